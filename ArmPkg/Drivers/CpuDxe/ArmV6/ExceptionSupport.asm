@@ -245,6 +245,10 @@ NoAdjustNeeded
 
 #if (FixedPcdGet32(PcdVFPEnabled))
   vpush    {d0-d15}                 ; save vstm registers in case they are used in optimizations
+  vmrs      R4, mvfr0               ; NEON code also uses d16-d31 when they exist
+  and       R4, R4, #0xf
+  cmp       R4, #2
+  vpusheq  {d16-d31}
 #endif
 
   mov       R4, SP                  ; Save current SP
@@ -265,6 +269,10 @@ CommonCExceptionHandler (
   mov       SP, R4                  ; Restore SP
 
 #if (FixedPcdGet32(PcdVFPEnabled))
+  vmrs      R0, mvfr0
+  and       R0, R0, #0xf
+  cmp       R0, #2
+  vpopeq    {d16-d31}
   vpop      {d0-d15}
 #endif
 
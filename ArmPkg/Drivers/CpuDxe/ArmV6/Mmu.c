@@ -339,273 +339,416 @@ SyncCacheConfig (
 
 
 
+// Non-secure bit of the first level descriptors pointing at a level 2 table
+#define TT_DESCRIPTOR_PAGETABLE_NS_MASK       (1UL << 3)
+
+// Level 2 tables released by a call of SetMemoryAttributes(). The table walks
+// may still use them until the TLB is invalidated at the end of the call, so
+// they only become free for the next calls.
+#define MMU_MAX_RELEASED_PAGE_TABLES          16
+
+// Changes of the first level and level 2 descriptors of a call of
+// SetMemoryAttributes(): Entry = ((Entry & ~Mask) | Value) & ~VirtualMask
+typedef struct {
+  UINT32                SectionMask;
+  UINT32                SectionValue;
+  UINT32                PageMask;
+  UINT32                PageValue;
+  UINT32                VirtualMask;
+} MMU_ENTRY_UPDATE;
+
+// Range of the data cache written back and invalidated at once
+typedef struct {
+  UINTN                 Base;
+  UINTN                 Length;
+} MMU_CACHE_RANGE;
+
+// Free level 2 tables, the first entry of each one links the next one
+STATIC ARM_PAGE_TABLE_ENTRY   *mFreePageTables;
+
+STATIC ARM_PAGE_TABLE_ENTRY   *mReleasedPageTables[MMU_MAX_RELEASED_PAGE_TABLES];
+STATIC UINTN                  mReleasedPageTableCount;
+
+STATIC
 EFI_STATUS
-UpdatePageEntries (
-  IN EFI_PHYSICAL_ADDRESS      BaseAddress,
-  IN UINT64                    Length,
-  IN UINT64                    Attributes,
-  IN EFI_PHYSICAL_ADDRESS      VirtualMask
+GetEntryUpdate (
+  IN  EFI_PHYSICAL_ADDRESS      BaseAddress,
+  IN  UINT64                    Attributes,
+  IN  EFI_PHYSICAL_ADDRESS      VirtualMask,
+  OUT MMU_ENTRY_UPDATE          *Update
   )
 {
-  EFI_STATUS    Status;
-  UINT32        EntryValue;
-  UINT32        EntryMask;
-  UINT32        FirstLevelIdx;
-  UINT32        Offset;
-  UINT32        NumPageEntries;
-  UINT32        Descriptor;
-  UINT32        p;
-  UINT32        PageTableIndex;
-  UINT32        PageTableEntry;
-  UINT32        CurrentPageTableEntry;
-  VOID          *Mva;
-
-  volatile ARM_FIRST_LEVEL_DESCRIPTOR   *FirstLevelTable;
-  volatile ARM_PAGE_TABLE_ENTRY         *PageTable;
+  // Mask: bitmask of values to change (1 = change this value, 0 = leave alone)
+  // Value: values at bit positions specified by Mask
 
-  Status = EFI_SUCCESS;
+  // Make sure we handle a range that is unmapped
+  Update->SectionMask = TT_DESCRIPTOR_SECTION_TYPE_MASK;
+  Update->SectionValue = TT_DESCRIPTOR_SECTION_TYPE_SECTION;
+  Update->PageMask = TT_DESCRIPTOR_PAGE_TYPE_MASK;
+  Update->PageValue = TT_DESCRIPTOR_PAGE_TYPE_PAGE;
+  Update->VirtualMask = (UINT32)VirtualMask;
 
-  // EntryMask: bitmask of values to change (1 = change this value, 0 = leave alone)
-  // EntryValue: values at bit positions specified by EntryMask
-  EntryMask = TT_DESCRIPTOR_PAGE_TYPE_MASK;
-  EntryValue = TT_DESCRIPTOR_PAGE_TYPE_PAGE;
   // Although the PI spec is unclear on this the GCD guarantees that only
   // one Attribute bit is set at a time, so we can safely use a switch statement
   switch (Attributes) {
     case EFI_MEMORY_UC:
       // modify cacheability attributes
-      EntryMask |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_MASK;
+      Update->SectionMask |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_MASK;
+      Update->PageMask |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_MASK;
       // map to strongly ordered
-      EntryValue |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_STRONGLY_ORDERED; // TEX[2:0] = 0, C=0, B=0
+      Update->SectionValue |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_STRONGLY_ORDERED; // TEX[2:0] = 0, C=0, B=0
+      Update->PageValue |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_STRONGLY_ORDERED;
       break;
 
     case EFI_MEMORY_WC:
       // modify cacheability attributes
-      EntryMask |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_MASK;
+      Update->SectionMask |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_MASK;
+      Update->PageMask |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_MASK;
       // map to normal non-cachable
-      EntryValue |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_NON_CACHEABLE; // TEX [2:0]= 001 = 0x2, B=0, C=0
+      Update->SectionValue |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_NON_CACHEABLE; // TEX [2:0]= 001 = 0x2, B=0, C=0
+      Update->PageValue |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_NON_CACHEABLE;
       break;
 
     case EFI_MEMORY_WT:
       // modify cacheability attributes
-      EntryMask |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_MASK;
+      Update->SectionMask |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_MASK;
+      Update->PageMask |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_MASK;
       // write through with no-allocate
-      EntryValue |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_WRITE_THROUGH_NO_ALLOC; // TEX [2:0] = 0, C=1, B=0
+      Update->SectionValue |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_WRITE_THROUGH_NO_ALLOC; // TEX [2:0] = 0, C=1, B=0
+      Update->PageValue |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_WRITE_THROUGH_NO_ALLOC;
       break;
 
     case EFI_MEMORY_WB:
       // modify cacheability attributes
-      EntryMask |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_MASK;
+      Update->SectionMask |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_MASK;
+      Update->PageMask |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_MASK;
       // write back (with allocate)
-      EntryValue |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_WRITE_BACK_ALLOC; // TEX [2:0] = 001, C=1, B=1
+      Update->SectionValue |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_WRITE_BACK_ALLOC; // TEX [2:0] = 001, C=1, B=1
+      Update->PageValue |= TT_DESCRIPTOR_PAGE_CACHE_POLICY_WRITE_BACK_ALLOC;
       break;
 
     case EFI_MEMORY_WP:
     case EFI_MEMORY_XP:
+    case EFI_MEMORY_RP:
     case EFI_MEMORY_UCE:
       // cannot be implemented UEFI definition unclear for ARM
       // Cause a page fault if these ranges are accessed.
-      EntryValue = TT_DESCRIPTOR_PAGE_TYPE_FAULT;
-      DEBUG ((EFI_D_PAGE, "SetMemoryAttributes(): setting page %lx with unsupported attribute %x will page fault on access\n", BaseAddress, Attributes));
+      Update->SectionValue = TT_DESCRIPTOR_SECTION_TYPE_FAULT;
+      Update->PageValue = TT_DESCRIPTOR_PAGE_TYPE_FAULT;
+      DEBUG ((EFI_D_PAGE, "SetMemoryAttributes(): setting range %lx with unsupported attribute %x will page fault on access\n", BaseAddress, Attributes));
       break;
 
     default:
       return EFI_UNSUPPORTED;
   }
 
-  // Obtain page table base
-  FirstLevelTable = (ARM_FIRST_LEVEL_DESCRIPTOR *)ArmGetTTBR0BaseAddress ();
-
-  // Calculate number of 4KB page table entries to change
-  NumPageEntries = Length / TT_DESCRIPTOR_PAGE_SIZE;
+  return EFI_SUCCESS;
+}
 
-  // Iterate for the number of 4KB pages to change
-  Offset = 0;
-  for(p = 0; p < NumPageEntries; p++) {
-    // Calculate index into first level translation table for page table value
+STATIC
+UINT32
+UpdateEntry (
+  IN UINT32                    Entry,
+  IN UINT32                    EntryMask,
+  IN UINT32                    EntryValue,
+  IN UINT32                    VirtualMask
+  )
+{
+  Entry = (Entry & ~EntryMask) | EntryValue;
 
-    FirstLevelIdx = TT_DESCRIPTOR_SECTION_BASE_ADDRESS(BaseAddress + Offset) >> TT_DESCRIPTOR_SECTION_BASE_SHIFT;
-    ASSERT (FirstLevelIdx < TRANSLATION_TABLE_SECTION_COUNT);
+  if (VirtualMask != 0) {
+    // Make this virtual address point at a physical page
+    Entry &= ~VirtualMask;
+  }
 
-    // Read the descriptor from the first level page table
-    Descriptor = FirstLevelTable[FirstLevelIdx];
+  return Entry;
+}
 
-    // Does this descriptor need to be converted from section entry to 4K pages?
-    if (!TT_DESCRIPTOR_SECTION_TYPE_IS_PAGE_TABLE(Descriptor)) {
-      Status = ConvertSectionToPages (FirstLevelIdx << TT_DESCRIPTOR_SECTION_BASE_SHIFT);
-      if (EFI_ERROR(Status)) {
-        // Exit for loop
-        break;
-      }
+STATIC
+VOID
+FlushCacheRange (
+  IN OUT MMU_CACHE_RANGE       *Range
+  )
+{
+  if (Range->Length != 0) {
+    // Falls back to a clean of the whole cache for the large ranges
+    WriteBackInvalidateDataCacheRange ((VOID *)Range->Base, Range->Length);
+    Range->Length = 0;
+  }
+}
 
-      // Re-read descriptor
-      Descriptor = FirstLevelTable[FirstLevelIdx];
-    }
+STATIC
+VOID
+AddCacheRange (
+  IN OUT MMU_CACHE_RANGE       *Range,
+  IN     UINTN                 Base,
+  IN     UINTN                 Length
+  )
+{
+  if ((Range->Length != 0) && (Range->Base + Range->Length == Base)) {
+    Range->Length += Length;
+  } else {
+    FlushCacheRange (Range);
+    Range->Base = Base;
+    Range->Length = Length;
+  }
+}
 
-    // Obtain page table base address
-    PageTable = (ARM_PAGE_TABLE_ENTRY *)TT_DESCRIPTOR_PAGE_BASE_ADDRESS(Descriptor);
+/**
+  Returns whether the update changes any descriptor of the range. The parts of
+  the range mapped cacheable whose descriptor changes are written back and
+  invalidated from the data cache, while they are still mapped.
+**/
+STATIC
+BOOLEAN
+PrepareEntryUpdates (
+  IN EFI_PHYSICAL_ADDRESS      BaseAddress,
+  IN EFI_PHYSICAL_ADDRESS      EndAddress,
+  IN MMU_ENTRY_UPDATE          *Update
+  )
+{
+  EFI_PHYSICAL_ADDRESS  Address;
+  EFI_PHYSICAL_ADDRESS  ChunkEnd;
+  UINT32                FirstLevelIdx;
+  UINT32                Descriptor;
+  UINT32                PageTableIndex;
+  UINT32                PageTableEntry;
+  BOOLEAN               Changed;
+  MMU_CACHE_RANGE       CacheRange;
 
-    // Calculate index into the page table
-    PageTableIndex = ((BaseAddress + Offset) & TT_DESCRIPTOR_PAGE_INDEX_MASK) >> TT_DESCRIPTOR_PAGE_BASE_SHIFT;
-    ASSERT (PageTableIndex < TRANSLATION_TABLE_PAGE_COUNT);
+  volatile ARM_FIRST_LEVEL_DESCRIPTOR   *FirstLevelTable;
+  volatile ARM_PAGE_TABLE_ENTRY         *PageTable;
 
-    // Get the entry
-    CurrentPageTableEntry = PageTable[PageTableIndex];
+  FirstLevelTable = (ARM_FIRST_LEVEL_DESCRIPTOR *)ArmGetTTBR0BaseAddress ();
+  Changed = FALSE;
+  CacheRange.Length = 0;
 
-    // Mask off appropriate fields
-    PageTableEntry = CurrentPageTableEntry & ~EntryMask;
+  for (Address = BaseAddress; Address < EndAddress; Address = ChunkEnd) {
+    FirstLevelIdx = (UINT32)(Address >> TT_DESCRIPTOR_SECTION_BASE_SHIFT);
+    ChunkEnd = MIN (EndAddress, TT_DESCRIPTOR_SECTION_BASE_ADDRESS (Address) + TT_DESCRIPTOR_SECTION_SIZE);
+    Descriptor = FirstLevelTable[FirstLevelIdx];
 
-    // Mask in new attributes and/or permissions
-    PageTableEntry |= EntryValue;
+    if (!TT_DESCRIPTOR_SECTION_TYPE_IS_PAGE_TABLE (Descriptor)) {
+      if (UpdateEntry (Descriptor, Update->SectionMask, Update->SectionValue, Update->VirtualMask) == Descriptor) {
+        continue;
+      }
 
-    if (VirtualMask != 0) {
-      // Make this virtual address point at a physical page
-      PageTableEntry &= ~VirtualMask;
+      Changed = TRUE;
+      if (((Descriptor & TT_DESCRIPTOR_SECTION_TYPE_MASK) == TT_DESCRIPTOR_SECTION_TYPE_SECTION) &&
+          ((Descriptor & TT_DESCRIPTOR_SECTION_CACHEABLE_MASK) == TT_DESCRIPTOR_SECTION_CACHEABLE_MASK)) {
+        AddCacheRange (&CacheRange, (UINTN)Address, (UINTN)(ChunkEnd - Address));
+      }
+      continue;
     }
 
-    if (CurrentPageTableEntry  != PageTableEntry) {
-      Mva = (VOID *)(UINTN)((((UINTN)FirstLevelIdx) << TT_DESCRIPTOR_SECTION_BASE_SHIFT) + (PageTableIndex << TT_DESCRIPTOR_PAGE_BASE_SHIFT));
-      if ((CurrentPageTableEntry & TT_DESCRIPTOR_PAGE_CACHEABLE_MASK) == TT_DESCRIPTOR_PAGE_CACHEABLE_MASK) {
-        // The current section mapping is cacheable so Clean/Invalidate the MVA of the page
-        // Note assumes switch(Attributes), not ARMv7 possibilities
-        WriteBackInvalidateDataCacheRange (Mva, TT_DESCRIPTOR_PAGE_SIZE);
+    PageTable = (ARM_PAGE_TABLE_ENTRY *)(Descriptor & TT_DESCRIPTOR_SECTION_PAGETABLE_ADDRESS_MASK);
+    for (; Address < ChunkEnd; Address += TT_DESCRIPTOR_PAGE_SIZE) {
+      PageTableIndex = (UINT32)((Address & TT_DESCRIPTOR_PAGE_INDEX_MASK) >> TT_DESCRIPTOR_PAGE_BASE_SHIFT);
+      PageTableEntry = PageTable[PageTableIndex];
+      if (UpdateEntry (PageTableEntry, Update->PageMask, Update->PageValue, Update->VirtualMask) == PageTableEntry) {
+        continue;
       }
 
-      // Only need to update if we are changing the entry
-      PageTable[PageTableIndex] = PageTableEntry;
-      ArmUpdateTranslationTableEntry ((VOID *)&PageTable[PageTableIndex], Mva);
+      Changed = TRUE;
+      if (((PageTableEntry & TT_DESCRIPTOR_PAGE_TYPE_PAGE) == TT_DESCRIPTOR_PAGE_TYPE_PAGE) &&
+          ((PageTableEntry & TT_DESCRIPTOR_PAGE_CACHEABLE_MASK) == TT_DESCRIPTOR_PAGE_CACHEABLE_MASK)) {
+        AddCacheRange (&CacheRange, (UINTN)Address, TT_DESCRIPTOR_PAGE_SIZE);
+      }
     }
+  }
 
-    Status = EFI_SUCCESS;
-    Offset += TT_DESCRIPTOR_PAGE_SIZE;
-
-  } // End first level translation table loop
+  FlushCacheRange (&CacheRange);
 
-  return Status;
+  return Changed;
 }
 
+STATIC
+UINT32
+ConvertPageAttributesToSectionAttributes (
+  IN UINT32   PageAttributes
+  )
+{
+  UINT32 SectionAttributes;
 
+  SectionAttributes = 0;
+  SectionAttributes |= TT_DESCRIPTOR_CONVERT_TO_SECTION_CACHE_POLICY (PageAttributes, FALSE);
+  SectionAttributes |= TT_DESCRIPTOR_CONVERT_TO_SECTION_AP (PageAttributes);
+  if ((PageAttributes & TT_DESCRIPTOR_PAGE_XN_MASK) != 0) {
+    SectionAttributes |= TT_DESCRIPTOR_SECTION_XN_MASK;
+  }
+  if ((PageAttributes & TT_DESCRIPTOR_PAGE_NG_MASK) != 0) {
+    SectionAttributes |= TT_DESCRIPTOR_SECTION_NG_MASK;
+  }
+  if ((PageAttributes & TT_DESCRIPTOR_PAGE_S_MASK) != 0) {
+    SectionAttributes |= TT_DESCRIPTOR_SECTION_S_MASK;
+  }
 
-EFI_STATUS
-UpdateSectionEntries (
-  IN EFI_PHYSICAL_ADDRESS      BaseAddress,
-  IN UINT64                    Length,
-  IN UINT64                    Attributes,
-  IN EFI_PHYSICAL_ADDRESS      VirtualMask
+  return SectionAttributes;
+}
+
+/**
+  Maps the section with a section descriptor again when its level 2 table
+  maps the whole section contiguously with the same attributes.
+**/
+STATIC
+VOID
+ConvertPagesToSection (
+  IN UINT32                    FirstLevelIdx
   )
 {
-  EFI_STATUS    Status = EFI_SUCCESS;
-  UINT32        EntryMask;
-  UINT32        EntryValue;
-  UINT32        FirstLevelIdx;
-  UINT32        NumSections;
-  UINT32        i;
-  UINT32        CurrentDescriptor;
   UINT32        Descriptor;
-  VOID          *Mva;
+  UINT32        PageTableEntry;
+  UINT32        Index;
+
   volatile ARM_FIRST_LEVEL_DESCRIPTOR   *FirstLevelTable;
+  volatile ARM_PAGE_TABLE_ENTRY         *PageTable;
 
-  // EntryMask: bitmask of values to change (1 = change this value, 0 = leave alone)
-  // EntryValue: values at bit positions specified by EntryMask
+  if (mReleasedPageTableCount == MMU_MAX_RELEASED_PAGE_TABLES) {
+    // The next calls will convert it
+    return;
+  }
 
-  // Make sure we handle a section range that is unmapped
-  EntryMask = TT_DESCRIPTOR_SECTION_TYPE_MASK;
-  EntryValue = TT_DESCRIPTOR_SECTION_TYPE_SECTION;
+  FirstLevelTable = (ARM_FIRST_LEVEL_DESCRIPTOR *)ArmGetTTBR0BaseAddress ();
+  Descriptor = FirstLevelTable[FirstLevelIdx];
+  PageTable = (ARM_PAGE_TABLE_ENTRY *)(Descriptor & TT_DESCRIPTOR_SECTION_PAGETABLE_ADDRESS_MASK);
+
+  // The first page must be at the start of a physical section, and the others
+  // follow it with the same attributes
+  PageTableEntry = PageTable[0];
+  if (((PageTableEntry & TT_DESCRIPTOR_PAGE_TYPE_PAGE) != TT_DESCRIPTOR_PAGE_TYPE_PAGE) ||
+      ((TT_DESCRIPTOR_PAGE_BASE_ADDRESS (PageTableEntry) & (TT_DESCRIPTOR_SECTION_SIZE - 1)) != 0)) {
+    return;
+  }
+  for (Index = 1; Index < TRANSLATION_TABLE_PAGE_COUNT; Index++) {
+    if (PageTable[Index] != PageTableEntry + (Index << TT_DESCRIPTOR_PAGE_BASE_SHIFT)) {
+      return;
+    }
+  }
 
-  // Although the PI spec is unclear on this the GCD guarantees that only
-  // one Attribute bit is set at a time, so we can safely use a switch statement
-  switch(Attributes) {
-    case EFI_MEMORY_UC:
-      // modify cacheability attributes
-      EntryMask |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_MASK;
-      // map to strongly ordered
-      EntryValue |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_STRONGLY_ORDERED; // TEX[2:0] = 0, C=0, B=0
-      break;
+  DEBUG ((EFI_D_PAGE, "Converting pages at 0x%x to a section\n", FirstLevelIdx << TT_DESCRIPTOR_SECTION_BASE_SHIFT));
 
-    case EFI_MEMORY_WC:
-      // modify cacheability attributes
-      EntryMask |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_MASK;
-      // map to normal non-cachable
-      EntryValue |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_NON_CACHEABLE; // TEX [2:0]= 001 = 0x2, B=0, C=0
-      break;
+  FirstLevelTable[FirstLevelIdx] =
+      TT_DESCRIPTOR_SECTION_BASE_ADDRESS (PageTableEntry) |
+      TT_DESCRIPTOR_SECTION_TYPE_SECTION |
+      (Descriptor & TT_DESCRIPTOR_SECTION_DOMAIN_MASK) |
+      (((Descriptor & TT_DESCRIPTOR_PAGETABLE_NS_MASK) != 0) ? TT_DESCRIPTOR_SECTION_NS : 0) |
+      ConvertPageAttributesToSectionAttributes (PageTableEntry);
 
-    case EFI_MEMORY_WT:
-      // modify cacheability attributes
-      EntryMask |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_MASK;
-      // write through with no-allocate
-      EntryValue |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_WRITE_THROUGH_NO_ALLOC; // TEX [2:0] = 0, C=1, B=0
-      break;
+  mReleasedPageTables[mReleasedPageTableCount++] = (ARM_PAGE_TABLE_ENTRY *)PageTable;
+}
 
-    case EFI_MEMORY_WB:
-      // modify cacheability attributes
-      EntryMask |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_MASK;
-      // write back (with allocate)
-      EntryValue |= TT_DESCRIPTOR_SECTION_CACHE_POLICY_WRITE_BACK_ALLOC; // TEX [2:0] = 001, C=1, B=1
-      break;
+/**
+  Updates the level 2 descriptors of a range within a single section, and
+  writes back the ones that changed for the table walks.
+**/
+STATIC
+VOID
+UpdatePageEntries (
+  IN EFI_PHYSICAL_ADDRESS      BaseAddress,
+  IN EFI_PHYSICAL_ADDRESS      EndAddress,
+  IN UINT32                    Descriptor,
+  IN MMU_ENTRY_UPDATE          *Update
+  )
+{
+  UINT32        PageTableIndex;
+  UINT32        LastPageTableIndex;
+  UINT32        FirstChanged;
+  UINT32        LastChanged;
+  UINT32        CurrentPageTableEntry;
+  UINT32        PageTableEntry;
 
-    case EFI_MEMORY_WP:
-    case EFI_MEMORY_XP:
-    case EFI_MEMORY_RP:
-    case EFI_MEMORY_UCE:
-      // cannot be implemented UEFI definition unclear for ARM
-      // Cause a page fault if these ranges are accessed.
-      EntryValue = TT_DESCRIPTOR_SECTION_TYPE_FAULT;
-      DEBUG ((EFI_D_PAGE, "SetMemoryAttributes(): setting section %lx with unsupported attribute %x will page fault on access\n", BaseAddress, Attributes));
-      break;
+  volatile ARM_PAGE_TABLE_ENTRY         *PageTable;
 
+  // Obtain page table base address
+  PageTable = (ARM_PAGE_TABLE_ENTRY *)(Descriptor & TT_DESCRIPTOR_SECTION_PAGETABLE_ADDRESS_MASK);
 
-    default:
-      return EFI_UNSUPPORTED;
+  PageTableIndex = (UINT32)((BaseAddress & TT_DESCRIPTOR_PAGE_INDEX_MASK) >> TT_DESCRIPTOR_PAGE_BASE_SHIFT);
+  LastPageTableIndex = PageTableIndex + (UINT32)((EndAddress - BaseAddress) >> TT_DESCRIPTOR_PAGE_BASE_SHIFT);
+  ASSERT (LastPageTableIndex <= TRANSLATION_TABLE_PAGE_COUNT);
+
+  FirstChanged = TRANSLATION_TABLE_PAGE_COUNT;
+  LastChanged = 0;
+
+  for (; PageTableIndex < LastPageTableIndex; PageTableIndex++) {
+    CurrentPageTableEntry = PageTable[PageTableIndex];
+    PageTableEntry = UpdateEntry (CurrentPageTableEntry, Update->PageMask, Update->PageValue, Update->VirtualMask);
+
+    // Only need to update if we are changing the entry
+    if (CurrentPageTableEntry != PageTableEntry) {
+      PageTable[PageTableIndex] = PageTableEntry;
+      FirstChanged = MIN (FirstChanged, PageTableIndex);
+      LastChanged = PageTableIndex;
+    }
   }
 
+  if (FirstChanged <= LastChanged) {
+    WriteBackDataCacheRange (
+      (VOID *)&PageTable[FirstChanged],
+      (LastChanged - FirstChanged + 1) * sizeof (ARM_PAGE_TABLE_ENTRY)
+      );
+  }
+}
+
+/**
+  Updates the descriptors of the range. The sections it only partly covers are
+  converted to pages, and the level 2 tables mapping a whole section with the
+  same attributes afterwards are converted back to sections.
+**/
+STATIC
+EFI_STATUS
+UpdateEntries (
+  IN EFI_PHYSICAL_ADDRESS      BaseAddress,
+  IN EFI_PHYSICAL_ADDRESS      EndAddress,
+  IN MMU_ENTRY_UPDATE          *Update
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PHYSICAL_ADDRESS  Address;
+  EFI_PHYSICAL_ADDRESS  ChunkEnd;
+  UINT32                FirstLevelIdx;
+  UINT32                CurrentDescriptor;
+  UINT32                Descriptor;
+
+  volatile ARM_FIRST_LEVEL_DESCRIPTOR   *FirstLevelTable;
+
   // obtain page table base
   FirstLevelTable = (ARM_FIRST_LEVEL_DESCRIPTOR *)ArmGetTTBR0BaseAddress ();
 
-  // calculate index into first level translation table for start of modification
-  FirstLevelIdx = TT_DESCRIPTOR_SECTION_BASE_ADDRESS(BaseAddress) >> TT_DESCRIPTOR_SECTION_BASE_SHIFT;
-  ASSERT (FirstLevelIdx < TRANSLATION_TABLE_SECTION_COUNT);
-
-  // calculate number of 1MB first level entries this applies to
-  NumSections = Length / TT_DESCRIPTOR_SECTION_SIZE;
+  for (Address = BaseAddress; Address < EndAddress; Address = ChunkEnd) {
+    FirstLevelIdx = (UINT32)(Address >> TT_DESCRIPTOR_SECTION_BASE_SHIFT);
+    ASSERT (FirstLevelIdx < TRANSLATION_TABLE_SECTION_COUNT);
+    ChunkEnd = MIN (EndAddress, TT_DESCRIPTOR_SECTION_BASE_ADDRESS (Address) + TT_DESCRIPTOR_SECTION_SIZE);
 
-  // iterate through each descriptor
-  for(i=0; i<NumSections; i++) {
-    CurrentDescriptor = FirstLevelTable[FirstLevelIdx + i];
+    CurrentDescriptor = FirstLevelTable[FirstLevelIdx];
 
-    // has this descriptor already been coverted to pages?
-    if (TT_DESCRIPTOR_SECTION_TYPE_IS_PAGE_TABLE(CurrentDescriptor)) {
-      // forward this 1MB range to page table function instead
-      Status = UpdatePageEntries ((FirstLevelIdx + i) << TT_DESCRIPTOR_SECTION_BASE_SHIFT, TT_DESCRIPTOR_SECTION_SIZE, Attributes, VirtualMask);
-    } else {
+    if (!TT_DESCRIPTOR_SECTION_TYPE_IS_PAGE_TABLE (CurrentDescriptor)) {
       // still a section entry
+      Descriptor = UpdateEntry (CurrentDescriptor, Update->SectionMask, Update->SectionValue, Update->VirtualMask);
+      if (Descriptor == CurrentDescriptor) {
+        continue;
+      }
 
-      // mask off appropriate fields
-      Descriptor = CurrentDescriptor & ~EntryMask;
-
-      // mask in new attributes and/or permissions
-      Descriptor |= EntryValue;
-      if (VirtualMask != 0) {
-        Descriptor &= ~VirtualMask;
+      if (ChunkEnd - Address == TT_DESCRIPTOR_SECTION_SIZE) {
+        FirstLevelTable[FirstLevelIdx] = Descriptor;
+        continue;
       }
 
-      if (CurrentDescriptor  != Descriptor) {
-        Mva = (VOID *)(UINTN)(((UINTN)FirstLevelTable) << TT_DESCRIPTOR_SECTION_BASE_SHIFT);
-        if ((CurrentDescriptor & TT_DESCRIPTOR_SECTION_CACHEABLE_MASK) == TT_DESCRIPTOR_SECTION_CACHEABLE_MASK) {
-          // The current section mapping is cacheable so Clean/Invalidate the MVA of the section
-          // Note assumes switch(Attributes), not ARMv7 possabilities
-          WriteBackInvalidateDataCacheRange (Mva, SIZE_1MB);
-        }
-
-        // Only need to update if we are changing the descriptor
-        FirstLevelTable[FirstLevelIdx + i] = Descriptor;
-        ArmUpdateTranslationTableEntry ((VOID *)&FirstLevelTable[FirstLevelIdx + i], Mva);
+      // Only part of the section changes, it has to be converted to 4K pages
+      Status = ConvertSectionToPages (FirstLevelIdx << TT_DESCRIPTOR_SECTION_BASE_SHIFT);
+      if (EFI_ERROR (Status)) {
+        return Status;
       }
+      CurrentDescriptor = FirstLevelTable[FirstLevelIdx];
+    }
 
-      Status = EFI_SUCCESS;
+    UpdatePageEntries (Address, ChunkEnd, CurrentDescriptor, Update);
+
+    if (Update->VirtualMask == 0) {
+      ConvertPagesToSection (FirstLevelIdx);
     }
   }
 
-  return Status;
+  return EFI_SUCCESS;
 }
 
 EFI_STATUS
@@ -637,10 +780,16 @@ ConvertSectionToPages (
   SectionDescriptor = FirstLevelTable[FirstLevelIdx];
   PageDescriptor = TT_DESCRIPTOR_PAGE_TYPE_PAGE | ConvertSectionAttributesToPageAttributes (SectionDescriptor, FALSE);
 
-  // Allocate a page table for the 4KB entries (we use up a full page even though we only need 1KB)
-  Status = gBS->AllocatePages (AllocateAnyPages, EfiBootServicesData, 1, &PageTableAddr);
-  if (EFI_ERROR(Status)) {
-    return Status;
+  if (mFreePageTables != NULL) {
+    // Reuse a table released by a section conversion
+    PageTableAddr = (UINTN)mFreePageTables;
+    mFreePageTables = *(ARM_PAGE_TABLE_ENTRY **)mFreePageTables;
+  } else {
+    // Allocate a page table for the 4KB entries (we use up a full page even though we only need 1KB)
+    Status = gBS->AllocatePages (AllocateAnyPages, EfiBootServicesData, 1, &PageTableAddr);
+    if (EFI_ERROR(Status)) {
+      return Status;
+    }
   }
 
   PageTable = (volatile ARM_PAGE_TABLE_ENTRY *)(UINTN)PageTableAddr;
@@ -651,7 +800,7 @@ ConvertSectionToPages (
   }
 
   // Flush d-cache so descriptors make it back to uncached memory for subsequent table walks
-  WriteBackInvalidateDataCacheRange ((VOID *)(UINTN)PageTableAddr, TT_DESCRIPTOR_PAGE_SIZE);
+  WriteBackInvalidateDataCacheRange ((VOID *)(UINTN)PageTableAddr, TRANSLATION_TABLE_PAGE_SIZE);
 
   // Formulate page table entry, Domain=0, NS=0
   PageTableDescriptor = (((UINTN)PageTableAddr) & TT_DESCRIPTOR_SECTION_PAGETABLE_ADDRESS_MASK) | TT_DESCRIPTOR_SECTION_TYPE_PAGE_TABLE;
@@ -672,28 +821,59 @@ SetMemoryAttributes (
   IN EFI_PHYSICAL_ADDRESS      VirtualMask
   )
 {
-  EFI_STATUS    Status;
+  EFI_STATUS            Status;
+  EFI_PHYSICAL_ADDRESS  EndAddress;
+  MMU_ENTRY_UPDATE      Update;
+  UINT32                FirstLevelIdx;
+  UINT32                LastFirstLevelIdx;
+  UINTN                 Index;
 
-  if(((BaseAddress & 0xFFFFF) == 0) && ((Length & 0xFFFFF) == 0)) {
-    // Is the base and length a multiple of 1 MB?
-    DEBUG ((EFI_D_PAGE, "SetMemoryAttributes(): MMU section 0x%x length 0x%x to %lx\n", (UINTN)BaseAddress, (UINTN)Length, Attributes));
-    Status = UpdateSectionEntries (BaseAddress, Length, Attributes, VirtualMask);
-  } else {
-    // Base and/or length is not a multiple of 1 MB
-    DEBUG ((EFI_D_PAGE, "SetMemoryAttributes(): MMU page 0x%x length 0x%x to %lx\n", (UINTN)BaseAddress, (UINTN)Length, Attributes));
-    Status = UpdatePageEntries (BaseAddress, Length, Attributes, VirtualMask);
+  volatile ARM_FIRST_LEVEL_DESCRIPTOR   *FirstLevelTable;
+
+  DEBUG ((EFI_D_PAGE, "SetMemoryAttributes(): MMU range 0x%x length 0x%x to %lx\n", (UINTN)BaseAddress, (UINTN)Length, Attributes));
+
+  // The descriptors map 4KB pages at least
+  ASSERT (((BaseAddress | Length) & (TT_DESCRIPTOR_PAGE_SIZE - 1)) == 0);
+  EndAddress = BaseAddress + (Length & ~(UINT64)(TT_DESCRIPTOR_PAGE_SIZE - 1));
+  if ((Length == 0) || (EndAddress > SIZE_4GB)) {
+    return (Length == 0) ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
   }
 
-  // Flush d-cache so descriptors make it back to uncached memory for subsequent table walks
-  // flush and invalidate pages
-  //TODO: Do we really need to invalidate the caches everytime we change the memory attributes ?
-  ArmCleanInvalidateDataCache ();
+  Status = GetEntryUpdate (BaseAddress, Attributes, VirtualMask, &Update);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
 
-  ArmInvalidateInstructionCache ();
+  // Nothing to write nor to invalidate when the range already has the attributes
+  if (!PrepareEntryUpdates (BaseAddress, EndAddress, &Update)) {
+    return EFI_SUCCESS;
+  }
 
-  // Invalidate all TLB entries so changes are synced
+  Status = UpdateEntries (BaseAddress, EndAddress, &Update);
+
+  // Flush d-cache so descriptors make it back to uncached memory for subsequent table walks,
+  // the level 2 ones have been written back by UpdatePageEntries()
+  FirstLevelTable = (ARM_FIRST_LEVEL_DESCRIPTOR *)ArmGetTTBR0BaseAddress ();
+  FirstLevelIdx = (UINT32)(BaseAddress >> TT_DESCRIPTOR_SECTION_BASE_SHIFT);
+  LastFirstLevelIdx = (UINT32)((EndAddress - 1) >> TT_DESCRIPTOR_SECTION_BASE_SHIFT);
+  WriteBackDataCacheRange (
+    (VOID *)&FirstLevelTable[FirstLevelIdx],
+    (LastFirstLevelIdx - FirstLevelIdx + 1) * sizeof (ARM_FIRST_LEVEL_DESCRIPTOR)
+    );
+  ArmDataSyncronizationBarrier ();
+
+  // Invalidate all TLB entries once for the whole range so changes are synced
   ArmInvalidateTlb ();
 
+  ArmInvalidateInstructionCache ();
+
+  // The table walks no longer use the level 2 tables released by this call
+  for (Index = 0; Index < mReleasedPageTableCount; Index++) {
+    *(ARM_PAGE_TABLE_ENTRY **)mReleasedPageTables[Index] = mFreePageTables;
+    mFreePageTables = mReleasedPageTables[Index];
+  }
+  mReleasedPageTableCount = 0;
+
   return Status;
 }
 
@@ -29,6 +29,16 @@
 
 #include <Protocol/Timer.h>
 #include <Protocol/HardwareInterrupt.h>
+#include <Protocol/TicklessTimer.h>
+
+//
+// Range of the delays programmed in tickless mode, in 100 ns units. Timer events
+// that are already due must not keep the timer interrupt asserted, and the
+// DXE core does not expect to wait forever without a tick. Code that sleeps in
+// WFI for a bounded time must arm a timer event for it (see SdHostDxe).
+//
+#define TIMER_TICKLESS_MIN_DELAY    100                 // 10 us
+#define TIMER_TICKLESS_MAX_DELAY    6000000000ULL       // 10 minutes
 
 // The notification function to call on every timer interrupt.
 EFI_TIMER_NOTIFY      mTimerNotifyFunction     = (EFI_TIMER_NOTIFY)NULL;
@@ -40,10 +50,68 @@ UINT64 mTimerPeriod = 0;
 UINT64 mTimerTicks = 0;
 // Number of elapsed period since the last Timer interrupt
 UINT64 mElapsedPeriod = 1;
+// Frequency of the system counter
+UINT32 mTimerFrequency = 0;
+// Counter value up to which the time has been passed to mTimerNotifyFunction in periodic mode
+UINT64 mLastNotifyCount = 0;
+
+// Tickless operation is wanted, and the DXE core has reported a deadline
+BOOLEAN mTicklessRequested = FALSE;
+BOOLEAN mTickless = FALSE;
+// In tickless mode, the time passed to mTimerNotifyFunction since the counter
+// was at mTicklessBase. Always converting from the same base keeps the rounding
+// of the counter ticks to 100 ns from adding up.
+UINT64 mTicklessBase = 0;
+UINT64 mTicklessTime = 0;
+// Counter value of the earliest deadline reported by the DXE core
+UINT64 mDeadlineCount = 0;
+
+// Statistics returned by TimerGetStatistics()
+UINT64 mInterruptCount = 0;
+UINT64 mDeadlineReports = 0;
+UINT64 mStatisticsStart = 0;
 
 // Cached copy of the Hardware Interrupt protocol instance
 EFI_HARDWARE_INTERRUPT_PROTOCOL *gInterrupt = NULL;
 
+/**
+  Converts counter ticks to 100 ns units, rounding down.
+**/
+STATIC
+UINT64
+TimerTicksToTime (
+  IN UINT64   Ticks
+  )
+{
+  UINT64  Seconds;
+  UINT64  Remainder;
+
+  // Per second, so that long periods without interrupt cannot overflow
+  Seconds = DivU64x64Remainder (Ticks, mTimerFrequency, &Remainder);
+  return MultU64x32 (Seconds, 10000000U) + DivU64x32 (MultU64x32 (Remainder, 10000000U), mTimerFrequency);
+}
+
+/**
+  Converts 100 ns units to counter ticks, rounding up or down.
+**/
+STATIC
+UINT64
+TimerTimeToTicks (
+  IN UINT64   Time,
+  IN BOOLEAN  RoundUp
+  )
+{
+  UINT64  Seconds;
+  UINT64  Remainder;
+
+  Seconds = DivU64x64Remainder (Time, 10000000U, &Remainder);
+  Remainder = MultU64x32 (Remainder, mTimerFrequency);
+  if (RoundUp) {
+    Remainder += 10000000U - 1;
+  }
+  return MultU64x32 (Seconds, mTimerFrequency) + DivU64x32 (Remainder, 10000000U);
+}
+
 /**
   This function registers the handler NotifyFunction so it is called every time
   the timer interrupt fires.  It also passes the amount of time since the last
@@ -162,12 +230,19 @@ TimerDriverSetTimerPeriod (
     mTimerPeriod   = TimerPeriod;
     mElapsedPeriod = 1;
 
-    gBS->RestoreTPL (OriginalTPL);
+    if (mTickless) {
+      // The interrupt follows the deadlines, the time kept counting while the
+      // timer was off
+      ArmGenericTimerSetCompareVal (mDeadlineCount);
+    } else {
+      // Get value of the current timer
+      CounterValue = ArmGenericTimerGetSystemCount ();
+      mLastNotifyCount = CounterValue;
+      // Set the interrupt in Current Time + mTimerTick
+      ArmGenericTimerSetCompareVal (CounterValue + mTimerTicks);
+    }
 
-    // Get value of the current timer
-    CounterValue = ArmGenericTimerGetSystemCount ();
-    // Set the interrupt in Current Time + mTimerTick
-    ArmGenericTimerSetCompareVal (CounterValue + mTimerTicks);
+    gBS->RestoreTPL (OriginalTPL);
 
     // Enable the timer
     ArmGenericTimerEnableTimer ();
@@ -235,6 +310,170 @@ TimerDriverGenerateSoftInterrupt (
   return EFI_UNSUPPORTED;
 }
 
+/**
+  Records the earliest deadline of the DXE core timer events and, in tickless
+  mode, programs the timer interrupt for it.
+
+  @param  This             The EDKII_TICKLESS_TIMER_PROTOCOL instance.
+  @param  Delay            The time left before the deadline in 100 ns units.
+
+  @retval EFI_SUCCESS           The deadline was recorded.
+
+**/
+EFI_STATUS
+EFIAPI
+TimerSetDeadline (
+  IN EDKII_TICKLESS_TIMER_PROTOCOL  *This,
+  IN UINT64                         Delay
+  )
+{
+  EFI_TPL     OriginalTPL;
+
+  // Also turns TICKLESS_TIMER_NO_DEADLINE into the longest delay
+  if (Delay < TIMER_TICKLESS_MIN_DELAY) {
+    Delay = TIMER_TICKLESS_MIN_DELAY;
+  } else if (Delay > TIMER_TICKLESS_MAX_DELAY) {
+    Delay = TIMER_TICKLESS_MAX_DELAY;
+  }
+
+  OriginalTPL = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+  mDeadlineReports++;
+  // Rounded up, the Duration passed at the interrupt then reaches the deadline
+  mDeadlineCount = ArmGenericTimerGetSystemCount () + TimerTimeToTicks (Delay, TRUE);
+
+  // The first deadline shows that the DXE core keeps them up to date. The time
+  // up to mLastNotifyCount has been passed to the DXE core as timer periods.
+  if (mTicklessRequested && !mTickless) {
+    mTickless = TRUE;
+    mTicklessBase = mLastNotifyCount;
+    mTicklessTime = 0;
+  }
+
+  if (mTickless && (mTimerPeriod != 0)) {
+    ArmGenericTimerSetCompareVal (mDeadlineCount);
+  }
+
+  gBS->RestoreTPL (OriginalTPL);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the time elapsed since the last call to mTimerNotifyFunction.
+
+  @param  This             The EDKII_TICKLESS_TIMER_PROTOCOL instance.
+  @param  Elapsed          The time in 100 ns units, 0 in periodic mode.
+
+  @retval EFI_SUCCESS           Elapsed was returned.
+  @retval EFI_INVALID_PARAMETER Elapsed is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+TimerGetElapsedTime (
+  IN  EDKII_TICKLESS_TIMER_PROTOCOL *This,
+  OUT UINT64                        *Elapsed
+  )
+{
+  if (Elapsed == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (mTickless) {
+    *Elapsed = TimerTicksToTime (ArmGenericTimerGetSystemCount () - mTicklessBase) - mTicklessTime;
+  } else {
+    *Elapsed = 0;
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Switches between tickless and periodic operation.
+
+  @param  This             The EDKII_TICKLESS_TIMER_PROTOCOL instance.
+  @param  Tickless         TRUE for tickless operation.
+
+  @retval EFI_SUCCESS           The mode was changed.
+
+**/
+EFI_STATUS
+EFIAPI
+TimerSetMode (
+  IN EDKII_TICKLESS_TIMER_PROTOCOL  *This,
+  IN BOOLEAN                        Tickless
+  )
+{
+  EFI_TPL     OriginalTPL;
+  UINT64      Ticks;
+
+  OriginalTPL = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+  // Going tickless waits for the next deadline, at the latest on the next tick
+  mTicklessRequested = Tickless;
+
+  if (!Tickless && mTickless) {
+    mTickless = FALSE;
+
+    // Resume the periods where the time was last passed to the DXE core
+    mLastNotifyCount = mTicklessBase + TimerTimeToTicks (mTicklessTime, FALSE);
+    if (mTimerTicks != 0) {
+      Ticks = ArmGenericTimerGetSystemCount () - mLastNotifyCount;
+      mElapsedPeriod = DivU64x64Remainder (Ticks, mTimerTicks, NULL) + 1;
+      ArmGenericTimerSetCompareVal (mLastNotifyCount + MultU64x64 (mElapsedPeriod, mTimerTicks));
+    }
+  }
+
+  gBS->RestoreTPL (OriginalTPL);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the timer interrupt statistics.
+
+  @param  This             The EDKII_TICKLESS_TIMER_PROTOCOL instance.
+  @param  Reset            TRUE to reset the statistics after reading them.
+  @param  Statistics       The statistics.
+
+  @retval EFI_SUCCESS           The statistics were returned.
+  @retval EFI_INVALID_PARAMETER Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+TimerGetStatistics (
+  IN  EDKII_TICKLESS_TIMER_PROTOCOL     *This,
+  IN  BOOLEAN                           Reset,
+  OUT EDKII_TICKLESS_TIMER_STATISTICS   *Statistics
+  )
+{
+  EFI_TPL     OriginalTPL;
+  UINT64      CounterValue;
+
+  if (Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  OriginalTPL = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+  CounterValue = ArmGenericTimerGetSystemCount ();
+  Statistics->Tickless   = mTickless;
+  Statistics->Interrupts = mInterruptCount;
+  Statistics->Deadlines  = mDeadlineReports;
+  Statistics->Elapsed    = TimerTicksToTime (CounterValue - mStatisticsStart);
+
+  if (Reset) {
+    mInterruptCount  = 0;
+    mDeadlineReports = 0;
+    mStatisticsStart = CounterValue;
+  }
+
+  gBS->RestoreTPL (OriginalTPL);
+
+  return EFI_SUCCESS;
+}
+
 /**
   Interface structure for the Timer Architectural Protocol.
 
@@ -276,6 +515,13 @@ EFI_TIMER_ARCH_PROTOCOL   gTimer = {
   TimerDriverGenerateSoftInterrupt
 };
 
+EDKII_TICKLESS_TIMER_PROTOCOL   gTicklessTimer = {
+  TimerSetDeadline,
+  TimerGetElapsedTime,
+  TimerSetMode,
+  TimerGetStatistics
+};
+
 /**
 
   C Interrupt Handler called in the interrupt context when Source interrupt is active.
@@ -299,6 +545,8 @@ TimerInterruptHandler (
   EFI_TPL      OriginalTPL;
   UINT64       CurrentValue;
   UINT64       CompareValue;
+  UINT64       Time;
+  UINT64       Duration;
 
   //
   // DXE core uses this callback for the EFI timer tick. The DXE core uses locks
@@ -313,31 +561,56 @@ TimerInterruptHandler (
     // Signal end of interrupt early to help avoid losing subsequent ticks from long duration handlers
     gInterrupt->EndOfInterrupt (gInterrupt, Source);
 
-    if (mTimerNotifyFunction) {
-      mTimerNotifyFunction (mTimerPeriod * mElapsedPeriod);
+    mInterruptCount++;
+
+    if (mTickless) {
+      // Pass the time elapsed since the last call, in whole 100 ns units
+      CurrentValue = ArmGenericTimerGetSystemCount ();
+      Time = TimerTicksToTime (CurrentValue - mTicklessBase);
+      Duration = Time - mTicklessTime;
+      mTicklessTime = Time;
+
+      // The DXE core reports its next deadline from the notification function,
+      // until then there is nothing to wake up for
+      mDeadlineCount = CurrentValue + TimerTimeToTicks (TIMER_TICKLESS_MAX_DELAY, TRUE);
+      ArmGenericTimerSetCompareVal (mDeadlineCount);
+
+      if (mTimerNotifyFunction) {
+        mTimerNotifyFunction (Duration);
+      }
+      ArmGenericTimerEnableTimer ();
+    } else {
+      // Time up to the compare value is passed to the DXE core below
+      mLastNotifyCount = ArmGenericTimerGetCompareVal ();
+
+      if (mTimerNotifyFunction) {
+        mTimerNotifyFunction (mTimerPeriod * mElapsedPeriod);
+      }
+
+      //
+      // Reload the Timer, unless the deadline the DXE core has just reported
+      // switched it to tickless operation
+      //
+      if (!mTickless) {
+        // Get current counter value
+        CurrentValue = ArmGenericTimerGetSystemCount ();
+        // Get the counter value to compare with
+        CompareValue = ArmGenericTimerGetCompareVal ();
+
+        // This loop is needed in case we missed interrupts (eg: case when the interrupt handling
+        // has taken longer than mTickPeriod).
+        // Note: Physical Counter is counting up
+        mElapsedPeriod = 0;
+        do {
+          CompareValue += mTimerTicks;
+          mElapsedPeriod++;
+        } while (CompareValue < CurrentValue);
+
+        // Set next compare value
+        ArmGenericTimerSetCompareVal (CompareValue);
+      }
+      ArmGenericTimerEnableTimer ();
     }
-
-    //
-    // Reload the Timer
-    //
-
-    // Get current counter value
-    CurrentValue = ArmGenericTimerGetSystemCount ();
-    // Get the counter value to compare with
-    CompareValue = ArmGenericTimerGetCompareVal ();
-
-    // This loop is needed in case we missed interrupts (eg: case when the interrupt handling
-    // has taken longer than mTickPeriod).
-    // Note: Physical Counter is counting up
-    mElapsedPeriod = 0;
-    do {
-      CompareValue += mTimerTicks;
-      mElapsedPeriod++;
-    } while (CompareValue < CurrentValue);
-
-    // Set next compare value
-    ArmGenericTimerSetCompareVal (CompareValue);
-    ArmGenericTimerEnableTimer ();
   }
 
   // Enable timer interrupts
@@ -380,6 +653,11 @@ TimerInitialize (
   Status = gBS->LocateProtocol (&gHardwareInterruptProtocolGuid, NULL, (VOID **)&gInterrupt);
   ASSERT_EFI_ERROR (Status);
 
+  mTimerFrequency = (UINT32)ArmGenericTimerGetTimerFreq ();
+  ASSERT (mTimerFrequency != 0);
+  mTicklessRequested = FeaturePcdGet (PcdArmArchTimerTickless);
+  mStatisticsStart = ArmGenericTimerGetSystemCount ();
+
   // Disable the timer
   TimerCtrlReg = ArmGenericTimerGetTimerCtrlReg ();
   TimerCtrlReg |= ARM_ARCH_TIMER_IMASK;
@@ -408,9 +686,10 @@ TimerInitialize (
   Status = TimerDriverSetTimerPeriod (&gTimer, FixedPcdGet32(PcdTimerPeriod)); // TIMER_DEFAULT_PERIOD
   ASSERT_EFI_ERROR (Status);
 
-  // Install the Timer Architectural Protocol onto a new handle
+  // Install the Timer Architectural Protocol and its tickless companion onto a new handle
   Status = gBS->InstallMultipleProtocolInterfaces(
                   &Handle,
+                  &gEdkiiTicklessTimerProtocolGuid, &gTicklessTimer,
                   &gEfiTimerArchProtocolGuid,      &gTimer,
                   NULL
                   );
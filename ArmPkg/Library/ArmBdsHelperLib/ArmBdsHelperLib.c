@@ -87,6 +87,59 @@ BdsIsRemovableUsb (
            (DevicePathSubType (DevicePath) == MSG_USB_WWID_DP)));
 }
 
+/**
+  Checks a USB device against a USB Class device path node. The class is the one
+  of the interface unless the device descriptor gives it, and 0xFFFF and 0xFF
+  match any value.
+**/
+STATIC
+BOOLEAN
+BdsMatchUsbClass (
+  IN  USB_CLASS_DEVICE_PATH*  UsbClassDevicePath,
+  IN  EFI_HANDLE              UsbIoHandle
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_USB_IO_PROTOCOL           *UsbIo;
+  EFI_USB_DEVICE_DESCRIPTOR     DeviceDescriptor;
+  EFI_USB_INTERFACE_DESCRIPTOR  InterfaceDescriptor;
+  UINT8                         DeviceClass;
+  UINT8                         DeviceSubClass;
+  UINT8                         DeviceProtocol;
+
+  Status = gBS->HandleProtocol (UsbIoHandle, &gEfiUsbIoProtocolGuid, (VOID **) &UsbIo);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  Status = UsbIo->UsbGetDeviceDescriptor (UsbIo, &DeviceDescriptor);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  if (((UsbClassDevicePath->VendorId != 0xFFFF) && (UsbClassDevicePath->VendorId != DeviceDescriptor.IdVendor)) ||
+      ((UsbClassDevicePath->ProductId != 0xFFFF) && (UsbClassDevicePath->ProductId != DeviceDescriptor.IdProduct))) {
+    return FALSE;
+  }
+
+  DeviceClass    = DeviceDescriptor.DeviceClass;
+  DeviceSubClass = DeviceDescriptor.DeviceSubClass;
+  DeviceProtocol = DeviceDescriptor.DeviceProtocol;
+  if (DeviceClass == 0) {
+    Status = UsbIo->UsbGetInterfaceDescriptor (UsbIo, &InterfaceDescriptor);
+    if (EFI_ERROR (Status)) {
+      return FALSE;
+    }
+    DeviceClass    = InterfaceDescriptor.InterfaceClass;
+    DeviceSubClass = InterfaceDescriptor.InterfaceSubClass;
+    DeviceProtocol = InterfaceDescriptor.InterfaceProtocol;
+  }
+
+  return (((UsbClassDevicePath->DeviceClass == 0xFF) || (UsbClassDevicePath->DeviceClass == DeviceClass)) &&
+          ((UsbClassDevicePath->DeviceSubClass == 0xFF) || (UsbClassDevicePath->DeviceSubClass == DeviceSubClass)) &&
+          ((UsbClassDevicePath->DeviceProtocol == 0xFF) || (UsbClassDevicePath->DeviceProtocol == DeviceProtocol)));
+}
+
 EFI_STATUS
 BdsGetDeviceUsb (
   IN  EFI_DEVICE_PATH*  RemovableDevicePath,
@@ -102,8 +155,6 @@ BdsGetDeviceUsb (
   EFI_DEVICE_PATH*              TmpDevicePath;
   USB_WWID_DEVICE_PATH*         WwidDevicePath1;
   USB_WWID_DEVICE_PATH*         WwidDevicePath2;
-  USB_CLASS_DEVICE_PATH*        UsbClassDevicePath1;
-  USB_CLASS_DEVICE_PATH*        UsbClassDevicePath2;
 
   // Get all the UsbIo handles
   UsbIoHandleCount = 0;
@@ -116,36 +167,32 @@ BdsGetDeviceUsb (
   for (Index = 0; Index < UsbIoHandleCount; Index++) {
     Status = gBS->HandleProtocol (UsbIoBuffer[Index], &gEfiDevicePathProtocolGuid, (VOID **) &UsbIoDevicePath);
     if (!EFI_ERROR (Status)) {
+      // The device paths of the USB devices have no USB Class node, the class
+      // is in their descriptors
+      if (DevicePathSubType (RemovableDevicePath) == MSG_USB_CLASS_DP) {
+        if (BdsMatchUsbClass ((USB_CLASS_DEVICE_PATH*)RemovableDevicePath, UsbIoBuffer[Index])) {
+          *DeviceHandle = UsbIoBuffer[Index];
+          // Add the additional original Device Path Nodes (eg: FilePath Device Path Node) to the new Device Path
+          *NewDevicePath = AppendDevicePath (UsbIoDevicePath, NextDevicePathNode (RemovableDevicePath));
+          return EFI_SUCCESS;
+        }
+        continue;
+      }
+
       TmpDevicePath = UsbIoDevicePath;
       while (!IsDevicePathEnd (TmpDevicePath)) {
-        // Check if the Device Path node is a USB Removable device Path node
-        if (BdsIsRemovableUsb (TmpDevicePath)) {
-          if (TmpDevicePath->SubType == MSG_USB_WWID_DP) {
-            WwidDevicePath1 = (USB_WWID_DEVICE_PATH*)RemovableDevicePath;
-            WwidDevicePath2 = (USB_WWID_DEVICE_PATH*)TmpDevicePath;
-            if ((WwidDevicePath1->VendorId == WwidDevicePath2->VendorId) &&
-                (WwidDevicePath1->ProductId == WwidDevicePath2->ProductId) &&
-                (CompareMem (WwidDevicePath1+1, WwidDevicePath2+1, DevicePathNodeLength(WwidDevicePath1)-sizeof (USB_WWID_DEVICE_PATH)) == 0))
-            {
-              *DeviceHandle = UsbIoBuffer[Index];
-              // Add the additional original Device Path Nodes (eg: FilePath Device Path Node) to the new Device Path
-              *NewDevicePath = AppendDevicePath (UsbIoDevicePath, NextDevicePathNode (RemovableDevicePath));
-              return EFI_SUCCESS;
-            }
-          } else {
-            UsbClassDevicePath1 = (USB_CLASS_DEVICE_PATH*)RemovableDevicePath;
-            UsbClassDevicePath2 = (USB_CLASS_DEVICE_PATH*)TmpDevicePath;
-            if ((UsbClassDevicePath1->VendorId != 0xFFFF) && (UsbClassDevicePath1->VendorId == UsbClassDevicePath2->VendorId) &&
-                (UsbClassDevicePath1->ProductId != 0xFFFF) && (UsbClassDevicePath1->ProductId == UsbClassDevicePath2->ProductId) &&
-                (UsbClassDevicePath1->DeviceClass != 0xFF) && (UsbClassDevicePath1->DeviceClass == UsbClassDevicePath2->DeviceClass) &&
-                (UsbClassDevicePath1->DeviceSubClass != 0xFF) && (UsbClassDevicePath1->DeviceSubClass == UsbClassDevicePath2->DeviceSubClass) &&
-                (UsbClassDevicePath1->DeviceProtocol != 0xFF) && (UsbClassDevicePath1->DeviceProtocol == UsbClassDevicePath2->DeviceProtocol))
-            {
-              *DeviceHandle = UsbIoBuffer[Index];
-              // Add the additional original Device Path Nodes (eg: FilePath Device Path Node) to the new Device Path
-              *NewDevicePath = AppendDevicePath (UsbIoDevicePath, NextDevicePathNode (RemovableDevicePath));
-              return EFI_SUCCESS;
-            }
+        // Check if the Device Path node is a USB WWID device Path node
+        if (IS_DEVICE_PATH_NODE (TmpDevicePath, MESSAGING_DEVICE_PATH, MSG_USB_WWID_DP)) {
+          WwidDevicePath1 = (USB_WWID_DEVICE_PATH*)RemovableDevicePath;
+          WwidDevicePath2 = (USB_WWID_DEVICE_PATH*)TmpDevicePath;
+          if ((WwidDevicePath1->VendorId == WwidDevicePath2->VendorId) &&
+              (WwidDevicePath1->ProductId == WwidDevicePath2->ProductId) &&
+              (CompareMem (WwidDevicePath1+1, WwidDevicePath2+1, DevicePathNodeLength(WwidDevicePath1)-sizeof (USB_WWID_DEVICE_PATH)) == 0))
+          {
+            *DeviceHandle = UsbIoBuffer[Index];
+            // Add the additional original Device Path Nodes (eg: FilePath Device Path Node) to the new Device Path
+            *NewDevicePath = AppendDevicePath (UsbIoDevicePath, NextDevicePathNode (RemovableDevicePath));
+            return EFI_SUCCESS;
           }
         }
         TmpDevicePath = NextDevicePathNode (TmpDevicePath);
@@ -81,6 +81,12 @@ PopulateLevel2PageTable (
       break;
   }
 
+  // On MP cores the cacheable memory is shared with the secondary cores once they
+  // are woken up to run code with their MMU on, it must be coherent between them
+  if (ArmIsMpCore () && (PageAttributes == TT_DESCRIPTOR_PAGE_WRITE_BACK)) {
+    PageAttributes |= TT_DESCRIPTOR_PAGE_S_SHARED;
+  }
+
   // Check if the Section Entry has already been populated. Otherwise attach a
   // Level 2 Translation Table to it
   if (*SectionEntry != 0) {
@@ -179,6 +185,12 @@ FillTranslationTable (
       break;
   }
 
+  if (ArmIsMpCore () &&
+      ((MemoryRegion->Attributes == ARM_MEMORY_REGION_ATTRIBUTE_WRITE_BACK) ||
+       (MemoryRegion->Attributes == ARM_MEMORY_REGION_ATTRIBUTE_NONSECURE_WRITE_BACK))) {
+    Attributes |= TT_DESCRIPTOR_SECTION_S_SHARED;
+  }
+
   // Get the first section entry for this mapping
   SectionEntry    = TRANSLATION_TABLE_ENTRY_FOR_VIRTUAL_ADDRESS(TranslationTable, MemoryRegion->VirtualBase);
 
@@ -258,6 +270,9 @@ ArmConfigureMmu (
   } else if ((TranslationTableAttribute == ARM_MEMORY_REGION_ATTRIBUTE_WRITE_BACK) ||
       (TranslationTableAttribute == ARM_MEMORY_REGION_ATTRIBUTE_NONSECURE_WRITE_BACK)) {
     TTBRAttributes = TTBR_WRITE_BACK_ALLOC;
+    if (ArmIsMpCore ()) {
+      TTBRAttributes |= TTBR_SHAREABLE;
+    }
   } else if ((TranslationTableAttribute == ARM_MEMORY_REGION_ATTRIBUTE_WRITE_THROUGH) ||
       (TranslationTableAttribute == ARM_MEMORY_REGION_ATTRIBUTE_NONSECURE_WRITE_THROUGH)) {
     TTBRAttributes = TTBR_WRITE_THROUGH_NO_ALLOC;
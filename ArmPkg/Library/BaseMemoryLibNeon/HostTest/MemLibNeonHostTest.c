@@ -0,0 +1,599 @@
+/** @file
+  Host-run correctness suite of BaseMemoryLibNeon.
+
+  Every entry point of the library is checked against a byte-wise reference
+  across all the relative alignments of its buffers within a vector, all the
+  lengths up to MAX_LENGTH and, where it matters, every position of the
+  difference or of the value searched for. Each buffer is surrounded by guard
+  bytes that must come back untouched.
+
+  Built and run with "make" from this directory, see the Makefile.
+
+  Copyright (c) Microsoft Corporation. All rights reserved.<BR>
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Base.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+//
+// Lengths checked, past the NEON_MIN_LENGTH threshold of the library and
+// over several unrolled iterations of its loops
+//
+#define MAX_LENGTH      300
+#define ALIGNMENTS      16
+#define GUARD_SIZE      64
+#define GUARD_BYTE      0xA5
+#define OVERLAP_MAX     48
+
+#define ARENA_SIZE      (GUARD_SIZE + ALIGNMENTS + OVERLAP_MAX + MAX_LENGTH + OVERLAP_MAX + GUARD_SIZE)
+
+STATIC UINT8  mArena[ARENA_SIZE] __attribute__ ((aligned (16)));
+STATIC UINT8  mSource[ARENA_SIZE] __attribute__ ((aligned (16)));
+STATIC UINT8  mExpected[ARENA_SIZE] __attribute__ ((aligned (16)));
+
+STATIC UINT64 mCases;
+STATIC UINT64 mFailures;
+
+//
+// The DebugLib and BaseLib functions the library calls
+//
+
+VOID
+EFIAPI
+DebugAssert (
+  IN CONST CHAR8  *FileName,
+  IN UINTN        LineNumber,
+  IN CONST CHAR8  *Description
+  )
+{
+  fprintf (stderr, "ASSERT %s(%u): %s\n", FileName, (unsigned) LineNumber, Description);
+  abort ();
+}
+
+VOID
+EFIAPI
+DebugPrint (
+  IN  UINTN        ErrorLevel,
+  IN  CONST CHAR8  *Format,
+  ...
+  )
+{
+}
+
+BOOLEAN
+EFIAPI
+DebugAssertEnabled (
+  VOID
+  )
+{
+  return TRUE;
+}
+
+BOOLEAN
+EFIAPI
+DebugPrintEnabled (
+  VOID
+  )
+{
+  return FALSE;
+}
+
+BOOLEAN
+EFIAPI
+DebugCodeEnabled (
+  VOID
+  )
+{
+  return FALSE;
+}
+
+BOOLEAN
+EFIAPI
+DebugClearMemoryEnabled (
+  VOID
+  )
+{
+  return FALSE;
+}
+
+BOOLEAN
+EFIAPI
+DebugPrintLevelEnabled (
+  IN  CONST UINTN        ErrorLevel
+  )
+{
+  return FALSE;
+}
+
+VOID *
+EFIAPI
+DebugClearMemory (
+  OUT VOID  *Buffer,
+  IN UINTN  Length
+  )
+{
+  return Buffer;
+}
+
+UINT64
+EFIAPI
+ReadUnaligned64 (
+  IN CONST UINT64  *Buffer
+  )
+{
+  UINT64  Value;
+
+  __builtin_memcpy (&Value, Buffer, sizeof (Value));
+  return Value;
+}
+
+UINT64
+EFIAPI
+WriteUnaligned64 (
+  OUT UINT64  *Buffer,
+  IN  UINT64  Value
+  )
+{
+  __builtin_memcpy (Buffer, &Value, sizeof (Value));
+  return Value;
+}
+
+//
+// Helpers
+//
+
+STATIC
+VOID
+Fail (
+  IN CONST CHAR8  *Test,
+  IN UINTN        Alignment1,
+  IN UINTN        Alignment2,
+  IN UINTN        Length,
+  IN UINTN        Extra
+  )
+{
+  mFailures++;
+  if (mFailures <= 20) {
+    printf (
+      "FAIL %s: alignments %u/%u, length %u, %u\n",
+      Test,
+      (unsigned) Alignment1,
+      (unsigned) Alignment2,
+      (unsigned) Length,
+      (unsigned) Extra
+      );
+  }
+}
+
+STATIC
+VOID
+FillPattern (
+  OUT UINT8  *Buffer,
+  IN  UINTN  Length,
+  IN  UINTN  Seed
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Length; Index++) {
+    Buffer[Index] = (UINT8) ((Index + Seed) * 131 + 7);
+  }
+}
+
+STATIC
+BOOLEAN
+ArenaMatches (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < ARENA_SIZE; Index++) {
+    if (mArena[Index] != mExpected[Index]) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+STATIC
+VOID
+ResetArena (
+  VOID
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < ARENA_SIZE; Index++) {
+    mArena[Index]    = GUARD_BYTE;
+    mExpected[Index] = GUARD_BYTE;
+  }
+}
+
+//
+// Tests
+//
+
+STATIC
+VOID
+TestCopyMem (
+  VOID
+  )
+{
+  UINTN  DestinationAlignment;
+  UINTN  SourceAlignment;
+  UINTN  Length;
+  UINTN  Index;
+  UINT8  *Destination;
+  VOID   *Result;
+
+  FillPattern (mSource, ARENA_SIZE, 0);
+
+  for (DestinationAlignment = 0; DestinationAlignment < ALIGNMENTS; DestinationAlignment++) {
+    for (SourceAlignment = 0; SourceAlignment < ALIGNMENTS; SourceAlignment++) {
+      for (Length = 0; Length <= MAX_LENGTH; Length++) {
+        ResetArena ();
+        Destination = mArena + GUARD_SIZE + DestinationAlignment;
+        for (Index = 0; Index < Length; Index++) {
+          mExpected[GUARD_SIZE + DestinationAlignment + Index] = mSource[GUARD_SIZE + SourceAlignment + Index];
+        }
+
+        Result = CopyMem (Destination, mSource + GUARD_SIZE + SourceAlignment, Length);
+        mCases++;
+        if (Result != Destination || !ArenaMatches ()) {
+          Fail ("CopyMem", DestinationAlignment, SourceAlignment, Length, 0);
+        }
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+TestCopyMemOverlap (
+  VOID
+  )
+{
+  UINTN  Alignment;
+  UINTN  Length;
+  INTN   Distance;
+  UINTN  Index;
+  UINT8  *Source;
+  UINT8  *Destination;
+  VOID   *Result;
+
+  for (Alignment = 0; Alignment < ALIGNMENTS; Alignment++) {
+    for (Distance = -OVERLAP_MAX; Distance <= OVERLAP_MAX; Distance++) {
+      if (Distance == 0) {
+        continue;
+      }
+      for (Length = 0; Length <= MAX_LENGTH; Length++) {
+        //
+        // Both buffers lie within the arena, between the guards
+        //
+        Source      = mArena + GUARD_SIZE + OVERLAP_MAX + Alignment;
+        Destination = Source + Distance;
+
+        FillPattern (mArena, ARENA_SIZE, Length);
+        for (Index = 0; Index < GUARD_SIZE; Index++) {
+          mArena[Index] = GUARD_BYTE;
+          mArena[ARENA_SIZE - 1 - Index] = GUARD_BYTE;
+        }
+        __builtin_memcpy (mExpected, mArena, ARENA_SIZE);
+        __builtin_memmove (mExpected + (Destination - mArena), mExpected + (Source - mArena), Length);
+
+        Result = CopyMem (Destination, Source, Length);
+        mCases++;
+        if (Result != Destination || !ArenaMatches ()) {
+          Fail ("CopyMem overlapping", Alignment, (UINTN) (Alignment + Distance) % ALIGNMENTS, Length, (UINTN) Distance);
+        }
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+TestSetMem (
+  VOID
+  )
+{
+  STATIC CONST UINT8  Values[] = { 0x00, 0x5A, 0xFF };
+  UINTN               Alignment;
+  UINTN               Length;
+  UINTN               Value;
+  UINTN               Index;
+  UINT8               *Buffer;
+  VOID                *Result;
+
+  for (Value = 0; Value < sizeof (Values) / sizeof (Values[0]); Value++) {
+    for (Alignment = 0; Alignment < ALIGNMENTS; Alignment++) {
+      for (Length = 0; Length <= MAX_LENGTH; Length++) {
+        ResetArena ();
+        Buffer = mArena + GUARD_SIZE + Alignment;
+        for (Index = 0; Index < Length; Index++) {
+          mExpected[GUARD_SIZE + Alignment + Index] = Values[Value];
+        }
+
+        Result = SetMem (Buffer, Length, Values[Value]);
+        mCases++;
+        if (Result != Buffer || !ArenaMatches ()) {
+          Fail ("SetMem", Alignment, 0, Length, Values[Value]);
+        }
+
+        ResetArena ();
+        for (Index = 0; Index < Length; Index++) {
+          mExpected[GUARD_SIZE + Alignment + Index] = 0;
+        }
+
+        Result = ZeroMem (Buffer, Length);
+        mCases++;
+        if (Result != Buffer || !ArenaMatches ()) {
+          Fail ("ZeroMem", Alignment, 0, Length, 0);
+        }
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+TestSetMemN (
+  VOID
+  )
+{
+  UINTN   Size;
+  UINTN   Alignment;
+  UINTN   Count;
+  UINTN   Index;
+  UINT8   *Buffer;
+  UINT64  Value;
+  VOID    *Result;
+
+  Value = 0x0123456789ABCDEFULL;
+
+  for (Size = 2; Size <= 8; Size *= 2) {
+    //
+    // The buffers are aligned on the size of their elements
+    //
+    for (Alignment = 0; Alignment < ALIGNMENTS; Alignment += Size) {
+      for (Count = 0; Count <= MAX_LENGTH / Size; Count++) {
+        ResetArena ();
+        Buffer = mArena + GUARD_SIZE + Alignment;
+        for (Index = 0; Index < Count * Size; Index++) {
+          mExpected[GUARD_SIZE + Alignment + Index] = (UINT8) (Value >> (8 * (Index % Size)));
+        }
+
+        switch (Size) {
+        case 2:
+          Result = SetMem16 (Buffer, Count * Size, (UINT16) Value);
+          break;
+        case 4:
+          Result = SetMem32 (Buffer, Count * Size, (UINT32) Value);
+          break;
+        default:
+          Result = SetMem64 (Buffer, Count * Size, Value);
+          break;
+        }
+        mCases++;
+        if (Result != Buffer || !ArenaMatches ()) {
+          Fail (Size == 2 ? "SetMem16" : Size == 4 ? "SetMem32" : "SetMem64", Alignment, 0, Count * Size, 0);
+        }
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+TestCompareMem (
+  VOID
+  )
+{
+  UINTN  Alignment1;
+  UINTN  Alignment2;
+  UINTN  Length;
+  UINTN  Position;
+  UINT8  *Buffer1;
+  UINT8  *Buffer2;
+  INTN   Expected;
+  INTN   Result;
+
+  for (Alignment1 = 0; Alignment1 < ALIGNMENTS; Alignment1++) {
+    for (Alignment2 = 0; Alignment2 < ALIGNMENTS; Alignment2++) {
+      Buffer1 = mArena + GUARD_SIZE + Alignment1;
+      Buffer2 = mSource + GUARD_SIZE + Alignment2;
+      for (Length = 1; Length <= MAX_LENGTH; Length++) {
+        //
+        // Identical buffers, then a difference in the first, a middle and the
+        // last byte, in both directions
+        //
+        for (Position = 0; Position <= 6; Position++) {
+          FillPattern (Buffer1, Length, Length);
+          FillPattern (Buffer2, Length, Length);
+          Expected = 0;
+          if (Position > 0) {
+            UINTN  Offset;
+
+            Offset = (Position - 1) / 2 == 0 ? 0 : (Position - 1) / 2 == 1 ? Length / 2 : Length - 1;
+            Buffer1[Offset] = (Position % 2 == 0) ? 0x10 : 0xF0;
+            Buffer2[Offset] = 0x80;
+            Expected = (INTN) Buffer1[Offset] - (INTN) Buffer2[Offset];
+          }
+
+          Result = CompareMem (Buffer1, Buffer2, Length);
+          mCases++;
+          if (Result != Expected) {
+            Fail ("CompareMem", Alignment1, Alignment2, Length, Position);
+          }
+        }
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+TestScanMem8 (
+  VOID
+  )
+{
+  UINTN       Alignment;
+  UINTN       Length;
+  UINTN       Position;
+  UINT8       *Buffer;
+  CONST VOID  *Result;
+
+  for (Alignment = 0; Alignment < ALIGNMENTS; Alignment++) {
+    Buffer = mArena + GUARD_SIZE + Alignment;
+    for (Length = 1; Length <= MAX_LENGTH; Length++) {
+      //
+      // The value at every position, then nowhere. The value also sits right
+      // past the end of the buffer, where it must not be found.
+      //
+      for (Position = 0; Position <= Length; Position++) {
+        SetMem (Buffer, Length + 1, 0x33);
+        Buffer[Length] = 0xC3;
+        if (Position < Length) {
+          Buffer[Position] = 0xC3;
+        }
+
+        Result = ScanMem8 (Buffer, Length, 0xC3);
+        mCases++;
+        if (Result != (Position < Length ? Buffer + Position : NULL)) {
+          Fail ("ScanMem8", Alignment, 0, Length, Position);
+        }
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+TestScanMemN (
+  VOID
+  )
+{
+  UINTN       Size;
+  UINTN       Alignment;
+  UINTN       Count;
+  UINTN       Position;
+  UINTN       Index;
+  UINT8       *Buffer;
+  UINT64      Value;
+  CONST VOID  *Result;
+  CONST VOID  *Expected;
+
+  Value = 0xFEDCBA9876543210ULL;
+
+  for (Size = 2; Size <= 8; Size *= 2) {
+    for (Alignment = 0; Alignment < ALIGNMENTS; Alignment += Size) {
+      Buffer = mArena + GUARD_SIZE + Alignment;
+      for (Count = 1; Count <= MAX_LENGTH / Size; Count++) {
+        for (Position = 0; Position <= Count; Position++) {
+          //
+          // The other elements only differ from the value in their last byte,
+          // so that a partial match can't be taken for a whole one
+          //
+          for (Index = 0; Index <= Count; Index++) {
+            __builtin_memcpy (Buffer + Index * Size, &Value, Size);
+            Buffer[Index * Size + Size - 1] ^= 0x01;
+          }
+          __builtin_memcpy (Buffer + Count * Size, &Value, Size);
+          if (Position < Count) {
+            __builtin_memcpy (Buffer + Position * Size, &Value, Size);
+          }
+          Expected = (Position < Count) ? Buffer + Position * Size : NULL;
+
+          switch (Size) {
+          case 2:
+            Result = ScanMem16 (Buffer, Count * Size, (UINT16) Value);
+            break;
+          case 4:
+            Result = ScanMem32 (Buffer, Count * Size, (UINT32) Value);
+            break;
+          default:
+            Result = ScanMem64 (Buffer, Count * Size, Value);
+            break;
+          }
+          mCases++;
+          if (Result != Expected) {
+            Fail (Size == 2 ? "ScanMem16" : Size == 4 ? "ScanMem32" : "ScanMem64", Alignment, 0, Count * Size, Position);
+          }
+        }
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+TestGuids (
+  VOID
+  )
+{
+  UINTN  Alignment1;
+  UINTN  Alignment2;
+  UINTN  Position;
+  GUID   *Guid1;
+  GUID   *Guid2;
+
+  for (Alignment1 = 0; Alignment1 < ALIGNMENTS; Alignment1++) {
+    for (Alignment2 = 0; Alignment2 < ALIGNMENTS; Alignment2++) {
+      Guid1 = (GUID *) (mArena + GUARD_SIZE + Alignment1);
+      Guid2 = (GUID *) (mSource + GUARD_SIZE + Alignment2);
+      for (Position = 0; Position <= sizeof (GUID); Position++) {
+        ResetArena ();
+        FillPattern ((UINT8 *) Guid2, sizeof (GUID), Position);
+        __builtin_memcpy (mExpected + GUARD_SIZE + Alignment1, Guid2, sizeof (GUID));
+
+        CopyGuid (Guid1, Guid2);
+        mCases++;
+        if (!ArenaMatches ()) {
+          Fail ("CopyGuid", Alignment1, Alignment2, sizeof (GUID), 0);
+        }
+
+        if (Position < sizeof (GUID)) {
+          ((UINT8 *) Guid1)[Position] ^= 0x40;
+        }
+        mCases++;
+        if (CompareGuid (Guid1, Guid2) != (Position == sizeof (GUID))) {
+          Fail ("CompareGuid", Alignment1, Alignment2, sizeof (GUID), Position);
+        }
+      }
+    }
+  }
+}
+
+int
+main (
+  int   Argc,
+  char  **Argv
+  )
+{
+  TestCopyMem ();
+  TestCopyMemOverlap ();
+  TestSetMem ();
+  TestSetMemN ();
+  TestCompareMem ();
+  TestScanMem8 ();
+  TestScanMemN ();
+  TestGuids ();
+
+  printf ("%llu cases, %llu failures\n", (unsigned long long) mCases, (unsigned long long) mFailures);
+  return mFailures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,807 @@
+/** @file
+  CopyMem(), SetMem(), CompareMem() and ScanMem() workers using the NEON unit.
+
+  The workers are written with the GCC vector extensions, which the ARM and
+  AArch64 compilers turn into NEON code. Every vector access is a 16-byte
+  aligned one, so it never takes an alignment fault nor crosses a page, even
+  when the buffers are not aligned. Such an access may read a few bytes that
+  share an aligned block with the buffer, but it never writes outside of it.
+  A source that is not aligned like its destination is read one aligned block
+  at a time and realigned with VEXT.
+
+  Copyright (c) Microsoft Corporation. All rights reserved.<BR>
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "MemLibInternals.h"
+
+typedef UINT8   NEON_U8   __attribute__ ((vector_size (16)));
+typedef UINT16  NEON_U16  __attribute__ ((vector_size (16)));
+typedef UINT32  NEON_U32  __attribute__ ((vector_size (16)));
+typedef UINT64  NEON_U64  __attribute__ ((vector_size (16)));
+
+#define NEON_SIZE                   16
+#define NEON_MASK                   (NEON_SIZE - 1)
+#define NEON_IS_ALIGNED(Address)    (((UINTN)(Address) & NEON_MASK) == 0)
+
+//
+// Shorter buffers are handled one element at a time, aligning them first
+// would cost more than what the vectors save
+//
+#define NEON_MIN_LENGTH             64
+
+//
+// Bytes Shift to Shift + 15 of Low followed by High. Shift must be a constant,
+// this is a single VEXT (EXT on AArch64).
+//
+#define NEON_EXTRACT(Low, High, Shift)                                      \
+  __builtin_shuffle ((Low), (High), (NEON_U8) {                             \
+    (Shift) + 0,  (Shift) + 1,  (Shift) + 2,  (Shift) + 3,                  \
+    (Shift) + 4,  (Shift) + 5,  (Shift) + 6,  (Shift) + 7,                  \
+    (Shift) + 8,  (Shift) + 9,  (Shift) + 10, (Shift) + 11,                 \
+    (Shift) + 12, (Shift) + 13, (Shift) + 14, (Shift) + 15 })
+
+//
+// Runs Loop (Shift) with Shift turned into a constant, Shift is 1 to 15
+//
+#define NEON_FOR_EACH_SHIFT(Shift, Loop)                                    \
+  switch (Shift) {                                                          \
+  case 1:  Loop (1);  break;                                                \
+  case 2:  Loop (2);  break;                                                \
+  case 3:  Loop (3);  break;                                                \
+  case 4:  Loop (4);  break;                                                \
+  case 5:  Loop (5);  break;                                                \
+  case 6:  Loop (6);  break;                                                \
+  case 7:  Loop (7);  break;                                                \
+  case 8:  Loop (8);  break;                                                \
+  case 9:  Loop (9);  break;                                                \
+  case 10: Loop (10); break;                                                \
+  case 11: Loop (11); break;                                                \
+  case 12: Loop (12); break;                                                \
+  case 13: Loop (13); break;                                                \
+  case 14: Loop (14); break;                                                \
+  default: Loop (15); break;                                                \
+  }
+
+/**
+  Tells whether any bit of a vector is set.
+
+  @param  Vector  The vector to test, typically the result of a comparison.
+
+  @retval TRUE    At least one bit is set.
+  @retval FALSE   The vector is all zeros.
+
+**/
+STATIC
+BOOLEAN
+NeonAnySet (
+  IN  NEON_U64  Vector
+  )
+{
+  return (Vector[0] | Vector[1]) != 0;
+}
+
+/**
+  Fills 16-byte aligned whole vectors with a pattern.
+
+  @param  Buffer  The buffer to fill, 16-byte aligned.
+  @param  Count   Number of vectors to fill.
+  @param  Pattern The pattern to fill the vectors with.
+
+**/
+STATIC
+VOID
+NeonFill (
+  OUT NEON_U64  *Buffer,
+  IN  UINTN     Count,
+  IN  NEON_U64  Pattern
+  )
+{
+  for (; Count >= 4; Count -= 4) {
+    Buffer[0] = Pattern;
+    Buffer[1] = Pattern;
+    Buffer[2] = Pattern;
+    Buffer[3] = Pattern;
+    Buffer += 4;
+  }
+  for (; Count > 0; Count--) {
+    *Buffer++ = Pattern;
+  }
+}
+
+/**
+  Copies a buffer from the lowest address to the highest one, which is safe
+  when the destination is below the source.
+
+  @param  Destination Target of copy
+  @param  Source      Place to copy from
+  @param  Length      Number of bytes to copy, at least NEON_MIN_LENGTH
+
+**/
+STATIC
+VOID
+NeonCopyForward (
+  OUT UINT8         *Destination,
+  IN  CONST UINT8   *Source,
+  IN  UINTN         Length
+  )
+{
+  NEON_U8           *Dst;
+  CONST NEON_U8     *Src;
+  NEON_U8           V0;
+  NEON_U8           V1;
+  NEON_U8           V2;
+  NEON_U8           V3;
+  NEON_U8           Low;
+  NEON_U8           High;
+  UINTN             Count;
+  UINTN             Shift;
+
+  while (!NEON_IS_ALIGNED (Destination)) {
+    *Destination++ = *Source++;
+    Length--;
+  }
+
+  Dst   = (NEON_U8 *)Destination;
+  Count = Length / NEON_SIZE;
+  Shift = (UINTN)Source & NEON_MASK;
+  Src   = (CONST NEON_U8 *)(Source - Shift);
+
+  Destination += Length & ~NEON_MASK;
+  Source      += Length & ~NEON_MASK;
+  Length      &= NEON_MASK;
+
+  if (Shift == 0) {
+    //
+    // All the loads of a block come before its stores, the buffers may overlap
+    //
+    for (; Count >= 4; Count -= 4) {
+      V0 = Src[0];
+      V1 = Src[1];
+      V2 = Src[2];
+      V3 = Src[3];
+      Dst[0] = V0;
+      Dst[1] = V1;
+      Dst[2] = V2;
+      Dst[3] = V3;
+      Src += 4;
+      Dst += 4;
+    }
+    for (; Count > 0; Count--) {
+      *Dst++ = *Src++;
+    }
+  } else {
+#define NEON_COPY_FORWARD(S)                                                \
+    for (Low = *Src++; Count > 0; Count--) {                                \
+      High   = *Src++;                                                      \
+      *Dst++ = NEON_EXTRACT (Low, High, S);                                 \
+      Low    = High;                                                        \
+    }
+
+    NEON_FOR_EACH_SHIFT (Shift, NEON_COPY_FORWARD);
+
+#undef NEON_COPY_FORWARD
+  }
+
+  while (Length-- != 0) {
+    *Destination++ = *Source++;
+  }
+}
+
+/**
+  Copies a buffer from the highest address to the lowest one, which is safe
+  when the destination is above the source.
+
+  @param  Destination Target of copy
+  @param  Source      Place to copy from
+  @param  Length      Number of bytes to copy, at least NEON_MIN_LENGTH
+
+**/
+STATIC
+VOID
+NeonCopyBackward (
+  OUT UINT8         *Destination,
+  IN  CONST UINT8   *Source,
+  IN  UINTN         Length
+  )
+{
+  NEON_U8           *Dst;
+  CONST NEON_U8     *Src;
+  NEON_U8           V0;
+  NEON_U8           V1;
+  NEON_U8           V2;
+  NEON_U8           V3;
+  NEON_U8           Low;
+  NEON_U8           High;
+  UINTN             Count;
+  UINTN             Shift;
+
+  Destination += Length;
+  Source      += Length;
+
+  while (!NEON_IS_ALIGNED (Destination)) {
+    *--Destination = *--Source;
+    Length--;
+  }
+
+  Dst   = (NEON_U8 *)Destination;
+  Count = Length / NEON_SIZE;
+  Shift = (UINTN)Source & NEON_MASK;
+  Src   = (CONST NEON_U8 *)(Source - Shift);
+
+  Destination -= Length & ~NEON_MASK;
+  Source      -= Length & ~NEON_MASK;
+  Length      &= NEON_MASK;
+
+  if (Shift == 0) {
+    for (; Count >= 4; Count -= 4) {
+      Src -= 4;
+      Dst -= 4;
+      V3 = Src[3];
+      V2 = Src[2];
+      V1 = Src[1];
+      V0 = Src[0];
+      Dst[3] = V3;
+      Dst[2] = V2;
+      Dst[1] = V1;
+      Dst[0] = V0;
+    }
+    for (; Count > 0; Count--) {
+      *--Dst = *--Src;
+    }
+  } else {
+#define NEON_COPY_BACKWARD(S)                                               \
+    for (High = *Src; Count > 0; Count--) {                                 \
+      Low    = *--Src;                                                      \
+      *--Dst = NEON_EXTRACT (Low, High, S);                                 \
+      High   = Low;                                                         \
+    }
+
+    NEON_FOR_EACH_SHIFT (Shift, NEON_COPY_BACKWARD);
+
+#undef NEON_COPY_BACKWARD
+  }
+
+  while (Length-- != 0) {
+    *--Destination = *--Source;
+  }
+}
+
+/**
+  Copy Length bytes from Source to Destination.
+
+  @param  DestinationBuffer Target of copy
+  @param  SourceBuffer      Place to copy from
+  @param  Length            Number of bytes to copy
+
+  @return Destination
+
+**/
+VOID *
+EFIAPI
+InternalMemCopyMem (
+  OUT     VOID                      *DestinationBuffer,
+  IN      CONST VOID                *SourceBuffer,
+  IN      UINTN                     Length
+  )
+{
+  UINT8                             *Destination8;
+  CONST UINT8                       *Source8;
+  BOOLEAN                           Forward;
+
+  Destination8 = (UINT8 *)DestinationBuffer;
+  Source8      = (CONST UINT8 *)SourceBuffer;
+  Forward      = (Source8 > Destination8) || (Source8 + Length <= Destination8);
+
+  if (Length >= NEON_MIN_LENGTH) {
+    if (Forward) {
+      NeonCopyForward (Destination8, Source8, Length);
+    } else {
+      NeonCopyBackward (Destination8, Source8, Length);
+    }
+  } else if (Forward) {
+    while (Length-- != 0) {
+      *(Destination8++) = *(Source8++);
+    }
+  } else {
+    while (Length-- != 0) {
+      Destination8[Length] = Source8[Length];
+    }
+  }
+
+  return DestinationBuffer;
+}
+
+/**
+  Set Buffer to Value for Size bytes.
+
+  @param  Buffer   Memory to set.
+  @param  Length   Number of bytes to set
+  @param  Value    Value of the set operation.
+
+  @return Buffer
+
+**/
+VOID *
+EFIAPI
+InternalMemSetMem (
+  OUT     VOID                      *Buffer,
+  IN      UINTN                     Length,
+  IN      UINT8                     Value
+  )
+{
+  UINT8                             *Pointer;
+  UINT64                            Value64;
+
+  Pointer = (UINT8 *)Buffer;
+  if (Length >= NEON_MIN_LENGTH) {
+    while (!NEON_IS_ALIGNED (Pointer)) {
+      *(Pointer++) = Value;
+      Length--;
+    }
+
+    Value64 = Value * 0x0101010101010101ULL;
+    NeonFill ((NEON_U64 *)Pointer, Length / NEON_SIZE, (NEON_U64) { Value64, Value64 });
+    Pointer += Length & ~NEON_MASK;
+    Length  &= NEON_MASK;
+  }
+
+  while (Length-- != 0) {
+    *(Pointer++) = Value;
+  }
+
+  return Buffer;
+}
+
+/**
+  Fills a target buffer with a 16-bit value, and returns the target buffer.
+
+  @param  Buffer  Pointer to the target buffer to fill.
+  @param  Length  Count of 16-bit value to fill.
+  @param  Value   Value with which to fill Length bytes of Buffer.
+
+  @return Buffer
+
+**/
+VOID *
+EFIAPI
+InternalMemSetMem16 (
+  OUT     VOID                      *Buffer,
+  IN      UINTN                     Length,
+  IN      UINT16                    Value
+  )
+{
+  UINT16                            *Pointer;
+  UINT64                            Value64;
+
+  Pointer = (UINT16 *)Buffer;
+  if (Length >= NEON_MIN_LENGTH / sizeof (UINT16)) {
+    while (!NEON_IS_ALIGNED (Pointer)) {
+      *(Pointer++) = Value;
+      Length--;
+    }
+
+    Value64 = Value * 0x0001000100010001ULL;
+    NeonFill ((NEON_U64 *)Pointer, Length / (NEON_SIZE / sizeof (UINT16)), (NEON_U64) { Value64, Value64 });
+    Pointer += Length & ~(NEON_SIZE / sizeof (UINT16) - 1);
+    Length  &= NEON_SIZE / sizeof (UINT16) - 1;
+  }
+
+  while (Length-- != 0) {
+    *(Pointer++) = Value;
+  }
+
+  return Buffer;
+}
+
+/**
+  Fills a target buffer with a 32-bit value, and returns the target buffer.
+
+  @param  Buffer  Pointer to the target buffer to fill.
+  @param  Length  Count of 32-bit value to fill.
+  @param  Value   Value with which to fill Length bytes of Buffer.
+
+  @return Buffer
+
+**/
+VOID *
+EFIAPI
+InternalMemSetMem32 (
+  OUT     VOID                      *Buffer,
+  IN      UINTN                     Length,
+  IN      UINT32                    Value
+  )
+{
+  UINT32                            *Pointer;
+  UINT64                            Value64;
+
+  Pointer = (UINT32 *)Buffer;
+  if (Length >= NEON_MIN_LENGTH / sizeof (UINT32)) {
+    while (!NEON_IS_ALIGNED (Pointer)) {
+      *(Pointer++) = Value;
+      Length--;
+    }
+
+    Value64 = Value * 0x0000000100000001ULL;
+    NeonFill ((NEON_U64 *)Pointer, Length / (NEON_SIZE / sizeof (UINT32)), (NEON_U64) { Value64, Value64 });
+    Pointer += Length & ~(NEON_SIZE / sizeof (UINT32) - 1);
+    Length  &= NEON_SIZE / sizeof (UINT32) - 1;
+  }
+
+  while (Length-- != 0) {
+    *(Pointer++) = Value;
+  }
+
+  return Buffer;
+}
+
+/**
+  Fills a target buffer with a 64-bit value, and returns the target buffer.
+
+  @param  Buffer  Pointer to the target buffer to fill.
+  @param  Length  Count of 64-bit value to fill.
+  @param  Value   Value with which to fill Length bytes of Buffer.
+
+  @return Buffer
+
+**/
+VOID *
+EFIAPI
+InternalMemSetMem64 (
+  OUT     VOID                      *Buffer,
+  IN      UINTN                     Length,
+  IN      UINT64                    Value
+  )
+{
+  UINT64                            *Pointer;
+
+  Pointer = (UINT64 *)Buffer;
+  if (Length >= NEON_MIN_LENGTH / sizeof (UINT64)) {
+    if (!NEON_IS_ALIGNED (Pointer)) {
+      *(Pointer++) = Value;
+      Length--;
+    }
+
+    NeonFill ((NEON_U64 *)Pointer, Length / (NEON_SIZE / sizeof (UINT64)), (NEON_U64) { Value, Value });
+    Pointer += Length & ~(NEON_SIZE / sizeof (UINT64) - 1);
+    Length  &= NEON_SIZE / sizeof (UINT64) - 1;
+  }
+
+  while (Length-- != 0) {
+    *(Pointer++) = Value;
+  }
+
+  return Buffer;
+}
+
+/**
+  Set Buffer to 0 for Size bytes.
+
+  @param  Buffer Memory to set.
+  @param  Length Number of bytes to set
+
+  @return Buffer
+
+**/
+VOID *
+EFIAPI
+InternalMemZeroMem (
+  OUT     VOID                      *Buffer,
+  IN      UINTN                     Length
+  )
+{
+  return InternalMemSetMem (Buffer, Length, 0);
+}
+
+/**
+  Compares two memory buffers of a given length.
+
+  @param  DestinationBuffer First memory buffer
+  @param  SourceBuffer      Second memory buffer
+  @param  Length            Length of DestinationBuffer and SourceBuffer memory
+                            regions to compare. Must be non-zero.
+
+  @return 0                 All Length bytes of the two buffers are identical.
+  @retval Non-zero          The first mismatched byte in SourceBuffer subtracted from the first
+                            mismatched byte in DestinationBuffer.
+
+**/
+INTN
+EFIAPI
+InternalMemCompareMem (
+  IN      CONST VOID                *DestinationBuffer,
+  IN      CONST VOID                *SourceBuffer,
+  IN      UINTN                     Length
+  )
+{
+  CONST UINT8                       *Destination8;
+  CONST UINT8                       *Source8;
+  CONST NEON_U8                     *Dst;
+  CONST NEON_U8                     *Src;
+  NEON_U8                           Low;
+  NEON_U8                           High;
+  UINTN                             Count;
+  UINTN                             Shift;
+
+  Destination8 = (CONST UINT8 *)DestinationBuffer;
+  Source8      = (CONST UINT8 *)SourceBuffer;
+
+  if (Length >= NEON_MIN_LENGTH) {
+    while (!NEON_IS_ALIGNED (Destination8)) {
+      if (*Destination8 != *Source8) {
+        return (INTN)*Destination8 - (INTN)*Source8;
+      }
+      Destination8++;
+      Source8++;
+      Length--;
+    }
+
+    Dst   = (CONST NEON_U8 *)Destination8;
+    Count = Length / NEON_SIZE;
+    Shift = (UINTN)Source8 & NEON_MASK;
+    Src   = (CONST NEON_U8 *)(Source8 - Shift);
+
+    //
+    // Stop at the first block that differs, the byte loop below finds the
+    // mismatch in it
+    //
+    if (Shift == 0) {
+      for (; Count > 0; Count--) {
+        if (NeonAnySet ((NEON_U64)(*Dst ^ *Src))) {
+          break;
+        }
+        Dst++;
+        Src++;
+      }
+    } else {
+#define NEON_COMPARE(S)                                                     \
+      for (Low = *Src++; Count > 0; Count--) {                              \
+        High = *Src++;                                                      \
+        if (NeonAnySet ((NEON_U64)(*Dst ^ NEON_EXTRACT (Low, High, S)))) {  \
+          break;                                                            \
+        }                                                                   \
+        Dst++;                                                              \
+        Low = High;                                                         \
+      }
+
+      NEON_FOR_EACH_SHIFT (Shift, NEON_COMPARE);
+
+#undef NEON_COMPARE
+    }
+
+    Source8     += (CONST UINT8 *)Dst - Destination8;
+    Length      -= (CONST UINT8 *)Dst - Destination8;
+    Destination8 = (CONST UINT8 *)Dst;
+  }
+
+  for (; Length > 0; Length--) {
+    if (*Destination8 != *Source8) {
+      return (INTN)*Destination8 - (INTN)*Source8;
+    }
+    Destination8++;
+    Source8++;
+  }
+
+  return 0;
+}
+
+/**
+  Scans a target buffer for an 8-bit value, and returns a pointer to the
+  matching 8-bit value in the target buffer.
+
+  @param  Buffer  Pointer to the target buffer to scan.
+  @param  Length  Count of 8-bit value to scan. Must be non-zero.
+  @param  Value   Value to search for in the target buffer.
+
+  @return Pointer to the first occurrence or NULL if not found.
+
+**/
+CONST VOID *
+EFIAPI
+InternalMemScanMem8 (
+  IN      CONST VOID                *Buffer,
+  IN      UINTN                     Length,
+  IN      UINT8                     Value
+  )
+{
+  CONST UINT8                       *Pointer;
+  CONST NEON_U8                     *Vector;
+  NEON_U8                           Pattern;
+
+  Pointer = (CONST UINT8 *)Buffer;
+  if (Length >= NEON_MIN_LENGTH) {
+    while (!NEON_IS_ALIGNED (Pointer)) {
+      if (*Pointer == Value) {
+        return Pointer;
+      }
+      Pointer++;
+      Length--;
+    }
+
+    Pattern = (NEON_U8) { Value, Value, Value, Value, Value, Value, Value, Value,
+                          Value, Value, Value, Value, Value, Value, Value, Value };
+    for (Vector = (CONST NEON_U8 *)Pointer; Length >= NEON_SIZE; Length -= NEON_SIZE) {
+      if (NeonAnySet ((NEON_U64)(*Vector == Pattern))) {
+        break;
+      }
+      Vector++;
+    }
+    Pointer = (CONST UINT8 *)Vector;
+  }
+
+  for (; Length > 0; Length--) {
+    if (*Pointer == Value) {
+      return Pointer;
+    }
+    Pointer++;
+  }
+
+  return NULL;
+}
+
+/**
+  Scans a target buffer for a 16-bit value, and returns a pointer to the
+  matching 16-bit value in the target buffer.
+
+  @param  Buffer  Pointer to the target buffer to scan.
+  @param  Length  Count of 16-bit value to scan. Must be non-zero.
+  @param  Value   Value to search for in the target buffer.
+
+  @return Pointer to the first occurrence or NULL if not found.
+
+**/
+CONST VOID *
+EFIAPI
+InternalMemScanMem16 (
+  IN      CONST VOID                *Buffer,
+  IN      UINTN                     Length,
+  IN      UINT16                    Value
+  )
+{
+  CONST UINT16                      *Pointer;
+  CONST NEON_U16                    *Vector;
+  NEON_U16                          Pattern;
+
+  Pointer = (CONST UINT16 *)Buffer;
+  if (Length >= NEON_MIN_LENGTH / sizeof (UINT16)) {
+    while (!NEON_IS_ALIGNED (Pointer)) {
+      if (*Pointer == Value) {
+        return Pointer;
+      }
+      Pointer++;
+      Length--;
+    }
+
+    Pattern = (NEON_U16) { Value, Value, Value, Value, Value, Value, Value, Value };
+    for (Vector = (CONST NEON_U16 *)Pointer; Length >= NEON_SIZE / sizeof (UINT16); Length -= NEON_SIZE / sizeof (UINT16)) {
+      if (NeonAnySet ((NEON_U64)(*Vector == Pattern))) {
+        break;
+      }
+      Vector++;
+    }
+    Pointer = (CONST UINT16 *)Vector;
+  }
+
+  for (; Length > 0; Length--) {
+    if (*Pointer == Value) {
+      return Pointer;
+    }
+    Pointer++;
+  }
+
+  return NULL;
+}
+
+/**
+  Scans a target buffer for a 32-bit value, and returns a pointer to the
+  matching 32-bit value in the target buffer.
+
+  @param  Buffer  Pointer to the target buffer to scan.
+  @param  Length  Count of 32-bit value to scan. Must be non-zero.
+  @param  Value   Value to search for in the target buffer.
+
+  @return Pointer to the first occurrence or NULL if not found.
+
+**/
+CONST VOID *
+EFIAPI
+InternalMemScanMem32 (
+  IN      CONST VOID                *Buffer,
+  IN      UINTN                     Length,
+  IN      UINT32                    Value
+  )
+{
+  CONST UINT32                      *Pointer;
+  CONST NEON_U32                    *Vector;
+  NEON_U32                          Pattern;
+
+  Pointer = (CONST UINT32 *)Buffer;
+  if (Length >= NEON_MIN_LENGTH / sizeof (UINT32)) {
+    while (!NEON_IS_ALIGNED (Pointer)) {
+      if (*Pointer == Value) {
+        return Pointer;
+      }
+      Pointer++;
+      Length--;
+    }
+
+    Pattern = (NEON_U32) { Value, Value, Value, Value };
+    for (Vector = (CONST NEON_U32 *)Pointer; Length >= NEON_SIZE / sizeof (UINT32); Length -= NEON_SIZE / sizeof (UINT32)) {
+      if (NeonAnySet ((NEON_U64)(*Vector == Pattern))) {
+        break;
+      }
+      Vector++;
+    }
+    Pointer = (CONST UINT32 *)Vector;
+  }
+
+  for (; Length > 0; Length--) {
+    if (*Pointer == Value) {
+      return Pointer;
+    }
+    Pointer++;
+  }
+
+  return NULL;
+}
+
+/**
+  Scans a target buffer for a 64-bit value, and returns a pointer to the
+  matching 64-bit value in the target buffer.
+
+  @param  Buffer  Pointer to the target buffer to scan.
+  @param  Length  Count of 64-bit value to scan. Must be non-zero.
+  @param  Value   Value to search for in the target buffer.
+
+  @return Pointer to the first occurrence or NULL if not found.
+
+**/
+CONST VOID *
+EFIAPI
+InternalMemScanMem64 (
+  IN      CONST VOID                *Buffer,
+  IN      UINTN                     Length,
+  IN      UINT64                    Value
+  )
+{
+  CONST UINT64                      *Pointer;
+  CONST NEON_U64                    *Vector;
+  NEON_U64                          Pattern;
+
+  Pointer = (CONST UINT64 *)Buffer;
+  if (Length >= NEON_MIN_LENGTH / sizeof (UINT64)) {
+    if (!NEON_IS_ALIGNED (Pointer)) {
+      if (*Pointer == Value) {
+        return Pointer;
+      }
+      Pointer++;
+      Length--;
+    }
+
+    Pattern = (NEON_U64) { Value, Value };
+    for (Vector = (CONST NEON_U64 *)Pointer; Length >= NEON_SIZE / sizeof (UINT64); Length -= NEON_SIZE / sizeof (UINT64)) {
+      if (NeonAnySet ((NEON_U64)(*Vector == Pattern))) {
+        break;
+      }
+      Vector++;
+    }
+    Pointer = (CONST UINT64 *)Vector;
+  }
+
+  for (; Length > 0; Length--) {
+    if (*Pointer == Value) {
+      return Pointer;
+    }
+    Pointer++;
+  }
+
+  return NULL;
+}
@@ -0,0 +1,95 @@
+/** @file
+*
+*  Runs firmware code on the secondary cores parked by the PrePi MPPP loop.
+*
+*  Copyright (c) Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __ARM_MPPP_LIB_H__
+#define __ARM_MPPP_LIB_H__
+
+#include <Guid/ArmMpCoreInfo.h>
+
+//
+// Offset of the ARM_MPPP_STARTUP pointer in the parking protocol mailbox. The
+// first half of the mailbox belongs to the OS, the second half is reserved for
+// the firmware.
+//
+#define ARM_MPPP_MAILBOX_STARTUP_OFFSET     0x800
+
+typedef
+VOID
+(EFIAPI *ARM_MPPP_ROUTINE) (
+  IN  VOID    *Context
+  );
+
+//
+// Filled by ArmMpppStartCore() and read by the woken core with its MMU off.
+// It must stay valid until the core is parked again.
+//
+typedef struct {
+  UINT32    Ttbr0;
+  UINT32    Ttbcr;
+  UINT32    Dacr;
+  UINT32    Sctlr;
+  UINT32    Cpacr;
+  UINT32    Vbar;
+  UINT32    StackTop;
+  UINT32    Routine;
+  UINT32    Context;
+} ARM_MPPP_STARTUP;
+
+/**
+  Sends a parked core to Routine through its parking protocol mailbox.
+
+  The core runs Routine(Context) on StackTop with the translation table, caches,
+  vectors and VFP access of the caller, and with the interrupts off. When
+  Routine returns, the core cleans its caches, turns them and its MMU off and
+  goes back to the PrePi parking loop.
+
+  The caller memory must be mapped shareable (see ArmV7Mmu.c) for the core to be
+  coherent with it.
+
+  @param  CoreInfo          Core to start, from the MP core info table
+  @param  Startup           Startup context, must stay valid until the core is parked
+  @param  Routine           Routine to run
+  @param  Context           Passed to Routine
+  @param  StackTop          Top of the stack to run Routine on
+
+  @retval RETURN_SUCCESS        The core took the jump address
+  @retval RETURN_UNSUPPORTED    The core has no mailbox
+  @retval RETURN_NOT_READY      The core is not in the parking loop
+  @retval RETURN_TIMEOUT        The core did not answer its mailbox
+**/
+RETURN_STATUS
+EFIAPI
+ArmMpppStartCore (
+  IN  CONST ARM_CORE_INFO   *CoreInfo,
+  IN  ARM_MPPP_STARTUP      *Startup,
+  IN  ARM_MPPP_ROUTINE      Routine,
+  IN  VOID                  *Context,
+  IN  VOID                  *StackTop
+  );
+
+/**
+  Returns TRUE if the core waits in the PrePi parking loop, with its mailbox in
+  the state the OS expects.
+
+  @param  CoreInfo          Core to check, from the MP core info table
+**/
+BOOLEAN
+EFIAPI
+ArmMpppIsCoreParked (
+  IN  CONST ARM_CORE_INFO   *CoreInfo
+  );
+
+#endif // __ARM_MPPP_LIB_H__
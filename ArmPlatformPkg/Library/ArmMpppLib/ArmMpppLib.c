@@ -0,0 +1,126 @@
+/** @file
+*
+*  Copyright (c) Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Base.h>
+#include <Library/ArmLib.h>
+#include <Library/ArmMpppLib.h>
+#include <Library/CacheMaintenanceLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoLib.h>
+#include <Library/PcdLib.h>
+#include <Library/TimerLib.h>
+
+// How long a parked core gets to take its jump address
+#define ARM_MPPP_START_TIMEOUT_US       100000
+#define ARM_MPPP_POLL_INTERVAL_US       10
+
+#define ARM_MPPP_MAILBOX(CoreInfo)      ((volatile UINT32 *)(UINTN)(PcdGet32 (PcdCPUCoresMPPPMailboxBase) + \
+                                          ((CoreInfo)->CoreId * PcdGet32 (PcdCPUCoresMPPPMailboxSize))))
+
+// Mailbox layout of the parking protocol, see PrePi MainMPCoreMPPP.c
+#define ARM_MPPP_PROCESSOR_ID(Mailbox)  ((Mailbox)[0])
+#define ARM_MPPP_JUMP_ADDRESS(Mailbox)  (*(volatile UINT64 *)&(Mailbox)[2])
+#define ARM_MPPP_STARTUP_PTR(Mailbox)   ((Mailbox)[ARM_MPPP_MAILBOX_STARTUP_OFFSET / sizeof (UINT32)])
+
+VOID
+ArmMpppEntry (
+  IN  UINT32              *Mailbox
+  );
+
+VOID
+ArmMpppReadMmuState (
+  OUT ARM_MPPP_STARTUP    *Startup
+  );
+
+BOOLEAN
+EFIAPI
+ArmMpppIsCoreParked (
+  IN  CONST ARM_CORE_INFO   *CoreInfo
+  )
+{
+  volatile UINT32   *Mailbox;
+
+  Mailbox = ARM_MPPP_MAILBOX (CoreInfo);
+
+  // The parked core writes its mailbox with the caches off
+  InvalidateDataCacheRange ((VOID *)Mailbox, sizeof (UINT32) * 4);
+
+  return (ARM_MPPP_PROCESSOR_ID (Mailbox) == 0xFFFFFFFF) && (ARM_MPPP_JUMP_ADDRESS (Mailbox) == 0);
+}
+
+RETURN_STATUS
+EFIAPI
+ArmMpppStartCore (
+  IN  CONST ARM_CORE_INFO   *CoreInfo,
+  IN  ARM_MPPP_STARTUP      *Startup,
+  IN  ARM_MPPP_ROUTINE      Routine,
+  IN  VOID                  *Context,
+  IN  VOID                  *StackTop
+  )
+{
+  volatile UINT32   *Mailbox;
+  UINTN             Timeout;
+
+  ASSERT (Startup != NULL);
+  ASSERT (Routine != NULL);
+  ASSERT (StackTop != NULL);
+
+  if (CoreInfo->MailboxSetAddress == 0) {
+    return RETURN_UNSUPPORTED;
+  }
+
+  if (!ArmMpppIsCoreParked (CoreInfo)) {
+    return RETURN_NOT_READY;
+  }
+
+  Mailbox = ARM_MPPP_MAILBOX (CoreInfo);
+
+  ArmMpppReadMmuState (Startup);
+  Startup->StackTop = (UINT32)(UINTN)StackTop;
+  Startup->Routine  = (UINT32)(UINTN)Routine;
+  Startup->Context  = (UINT32)(UINTN)Context;
+
+  // Same sequence as the OS, the jump address first and the processor id last
+  ARM_MPPP_STARTUP_PTR (Mailbox) = (UINT32)(UINTN)Startup;
+  ARM_MPPP_JUMP_ADDRESS (Mailbox) = (UINT64)(UINTN)ArmMpppEntry;
+  ARM_MPPP_PROCESSOR_ID (Mailbox) = CoreInfo->CoreId;
+
+  //
+  // The core runs ArmMpppEntry and reads its mailbox and startup context with
+  // the MMU off. Push the whole data cache to memory rather than guessing the
+  // extent of the code.
+  //
+  WriteBackDataCache ();
+  ArmDataSyncronizationBarrier ();
+
+  MmioWrite32 ((UINTN)CoreInfo->MailboxSetAddress, 1);
+
+  // PrePi clears the jump address when it takes it
+  for (Timeout = 0; Timeout < ARM_MPPP_START_TIMEOUT_US; Timeout += ARM_MPPP_POLL_INTERVAL_US) {
+    InvalidateDataCacheRange ((VOID *)Mailbox, sizeof (UINT32) * 4);
+    if (ARM_MPPP_JUMP_ADDRESS (Mailbox) == 0) {
+      return RETURN_SUCCESS;
+    }
+    MicroSecondDelay (ARM_MPPP_POLL_INTERVAL_US);
+  }
+
+  DEBUG ((EFI_D_ERROR, "ArmMpppStartCore: Core %d did not answer its mailbox\n", CoreInfo->CoreId));
+
+  // Withdraw the request, the core must not take it later
+  ARM_MPPP_PROCESSOR_ID (Mailbox) = 0xFFFFFFFF;
+  ARM_MPPP_JUMP_ADDRESS (Mailbox) = 0;
+  WriteBackInvalidateDataCacheRange ((VOID *)Mailbox, sizeof (UINT32) * 4);
+
+  return RETURN_TIMEOUT;
+}
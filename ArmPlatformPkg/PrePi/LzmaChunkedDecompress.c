@@ -0,0 +1,381 @@
+/** @file
+*
+*  Decodes the LZMA chunked GUIDed sections on the primary core and on the
+*  secondary cores that PrePi can borrow.
+*
+*  Copyright (c) Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include "PrePi.h"
+
+#include <Library/PerformanceLib.h>
+#include <Library/TimerLib.h>
+
+#include <Guid/LzmaDecompress.h>
+
+#include "LzmaDecompress.h"
+
+// Every decoder has its own LzmaUefiDecompress() scratch buffer. The primary
+// core uses the one of the caller, the secondary cores get one of their own
+// that is never freed.
+#define LZMA_CHUNKED_MAX_DECODERS       4
+#define LZMA_CHUNKED_DECODER_SCRATCH    SIZE_64KB
+
+// LZMA properties and decoded size at the start of every chunk
+#define LZMA_CHUNKED_STREAM_HEADER_SIZE 13
+
+// How long the primary core waits for a secondary core to finish its chunks
+// once it is done with its own ones, before decoding them itself. The core is
+// then told to stop after its current chunk.
+#define LZMA_CHUNKED_WAIT_TIMEOUT_US    5000000
+
+typedef struct {
+  UINT32                      Id;
+  CONST LZMA_CHUNKED_HEADER   *Header;
+  UINT8                       *Output;
+  UINTN                       DecoderCount;
+} LZMA_CHUNKED_JOB;
+
+typedef struct {
+  LZMA_CHUNKED_JOB            Job;
+  UINTN                       Index;
+  VOID                        *Scratch;
+  BOOLEAN                     Started;
+  BOOLEAN                     Lost;
+  volatile BOOLEAN            Done;
+  volatile RETURN_STATUS      Status;
+} LZMA_CHUNKED_DECODER;
+
+//
+// Not on the stack, a secondary core that times out may still use its decoder.
+// A lost decoder is left alone, it only writes to its own scratch buffer and
+// the same output bytes as the primary core.
+//
+STATIC LZMA_CHUNKED_DECODER   mDecoders[LZMA_CHUNKED_MAX_DECODERS];
+
+//
+// Id of the job the secondary cores may work on, they check it between two
+// chunks and go back to their parking loop when it changes. Zero aborts the
+// current job.
+//
+STATIC UINT32                 mLzmaChunkedLastJobId;
+STATIC volatile UINT32        mLzmaChunkedRunningJobId;
+
+/**
+  Returns the LZMA chunked data of a GUIDed section and checks its index. The
+  secondary cores rely on it and do not check the offsets again.
+**/
+STATIC
+RETURN_STATUS
+LzmaChunkedGetHeader (
+  IN  CONST VOID                  *InputSection,
+  OUT CONST LZMA_CHUNKED_HEADER   **Header,
+  OUT UINT16                      *SectionAttribute  OPTIONAL
+  )
+{
+  CONST LZMA_CHUNKED_HEADER   *ChunkedHeader;
+  CONST UINT32                *ChunkOffset;
+  UINT32                      DataSize;
+  UINT32                      Index;
+  UINT32                      ChunkSize;
+  UINT32                      ScratchSize;
+
+  if (IS_SECTION2 (InputSection)) {
+    if (!CompareGuid (&gLzmaChunkedCustomDecompressGuid,
+                      &(((EFI_GUID_DEFINED_SECTION2 *) InputSection)->SectionDefinitionGuid))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    ChunkedHeader = (LZMA_CHUNKED_HEADER *)((UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset);
+    DataSize = SECTION2_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset;
+    if (SectionAttribute != NULL) {
+      *SectionAttribute = ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->Attributes;
+    }
+  } else {
+    if (!CompareGuid (&gLzmaChunkedCustomDecompressGuid,
+                      &(((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    ChunkedHeader = (LZMA_CHUNKED_HEADER *)((UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset);
+    DataSize = SECTION_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset;
+    if (SectionAttribute != NULL) {
+      *SectionAttribute = ((EFI_GUID_DEFINED_SECTION *) InputSection)->Attributes;
+    }
+  }
+
+  if ((DataSize < sizeof (LZMA_CHUNKED_HEADER)) ||
+      (ChunkedHeader->Signature != LZMA_CHUNKED_SIGNATURE) ||
+      (ChunkedHeader->ChunkSize == 0) ||
+      (ChunkedHeader->UncompressedSize > MAX_UINT32) ||
+      (ChunkedHeader->ChunkCount != DivU64x32 (ChunkedHeader->UncompressedSize + ChunkedHeader->ChunkSize - 1, ChunkedHeader->ChunkSize)) ||
+      (ChunkedHeader->ChunkCount >= (DataSize - sizeof (LZMA_CHUNKED_HEADER)) / sizeof (UINT32))) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  ChunkOffset = (CONST UINT32 *)(ChunkedHeader + 1);
+  for (Index = 0; Index < ChunkedHeader->ChunkCount; Index++) {
+    if ((ChunkOffset[Index + 1] > DataSize) ||
+        (ChunkOffset[Index + 1] < LZMA_CHUNKED_STREAM_HEADER_SIZE) ||
+        (ChunkOffset[Index] > ChunkOffset[Index + 1] - LZMA_CHUNKED_STREAM_HEADER_SIZE)) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    LzmaUefiDecompressGetInfo ((UINT8 *)ChunkedHeader + ChunkOffset[Index],
+      ChunkOffset[Index + 1] - ChunkOffset[Index], &ChunkSize, &ScratchSize);
+    if ((ScratchSize > LZMA_CHUNKED_DECODER_SCRATCH) ||
+        (ChunkSize != MIN (ChunkedHeader->ChunkSize, (UINT32)ChunkedHeader->UncompressedSize - (Index * ChunkedHeader->ChunkSize)))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+  }
+
+  *Header = ChunkedHeader;
+  return RETURN_SUCCESS;
+}
+
+/**
+  Decodes the chunks of a decoder, every DecoderCount-th chunk from its index.
+  Neighbouring chunks go to different cores, which keeps them busy for about
+  the same time when the compression ratio varies along the image.
+
+  A secondary core stops with RETURN_ABORTED once the primary core no longer
+  runs its job, a lost core can at most finish the chunk it is decoding.
+**/
+STATIC
+RETURN_STATUS
+LzmaChunkedDecodeShare (
+  IN  LZMA_CHUNKED_JOB          *Job,
+  IN  UINTN                     DecoderIndex,
+  IN  VOID                      *Scratch,
+  IN  BOOLEAN                   Abortable
+  )
+{
+  CONST UINT32                *ChunkOffset;
+  UINTN                       Chunk;
+  RETURN_STATUS               Status;
+
+  ChunkOffset = (CONST UINT32 *)(Job->Header + 1);
+  for (Chunk = DecoderIndex; Chunk < Job->Header->ChunkCount; Chunk += Job->DecoderCount) {
+    if (Abortable && (mLzmaChunkedRunningJobId != Job->Id)) {
+      return RETURN_ABORTED;
+    }
+
+    Status = LzmaUefiDecompress (
+               (UINT8 *)Job->Header + ChunkOffset[Chunk],
+               ChunkOffset[Chunk + 1] - ChunkOffset[Chunk],
+               Job->Output + (Chunk * Job->Header->ChunkSize),
+               Scratch
+               );
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Runs on a secondary core, with the interrupts off. It must not print as the
+  primary core may use the serial port at the same time.
+**/
+STATIC
+VOID
+EFIAPI
+LzmaChunkedDecoderMain (
+  IN  VOID                      *Context
+  )
+{
+  LZMA_CHUNKED_DECODER        *Decoder;
+
+  Decoder = Context;
+  Decoder->Status = LzmaChunkedDecodeShare (&Decoder->Job, Decoder->Index, Decoder->Scratch, TRUE);
+
+  // The primary core reads the output once it sees Done
+  ArmDataMemoryBarrier ();
+  Decoder->Done = TRUE;
+  ArmDataSyncronizationBarrier ();
+}
+
+STATIC
+UINT64
+LzmaChunkedElapsedUs (
+  IN  UINT64                    StartTime
+  )
+{
+  UINT64                      Frequency;
+  UINT64                      CounterStart;
+  UINT64                      CounterEnd;
+  UINT64                      Ticks;
+
+  Frequency = GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+  if (Frequency == 0) {
+    return 0;
+  }
+
+  if (CounterStart < CounterEnd) {
+    Ticks = GetPerformanceCounter () - StartTime;
+  } else {
+    Ticks = StartTime - GetPerformanceCounter ();
+  }
+
+  return DivU64x64Remainder (MultU64x32 (Ticks, 1000000), Frequency, NULL);
+}
+
+RETURN_STATUS
+EFIAPI
+LzmaChunkedGuidedSectionGetInfo (
+  IN  CONST VOID                *InputSection,
+  OUT UINT32                    *OutputBufferSize,
+  OUT UINT32                    *ScratchBufferSize,
+  OUT UINT16                    *SectionAttribute
+  )
+{
+  CONST LZMA_CHUNKED_HEADER   *Header;
+  RETURN_STATUS               Status;
+
+  ASSERT (InputSection != NULL);
+  ASSERT (OutputBufferSize != NULL);
+  ASSERT (ScratchBufferSize != NULL);
+  ASSERT (SectionAttribute != NULL);
+
+  Status = LzmaChunkedGetHeader (InputSection, &Header, SectionAttribute);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  *OutputBufferSize = (UINT32)Header->UncompressedSize;
+  *ScratchBufferSize = LZMA_CHUNKED_DECODER_SCRATCH;
+
+  return RETURN_SUCCESS;
+}
+
+RETURN_STATUS
+EFIAPI
+LzmaChunkedGuidedSectionExtraction (
+  IN CONST  VOID                *InputSection,
+  OUT       VOID                **OutputBuffer,
+  OUT       VOID                *ScratchBuffer,        OPTIONAL
+  OUT       UINT32              *AuthenticationStatus
+  )
+{
+  CONST LZMA_CHUNKED_HEADER   *Header;
+  LZMA_CHUNKED_JOB            Job;
+  UINTN                       Index;
+  UINTN                       Timeout;
+  UINTN                       StartedCount;
+  UINT64                      StartTime;
+  RETURN_STATUS               Status;
+
+  ASSERT (OutputBuffer != NULL);
+  ASSERT (InputSection != NULL);
+  ASSERT (ScratchBuffer != NULL);
+
+  Status = LzmaChunkedGetHeader (InputSection, &Header, NULL);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Authentication is set to Zero, which may be ignored.
+  //
+  *AuthenticationStatus = 0;
+
+  PERF_START (NULL, "LzmaChunked", NULL, 0);
+  StartTime = GetPerformanceCounter ();
+
+  // Zero is never the id of a job
+  mLzmaChunkedLastJobId++;
+  if (mLzmaChunkedLastJobId == 0) {
+    mLzmaChunkedLastJobId++;
+  }
+
+  Job.Id = mLzmaChunkedLastJobId;
+  Job.Header = Header;
+  Job.Output = *OutputBuffer;
+  Job.DecoderCount = MIN (PrePiGetSecondaryCoreCount () + 1, LZMA_CHUNKED_MAX_DECODERS);
+  Job.DecoderCount = MIN (Job.DecoderCount, Header->ChunkCount);
+
+  mLzmaChunkedRunningJobId = Job.Id;
+  ArmDataSyncronizationBarrier ();
+
+  // Decoder 0 is the primary core, the chunks of the lost decoders are left to it
+  StartedCount = 0;
+  for (Index = 1; Index < Job.DecoderCount; Index++) {
+    mDecoders[Index].Started = FALSE;
+    if (mDecoders[Index].Lost) {
+      continue;
+    }
+
+    if (mDecoders[Index].Scratch == NULL) {
+      mDecoders[Index].Scratch = AllocatePages (EFI_SIZE_TO_PAGES (LZMA_CHUNKED_DECODER_SCRATCH));
+      if (mDecoders[Index].Scratch == NULL) {
+        continue;
+      }
+    }
+
+    CopyMem (&mDecoders[Index].Job, &Job, sizeof (Job));
+    mDecoders[Index].Index = Index;
+    mDecoders[Index].Done = FALSE;
+    mDecoders[Index].Status = RETURN_SUCCESS;
+    if (!EFI_ERROR (PrePiStartSecondaryCore (Index - 1, LzmaChunkedDecoderMain, &mDecoders[Index]))) {
+      mDecoders[Index].Started = TRUE;
+      StartedCount++;
+    }
+  }
+
+  Status = LzmaChunkedDecodeShare (&Job, 0, ScratchBuffer, FALSE);
+
+  //
+  // Take over the chunks of the cores that could not be started, failed or did
+  // not finish in time. A core that times out is told to stop after its current
+  // chunk, the other cores stop too and their chunks are taken over as well. A
+  // late core writes the same bytes, and the primary core only uses the
+  // scratch buffer of the caller.
+  //
+  for (Index = 1; (Index < Job.DecoderCount) && !RETURN_ERROR (Status); Index++) {
+    for (Timeout = 0; mDecoders[Index].Started && !mDecoders[Index].Done; Timeout += 10) {
+      if (Timeout >= LZMA_CHUNKED_WAIT_TIMEOUT_US) {
+        DEBUG ((EFI_D_ERROR, "LzmaChunked: Decoder %d timed out\n", Index));
+        mLzmaChunkedRunningJobId = 0;
+        ArmDataSyncronizationBarrier ();
+        break;
+      }
+      MicroSecondDelay (10);
+    }
+    ArmDataMemoryBarrier ();
+
+    if (!mDecoders[Index].Started || !mDecoders[Index].Done || RETURN_ERROR (mDecoders[Index].Status)) {
+      Status = LzmaChunkedDecodeShare (&Job, Index, ScratchBuffer, FALSE);
+    }
+  }
+
+  // The wait stops at the first error, the cores still decoding go back to their parking loop
+  mLzmaChunkedRunningJobId = 0;
+  ArmDataSyncronizationBarrier ();
+
+  PrePiParkSecondaryCores ();
+
+  //
+  // A core that is still not done is stuck within a chunk. It is lost: its
+  // decoder and its core are never used again, see PrePiParkSecondaryCores().
+  //
+  for (Index = 1; Index < Job.DecoderCount; Index++) {
+    if (mDecoders[Index].Started && !mDecoders[Index].Done) {
+      mDecoders[Index].Lost = TRUE;
+    }
+  }
+
+  PERF_END (NULL, "LzmaChunked", NULL, 0);
+
+  DEBUG ((EFI_D_INFO, "LzmaChunked: %d chunks, %d bytes decoded on %d cores in %ld us\n",
+    Header->ChunkCount, (UINT32)Header->UncompressedSize, StartedCount + 1, LzmaChunkedElapsedUs (StartTime)));
+
+  return Status;
+}
@@ -99,5 +99,27 @@ LzmaGuidedSectionExtraction (
   OUT       UINT32  *AuthenticationStatus
   );
 
+//
+// LzmaDecompressLib internal functions, used directly to decode the chunks of
+// the LZMA chunked sections
+//
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompressGetInfo (
+  IN  CONST VOID  *Source,
+  IN  UINT32      SourceSize,
+  OUT UINT32      *DestinationSize,
+  OUT UINT32      *ScratchSize
+  );
+
+RETURN_STATUS
+EFIAPI
+LzmaUefiDecompress (
+  IN CONST VOID  *Source,
+  IN UINTN       SourceSize,
+  IN OUT VOID    *Destination,
+  IN OUT VOID    *Scratch
+  );
+
 #endif // __LZMADECOMPRESS_H__
 
@@ -104,3 +104,29 @@ SecondaryMain (
   // The secondaries shouldn't reach here
   ASSERT(FALSE);
 }
+
+UINTN
+PrePiGetSecondaryCoreCount (
+  VOID
+  )
+{
+  // The secondary cores are not available to PrePi
+  return 0;
+}
+
+EFI_STATUS
+PrePiStartSecondaryCore (
+  IN  UINTN                     Index,
+  IN  ARM_MPPP_ROUTINE          Routine,
+  IN  VOID                      *Context
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+VOID
+PrePiParkSecondaryCores (
+  VOID
+  )
+{
+}
@@ -18,9 +18,23 @@
 #include "PrePi.h"
 
 #include <Library/ArmGicLib.h>
+#include <Library/TimerLib.h>
 
 #include <Ppi/ArmMpCoreInfo.h>
 
+#define PREPI_SECONDARY_CORE_MAX        FixedPcdGet32 (PcdCoreCount)
+#define PREPI_SECONDARY_STACK_SIZE      SIZE_16KB
+#define PREPI_SECONDARY_PARK_TIMEOUT_US 1000000
+
+typedef struct {
+  ARM_CORE_INFO           *CoreInfo;
+  ARM_MPPP_STARTUP        Startup;
+  VOID                    *Stack;
+  BOOLEAN                 Started;
+} PREPI_SECONDARY_CORE;
+
+STATIC PREPI_SECONDARY_CORE mSecondaryCores[PREPI_SECONDARY_CORE_MAX];
+
 VOID
 PrimaryMain (
   IN  UINTN                     UefiMemoryBase,
@@ -127,56 +141,210 @@ SecondaryMain (
   // The WFI will wake up the core on interrupt but not take it.
   ArmDisableInterrupts();
 
-  do {
-    ArmCallWFI ();
+  for (;;) {
+    do {
+      ArmCallWFI ();
 
-    // Non-GIC implementations need another means to receive an interrupt.
-    // Therefore, we support both the mailbox and the ARM GIC as options.
-    // When the ARM GIC is used the mailbox code does nothing.
-    if (ArmCoreInfoTable[Index].MailboxClearAddress != 0) {
-        // Read the mailbox
-        MmioRead32 (ArmCoreInfoTable[Index].MailboxGetAddress);
+      // Non-GIC implementations need another means to receive an interrupt.
+      // Therefore, we support both the mailbox and the ARM GIC as options.
+      // When the ARM GIC is used the mailbox code does nothing.
+      if (ArmCoreInfoTable[Index].MailboxClearAddress != 0) {
+          // Read the mailbox
+          MmioRead32 (ArmCoreInfoTable[Index].MailboxGetAddress);
 
-        // Clear Secondary cores MailBox
-        MmioWrite32 (ArmCoreInfoTable[Index].MailboxClearAddress, ArmCoreInfoTable[Index].MailboxClearValue);
-    }
+          // Clear Secondary cores MailBox
+          MmioWrite32 (ArmCoreInfoTable[Index].MailboxClearAddress, ArmCoreInfoTable[Index].MailboxClearValue);
+      }
+
+      // Get the values from the mailbox
+      ProcessorId = *ProcessorIdAddr;
 
-    // Get the values from the mailbox
-    ProcessorId = *ProcessorIdAddr;
+      // Note that we cast the 64-bit address to the native architecture here.
+      JumpAddress = (UINTN) (*JumpAddressAddr);
 
-    // Note that we cast the 64-bit address to the native architecture here.
-    JumpAddress = (UINTN) (*JumpAddressAddr);
+      // Acknowledge the interrupt and send End of Interrupt signal.
+      AcknowledgeInterrupt = ArmGicAcknowledgeInterrupt (PcdGet32(PcdGicInterruptInterfaceBase), &InterruptId);
+      // Check if it is a valid interrupt ID
+      if (InterruptId < ArmGicGetMaxNumInterrupts (FixedPcdGet32 (PcdGicDistributorBase))) {
+          // Got a valid SGI number hence signal End of Interrupt
+          ArmGicEndOfInterrupt (FixedPcdGet32 (PcdGicInterruptInterfaceBase), AcknowledgeInterrupt);
+      }
+
+      DEBUG ((DEBUG_INIT, "(MPPP)SecondaryMain: Wakeup: MpId=0x%8.8X, ProcId=0x%8.8X, JumpAddress=0x%8.8X\n",
+              MpId,
+              ProcessorId,
+              (UINT32) JumpAddress));
 
-    // Acknowledge the interrupt and send End of Interrupt signal.
-    AcknowledgeInterrupt = ArmGicAcknowledgeInterrupt (PcdGet32(PcdGicInterruptInterfaceBase), &InterruptId);
-    // Check if it is a valid interrupt ID
-    if (InterruptId < ArmGicGetMaxNumInterrupts (FixedPcdGet32 (PcdGicDistributorBase))) {
-        // Got a valid SGI number hence signal End of Interrupt
-        ArmGicEndOfInterrupt (FixedPcdGet32 (PcdGicInterruptInterfaceBase), AcknowledgeInterrupt);
     }
+    while ( (ProcessorId != CoreId) ||
+            (JumpAddress == 0) );
 
-    DEBUG ((DEBUG_INIT, "(MPPP)SecondaryMain: Wakeup: MpId=0x%8.8X, ProcId=0x%8.8X, JumpAddress=0x%8.8X\n",
+    DEBUG ((DEBUG_INIT, "(MPPP)SecondaryMain: Exit: MpId=0x%8.8X, JumpAddress=0x%8.8X\n",
             MpId,
-            ProcessorId,
             (UINT32) JumpAddress));
 
+    // Acknowledge the jump address by clearing it
+    *JumpAddressAddr = 0;
+
+    // Jump to secondary core entry point.
+    Jump = (VOID (*)()) (JumpAddress);
+
+    Jump(MailboxAddr);
+
+    // The OS never returns here, but the firmware can wake the core to run code
+    // during boot (see ArmMpppLib). That code returns with the MMU
+    // and the caches off and its dirty lines cleaned, so the core can go straight
+    // back to the parked state. The data cache must not be invalidated by set/way
+    // again as the L2 is shared with the cores that are still running.
+    DEBUG ((DEBUG_INIT, "(MPPP)SecondaryMain: Return: MpId=0x%8.8X\n", MpId));
+
+    ArmInvalidateInstructionCache();
+    ArmDisableInterrupts();
+
+    *ProcessorIdAddr = 0xFFFFFFFF;
+    *JumpAddressAddr = 0;
+    ArmDataSyncronizationBarrier();
   }
-  while ( (ProcessorId != CoreId) ||
-          (JumpAddress == 0) );
+}
 
-  DEBUG ((DEBUG_INIT, "(MPPP)SecondaryMain: Exit: MpId=0x%8.8X, JumpAddress=0x%8.8X\n",
-          MpId,
-          (UINT32) JumpAddress));
 
-  // Acknowledge the jump address by clearing it
-  *JumpAddressAddr = 0;
+//
+// Returns the entry of the Index-th secondary core in the ARM Core Info Table
+//
+STATIC
+ARM_CORE_INFO *
+GetSecondaryCoreInfo (
+  IN  UINTN                     Index
+  )
+{
+  EFI_STATUS              Status;
+  ARM_MP_CORE_INFO_PPI    *ArmMpCoreInfoPpi;
+  UINTN                   ArmCoreCount;
+  ARM_CORE_INFO           *ArmCoreInfoTable;
+  UINTN                   CoreIndex;
+  UINTN                   MpId;
 
-  // Jump to secondary core entry point.
-  Jump = (VOID (*)()) (JumpAddress);
+  Status = GetPlatformPpi (&gArmMpCoreInfoPpiGuid, (VOID**)&ArmMpCoreInfoPpi);
+  if (EFI_ERROR (Status)) {
+    return NULL;
+  }
 
-  Jump(MailboxAddr);
+  ArmCoreCount = 0;
+  Status = ArmMpCoreInfoPpi->GetMpCoreInfo (&ArmCoreCount, &ArmCoreInfoTable);
+  if (EFI_ERROR (Status)) {
+    return NULL;
+  }
 
-  // The secondaries shouldn't reach here
-  ASSERT(FALSE);
+  MpId = ArmReadMpidr ();
+  for (CoreIndex = 0; CoreIndex < ArmCoreCount; CoreIndex++) {
+    if ((ArmCoreInfoTable[CoreIndex].ClusterId == GET_CLUSTER_ID (MpId)) &&
+        (ArmCoreInfoTable[CoreIndex].CoreId == GET_CORE_ID (MpId))) {
+      continue;
+    }
+    if (Index-- == 0) {
+      return &ArmCoreInfoTable[CoreIndex];
+    }
+  }
+
+  return NULL;
+}
+
+UINTN
+PrePiGetSecondaryCoreCount (
+  VOID
+  )
+{
+  UINTN                   Count;
+
+  for (Count = 0; Count < PREPI_SECONDARY_CORE_MAX; Count++) {
+    if (GetSecondaryCoreInfo (Count) == NULL) {
+      break;
+    }
+  }
+
+  return Count;
 }
 
+/**
+  Runs Routine on a secondary core waiting in its parking loop. The core goes
+  back to the parking loop when Routine returns, PrePiParkSecondaryCores()
+  waits for it.
+
+  The core shares the primary core translation table, Routine must not call
+  anything that is not reentrant, in particular the HOB and memory allocation
+  libraries.
+**/
+EFI_STATUS
+PrePiStartSecondaryCore (
+  IN  UINTN                     Index,
+  IN  ARM_MPPP_ROUTINE          Routine,
+  IN  VOID                      *Context
+  )
+{
+  PREPI_SECONDARY_CORE    *Core;
+  ARM_CORE_INFO           *CoreInfo;
+  EFI_STATUS              Status;
+
+  if (Index >= PREPI_SECONDARY_CORE_MAX) {
+    return EFI_NOT_FOUND;
+  }
+
+  CoreInfo = GetSecondaryCoreInfo (Index);
+  if (CoreInfo == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Core = &mSecondaryCores[Index];
+  if (Core->Started) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  if (Core->Stack == NULL) {
+    Core->Stack = AllocatePages (EFI_SIZE_TO_PAGES (PREPI_SECONDARY_STACK_SIZE));
+    if (Core->Stack == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Status = ArmMpppStartCore (CoreInfo, &Core->Startup, Routine, Context,
+             (UINT8 *)Core->Stack + PREPI_SECONDARY_STACK_SIZE);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((EFI_D_WARN, "(MPPP)PrePiStartSecondaryCore: Core %d: %r\n", CoreInfo->CoreId, Status));
+    return Status;
+  }
+
+  Core->CoreInfo = CoreInfo;
+  Core->Started = TRUE;
+
+  return EFI_SUCCESS;
+}
+
+VOID
+PrePiParkSecondaryCores (
+  VOID
+  )
+{
+  PREPI_SECONDARY_CORE    *Core;
+  UINTN                   Index;
+  UINTN                   Timeout;
+
+  for (Index = 0; Index < PREPI_SECONDARY_CORE_MAX; Index++) {
+    Core = &mSecondaryCores[Index];
+    if (!Core->Started) {
+      continue;
+    }
+
+    for (Timeout = 0; Timeout < PREPI_SECONDARY_PARK_TIMEOUT_US; Timeout += 10) {
+      if (ArmMpppIsCoreParked (Core->CoreInfo)) {
+        Core->Started = FALSE;
+        break;
+      }
+      MicroSecondDelay (10);
+    }
+
+    // A core that did not come back is left marked as started, it must not be woken again
+    if (Core->Started) {
+      DEBUG ((EFI_D_ERROR, "(MPPP)PrePiParkSecondaryCores: Core %d is not parked\n", Core->CoreInfo->CoreId));
+    }
+  }
+}
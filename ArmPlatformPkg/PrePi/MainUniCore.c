@@ -42,3 +42,28 @@ SecondaryMain (
   ASSERT(FALSE);
 }
 
+UINTN
+PrePiGetSecondaryCoreCount (
+  VOID
+  )
+{
+  // The secondary cores are not available to PrePi
+  return 0;
+}
+
+EFI_STATUS
+PrePiStartSecondaryCore (
+  IN  UINTN                     Index,
+  IN  ARM_MPPP_ROUTINE          Routine,
+  IN  VOID                      *Context
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+VOID
+PrePiParkSecondaryCores (
+  VOID
+  )
+{
+}
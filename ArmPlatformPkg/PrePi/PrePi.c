@@ -22,11 +22,13 @@
 #include <Library/PrePiHobListPointerLib.h>
 #include <Library/TimerLib.h>
 #include <Library/PerformanceLib.h>
+#include <Library/ExtractGuidedSectionLib.h>
 
 #include <Ppi/GuidedSectionExtraction.h>
 #include <Ppi/ArmMpCoreInfo.h>
 #include <Guid/LzmaDecompress.h>
 #include <Guid/ArmGlobalVariableHob.h>
+#include <Guid/FirmwarePerformance.h>
 
 #include "PrePi.h"
 #include "LzmaDecompress.h"
@@ -106,6 +108,7 @@ PrePiMain (
   CHAR8                         Buffer[100];
   UINTN                         CharCount;
   UINTN                         StacksSize;
+  FIRMWARE_SEC_PERFORMANCE      SecPerformance;
 
   // If ensure the FD is either part of the System Memory or totally outside of the System Memory (XIP)
   ASSERT (IS_XIP() ||
@@ -179,6 +182,12 @@ PrePiMain (
   // Now, the HOB List has been initialized, we can register performance information
   PERF_START (NULL, "PEI", NULL, StartTimeStamp);
 
+  // The FPDT reports the time the primary core entered PrePi as the end of the reset
+  if (PerformanceMeasurementEnabled ()) {
+    SecPerformance.ResetEnd = GetTimeInNanoSecond (StartTimeStamp);
+    BuildGuidDataHob (&gEfiFirmwarePerformanceGuid, &SecPerformance, sizeof (SecPerformance));
+  }
+
   // SEC phase needs to run library constructors by hand.
   ExtractGuidedSectionLibConstructor ();
   LzmaDecompressLibConstructor ();
@@ -191,8 +200,17 @@ PrePiMain (
     LzmaGuidedSectionExtraction
     );
 
+  // The LZMA chunked sections borrow the secondary cores, only PrePi decodes them
+  ExtractGuidedSectionRegisterHandlers (
+    &gLzmaChunkedCustomDecompressGuid,
+    LzmaChunkedGuidedSectionGetInfo,
+    LzmaChunkedGuidedSectionExtraction
+    );
+
   // Assume the FV that contains the SEC (our code) also contains a compressed FV.
+  PERF_START (NULL, "DecompressFv", NULL, 0);
   Status = DecompressFirstFv ();
+  PERF_END (NULL, "DecompressFv", NULL, 0);
   ASSERT_EFI_ERROR (Status);
 
   // Load the DXE Core and transfer control to it
@@ -26,6 +26,7 @@
 #include <Library/HobLib.h>
 #include <Library/SerialPortLib.h>
 #include <Library/ArmPlatformLib.h>
+#include <Library/ArmMpppLib.h>
 
 #define SerialPrint(txt)  SerialPortWrite (txt, AsciiStrLen(txt)+1);
 
@@ -87,4 +88,44 @@ ArchInitialize (
   VOID
   );
 
+//
+// Secondary cores that can run code for the primary core before DXE, only the
+// MPPP variation implements them. The others have no secondary core to lend.
+//
+UINTN
+PrePiGetSecondaryCoreCount (
+  VOID
+  );
+
+EFI_STATUS
+PrePiStartSecondaryCore (
+  IN  UINTN                     Index,
+  IN  ARM_MPPP_ROUTINE          Routine,
+  IN  VOID                      *Context
+  );
+
+// Wait for every started secondary core to be back in its parking loop
+VOID
+PrePiParkSecondaryCores (
+  VOID
+  );
+
+RETURN_STATUS
+EFIAPI
+LzmaChunkedGuidedSectionGetInfo (
+  IN  CONST VOID                *InputSection,
+  OUT UINT32                    *OutputBufferSize,
+  OUT UINT32                    *ScratchBufferSize,
+  OUT UINT16                    *SectionAttribute
+  );
+
+RETURN_STATUS
+EFIAPI
+LzmaChunkedGuidedSectionExtraction (
+  IN CONST  VOID                *InputSection,
+  OUT       VOID                **OutputBuffer,
+  OUT       VOID                *ScratchBuffer,        OPTIONAL
+  OUT       UINT32              *AuthenticationStatus
+  );
+
 #endif /* _PREPI_H_ */
@@ -0,0 +1,1007 @@
+/** @file
+LZ4 Compress/Decompress tool (Lz4Compress)
+
+The output is an LZ4_SECTION_HEADER followed by a single LZ4 block, see
+IntelFrameworkModulePkg/Include/Guid/Lz4Decompress.h. The matches are found
+with hash chains, which costs compression time but not decompression time.
+
+The --benchmark option compares the ratio and the decompression speed of LZ4,
+LZMA and Tiano on the input files, typically the FVs of a build.
+
+Copyright (c) Microsoft Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../LzmaCompress/Sdk/C/LzmaDec.h"
+#include "../LzmaCompress/Sdk/C/LzmaEnc.h"
+#include "EfiUtilityMsgs.h"
+#include "CommonLib.h"
+#include "ParseInf.h"
+#include "Compress.h"
+#include "Decompress.h"
+
+#define UTILITY_NAME            "Lz4Compress"
+#define UTILITY_MAJOR_VERSION   0
+#define UTILITY_MINOR_VERSION   1
+
+#define LZ4_ACTION_NULL         0
+#define LZ4_ACTION_ENCODE       1
+#define LZ4_ACTION_DECODE       2
+#define LZ4_ACTION_BENCHMARK    3
+
+//
+// Keep in sync with IntelFrameworkModulePkg/Include/Guid/Lz4Decompress.h
+//
+#define LZ4_SECTION_SIGNATURE   0x42345A4C    // 'LZ4B'
+#define LZ4_SECTION_HEADER_SIZE 8
+
+//
+// LZ4 block format constraints
+//
+#define LZ4_MIN_MATCH           4
+#define LZ4_LAST_LITERALS       5             // The block ends with 5 literals
+#define LZ4_MF_LIMIT            12            // The last match starts 12 bytes before the end
+#define LZ4_MAX_DISTANCE        65535
+#define LZ4_RUN_MASK            15
+
+#define LZ4_HASH_LOG            16
+#define LZ4_WINDOW_MASK         0xFFFF
+#define LZ4_DEFAULT_DEPTH       256
+
+#define LZMA_HEADER_SIZE        (LZMA_PROPS_SIZE + 8)
+
+#define BENCHMARK_MIN_SECONDS   0.5
+
+STATIC UINT32 mChainDepth = LZ4_DEFAULT_DEPTH;
+
+VOID
+Version (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Displays the standard utility information to SDTOUT
+
+Arguments:
+
+  None
+
+Returns:
+
+  None
+
+--*/
+{
+  fprintf (stdout, "%s Version %d.%d %s \n", UTILITY_NAME, UTILITY_MAJOR_VERSION, UTILITY_MINOR_VERSION, __BUILD_VERSION);
+}
+
+VOID
+Usage (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Displays the utility usage syntax to STDOUT
+
+Arguments:
+
+  None
+
+Returns:
+
+  None
+
+--*/
+{
+  //
+  // Summary usage
+  //
+  fprintf (stdout, "Usage: Lz4Compress -e|-d [options] <input_file>\n");
+  fprintf (stdout, "       Lz4Compress --benchmark <input_file> [<input_file> ...]\n\n");
+
+  //
+  // Copyright declaration
+  //
+  fprintf (stdout, "Copyright (c) Microsoft Corporation. All rights reserved.\n\n");
+
+  //
+  // Details Option
+  //
+  fprintf (stdout, "optional arguments:\n");
+  fprintf (stdout, "  -h, --help            Show this help message and exit\n");
+  fprintf (stdout, "  --version             Show program's version number and exit\n");
+  fprintf (stdout, "  --debug [DEBUG]       Output DEBUG statements, where DEBUG_LEVEL is 0 (min)\n\
+                        - 9 (max)\n");
+  fprintf (stdout, "  -v, --verbose         Print informational statements\n");
+  fprintf (stdout, "  -q, --quiet           Returns the exit code, error messages will be\n\
+                        displayed\n");
+  fprintf (stdout, "  -e, --encode          Compress the input file\n");
+  fprintf (stdout, "  -d, --decode          Decompress the input file\n");
+  fprintf (stdout, "  -o OUTPUT_FILENAME, --output OUTPUT_FILENAME\n\
+                        Output file name\n");
+  fprintf (stdout, "  --depth DEPTH         Number of matches tried at each position, 256 by\n\
+                        default. Only changes the compression time and ratio\n");
+  fprintf (stdout, "  --benchmark           Compare the ratio and the decompression speed of\n\
+                        LZ4, LZMA and Tiano on the input files\n");
+}
+
+STATIC
+UINT32
+Lz4Read32 (
+  IN CONST UINT8    *Buffer
+  )
+{
+  return (UINT32) Buffer[0] | ((UINT32) Buffer[1] << 8) | ((UINT32) Buffer[2] << 16) | ((UINT32) Buffer[3] << 24);
+}
+
+STATIC
+VOID
+Lz4Write32 (
+  IN UINT8          *Buffer,
+  IN UINT32         Value
+  )
+{
+  Buffer[0] = (UINT8) Value;
+  Buffer[1] = (UINT8) (Value >> 8);
+  Buffer[2] = (UINT8) (Value >> 16);
+  Buffer[3] = (UINT8) (Value >> 24);
+}
+
+STATIC
+UINT32
+Lz4Hash (
+  IN CONST UINT8    *Buffer
+  )
+{
+  return (Lz4Read32 (Buffer) * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+STATIC
+UINT32
+Lz4CompressBound (
+  IN UINT32         SrcSize
+  )
+{
+  return LZ4_SECTION_HEADER_SIZE + SrcSize + SrcSize / 255 + 16;
+}
+
+STATIC
+UINT8 *
+Lz4WriteLength (
+  IN UINT8          *Dst,
+  IN UINT32         Length
+  )
+{
+  while (Length >= 255) {
+    *Dst++ = 255;
+    Length -= 255;
+  }
+  *Dst++ = (UINT8) Length;
+  return Dst;
+}
+
+STATIC
+UINT8 *
+Lz4WriteSequence (
+  IN UINT8          *Dst,
+  IN CONST UINT8    *Literals,
+  IN UINT32         LiteralLength,
+  IN UINT32         Offset,
+  IN UINT32         MatchLength
+  )
+/*++
+
+Routine Description:
+
+  Writes a sequence of the LZ4 block format. The last sequence has no match,
+  MatchLength is then 0.
+
+--*/
+{
+  UINT8   *Token;
+
+  Token = Dst++;
+  *Token = (UINT8) ((LiteralLength >= LZ4_RUN_MASK ? LZ4_RUN_MASK : LiteralLength) << 4);
+  if (LiteralLength >= LZ4_RUN_MASK) {
+    Dst = Lz4WriteLength (Dst, LiteralLength - LZ4_RUN_MASK);
+  }
+  memcpy (Dst, Literals, LiteralLength);
+  Dst += LiteralLength;
+
+  if (MatchLength != 0) {
+    *Dst++ = (UINT8) Offset;
+    *Dst++ = (UINT8) (Offset >> 8);
+    MatchLength -= LZ4_MIN_MATCH;
+    *Token |= (UINT8) (MatchLength >= LZ4_RUN_MASK ? LZ4_RUN_MASK : MatchLength);
+    if (MatchLength >= LZ4_RUN_MASK) {
+      Dst = Lz4WriteLength (Dst, MatchLength - LZ4_RUN_MASK);
+    }
+  }
+
+  return Dst;
+}
+
+STATIC
+EFI_STATUS
+Lz4Encode (
+  IN     CONST UINT8    *Src,
+  IN     UINT32         SrcSize,
+  OUT    UINT8          *Dst,
+  IN OUT UINT32         *DstSize
+  )
+/*++
+
+Routine Description:
+
+  Compresses Src into an LZ4 section. Dst must hold Lz4CompressBound (SrcSize)
+  bytes.
+
+--*/
+{
+  INT32         *Head;
+  INT32         *Chain;
+  UINT8         *Out;
+  UINT32        Pos;
+  UINT32        Anchor;
+  UINT32        MatchLimit;
+  UINT32        Candidate;
+  UINT32        Length;
+  UINT32        BestLength;
+  UINT32        BestOffset;
+  UINT32        Depth;
+  UINT32        Hash;
+  INT32         Next;
+
+  if (*DstSize < Lz4CompressBound (SrcSize)) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Head  = (INT32 *) malloc (sizeof (INT32) << LZ4_HASH_LOG);
+  Chain = (INT32 *) malloc (sizeof (INT32) * (LZ4_WINDOW_MASK + 1));
+  if ((Head == NULL) || (Chain == NULL)) {
+    free (Head);
+    free (Chain);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  memset (Head, 0xFF, sizeof (INT32) << LZ4_HASH_LOG);
+
+  Lz4Write32 (Dst, LZ4_SECTION_SIGNATURE);
+  Lz4Write32 (Dst + 4, SrcSize);
+  Out = Dst + LZ4_SECTION_HEADER_SIZE;
+
+  Pos    = 0;
+  Anchor = 0;
+  if (SrcSize > LZ4_MF_LIMIT) {
+    MatchLimit = SrcSize - LZ4_LAST_LITERALS;
+    while (Pos <= SrcSize - LZ4_MF_LIMIT) {
+      //
+      // Longest match in the window, most recent candidates first
+      //
+      BestLength = 0;
+      BestOffset = 0;
+      Hash = Lz4Hash (Src + Pos);
+      Next = Head[Hash];
+      for (Depth = 0; (Next >= 0) && (Depth < mChainDepth); Depth++) {
+        Candidate = (UINT32) Next;
+        if (Pos - Candidate > LZ4_MAX_DISTANCE) {
+          break;
+        }
+        if ((Src[Candidate + BestLength] == Src[Pos + BestLength]) &&
+            (Lz4Read32 (Src + Candidate) == Lz4Read32 (Src + Pos))) {
+          for (Length = LZ4_MIN_MATCH; (Pos + Length < MatchLimit) && (Src[Candidate + Length] == Src[Pos + Length]); Length++) {
+          }
+          if (Length > BestLength) {
+            BestLength = Length;
+            BestOffset = Pos - Candidate;
+          }
+        }
+        Next = Chain[Candidate & LZ4_WINDOW_MASK];
+        if (Next >= (INT32) Candidate) {
+          break;
+        }
+      }
+
+      if (BestLength < LZ4_MIN_MATCH) {
+        Chain[Pos & LZ4_WINDOW_MASK] = Head[Hash];
+        Head[Hash] = (INT32) Pos;
+        Pos++;
+        continue;
+      }
+
+      Out = Lz4WriteSequence (Out, Src + Anchor, Pos - Anchor, BestOffset, BestLength);
+
+      //
+      // Index every position of the match, the next ones may refer to them
+      //
+      for (Length = 0; (Length < BestLength) && (Pos + LZ4_MIN_MATCH <= SrcSize); Length++, Pos++) {
+        Hash = Lz4Hash (Src + Pos);
+        Chain[Pos & LZ4_WINDOW_MASK] = Head[Hash];
+        Head[Hash] = (INT32) Pos;
+      }
+      Pos    = Anchor = Pos + (BestLength - Length);
+    }
+  }
+
+  Out = Lz4WriteSequence (Out, Src + Anchor, SrcSize - Anchor, 0, 0);
+  *DstSize = (UINT32) (Out - Dst);
+
+  free (Head);
+  free (Chain);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+Lz4Decode (
+  IN  CONST UINT8   *Src,
+  IN  UINT32        SrcSize,
+  OUT UINT8         *Dst,
+  IN  UINT32        DstSize
+  )
+/*++
+
+Routine Description:
+
+  Decompresses the LZ4 block of a section, same checks as the firmware
+  decompressor in IntelFrameworkModulePkg/Library/BaseLz4DecompressLib.
+
+--*/
+{
+  CONST UINT8   *In;
+  CONST UINT8   *InEnd;
+  UINT8         *Out;
+  UINT8         *OutEnd;
+  CONST UINT8   *Match;
+  UINT32        Token;
+  UINT32        Length;
+  UINT32        Offset;
+  UINT32        Byte;
+
+  In     = Src;
+  InEnd  = Src + SrcSize;
+  Out    = Dst;
+  OutEnd = Dst + DstSize;
+
+  for (;;) {
+    if (In >= InEnd) {
+      return EFI_INVALID_PARAMETER;
+    }
+    Token = *In++;
+
+    Length = Token >> 4;
+    if (Length == LZ4_RUN_MASK) {
+      do {
+        if (In >= InEnd) {
+          return EFI_INVALID_PARAMETER;
+        }
+        Byte = *In++;
+        Length += Byte;
+      } while (Byte == 255);
+    }
+    if ((Length > (UINT32) (InEnd - In)) || (Length > (UINT32) (OutEnd - Out))) {
+      return EFI_INVALID_PARAMETER;
+    }
+    memcpy (Out, In, Length);
+    In  += Length;
+    Out += Length;
+
+    if (In == InEnd) {
+      break;
+    }
+
+    if (InEnd - In < 2) {
+      return EFI_INVALID_PARAMETER;
+    }
+    Offset = In[0] | (In[1] << 8);
+    In += 2;
+    if ((Offset == 0) || (Offset > (UINT32) (Out - Dst))) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Length = Token & LZ4_RUN_MASK;
+    if (Length == LZ4_RUN_MASK) {
+      do {
+        if (In >= InEnd) {
+          return EFI_INVALID_PARAMETER;
+        }
+        Byte = *In++;
+        Length += Byte;
+      } while (Byte == 255);
+    }
+    Length += LZ4_MIN_MATCH;
+    if (Length > (UINT32) (OutEnd - Out)) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Match = Out - Offset;
+    while (Length-- != 0) {
+      *Out++ = *Match++;
+    }
+  }
+
+  return (Out == OutEnd) ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+}
+
+STATIC
+EFI_STATUS
+Lz4DecodeSection (
+  IN  CONST UINT8   *Src,
+  IN  UINT32        SrcSize,
+  OUT UINT8         **Dst,
+  OUT UINT32        *DstSize
+  )
+{
+  EFI_STATUS    Status;
+
+  if ((SrcSize < LZ4_SECTION_HEADER_SIZE) || (Lz4Read32 (Src) != LZ4_SECTION_SIGNATURE)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *DstSize = Lz4Read32 (Src + 4);
+  *Dst = (UINT8 *) malloc (*DstSize + 1);
+  if (*Dst == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Lz4Decode (Src + LZ4_SECTION_HEADER_SIZE, SrcSize - LZ4_SECTION_HEADER_SIZE, *Dst, *DstSize);
+  if (EFI_ERROR (Status)) {
+    free (*Dst);
+    *Dst = NULL;
+  }
+  return Status;
+}
+
+//
+// Benchmark
+//
+
+static void *SzAlloc(void *p, size_t size) { p = p; return malloc(size); }
+static void SzFree(void *p, void *address) { p = p; free(address); }
+static ISzAlloc g_Alloc = { SzAlloc, SzFree };
+
+typedef struct {
+  CONST CHAR8   *Name;
+  UINT32        CompressedSize;
+  double        DecodeSeconds;
+  UINT32        Iterations;
+} BENCHMARK_RESULT;
+
+STATIC
+double
+ElapsedSeconds (
+  IN clock_t    Start
+  )
+{
+  return (double) (clock () - Start) / CLOCKS_PER_SEC;
+}
+
+STATIC
+EFI_STATUS
+BenchmarkLz4 (
+  IN  UINT8             *Src,
+  IN  UINT32            SrcSize,
+  IN  UINT8             *Check,
+  OUT BENCHMARK_RESULT  *Result
+  )
+{
+  EFI_STATUS    Status;
+  UINT8         *Compressed;
+  UINT32        CompressedSize;
+  clock_t       Start;
+
+  CompressedSize = Lz4CompressBound (SrcSize);
+  Compressed = (UINT8 *) malloc (CompressedSize);
+  if (Compressed == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = Lz4Encode (Src, SrcSize, Compressed, &CompressedSize);
+  if (!EFI_ERROR (Status)) {
+    Result->CompressedSize = CompressedSize;
+    Result->Iterations = 0;
+    Start = clock ();
+    do {
+      Status = Lz4Decode (Compressed + LZ4_SECTION_HEADER_SIZE, CompressedSize - LZ4_SECTION_HEADER_SIZE, Check, SrcSize);
+      Result->Iterations++;
+    } while (!EFI_ERROR (Status) && (ElapsedSeconds (Start) < BENCHMARK_MIN_SECONDS));
+    Result->DecodeSeconds = ElapsedSeconds (Start);
+  }
+
+  free (Compressed);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+BenchmarkLzma (
+  IN  UINT8             *Src,
+  IN  UINT32            SrcSize,
+  IN  UINT8             *Check,
+  OUT BENCHMARK_RESULT  *Result
+  )
+{
+  CLzmaEncProps   Props;
+  UINT8           *Compressed;
+  SizeT           CompressedSize;
+  SizeT           PropsSize;
+  SizeT           InSize;
+  SizeT           OutSize;
+  ELzmaStatus     LzmaStatus;
+  SRes            Res;
+  clock_t         Start;
+
+  LzmaEncProps_Init (&Props);
+  LzmaEncProps_Normalize (&Props);
+
+  // Same margin as LzmaCompress
+  CompressedSize = SrcSize / 20 * 21 + (1 << 16);
+  Compressed = (UINT8 *) malloc (CompressedSize);
+  if (Compressed == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  PropsSize = LZMA_PROPS_SIZE;
+  CompressedSize -= LZMA_HEADER_SIZE;
+  Res = LzmaEncode (Compressed + LZMA_HEADER_SIZE, &CompressedSize, Src, SrcSize,
+          &Props, Compressed, &PropsSize, 0, NULL, &g_Alloc, &g_Alloc);
+  if (Res == SZ_OK) {
+    Result->CompressedSize = (UINT32) (LZMA_HEADER_SIZE + CompressedSize);
+    Result->Iterations = 0;
+    Start = clock ();
+    do {
+      InSize = CompressedSize;
+      OutSize = SrcSize;
+      Res = LzmaDecode (Check, &OutSize, Compressed + LZMA_HEADER_SIZE, &InSize,
+              Compressed, LZMA_PROPS_SIZE, LZMA_FINISH_END, &LzmaStatus, &g_Alloc);
+      Result->Iterations++;
+    } while ((Res == SZ_OK) && (ElapsedSeconds (Start) < BENCHMARK_MIN_SECONDS));
+    Result->DecodeSeconds = ElapsedSeconds (Start);
+  }
+
+  free (Compressed);
+  return (Res == SZ_OK) ? EFI_SUCCESS : EFI_ABORTED;
+}
+
+STATIC
+EFI_STATUS
+BenchmarkTiano (
+  IN  UINT8             *Src,
+  IN  UINT32            SrcSize,
+  IN  UINT8             *Check,
+  OUT BENCHMARK_RESULT  *Result
+  )
+{
+  EFI_STATUS    Status;
+  UINT8         *Compressed;
+  UINT32        CompressedSize;
+  UINT8         *Scratch;
+  UINT32        DstSize;
+  UINT32        ScratchSize;
+  clock_t       Start;
+
+  CompressedSize = 0;
+  Status = TianoCompress (Src, SrcSize, NULL, &CompressedSize);
+  if (Status != EFI_BUFFER_TOO_SMALL) {
+    return EFI_ABORTED;
+  }
+
+  Compressed = (UINT8 *) malloc (CompressedSize);
+  if (Compressed == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = TianoCompress (Src, SrcSize, Compressed, &CompressedSize);
+  if (!EFI_ERROR (Status)) {
+    Status = TianoGetInfo (Compressed, CompressedSize, &DstSize, &ScratchSize);
+  }
+  if (EFI_ERROR (Status)) {
+    free (Compressed);
+    return Status;
+  }
+
+  Scratch = (UINT8 *) malloc (ScratchSize);
+  if (Scratch == NULL) {
+    free (Compressed);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Result->CompressedSize = CompressedSize;
+  Result->Iterations = 0;
+  Start = clock ();
+  do {
+    Status = TianoDecompress (Compressed, CompressedSize, Check, SrcSize, Scratch, ScratchSize);
+    Result->Iterations++;
+  } while (!EFI_ERROR (Status) && (ElapsedSeconds (Start) < BENCHMARK_MIN_SECONDS));
+  Result->DecodeSeconds = ElapsedSeconds (Start);
+
+  free (Scratch);
+  free (Compressed);
+  return Status;
+}
+
+typedef
+EFI_STATUS
+(*BENCHMARK_FUNCTION) (
+  IN  UINT8             *Src,
+  IN  UINT32            SrcSize,
+  IN  UINT8             *Check,
+  OUT BENCHMARK_RESULT  *Result
+  );
+
+STATIC CONST struct {
+  CONST CHAR8           *Name;
+  BENCHMARK_FUNCTION    Function;
+} mBenchmarks[] = {
+  { "LZ4",    BenchmarkLz4 },
+  { "LZMA",   BenchmarkLzma },
+  { "Tiano",  BenchmarkTiano }
+};
+
+STATIC
+EFI_STATUS
+Benchmark (
+  IN CHAR8          *FileName,
+  IN UINT8          *FileBuffer,
+  IN UINT32         FileSize
+  )
+/*++
+
+Routine Description:
+
+  Compresses the file with every algorithm, then decompresses it repeatedly
+  for at least BENCHMARK_MIN_SECONDS of CPU time. Every decompressed copy is
+  checked against the input.
+
+--*/
+{
+  EFI_STATUS        Status;
+  UINT8             *Check;
+  BENCHMARK_RESULT  Result;
+  UINTN             Index;
+
+  Check = (UINT8 *) malloc (FileSize + 1);
+  if (Check == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  fprintf (stdout, "%s: %u bytes\n", FileName, (unsigned) FileSize);
+  fprintf (stdout, "  %-8s %12s %8s %14s\n", "Format", "Compressed", "Ratio", "Decode (MB/s)");
+
+  Status = EFI_SUCCESS;
+  for (Index = 0; Index < sizeof (mBenchmarks) / sizeof (mBenchmarks[0]); Index++) {
+    memset (Check, 0, FileSize);
+    Status = mBenchmarks[Index].Function (FileBuffer, FileSize, Check, &Result);
+    if (!EFI_ERROR (Status) && (memcmp (Check, FileBuffer, FileSize) != 0)) {
+      Status = EFI_VOLUME_CORRUPTED;
+    }
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 3000, "Benchmark failed", "%s on %s", mBenchmarks[Index].Name, FileName);
+      break;
+    }
+
+    fprintf (stdout, "  %-8s %12u %7.2f%% %14.1f\n",
+      mBenchmarks[Index].Name,
+      (unsigned) Result.CompressedSize,
+      100.0 * Result.CompressedSize / FileSize,
+      ((double) FileSize * Result.Iterations) / (Result.DecodeSeconds * 1024 * 1024));
+  }
+
+  free (Check);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+ReadInputFile (
+  IN  CHAR8         *FileName,
+  OUT UINT8         **FileBuffer,
+  OUT UINT32        *FileSize
+  )
+{
+  FILE    *InFile;
+
+  InFile = fopen (LongFilePath (FileName), "rb");
+  if (InFile == NULL) {
+    Error (NULL, 0, 0001, "Error opening file", FileName);
+    return EFI_ABORTED;
+  }
+
+  fseek (InFile, 0, SEEK_END);
+  *FileSize = ftell (InFile);
+  fseek (InFile, 0, SEEK_SET);
+
+  *FileBuffer = (UINT8 *) malloc (*FileSize + 1);
+  if (*FileBuffer == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    fclose (InFile);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (fread (*FileBuffer, 1, *FileSize, InFile) != *FileSize) {
+    Error (NULL, 0, 0004, "Error reading file", FileName);
+    free (*FileBuffer);
+    fclose (InFile);
+    return EFI_ABORTED;
+  }
+
+  fclose (InFile);
+  VerboseMsg ("the size of %s is %u bytes", FileName, (unsigned) *FileSize);
+  return EFI_SUCCESS;
+}
+
+int
+main (
+  int   argc,
+  CHAR8 *argv[]
+  )
+/*++
+
+Routine Description:
+
+  Main function.
+
+Arguments:
+
+  argc - Number of command line parameters.
+  argv - Array of pointers to parameter strings.
+
+Returns:
+  STATUS_SUCCESS - Utility exits successfully.
+  STATUS_ERROR   - Some error occurred during execution.
+
+--*/
+{
+  EFI_STATUS              Status;
+  CHAR8                   *OutputFileName;
+  CHAR8                   **InputFileNames;
+  UINT32                  InputFileCount;
+  UINT8                   *FileBuffer;
+  UINT32                  FileSize;
+  UINT8                   *OutputBuffer;
+  UINT32                  OutputSize;
+  UINT64                  Value;
+  UINT8                   FileAction;
+  FILE                    *OutFile;
+  UINT32                  Index;
+
+  //
+  // Init local variables
+  //
+  OutputFileName = NULL;
+  InputFileCount = 0;
+  FileAction     = LZ4_ACTION_NULL;
+  FileBuffer     = NULL;
+  OutputBuffer   = NULL;
+  OutFile        = NULL;
+
+  SetUtilityName (UTILITY_NAME);
+
+  if (argc == 1) {
+    Error (NULL, 0, 1001, "Missing options", "no options input");
+    Usage ();
+    return STATUS_ERROR;
+  }
+
+  InputFileNames = (CHAR8 **) malloc (argc * sizeof (CHAR8 *));
+  if (InputFileNames == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return STATUS_ERROR;
+  }
+
+  //
+  // Parse command line
+  //
+  argc --;
+  argv ++;
+
+  if ((stricmp (argv[0], "-h") == 0) || (stricmp (argv[0], "--help") == 0)) {
+    Usage ();
+    return STATUS_SUCCESS;
+  }
+
+  if (stricmp (argv[0], "--version") == 0) {
+    Version ();
+    return STATUS_SUCCESS;
+  }
+
+  while (argc > 0) {
+    if ((stricmp (argv[0], "-o") == 0) || (stricmp (argv[0], "--output") == 0)) {
+      if (argv[1] == NULL || argv[1][0] == '-') {
+        Error (NULL, 0, 1003, "Invalid option value", "Output File name is missing for -o option");
+        goto Finish;
+      }
+      OutputFileName = argv[1];
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-e") == 0) || (stricmp (argv[0], "--encode") == 0)) {
+      FileAction = LZ4_ACTION_ENCODE;
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-d") == 0) || (stricmp (argv[0], "--decode") == 0)) {
+      FileAction = LZ4_ACTION_DECODE;
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if (stricmp (argv[0], "--benchmark") == 0) {
+      FileAction = LZ4_ACTION_BENCHMARK;
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if (stricmp (argv[0], "--depth") == 0) {
+      Status = AsciiStringToUint64 (argv[1], FALSE, &Value);
+      if (EFI_ERROR (Status) || (Value == 0) || (Value > 65536)) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        goto Finish;
+      }
+      mChainDepth = (UINT32) Value;
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-v") == 0) || (stricmp (argv[0], "--verbose") == 0)) {
+      SetPrintLevel (VERBOSE_LOG_LEVEL);
+      VerboseMsg ("Verbose output Mode Set!");
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-q") == 0) || (stricmp (argv[0], "--quiet") == 0)) {
+      SetPrintLevel (KEY_LOG_LEVEL);
+      KeyMsg ("Quiet output Mode Set!");
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if (stricmp (argv[0], "--debug") == 0) {
+      Status = AsciiStringToUint64 (argv[1], FALSE, &Value);
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        goto Finish;
+      }
+      if (Value > 9) {
+        Error (NULL, 0, 1003, "Invalid option value", "Debug Level range is 0-9, current input level is %d", (int) Value);
+        goto Finish;
+      }
+      SetPrintLevel (Value);
+      DebugMsg (NULL, 0, 9, "Debug Mode Set", "Debug Output Mode Level %s is set!", argv[1]);
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    if (argv[0][0] == '-') {
+      Error (NULL, 0, 1000, "Unknown option", argv[0]);
+      goto Finish;
+    }
+
+    //
+    // Get Input file file name.
+    //
+    InputFileNames[InputFileCount++] = argv[0];
+    argc --;
+    argv ++;
+  }
+
+  VerboseMsg ("%s tool start.", UTILITY_NAME);
+
+  //
+  // Check Input paramters
+  //
+  if (FileAction == LZ4_ACTION_NULL) {
+    Error (NULL, 0, 1001, "Missing option", "the encode, decode or benchmark option must be specified!");
+    goto Finish;
+  }
+
+  if (InputFileCount == 0) {
+    Error (NULL, 0, 1001, "Missing option", "Input files are not specified");
+    goto Finish;
+  }
+
+  if (FileAction == LZ4_ACTION_BENCHMARK) {
+    for (Index = 0; Index < InputFileCount; Index++) {
+      Status = ReadInputFile (InputFileNames[Index], &FileBuffer, &FileSize);
+      if (EFI_ERROR (Status)) {
+        goto Finish;
+      }
+      Status = Benchmark (InputFileNames[Index], FileBuffer, FileSize);
+      free (FileBuffer);
+      FileBuffer = NULL;
+      if (EFI_ERROR (Status)) {
+        goto Finish;
+      }
+    }
+    goto Finish;
+  }
+
+  if (InputFileCount > 1) {
+    Error (NULL, 0, 1003, "Invalid option value", "Only one input file can be encoded or decoded");
+    goto Finish;
+  }
+
+  if (OutputFileName == NULL) {
+    Error (NULL, 0, 1001, "Missing option", "Output file are not specified");
+    goto Finish;
+  }
+  VerboseMsg ("Output file name is %s", OutputFileName);
+
+  Status = ReadInputFile (InputFileNames[0], &FileBuffer, &FileSize);
+  if (EFI_ERROR (Status)) {
+    goto Finish;
+  }
+
+  if (FileAction == LZ4_ACTION_ENCODE) {
+    OutputSize = Lz4CompressBound (FileSize);
+    OutputBuffer = (UINT8 *) malloc (OutputSize);
+    if (OutputBuffer == NULL) {
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+      goto Finish;
+    }
+    Status = Lz4Encode (FileBuffer, FileSize, OutputBuffer, &OutputSize);
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 3000, "Invalid", "LZ4 compression failed!");
+      goto Finish;
+    }
+  } else {
+    Status = Lz4DecodeSection (FileBuffer, FileSize, &OutputBuffer, &OutputSize);
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 3000, "Invalid", "the input file is not a valid LZ4 section!");
+      goto Finish;
+    }
+  }
+
+  //
+  // Done, write output file.
+  //
+  OutFile = fopen (LongFilePath (OutputFileName), "wb");
+  if (OutFile == NULL) {
+    Error (NULL, 0, 0001, "Error opening file", OutputFileName);
+    goto Finish;
+  }
+  if (fwrite (OutputBuffer, 1, OutputSize, OutFile) != OutputSize) {
+    Error (NULL, 0, 0002, "Error writing file", OutputFileName);
+    goto Finish;
+  }
+  VerboseMsg ("the size of the output file is %u bytes", (unsigned) OutputSize);
+
+Finish:
+  free (FileBuffer);
+  free (OutputBuffer);
+  free (InputFileNames);
+
+  if (OutFile != NULL) {
+    fclose (OutFile);
+  }
+
+  VerboseMsg ("%s tool done with return code is 0x%x.", UTILITY_NAME, GetUtilityStatus ());
+
+  return GetUtilityStatus ();
+}
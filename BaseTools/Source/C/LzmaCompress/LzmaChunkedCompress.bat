@@ -0,0 +1,33 @@
+@REM @file
+@REM This script will exec LzmaCompress tool with --chunk-size option that splits
+@REM the data in chunks compressed independently, so that they can be decoded in
+@REM parallel.
+@REM
+@REM Copyright (c) Microsoft Corporation. All rights reserved.
+@REM This program and the accompanying materials
+@REM are licensed and made available under the terms and conditions of the BSD License
+@REM which accompanies this distribution.  The full text of the license may be found at
+@REM http://opensource.org/licenses/bsd-license.php
+@REM
+@REM THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+@REM WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+@REM
+
+@echo off
+@setlocal
+
+:Begin
+if "%1"=="" goto End
+if "%1"=="-e" (
+  set FLAG=--chunk-size 0x40000
+)
+if "%1"=="-d" (
+  set FLAG=--chunk-size 0x40000
+)
+set ARGS=%ARGS% %1
+shift
+goto Begin
+
+:End
+LzmaCompress %ARGS% %FLAG%
+@echo on
@@ -32,6 +32,13 @@
 
 #define LZMA_HEADER_SIZE (LZMA_PROPS_SIZE + 8)
 
+//
+// Chunked format, see LZMA_CHUNKED_HEADER in
+// IntelFrameworkModulePkg/Include/Guid/LzmaDecompress.h
+//
+#define LZMA_CHUNKED_SIGNATURE    0x4B435A4C   // 'LZCK'
+#define LZMA_CHUNKED_HEADER_SIZE  24
+
 typedef enum {
   NoConverter, 
   X86Converter,
@@ -49,6 +56,7 @@ static ISzAlloc g_Alloc = { SzAlloc, SzFree };
 
 static Bool mQuietMode = False;
 static CONVERTER_TYPE mConType = NoConverter;
+static UInt32 mChunkSize = 0;
 
 #define UTILITY_NAME "LzmaCompress"
 #define UTILITY_MAJOR_VERSION 0
@@ -65,6 +73,8 @@ void PrintHelp(char *buffer)
              "  -d: decode file\n"
              "  -o FileName, --output FileName: specify the output filename\n"
              "  --f86: enable converter for x86 code\n"
+             "  --chunk-size Size: split the data in chunks of Size bytes compressed\n"
+             "                     independently, -d then expects the chunked format\n"
              "  -v, --verbose: increase output messages\n"
              "  -q, --quiet: reduce output messages\n"
              "  --debug [0-9]: set debug level\n"
@@ -181,6 +191,175 @@ Done:
   return res;
 }
 
+static void SetUi32(Byte *p, UInt32 v)
+{
+  p[0] = (Byte)v;
+  p[1] = (Byte)(v >> 8);
+  p[2] = (Byte)(v >> 16);
+  p[3] = (Byte)(v >> 24);
+}
+
+static UInt32 GetUi32(const Byte *p)
+{
+  return (UInt32)p[0] | ((UInt32)p[1] << 8) | ((UInt32)p[2] << 16) | ((UInt32)p[3] << 24);
+}
+
+static SRes EncodeChunked(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
+{
+  SRes res;
+  size_t inSize = (size_t)fileSize;
+  Byte *inBuffer = 0;
+  Byte *outBuffer = 0;
+  size_t outSize;
+  size_t outPos;
+  size_t indexSize;
+  UInt32 chunkCount;
+  UInt32 chunk;
+  CLzmaEncProps props;
+
+  LzmaEncProps_Init(&props);
+  LzmaEncProps_Normalize(&props);
+
+  if (fileSize > 0xFFFFFFFF)
+    return SZ_ERROR_UNSUPPORTED;
+
+  // empty data is encoded as a header with no chunks
+  if (inSize != 0) {
+    inBuffer = (Byte *)MyAlloc(inSize);
+    if (inBuffer == 0)
+      return SZ_ERROR_MEM;
+
+    if (SeqInStream_Read(inStream, inBuffer, inSize) != SZ_OK) {
+      res = SZ_ERROR_READ;
+      goto Done;
+    }
+  }
+
+  chunkCount = (UInt32)((inSize + mChunkSize - 1) / mChunkSize);
+  indexSize = LZMA_CHUNKED_HEADER_SIZE + ((size_t)chunkCount + 1) * 4;
+
+  // same margin as Encode() for every chunk
+  outSize = indexSize + inSize / 20 * 21 + (size_t)chunkCount * (LZMA_HEADER_SIZE + (1 << 16));
+  outBuffer = (Byte *)MyAlloc(outSize);
+  if (outBuffer == 0) {
+    res = SZ_ERROR_MEM;
+    goto Done;
+  }
+
+  memset(outBuffer, 0, indexSize);
+  SetUi32(outBuffer, LZMA_CHUNKED_SIGNATURE);
+  SetUi32(outBuffer + 4, mChunkSize);
+  SetUi32(outBuffer + 8, chunkCount);
+  SetUi32(outBuffer + 16, (UInt32)fileSize);
+
+  res = SZ_OK;
+  outPos = indexSize;
+  for (chunk = 0; chunk < chunkCount; chunk++) {
+    size_t chunkPos = (size_t)chunk * mChunkSize;
+    size_t chunkSize = inSize - chunkPos < mChunkSize ? inSize - chunkPos : mChunkSize;
+    size_t outSizeProcessed = outSize - outPos - LZMA_HEADER_SIZE;
+    size_t outPropsSize = LZMA_PROPS_SIZE;
+    int i;
+
+    SetUi32(outBuffer + LZMA_CHUNKED_HEADER_SIZE + chunk * 4, (UInt32)outPos);
+    for (i = 0; i < 8; i++)
+      outBuffer[outPos + LZMA_PROPS_SIZE + i] = (Byte)((UInt64)chunkSize >> (8 * i));
+
+    res = LzmaEncode(outBuffer + outPos + LZMA_HEADER_SIZE, &outSizeProcessed,
+        inBuffer + chunkPos, chunkSize,
+        &props, outBuffer + outPos, &outPropsSize, 0,
+        NULL, &g_Alloc, &g_Alloc);
+    if (res != SZ_OK)
+      goto Done;
+
+    outPos += LZMA_HEADER_SIZE + outSizeProcessed;
+  }
+  SetUi32(outBuffer + LZMA_CHUNKED_HEADER_SIZE + chunkCount * 4, (UInt32)outPos);
+
+  if (outStream->Write(outStream, outBuffer, outPos) != outPos)
+    res = SZ_ERROR_WRITE;
+
+Done:
+  MyFree(outBuffer);
+  MyFree(inBuffer);
+
+  return res;
+}
+
+static SRes DecodeChunked(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
+{
+  SRes res;
+  size_t inSize = (size_t)fileSize;
+  Byte *inBuffer = 0;
+  Byte *outBuffer = 0;
+  size_t outSize;
+  UInt32 chunkSize;
+  UInt32 chunkCount;
+  UInt32 chunk;
+
+  if (inSize < LZMA_CHUNKED_HEADER_SIZE + 4)
+    return SZ_ERROR_INPUT_EOF;
+
+  inBuffer = (Byte *)MyAlloc(inSize);
+  if (inBuffer == 0)
+    return SZ_ERROR_MEM;
+
+  if (SeqInStream_Read(inStream, inBuffer, inSize) != SZ_OK) {
+    res = SZ_ERROR_READ;
+    goto Done;
+  }
+
+  chunkSize = GetUi32(inBuffer + 4);
+  chunkCount = GetUi32(inBuffer + 8);
+  outSize = GetUi32(inBuffer + 16);
+  if ((GetUi32(inBuffer) != LZMA_CHUNKED_SIGNATURE) || (GetUi32(inBuffer + 20) != 0) ||
+      (chunkSize == 0) || (chunkCount != (outSize + chunkSize - 1) / chunkSize) ||
+      (inSize < LZMA_CHUNKED_HEADER_SIZE + ((size_t)chunkCount + 1) * 4)) {
+    res = SZ_ERROR_DATA;
+    goto Done;
+  }
+
+  if (outSize == 0) {
+    res = SZ_OK;
+    goto Done;
+  }
+
+  outBuffer = (Byte *)MyAlloc(outSize);
+  if (outBuffer == 0) {
+    res = SZ_ERROR_MEM;
+    goto Done;
+  }
+
+  for (chunk = 0; chunk < chunkCount; chunk++) {
+    size_t chunkStart = GetUi32(inBuffer + LZMA_CHUNKED_HEADER_SIZE + chunk * 4);
+    size_t chunkEnd = GetUi32(inBuffer + LZMA_CHUNKED_HEADER_SIZE + (chunk + 1) * 4);
+    size_t outPos = (size_t)chunk * chunkSize;
+    size_t outChunkSize = outSize - outPos < chunkSize ? outSize - outPos : chunkSize;
+    size_t inSizePure;
+    ELzmaStatus status;
+
+    if ((chunkEnd > inSize) || (chunkStart + LZMA_HEADER_SIZE > chunkEnd)) {
+      res = SZ_ERROR_DATA;
+      goto Done;
+    }
+
+    inSizePure = chunkEnd - chunkStart - LZMA_HEADER_SIZE;
+    res = LzmaDecode(outBuffer + outPos, &outChunkSize, inBuffer + chunkStart + LZMA_HEADER_SIZE, &inSizePure,
+        inBuffer + chunkStart, LZMA_PROPS_SIZE, LZMA_FINISH_END, &status, &g_Alloc);
+    if (res != SZ_OK)
+      goto Done;
+  }
+
+  if (outStream->Write(outStream, outBuffer, outSize) != outSize)
+    res = SZ_ERROR_WRITE;
+
+Done:
+  MyFree(outBuffer);
+  MyFree(inBuffer);
+
+  return res;
+}
+
 static SRes Decode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
 {
   SRes res;
@@ -275,6 +454,14 @@ int main2(int numArgs, const char *args[], char *rs)
       modeWasSet = True;
     } else if (strcmp(args[param], "--f86") == 0) {
       mConType = X86Converter;
+    } else if (strcmp(args[param], "--chunk-size") == 0) {
+      if (numArgs < (param + 2)) {
+        return PrintUserError(rs);
+      }
+      mChunkSize = (UInt32)strtoul(args[++param], NULL, 0);
+      if (mChunkSize == 0) {
+        return PrintUserError(rs);
+      }
     } else if (strcmp(args[param], "-o") == 0 ||
                strcmp(args[param], "--output") == 0) {
       if (numArgs < (param + 2)) {
@@ -323,6 +510,10 @@ int main2(int numArgs, const char *args[], char *rs)
     return PrintUserError(rs);
   }
 
+  if ((mChunkSize != 0) && (mConType != NoConverter)) {
+    return PrintError(rs, "--chunk-size can not be combined with a converter");
+  }
+
   {
     size_t t4 = sizeof(UInt32);
     size_t t8 = sizeof(UInt64);
@@ -343,14 +534,22 @@ int main2(int numArgs, const char *args[], char *rs)
     if (!mQuietMode) {
       printf("Encoding\n");
     }
-    res = Encode(&outStream.s, &inStream.s, fileSize);
+    if (mChunkSize != 0) {
+      res = EncodeChunked(&outStream.s, &inStream.s, fileSize);
+    } else {
+      res = Encode(&outStream.s, &inStream.s, fileSize);
+    }
   }
   else
   {
     if (!mQuietMode) {
       printf("Decoding\n");
     }
-    res = Decode(&outStream.s, &inStream.s, fileSize);
+    if (mChunkSize != 0) {
+      res = DecodeChunked(&outStream.s, &inStream.s, fileSize);
+    } else {
+      res = Decode(&outStream.s, &inStream.s, fileSize);
+    }
   }
 
   File_Close(&outStream.file);
@@ -63,8 +63,10 @@ typedef UINT32 MMC_CMD;
 #define MMC_CMD20             (MMC_INDX(20) | MMC_CMD_WAIT_RESPONSE)
 #define MMC_CMD23             (MMC_INDX(23) | MMC_CMD_WAIT_RESPONSE)
 #define MMC_CMD24             (MMC_INDX(24) | MMC_CMD_WAIT_RESPONSE)
+#define MMC_CMD25             (MMC_INDX(25) | MMC_CMD_WAIT_RESPONSE)
 #define MMC_CMD55             (MMC_INDX(55) | MMC_CMD_WAIT_RESPONSE)
 #define MMC_ACMD6             (MMC_INDX(6) | MMC_CMD_WAIT_RESPONSE | MMC_CMD_NO_CRC_RESPONSE)
+#define MMC_ACMD23            (MMC_INDX(23) | MMC_CMD_WAIT_RESPONSE)
 #define MMC_ACMD41            (MMC_INDX(41) | MMC_CMD_WAIT_RESPONSE | MMC_CMD_NO_CRC_RESPONSE)
 
 // Valid responses for CMD1 in eMMC
@@ -134,6 +136,32 @@ typedef EFI_STATUS (EFIAPI *MMC_WRITEBLOCKDATA) (
   IN  UINT32                    *Buffer
   );
 
+//
+// Returns TRUE if ReadBlockData()/WriteBlockData() accept the data of a whole
+// multiple block transfer in a single call instead of one block at a time
+//
+typedef BOOLEAN (EFIAPI *MMC_ISMULTIBLOCK) (
+  IN  EFI_MMC_HOST_PROTOCOL     *This
+  );
+
+//
+// Starts moving the data of the transfer whose command was just sent and returns
+// without waiting for it. Hosts that can't leave this transfer running move the
+// data before returning. PollBlockData() returns EFI_NOT_READY as long as the data
+// is moving and the outcome of the transfer once it is over.
+//
+typedef EFI_STATUS (EFIAPI *MMC_STARTBLOCKDATA) (
+  IN  EFI_MMC_HOST_PROTOCOL     *This,
+  IN  BOOLEAN                   IsRead,
+  IN  EFI_LBA                   Lba,
+  IN  UINTN                     Length,
+  IN  UINT32                    *Buffer
+  );
+
+typedef EFI_STATUS (EFIAPI *MMC_POLLBLOCKDATA) (
+  IN  EFI_MMC_HOST_PROTOCOL     *This
+  );
+
 
 struct _EFI_MMC_HOST_PROTOCOL {
 
@@ -150,9 +178,20 @@ struct _EFI_MMC_HOST_PROTOCOL {
   MMC_READBLOCKDATA       ReadBlockData;
   MMC_WRITEBLOCKDATA      WriteBlockData;
 
+  MMC_ISMULTIBLOCK        IsMultiBlock;
+
+  MMC_STARTBLOCKDATA      StartBlockData;
+  MMC_POLLBLOCKDATA       PollBlockData;
+
 };
 
-#define MMC_HOST_PROTOCOL_REVISION    0x00010001    // 1.1
+#define MMC_HOST_PROTOCOL_REVISION    0x00010003    // 1.3
+
+#define MMC_HOST_HAS_ISMULTIBLOCK(Host)   (Host->Revision >= 0x00010002 && \
+                                           Host->IsMultiBlock != NULL)
+#define MMC_HOST_HAS_ASYNCBLOCKDATA(Host) (Host->Revision >= MMC_HOST_PROTOCOL_REVISION && \
+                                           Host->StartBlockData != NULL && \
+                                           Host->PollBlockData != NULL)
 
 extern EFI_GUID gEfiMmcHostProtocolGuid;
 
@@ -473,12 +473,13 @@ MapFd0 (
     }
   }
 
-  // Map the rest of the FD as read/write
+  // Map the rest of the FD as read/write, the writes go to the FD file unless
+  // a driver writes the NV storage back itself
   res2 = mmap (
           (void *)(UINTN)(FixedPcdGet64 (PcdEmuFlashFvRecoveryBase) + FvSize),
           FileSize - FvSize,
           PROT_READ | PROT_WRITE | PROT_EXEC,
-          MAP_SHARED,
+          FixedPcdGetBool (PcdEmuFlashNvStorageShared) ? MAP_SHARED : MAP_PRIVATE,
           fd,
           FvSize
           );
@@ -0,0 +1,41 @@
+/** @file
+  LZ4 Custom decompress algorithm Guid definition.
+
+Copyright (c) Microsoft Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available under
+the terms and conditions of the BSD License that accompanies this distribution.
+The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php.
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __LZ4_DECOMPRESS_GUID_H__
+#define __LZ4_DECOMPRESS_GUID_H__
+
+///
+/// The Global ID used to identify a section of an FFS file of type
+/// EFI_SECTION_GUID_DEFINED, whose contents have been compressed using LZ4.
+/// LZ4 compresses less than LZMA but decompresses an order of magnitude faster.
+///
+#define LZ4_CUSTOM_DECOMPRESS_GUID  \
+  { 0xA001F3D9, 0x08AF, 0x4465, { 0xB9, 0x42, 0x0A, 0xD0, 0x0F, 0xB2, 0xEE, 0x2E } }
+
+#define LZ4_SECTION_SIGNATURE  SIGNATURE_32 ('L', 'Z', '4', 'B')
+
+///
+/// Header of the data of an LZ4 section. It is followed by a single LZ4 block,
+/// in the format of the LZ4 reference implementation, that decodes to
+/// UncompressedSize bytes. The same layout is produced by the BaseTools
+/// Lz4Compress tool.
+///
+typedef struct {
+  UINT32  Signature;
+  UINT32  UncompressedSize;
+} LZ4_SECTION_HEADER;
+
+extern GUID gLz4CustomDecompressGuid;
+
+#endif
@@ -29,7 +29,33 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define LZMAF86_CUSTOM_DECOMPRESS_GUID  \
   { 0xD42AE6BD, 0x1352, 0x4bfb, { 0x90, 0x9A, 0xCA, 0x72, 0xA6, 0xEA, 0xE8, 0x89 } }
 
+///
+/// The Global ID used to identify a section of an FFS file of type 
+/// EFI_SECTION_GUID_DEFINED, whose contents have been split in chunks compressed
+/// independently using LZMA, so that they can be decoded in parallel.
+///
+#define LZMA_CHUNKED_CUSTOM_DECOMPRESS_GUID  \
+  { 0xE3E6AD53, 0xFA47, 0x464E, { 0x8A, 0x74, 0x7F, 0x13, 0xC8, 0x79, 0x93, 0xC6 } }
+
+#define LZMA_CHUNKED_SIGNATURE  SIGNATURE_32 ('L', 'Z', 'C', 'K')
+
+///
+/// Header of the data of an LZMA chunked section. It is followed by ChunkCount + 1
+/// UINT32 offsets, from the start of the header, of every chunk and of the end of
+/// the last one. Each chunk is a complete LZMA stream, with its own 13 byte header,
+/// that decodes to ChunkSize bytes but the last one that holds the remainder.
+/// The same layout is produced by the BaseTools LzmaCompress --chunk-size option.
+///
+typedef struct {
+  UINT32  Signature;
+  UINT32  ChunkSize;
+  UINT32  ChunkCount;
+  UINT32  Reserved;
+  UINT64  UncompressedSize;
+} LZMA_CHUNKED_HEADER;
+
 extern GUID gLzmaCustomDecompressGuid;
 extern GUID gLzmaF86CustomDecompressGuid;
+extern GUID gLzmaChunkedCustomDecompressGuid;
 
 #endif
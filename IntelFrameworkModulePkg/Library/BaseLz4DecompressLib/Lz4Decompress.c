@@ -0,0 +1,354 @@
+/** @file
+  LZ4 Decompress GUIDed Section Extraction Library.
+
+  Decodes sections made of an LZ4_SECTION_HEADER followed by a single LZ4
+  block, as produced by the BaseTools Lz4Compress tool. The decoder needs no
+  scratch buffer and checks every length and offset against the input and the
+  output buffers, a corrupted section can not make it read or write out of them.
+
+  Copyright (c) Microsoft Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <PiPei.h>
+#include <Guid/Lz4Decompress.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/ExtractGuidedSectionLib.h>
+
+#define LZ4_MIN_MATCH         4
+#define LZ4_RUN_MASK          15
+
+//
+// Shorter copies are done byte per byte, CopyMem() does not pay off for them
+//
+#define LZ4_SHORT_COPY        16
+
+/**
+  Reads the extension bytes of a literal or match length.
+
+  @param[in, out] Input     The current position in the block, updated.
+  @param[in]      InputEnd  The end of the block.
+  @param[in, out] Length    The length from the token, updated.
+
+  @retval TRUE    The length was read.
+  @retval FALSE   The block ends in the middle of the length.
+
+**/
+STATIC
+BOOLEAN
+Lz4ReadLength (
+  IN OUT CONST UINT8  **Input,
+  IN     CONST UINT8  *InputEnd,
+  IN OUT UINT32       *Length
+  )
+{
+  CONST UINT8   *In;
+  UINT32        Byte;
+
+  In = *Input;
+  do {
+    if (In >= InputEnd) {
+      return FALSE;
+    }
+    Byte = *In++;
+    *Length += Byte;
+  } while (Byte == 255);
+
+  *Input = In;
+  return TRUE;
+}
+
+/**
+  Decodes an LZ4 block.
+
+  @param[in]  Source        The LZ4 block.
+  @param[in]  SourceSize    The size of the LZ4 block.
+  @param[out] Destination   The buffer for the decoded data.
+  @param[in]  DecodedSize   The size the block decodes to.
+
+  @retval RETURN_SUCCESS            The block was decoded to exactly DecodedSize bytes.
+  @retval RETURN_INVALID_PARAMETER  The block is corrupted.
+
+**/
+STATIC
+RETURN_STATUS
+Lz4DecodeBlock (
+  IN  CONST UINT8   *Source,
+  IN  UINT32        SourceSize,
+  OUT UINT8         *Destination,
+  IN  UINT32        DecodedSize
+  )
+{
+  CONST UINT8   *In;
+  CONST UINT8   *InEnd;
+  UINT8         *Out;
+  UINT8         *OutEnd;
+  CONST UINT8   *Match;
+  UINT32        Token;
+  UINT32        Length;
+  UINT32        Offset;
+
+  In     = Source;
+  InEnd  = Source + SourceSize;
+  Out    = Destination;
+  OutEnd = Destination + DecodedSize;
+
+  for (;;) {
+    if (In >= InEnd) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    Token = *In++;
+
+    //
+    // Literals
+    //
+    Length = Token >> 4;
+    if ((Length == LZ4_RUN_MASK) && !Lz4ReadLength (&In, InEnd, &Length)) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    if ((Length > (UINTN)(InEnd - In)) || (Length > (UINTN)(OutEnd - Out))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    if (Length > LZ4_SHORT_COPY) {
+      CopyMem (Out, In, Length);
+      In  += Length;
+      Out += Length;
+    } else {
+      while (Length-- != 0) {
+        *Out++ = *In++;
+      }
+    }
+
+    //
+    // The last sequence has no match
+    //
+    if (In == InEnd) {
+      break;
+    }
+
+    //
+    // Match
+    //
+    if (InEnd - In < 2) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    Offset = In[0] | (In[1] << 8);
+    In += 2;
+    if ((Offset == 0) || (Offset > (UINTN)(Out - Destination))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    Length = Token & LZ4_RUN_MASK;
+    if ((Length == LZ4_RUN_MASK) && !Lz4ReadLength (&In, InEnd, &Length)) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    Length += LZ4_MIN_MATCH;
+    if (Length > (UINTN)(OutEnd - Out)) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    //
+    // A match closer than its length repeats the bytes it is producing
+    //
+    Match = Out - Offset;
+    if ((Offset >= Length) && (Length > LZ4_SHORT_COPY)) {
+      CopyMem (Out, Match, Length);
+      Out += Length;
+    } else {
+      while (Length-- != 0) {
+        *Out++ = *Match++;
+      }
+    }
+  }
+
+  if (Out != OutEnd) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Returns the data of an LZ4 GUIDed section.
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] Data          The data of the section.
+  @param[out] DataSize      The size of the data of the section.
+  @param[out] Attributes    The attributes of the GUIDed section.
+
+  @retval RETURN_SUCCESS            The section is an LZ4 section.
+  @retval RETURN_INVALID_PARAMETER  The section is not an LZ4 section.
+
+**/
+STATIC
+RETURN_STATUS
+Lz4GetSectionData (
+  IN  CONST VOID            *InputSection,
+  OUT CONST UINT8           **Data,
+  OUT UINT32                *DataSize,
+  OUT UINT16                *Attributes
+  )
+{
+  CONST EFI_GUID  *Guid;
+  UINT32          SectionSize;
+  UINT16          DataOffset;
+
+  if (IS_SECTION2 (InputSection)) {
+    Guid        = &((EFI_GUID_DEFINED_SECTION2 *) InputSection)->SectionDefinitionGuid;
+    SectionSize = SECTION2_SIZE (InputSection);
+    DataOffset  = ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset;
+    *Attributes = ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->Attributes;
+  } else {
+    Guid        = &((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid;
+    SectionSize = SECTION_SIZE (InputSection);
+    DataOffset  = ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset;
+    *Attributes = ((EFI_GUID_DEFINED_SECTION *) InputSection)->Attributes;
+  }
+
+  if (!CompareGuid (&gLz4CustomDecompressGuid, Guid)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  if ((DataOffset > SectionSize) ||
+      (SectionSize - DataOffset < sizeof (LZ4_SECTION_HEADER)) ||
+      (((LZ4_SECTION_HEADER *) ((UINT8 *) InputSection + DataOffset))->Signature != LZ4_SECTION_SIGNATURE)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  *Data     = (UINT8 *) InputSection + DataOffset;
+  *DataSize = SectionSize - DataOffset;
+  return RETURN_SUCCESS;
+}
+
+/**
+  Examines a GUIDed section and returns the size of the decoded buffer and the
+  size of an scratch buffer required to actually decode the data in a GUIDed section.
+
+  If the GUID of InputSection is not the LZ4 one, or the section data does not
+  start with an LZ4 header, then RETURN_INVALID_PARAMETER is returned.
+
+  @param[in]  InputSection       A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBufferSize   A pointer to the size, in bytes, of an output buffer required
+                                 if the buffer specified by InputSection were decoded.
+  @param[out] ScratchBufferSize  A pointer to the size, in bytes, required as scratch space
+                                 if the buffer specified by InputSection were decoded.
+  @param[out] SectionAttribute   A pointer to the attributes of the GUIDed section. See the Attributes
+                                 field of EFI_GUID_DEFINED_SECTION in the PI Specification.
+
+  @retval  RETURN_SUCCESS            The information about InputSection was returned.
+  @retval  RETURN_INVALID_PARAMETER  The information can not be retrieved from the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+Lz4GuidedSectionGetInfo (
+  IN  CONST VOID  *InputSection,
+  OUT UINT32      *OutputBufferSize,
+  OUT UINT32      *ScratchBufferSize,
+  OUT UINT16      *SectionAttribute
+  )
+{
+  RETURN_STATUS   Status;
+  CONST UINT8     *Data;
+  UINT32          DataSize;
+
+  ASSERT (InputSection != NULL);
+  ASSERT (OutputBufferSize != NULL);
+  ASSERT (ScratchBufferSize != NULL);
+  ASSERT (SectionAttribute != NULL);
+
+  Status = Lz4GetSectionData (InputSection, &Data, &DataSize, SectionAttribute);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  *OutputBufferSize  = ((LZ4_SECTION_HEADER *) Data)->UncompressedSize;
+  *ScratchBufferSize = 0;
+  return RETURN_SUCCESS;
+}
+
+/**
+  Decompress an LZ4 compressed GUIDed section into a caller allocated output buffer.
+
+  If the GUID of InputSection is not the LZ4 one, or the section data can not
+  be decoded, then RETURN_INVALID_PARAMETER is returned.
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBuffer  A pointer to a buffer that contains the result of a decode operation.
+  @param[out] ScratchBuffer Not used, LZ4 needs no scratch buffer.
+  @param[out] AuthenticationStatus
+                            A pointer to the authentication status of the decoded output buffer.
+                            See the definition of authentication status in the EFI_PEI_GUIDED_SECTION_EXTRACTION_PPI
+                            section of the PI Specification. EFI_AUTH_STATUS_PLATFORM_OVERRIDE must
+                            never be set by this handler.
+
+  @retval  RETURN_SUCCESS            The buffer specified by InputSection was decoded.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded.
+
+**/
+RETURN_STATUS
+EFIAPI
+Lz4GuidedSectionExtraction (
+  IN CONST  VOID    *InputSection,
+  OUT       VOID    **OutputBuffer,
+  OUT       VOID    *ScratchBuffer,        OPTIONAL
+  OUT       UINT32  *AuthenticationStatus
+  )
+{
+  RETURN_STATUS   Status;
+  CONST UINT8     *Data;
+  UINT32          DataSize;
+  UINT16          Attributes;
+
+  ASSERT (OutputBuffer != NULL);
+  ASSERT (InputSection != NULL);
+
+  Status = Lz4GetSectionData (InputSection, &Data, &DataSize, &Attributes);
+  if (RETURN_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Authentication is set to Zero, which may be ignored.
+  //
+  *AuthenticationStatus = 0;
+
+  Status = Lz4DecodeBlock (
+             Data + sizeof (LZ4_SECTION_HEADER),
+             DataSize - sizeof (LZ4_SECTION_HEADER),
+             *OutputBuffer,
+             ((LZ4_SECTION_HEADER *) Data)->UncompressedSize
+             );
+  if (RETURN_ERROR (Status)) {
+    DEBUG ((EFI_D_ERROR, "Lz4GuidedSectionExtraction: Corrupted LZ4 section at 0x%p\n", InputSection));
+  }
+
+  return Status;
+}
+
+/**
+  Register the LZ4 GetInfo and Extraction handlers with gLz4CustomDecompressGuid.
+
+  @retval  RETURN_SUCCESS            Register successfully.
+  @retval  RETURN_OUT_OF_RESOURCES   No enough memory to store this handler.
+**/
+EFI_STATUS
+EFIAPI
+Lz4DecompressLibConstructor (
+  )
+{
+  return ExtractGuidedSectionRegisterHandlers (
+           &gLz4CustomDecompressGuid,
+           Lz4GuidedSectionGetInfo,
+           Lz4GuidedSectionExtraction
+           );
+}
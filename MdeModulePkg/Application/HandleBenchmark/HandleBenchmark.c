@@ -0,0 +1,454 @@
+/** @file
+  Shell application measuring the protocol handler boot services of the DXE
+  core: HandleProtocol(), OpenProtocol()/CloseProtocol(), LocateProtocol(),
+  LocateHandle() and InstallProtocolInterface()/UninstallProtocolInterface().
+  The handle database is grown beforehand with synthetic handles carrying
+  synthetic protocols, so the times show how the services scale with the
+  number of handles and protocols in the system.
+
+  Copyright (c), Microsoft Corporation. All rights reserved.
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Protocol/EfiShellParameters.h>
+
+#define BENCH_DEFAULT_DURATION_MS   200
+#define BENCH_DEFAULT_HANDLES       1000
+#define BENCH_MAX_HANDLES           100000
+
+// Synthetic protocols, each handle carries BENCH_PROTOCOLS_PER_HANDLE of them
+// spread BENCH_PROTOCOL_STRIDE apart
+#define BENCH_PROTOCOLS             64
+#define BENCH_PROTOCOLS_PER_HANDLE  4
+#define BENCH_PROTOCOL_STRIDE       (BENCH_PROTOCOLS / BENCH_PROTOCOLS_PER_HANDLE)
+
+typedef struct {
+  BOOLEAN     Csv;
+  UINTN       DurationMs;
+  UINTN       HandleCount;
+} BENCH_OPTIONS;
+
+typedef
+EFI_STATUS
+(*BENCH_FUNCTION) (
+  IN UINTN    Iteration
+  );
+
+typedef struct {
+  CONST CHAR16    *Name;
+  BENCH_FUNCTION  Function;
+} BENCH_CASE;
+
+STATIC EFI_GUID mProtocols[BENCH_PROTOCOLS];
+STATIC EFI_HANDLE *mHandles;
+STATIC UINTN mHandleCount;
+STATIC EFI_HANDLE *mLocateBuffer;
+STATIC EFI_HANDLE mImageHandle;
+STATIC UINT32 mInterface;
+STATIC UINT64 mTicksPerSecond;
+
+STATIC
+VOID
+BenchPrintUsage (
+  VOID
+  )
+{
+  Print (L"Usage: HandleBenchmark [options]\n");
+  Print (L"  -t <ms>   Time spent on each service (default %d)\n", BENCH_DEFAULT_DURATION_MS);
+  Print (L"  -n <n>    Synthetic handles added to the database (default %d)\n", BENCH_DEFAULT_HANDLES);
+  Print (L"  -csv      Print the results as CSV\n");
+  Print (L"Each synthetic handle carries %d of %d synthetic protocols.\n", BENCH_PROTOCOLS_PER_HANDLE, BENCH_PROTOCOLS);
+}
+
+STATIC
+EFI_STATUS
+BenchParseOptions (
+  IN  UINTN           Argc,
+  IN  CHAR16          **Argv,
+  OUT BENCH_OPTIONS   *Options
+  )
+{
+  UINTN Idx;
+
+  ZeroMem (Options, sizeof (BENCH_OPTIONS));
+  Options->DurationMs = BENCH_DEFAULT_DURATION_MS;
+  Options->HandleCount = BENCH_DEFAULT_HANDLES;
+
+  for (Idx = 1; Idx < Argc; ++Idx) {
+    if (StrCmp (Argv[Idx], L"-csv") == 0) {
+      Options->Csv = TRUE;
+    } else if ((StrCmp (Argv[Idx], L"-t") == 0) && (Idx + 1 < Argc)) {
+      Options->DurationMs = StrDecimalToUintn (Argv[++Idx]);
+      if ((Options->DurationMs == 0) || (Options->DurationMs > 60000)) {
+        Print (L"HandleBenchmark: Invalid duration %s\n", Argv[Idx]);
+        return EFI_INVALID_PARAMETER;
+      }
+    } else if ((StrCmp (Argv[Idx], L"-n") == 0) && (Idx + 1 < Argc)) {
+      Options->HandleCount = StrDecimalToUintn (Argv[++Idx]);
+      if ((Options->HandleCount == 0) || (Options->HandleCount > BENCH_MAX_HANDLES)) {
+        Print (L"HandleBenchmark: Invalid handle count %s\n", Argv[Idx]);
+        return EFI_INVALID_PARAMETER;
+      }
+    } else if ((StrCmp (Argv[Idx], L"-h") == 0) || (StrCmp (Argv[Idx], L"-?") == 0)) {
+      return EFI_ABORTED;
+    } else {
+      Print (L"HandleBenchmark: Missing or unknown option %s\n", Argv[Idx]);
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+UINT64
+BenchTicksToNs (
+  IN UINT64   Ticks
+  )
+{
+  return DivU64x64Remainder (MultU64x32 (Ticks, 1000000000), mTicksPerSecond, NULL);
+}
+
+/**
+  Returns the synthetic protocol Slot of the synthetic handle HandleIdx
+**/
+STATIC
+EFI_GUID*
+BenchProtocol (
+  IN UINTN    HandleIdx,
+  IN UINTN    Slot
+  )
+{
+  return &mProtocols[(HandleIdx + (Slot * BENCH_PROTOCOL_STRIDE)) % BENCH_PROTOCOLS];
+}
+
+STATIC
+EFI_STATUS
+BenchHandleProtocol (
+  IN UINTN    Iteration
+  )
+{
+  EFI_STATUS Status;
+  UINTN HandleIdx;
+  VOID *Interface;
+
+  HandleIdx = Iteration % mHandleCount;
+  Status = gBS->HandleProtocol (
+    mHandles[HandleIdx],
+    BenchProtocol (HandleIdx, Iteration % BENCH_PROTOCOLS_PER_HANDLE),
+    &Interface);
+  if (!EFI_ERROR (Status) && (Interface != &mInterface)) {
+    Status = EFI_DEVICE_ERROR;
+  }
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+BenchHandleProtocolMiss (
+  IN UINTN    Iteration
+  )
+{
+  EFI_STATUS Status;
+  UINTN HandleIdx;
+  VOID *Interface;
+
+  // The protocol right after the first one of the handle isn't on it
+  HandleIdx = Iteration % mHandleCount;
+  Status = gBS->HandleProtocol (mHandles[HandleIdx], BenchProtocol (HandleIdx + 1, 0), &Interface);
+
+  return (Status == EFI_UNSUPPORTED) ? EFI_SUCCESS : EFI_DEVICE_ERROR;
+}
+
+STATIC
+EFI_STATUS
+BenchInvalidHandle (
+  IN UINTN    Iteration
+  )
+{
+  EFI_STATUS Status;
+  VOID *Interface;
+
+  Status = gBS->HandleProtocol ((EFI_HANDLE)&mInterface, BenchProtocol (Iteration, 0), &Interface);
+
+  return (Status == EFI_INVALID_PARAMETER) ? EFI_SUCCESS : EFI_DEVICE_ERROR;
+}
+
+STATIC
+EFI_STATUS
+BenchOpenCloseProtocol (
+  IN UINTN    Iteration
+  )
+{
+  EFI_STATUS Status;
+  UINTN HandleIdx;
+  EFI_GUID *Protocol;
+  VOID *Interface;
+
+  HandleIdx = Iteration % mHandleCount;
+  Protocol = BenchProtocol (HandleIdx, Iteration % BENCH_PROTOCOLS_PER_HANDLE);
+  Status = gBS->OpenProtocol (
+    mHandles[HandleIdx],
+    Protocol,
+    &Interface,
+    mImageHandle,
+    NULL,
+    EFI_OPEN_PROTOCOL_GET_PROTOCOL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return gBS->CloseProtocol (mHandles[HandleIdx], Protocol, mImageHandle, NULL);
+}
+
+STATIC
+EFI_STATUS
+BenchLocateProtocol (
+  IN UINTN    Iteration
+  )
+{
+  VOID *Interface;
+
+  return gBS->LocateProtocol (&mProtocols[Iteration % BENCH_PROTOCOLS], NULL, &Interface);
+}
+
+STATIC
+EFI_STATUS
+BenchLocateHandle (
+  IN UINTN    Iteration
+  )
+{
+  UINTN BufferSize;
+
+  BufferSize = mHandleCount * sizeof (EFI_HANDLE);
+  return gBS->LocateHandle (
+    ByProtocol,
+    &mProtocols[Iteration % BENCH_PROTOCOLS],
+    NULL,
+    &BufferSize,
+    mLocateBuffer);
+}
+
+STATIC
+EFI_STATUS
+BenchInstallUninstall (
+  IN UINTN    Iteration
+  )
+{
+  EFI_STATUS Status;
+  EFI_HANDLE Handle;
+  EFI_GUID *Protocol;
+
+  Handle = NULL;
+  Protocol = &mProtocols[Iteration % BENCH_PROTOCOLS];
+  Status = gBS->InstallProtocolInterface (&Handle, Protocol, EFI_NATIVE_INTERFACE, &mInterface);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return gBS->UninstallProtocolInterface (Handle, Protocol, &mInterface);
+}
+
+STATIC CONST BENCH_CASE mCases[] = {
+  { L"handle",        BenchHandleProtocol },
+  { L"handle-miss",   BenchHandleProtocolMiss },
+  { L"handle-bad",    BenchInvalidHandle },
+  { L"open-close",    BenchOpenCloseProtocol },
+  { L"locate-prot",   BenchLocateProtocol },
+  { L"locate-handle", BenchLocateHandle },
+  { L"install",       BenchInstallUninstall },
+};
+
+STATIC
+EFI_STATUS
+BenchRunCase (
+  IN BENCH_OPTIONS        *Options,
+  IN CONST BENCH_CASE     *Case
+  )
+{
+  EFI_STATUS Status;
+  UINT64 Duration;
+  UINT64 Start;
+  UINT64 Ticks;
+  UINTN Calls;
+
+  Duration = DivU64x32 (MultU64x32 (mTicksPerSecond, (UINT32)Options->DurationMs), 1000);
+  Calls = 0;
+
+  // Batches of calls, the performance counter costs as much as a lookup
+  Start = GetPerformanceCounter ();
+  do {
+    do {
+      Status = Case->Function (Calls);
+      if (EFI_ERROR (Status)) {
+        Print (L"HandleBenchmark: %s failed, %r\n", Case->Name, Status);
+        return Status;
+      }
+    } while ((++Calls % 64) != 0);
+    Ticks = GetPerformanceCounter () - Start;
+  } while (Ticks < Duration);
+
+  if (Options->Csv) {
+    Print (
+      L"%s,%d,%d,%ld\n",
+      Case->Name,
+      mHandleCount,
+      Calls,
+      DivU64x64Remainder (BenchTicksToNs (Ticks), Calls, NULL));
+  } else {
+    Print (
+      L"%-13s  %9d  %9ld\n",
+      Case->Name,
+      Calls,
+      DivU64x64Remainder (BenchTicksToNs (Ticks), Calls, NULL));
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+BenchRemoveHandles (
+  VOID
+  )
+{
+  UINTN Idx;
+
+  for (Idx = 0; Idx < mHandleCount; ++Idx) {
+    if (mHandles[Idx] != NULL) {
+      gBS->UninstallMultipleProtocolInterfaces (
+        mHandles[Idx],
+        BenchProtocol (Idx, 0), &mInterface,
+        BenchProtocol (Idx, 1), &mInterface,
+        BenchProtocol (Idx, 2), &mInterface,
+        BenchProtocol (Idx, 3), &mInterface,
+        NULL);
+    }
+  }
+}
+
+STATIC
+EFI_STATUS
+BenchAddHandles (
+  VOID
+  )
+{
+  EFI_STATUS Status;
+  UINTN Idx;
+
+  for (Idx = 0; Idx < BENCH_PROTOCOLS; ++Idx) {
+    // Random GUID, the last byte tells the synthetic protocols apart
+    mProtocols[Idx].Data1 = 0x6b1e0c52;
+    mProtocols[Idx].Data2 = 0x7d3a;
+    mProtocols[Idx].Data3 = 0x4f08;
+    mProtocols[Idx].Data4[0] = 0x9a;
+    mProtocols[Idx].Data4[1] = 0x41;
+    mProtocols[Idx].Data4[2] = 0x3c;
+    mProtocols[Idx].Data4[3] = 0x5e;
+    mProtocols[Idx].Data4[4] = 0x82;
+    mProtocols[Idx].Data4[5] = 0xd7;
+    mProtocols[Idx].Data4[6] = 0x10;
+    mProtocols[Idx].Data4[7] = (UINT8)Idx;
+  }
+
+  for (Idx = 0; Idx < mHandleCount; ++Idx) {
+    Status = gBS->InstallMultipleProtocolInterfaces (
+      &mHandles[Idx],
+      BenchProtocol (Idx, 0), &mInterface,
+      BenchProtocol (Idx, 1), &mInterface,
+      BenchProtocol (Idx, 2), &mInterface,
+      BenchProtocol (Idx, 3), &mInterface,
+      NULL);
+    if (EFI_ERROR (Status)) {
+      Print (L"HandleBenchmark: Failed to add the synthetic handles, %r\n", Status);
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+HandleBenchmarkMain (
+  IN EFI_HANDLE           ImageHandle,
+  IN EFI_SYSTEM_TABLE     *SystemTable
+  )
+{
+  EFI_STATUS Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+  BENCH_OPTIONS Options;
+  UINTN Idx;
+
+  Status = gBS->HandleProtocol (ImageHandle, &gEfiShellParametersProtocolGuid, (VOID**)&ShellParameters);
+  if (EFI_ERROR (Status)) {
+    Print (L"HandleBenchmark: Must be started from the UEFI Shell\n");
+    return Status;
+  }
+
+  Status = BenchParseOptions (ShellParameters->Argc, ShellParameters->Argv, &Options);
+  if (EFI_ERROR (Status)) {
+    BenchPrintUsage ();
+    return (Status == EFI_ABORTED) ? EFI_SUCCESS : Status;
+  }
+
+  mTicksPerSecond = GetPerformanceCounterProperties (NULL, NULL);
+  ASSERT (mTicksPerSecond != 0);
+
+  mImageHandle = ImageHandle;
+  mHandleCount = Options.HandleCount;
+  mHandles = AllocateZeroPool (mHandleCount * sizeof (EFI_HANDLE));
+  mLocateBuffer = AllocatePool (mHandleCount * sizeof (EFI_HANDLE));
+  if ((mHandles == NULL) || (mLocateBuffer == NULL)) {
+    Print (L"HandleBenchmark: Failed to allocate the handle buffers\n");
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Exit;
+  }
+
+  Status = BenchAddHandles ();
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  if (Options.Csv) {
+    Print (L"service,handles,calls,ns\n");
+  } else {
+    Print (L"%d synthetic handles\n", mHandleCount);
+    Print (L"service            calls    ns/call\n");
+  }
+
+  for (Idx = 0; Idx < sizeof (mCases) / sizeof (mCases[0]); ++Idx) {
+    Status = BenchRunCase (&Options, &mCases[Idx]);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+Exit:
+  if (mHandles != NULL) {
+    BenchRemoveHandles ();
+    FreePool (mHandles);
+  }
+  if (mLocateBuffer != NULL) {
+    FreePool (mLocateBuffer);
+  }
+  return Status;
+}
@@ -0,0 +1,698 @@
+/** @file
+  Shell application stressing and benchmarking the page allocator of the DXE
+  core. The memory map is first fragmented with single pages of alternating
+  types and free holes between them, so the times show how AllocatePages(),
+  FreePages() and GetMemoryMap() scale with the number of memory map entries.
+  A random mix of allocations of every allocation type is then checked
+  against the contents of the pages and the memory map.
+
+  Copyright (c), Microsoft Corporation. All rights reserved.
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Protocol/EfiShellParameters.h>
+
+#define BENCH_DEFAULT_DURATION_MS   200
+#define BENCH_DEFAULT_FRAGMENTS     2000
+#define BENCH_MAX_FRAGMENTS         100000
+#define BENCH_DEFAULT_ITERATIONS    20000
+
+//
+// Every BENCH_HOLE_STRIDE-th fragment page is freed again to leave a hole
+//
+#define BENCH_HOLE_STRIDE           4
+
+//
+// Live allocations of the stress test, their largest size, and the number of
+// iterations between two checks of the memory map
+//
+#define BENCH_STRESS_SLOTS          256
+#define BENCH_STRESS_MAX_PAGES      32
+#define BENCH_STRESS_CHECK_PERIOD   256
+
+//
+// Room left in the memory map buffer for the entries added while it is used
+//
+#define BENCH_MAP_SLACK             64
+
+typedef struct {
+  BOOLEAN               Csv;
+  UINTN                 DurationMs;
+  UINTN                 FragmentCount;
+  UINTN                 Iterations;
+  UINT32                Seed;
+} BENCH_OPTIONS;
+
+typedef
+EFI_STATUS
+(*BENCH_FUNCTION) (
+  IN UINTN    Iteration
+  );
+
+typedef struct {
+  CONST CHAR16          *Name;
+  BENCH_FUNCTION        Function;
+} BENCH_CASE;
+
+typedef struct {
+  EFI_PHYSICAL_ADDRESS  Address;
+  UINTN                 Pages;
+  EFI_MEMORY_TYPE       Type;
+} BENCH_ALLOCATION;
+
+STATIC EFI_PHYSICAL_ADDRESS   *mFragments;
+STATIC UINTN                  mFragmentCount;
+STATIC EFI_MEMORY_DESCRIPTOR  *mMemoryMap;
+STATIC UINTN                  mMemoryMapBufferSize;
+STATIC BENCH_ALLOCATION       mAllocations[BENCH_STRESS_SLOTS];
+STATIC UINT32                 mRandom;
+STATIC UINT64                 mTicksPerSecond;
+
+STATIC CONST EFI_MEMORY_TYPE  mStressTypes[] = {
+  EfiLoaderData,
+  EfiBootServicesCode,
+  EfiBootServicesData,
+  EfiRuntimeServicesData,
+  EfiACPIReclaimMemory
+};
+
+STATIC
+VOID
+BenchPrintUsage (
+  VOID
+  )
+{
+  Print (L"Usage: PageBenchmark [options]\n");
+  Print (L"  -t <ms>   Time spent on each service (default %d)\n", BENCH_DEFAULT_DURATION_MS);
+  Print (L"  -n <n>    Fragment pages added to the memory map (default %d)\n", BENCH_DEFAULT_FRAGMENTS);
+  Print (L"  -i <n>    Iterations of the stress test, 0 to skip it (default %d)\n", BENCH_DEFAULT_ITERATIONS);
+  Print (L"  -s <n>    Seed of the stress test\n");
+  Print (L"  -csv      Print the results as CSV\n");
+  Print (L"One fragment page in %d is freed again to leave a hole.\n", BENCH_HOLE_STRIDE);
+}
+
+STATIC
+EFI_STATUS
+BenchParseOptions (
+  IN  UINTN           Argc,
+  IN  CHAR16          **Argv,
+  OUT BENCH_OPTIONS   *Options
+  )
+{
+  UINTN     Idx;
+
+  ZeroMem (Options, sizeof (BENCH_OPTIONS));
+  Options->DurationMs    = BENCH_DEFAULT_DURATION_MS;
+  Options->FragmentCount = BENCH_DEFAULT_FRAGMENTS;
+  Options->Iterations    = BENCH_DEFAULT_ITERATIONS;
+  Options->Seed          = 1;
+
+  for (Idx = 1; Idx < Argc; ++Idx) {
+    if (StrCmp (Argv[Idx], L"-csv") == 0) {
+      Options->Csv = TRUE;
+    } else if ((StrCmp (Argv[Idx], L"-t") == 0) && (Idx + 1 < Argc)) {
+      Options->DurationMs = StrDecimalToUintn (Argv[++Idx]);
+      if ((Options->DurationMs == 0) || (Options->DurationMs > 60000)) {
+        Print (L"PageBenchmark: Invalid duration %s\n", Argv[Idx]);
+        return EFI_INVALID_PARAMETER;
+      }
+    } else if ((StrCmp (Argv[Idx], L"-n") == 0) && (Idx + 1 < Argc)) {
+      Options->FragmentCount = StrDecimalToUintn (Argv[++Idx]);
+      if ((Options->FragmentCount < BENCH_HOLE_STRIDE) || (Options->FragmentCount > BENCH_MAX_FRAGMENTS)) {
+        Print (L"PageBenchmark: Invalid fragment count %s\n", Argv[Idx]);
+        return EFI_INVALID_PARAMETER;
+      }
+    } else if ((StrCmp (Argv[Idx], L"-i") == 0) && (Idx + 1 < Argc)) {
+      Options->Iterations = StrDecimalToUintn (Argv[++Idx]);
+    } else if ((StrCmp (Argv[Idx], L"-s") == 0) && (Idx + 1 < Argc)) {
+      Options->Seed = (UINT32) StrDecimalToUintn (Argv[++Idx]);
+    } else if ((StrCmp (Argv[Idx], L"-h") == 0) || (StrCmp (Argv[Idx], L"-?") == 0)) {
+      return EFI_ABORTED;
+    } else {
+      Print (L"PageBenchmark: Missing or unknown option %s\n", Argv[Idx]);
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+UINT64
+BenchTicksToNs (
+  IN UINT64   Ticks
+  )
+{
+  return DivU64x64Remainder (MultU64x32 (Ticks, 1000000000), mTicksPerSecond, NULL);
+}
+
+/**
+  Returns a pseudo random number below Limit.
+**/
+STATIC
+UINTN
+BenchRandom (
+  IN UINTN    Limit
+  )
+{
+  mRandom = mRandom * 1103515245 + 12345;
+  return (mRandom >> 8) % Limit;
+}
+
+/**
+  Reads the memory map into mMemoryMap.
+
+  @param  DescriptorSize         Returns the size of a descriptor
+  @param  DescriptorCount        Returns the number of descriptors
+
+**/
+STATIC
+EFI_STATUS
+BenchGetMemoryMap (
+  OUT UINTN   *DescriptorSize,
+  OUT UINTN   *DescriptorCount
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       MapSize;
+  UINTN       MapKey;
+  UINT32      DescriptorVersion;
+
+  MapSize = mMemoryMapBufferSize;
+  Status = gBS->GetMemoryMap (&MapSize, mMemoryMap, &MapKey, DescriptorSize, &DescriptorVersion);
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    if (mMemoryMap != NULL) {
+      FreePool (mMemoryMap);
+    }
+    mMemoryMapBufferSize = MapSize + BENCH_MAP_SLACK * sizeof (EFI_MEMORY_DESCRIPTOR) * 2;
+    mMemoryMap = AllocatePool (mMemoryMapBufferSize);
+    if (mMemoryMap == NULL) {
+      mMemoryMapBufferSize = 0;
+      return EFI_OUT_OF_RESOURCES;
+    }
+    MapSize = mMemoryMapBufferSize;
+    Status = gBS->GetMemoryMap (&MapSize, mMemoryMap, &MapKey, DescriptorSize, &DescriptorVersion);
+  }
+  if (!EFI_ERROR (Status)) {
+    *DescriptorCount = MapSize / *DescriptorSize;
+  }
+
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+BenchAllocateFree (
+  IN EFI_ALLOCATE_TYPE      Type,
+  IN UINTN                  Pages,
+  IN EFI_PHYSICAL_ADDRESS   Address
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = gBS->AllocatePages (Type, EfiBootServicesData, Pages, &Address);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return gBS->FreePages (Address, Pages);
+}
+
+STATIC
+EFI_STATUS
+BenchAnyPages (
+  IN UINTN    Iteration
+  )
+{
+  return BenchAllocateFree (AllocateAnyPages, 1, 0);
+}
+
+STATIC
+EFI_STATUS
+BenchAnyPagesLarge (
+  IN UINTN    Iteration
+  )
+{
+  return BenchAllocateFree (AllocateAnyPages, 64, 0);
+}
+
+STATIC
+EFI_STATUS
+BenchMaxAddress (
+  IN UINTN    Iteration
+  )
+{
+  //
+  // Below the middle of the fragments, where only the holes are free
+  //
+  return BenchAllocateFree (AllocateMaxAddress, 1, mFragments[mFragmentCount / 2] - 1);
+}
+
+STATIC
+EFI_STATUS
+BenchAddress (
+  IN UINTN    Iteration
+  )
+{
+  UINTN   Hole;
+
+  Hole = (Iteration * BENCH_HOLE_STRIDE) % (mFragmentCount - mFragmentCount % BENCH_HOLE_STRIDE);
+  return BenchAllocateFree (AllocateAddress, 1, mFragments[Hole]);
+}
+
+STATIC
+EFI_STATUS
+BenchGetMap (
+  IN UINTN    Iteration
+  )
+{
+  UINTN   DescriptorSize;
+  UINTN   DescriptorCount;
+
+  return BenchGetMemoryMap (&DescriptorSize, &DescriptorCount);
+}
+
+STATIC CONST BENCH_CASE mCases[] = {
+  { L"any",         BenchAnyPages },
+  { L"any-64",      BenchAnyPagesLarge },
+  { L"max-address", BenchMaxAddress },
+  { L"address",     BenchAddress },
+  { L"get-map",     BenchGetMap },
+};
+
+STATIC
+EFI_STATUS
+BenchRunCase (
+  IN BENCH_OPTIONS        *Options,
+  IN CONST BENCH_CASE     *Case
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      Duration;
+  UINT64      Start;
+  UINT64      Ticks;
+  UINTN       Calls;
+
+  Duration = DivU64x32 (MultU64x32 (mTicksPerSecond, (UINT32) Options->DurationMs), 1000);
+  Calls = 0;
+
+  Start = GetPerformanceCounter ();
+  do {
+    do {
+      Status = Case->Function (Calls);
+      if (EFI_ERROR (Status)) {
+        Print (L"PageBenchmark: %s failed, %r\n", Case->Name, Status);
+        return Status;
+      }
+    } while ((++Calls % 16) != 0);
+    Ticks = GetPerformanceCounter () - Start;
+  } while (Ticks < Duration);
+
+  if (Options->Csv) {
+    Print (
+      L"%s,%d,%d,%ld\n",
+      Case->Name,
+      mFragmentCount,
+      Calls,
+      DivU64x64Remainder (BenchTicksToNs (Ticks), Calls, NULL)
+      );
+  } else {
+    Print (
+      L"%-11s  %9d  %9ld\n",
+      Case->Name,
+      Calls,
+      DivU64x64Remainder (BenchTicksToNs (Ticks), Calls, NULL)
+      );
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the value stored at both ends of a stress allocation.
+**/
+STATIC
+UINT64
+BenchStressPattern (
+  IN BENCH_ALLOCATION     *Allocation
+  )
+{
+  return Allocation->Address ^ LShiftU64 (Allocation->Pages, 48) ^ 0x5a5aa5a5c3c33c3cULL;
+}
+
+STATIC
+UINT64 *
+BenchStressLastWord (
+  IN BENCH_ALLOCATION     *Allocation
+  )
+{
+  return (UINT64 *) (UINTN) (Allocation->Address + EFI_PAGES_TO_SIZE (Allocation->Pages) - sizeof (UINT64));
+}
+
+/**
+  Checks that every live stress allocation is covered by a descriptor of its
+  type, and that the descriptors of the memory map do not overlap.
+**/
+STATIC
+EFI_STATUS
+BenchStressCheckMap (
+  VOID
+  )
+{
+  EFI_STATUS              Status;
+  UINTN                   DescriptorSize;
+  UINTN                   DescriptorCount;
+  UINTN                   Slot;
+  UINTN                   Idx;
+  EFI_MEMORY_DESCRIPTOR   *Descriptor;
+  EFI_PHYSICAL_ADDRESS    End;
+  BENCH_ALLOCATION        *Allocation;
+  UINT64                  Scratch[16];
+
+  Status = BenchGetMemoryMap (&DescriptorSize, &DescriptorCount);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Slot = 0; Slot < BENCH_STRESS_SLOTS; ++Slot) {
+    Allocation = &mAllocations[Slot];
+    if (Allocation->Pages == 0) {
+      continue;
+    }
+
+    End = Allocation->Address + EFI_PAGES_TO_SIZE (Allocation->Pages);
+    Descriptor = mMemoryMap;
+    for (Idx = 0; Idx < DescriptorCount; ++Idx) {
+      if ((Descriptor->PhysicalStart <= Allocation->Address) &&
+          (Descriptor->PhysicalStart + EFI_PAGES_TO_SIZE ((UINTN) Descriptor->NumberOfPages) >= End)) {
+        break;
+      }
+      Descriptor = NEXT_MEMORY_DESCRIPTOR (Descriptor, DescriptorSize);
+    }
+
+    if ((Idx == DescriptorCount) || (Descriptor->Type != Allocation->Type)) {
+      Print (
+        L"PageBenchmark: %d pages of type %d at 0x%lx are not in the memory map\n",
+        Allocation->Pages,
+        Allocation->Type,
+        Allocation->Address
+        );
+      return EFI_VOLUME_CORRUPTED;
+    }
+  }
+
+  //
+  // Sort the descriptors by address, then look for overlaps between neighbours.
+  // The map is mostly sorted already, so an insertion sort is enough
+  //
+  ASSERT (DescriptorSize <= sizeof (Scratch));
+  for (Idx = 1; Idx < DescriptorCount; ++Idx) {
+    Slot = Idx;
+    while (Slot > 0) {
+      Descriptor = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) mMemoryMap + (Slot - 1) * DescriptorSize);
+      if (Descriptor->PhysicalStart <= NEXT_MEMORY_DESCRIPTOR (Descriptor, DescriptorSize)->PhysicalStart) {
+        break;
+      }
+      CopyMem (Scratch, Descriptor, DescriptorSize);
+      CopyMem (Descriptor, NEXT_MEMORY_DESCRIPTOR (Descriptor, DescriptorSize), DescriptorSize);
+      CopyMem (NEXT_MEMORY_DESCRIPTOR (Descriptor, DescriptorSize), Scratch, DescriptorSize);
+      --Slot;
+    }
+  }
+
+  Descriptor = mMemoryMap;
+  for (Idx = 1; Idx < DescriptorCount; ++Idx) {
+    if (Descriptor->PhysicalStart + EFI_PAGES_TO_SIZE ((UINTN) Descriptor->NumberOfPages) >
+        NEXT_MEMORY_DESCRIPTOR (Descriptor, DescriptorSize)->PhysicalStart) {
+      Print (L"PageBenchmark: Memory map descriptors overlap at 0x%lx\n", Descriptor->PhysicalStart);
+      return EFI_VOLUME_CORRUPTED;
+    }
+    Descriptor = NEXT_MEMORY_DESCRIPTOR (Descriptor, DescriptorSize);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Frees a live stress allocation after checking its contents.
+**/
+STATIC
+EFI_STATUS
+BenchStressFree (
+  IN BENCH_ALLOCATION     *Allocation
+  )
+{
+  EFI_STATUS  Status;
+
+  if ((*(UINT64 *) (UINTN) Allocation->Address != BenchStressPattern (Allocation)) ||
+      (*BenchStressLastWord (Allocation) != BenchStressPattern (Allocation))) {
+    Print (L"PageBenchmark: %d pages at 0x%lx were overwritten\n", Allocation->Pages, Allocation->Address);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Status = gBS->FreePages (Allocation->Address, Allocation->Pages);
+  if (EFI_ERROR (Status)) {
+    Print (L"PageBenchmark: Failed to free %d pages at 0x%lx, %r\n", Allocation->Pages, Allocation->Address, Status);
+    return Status;
+  }
+
+  Allocation->Pages = 0;
+  return EFI_SUCCESS;
+}
+
+/**
+  Allocates a stress allocation of a random size, memory type and allocation
+  type. Fixed address and max address allocations aim at the fragments.
+**/
+STATIC
+EFI_STATUS
+BenchStressAllocate (
+  IN BENCH_ALLOCATION     *Allocation
+  )
+{
+  EFI_STATUS            Status;
+  EFI_ALLOCATE_TYPE     Type;
+  EFI_PHYSICAL_ADDRESS  Address;
+  UINTN                 Pages;
+  EFI_MEMORY_TYPE       MemoryType;
+
+  Pages      = 1 + BenchRandom (BENCH_STRESS_MAX_PAGES);
+  MemoryType = mStressTypes[BenchRandom (sizeof (mStressTypes) / sizeof (mStressTypes[0]))];
+  Type       = (EFI_ALLOCATE_TYPE) BenchRandom (MaxAllocateType);
+  Address    = 0;
+  if (Type == AllocateMaxAddress) {
+    Address = mFragments[BenchRandom (mFragmentCount)] + EFI_PAGE_SIZE - 1;
+  } else if (Type == AllocateAddress) {
+    Address = mFragments[BenchRandom (mFragmentCount)] & ~((EFI_PHYSICAL_ADDRESS) SIZE_64KB - 1);
+  }
+
+  Status = gBS->AllocatePages (Type, MemoryType, Pages, &Address);
+  if (EFI_ERROR (Status)) {
+    //
+    // The fixed and max address requests often hit allocated memory
+    //
+    if ((Status == EFI_NOT_FOUND) || (Status == EFI_OUT_OF_RESOURCES)) {
+      return EFI_SUCCESS;
+    }
+    Print (L"PageBenchmark: Failed to allocate %d pages of type %d, %r\n", Pages, MemoryType, Status);
+    return Status;
+  }
+
+  Allocation->Address = Address;
+  Allocation->Pages   = Pages;
+  Allocation->Type    = MemoryType;
+  *(UINT64 *) (UINTN) Address = BenchStressPattern (Allocation);
+  *BenchStressLastWord (Allocation) = BenchStressPattern (Allocation);
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+BenchRunStress (
+  IN BENCH_OPTIONS        *Options
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Iteration;
+  UINTN       Slot;
+  UINT64      Start;
+  UINT64      Ticks;
+
+  mRandom = Options->Seed;
+  Status  = EFI_SUCCESS;
+
+  Start = GetPerformanceCounter ();
+  for (Iteration = 1; Iteration <= Options->Iterations; ++Iteration) {
+    Slot = BenchRandom (BENCH_STRESS_SLOTS);
+    if (mAllocations[Slot].Pages != 0) {
+      Status = BenchStressFree (&mAllocations[Slot]);
+    } else {
+      Status = BenchStressAllocate (&mAllocations[Slot]);
+    }
+    if (!EFI_ERROR (Status) && (Iteration % BENCH_STRESS_CHECK_PERIOD) == 0) {
+      Status = BenchStressCheckMap ();
+    }
+    if (EFI_ERROR (Status)) {
+      Print (L"PageBenchmark: Stress test failed at iteration %d, seed %d\n", Iteration, Options->Seed);
+      break;
+    }
+  }
+  Ticks = GetPerformanceCounter () - Start;
+
+  for (Slot = 0; Slot < BENCH_STRESS_SLOTS; ++Slot) {
+    if (mAllocations[Slot].Pages != 0) {
+      gBS->FreePages (mAllocations[Slot].Address, mAllocations[Slot].Pages);
+      mAllocations[Slot].Pages = 0;
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    if (Options->Csv) {
+      Print (L"stress,%d,%d,%ld\n", mFragmentCount, Options->Iterations, DivU64x64Remainder (BenchTicksToNs (Ticks), Options->Iterations, NULL));
+    } else {
+      Print (L"Stress test passed, %d iterations in %ld ms\n", Options->Iterations, DivU64x32 (BenchTicksToNs (Ticks), 1000000));
+    }
+  }
+
+  return Status;
+}
+
+STATIC
+VOID
+BenchRemoveFragments (
+  VOID
+  )
+{
+  UINTN   Idx;
+
+  for (Idx = 0; Idx < mFragmentCount; ++Idx) {
+    if ((Idx % BENCH_HOLE_STRIDE) != 0 && mFragments[Idx] != 0) {
+      gBS->FreePages (mFragments[Idx], 1);
+    }
+  }
+}
+
+/**
+  Fragments the memory map with single pages of alternating types, then frees
+  one page in BENCH_HOLE_STRIDE to leave free holes between the others.
+**/
+STATIC
+EFI_STATUS
+BenchAddFragments (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Idx;
+
+  for (Idx = 0; Idx < mFragmentCount; ++Idx) {
+    Status = gBS->AllocatePages (
+                    AllocateAnyPages,
+                    ((Idx % 2) == 0) ? EfiBootServicesData : EfiLoaderData,
+                    1,
+                    &mFragments[Idx]
+                    );
+    if (EFI_ERROR (Status)) {
+      Print (L"PageBenchmark: Failed to fragment the memory map, %r\n", Status);
+      return Status;
+    }
+  }
+
+  for (Idx = 0; Idx < mFragmentCount; Idx += BENCH_HOLE_STRIDE) {
+    gBS->FreePages (mFragments[Idx], 1);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+PageBenchmarkMain (
+  IN EFI_HANDLE           ImageHandle,
+  IN EFI_SYSTEM_TABLE     *SystemTable
+  )
+{
+  EFI_STATUS                      Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL   *ShellParameters;
+  BENCH_OPTIONS                   Options;
+  UINTN                           DescriptorSize;
+  UINTN                           DescriptorCount;
+  UINTN                           Idx;
+
+  Status = gBS->HandleProtocol (ImageHandle, &gEfiShellParametersProtocolGuid, (VOID **) &ShellParameters);
+  if (EFI_ERROR (Status)) {
+    Print (L"PageBenchmark: Must be started from the UEFI Shell\n");
+    return Status;
+  }
+
+  Status = BenchParseOptions (ShellParameters->Argc, ShellParameters->Argv, &Options);
+  if (EFI_ERROR (Status)) {
+    BenchPrintUsage ();
+    return (Status == EFI_ABORTED) ? EFI_SUCCESS : Status;
+  }
+
+  mTicksPerSecond = GetPerformanceCounterProperties (NULL, NULL);
+  ASSERT (mTicksPerSecond != 0);
+
+  mFragmentCount = Options.FragmentCount;
+  mFragments = AllocateZeroPool (mFragmentCount * sizeof (EFI_PHYSICAL_ADDRESS));
+  if (mFragments == NULL) {
+    Print (L"PageBenchmark: Failed to allocate the fragment table\n");
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = BenchAddFragments ();
+  if (EFI_ERROR (Status)) {
+    goto Exit;
+  }
+
+  Status = BenchGetMemoryMap (&DescriptorSize, &DescriptorCount);
+  if (EFI_ERROR (Status)) {
+    Print (L"PageBenchmark: Failed to get the memory map, %r\n", Status);
+    goto Exit;
+  }
+
+  if (Options.Csv) {
+    Print (L"service,fragments,calls,ns\n");
+  } else {
+    Print (L"%d fragment pages, %d memory map descriptors\n", mFragmentCount, DescriptorCount);
+    Print (L"service          calls    ns/call\n");
+  }
+
+  for (Idx = 0; Idx < sizeof (mCases) / sizeof (mCases[0]); ++Idx) {
+    Status = BenchRunCase (&Options, &mCases[Idx]);
+    if (EFI_ERROR (Status)) {
+      goto Exit;
+    }
+  }
+
+  if (Options.Iterations != 0) {
+    Status = BenchRunStress (&Options);
+  }
+
+Exit:
+  BenchRemoveFragments ();
+  FreePool (mFragments);
+  if (mMemoryMap != NULL) {
+    FreePool (mMemoryMap);
+  }
+  return Status;
+}
@@ -195,6 +195,203 @@ CorePreProcessDepex (
 
 
 
+/**
+  Find the next PUSH opcode of a dependency expression. The walk stops at
+  the END opcode, at an unknown opcode, or at the end of the Depex.
+
+  @param  DriverEntry           DriverEntry element to walk.
+  @param  Iterator              The previous PUSH opcode, or NULL to start
+                                from the beginning of the Depex.
+
+  @return The next PUSH opcode, or NULL if there is none.
+
+**/
+UINT8 *
+CoreNextDepexPush (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry,
+  IN  UINT8                   *Iterator
+  )
+{
+  UINT8  *End;
+
+  End = (UINT8 *) DriverEntry->Depex + DriverEntry->DepexSize;
+  if (Iterator == NULL) {
+    Iterator = DriverEntry->Depex;
+  } else {
+    Iterator += 1 + sizeof (EFI_GUID);
+  }
+
+  while (Iterator < End) {
+    switch (*Iterator) {
+    case EFI_DEP_PUSH:
+      if (Iterator + 1 + sizeof (EFI_GUID) > End) {
+        return NULL;
+      }
+      return Iterator;
+
+    case EFI_DEP_BEFORE:
+    case EFI_DEP_AFTER:
+    case EFI_DEP_REPLACE_TRUE:
+      Iterator += sizeof (EFI_GUID);
+      break;
+
+    case EFI_DEP_SOR:
+    case EFI_DEP_AND:
+    case EFI_DEP_OR:
+    case EFI_DEP_NOT:
+    case EFI_DEP_TRUE:
+    case EFI_DEP_FALSE:
+      break;
+
+    default:
+      return NULL;
+    }
+    Iterator++;
+  }
+
+  return NULL;
+}
+
+
+
+/**
+  Registers DriverEntry as a waiter of every GUID pushed by its dependency
+  expression. If the waiters cannot all be registered, the driver is polled
+  on every round of dispatch instead.
+
+  @param  DriverEntry           DriverEntry element to index.
+
+**/
+VOID
+CoreIndexDepex (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  EFI_STATUS    Status;
+  UINT8         *Iterator;
+  UINTN         Count;
+  DEPEX_WAITER  *Waiter;
+  EFI_GUID      DriverGuid;
+
+  DriverEntry->DepexIndexed = TRUE;
+
+  //
+  // BEFORE and AFTER are processed by CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (),
+  // and a NULL Depex only waits for the architectural protocols.
+  //
+  if (DriverEntry->Depex == NULL || DriverEntry->Before || DriverEntry->After) {
+    return;
+  }
+
+  Count = 0;
+  for (Iterator = CoreNextDepexPush (DriverEntry, NULL); Iterator != NULL; Iterator = CoreNextDepexPush (DriverEntry, Iterator)) {
+    Count++;
+  }
+  if (Count == 0) {
+    return;
+  }
+
+  DriverEntry->DepexWaiters = AllocateZeroPool (Count * sizeof (DEPEX_WAITER));
+  if (DriverEntry->DepexWaiters == NULL) {
+    DriverEntry->DepexPolled = TRUE;
+    return;
+  }
+
+  for (Iterator = CoreNextDepexPush (DriverEntry, NULL); Iterator != NULL; Iterator = CoreNextDepexPush (DriverEntry, Iterator)) {
+    Waiter = &DriverEntry->DepexWaiters[DriverEntry->DepexWaiterCount];
+    Waiter->Signature   = DEPEX_WAITER_SIGNATURE;
+    Waiter->DriverEntry = DriverEntry;
+
+    CopyMem (&DriverGuid, Iterator + 1, sizeof (EFI_GUID));
+    Status = CoreInsertDepexWaiter (&DriverGuid, Waiter);
+    if (EFI_ERROR (Status)) {
+      DriverEntry->DepexPolled = TRUE;
+      break;
+    }
+    DriverEntry->DepexWaiterCount++;
+  }
+}
+
+
+
+/**
+  Unregisters the waiters of DriverEntry, once it left the Dependent state.
+
+  @param  DriverEntry           DriverEntry element to remove from the index.
+
+**/
+VOID
+CoreUnindexDepex (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  UINTN  Index;
+
+  if (DriverEntry->DepexWaiters == NULL) {
+    return;
+  }
+
+  for (Index = 0; Index < DriverEntry->DepexWaiterCount; Index++) {
+    CoreRemoveDepexWaiter (&DriverEntry->DepexWaiters[Index]);
+  }
+
+  FreePool (DriverEntry->DepexWaiters);
+  DriverEntry->DepexWaiters     = NULL;
+  DriverEntry->DepexWaiterCount = 0;
+}
+
+
+
+/**
+  Displays why the dependency expression of a driver evaluates to FALSE,
+  listing the GUIDs it pushes that are not installed.
+
+  @param  DriverEntry           DriverEntry element to display.
+
+**/
+VOID
+CoreDisplayDepexBlockers (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *Iterator;
+  BOOLEAN     Missing;
+  EFI_GUID    DriverGuid;
+  VOID        *Interface;
+
+  if (DriverEntry->Depex == NULL) {
+    DEBUG ((DEBUG_LOAD, "  Waiting for the architectural protocols\n"));
+    return;
+  }
+
+  if (DriverEntry->Before || DriverEntry->After) {
+    DEBUG ((
+      DEBUG_LOAD,
+      "  Waiting for the dispatch of FFS(%g) it is %a\n",
+      &DriverEntry->BeforeAfterGuid,
+      DriverEntry->Before ? "BEFORE" : "AFTER"
+      ));
+    return;
+  }
+
+  Missing = FALSE;
+  for (Iterator = CoreNextDepexPush (DriverEntry, NULL); Iterator != NULL; Iterator = CoreNextDepexPush (DriverEntry, Iterator)) {
+    CopyMem (&DriverGuid, Iterator + 1, sizeof (EFI_GUID));
+    Status = CoreLocateProtocol (&DriverGuid, NULL, &Interface);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_LOAD, "  Waiting for GUID(%g)\n", &DriverGuid));
+      Missing = TRUE;
+    }
+  }
+
+  if (!Missing) {
+    DEBUG ((DEBUG_LOAD, "  Depex evaluates to FALSE with all its GUIDs installed\n"));
+  }
+}
+
+
+
 /**
   This is the POSTFIX version of the dependency evaluator.  This code does
   not need to handle Before or After, as it is not valid to call this
@@ -9,9 +9,12 @@
             FV is only processed once.
 
   Step #2 - Dispatch. Remove driver from the mScheduledQueue and load and
-            start it. After mScheduledQueue is drained check the
-            mDiscoveredList to see if any item has a Depex that is ready to
-            be placed on the mScheduledQueue.
+            start it. After mScheduledQueue is drained check the drivers on
+            the mDepexQueue to see if any item has a Depex that is ready to
+            be placed on the mScheduledQueue. A driver is put on the
+            mDepexQueue when it is discovered or scheduled on request, and
+            when a protocol pushed by its Depex is installed or uninstalled,
+            so the Depex of the other drivers cannot have changed.
 
   Step #3 - Adding to the mScheduledQueue requires that you process Before
             and After dependencies. This is done recursively as the call to add
@@ -51,13 +54,31 @@ LIST_ENTRY  mDiscoveredList = INITIALIZE_LIST_HEAD_VARIABLE (mDiscoveredList);
 //
 LIST_ENTRY  mScheduledQueue = INITIALIZE_LIST_HEAD_VARIABLE (mScheduledQueue);
 
+//
+// Queue of drivers whose Depex has to be evaluated on the next round of
+// dispatch, in the order of mDiscoveredList. List of EFI_CORE_DRIVER_ENTRY
+//
+LIST_ENTRY  mDepexQueue = INITIALIZE_LIST_HEAD_VARIABLE (mDepexQueue);
+
+//
+// Queue of drivers without Depex, waiting for all the architectural
+// protocols. List of EFI_CORE_DRIVER_ENTRY
+//
+LIST_ENTRY  mArchProtocolQueue = INITIALIZE_LIST_HEAD_VARIABLE (mArchProtocolQueue);
+
+//
+// Number of drivers added to the mDiscoveredList, the Ordinal of the next one
+//
+UINTN       mDiscoveredCount = 0;
+
 //
 // List of handles who's Fv's have been parsed and added to the mFwDriverList.
 //
 LIST_ENTRY  mFvHandleList = INITIALIZE_LIST_HEAD_VARIABLE (mFvHandleList);           // list of KNOWN_HANDLE
 
 //
-// Lock for mDiscoveredList, mScheduledQueue, gDispatcherRunning.
+// Lock for mDiscoveredList, mScheduledQueue, mDepexQueue, mArchProtocolQueue,
+// gDispatcherRunning.
 //
 EFI_LOCK  mDispatcherLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
 
@@ -229,6 +250,65 @@ CoreReleaseDispatcherLock (
 }
 
 
+/**
+  Insert DriverEntry onto a Depex queue, keeping the order of the
+  mDiscoveredList. The mDispatcherLock must be owned.
+
+  @param  Queue                 The mDepexQueue or the mArchProtocolQueue
+  @param  DriverEntry           The driver to insert
+
+**/
+VOID
+CoreInsertOnDepexQueue (
+  IN  LIST_ENTRY              *Queue,
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  LIST_ENTRY            *Link;
+  EFI_CORE_DRIVER_ENTRY *QueuedEntry;
+
+  ASSERT_LOCKED (&mDispatcherLock);
+  ASSERT (!DriverEntry->DepexQueued);
+
+  //
+  // Search from the tail, the drivers are mostly queued in the order they
+  // were discovered
+  //
+  for (Link = Queue->BackLink; Link != Queue; Link = Link->BackLink) {
+    QueuedEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, DepexLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    if (QueuedEntry->Ordinal < DriverEntry->Ordinal) {
+      break;
+    }
+  }
+
+  InsertHeadList (Link, &DriverEntry->DepexLink);
+  DriverEntry->DepexQueued = TRUE;
+}
+
+
+/**
+  Queues a driver for the evaluation of its dependency expression on the next
+  round of dispatch. Drivers that are not Dependent, or are already queued,
+  are left alone.
+
+  @param  DriverEntry           The driver to queue.
+
+**/
+VOID
+CoreQueueDepexEvaluation (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  CoreAcquireDispatcherLock ();
+
+  if (DriverEntry->Dependent && !DriverEntry->DepexQueued) {
+    CoreInsertOnDepexQueue (&mDepexQueue, DriverEntry);
+  }
+
+  CoreReleaseDispatcherLock ();
+}
+
+
 /**
   Read Depex and pre-process the Depex for Before and After. If Section Extraction
   protocol returns an error via ReadSection defer the reading of the Depex.
@@ -332,6 +412,9 @@ CoreSchedule (
       CoreAcquireDispatcherLock ();
       DriverEntry->Unrequested  = FALSE;
       DriverEntry->Dependent    = TRUE;
+      if (!DriverEntry->DepexQueued) {
+        CoreInsertOnDepexQueue (&mDepexQueue, DriverEntry);
+      }
       CoreReleaseDispatcherLock ();
 
       DEBUG ((DEBUG_DISPATCH, "Schedule FFS(%g) - EFI_SUCCESS\n", DriverName));
@@ -433,7 +516,8 @@ CoreDispatcher (
 {
   EFI_STATUS                      Status;
   EFI_STATUS                      ReturnStatus;
-  LIST_ENTRY                      *Link;
+  LIST_ENTRY                      *Queue;
+  LIST_ENTRY                      RetryQueue;
   EFI_CORE_DRIVER_ENTRY           *DriverEntry;
   BOOLEAN                         ReadyToRun;
   EFI_EVENT                       DxeDispatchEvent;
@@ -568,11 +652,33 @@ CoreDispatcher (
     }
 
     //
-    // Search DriverList for items to place on Scheduled Queue
+    // Once all the architectural protocols are available, the drivers without
+    // Depex are evaluated again
+    //
+    if (!IsListEmpty (&mArchProtocolQueue) && !EFI_ERROR (CoreAllEfiServicesAvailable ())) {
+      CoreAcquireDispatcherLock ();
+      while (!IsListEmpty (&mArchProtocolQueue)) {
+        DriverEntry = CR (mArchProtocolQueue.ForwardLink, EFI_CORE_DRIVER_ENTRY, DepexLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+        RemoveEntryList (&DriverEntry->DepexLink);
+        DriverEntry->DepexQueued = FALSE;
+        CoreInsertOnDepexQueue (&mDepexQueue, DriverEntry);
+      }
+      CoreReleaseDispatcherLock ();
+    }
+
+    //
+    // Search Depex Queue for items to place on Scheduled Queue. It is in the
+    // order of the DriverList, so the drivers are scheduled in the same order
+    // as if the whole DriverList was searched.
     //
     ReadyToRun = FALSE;
-    for (Link = mDiscoveredList.ForwardLink; Link != &mDiscoveredList; Link = Link->ForwardLink) {
-      DriverEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, Link, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    InitializeListHead (&RetryQueue);
+    CoreAcquireDispatcherLock ();
+    while (!IsListEmpty (&mDepexQueue)) {
+      DriverEntry = CR (mDepexQueue.ForwardLink, EFI_CORE_DRIVER_ENTRY, DepexLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+      RemoveEntryList (&DriverEntry->DepexLink);
+      DriverEntry->DepexQueued = FALSE;
+      CoreReleaseDispatcherLock ();
 
       if (DriverEntry->DepexProtocolError){
         //
@@ -581,19 +687,49 @@ CoreDispatcher (
         Status = CoreGetDepexSectionAndPreProccess (DriverEntry);
       }
 
+      Queue = NULL;
       if (DriverEntry->Dependent) {
+        //
+        // Register the waiters before the evaluation, so that no protocol
+        // installation can be missed
+        //
+        if (!DriverEntry->DepexIndexed) {
+          CoreIndexDepex (DriverEntry);
+        }
+
         if (CoreIsSchedulable (DriverEntry)) {
           CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (DriverEntry);
           ReadyToRun = TRUE;
+        } else if (DriverEntry->Depex == NULL) {
+          Queue = &mArchProtocolQueue;
+        } else if (DriverEntry->DepexPolled) {
+          Queue = &RetryQueue;
         }
-      } else {
-        if (DriverEntry->Unrequested) {
-          DEBUG ((DEBUG_DISPATCH, "Evaluate DXE DEPEX for FFS(%g)\n", &DriverEntry->FileName));
-          DEBUG ((DEBUG_DISPATCH, "  SOR                                             = Not Requested\n"));
-          DEBUG ((DEBUG_DISPATCH, "  RESULT = FALSE\n"));
-        }
+      } else if (DriverEntry->DepexProtocolError) {
+        Queue = &RetryQueue;
+      } else if (DriverEntry->Unrequested) {
+        DEBUG ((DEBUG_DISPATCH, "Evaluate DXE DEPEX for FFS(%g)\n", &DriverEntry->FileName));
+        DEBUG ((DEBUG_DISPATCH, "  SOR                                             = Not Requested\n"));
+        DEBUG ((DEBUG_DISPATCH, "  RESULT = FALSE\n"));
+      }
+
+      CoreAcquireDispatcherLock ();
+      if (Queue != NULL && !DriverEntry->DepexQueued) {
+        CoreInsertOnDepexQueue (Queue, DriverEntry);
       }
     }
+
+    //
+    // The drivers that could not be indexed, or whose Depex could not be
+    // read, are evaluated again on the next round
+    //
+    while (!IsListEmpty (&RetryQueue)) {
+      DriverEntry = CR (RetryQueue.ForwardLink, EFI_CORE_DRIVER_ENTRY, DepexLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+      RemoveEntryList (&DriverEntry->DepexLink);
+      DriverEntry->DepexQueued = FALSE;
+      CoreInsertOnDepexQueue (&mDepexQueue, DriverEntry);
+    }
+    CoreReleaseDispatcherLock ();
   } while (ReadyToRun);
 
   //
@@ -657,6 +793,11 @@ CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (
 
   CoreReleaseDispatcherLock ();
 
+  //
+  // The protocols pushed by its Depex no longer matter
+  //
+  CoreUnindexDepex (InsertedDriverEntry);
+
   //
   // Process After Dependency
   //
@@ -913,8 +1054,14 @@ CoreAddToDriverList (
 
   CoreAcquireDispatcherLock ();
 
+  DriverEntry->Ordinal = mDiscoveredCount++;
   InsertTailList (&mDiscoveredList, &DriverEntry->Link);
 
+  //
+  // Evaluate the Depex of the new driver on the next round of dispatch
+  //
+  CoreInsertOnDepexQueue (&mDepexQueue, DriverEntry);
+
   CoreReleaseDispatcherLock ();
 
   return EFI_SUCCESS;
@@ -1405,8 +1552,8 @@ CoreInitializeDispatcher (
 //
 
 /**
-  Traverse the discovered list for any drivers that were discovered but not loaded
-  because the dependency experessions evaluated to false.
+  Traverse the discovered list for any drivers that were discovered but not loaded,
+  and display why each of them is still blocked.
 
 **/
 VOID
@@ -1421,6 +1568,16 @@ CoreDisplayDiscoveredNotDispatched (
     DriverEntry = CR(Link, EFI_CORE_DRIVER_ENTRY, Link, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
     if (DriverEntry->Dependent) {
       DEBUG ((DEBUG_LOAD, "Driver %g was discovered but not loaded!!\n", &DriverEntry->FileName));
+      CoreDisplayDepexBlockers (DriverEntry);
+    } else if (DriverEntry->Unrequested) {
+      DEBUG ((DEBUG_LOAD, "Driver %g was discovered but not loaded!!\n", &DriverEntry->FileName));
+      DEBUG ((DEBUG_LOAD, "  Waiting for Schedule () (SOR)\n"));
+    } else if (DriverEntry->Untrusted) {
+      DEBUG ((DEBUG_LOAD, "Driver %g was discovered but not loaded!!\n", &DriverEntry->FileName));
+      DEBUG ((DEBUG_LOAD, "  Waiting for Trust () (Untrusted)\n"));
+    } else if (DriverEntry->DepexProtocolError) {
+      DEBUG ((DEBUG_LOAD, "Driver %g was discovered but not loaded!!\n", &DriverEntry->FileName));
+      DEBUG ((DEBUG_LOAD, "  Depex section could not be read yet\n"));
     }
   }
 }
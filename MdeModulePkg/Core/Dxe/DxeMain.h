@@ -53,6 +53,9 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Protocol/TcgService.h>
 #include <Protocol/HiiPackageList.h>
 #include <Protocol/SmmBase2.h>
+#include <Protocol/TicklessTimer.h>
+#include <Protocol/TimerEventStatistics.h>
+#include <Protocol/PoolStatistics.h>
 #include <Guid/MemoryTypeInformation.h>
 #include <Guid/FirmwareFileSystem2.h>
 #include <Guid/FirmwareFileSystem3.h>
@@ -145,13 +148,33 @@ typedef struct {
 } KNOWN_HANDLE;
 
 
-#define EFI_CORE_DRIVER_ENTRY_SIGNATURE SIGNATURE_32('d','r','v','r')
+//
+// DEPEX_WAITER - Links a driver in the Dependent state to the protocol entry
+// of a GUID pushed by its dependency expression, so that installing or
+// uninstalling the protocol queues the driver for another evaluation
+//
+#define DEPEX_WAITER_SIGNATURE  SIGNATURE_32('d','p','x','w')
 typedef struct {
+  UINTN                           Signature;
+  LIST_ENTRY                      Link;             // PROTOCOL_ENTRY.DepexWaiters
+  struct _EFI_CORE_DRIVER_ENTRY   *DriverEntry;
+} DEPEX_WAITER;
+
+#define EFI_CORE_DRIVER_ENTRY_SIGNATURE SIGNATURE_32('d','r','v','r')
+typedef struct _EFI_CORE_DRIVER_ENTRY {
   UINTN                           Signature;
   LIST_ENTRY                      Link;             // mDriverList
 
   LIST_ENTRY                      ScheduledLink;    // mScheduledQueue
 
+  LIST_ENTRY                      DepexLink;        // mDepexQueue, mArchProtocolQueue
+  UINTN                           Ordinal;          // Position in mDiscoveredList
+  BOOLEAN                         DepexQueued;
+  BOOLEAN                         DepexIndexed;
+  BOOLEAN                         DepexPolled;
+  UINTN                           DepexWaiterCount;
+  DEPEX_WAITER                    *DepexWaiters;
+
   EFI_HANDLE                      FvHandle;
   EFI_GUID                        FileName;
   EFI_DEVICE_PATH_PROTOCOL        *FvFileDevicePath;
@@ -262,6 +285,7 @@ extern EFI_SECURITY_ARCH_PROTOCOL               *gSecurity;
 extern EFI_SECURITY2_ARCH_PROTOCOL              *gSecurity2;
 extern EFI_BDS_ARCH_PROTOCOL                    *gBds;
 extern EFI_SMM_BASE2_PROTOCOL                   *gSmmBase2;
+extern EDKII_TICKLESS_TIMER_PROTOCOL            *gTicklessTimer;
 
 extern EFI_TPL                                  gEfiCurrentTpl;
 
@@ -291,6 +315,16 @@ CoreInitializePool (
   );
 
 
+/**
+  Installs the Pool Statistics Protocol.
+
+**/
+VOID
+CoreInstallPoolStatisticsProtocol (
+  VOID
+  );
+
+
 /**
   Called to initialize the memory map and add descriptors to
   the current descriptor list.
@@ -506,6 +540,88 @@ CorePreProcessDepex (
   );
 
 
+/**
+  Registers DriverEntry as a waiter of every GUID pushed by its dependency
+  expression. If the waiters cannot all be registered, the driver is polled
+  on every round of dispatch instead.
+
+  @param  DriverEntry           DriverEntry element to index.
+
+**/
+VOID
+CoreIndexDepex (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  );
+
+
+/**
+  Unregisters the waiters of DriverEntry, once it left the Dependent state.
+
+  @param  DriverEntry           DriverEntry element to remove from the index.
+
+**/
+VOID
+CoreUnindexDepex (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  );
+
+
+/**
+  Displays why the dependency expression of a driver evaluates to FALSE,
+  listing the GUIDs it pushes that are not installed.
+
+  @param  DriverEntry           DriverEntry element to display.
+
+**/
+VOID
+CoreDisplayDepexBlockers (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  );
+
+
+/**
+  Queues a driver for the evaluation of its dependency expression on the next
+  round of dispatch. Drivers that are not Dependent, or are already queued,
+  are left alone.
+
+  @param  DriverEntry           The driver to queue.
+
+**/
+VOID
+CoreQueueDepexEvaluation (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  );
+
+
+/**
+  Adds a depex waiter onto the protocol entry of Protocol.
+
+  @param  Protocol               The GUID pushed by the dependency expression
+  @param  Waiter                 The waiter to add
+
+  @retval EFI_SUCCESS            The waiter was added
+  @retval EFI_OUT_OF_RESOURCES   The protocol entry could not be created
+
+**/
+EFI_STATUS
+CoreInsertDepexWaiter (
+  IN EFI_GUID       *Protocol,
+  IN DEPEX_WAITER   *Waiter
+  );
+
+
+/**
+  Removes a depex waiter from its protocol entry.
+
+  @param  Waiter                 The waiter to remove
+
+**/
+VOID
+CoreRemoveDepexWaiter (
+  IN DEPEX_WAITER   *Waiter
+  );
+
+
 
 /**
   Terminates all boot services.
@@ -2190,8 +2306,8 @@ CoreDisplayMissingArchProtocols (
 
 
 /**
-  Traverse the discovered list for any drivers that were discovered but not loaded
-  because the dependency experessions evaluated to false.
+  Traverse the discovered list for any drivers that were discovered but not loaded,
+  and display why each of them is still blocked.
 
 **/
 VOID
@@ -34,6 +34,7 @@ EFI_WATCHDOG_TIMER_ARCH_PROTOCOL  *gWatchdogTimer = NULL;
 // DXE Core globals for optional protocol dependencies
 //
 EFI_SMM_BASE2_PROTOCOL            *gSmmBase2      = NULL;
+EDKII_TICKLESS_TIMER_PROTOCOL     *gTicklessTimer = NULL;
 
 //
 // DXE Core Global used to update core loaded image protocol handle
@@ -387,6 +388,8 @@ DxeMain (
 
   MemoryProfileInstallProtocol ();
 
+  CoreInstallPoolStatisticsProtocol ();
+
   //
   // Get persisted vector hand-off info from GUIDeed HOB again due to HobStart may be updated,
   // and install configuration table
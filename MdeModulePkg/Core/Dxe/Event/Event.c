@@ -469,6 +469,14 @@ CoreCreateEventInternal (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  if ((Type & EVT_TIMER) != 0) {
+    Status = CoreReserveTimerSlot ();
+    if (EFI_ERROR (Status)) {
+      CoreFreePool (IEvent);
+      return Status;
+    }
+  }
+
   IEvent->Signature = EVENT_SIGNATURE;
   IEvent->Type = Type;
 
@@ -739,6 +747,7 @@ CoreCloseEvent (
   //
   if ((Event->Type & EVT_TIMER) != 0) {
     CoreSetTimer (Event, TimerCancel, 0);
+    CoreReleaseTimerSlot ();
   }
 
   CoreAcquireEventLock ();
@@ -28,9 +28,16 @@ extern  UINTN                   gEventPending;
 /// Timer event information
 ///
 typedef struct {
-  LIST_ENTRY      Link;
+  ///
+  /// Slot of the event in the timer heap, from 1, 0 while the timer isn't queued
+  ///
+  UINTN           HeapIndex;
   UINT64          TriggerTime;
   UINT64          Period;
+  ///
+  /// Orders the timers of the same TriggerTime by the time they were queued
+  ///
+  UINT64          Sequence;
 } TIMER_EVENT_INFO;
 
 #define EVENT_SIGNATURE         SIGNATURE_32('e','v','n','t')
@@ -85,4 +92,28 @@ CoreInitializeTimer (
   VOID
   );
 
+
+/**
+  Reserves the slot of a new timer event in the timer heap, so that it can be
+  queued at any TPL later on.
+
+  @retval EFI_SUCCESS            The slot was reserved.
+  @retval EFI_OUT_OF_RESOURCES   The timer heap could not grow.
+
+**/
+EFI_STATUS
+CoreReserveTimerSlot (
+  VOID
+  );
+
+
+/**
+  Releases the slot of a timer event being closed.
+
+**/
+VOID
+CoreReleaseTimerSlot (
+  VOID
+  );
+
 #endif
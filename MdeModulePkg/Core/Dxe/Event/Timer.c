@@ -16,17 +16,158 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "DxeMain.h"
 #include "Event.h"
 
+//
+// Slots of the timer heap allocated at once
+//
+#define TIMER_HEAP_GROWTH   32
+
 //
 // Internal data
 //
 
-LIST_ENTRY       mEfiTimerList = INITIALIZE_LIST_HEAD_VARIABLE (mEfiTimerList);
+//
+// mEfiTimerHeap - The queued timer events, a binary min-heap on their trigger
+//                 time stored from slot 1. Every timer event has a slot
+//                 reserved when it is created, so queuing never allocates
+//
+IEVENT           **mEfiTimerHeap = NULL;
+UINTN            mEfiTimerHeapSize = 0;
+UINTN            mEfiTimerCount = 0;
+UINTN            mEfiTimerEvents = 0;
+UINT64           mEfiTimerSequence = 0;
 EFI_LOCK         mEfiTimerLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL - 1);
 EFI_EVENT        mEfiCheckTimerEvent = NULL;
 
 EFI_LOCK         mEfiSystemTimeLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
 UINT64           mEfiSystemTime = 0;
 
+//
+// mEfiTimerStatistics - Counters of EDKII_TIMER_EVENT_STATISTICS_PROTOCOL,
+//                       Ticks is owned by mEfiSystemTimeLock, the others by
+//                       mEfiTimerLock
+//
+EDKII_TIMER_EVENT_STATISTICS  mEfiTimerStatistics;
+
+EFI_STATUS
+EFIAPI
+CoreGetTimerEventStatistics (
+  IN  EDKII_TIMER_EVENT_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                                Reset,
+  OUT EDKII_TIMER_EVENT_STATISTICS           *Statistics
+  );
+
+EDKII_TIMER_EVENT_STATISTICS_PROTOCOL  mEfiTimerEventStatisticsProtocol = {
+  CoreGetTimerEventStatistics
+};
+
+//
+// Timer heap functions
+//
+/**
+  Tells whether a timer expires before another one. Timers of the same trigger
+  time expire in the order they were queued.
+
+  @param  Event1                 The first timer event
+  @param  Event2                 The second timer event
+
+  @retval TRUE                   Event1 expires first
+  @retval FALSE                  Event2 expires first
+
+**/
+BOOLEAN
+CoreTimerBefore (
+  IN IEVENT   *Event1,
+  IN IEVENT   *Event2
+  )
+{
+  if (Event1->Timer.TriggerTime != Event2->Timer.TriggerTime) {
+    return (BOOLEAN)(Event1->Timer.TriggerTime < Event2->Timer.TriggerTime);
+  }
+  return (BOOLEAN)(Event1->Timer.Sequence < Event2->Timer.Sequence);
+}
+
+/**
+  Stores a timer event in a slot of the timer heap.
+
+  @param  Index                  The slot
+  @param  Event                  The timer event
+
+**/
+VOID
+CoreSetTimerHeapSlot (
+  IN UINTN    Index,
+  IN IEVENT   *Event
+  )
+{
+  mEfiTimerHeap[Index] = Event;
+  Event->Timer.HeapIndex = Index;
+}
+
+/**
+  Moves the timer event of a slot towards the root of the timer heap until
+  its parent expires first.
+
+  @param  Index                  The slot of the timer event
+
+**/
+VOID
+CoreTimerHeapSiftUp (
+  IN UINTN    Index
+  )
+{
+  IEVENT          *Event;
+
+  Event = mEfiTimerHeap[Index];
+  while ((Index > 1) && CoreTimerBefore (Event, mEfiTimerHeap[Index / 2])) {
+    CoreSetTimerHeapSlot (Index, mEfiTimerHeap[Index / 2]);
+    Index /= 2;
+  }
+  CoreSetTimerHeapSlot (Index, Event);
+}
+
+/**
+  Moves the timer event of a slot towards the leaves of the timer heap until
+  it expires before its children.
+
+  @param  Index                  The slot of the timer event
+
+**/
+VOID
+CoreTimerHeapSiftDown (
+  IN UINTN    Index
+  )
+{
+  IEVENT          *Event;
+  UINTN           Child;
+
+  Event = mEfiTimerHeap[Index];
+  while ((Child = Index * 2) <= mEfiTimerCount) {
+    if ((Child < mEfiTimerCount) && CoreTimerBefore (mEfiTimerHeap[Child + 1], mEfiTimerHeap[Child])) {
+      Child++;
+    }
+    if (!CoreTimerBefore (mEfiTimerHeap[Child], Event)) {
+      break;
+    }
+    CoreSetTimerHeapSlot (Index, mEfiTimerHeap[Child]);
+    Index = Child;
+  }
+  CoreSetTimerHeapSlot (Index, Event);
+}
+
+/**
+  Returns the timer event that expires first.
+
+  @return The timer event, NULL if no timer is queued
+
+**/
+IEVENT *
+CoreFirstEventTimer (
+  VOID
+  )
+{
+  return (mEfiTimerCount != 0) ? mEfiTimerHeap[1] : NULL;
+}
+
 //
 // Timer functions
 //
@@ -42,29 +183,163 @@ CoreInsertEventTimer (
   IN IEVENT   *Event
   )
 {
-  UINT64          TriggerTime;
-  LIST_ENTRY      *Link;
-  IEVENT          *Event2;
-
   ASSERT_LOCKED (&mEfiTimerLock);
+  ASSERT (Event->Timer.HeapIndex == 0);
+  ASSERT (mEfiTimerCount < mEfiTimerHeapSize);
 
   //
-  // Get the timer's trigger time
+  // Insert the timer into the timer heap, after the timers of the same
+  // trigger time
   //
-  TriggerTime = Event->Timer.TriggerTime;
+  Event->Timer.Sequence = mEfiTimerSequence++;
+  mEfiTimerCount++;
+  CoreSetTimerHeapSlot (mEfiTimerCount, Event);
+  CoreTimerHeapSiftUp (mEfiTimerCount);
+
+  if (mEfiTimerCount > mEfiTimerStatistics.MaxQueued) {
+    mEfiTimerStatistics.MaxQueued = mEfiTimerCount;
+  }
+}
+
+/**
+  Removes a queued timer event.
+
+  @param  Event                  Points to the internal structure of the timer
+                                 event to be removed
+
+**/
+VOID
+CoreRemoveEventTimer (
+  IN IEVENT   *Event
+  )
+{
+  UINTN           Index;
+  IEVENT          *Last;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+  ASSERT (Event->Timer.HeapIndex != 0);
 
   //
-  // Insert the timer into the timer database in assending sorted order
+  // Move the last timer of the heap to the slot freed, then restore the heap
+  // order in whichever direction it was broken
   //
-  for (Link = mEfiTimerList.ForwardLink; Link != &mEfiTimerList; Link = Link->ForwardLink) {
-    Event2 = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+  Index = Event->Timer.HeapIndex;
+  Event->Timer.HeapIndex = 0;
+  Last = mEfiTimerHeap[mEfiTimerCount];
+  mEfiTimerCount--;
+  if (Last != Event) {
+    CoreSetTimerHeapSlot (Index, Last);
+    if ((Index > 1) && CoreTimerBefore (Last, mEfiTimerHeap[Index / 2])) {
+      CoreTimerHeapSiftUp (Index);
+    } else {
+      CoreTimerHeapSiftDown (Index);
+    }
+  }
+}
 
-    if (Event2->Timer.TriggerTime > TriggerTime) {
-      break;
+/**
+  Reserves the slot of a new timer event in the timer heap, so that it can be
+  queued at any TPL later on.
+
+  @retval EFI_SUCCESS            The slot was reserved.
+  @retval EFI_OUT_OF_RESOURCES   The timer heap could not grow.
+
+**/
+EFI_STATUS
+CoreReserveTimerSlot (
+  VOID
+  )
+{
+  IEVENT          **NewHeap;
+  IEVENT          **FreeHeap;
+  UINTN           NewSize;
+
+  FreeHeap = NULL;
+  CoreAcquireLock (&mEfiTimerLock);
+  while (mEfiTimerEvents >= mEfiTimerHeapSize) {
+    //
+    // The pool can't be allocated at the TPL of the lock, grow the heap with
+    // the lock released
+    //
+    NewSize = mEfiTimerHeapSize + TIMER_HEAP_GROWTH;
+    CoreReleaseLock (&mEfiTimerLock);
+    if (FreeHeap != NULL) {
+      CoreFreePool (FreeHeap);
+      FreeHeap = NULL;
+    }
+    NewHeap = AllocatePool ((NewSize + 1) * sizeof (IEVENT *));
+    if (NewHeap == NULL) {
+      return EFI_OUT_OF_RESOURCES;
     }
+    CoreAcquireLock (&mEfiTimerLock);
+
+    //
+    // A timer event created meanwhile at a higher TPL may have grown it already
+    //
+    if (NewSize > mEfiTimerHeapSize) {
+      if (mEfiTimerCount != 0) {
+        CopyMem (&NewHeap[1], &mEfiTimerHeap[1], mEfiTimerCount * sizeof (IEVENT *));
+      }
+      FreeHeap = mEfiTimerHeap;
+      mEfiTimerHeap = NewHeap;
+      mEfiTimerHeapSize = NewSize;
+    } else {
+      FreeHeap = NewHeap;
+    }
+  }
+  mEfiTimerEvents++;
+  CoreReleaseLock (&mEfiTimerLock);
+
+  if (FreeHeap != NULL) {
+    CoreFreePool (FreeHeap);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Releases the slot of a timer event being closed.
+
+**/
+VOID
+CoreReleaseTimerSlot (
+  VOID
+  )
+{
+  CoreAcquireLock (&mEfiTimerLock);
+  ASSERT (mEfiTimerEvents > 0);
+  mEfiTimerEvents--;
+  CoreReleaseLock (&mEfiTimerLock);
+}
+
+/**
+  Tells a tickless timer driver how long it can wait before the earliest timer
+  event expires, so that its next interrupt fires then rather than after a
+  fixed period.
+
+  @param  SystemTime             The current system time
+
+**/
+STATIC
+VOID
+CoreReportTimerDeadline (
+  IN UINT64   SystemTime
+  )
+{
+  IEVENT          *Event;
+  UINT64          Delay;
+
+  if (gTicklessTimer == NULL) {
+    return;
+  }
+
+  Delay = TICKLESS_TIMER_NO_DEADLINE;
+  Event = CoreFirstEventTimer ();
+  if (Event != NULL) {
+    Delay = (Event->Timer.TriggerTime > SystemTime) ? (Event->Timer.TriggerTime - SystemTime) : 0;
   }
 
-  InsertTailList (Link, &Event->Timer.Link);
+  gTicklessTimer->SetDeadline (gTicklessTimer, Delay);
 }
 
 /**
@@ -79,16 +354,26 @@ CoreCurrentSystemTime (
   )
 {
   UINT64          SystemTime;
+  UINT64          Elapsed;
 
   CoreAcquireLock (&mEfiSystemTimeLock);
   SystemTime = mEfiSystemTime;
+
+  //
+  // A tickless timer driver only calls CoreTimerTick() when an event is due,
+  // add the time elapsed since its last call
+  //
+  if (gTicklessTimer != NULL) {
+    gTicklessTimer->GetElapsedTime (gTicklessTimer, &Elapsed);
+    SystemTime += Elapsed;
+  }
   CoreReleaseLock (&mEfiSystemTimeLock);
 
   return SystemTime;
 }
 
 /**
-  Checks the sorted timer list against the current system time.
+  Checks the timer heap against the current system time.
   Signals any expired event timer.
 
   @param  CheckEvent             Not used
@@ -110,10 +395,9 @@ CoreCheckTimers (
   //
   CoreAcquireLock (&mEfiTimerLock);
   SystemTime = CoreCurrentSystemTime ();
+  mEfiTimerStatistics.Checks++;
 
-  while (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
-
+  while ((Event = CoreFirstEventTimer ()) != NULL) {
     //
     // If this timer is not expired, then we're done
     //
@@ -121,17 +405,11 @@ CoreCheckTimers (
       break;
     }
 
-    //
-    // Remove this timer from the timer queue
-    //
-
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
-
     //
     // Signal it
     //
     CoreSignalEvent (Event);
+    mEfiTimerStatistics.Expired++;
 
     //
     // If this is a periodic timer, set it
@@ -148,15 +426,25 @@ CoreCheckTimers (
       if (Event->Timer.TriggerTime <= SystemTime) {
         Event->Timer.TriggerTime = SystemTime;
         CoreSignalEvent (mEfiCheckTimerEvent);
+        mEfiTimerStatistics.Late++;
       }
 
       //
-      // Add the timer
+      // Requeue the timer from the root of the heap, after the timers of the
+      // same trigger time
       //
-      CoreInsertEventTimer (Event);
+      Event->Timer.Sequence = mEfiTimerSequence++;
+      CoreTimerHeapSiftDown (1);
+    } else {
+      //
+      // Remove this timer from the timer heap
+      //
+      CoreRemoveEventTimer (Event);
     }
   }
 
+  CoreReportTimerDeadline (CoreCurrentSystemTime ());
+
   CoreReleaseLock (&mEfiTimerLock);
 }
 
@@ -171,6 +459,7 @@ CoreInitializeTimer (
   )
 {
   EFI_STATUS  Status;
+  EFI_HANDLE  Handle;
 
   Status = CoreCreateEventInternal (
              EVT_NOTIFY_SIGNAL,
@@ -181,6 +470,15 @@ CoreInitializeTimer (
              &mEfiCheckTimerEvent
              );
   ASSERT_EFI_ERROR (Status);
+
+  Handle = NULL;
+  Status = CoreInstallMultipleProtocolInterfaces (
+             &Handle,
+             &gEdkiiTimerEventStatisticsProtocolGuid,
+             &mEfiTimerEventStatisticsProtocol,
+             NULL
+             );
+  ASSERT_EFI_ERROR (Status);
 }
 
 
@@ -208,19 +506,19 @@ CoreTimerTick (
   // Update the system time
   //
   mEfiSystemTime += Duration;
+  mEfiTimerStatistics.Ticks++;
 
   //
-  // If the head of the list is expired, fire the timer event
+  // If the root of the heap is expired, fire the timer event
   // to process it
   //
-  if (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
-
-    if (Event->Timer.TriggerTime <= mEfiSystemTime) {
-      CoreSignalEvent (mEfiCheckTimerEvent);
-    }
+  Event = CoreFirstEventTimer ();
+  if ((Event != NULL) && (Event->Timer.TriggerTime <= mEfiSystemTime)) {
+    CoreSignalEvent (mEfiCheckTimerEvent);
   }
 
+  CoreReportTimerDeadline (mEfiSystemTime);
+
   CoreReleaseLock (&mEfiSystemTimeLock);
 }
 
@@ -270,9 +568,9 @@ CoreSetTimer (
   //
   // If the timer is queued to the timer database, remove it
   //
-  if (Event->Timer.Link.ForwardLink != NULL) {
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
+  if (Event->Timer.HeapIndex != 0) {
+    CoreRemoveEventTimer (Event);
+    mEfiTimerStatistics.Cancelled++;
   }
 
   Event->Timer.TriggerTime = 0;
@@ -289,12 +587,57 @@ CoreSetTimer (
 
     Event->Timer.TriggerTime = CoreCurrentSystemTime () + TriggerTime;
     CoreInsertEventTimer (Event);
+    mEfiTimerStatistics.Set++;
 
     if (TriggerTime == 0) {
       CoreSignalEvent (mEfiCheckTimerEvent);
     }
   }
 
+  CoreReportTimerDeadline (CoreCurrentSystemTime ());
+
+  CoreReleaseLock (&mEfiTimerLock);
+
+  return EFI_SUCCESS;
+}
+
+
+/**
+  Returns the timer event statistics, and optionally resets them.
+
+  @param  This                   The EDKII_TIMER_EVENT_STATISTICS_PROTOCOL instance
+  @param  Reset                  TRUE to reset the statistics after reading them
+  @param  Statistics             The statistics
+
+  @retval EFI_SUCCESS            The statistics were returned
+  @retval EFI_INVALID_PARAMETER  Statistics is NULL
+
+**/
+EFI_STATUS
+EFIAPI
+CoreGetTimerEventStatistics (
+  IN  EDKII_TIMER_EVENT_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                                Reset,
+  OUT EDKII_TIMER_EVENT_STATISTICS           *Statistics
+  )
+{
+  if (Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CoreAcquireLock (&mEfiTimerLock);
+  CoreAcquireLock (&mEfiSystemTimeLock);
+
+  mEfiTimerStatistics.Queued = mEfiTimerCount;
+  mEfiTimerStatistics.TimerEvents = mEfiTimerEvents;
+  CopyMem (Statistics, &mEfiTimerStatistics, sizeof (*Statistics));
+
+  if (Reset) {
+    ZeroMem (&mEfiTimerStatistics, sizeof (mEfiTimerStatistics));
+    mEfiTimerStatistics.MaxQueued = mEfiTimerCount;
+  }
+
+  CoreReleaseLock (&mEfiSystemTimeLock);
   CoreReleaseLock (&mEfiTimerLock);
 
   return EFI_SUCCESS;
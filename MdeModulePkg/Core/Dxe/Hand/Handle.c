@@ -27,6 +27,215 @@ LIST_ENTRY      gHandleList           = INITIALIZE_LIST_HEAD_VARIABLE (gHandleLi
 EFI_LOCK        gProtocolDatabaseLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
 UINT64          gHandleDatabaseKey    = 0;
 
+//
+// mProtocolHash         - The protocol entries of mProtocolDatabase by protocol ID
+// mHandleHash           - The handles of gHandleList by value, so a handle is
+//                         validated without dereferencing it
+// mInterfaceHash        - The protocol interfaces by handle and protocol entry,
+//                         a handle has at most one interface per protocol
+// All of them are updated with the gProtocolDatabaseLock owned
+//
+PROTOCOL_ENTRY      *mProtocolHash[1 << PROTOCOL_HASH_BITS];
+IHANDLE             *mHandleHash[1 << HANDLE_HASH_BITS];
+PROTOCOL_INTERFACE  *mInterfaceHash[1 << INTERFACE_HASH_BITS];
+
+
+
+/**
+  Spreads a key over the buckets of a hash index.
+
+  @param  Key                    The value to hash
+  @param  Bits                   Log2 of the number of buckets of the index
+
+  @return The bucket of Key
+
+**/
+UINTN
+CoreHashBucket (
+  IN UINT32     Key,
+  IN UINTN      Bits
+  )
+{
+  //
+  // Fibonacci hashing, the high bits of the product depend on all the bits of Key
+  //
+  return (UINTN)((UINT32)(Key * 0x9E3779B1) >> (32 - Bits));
+}
+
+
+
+/**
+  Returns the bucket of a protocol ID in mProtocolHash.
+
+  @param  Protocol               The ID of the protocol
+
+  @return The bucket of Protocol
+
+**/
+UINTN
+CoreProtocolHashBucket (
+  IN EFI_GUID   *Protocol
+  )
+{
+  UINT32              *Words;
+
+  Words = (UINT32 *)Protocol;
+  return CoreHashBucket (
+           ReadUnaligned32 (&Words[0]) ^ ReadUnaligned32 (&Words[1]) ^
+           ReadUnaligned32 (&Words[2]) ^ ReadUnaligned32 (&Words[3]),
+           PROTOCOL_HASH_BITS
+           );
+}
+
+
+
+/**
+  Returns the bucket of a protocol interface in mInterfaceHash.
+
+  @param  Handle                 The handle the protocol interface is installed on
+  @param  ProtEntry              The protocol entry of the protocol interface
+
+  @return The bucket of the protocol interface
+
+**/
+UINTN
+CoreInterfaceHashBucket (
+  IN IHANDLE          *Handle,
+  IN PROTOCOL_ENTRY   *ProtEntry
+  )
+{
+  return CoreHashBucket ((UINT32)(UINTN)Handle ^ ((UINT32)(UINTN)ProtEntry >> 3), INTERFACE_HASH_BITS);
+}
+
+
+
+/**
+  Adds a new handle to mHandleHash.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to add
+
+**/
+VOID
+CoreInsertHandleHash (
+  IN IHANDLE        *Handle
+  )
+{
+  UINTN               Bucket;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Bucket = CoreHashBucket ((UINT32)(UINTN)Handle, HANDLE_HASH_BITS);
+  Handle->HashNext = mHandleHash[Bucket];
+  mHandleHash[Bucket] = Handle;
+}
+
+
+
+/**
+  Removes a handle from mHandleHash before it is freed.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to remove
+
+**/
+VOID
+CoreRemoveHandleHash (
+  IN IHANDLE        *Handle
+  )
+{
+  IHANDLE             **Link;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Link = &mHandleHash[CoreHashBucket ((UINT32)(UINTN)Handle, HANDLE_HASH_BITS)];
+  while (*Link != Handle) {
+    ASSERT (*Link != NULL);
+    Link = &(*Link)->HashNext;
+  }
+  *Link = Handle->HashNext;
+}
+
+
+
+/**
+  Adds a protocol interface being installed to mInterfaceHash.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Prot                   The protocol interface to add
+
+**/
+VOID
+CoreInsertInterfaceHash (
+  IN PROTOCOL_INTERFACE   *Prot
+  )
+{
+  UINTN               Bucket;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Bucket = CoreInterfaceHashBucket (Prot->Handle, Prot->Protocol);
+  Prot->HashNext = mInterfaceHash[Bucket];
+  mInterfaceHash[Bucket] = Prot;
+}
+
+
+
+/**
+  Removes a protocol interface being uninstalled from mInterfaceHash.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Prot                   The protocol interface to remove
+
+**/
+VOID
+CoreRemoveInterfaceHash (
+  IN PROTOCOL_INTERFACE   *Prot
+  )
+{
+  PROTOCOL_INTERFACE  **Link;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  Link = &mInterfaceHash[CoreInterfaceHashBucket (Prot->Handle, Prot->Protocol)];
+  while (*Link != Prot) {
+    ASSERT (*Link != NULL);
+    Link = &(*Link)->HashNext;
+  }
+  *Link = Prot->HashNext;
+}
+
+
+
+/**
+  Finds the protocol interface of a protocol entry installed on a handle.
+  The gProtocolDatabaseLock must be owned
+
+  @param  Handle                 The handle to search the protocol on
+  @param  ProtEntry              The protocol entry of the protocol
+
+  @return Protocol instance (NULL: Not found)
+
+**/
+PROTOCOL_INTERFACE *
+CoreLookupInterfaceHash (
+  IN IHANDLE          *Handle,
+  IN PROTOCOL_ENTRY   *ProtEntry
+  )
+{
+  PROTOCOL_INTERFACE  *Prot;
+
+  ASSERT_LOCKED(&gProtocolDatabaseLock);
+
+  for (Prot = mInterfaceHash[CoreInterfaceHashBucket (Handle, ProtEntry)]; Prot != NULL; Prot = Prot->HashNext) {
+    if (Prot->Handle == Handle && Prot->Protocol == ProtEntry) {
+      break;
+    }
+  }
+
+  return Prot;
+}
+
 
 
 /**
@@ -72,14 +281,30 @@ CoreValidateHandle (
   )
 {
   IHANDLE             *Handle;
+  EFI_TPL             OldTpl;
 
-  Handle = (IHANDLE *)UserHandle;
-  if (Handle == NULL) {
+  if (UserHandle == NULL) {
     return EFI_INVALID_PARAMETER;
   }
-  if (Handle->Signature != EFI_HANDLE_SIGNATURE) {
+
+  //
+  // The handles are added and removed with the gProtocolDatabaseLock owned,
+  // raising to its TPL is enough to walk the bucket
+  //
+  OldTpl = CoreRaiseTpl (TPL_NOTIFY);
+  for (Handle = mHandleHash[CoreHashBucket ((UINT32)(UINTN)UserHandle, HANDLE_HASH_BITS)];
+       Handle != NULL;
+       Handle = Handle->HashNext) {
+    if (Handle == UserHandle) {
+      break;
+    }
+  }
+  CoreRestoreTpl (OldTpl);
+
+  if (Handle == NULL) {
     return EFI_INVALID_PARAMETER;
   }
+  ASSERT_IS_HANDLE (Handle);
   return EFI_SUCCESS;
 }
 
@@ -101,29 +326,23 @@ CoreFindProtocolEntry (
   IN BOOLEAN    Create
   )
 {
-  LIST_ENTRY          *Link;
-  PROTOCOL_ENTRY      *Item;
   PROTOCOL_ENTRY      *ProtEntry;
+  UINTN               Bucket;
 
   ASSERT_LOCKED(&gProtocolDatabaseLock);
 
   //
-  // Search the database for the matching GUID
+  // Search the hash index of the database for the matching GUID
   //
 
-  ProtEntry = NULL;
-  for (Link = mProtocolDatabase.ForwardLink;
-       Link != &mProtocolDatabase;
-       Link = Link->ForwardLink) {
-
-    Item = CR(Link, PROTOCOL_ENTRY, AllEntries, PROTOCOL_ENTRY_SIGNATURE);
-    if (CompareGuid (&Item->ProtocolID, Protocol)) {
+  Bucket = CoreProtocolHashBucket (Protocol);
+  for (ProtEntry = mProtocolHash[Bucket]; ProtEntry != NULL; ProtEntry = ProtEntry->HashNext) {
+    if (CompareGuid (&ProtEntry->ProtocolID, Protocol)) {
 
       //
       // This is the protocol entry
       //
 
-      ProtEntry = Item;
       break;
     }
   }
@@ -143,11 +362,14 @@ CoreFindProtocolEntry (
       CopyGuid ((VOID *)&ProtEntry->ProtocolID, Protocol);
       InitializeListHead (&ProtEntry->Protocols);
       InitializeListHead (&ProtEntry->Notify);
+      InitializeListHead (&ProtEntry->DepexWaiters);
 
       //
-      // Add it to protocol database
+      // Add it to protocol database, protocol entries are never removed
       //
       InsertTailList (&mProtocolDatabase, &ProtEntry->AllEntries);
+      ProtEntry->HashNext = mProtocolHash[Bucket];
+      mProtocolHash[Bucket] = ProtEntry;
     }
   }
 
@@ -177,7 +399,6 @@ CoreFindProtocolInterface (
 {
   PROTOCOL_INTERFACE  *Prot;
   PROTOCOL_ENTRY      *ProtEntry;
-  LIST_ENTRY          *Link;
 
   ASSERT_LOCKED(&gProtocolDatabaseLock);
   Prot = NULL;
@@ -190,18 +411,10 @@ CoreFindProtocolInterface (
   if (ProtEntry != NULL) {
 
     //
-    // Look at each protocol interface for any matches
+    // The handle has at most one interface for the protocol, check it matches
     //
-    for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link=Link->ForwardLink) {
-
-      //
-      // If this protocol interface matches, remove it
-      //
-      Prot = CR(Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
-      if (Prot->Interface == Interface && Prot->Protocol == ProtEntry) {
-        break;
-      }
-
+    Prot = CoreLookupInterfaceHash (Handle, ProtEntry);
+    if ((Prot != NULL) && (Prot->Interface != Interface)) {
       Prot = NULL;
     }
   }
@@ -428,6 +641,7 @@ CoreInstallProtocolInterfaceNotify (
     // in the system
     //
     InsertTailList (&gHandleList, &Handle->AllHandles);
+    CoreInsertHandleHash (Handle);
   }
 
   Status = CoreValidateHandle (Handle);
@@ -465,6 +679,13 @@ CoreInstallProtocolInterfaceNotify (
   // protocol entry
   //
   InsertTailList (&ProtEntry->Protocols, &Prot->ByProtocol);
+  CoreInsertInterfaceHash (Prot);
+
+  //
+  // The drivers whose dependency expression pushes this protocol may be
+  // ready, even when the notifications are deferred
+  //
+  CoreNotifyDepexWaiters (ProtEntry);
 
   //
   // Notify the notification list for this protocol
@@ -780,6 +1001,7 @@ CoreUninstallProtocolInterface (
     // Remove the protocol interface from the handle
     //
     RemoveEntryList (&Prot->Link);
+    CoreRemoveInterfaceHash (Prot);
 
     //
     // Free the memory
@@ -795,6 +1017,7 @@ CoreUninstallProtocolInterface (
   if (IsListEmpty (&Handle->Protocols)) {
     Handle->Signature = 0;
     RemoveEntryList (&Handle->AllHandles);
+    CoreRemoveHandleHash (Handle);
     CoreFreePool (Handle);
   }
 
@@ -893,28 +1116,21 @@ CoreGetProtocolInterface (
 {
   EFI_STATUS          Status;
   PROTOCOL_ENTRY      *ProtEntry;
-  PROTOCOL_INTERFACE  *Prot;
-  IHANDLE             *Handle;
-  LIST_ENTRY          *Link;
 
   Status = CoreValidateHandle (UserHandle);
   if (EFI_ERROR (Status)) {
     return NULL;
   }
 
-  Handle = (IHANDLE *)UserHandle;
-
   //
-  // Look at each protocol interface for a match
+  // A protocol nothing was ever installed for has no entry
   //
-  for (Link = Handle->Protocols.ForwardLink; Link != &Handle->Protocols; Link = Link->ForwardLink) {
-    Prot = CR(Link, PROTOCOL_INTERFACE, Link, PROTOCOL_INTERFACE_SIGNATURE);
-    ProtEntry = Prot->Protocol;
-    if (CompareGuid (&ProtEntry->ProtocolID, Protocol)) {
-      return Prot;
-    }
+  ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
+  if (ProtEntry == NULL) {
+    return NULL;
   }
-  return NULL;
+
+  return CoreLookupInterfaceHash ((IHANDLE *)UserHandle, ProtEntry);
 }
 
 
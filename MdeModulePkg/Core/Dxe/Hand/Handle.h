@@ -18,10 +18,18 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #define EFI_HANDLE_SIGNATURE            SIGNATURE_32('h','n','d','l')
 
+//
+// Number of buckets of the hash indexes of the protocol database, the lists
+// stay the reference for the order of the protocols and handles
+//
+#define PROTOCOL_HASH_BITS              7
+#define HANDLE_HASH_BITS                9
+#define INTERFACE_HASH_BITS             10
+
 ///
 /// IHANDLE - contains a list of protocol handles
 ///
-typedef struct {
+typedef struct _IHANDLE {
   UINTN               Signature;
   /// All handles list of IHANDLE
   LIST_ENTRY          AllHandles;
@@ -30,6 +38,8 @@ typedef struct {
   UINTN               LocateRequest;
   /// The Handle Database Key value when this handle was last created or modified
   UINT64              Key;
+  /// Next handle in the same bucket of mHandleHash
+  struct _IHANDLE     *HashNext;
 } IHANDLE;
 
 #define ASSERT_IS_HANDLE(a)  ASSERT((a)->Signature == EFI_HANDLE_SIGNATURE)
@@ -41,7 +51,7 @@ typedef struct {
 /// database.  Each handler that supports this protocol is listed, along
 /// with a list of registered notifies.
 ///
-typedef struct {
+typedef struct _PROTOCOL_ENTRY {
   UINTN               Signature;
   /// Link Entry inserted to mProtocolDatabase
   LIST_ENTRY          AllEntries;  
@@ -51,6 +61,10 @@ typedef struct {
   LIST_ENTRY          Protocols;     
   /// Registerd notification handlers
   LIST_ENTRY          Notify;                 
+  /// Drivers whose dependency expression pushes this protocol
+  LIST_ENTRY          DepexWaiters;
+  /// Next protocol entry in the same bucket of mProtocolHash
+  struct _PROTOCOL_ENTRY  *HashNext;
 } PROTOCOL_ENTRY;
 
 
@@ -60,7 +74,7 @@ typedef struct {
 /// PROTOCOL_INTERFACE - each protocol installed on a handle is tracked
 /// with a protocol interface structure
 ///
-typedef struct {
+typedef struct _PROTOCOL_INTERFACE {
   UINTN                       Signature;
   /// Link on IHANDLE.Protocols
   LIST_ENTRY                  Link;   
@@ -75,6 +89,8 @@ typedef struct {
   /// OPEN_PROTOCOL_DATA list
   LIST_ENTRY                  OpenList;       
   UINTN                       OpenListCount;
+  /// Next protocol interface in the same bucket of mInterfaceHash
+  struct _PROTOCOL_INTERFACE  *HashNext;
 
 } PROTOCOL_INTERFACE;
 
@@ -139,6 +155,19 @@ CoreNotifyProtocolEntry (
   );
 
 
+/**
+  Queue every driver waiting on the protocol entry for the evaluation of its
+  dependency expression.
+
+  @param  ProtEntry              Protocol entry
+
+**/
+VOID
+CoreNotifyDepexWaiters (
+  IN PROTOCOL_ENTRY   *ProtEntry
+  );
+
+
 /**
   Finds the protocol instance for the requested handle and protocol.
   Note: This function doesn't do parameters checking, it's caller's responsibility
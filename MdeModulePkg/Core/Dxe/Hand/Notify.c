@@ -39,6 +39,84 @@ CoreNotifyProtocolEntry (
 }
 
 
+/**
+  Queue every driver waiting on the protocol entry for the evaluation of its
+  dependency expression.
+
+  @param  ProtEntry              Protocol entry
+
+**/
+VOID
+CoreNotifyDepexWaiters (
+  IN PROTOCOL_ENTRY   *ProtEntry
+  )
+{
+  DEPEX_WAITER        *Waiter;
+  LIST_ENTRY          *Link;
+
+  ASSERT_LOCKED (&gProtocolDatabaseLock);
+
+  for (Link=ProtEntry->DepexWaiters.ForwardLink; Link != &ProtEntry->DepexWaiters; Link=Link->ForwardLink) {
+    Waiter = CR(Link, DEPEX_WAITER, Link, DEPEX_WAITER_SIGNATURE);
+    CoreQueueDepexEvaluation (Waiter->DriverEntry);
+  }
+}
+
+
+/**
+  Adds a depex waiter onto the protocol entry of Protocol.
+
+  @param  Protocol               The GUID pushed by the dependency expression
+  @param  Waiter                 The waiter to add
+
+  @retval EFI_SUCCESS            The waiter was added
+  @retval EFI_OUT_OF_RESOURCES   The protocol entry could not be created
+
+**/
+EFI_STATUS
+CoreInsertDepexWaiter (
+  IN EFI_GUID       *Protocol,
+  IN DEPEX_WAITER   *Waiter
+  )
+{
+  PROTOCOL_ENTRY    *ProtEntry;
+  EFI_STATUS        Status;
+
+  CoreAcquireProtocolLock ();
+
+  //
+  // The entry is created for a protocol that is not installed yet, like for
+  // a notification
+  //
+  Status = EFI_OUT_OF_RESOURCES;
+  ProtEntry = CoreFindProtocolEntry (Protocol, TRUE);
+  if (ProtEntry != NULL) {
+    InsertTailList (&ProtEntry->DepexWaiters, &Waiter->Link);
+    Status = EFI_SUCCESS;
+  }
+
+  CoreReleaseProtocolLock ();
+  return Status;
+}
+
+
+/**
+  Removes a depex waiter from its protocol entry.
+
+  @param  Waiter                 The waiter to remove
+
+**/
+VOID
+CoreRemoveDepexWaiter (
+  IN DEPEX_WAITER   *Waiter
+  )
+{
+  CoreAcquireProtocolLock ();
+  RemoveEntryList (&Waiter->Link);
+  CoreReleaseProtocolLock ();
+}
+
+
 
 /**
   Removes Protocol from the protocol list (but not the handle list).
@@ -84,6 +162,11 @@ CoreRemoveInterfaceFromProtocol (
     // Remove the protocol interface entry
     //
     RemoveEntryList (&Prot->ByProtocol);
+
+    //
+    // A dependency expression with a NOT may become TRUE
+    //
+    CoreNotifyDepexWaiters (ProtEntry);
   }
 
   return Prot;
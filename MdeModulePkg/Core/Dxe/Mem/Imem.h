@@ -37,7 +37,9 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 //
 
 #define MEMORY_MAP_SIGNATURE   SIGNATURE_32('m','m','a','p')
-typedef struct {
+typedef struct _MEMORY_MAP MEMORY_MAP;
+
+struct _MEMORY_MAP {
   UINTN           Signature;
   LIST_ENTRY      Link;
   BOOLEAN         FromPages;
@@ -48,7 +50,18 @@ typedef struct {
 
   UINT64          VirtualStart;
   UINT64          Attribute;
-} MEMORY_MAP;
+
+  //
+  // Node of the red-black tree that indexes the memory map by address.
+  // MaxFreePages is the largest EfiConventionalMemory range in the subtree
+  // rooted at this node, so free page searches can skip whole subtrees.
+  //
+  MEMORY_MAP      *Parent;
+  MEMORY_MAP      *Left;
+  MEMORY_MAP      *Right;
+  BOOLEAN         Red;
+  UINT64          MaxFreePages;
+};
 
 //
 // Internal prototypes
@@ -51,6 +51,11 @@ UINTN         mFreeMapStack = 0;
 ///
 LIST_ENTRY   mFreeMemoryMapEntryList = INITIALIZE_LIST_HEAD_VARIABLE (mFreeMemoryMapEntryList);
 BOOLEAN      mMemoryTypeInformationInitialized = FALSE;
+///
+/// mMemoryMapRoot - Root of the red-black tree indexing the gMemoryMap entries
+/// by address. gMemoryMap keeps the order the memory map is reported in.
+///
+MEMORY_MAP   *mMemoryMapRoot = NULL;
 
 EFI_MEMORY_TYPE_STATISTICS mMemoryTypeStatistics[EfiMaxMemoryType + 1] = {
   { 0, MAX_ADDRESS, 0, 0, EfiMaxMemoryType, TRUE,  FALSE },  // EfiReservedMemoryType
@@ -123,7 +128,452 @@ CoreReleaseMemoryLock (
   CoreReleaseLock (&gMemoryLock);
 }
 
+//
+// Memory map tree functions
+//
+/**
+  Returns the number of free pages a descriptor entry contributes to the
+  free page searches.
+
+  @param  Entry                  The descriptor entry
+
+  @return The number of pages of an EfiConventionalMemory entry, 0 otherwise
+
+**/
+UINT64
+MemoryMapEntryFreePages (
+  IN MEMORY_MAP   *Entry
+  )
+{
+  if (Entry->Type != EfiConventionalMemory) {
+    return 0;
+  }
+  return RShiftU64 (Entry->End - Entry->Start + 1, EFI_PAGE_SHIFT);
+}
+
+/**
+  Recomputes the largest free range of the subtree rooted at a node from
+  the node and its children.
+
+  @param  Node                   The node of the memory map tree
+
+**/
+VOID
+MemoryMapTreeUpdateNode (
+  IN OUT MEMORY_MAP   *Node
+  )
+{
+  UINT64          MaxFreePages;
+
+  MaxFreePages = MemoryMapEntryFreePages (Node);
+  if (Node->Left != NULL && Node->Left->MaxFreePages > MaxFreePages) {
+    MaxFreePages = Node->Left->MaxFreePages;
+  }
+  if (Node->Right != NULL && Node->Right->MaxFreePages > MaxFreePages) {
+    MaxFreePages = Node->Right->MaxFreePages;
+  }
+  Node->MaxFreePages = MaxFreePages;
+}
+
+/**
+  Recomputes the largest free ranges from a node up to the root of the
+  memory map tree. Called when the range or the type of a node changes.
+
+  @param  Node                   The node of the memory map tree, or NULL
+
+**/
+VOID
+MemoryMapTreeUpdatePath (
+  IN MEMORY_MAP   *Node
+  )
+{
+  while (Node != NULL) {
+    MemoryMapTreeUpdateNode (Node);
+    Node = Node->Parent;
+  }
+}
+
+/**
+  Makes a parent point to a new child in place of an old one.
+
+  @param  Parent                 The parent, or NULL if OldChild is the root
+  @param  OldChild               The child being replaced
+  @param  NewChild               The replacement child, or NULL
+
+**/
+VOID
+MemoryMapTreeReplaceChild (
+  IN MEMORY_MAP   *Parent,
+  IN MEMORY_MAP   *OldChild,
+  IN MEMORY_MAP   *NewChild
+  )
+{
+  if (Parent == NULL) {
+    mMemoryMapRoot = NewChild;
+  } else if (Parent->Left == OldChild) {
+    Parent->Left = NewChild;
+  } else {
+    Parent->Right = NewChild;
+  }
+}
+
+/**
+  Rotates the memory map tree left around a node.
+
+  @param  Node                   The node, its right child takes its place
+
+**/
+VOID
+MemoryMapTreeRotateLeft (
+  IN MEMORY_MAP   *Node
+  )
+{
+  MEMORY_MAP      *Pivot;
+
+  Pivot = Node->Right;
+  Node->Right = Pivot->Left;
+  if (Pivot->Left != NULL) {
+    Pivot->Left->Parent = Node;
+  }
+  Pivot->Parent = Node->Parent;
+  MemoryMapTreeReplaceChild (Node->Parent, Node, Pivot);
+  Pivot->Left  = Node;
+  Node->Parent = Pivot;
+
+  MemoryMapTreeUpdateNode (Node);
+  MemoryMapTreeUpdateNode (Pivot);
+}
+
+/**
+  Rotates the memory map tree right around a node.
+
+  @param  Node                   The node, its left child takes its place
+
+**/
+VOID
+MemoryMapTreeRotateRight (
+  IN MEMORY_MAP   *Node
+  )
+{
+  MEMORY_MAP      *Pivot;
+
+  Pivot = Node->Left;
+  Node->Left = Pivot->Right;
+  if (Pivot->Right != NULL) {
+    Pivot->Right->Parent = Node;
+  }
+  Pivot->Parent = Node->Parent;
+  MemoryMapTreeReplaceChild (Node->Parent, Node, Pivot);
+  Pivot->Right = Node;
+  Node->Parent = Pivot;
+
+  MemoryMapTreeUpdateNode (Node);
+  MemoryMapTreeUpdateNode (Pivot);
+}
+
+/**
+  Inserts a descriptor entry into the memory map tree. The range of the
+  entry must not overlap the range of any entry in the tree.
+
+  @param  Entry                  The descriptor entry to insert
+
+**/
+VOID
+MemoryMapTreeInsert (
+  IN OUT MEMORY_MAP   *Entry
+  )
+{
+  MEMORY_MAP      **Link;
+  MEMORY_MAP      *Parent;
+  MEMORY_MAP      *Uncle;
+  MEMORY_MAP      *Grandparent;
+
+  Parent = NULL;
+  Link   = &mMemoryMapRoot;
+  while (*Link != NULL) {
+    Parent = *Link;
+    Link   = (Entry->Start < Parent->Start) ? &Parent->Left : &Parent->Right;
+  }
+
+  Entry->Parent = Parent;
+  Entry->Left   = NULL;
+  Entry->Right  = NULL;
+  Entry->Red    = TRUE;
+  *Link = Entry;
+  MemoryMapTreeUpdatePath (Entry);
+
+  //
+  // Restore the red-black properties. The rotations keep the set of entries
+  // below the top of each subtree, so the free ranges above stay valid.
+  //
+  while ((Parent = Entry->Parent) != NULL && Parent->Red) {
+    Grandparent = Parent->Parent;
+    if (Parent == Grandparent->Left) {
+      Uncle = Grandparent->Right;
+      if (Uncle != NULL && Uncle->Red) {
+        Parent->Red      = FALSE;
+        Uncle->Red       = FALSE;
+        Grandparent->Red = TRUE;
+        Entry = Grandparent;
+        continue;
+      }
+      if (Entry == Parent->Right) {
+        MemoryMapTreeRotateLeft (Parent);
+        Entry  = Parent;
+        Parent = Entry->Parent;
+      }
+      Parent->Red      = FALSE;
+      Grandparent->Red = TRUE;
+      MemoryMapTreeRotateRight (Grandparent);
+    } else {
+      Uncle = Grandparent->Left;
+      if (Uncle != NULL && Uncle->Red) {
+        Parent->Red      = FALSE;
+        Uncle->Red       = FALSE;
+        Grandparent->Red = TRUE;
+        Entry = Grandparent;
+        continue;
+      }
+      if (Entry == Parent->Left) {
+        MemoryMapTreeRotateRight (Parent);
+        Entry  = Parent;
+        Parent = Entry->Parent;
+      }
+      Parent->Red      = FALSE;
+      Grandparent->Red = TRUE;
+      MemoryMapTreeRotateLeft (Grandparent);
+    }
+  }
+  mMemoryMapRoot->Red = FALSE;
+}
+
+/**
+  Removes a descriptor entry from the memory map tree.
+
+  @param  Entry                  The descriptor entry to remove
+
+**/
+VOID
+MemoryMapTreeRemove (
+  IN OUT MEMORY_MAP   *Entry
+  )
+{
+  MEMORY_MAP      *Node;
+  MEMORY_MAP      *Child;
+  MEMORY_MAP      *Parent;
+  MEMORY_MAP      *Sibling;
+  BOOLEAN         RemovedRed;
+
+  //
+  // Node is the entry that leaves its position: Entry itself if it has at
+  // most one child, its successor otherwise. The successor then takes the
+  // position of Entry.
+  //
+  if (Entry->Left == NULL || Entry->Right == NULL) {
+    Node = Entry;
+  } else {
+    Node = Entry->Right;
+    while (Node->Left != NULL) {
+      Node = Node->Left;
+    }
+  }
+
+  Child  = (Node->Left != NULL) ? Node->Left : Node->Right;
+  Parent = Node->Parent;
+  if (Child != NULL) {
+    Child->Parent = Parent;
+  }
+  MemoryMapTreeReplaceChild (Parent, Node, Child);
+  RemovedRed = Node->Red;
+
+  if (Node != Entry) {
+    if (Parent == Entry) {
+      Parent = Node;
+    }
+    Node->Parent = Entry->Parent;
+    Node->Left   = Entry->Left;
+    Node->Right  = Entry->Right;
+    Node->Red    = Entry->Red;
+    MemoryMapTreeReplaceChild (Entry->Parent, Entry, Node);
+    if (Node->Left != NULL) {
+      Node->Left->Parent = Node;
+    }
+    if (Node->Right != NULL) {
+      Node->Right->Parent = Node;
+    }
+  }
+  MemoryMapTreeUpdatePath (Parent);
+
+  Entry->Parent = NULL;
+  Entry->Left   = NULL;
+  Entry->Right  = NULL;
+
+  if (RemovedRed) {
+    return;
+  }
+
+  //
+  // Child carries an extra black, push it up until it can be absorbed
+  //
+  while (Child != mMemoryMapRoot && (Child == NULL || !Child->Red)) {
+    if (Child == Parent->Left) {
+      Sibling = Parent->Right;
+      if (Sibling->Red) {
+        Sibling->Red = FALSE;
+        Parent->Red  = TRUE;
+        MemoryMapTreeRotateLeft (Parent);
+        Sibling = Parent->Right;
+      }
+      if ((Sibling->Left == NULL || !Sibling->Left->Red) &&
+          (Sibling->Right == NULL || !Sibling->Right->Red)) {
+        Sibling->Red = TRUE;
+        Child  = Parent;
+        Parent = Child->Parent;
+      } else {
+        if (Sibling->Right == NULL || !Sibling->Right->Red) {
+          Sibling->Left->Red = FALSE;
+          Sibling->Red       = TRUE;
+          MemoryMapTreeRotateRight (Sibling);
+          Sibling = Parent->Right;
+        }
+        Sibling->Red        = Parent->Red;
+        Parent->Red         = FALSE;
+        Sibling->Right->Red = FALSE;
+        MemoryMapTreeRotateLeft (Parent);
+        Child = mMemoryMapRoot;
+      }
+    } else {
+      Sibling = Parent->Left;
+      if (Sibling->Red) {
+        Sibling->Red = FALSE;
+        Parent->Red  = TRUE;
+        MemoryMapTreeRotateRight (Parent);
+        Sibling = Parent->Left;
+      }
+      if ((Sibling->Left == NULL || !Sibling->Left->Red) &&
+          (Sibling->Right == NULL || !Sibling->Right->Red)) {
+        Sibling->Red = TRUE;
+        Child  = Parent;
+        Parent = Child->Parent;
+      } else {
+        if (Sibling->Left == NULL || !Sibling->Left->Red) {
+          Sibling->Right->Red = FALSE;
+          Sibling->Red        = TRUE;
+          MemoryMapTreeRotateLeft (Sibling);
+          Sibling = Parent->Left;
+        }
+        Sibling->Red       = Parent->Red;
+        Parent->Red        = FALSE;
+        Sibling->Left->Red = FALSE;
+        MemoryMapTreeRotateRight (Parent);
+        Child = mMemoryMapRoot;
+      }
+    }
+  }
+  if (Child != NULL) {
+    Child->Red = FALSE;
+  }
+}
+
+/**
+  Moves a node of the memory map tree to a copy of its descriptor entry.
+
+  @param  OldEntry               The descriptor entry in the tree
+  @param  NewEntry               The copy of OldEntry taking its place
+
+**/
+VOID
+MemoryMapTreeReplace (
+  IN MEMORY_MAP       *OldEntry,
+  IN OUT MEMORY_MAP   *NewEntry
+  )
+{
+  MemoryMapTreeReplaceChild (NewEntry->Parent, OldEntry, NewEntry);
+  if (NewEntry->Left != NULL) {
+    NewEntry->Left->Parent = NewEntry;
+  }
+  if (NewEntry->Right != NULL) {
+    NewEntry->Right->Parent = NewEntry;
+  }
+}
+
+/**
+  Returns the descriptor entry that follows another one in address order.
+
+  @param  Entry                  The descriptor entry
+
+  @return The next descriptor entry, or NULL if Entry is the last one
+
+**/
+MEMORY_MAP *
+MemoryMapTreeNext (
+  IN MEMORY_MAP   *Entry
+  )
+{
+  if (Entry->Right != NULL) {
+    Entry = Entry->Right;
+    while (Entry->Left != NULL) {
+      Entry = Entry->Left;
+    }
+    return Entry;
+  }
+  while (Entry->Parent != NULL && Entry == Entry->Parent->Right) {
+    Entry = Entry->Parent;
+  }
+  return Entry->Parent;
+}
+
+/**
+  Returns the descriptor entry with the highest start address not above an
+  address.
+
+  @param  Address                The address
+
+  @return The descriptor entry, or NULL if all entries start above Address
+
+**/
+MEMORY_MAP *
+MemoryMapTreeFloor (
+  IN UINT64       Address
+  )
+{
+  MEMORY_MAP      *Node;
+  MEMORY_MAP      *Floor;
+
+  Floor = NULL;
+  Node  = mMemoryMapRoot;
+  while (Node != NULL) {
+    if (Node->Start <= Address) {
+      Floor = Node;
+      Node  = Node->Right;
+    } else {
+      Node  = Node->Left;
+    }
+  }
+  return Floor;
+}
+
+/**
+  Internal function.  Finds the descriptor entry that covers an address.
+
+  @param  Address                The address
 
+  @return The descriptor entry, or NULL if no entry covers the address
+
+**/
+MEMORY_MAP *
+CoreFindMemoryMapEntry (
+  IN UINT64       Address
+  )
+{
+  MEMORY_MAP      *Entry;
+
+  Entry = MemoryMapTreeFloor (Address);
+  if (Entry == NULL || Entry->End <= Address) {
+    return NULL;
+  }
+  return Entry;
+}
 
 
 /**
@@ -139,6 +589,7 @@ RemoveMemoryMapEntry (
 {
   RemoveEntryList (&Entry->Link);
   Entry->Link.ForwardLink = NULL;
+  MemoryMapTreeRemove (Entry);
 
   if (Entry->FromPages) {
     //
@@ -168,7 +619,6 @@ CoreAddRange (
   IN UINT64                   Attribute
   )
 {
-  LIST_ENTRY        *Link;
   MEMORY_MAP        *Entry;
 
   ASSERT ((Start & EFI_PAGE_MASK) == 0);
@@ -215,25 +665,20 @@ CoreAddRange (
   // and the same Attribute
   //
 
-  Link = gMemoryMap.ForwardLink;
-  while (Link != &gMemoryMap) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    Link  = Link->ForwardLink;
-
-    if (Entry->Type != Type) {
-      continue;
-    }
-
-    if (Entry->Attribute != Attribute) {
-      continue;
-    }
-
-    if (Entry->End + 1 == Start) {
+  if (Start != 0) {
+    Entry = MemoryMapTreeFloor (Start - 1);
+    if (Entry != NULL && Entry->End + 1 == Start &&
+        Entry->Type == Type && Entry->Attribute == Attribute) {
 
       Start = Entry->Start;
       RemoveMemoryMapEntry (Entry);
+    }
+  }
 
-    } else if (Entry->Start == End + 1) {
+  if (End != MAX_UINT64) {
+    Entry = MemoryMapTreeFloor (End + 1);
+    if (Entry != NULL && Entry->Start == End + 1 &&
+        Entry->Type == Type && Entry->Attribute == Attribute) {
 
       End = Entry->End;
       RemoveMemoryMapEntry (Entry);
@@ -252,6 +697,7 @@ CoreAddRange (
   mMapStack[mMapDepth].VirtualStart  = 0;
   mMapStack[mMapDepth].Attribute     = Attribute;
   InsertTailList (&gMemoryMap, &mMapStack[mMapDepth].Link);
+  MemoryMapTreeInsert (&mMapStack[mMapDepth]);
 
   mMapDepth += 1;
   ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -359,13 +805,17 @@ CoreFreeMemoryMapStack (
 
       CopyMem (Entry , &mMapStack[mMapDepth], sizeof (MEMORY_MAP));
       Entry->FromPages = TRUE;
+      MemoryMapTreeReplace (&mMapStack[mMapDepth], Entry);
 
       //
-      // Find insertion location
+      // Find insertion location. The entries from pages are kept in
+      // address order in gMemoryMap, so this is before the next one of
+      // them in the tree. The entries still on the stack are skipped.
       //
-      for (Link2 = gMemoryMap.ForwardLink; Link2 != &gMemoryMap; Link2 = Link2->ForwardLink) {
-        Entry2 = CR (Link2, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-        if (Entry2->FromPages && Entry2->Start > Entry->Start) {
+      Link2 = &gMemoryMap;
+      for (Entry2 = MemoryMapTreeNext (Entry); Entry2 != NULL; Entry2 = MemoryMapTreeNext (Entry2)) {
+        if (Entry2->FromPages) {
+          Link2 = &Entry2->Link;
           break;
         }
       }
@@ -706,7 +1156,6 @@ CoreConvertPagesEx (
   UINT64          RangeEnd;
   UINT64          Attribute;
   EFI_MEMORY_TYPE MemType;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
 
   Entry = NULL;
@@ -732,15 +1181,9 @@ CoreConvertPagesEx (
     //
     // Find the entry that the covers the range
     //
-    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-      if (Entry->Start <= Start && Entry->End > Start) {
-        break;
-      }
-    }
+    Entry = CoreFindMemoryMapEntry (Start);
 
-    if (Link == &gMemoryMap) {
+    if (Entry == NULL) {
       DEBUG ((DEBUG_ERROR | DEBUG_PAGE, "ConvertPages: failed to find range %lx - %lx\n", Start, End));
       return EFI_NOT_FOUND;
     }
@@ -806,6 +1249,7 @@ CoreConvertPagesEx (
       // Clip start
       //
       Entry->Start = RangeEnd + 1;
+      MemoryMapTreeUpdatePath (Entry);
 
     } else if (Entry->End == RangeEnd) {
 
@@ -813,6 +1257,7 @@ CoreConvertPagesEx (
       // Clip end
       //
       Entry->End = Start - 1;
+      MemoryMapTreeUpdatePath (Entry);
 
     } else {
 
@@ -836,9 +1281,11 @@ CoreConvertPagesEx (
 
       Entry->End = Start - 1;
       ASSERT (Entry->Start < Entry->End);
+      MemoryMapTreeUpdatePath (Entry);
 
       Entry = &mMapStack[mMapDepth];
       InsertTailList (&gMemoryMap, &Entry->Link);
+      MemoryMapTreeInsert (Entry);
 
       mMapDepth += 1;
       ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -956,6 +1403,149 @@ CoreUpdateMemoryAttributes (
 }
 
 
+/**
+  Internal function. Finds the highest free page range that a descriptor
+  entry offers below the requested address.
+
+  @param  Entry                  The descriptor entry
+  @param  MaxAddress             The address that the range must be below, the
+                                 last byte of a page
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfBytes          Number of bytes needed
+  @param  Alignment              Bits to align with
+
+  @return The last byte of the range, or 0 if the entry has no such range
+
+**/
+UINT64
+CoreFindFreePagesInEntry (
+  IN MEMORY_MAP       *Entry,
+  IN UINT64           MaxAddress,
+  IN UINT64           MinAddress,
+  IN UINT64           NumberOfBytes,
+  IN UINTN            Alignment
+  )
+{
+  UINT64          DescStart;
+  UINT64          DescEnd;
+
+  //
+  // If it's not a free entry, don't bother with it
+  //
+  if (Entry->Type != EfiConventionalMemory) {
+    return 0;
+  }
+
+  DescStart = Entry->Start;
+  DescEnd = Entry->End;
+
+  //
+  // If desc is past max allowed address or below min allowed address, skip it
+  //
+  if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
+    return 0;
+  }
+
+  //
+  // If desc ends past max allowed address, clip the end
+  //
+  if (DescEnd >= MaxAddress) {
+    DescEnd = MaxAddress;
+  }
+
+  DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
+
+  //
+  // If the alignment leaves nothing of the descriptor, skip it
+  //
+  if (DescEnd < DescStart) {
+    return 0;
+  }
+
+  //
+  // Compute the number of bytes we can used from this
+  // descriptor, and see it's enough to satisfy the request
+  //
+  if (DescEnd - DescStart + 1 < NumberOfBytes) {
+    return 0;
+  }
+
+  //
+  // If the start of the allocated range is below the min address allowed, skip it
+  //
+  if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
+    return 0;
+  }
+
+  return DescEnd;
+}
+
+
+/**
+  Internal function. Finds the highest free page range below the requested
+  address in a subtree of the memory map tree. The entries are visited from
+  the highest address down, skipping the subtrees without a free range large
+  enough and the ones entirely outside [MinAddress, MaxAddress], so the
+  first range found is the best match.
+
+  @param  Node                   The root of the subtree, or NULL
+  @param  MaxAddress             The address that the range must be below, the
+                                 last byte of a page
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfPages          Number of pages needed
+  @param  NumberOfBytes          Number of bytes needed
+  @param  Alignment              Bits to align with
+
+  @return The last byte of the range, or 0 if the range was not found
+
+**/
+UINT64
+CoreFindFreePagesInTree (
+  IN MEMORY_MAP       *Node,
+  IN UINT64           MaxAddress,
+  IN UINT64           MinAddress,
+  IN UINT64           NumberOfPages,
+  IN UINT64           NumberOfBytes,
+  IN UINTN            Alignment
+  )
+{
+  UINT64          Target;
+
+  //
+  // The recursion only goes down the tree, so it is bounded by its height
+  //
+  while (Node != NULL && Node->MaxFreePages >= NumberOfPages) {
+    if (Node->Start >= MaxAddress) {
+      //
+      // Node and everything above it is past max allowed address
+      //
+      Node = Node->Left;
+      continue;
+    }
+
+    Target = CoreFindFreePagesInTree (Node->Right, MaxAddress, MinAddress, NumberOfPages, NumberOfBytes, Alignment);
+    if (Target != 0) {
+      return Target;
+    }
+
+    Target = CoreFindFreePagesInEntry (Node, MaxAddress, MinAddress, NumberOfBytes, Alignment);
+    if (Target != 0) {
+      return Target;
+    }
+
+    if (Node->End < MinAddress) {
+      //
+      // Everything below Node is below min allowed address
+      //
+      break;
+    }
+    Node = Node->Left;
+  }
+
+  return 0;
+}
+
+
 /**
   Internal function. Finds a consecutive free page range below
   the requested address.
@@ -981,11 +1571,6 @@ CoreFindFreePagesI (
 {
   UINT64          NumberOfBytes;
   UINT64          Target;
-  UINT64          DescStart;
-  UINT64          DescEnd;
-  UINT64          DescNumberOfBytes;
-  LIST_ENTRY      *Link;
-  MEMORY_MAP      *Entry;
 
   if ((MaxAddress < EFI_PAGE_MASK) ||(NumberOfPages == 0)) {
     return 0;
@@ -1014,59 +1599,7 @@ CoreFindFreePagesI (
   }
 
   NumberOfBytes = LShiftU64 (NumberOfPages, EFI_PAGE_SHIFT);
-  Target = 0;
-
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-    //
-    // If it's not a free entry, don't bother with it
-    //
-    if (Entry->Type != EfiConventionalMemory) {
-      continue;
-    }
-
-    DescStart = Entry->Start;
-    DescEnd = Entry->End;
-
-    //
-    // If desc is past max allowed address or below min allowed address, skip it
-    //
-    if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
-      continue;
-    }
-
-    //
-    // If desc ends past max allowed address, clip the end
-    //
-    if (DescEnd >= MaxAddress) {
-      DescEnd = MaxAddress;
-    }
-
-    DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
-
-    //
-    // Compute the number of bytes we can used from this
-    // descriptor, and see it's enough to satisfy the request
-    //
-    DescNumberOfBytes = DescEnd - DescStart + 1;
-
-    if (DescNumberOfBytes >= NumberOfBytes) {
-      //
-      // If the start of the allocated range is below the min address allowed, skip it
-      //
-      if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
-        continue;
-      }
-
-      //
-      // If this is the best match so far remember it
-      //
-      if (DescEnd > Target) {
-        Target = DescEnd;
-      }
-    }
-  }
+  Target = CoreFindFreePagesInTree (mMemoryMapRoot, MaxAddress, MinAddress, NumberOfPages, NumberOfBytes, Alignment);
 
   //
   // If this is a grow down, adjust target to be the allocation base
@@ -1322,7 +1855,6 @@ CoreInternalFreePages (
   )
 {
   EFI_STATUS      Status;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
   UINTN           Alignment;
 
@@ -1334,14 +1866,8 @@ CoreInternalFreePages (
   //
   // Find the entry that the covers the range
   //
-  Entry = NULL;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR(Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    if (Entry->Start <= Memory && Entry->End > Memory) {
-        break;
-    }
-  }
-  if (Link == &gMemoryMap) {
+  Entry = CoreFindMemoryMapEntry (Memory);
+  if (Entry == NULL) {
     Status = EFI_NOT_FOUND;
     goto Done;
   }
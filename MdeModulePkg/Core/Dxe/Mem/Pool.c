@@ -57,6 +57,89 @@ typedef struct {
 
 #define MAX_POOL_SIZE     (MAX_ADDRESS - POOL_OVERHEAD)
 
+//
+// Slab front-end for the small allocations. A slab is a page holding objects
+// of a single size class, for a single memory type. The objects carry no
+// header, FreePool() recognizes them from the signature at the start of
+// their page, which is never a POOL_SLAB_SIGNATURE in the pages of the pool
+// lists. The slab keeps a bitmap of its allocated objects, so a double free
+// is caught whatever the caller left in the freed object.
+//
+#define POOL_SLAB_MAX_SIZE        512
+#define POOL_SLAB_GRANULE         16
+#define POOL_SLAB_CLASSES         EDKII_POOL_SLAB_CLASSES
+
+//
+// Empty slabs kept per memory type for reuse. Past POOL_SLAB_EMPTY_MAX of
+// them, they are returned in a batch down to POOL_SLAB_EMPTY_KEEP.
+//
+#define POOL_SLAB_EMPTY_MAX       8
+#define POOL_SLAB_EMPTY_KEEP      2
+
+//
+// PcdPoolSlabPropertyMask bits
+//
+#define POOL_SLAB_PROPERTY_ENABLE BIT0
+#define POOL_SLAB_PROPERTY_GUARD  BIT1
+
+//
+// Upper bound of the objects of a slab, for the size of its bitmap
+//
+#define POOL_SLAB_MAX_OBJECTS     (DEFAULT_PAGE_ALLOCATION / POOL_SLAB_GRANULE)
+
+#define POOL_SLAB_SIGNATURE       SIGNATURE_32('p','s','l','b')
+typedef struct {
+  UINT32          Signature;
+  UINT16          Class;
+  UINT16          Used;
+  UINT16          Carved;
+  UINT16          Capacity;
+  EFI_MEMORY_TYPE Type;
+  //
+  // On the partial list of its class while it has free objects, on the empty
+  // list of its memory type while it has none allocated
+  //
+  LIST_ENTRY      Link;
+  VOID            *FreeList;
+  //
+  // One bit per carved object, set while it is allocated
+  //
+  UINT32          Allocated[POOL_SLAB_MAX_OBJECTS / 32];
+} POOL_SLAB;
+
+#define SIZE_OF_POOL_SLAB   ALIGN_VALUE (sizeof (POOL_SLAB), POOL_SLAB_GRANULE)
+
+#define POOL_SLAB_IS_ALLOCATED(Slab, Index)  (((Slab)->Allocated[(Index) / 32] & (1u << ((Index) % 32))) != 0)
+
+typedef struct {
+  VOID            *Next;
+} POOL_SLAB_FREE;
+
+//
+// With POOL_SLAB_PROPERTY_GUARD, the bytes of an object past the requested
+// size are filled with POOL_SLAB_PAD and a guard follows the object
+//
+#define POOL_SLAB_GUARD_SIGNATURE SIGNATURE_32('p','s','g','d')
+typedef struct {
+  UINT32          Signature;
+  UINT32          Size;
+} POOL_SLAB_GUARD;
+
+#define POOL_SLAB_PAD             0xAF
+
+typedef struct {
+  LIST_ENTRY      Partial[POOL_SLAB_CLASSES];
+  LIST_ENTRY      Empty;
+  UINTN           EmptyCount;
+} POOL_SLAB_CACHE;
+
+//
+// Object sizes of the size classes, tighter for the smallest sizes
+//
+GLOBAL_REMOVE_IF_UNREFERENCED CONST UINT16 mPoolSlabClassSize[POOL_SLAB_CLASSES] = {
+  16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+
 //
 // Globals
 //
@@ -80,6 +163,33 @@ POOL            mPoolHead[EfiMaxMemoryType];
 //
 LIST_ENTRY      mPoolHeadList = INITIALIZE_LIST_HEAD_VARIABLE (mPoolHeadList);
 
+//
+// Slab caches for each memory type below EfiMaxMemoryType, the OS specific
+// memory types only use the pool lists
+//
+POOL_SLAB_CACHE mPoolSlabCache[EfiMaxMemoryType];
+UINT8           mPoolSlabProperty;
+UINTN           mPoolSlabSlotSize[POOL_SLAB_CLASSES];
+UINT8           mPoolSlabClassOfSize[POOL_SLAB_MAX_SIZE / POOL_SLAB_GRANULE + 1];
+
+//
+// mPoolStatistics - Counters of EDKII_POOL_STATISTICS_PROTOCOL, owned by
+//                   gMemoryLock
+//
+EDKII_POOL_STATISTICS  mPoolStatistics;
+
+EFI_STATUS
+EFIAPI
+CoreGetPoolStatistics (
+  IN  EDKII_POOL_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                         Reset,
+  OUT EDKII_POOL_STATISTICS           *Statistics
+  );
+
+EDKII_POOL_STATISTICS_PROTOCOL  mPoolStatisticsProtocol = {
+  CoreGetPoolStatistics
+};
+
 
 /**
   Called to initialize the pool.
@@ -92,6 +202,7 @@ CoreInitializePool (
 {
   UINTN  Type;
   UINTN  Index;
+  UINTN  Class;
 
   for (Type=0; Type < EfiMaxMemoryType; Type++) {
     mPoolHead[Type].Signature  = 0;
@@ -100,7 +211,378 @@ CoreInitializePool (
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&mPoolHead[Type].FreeList[Index]);
     }
+    for (Class=0; Class < POOL_SLAB_CLASSES; Class++) {
+      InitializeListHead (&mPoolSlabCache[Type].Partial[Class]);
+    }
+    InitializeListHead (&mPoolSlabCache[Type].Empty);
+    mPoolSlabCache[Type].EmptyCount = 0;
+  }
+
+  mPoolSlabProperty = PcdGet8 (PcdPoolSlabPropertyMask);
+  mPoolStatistics.SlabEnabled  = (BOOLEAN) ((mPoolSlabProperty & POOL_SLAB_PROPERTY_ENABLE) != 0);
+  mPoolStatistics.GuardEnabled = (BOOLEAN) ((mPoolSlabProperty & POOL_SLAB_PROPERTY_GUARD) != 0);
+
+  //
+  // Size the slots of the size classes, and map the sizes to the smallest
+  // class that fits them
+  //
+  Class = 0;
+  for (Index = 0; Index <= POOL_SLAB_MAX_SIZE / POOL_SLAB_GRANULE; Index++) {
+    while (mPoolSlabClassSize[Class] < Index * POOL_SLAB_GRANULE) {
+      Class++;
+    }
+    mPoolSlabClassOfSize[Index] = (UINT8) Class;
+  }
+
+  for (Class = 0; Class < POOL_SLAB_CLASSES; Class++) {
+    mPoolSlabSlotSize[Class] = mPoolSlabClassSize[Class];
+    if (mPoolStatistics.GuardEnabled) {
+      mPoolSlabSlotSize[Class] += sizeof (POOL_SLAB_GUARD);
+    }
+    mPoolStatistics.Classes[Class].Size           = mPoolSlabClassSize[Class];
+    mPoolStatistics.Classes[Class].ObjectsPerSlab = (UINT32) ((DEFAULT_PAGE_ALLOCATION - SIZE_OF_POOL_SLAB) / mPoolSlabSlotSize[Class]);
+  }
+}
+
+
+/**
+  Installs the Pool Statistics Protocol.
+
+**/
+VOID
+CoreInstallPoolStatisticsProtocol (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  EFI_HANDLE  Handle;
+
+  Handle = NULL;
+  Status = CoreInstallMultipleProtocolInterfaces (
+             &Handle,
+             &gEdkiiPoolStatisticsProtocolGuid,
+             &mPoolStatisticsProtocol,
+             NULL
+             );
+  ASSERT_EFI_ERROR (Status);
+}
+
+
+/**
+  Returns the pool statistics, and optionally resets them.
+
+  @param  This                   The EDKII_POOL_STATISTICS_PROTOCOL instance
+  @param  Reset                  TRUE to reset the statistics after reading them
+  @param  Statistics             The statistics
+
+  @retval EFI_SUCCESS            The statistics were returned
+  @retval EFI_INVALID_PARAMETER  Statistics is NULL
+
+**/
+EFI_STATUS
+EFIAPI
+CoreGetPoolStatistics (
+  IN  EDKII_POOL_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                         Reset,
+  OUT EDKII_POOL_STATISTICS           *Statistics
+  )
+{
+  LIST_ENTRY  *Link;
+  POOL        *Pool;
+  UINTN       Type;
+  UINTN       Class;
+
+  if (Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CoreAcquireMemoryLock ();
+
+  mPoolStatistics.LiveBytes = 0;
+  for (Type = 0; Type < EfiMaxMemoryType; Type++) {
+    mPoolStatistics.LiveBytes += mPoolHead[Type].Used;
+  }
+  for (Link = mPoolHeadList.ForwardLink; Link != &mPoolHeadList; Link = Link->ForwardLink) {
+    Pool = CR (Link, POOL, Link, POOL_SIGNATURE);
+    mPoolStatistics.LiveBytes += Pool->Used;
+  }
+  CopyMem (Statistics, &mPoolStatistics, sizeof (*Statistics));
+
+  if (Reset) {
+    mPoolStatistics.SlabRequestedBytes = 0;
+    mPoolStatistics.SlabAllocatedBytes = 0;
+    mPoolStatistics.SlabPagesAllocated = 0;
+    mPoolStatistics.SlabPagesFreed     = 0;
+    for (Class = 0; Class < POOL_SLAB_CLASSES; Class++) {
+      mPoolStatistics.Classes[Class].Allocations = 0;
+      mPoolStatistics.Classes[Class].Frees       = 0;
+    }
   }
+
+  CoreReleaseMemoryLock ();
+
+  return EFI_SUCCESS;
+}
+
+
+/**
+  Internal function.  Returns the empty slabs of a memory type past
+  POOL_SLAB_EMPTY_KEEP to the page allocator, the least recently emptied
+  first.
+
+  @param  Cache                  The slab cache of the memory type
+
+**/
+VOID
+CoreTrimPoolSlabs (
+  IN POOL_SLAB_CACHE  *Cache
+  )
+{
+  POOL_SLAB   *Slab;
+
+  ASSERT_LOCKED (&gMemoryLock);
+
+  while (Cache->EmptyCount > POOL_SLAB_EMPTY_KEEP) {
+    Slab = CR (Cache->Empty.BackLink, POOL_SLAB, Link, POOL_SLAB_SIGNATURE);
+    RemoveEntryList (&Slab->Link);
+    Cache->EmptyCount -= 1;
+
+    //
+    // The page may come back as pool list pages or as pages of a driver
+    //
+    Slab->Signature = 0;
+    CoreFreePoolPages ((EFI_PHYSICAL_ADDRESS) (UINTN) Slab, EFI_SIZE_TO_PAGES (DEFAULT_PAGE_ALLOCATION));
+
+    mPoolStatistics.SlabEmptyPages -= 1;
+    mPoolStatistics.SlabPageBytes  -= DEFAULT_PAGE_ALLOCATION;
+    mPoolStatistics.SlabPagesFreed += 1;
+  }
+}
+
+
+/**
+  Internal function.  Allocates a pool object from the slabs.
+  Caller must have the memory lock held
+
+  @param  PoolType               Type of pool to allocate, below EfiMaxMemoryType
+  @param  Size                   The amount of pool to allocate, at most
+                                 POOL_SLAB_MAX_SIZE
+
+  @return The allocated object, or NULL
+
+**/
+VOID *
+CoreAllocatePoolSlab (
+  IN EFI_MEMORY_TYPE  PoolType,
+  IN UINTN            Size
+  )
+{
+  POOL_SLAB_CACHE *Cache;
+  POOL_SLAB       *Slab;
+  POOL_SLAB_FREE  *Free;
+  POOL_SLAB_GUARD *Guard;
+  UINTN           Class;
+  UINTN           ClassSize;
+  UINTN           Index;
+
+  ASSERT_LOCKED (&gMemoryLock);
+  ASSERT ((UINT32) PoolType < EfiMaxMemoryType);
+  ASSERT (Size <= POOL_SLAB_MAX_SIZE);
+
+  Class     = mPoolSlabClassOfSize[(Size + POOL_SLAB_GRANULE - 1) / POOL_SLAB_GRANULE];
+  ClassSize = mPoolSlabClassSize[Class];
+  Cache     = &mPoolSlabCache[PoolType];
+
+  if (IsListEmpty (&Cache->Partial[Class])) {
+    //
+    // Reuse an empty slab of the memory type, or get another page
+    //
+    if (!IsListEmpty (&Cache->Empty)) {
+      Slab = CR (Cache->Empty.ForwardLink, POOL_SLAB, Link, POOL_SLAB_SIGNATURE);
+      RemoveEntryList (&Slab->Link);
+      Cache->EmptyCount -= 1;
+      mPoolStatistics.SlabEmptyPages -= 1;
+    } else {
+      Slab = CoreAllocatePoolPages (PoolType, EFI_SIZE_TO_PAGES (DEFAULT_PAGE_ALLOCATION), DEFAULT_PAGE_ALLOCATION);
+      if (Slab == NULL) {
+        return NULL;
+      }
+      Slab->Signature = POOL_SLAB_SIGNATURE;
+      Slab->Type      = PoolType;
+      mPoolStatistics.SlabPageBytes      += DEFAULT_PAGE_ALLOCATION;
+      mPoolStatistics.SlabPagesAllocated += 1;
+    }
+
+    //
+    // The objects are carved from the slab as they are first needed
+    //
+    Slab->Class    = (UINT16) Class;
+    Slab->Used     = 0;
+    Slab->Carved   = 0;
+    Slab->Capacity = (UINT16) mPoolStatistics.Classes[Class].ObjectsPerSlab;
+    Slab->FreeList = NULL;
+    ZeroMem (Slab->Allocated, sizeof (Slab->Allocated));
+    InsertHeadList (&Cache->Partial[Class], &Slab->Link);
+    mPoolStatistics.Classes[Class].Slabs += 1;
+  }
+
+  Slab = CR (Cache->Partial[Class].ForwardLink, POOL_SLAB, Link, POOL_SLAB_SIGNATURE);
+  if (Slab->FreeList != NULL) {
+    Free = Slab->FreeList;
+    Slab->FreeList = Free->Next;
+  } else {
+    ASSERT (Slab->Carved < Slab->Capacity);
+    Free = (POOL_SLAB_FREE *) ((UINT8 *) Slab + SIZE_OF_POOL_SLAB + Slab->Carved * mPoolSlabSlotSize[Class]);
+    Slab->Carved += 1;
+  }
+  Index = ((UINTN) Free - (UINTN) Slab - SIZE_OF_POOL_SLAB) / mPoolSlabSlotSize[Class];
+  ASSERT (!POOL_SLAB_IS_ALLOCATED (Slab, Index));
+  Slab->Allocated[Index / 32] |= 1u << (Index % 32);
+  Slab->Used += 1;
+
+  //
+  // A full slab leaves the partial list until one of its objects is freed
+  //
+  if (Slab->Used == Slab->Capacity) {
+    RemoveEntryList (&Slab->Link);
+  }
+
+  DEBUG_CLEAR_MEMORY (Free, Size);
+  if (mPoolStatistics.GuardEnabled) {
+    SetMem ((UINT8 *) Free + Size, ClassSize - Size, POOL_SLAB_PAD);
+    Guard = (POOL_SLAB_GUARD *) ((UINT8 *) Free + ClassSize);
+    Guard->Signature = POOL_SLAB_GUARD_SIGNATURE;
+    Guard->Size      = (UINT32) Size;
+  }
+
+  mPoolHead[PoolType].Used += ClassSize;
+  mPoolStatistics.SlabLiveBytes      += ClassSize;
+  mPoolStatistics.SlabRequestedBytes += Size;
+  mPoolStatistics.SlabAllocatedBytes += ClassSize;
+  mPoolStatistics.Classes[Class].Allocations += 1;
+  mPoolStatistics.Classes[Class].LiveObjects += 1;
+
+  DEBUG ((
+    DEBUG_POOL,
+    "AllocatePoolI: Type %x, Addr %p (len %lx) slab %d\n", PoolType,
+    Free,
+    (UINT64) Size,
+    (UINT32) ClassSize
+    ));
+
+  return Free;
+}
+
+
+/**
+  Internal function.  Frees a pool object of a slab.
+  Caller must have the memory lock held
+
+  @param  Slab                   The slab of the object
+  @param  Buffer                 The object to free
+
+  @retval EFI_INVALID_PARAMETER  Buffer is not an allocated object of Slab,
+                                 or its guard was overwritten
+  @retval EFI_SUCCESS            Buffer successfully freed.
+
+**/
+EFI_STATUS
+CoreFreePoolSlab (
+  IN POOL_SLAB  *Slab,
+  IN VOID       *Buffer
+  )
+{
+  POOL_SLAB_CACHE *Cache;
+  POOL_SLAB_FREE  *Free;
+  POOL_SLAB_GUARD *Guard;
+  UINTN           Class;
+  UINTN           ClassSize;
+  UINTN           Offset;
+  UINTN           Object;
+  UINTN           Index;
+
+  ASSERT_LOCKED (&gMemoryLock);
+
+  Class = Slab->Class;
+  if (Class >= POOL_SLAB_CLASSES || (UINT32) Slab->Type >= EfiMaxMemoryType) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Buffer must be the start of a carved object
+  //
+  Offset = (UINTN) Buffer - (UINTN) Slab;
+  if (Offset < SIZE_OF_POOL_SLAB ||
+      ((Offset - SIZE_OF_POOL_SLAB) % mPoolSlabSlotSize[Class]) != 0 ||
+      ((Offset - SIZE_OF_POOL_SLAB) / mPoolSlabSlotSize[Class]) >= Slab->Carved) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Free      = (POOL_SLAB_FREE *) Buffer;
+  ClassSize = mPoolSlabClassSize[Class];
+  Object    = (Offset - SIZE_OF_POOL_SLAB) / mPoolSlabSlotSize[Class];
+
+  if (!POOL_SLAB_IS_ALLOCATED (Slab, Object)) {
+    DEBUG ((DEBUG_ERROR | DEBUG_POOL, "FreePool: %p is already free\n", Buffer));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (mPoolStatistics.GuardEnabled) {
+    Guard = (POOL_SLAB_GUARD *) ((UINT8 *) Free + ClassSize);
+    Index = ClassSize;
+    if (Guard->Signature == POOL_SLAB_GUARD_SIGNATURE && Guard->Size <= ClassSize) {
+      for (Index = Guard->Size; Index < ClassSize; Index++) {
+        if (((UINT8 *) Free)[Index] != POOL_SLAB_PAD) {
+          break;
+        }
+      }
+    }
+    if (Index != ClassSize || Guard->Signature != POOL_SLAB_GUARD_SIGNATURE) {
+      DEBUG ((DEBUG_ERROR | DEBUG_POOL, "FreePool: %p (len %x) was overrun\n", Buffer, Guard->Size));
+      ASSERT (FALSE);
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  DEBUG ((DEBUG_POOL, "FreePool: %p slab %d\n", Buffer, (UINT32) ClassSize));
+
+  //
+  // Put the object onto the free list of its slab, and the slab back onto
+  // the partial list of its class if it was full
+  //
+  DEBUG_CLEAR_MEMORY (Free, ClassSize);
+  Slab->Allocated[Object / 32] &= ~(1u << (Object % 32));
+  Free->Next      = Slab->FreeList;
+  Slab->FreeList  = Free;
+
+  Cache = &mPoolSlabCache[Slab->Type];
+  if (Slab->Used == Slab->Capacity) {
+    InsertHeadList (&Cache->Partial[Class], &Slab->Link);
+  }
+  Slab->Used -= 1;
+
+  mPoolHead[Slab->Type].Used -= ClassSize;
+  mPoolStatistics.SlabLiveBytes -= ClassSize;
+  mPoolStatistics.Classes[Class].Frees       += 1;
+  mPoolStatistics.Classes[Class].LiveObjects -= 1;
+
+  //
+  // Keep an empty slab for any class of the memory type, returning the
+  // empty slabs in excess in a batch
+  //
+  if (Slab->Used == 0) {
+    RemoveEntryList (&Slab->Link);
+    InsertHeadList (&Cache->Empty, &Slab->Link);
+    Cache->EmptyCount += 1;
+    mPoolStatistics.Classes[Class].Slabs -= 1;
+    mPoolStatistics.SlabEmptyPages += 1;
+
+    if (Cache->EmptyCount > POOL_SLAB_EMPTY_MAX) {
+      CoreTrimPoolSlabs (Cache);
+    }
+  }
+
+  return EFI_SUCCESS;
 }
 
 
@@ -277,6 +759,17 @@ CoreAllocatePoolI (
 
   ASSERT_LOCKED (&gMemoryLock);
 
+  //
+  // Serve the small allocations from the slabs when possible
+  //
+  if ((mPoolSlabProperty & POOL_SLAB_PROPERTY_ENABLE) != 0 &&
+      Size <= POOL_SLAB_MAX_SIZE && (UINT32) PoolType < EfiMaxMemoryType) {
+    Buffer = CoreAllocatePoolSlab (PoolType, Size);
+    if (Buffer != NULL) {
+      return Buffer;
+    }
+  }
+
   //
   // Adjust the size by the pool header & tail overhead
   //
@@ -467,8 +960,19 @@ CoreFreePoolI (
   UINTN       FSize;
   UINTN       Offset;
   BOOLEAN     AllFree;
+  POOL_SLAB   *Slab;
 
   ASSERT(Buffer != NULL);
+
+  //
+  // The pages of the slabs start with a slab header, the pages of the pool
+  // lists with a pool head or a free pool entry
+  //
+  Slab = (POOL_SLAB *) ((UINTN) Buffer & ~((UINTN) DEFAULT_PAGE_ALLOCATION - 1));
+  if (Slab->Signature == POOL_SLAB_SIGNATURE) {
+    return CoreFreePoolSlab (Slab, Buffer);
+  }
+
   //
   // Get the head & tail of the pool entry
   //
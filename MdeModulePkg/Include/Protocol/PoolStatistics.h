@@ -0,0 +1,144 @@
+/** @file
+  Pool Statistics Protocol is an EDK II-specific protocol produced by the DXE
+  Core. It returns the counters of the slab front-end that serves the small
+  pool allocations, and the bytes held by the pool, to profile how much memory
+  the pool allocations of the drivers waste.
+
+  The slab front-end serves the allocations of up to 512 bytes from pages
+  holding objects of a single size class. The fragmentation of these pages is
+  1 - SlabLiveBytes / SlabPageBytes, the rounding waste of the size classes is
+  1 - SlabRequestedBytes / SlabAllocatedBytes.
+
+  Copyright (c) Microsoft Corporation. All rights reserved.
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __POOL_STATISTICS_H__
+#define __POOL_STATISTICS_H__
+
+#define EDKII_POOL_STATISTICS_PROTOCOL_GUID \
+  { \
+    0x7d3e5a91, 0xc2b8, 0x4f16, { 0xa4, 0x0d, 0x5e, 0x81, 0x9c, 0x27, 0xb6, 0xf3 } \
+  }
+
+///
+/// Number of size classes of the slab front-end.
+///
+#define EDKII_POOL_SLAB_CLASSES   16
+
+typedef struct _EDKII_POOL_STATISTICS_PROTOCOL  EDKII_POOL_STATISTICS_PROTOCOL;
+
+typedef struct {
+  ///
+  /// Size in bytes of the objects of the class.
+  ///
+  UINT32    Size;
+  ///
+  /// Objects of the class held by a page.
+  ///
+  UINT32    ObjectsPerSlab;
+  ///
+  /// Allocations served by the class since the statistics were last reset.
+  ///
+  UINT64    Allocations;
+  ///
+  /// Objects of the class freed since the statistics were last reset.
+  ///
+  UINT64    Frees;
+  ///
+  /// Objects of the class currently allocated.
+  ///
+  UINT64    LiveObjects;
+  ///
+  /// Pages currently holding objects of the class.
+  ///
+  UINT64    Slabs;
+} EDKII_POOL_SLAB_CLASS_STATISTICS;
+
+typedef struct {
+  ///
+  /// TRUE if the slab front-end serves the small allocations.
+  ///
+  BOOLEAN                           SlabEnabled;
+  ///
+  /// TRUE if the slab objects carry guards checked when they are freed.
+  ///
+  BOOLEAN                           GuardEnabled;
+  ///
+  /// Bytes currently allocated from the pool, including the headers and the
+  /// tails of the allocations that are not slab objects.
+  ///
+  UINT64                            LiveBytes;
+  ///
+  /// Bytes of the slab objects currently allocated, counted at the size of
+  /// their class.
+  ///
+  UINT64                            SlabLiveBytes;
+  ///
+  /// Bytes of the pages currently held by the slab front-end, including the
+  /// empty pages kept for reuse.
+  ///
+  UINT64                            SlabPageBytes;
+  ///
+  /// Empty pages currently kept for reuse.
+  ///
+  UINT64                            SlabEmptyPages;
+  ///
+  /// Bytes requested from the slab front-end since the statistics were last
+  /// reset.
+  ///
+  UINT64                            SlabRequestedBytes;
+  ///
+  /// Bytes of the slab objects allocated since the statistics were last
+  /// reset, counted at the size of their class.
+  ///
+  UINT64                            SlabAllocatedBytes;
+  ///
+  /// Pages taken from and returned to the page allocator by the slab
+  /// front-end since the statistics were last reset.
+  ///
+  UINT64                            SlabPagesAllocated;
+  UINT64                            SlabPagesFreed;
+  ///
+  /// Counters of each size class, from the smallest to the largest.
+  ///
+  EDKII_POOL_SLAB_CLASS_STATISTICS  Classes[EDKII_POOL_SLAB_CLASSES];
+} EDKII_POOL_STATISTICS;
+
+/**
+  Returns the pool statistics, and optionally resets them. Only the counters
+  of events since the last reset are reset, the counters of what is currently
+  allocated are not.
+
+  @param[in]  This        The EDKII_POOL_STATISTICS_PROTOCOL instance.
+  @param[in]  Reset       TRUE to reset the statistics after reading them.
+  @param[out] Statistics  The statistics.
+
+  @retval EFI_SUCCESS           The statistics were returned.
+  @retval EFI_INVALID_PARAMETER Statistics is NULL.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_POOL_GET_STATISTICS) (
+  IN  EDKII_POOL_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                         Reset,
+  OUT EDKII_POOL_STATISTICS           *Statistics
+  );
+
+///
+/// Pool Statistics Protocol, produced by the DXE Core.
+///
+struct _EDKII_POOL_STATISTICS_PROTOCOL {
+  EDKII_POOL_GET_STATISTICS   GetStatistics;
+};
+
+extern EFI_GUID gEdkiiPoolStatisticsProtocolGuid;
+
+#endif
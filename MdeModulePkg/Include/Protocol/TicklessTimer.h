@@ -0,0 +1,137 @@
+/** @file
+  Tickless Timer Protocol is an EDK II-specific companion of the Timer
+  Architectural Protocol. A timer driver that can program its next interrupt
+  at an arbitrary time produces it next to EFI_TIMER_ARCH_PROTOCOL; the DXE
+  Core then reports the expiry of its earliest timer event, so that the
+  timer interrupt fires when an event is due instead of on every period.
+
+  Copyright (c) Microsoft Corporation. All rights reserved.
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __TICKLESS_TIMER_H__
+#define __TICKLESS_TIMER_H__
+
+#define EDKII_TICKLESS_TIMER_PROTOCOL_GUID \
+  { \
+    0x5c0e4f3b, 0x8a2d, 0x4e61, { 0x9b, 0x17, 0xd4, 0x63, 0x2a, 0xf0, 0x85, 0xc9 } \
+  }
+
+typedef struct _EDKII_TICKLESS_TIMER_PROTOCOL  EDKII_TICKLESS_TIMER_PROTOCOL;
+
+///
+/// Delay passed to SetDeadline() when no timer event is pending
+///
+#define TICKLESS_TIMER_NO_DEADLINE  MAX_UINT64
+
+typedef struct {
+  ///
+  /// TRUE while the timer interrupt follows the deadlines reported by the DXE
+  /// Core, FALSE while it fires every timer period.
+  ///
+  BOOLEAN   Tickless;
+  ///
+  /// Timer interrupts taken since the statistics were last reset.
+  ///
+  UINT64    Interrupts;
+  ///
+  /// Deadlines reported through SetDeadline() since the statistics were last reset.
+  ///
+  UINT64    Deadlines;
+  ///
+  /// Time since the statistics were last reset, in 100 ns units.
+  ///
+  UINT64    Elapsed;
+} EDKII_TICKLESS_TIMER_STATISTICS;
+
+/**
+  Reports the time left before the earliest pending timer event expires. The
+  DXE Core calls it whenever the head of its timer list may have changed.
+
+  @param[in] This   The EDKII_TICKLESS_TIMER_PROTOCOL instance.
+  @param[in] Delay  The time left in 100 ns units, 0 if an event already
+                    expired, or TICKLESS_TIMER_NO_DEADLINE.
+
+  @retval EFI_SUCCESS   The deadline was recorded.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_TICKLESS_TIMER_SET_DEADLINE) (
+  IN EDKII_TICKLESS_TIMER_PROTOCOL  *This,
+  IN UINT64                         Delay
+  );
+
+/**
+  Returns the time that elapsed since the last call to the notification
+  function registered with EFI_TIMER_ARCH_PROTOCOL.RegisterHandler(). That
+  time is part of the Duration passed to the next call.
+
+  @param[in]  This      The EDKII_TICKLESS_TIMER_PROTOCOL instance.
+  @param[out] Elapsed   The time in 100 ns units. Always 0 while the timer is
+                        not tickless, the next Duration then covers whole
+                        timer periods.
+
+  @retval EFI_SUCCESS   Elapsed was returned.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_TICKLESS_TIMER_GET_ELAPSED_TIME) (
+  IN  EDKII_TICKLESS_TIMER_PROTOCOL *This,
+  OUT UINT64                        *Elapsed
+  );
+
+/**
+  Switches between tickless and periodic operation. The timer becomes
+  tickless once the DXE Core has reported a deadline.
+
+  @param[in] This       The EDKII_TICKLESS_TIMER_PROTOCOL instance.
+  @param[in] Tickless   TRUE for tickless operation, FALSE for periodic.
+
+  @retval EFI_SUCCESS   The mode was changed.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_TICKLESS_TIMER_SET_MODE) (
+  IN EDKII_TICKLESS_TIMER_PROTOCOL  *This,
+  IN BOOLEAN                        Tickless
+  );
+
+/**
+  Returns the timer interrupt statistics, and optionally resets them.
+
+  @param[in]  This        The EDKII_TICKLESS_TIMER_PROTOCOL instance.
+  @param[in]  Reset       TRUE to reset the statistics after reading them.
+  @param[out] Statistics  The statistics.
+
+  @retval EFI_SUCCESS           The statistics were returned.
+  @retval EFI_INVALID_PARAMETER Statistics is NULL.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_TICKLESS_TIMER_GET_STATISTICS) (
+  IN  EDKII_TICKLESS_TIMER_PROTOCOL     *This,
+  IN  BOOLEAN                           Reset,
+  OUT EDKII_TICKLESS_TIMER_STATISTICS   *Statistics
+  );
+
+///
+/// Tickless Timer Protocol, produced by the timer driver and consumed by the
+/// DXE Core.
+///
+struct _EDKII_TICKLESS_TIMER_PROTOCOL {
+  EDKII_TICKLESS_TIMER_SET_DEADLINE       SetDeadline;
+  EDKII_TICKLESS_TIMER_GET_ELAPSED_TIME   GetElapsedTime;
+  EDKII_TICKLESS_TIMER_SET_MODE           SetMode;
+  EDKII_TICKLESS_TIMER_GET_STATISTICS     GetStatistics;
+};
+
+extern EFI_GUID gEdkiiTicklessTimerProtocolGuid;
+
+#endif
@@ -0,0 +1,95 @@
+/** @file
+  Timer Event Statistics Protocol is an EDK II-specific protocol produced by
+  the DXE Core. It returns the counters of the timer event queue, to profile
+  how the timer events of the drivers load the core.
+
+  Copyright (c) Microsoft Corporation. All rights reserved.
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __TIMER_EVENT_STATISTICS_H__
+#define __TIMER_EVENT_STATISTICS_H__
+
+#define EDKII_TIMER_EVENT_STATISTICS_PROTOCOL_GUID \
+  { \
+    0x2a7c91e4, 0x6f35, 0x4d0b, { 0x8e, 0x52, 0x1b, 0xc9, 0x07, 0x6d, 0xa3, 0x4f } \
+  }
+
+typedef struct _EDKII_TIMER_EVENT_STATISTICS_PROTOCOL  EDKII_TIMER_EVENT_STATISTICS_PROTOCOL;
+
+typedef struct {
+  ///
+  /// Timer events currently waiting for their trigger time.
+  ///
+  UINT64    Queued;
+  ///
+  /// Most timer events waiting at once since the statistics were last reset.
+  ///
+  UINT64    MaxQueued;
+  ///
+  /// Timer events existing, each of them can be queued once.
+  ///
+  UINT64    TimerEvents;
+  ///
+  /// Timers set through SetTimer() since the statistics were last reset.
+  ///
+  UINT64    Set;
+  ///
+  /// Queued timers cancelled or replaced by SetTimer() or CloseEvent().
+  ///
+  UINT64    Cancelled;
+  ///
+  /// Timer events signaled because their trigger time was reached.
+  ///
+  UINT64    Expired;
+  ///
+  /// Periodic timers that fell a whole period behind and restarted from the
+  /// current time.
+  ///
+  UINT64    Late;
+  ///
+  /// Times the queue was checked for expired timers.
+  ///
+  UINT64    Checks;
+  ///
+  /// Calls to the timer tick handler of the DXE Core.
+  ///
+  UINT64    Ticks;
+} EDKII_TIMER_EVENT_STATISTICS;
+
+/**
+  Returns the timer event statistics, and optionally resets them. Queued and
+  TimerEvents are never reset, MaxQueued restarts from Queued.
+
+  @param[in]  This        The EDKII_TIMER_EVENT_STATISTICS_PROTOCOL instance.
+  @param[in]  Reset       TRUE to reset the statistics after reading them.
+  @param[out] Statistics  The statistics.
+
+  @retval EFI_SUCCESS           The statistics were returned.
+  @retval EFI_INVALID_PARAMETER Statistics is NULL.
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_TIMER_EVENT_GET_STATISTICS) (
+  IN  EDKII_TIMER_EVENT_STATISTICS_PROTOCOL  *This,
+  IN  BOOLEAN                                Reset,
+  OUT EDKII_TIMER_EVENT_STATISTICS           *Statistics
+  );
+
+///
+/// Timer Event Statistics Protocol, produced by the DXE Core.
+///
+struct _EDKII_TIMER_EVENT_STATISTICS_PROTOCOL {
+  EDKII_TIMER_EVENT_GET_STATISTICS   GetStatistics;
+};
+
+extern EFI_GUID gEdkiiTimerEventStatisticsProtocolGuid;
+
+#endif
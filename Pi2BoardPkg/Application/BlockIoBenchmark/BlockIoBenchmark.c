@@ -0,0 +1,1206 @@
+/** @file
+*
+*  Shell application measuring the throughput and latency of a block device
+*  through BlockIo (queue depth 1) and BlockIo2 (deeper queues).
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/EfiShellParameters.h>
+#include <Protocol/MmcStats.h>
+
+#define BENCH_READ                  0
+#define BENCH_WRITE                 1
+
+#define BENCH_MAX_QUEUE_DEPTH       32
+#define BENCH_MAX_IO_SIZE           SIZE_64MB
+#define BENCH_MAX_QUEUE_DEPTHS      8
+
+#define BENCH_DEFAULT_MIN_SIZE      SIZE_4KB
+#define BENCH_DEFAULT_MAX_SIZE      SIZE_1MB
+#define BENCH_DEFAULT_IO_COUNT      256
+#define BENCH_DEFAULT_REGION_SIZE   SIZE_64MB
+#define BENCH_DEFAULT_SEED          1
+
+// Chunk used to save the test region before the write tests
+#define BENCH_BACKUP_CHUNK_SIZE     SIZE_1MB
+
+// Same log2 buckets as MMC_STATS_IO.Latency, so both histograms line up
+#define BENCH_LATENCY_BUCKETS       MMC_STATS_LATENCY_BUCKETS
+
+typedef struct {
+    BOOLEAN     List;
+    BOOLEAN     Write;
+    BOOLEAN     Sequential;
+    BOOLEAN     Random;
+    BOOLEAN     KeepCache;
+    BOOLEAN     Histogram;
+    BOOLEAN     Csv;
+    BOOLEAN     DeviceSet;
+    UINTN       DeviceIndex;
+    UINTN       MinSize;
+    UINTN       MaxSize;
+    UINTN       QueueDepths[BENCH_MAX_QUEUE_DEPTHS];
+    UINTN       QueueDepthCount;
+    UINTN       IoCount;
+    EFI_LBA     RegionStart;
+    UINT64      RegionSize;
+    UINT32      Seed;
+} BENCH_OPTIONS;
+
+typedef struct {
+    EFI_HANDLE              Handle;
+    EFI_BLOCK_IO_PROTOCOL   *BlockIo;
+    EFI_BLOCK_IO2_PROTOCOL  *BlockIo2;      // NULL when the device does not publish it
+    MMC_STATS_PROTOCOL      *MmcStats;      // NULL unless the device belongs to MmcDxe
+    EFI_BLOCK_IO_MEDIA      *Media;
+    EFI_LBA                 RegionStart;
+    UINT64                  RegionBlocks;
+    UINT8                   *Backup;        // Content of the region, written back by the write tests
+    UINTN                   BackupPages;
+} BENCH_DEVICE;
+
+//
+// One outstanding request. The completion is timestamped from the token event
+// notification, which runs at TPL_NOTIFY as soon as the driver signals it
+//
+typedef struct {
+    EFI_BLOCK_IO2_TOKEN     Token;
+    UINT8                   *Buffer;
+    UINT64                  StartTime;
+    volatile UINT64         EndTime;
+    volatile BOOLEAN        Done;
+    BOOLEAN                 Busy;
+} BENCH_SLOT;
+
+typedef struct {
+    UINTN       Transfer;
+    BOOLEAN     Random;
+    UINTN       IoSize;
+    UINTN       QueueDepth;
+} BENCH_TEST;
+
+typedef struct {
+    UINTN       Ios;
+    UINT64      ElapsedUs;
+    UINT64      AvgUs;
+    UINT64      P50Us;
+    UINT64      P99Us;
+    UINT64      MaxUs;
+    UINT64      Histogram[BENCH_LATENCY_BUCKETS];
+    BOOLEAN     HasDriverStats;
+    UINT64      DriverAvgUs;
+} BENCH_RESULT;
+
+STATIC UINT64 mTicksPerSecond;
+STATIC UINT32 mRandomState;
+
+STATIC BENCH_SLOT mSlots[BENCH_MAX_QUEUE_DEPTH];
+STATIC UINTN mSlotBufferPages;
+STATIC UINT64 *mLatencies;
+
+STATIC
+VOID
+BenchPrintUsage(
+    VOID
+    )
+{
+    Print(L"Usage: BlockIoBenchmark [options]\n");
+    Print(L"  -l                List the block devices and exit\n");
+    Print(L"  -d <index>        Device to test, as listed by -l (default: first MMC device)\n");
+    Print(L"  -b <min>[:<max>]  I/O sizes, doubled from min to max (default 4K:1M)\n");
+    Print(L"  -q <qd>[,<qd>..]  Queue depths (default 1,4), depths above 1 need BlockIo2\n");
+    Print(L"  -p seq|rand|all   Access pattern (default all)\n");
+    Print(L"  -n <count>        I/Os per test (default %d)\n", BENCH_DEFAULT_IO_COUNT);
+    Print(L"  -a <lba>          First block of the test region (default 0)\n");
+    Print(L"  -z <size>         Size of the test region (default 64M)\n");
+    Print(L"  -s <seed>         Seed of the random offsets (default %d)\n", BENCH_DEFAULT_SEED);
+    Print(L"  -w                Also run write tests, see below\n");
+    Print(L"  -cache            Leave the MmcDxe sector cache on\n");
+    Print(L"  -hist             Print the latency histograms\n");
+    Print(L"  -csv              Print the results as CSV\n");
+    Print(L"Sizes take a K, M or G suffix, numbers a 0x prefix for hexadecimal.\n");
+    Print(L"The write tests save the test region in memory first and only ever write\n");
+    Print(L"it back to where it came from. The region must not be used by anything\n");
+    Print(L"else, such as a mounted file system, while the benchmark runs.\n");
+}
+
+//
+// xorshift32, the same seed always produces the same offsets
+//
+STATIC
+UINT32
+BenchRandom(
+    VOID
+    )
+{
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    return mRandomState;
+}
+
+STATIC
+UINT64
+BenchTicksToUs(
+    IN UINT64   Ticks
+    )
+{
+    return DivU64x64Remainder(MultU64x32(Ticks, 1000000), mTicksPerSecond, NULL);
+}
+
+//
+// Bucket 0 is below 1us, bucket n > 0 is [2^(n-1), 2^n) us
+//
+STATIC
+UINTN
+BenchLatencyBucket(
+    IN UINT64   TimeUs
+    )
+{
+    UINTN Bucket;
+
+    if (TimeUs == 0) {
+        return 0;
+    }
+
+    Bucket = (UINTN)HighBitSet64(TimeUs) + 1;
+    return MIN(Bucket, BENCH_LATENCY_BUCKETS - 1);
+}
+
+STATIC
+VOID
+BenchSortLatencies(
+    IN OUT UINT64   *Table,
+    IN UINTN        NumEntries
+    )
+{
+    // Shell sort, tens of thousands of samples are too many for an insertion sort
+    UINTN Gap;
+    UINTN Idx;
+    UINTN J;
+    UINT64 CurrEntry;
+
+    for (Gap = NumEntries / 2; Gap > 0; Gap /= 2) {
+        for (Idx = Gap; Idx < NumEntries; ++Idx) {
+            CurrEntry = Table[Idx];
+            for (J = Idx; (J >= Gap) && (Table[J - Gap] > CurrEntry); J -= Gap) {
+                Table[J] = Table[J - Gap];
+            }
+            Table[J] = CurrEntry;
+        }
+    }
+}
+
+/**
+  Parses a decimal or 0x prefixed hexadecimal number with an optional K, M or G suffix
+**/
+STATIC
+EFI_STATUS
+BenchParseNumber(
+    IN  CONST CHAR16    *String,
+    OUT UINT64          *Value
+    )
+{
+    CONST CHAR16 *Suffix;
+    UINTN Shift;
+
+    if ((String == NULL) || (*String == L'\0')) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if ((String[0] == L'0') && ((String[1] == L'x') || (String[1] == L'X'))) {
+        if (String[2] == L'\0') {
+            return EFI_INVALID_PARAMETER;
+        }
+        *Value = StrHexToUint64(String);
+        Suffix = String + 2;
+        while (((*Suffix >= L'0') && (*Suffix <= L'9')) ||
+               ((*Suffix >= L'a') && (*Suffix <= L'f')) ||
+               ((*Suffix >= L'A') && (*Suffix <= L'F'))) {
+            ++Suffix;
+        }
+    } else {
+        if ((*String < L'0') || (*String > L'9')) {
+            return EFI_INVALID_PARAMETER;
+        }
+        *Value = StrDecimalToUint64(String);
+        Suffix = String;
+        while ((*Suffix >= L'0') && (*Suffix <= L'9')) {
+            ++Suffix;
+        }
+    }
+
+    switch (*Suffix) {
+    case L'\0':
+        return EFI_SUCCESS;
+    case L'k':
+    case L'K':
+        Shift = 10;
+        break;
+    case L'm':
+    case L'M':
+        Shift = 20;
+        break;
+    case L'g':
+    case L'G':
+        Shift = 30;
+        break;
+    default:
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (Suffix[1] != L'\0') {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    *Value = LShiftU64(*Value, Shift);
+    return EFI_SUCCESS;
+}
+
+/**
+  Parses "<min>[:<max>]" into the I/O size range
+**/
+STATIC
+EFI_STATUS
+BenchParseSizes(
+    IN  CONST CHAR16    *String,
+    OUT BENCH_OPTIONS   *Options
+    )
+{
+    CHAR16 Min[32];
+    UINTN Length;
+    UINT64 Value;
+    EFI_STATUS Status;
+
+    for (Length = 0; (String[Length] != L'\0') && (String[Length] != L':'); ++Length);
+    if ((Length == 0) || (Length >= sizeof(Min) / sizeof(Min[0]))) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    CopyMem(Min, String, Length * sizeof(CHAR16));
+    Min[Length] = L'\0';
+
+    Status = BenchParseNumber(Min, &Value);
+    if (EFI_ERROR(Status) || (Value == 0) || (Value > BENCH_MAX_IO_SIZE)) {
+        return EFI_INVALID_PARAMETER;
+    }
+    Options->MinSize = (UINTN)Value;
+    Options->MaxSize = (UINTN)Value;
+
+    if (String[Length] == L':') {
+        Status = BenchParseNumber(String + Length + 1, &Value);
+        if (EFI_ERROR(Status) || (Value < Options->MinSize) || (Value > BENCH_MAX_IO_SIZE)) {
+            return EFI_INVALID_PARAMETER;
+        }
+        Options->MaxSize = (UINTN)Value;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Parses the comma separated list of queue depths
+**/
+STATIC
+EFI_STATUS
+BenchParseQueueDepths(
+    IN  CONST CHAR16    *String,
+    OUT BENCH_OPTIONS   *Options
+    )
+{
+    CHAR16 Depth[16];
+    UINTN Length;
+    UINT64 Value;
+    EFI_STATUS Status;
+
+    Options->QueueDepthCount = 0;
+
+    while (*String != L'\0') {
+        for (Length = 0; (String[Length] != L'\0') && (String[Length] != L','); ++Length);
+        if ((Length == 0) || (Length >= sizeof(Depth) / sizeof(Depth[0])) ||
+            (Options->QueueDepthCount == BENCH_MAX_QUEUE_DEPTHS)) {
+            return EFI_INVALID_PARAMETER;
+        }
+
+        CopyMem(Depth, String, Length * sizeof(CHAR16));
+        Depth[Length] = L'\0';
+
+        Status = BenchParseNumber(Depth, &Value);
+        if (EFI_ERROR(Status) || (Value == 0) || (Value > BENCH_MAX_QUEUE_DEPTH)) {
+            return EFI_INVALID_PARAMETER;
+        }
+        Options->QueueDepths[Options->QueueDepthCount++] = (UINTN)Value;
+
+        String += Length;
+        if (*String == L',') {
+            ++String;
+        }
+    }
+
+    return (Options->QueueDepthCount != 0) ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+}
+
+STATIC
+EFI_STATUS
+BenchParseOptions(
+    IN  UINTN           Argc,
+    IN  CHAR16          **Argv,
+    OUT BENCH_OPTIONS   *Options
+    )
+{
+    EFI_STATUS Status;
+    UINT64 Value;
+    UINTN Idx;
+    CHAR16 *Option;
+    CHAR16 *Argument;
+
+    ZeroMem(Options, sizeof(BENCH_OPTIONS));
+    Options->Sequential = TRUE;
+    Options->Random = TRUE;
+    Options->MinSize = BENCH_DEFAULT_MIN_SIZE;
+    Options->MaxSize = BENCH_DEFAULT_MAX_SIZE;
+    Options->QueueDepths[0] = 1;
+    Options->QueueDepths[1] = 4;
+    Options->QueueDepthCount = 2;
+    Options->IoCount = BENCH_DEFAULT_IO_COUNT;
+    Options->RegionSize = BENCH_DEFAULT_REGION_SIZE;
+    Options->Seed = BENCH_DEFAULT_SEED;
+
+    for (Idx = 1; Idx < Argc; ++Idx) {
+        Option = Argv[Idx];
+
+        // Flags
+        if (StrCmp(Option, L"-l") == 0) {
+            Options->List = TRUE;
+            continue;
+        } else if (StrCmp(Option, L"-w") == 0) {
+            Options->Write = TRUE;
+            continue;
+        } else if (StrCmp(Option, L"-cache") == 0) {
+            Options->KeepCache = TRUE;
+            continue;
+        } else if (StrCmp(Option, L"-hist") == 0) {
+            Options->Histogram = TRUE;
+            continue;
+        } else if (StrCmp(Option, L"-csv") == 0) {
+            Options->Csv = TRUE;
+            continue;
+        } else if ((StrCmp(Option, L"-h") == 0) || (StrCmp(Option, L"-?") == 0)) {
+            return EFI_ABORTED;
+        }
+
+        // Options with an argument
+        if (Idx + 1 >= Argc) {
+            Print(L"BlockIoBenchmark: Missing or unknown option %s\n", Option);
+            return EFI_INVALID_PARAMETER;
+        }
+        Argument = Argv[++Idx];
+
+        if (StrCmp(Option, L"-b") == 0) {
+            Status = BenchParseSizes(Argument, Options);
+        } else if (StrCmp(Option, L"-q") == 0) {
+            Status = BenchParseQueueDepths(Argument, Options);
+        } else if (StrCmp(Option, L"-p") == 0) {
+            Status = EFI_SUCCESS;
+            Options->Sequential = (StrCmp(Argument, L"rand") != 0);
+            Options->Random = (StrCmp(Argument, L"seq") != 0);
+            if ((StrCmp(Argument, L"seq") != 0) &&
+                (StrCmp(Argument, L"rand") != 0) &&
+                (StrCmp(Argument, L"all") != 0)) {
+                Status = EFI_INVALID_PARAMETER;
+            }
+        } else {
+            Status = BenchParseNumber(Argument, &Value);
+            if (!EFI_ERROR(Status)) {
+                if (StrCmp(Option, L"-d") == 0) {
+                    Options->DeviceIndex = (UINTN)Value;
+                    Options->DeviceSet = TRUE;
+                } else if ((StrCmp(Option, L"-n") == 0) && (Value != 0) && (Value <= MAX_UINT32)) {
+                    Options->IoCount = (UINTN)Value;
+                } else if (StrCmp(Option, L"-a") == 0) {
+                    Options->RegionStart = Value;
+                } else if ((StrCmp(Option, L"-z") == 0) && (Value != 0)) {
+                    Options->RegionSize = Value;
+                } else if ((StrCmp(Option, L"-s") == 0) && (Value != 0) && (Value <= MAX_UINT32)) {
+                    Options->Seed = (UINT32)Value;
+                } else {
+                    Status = EFI_INVALID_PARAMETER;
+                }
+            }
+        }
+
+        if (EFI_ERROR(Status)) {
+            Print(L"BlockIoBenchmark: Invalid option %s %s\n", Option, Argument);
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+BenchListDevices(
+    IN EFI_HANDLE   *Handles,
+    IN UINTN        HandleCount
+    )
+{
+    EFI_BLOCK_IO_PROTOCOL *BlockIo;
+    EFI_DEVICE_PATH_PROTOCOL *DevicePath;
+    CHAR16 *DevicePathText;
+    VOID *Interface;
+    UINTN Idx;
+
+    Print(L"Idx  BlockSize  Blocks        Flags  Device path\n");
+
+    for (Idx = 0; Idx < HandleCount; ++Idx) {
+        if (EFI_ERROR(gBS->HandleProtocol(Handles[Idx], &gEfiBlockIoProtocolGuid, (VOID**)&BlockIo))) {
+            continue;
+        }
+
+        DevicePathText = NULL;
+        if (!EFI_ERROR(gBS->HandleProtocol(Handles[Idx], &gEfiDevicePathProtocolGuid, (VOID**)&DevicePath))) {
+            DevicePathText = ConvertDevicePathToText(DevicePath, TRUE, TRUE);
+        }
+
+        // P: partition, 2: BlockIo2, M: MmcDxe statistics, R: read-only, -: no media
+        Print(
+            L"%3d  %9d  %12ld  %c%c%c%c%c  %s\n",
+            (UINT32)Idx,
+            BlockIo->Media->BlockSize,
+            BlockIo->Media->MediaPresent ? BlockIo->Media->LastBlock + 1 : 0,
+            BlockIo->Media->LogicalPartition ? L'P' : L' ',
+            EFI_ERROR(gBS->HandleProtocol(Handles[Idx], &gEfiBlockIo2ProtocolGuid, &Interface)) ? L' ' : L'2',
+            EFI_ERROR(gBS->HandleProtocol(Handles[Idx], &gMmcStatsProtocolGuid, &Interface)) ? L' ' : L'M',
+            BlockIo->Media->ReadOnly ? L'R' : L' ',
+            BlockIo->Media->MediaPresent ? L' ' : L'-',
+            (DevicePathText != NULL) ? DevicePathText : L"?");
+
+        if (DevicePathText != NULL) {
+            FreePool(DevicePathText);
+        }
+    }
+}
+
+/**
+  Picks the device to test, by default the first device with MmcDxe statistics
+**/
+STATIC
+EFI_STATUS
+BenchOpenDevice(
+    IN  EFI_HANDLE      *Handles,
+    IN  UINTN           HandleCount,
+    IN  BENCH_OPTIONS   *Options,
+    OUT BENCH_DEVICE    *Device
+    )
+{
+    EFI_STATUS Status;
+    VOID *Interface;
+    UINTN Idx;
+
+    ZeroMem(Device, sizeof(BENCH_DEVICE));
+
+    if (Options->DeviceSet) {
+        if (Options->DeviceIndex >= HandleCount) {
+            Print(L"BlockIoBenchmark: No device %d, see -l\n", (UINT32)Options->DeviceIndex);
+            return EFI_NOT_FOUND;
+        }
+        Device->Handle = Handles[Options->DeviceIndex];
+    } else {
+        for (Idx = 0; Idx < HandleCount; ++Idx) {
+            Status = gBS->HandleProtocol(Handles[Idx], &gMmcStatsProtocolGuid, &Interface);
+            if (!EFI_ERROR(Status)) {
+                Device->Handle = Handles[Idx];
+                break;
+            }
+        }
+        if (Device->Handle == NULL) {
+            Print(L"BlockIoBenchmark: No MMC device, pick one with -d\n");
+            return EFI_NOT_FOUND;
+        }
+    }
+
+    Status = gBS->HandleProtocol(Device->Handle, &gEfiBlockIoProtocolGuid, (VOID**)&Device->BlockIo);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+    if (EFI_ERROR(gBS->HandleProtocol(Device->Handle, &gEfiBlockIo2ProtocolGuid, (VOID**)&Device->BlockIo2))) {
+        Device->BlockIo2 = NULL;
+    }
+    if (EFI_ERROR(gBS->HandleProtocol(Device->Handle, &gMmcStatsProtocolGuid, (VOID**)&Device->MmcStats))) {
+        Device->MmcStats = NULL;
+    }
+    Device->Media = Device->BlockIo->Media;
+
+    if (!Device->Media->MediaPresent || (Device->Media->BlockSize == 0)) {
+        Print(L"BlockIoBenchmark: No media in the device\n");
+        return EFI_NO_MEDIA;
+    }
+
+    if (Options->RegionStart > Device->Media->LastBlock) {
+        Print(L"BlockIoBenchmark: Region starts past the last block 0x%lx\n", Device->Media->LastBlock);
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Device->RegionStart = Options->RegionStart;
+    Device->RegionBlocks = MIN(
+        DivU64x32(Options->RegionSize, Device->Media->BlockSize),
+        Device->Media->LastBlock + 1 - Device->RegionStart);
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Saves the test region, the write tests write this content back in place
+**/
+STATIC
+EFI_STATUS
+BenchBackupRegion(
+    IN OUT BENCH_DEVICE *Device
+    )
+{
+    EFI_STATUS Status;
+    UINT64 RegionSize;
+    UINT64 Offset;
+    UINTN ChunkSize;
+
+    RegionSize = MultU64x32(Device->RegionBlocks, Device->Media->BlockSize);
+    if (RegionSize > MAX_UINTN - EFI_PAGE_SIZE) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Device->BackupPages = EFI_SIZE_TO_PAGES((UINTN)RegionSize);
+    Device->Backup = AllocateAlignedPages(Device->BackupPages, MAX(Device->Media->IoAlign, EFI_PAGE_SIZE));
+    if (Device->Backup == NULL) {
+        Print(L"BlockIoBenchmark: Not enough memory to save the %ldMB region, shrink it with -z\n",
+            RShiftU64(RegionSize, 20));
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (Offset = 0; Offset < RegionSize; Offset += ChunkSize) {
+        ChunkSize = (UINTN)MIN(RegionSize - Offset, BENCH_BACKUP_CHUNK_SIZE);
+        Status = Device->BlockIo->ReadBlocks(
+            Device->BlockIo,
+            Device->Media->MediaId,
+            Device->RegionStart + DivU64x32(Offset, Device->Media->BlockSize),
+            ChunkSize,
+            Device->Backup + Offset);
+        if (EFI_ERROR(Status)) {
+            Print(L"BlockIoBenchmark: Failed to save the region, %r\n", Status);
+            return Status;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Allocates one buffer of MaxSize bytes and one token event per slot of the deepest queue
+**/
+STATIC
+EFI_STATUS
+BenchAllocateSlots(
+    IN BENCH_DEVICE     *Device,
+    IN BENCH_OPTIONS    *Options,
+    IN EFI_EVENT_NOTIFY NotifyFunction
+    )
+{
+    EFI_STATUS Status;
+    UINTN SlotCount;
+    UINTN Idx;
+
+    SlotCount = 1;
+    for (Idx = 0; Idx < Options->QueueDepthCount; ++Idx) {
+        SlotCount = MAX(SlotCount, Options->QueueDepths[Idx]);
+    }
+
+    mSlotBufferPages = EFI_SIZE_TO_PAGES(Options->MaxSize);
+
+    for (Idx = 0; Idx < SlotCount; ++Idx) {
+        mSlots[Idx].Buffer = AllocateAlignedPages(mSlotBufferPages, MAX(Device->Media->IoAlign, EFI_PAGE_SIZE));
+        if (mSlots[Idx].Buffer == NULL) {
+            return EFI_OUT_OF_RESOURCES;
+        }
+
+        Status = gBS->CreateEvent(
+            EVT_NOTIFY_SIGNAL,
+            TPL_NOTIFY,
+            NotifyFunction,
+            &mSlots[Idx],
+            &mSlots[Idx].Token.Event);
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+BenchFreeSlots(
+    VOID
+    )
+{
+    UINTN Idx;
+
+    for (Idx = 0; Idx < BENCH_MAX_QUEUE_DEPTH; ++Idx) {
+        if (mSlots[Idx].Token.Event != NULL) {
+            gBS->CloseEvent(mSlots[Idx].Token.Event);
+        }
+        if (mSlots[Idx].Buffer != NULL) {
+            FreeAlignedPages(mSlots[Idx].Buffer, mSlotBufferPages);
+        }
+    }
+    ZeroMem(mSlots, sizeof(mSlots));
+}
+
+VOID
+EFIAPI
+BenchIoComplete(
+    IN  EFI_EVENT   Event,
+    IN  VOID        *Context
+    )
+{
+    BENCH_SLOT *Slot = (BENCH_SLOT*)Context;
+
+    Slot->EndTime = GetPerformanceCounter();
+    Slot->Done = TRUE;
+}
+
+/**
+  Returns the LBA of the Index-th I/O of the test, I/Os are aligned on their size
+**/
+STATIC
+EFI_LBA
+BenchNextLba(
+    IN BENCH_DEVICE     *Device,
+    IN BENCH_TEST       *Test,
+    IN UINTN            Index
+    )
+{
+    UINTN BlocksPerIo;
+    UINT64 IoSlots;
+    UINT64 IoSlot;
+
+    BlocksPerIo = Test->IoSize / Device->Media->BlockSize;
+    IoSlots = DivU64x32(Device->RegionBlocks, (UINT32)BlocksPerIo);
+
+    if (Test->Random) {
+        IoSlot = ((UINT64)BenchRandom() << 32) | BenchRandom();
+    } else {
+        IoSlot = Index;
+    }
+    DivU64x64Remainder(IoSlot, IoSlots, &IoSlot);
+
+    return Device->RegionStart + MultU64x32(IoSlot, (UINT32)BlocksPerIo);
+}
+
+STATIC
+VOID *
+BenchWriteBuffer(
+    IN BENCH_DEVICE     *Device,
+    IN EFI_LBA          Lba
+    )
+{
+    return Device->Backup + MultU64x32(Lba - Device->RegionStart, Device->Media->BlockSize);
+}
+
+/**
+  Runs a queue depth 1 test through BlockIo
+**/
+STATIC
+EFI_STATUS
+BenchRunBlockIo(
+    IN  BENCH_DEVICE    *Device,
+    IN  BENCH_TEST      *Test,
+    IN  UINTN           IoCount,
+    OUT UINT64          *ElapsedTicks
+    )
+{
+    EFI_STATUS Status;
+    EFI_BLOCK_IO_PROTOCOL *BlockIo;
+    EFI_LBA Lba;
+    UINT64 TestStart;
+    UINT64 StartTime;
+    UINTN Idx;
+
+    BlockIo = Device->BlockIo;
+    TestStart = GetPerformanceCounter();
+
+    for (Idx = 0; Idx < IoCount; ++Idx) {
+        Lba = BenchNextLba(Device, Test, Idx);
+
+        StartTime = GetPerformanceCounter();
+        if (Test->Transfer == BENCH_WRITE) {
+            Status = BlockIo->WriteBlocks(
+                BlockIo,
+                Device->Media->MediaId,
+                Lba,
+                Test->IoSize,
+                BenchWriteBuffer(Device, Lba));
+        } else {
+            Status = BlockIo->ReadBlocks(
+                BlockIo,
+                Device->Media->MediaId,
+                Lba,
+                Test->IoSize,
+                mSlots[0].Buffer);
+        }
+        mLatencies[Idx] = GetPerformanceCounter() - StartTime;
+
+        if (EFI_ERROR(Status)) {
+            Print(L"BlockIoBenchmark: I/O at LBA 0x%lx failed, %r\n", Lba, Status);
+            return Status;
+        }
+    }
+
+    *ElapsedTicks = GetPerformanceCounter() - TestStart;
+    return EFI_SUCCESS;
+}
+
+/**
+  Runs a test through BlockIo2 keeping QueueDepth requests in flight
+**/
+STATIC
+EFI_STATUS
+BenchRunBlockIo2(
+    IN  BENCH_DEVICE    *Device,
+    IN  BENCH_TEST      *Test,
+    IN  UINTN           IoCount,
+    OUT UINT64          *ElapsedTicks
+    )
+{
+    EFI_STATUS Status;
+    EFI_BLOCK_IO2_PROTOCOL *BlockIo2;
+    BENCH_SLOT *Slot;
+    EFI_LBA Lba;
+    UINT64 TestStart;
+    UINTN Issued;
+    UINTN Completed;
+    UINTN Idx;
+
+    BlockIo2 = Device->BlockIo2;
+    Status = EFI_SUCCESS;
+    Issued = 0;
+    Completed = 0;
+    TestStart = GetPerformanceCounter();
+
+    while (Completed < IoCount) {
+        for (Idx = 0; Idx < Test->QueueDepth; ++Idx) {
+            Slot = &mSlots[Idx];
+
+            if (Slot->Busy && Slot->Done) {
+                Slot->Busy = FALSE;
+                if (EFI_ERROR(Slot->Token.TransactionStatus)) {
+                    Status = Slot->Token.TransactionStatus;
+                    Print(L"BlockIoBenchmark: Queued I/O failed, %r\n", Status);
+                    goto DRAIN;
+                }
+                mLatencies[Completed++] = Slot->EndTime - Slot->StartTime;
+            }
+
+            if (!Slot->Busy && (Issued < IoCount)) {
+                Lba = BenchNextLba(Device, Test, Issued);
+
+                Slot->Busy = TRUE;
+                Slot->Done = FALSE;
+                Slot->StartTime = GetPerformanceCounter();
+                if (Test->Transfer == BENCH_WRITE) {
+                    Status = BlockIo2->WriteBlocksEx(
+                        BlockIo2,
+                        Device->Media->MediaId,
+                        Lba,
+                        &Slot->Token,
+                        Test->IoSize,
+                        BenchWriteBuffer(Device, Lba));
+                } else {
+                    Status = BlockIo2->ReadBlocksEx(
+                        BlockIo2,
+                        Device->Media->MediaId,
+                        Lba,
+                        &Slot->Token,
+                        Test->IoSize,
+                        Slot->Buffer);
+                }
+                if (EFI_ERROR(Status)) {
+                    Slot->Busy = FALSE;
+                    Print(L"BlockIoBenchmark: Queuing I/O at LBA 0x%lx failed, %r\n", Lba, Status);
+                    goto DRAIN;
+                }
+                ++Issued;
+            }
+        }
+        CpuPause();
+    }
+
+    *ElapsedTicks = GetPerformanceCounter() - TestStart;
+    return EFI_SUCCESS;
+
+DRAIN:
+    // The buffers must not be reused while the driver still owns them
+    for (Idx = 0; Idx < Test->QueueDepth; ++Idx) {
+        while (mSlots[Idx].Busy && !mSlots[Idx].Done) {
+            CpuPause();
+        }
+        mSlots[Idx].Busy = FALSE;
+    }
+    return Status;
+}
+
+STATIC
+VOID
+BenchComputeResult(
+    IN  UINTN           IoCount,
+    IN  UINT64          ElapsedTicks,
+    OUT BENCH_RESULT    *Result
+    )
+{
+    UINT64 TotalUs;
+    UINTN Idx;
+
+    ZeroMem(Result, sizeof(BENCH_RESULT));
+    Result->Ios = IoCount;
+    Result->ElapsedUs = MAX(BenchTicksToUs(ElapsedTicks), 1);
+
+    TotalUs = 0;
+    for (Idx = 0; Idx < IoCount; ++Idx) {
+        mLatencies[Idx] = BenchTicksToUs(mLatencies[Idx]);
+        TotalUs += mLatencies[Idx];
+        ++Result->Histogram[BenchLatencyBucket(mLatencies[Idx])];
+    }
+
+    BenchSortLatencies(mLatencies, IoCount);
+
+    Result->AvgUs = DivU64x64Remainder(TotalUs, IoCount, NULL);
+    Result->P50Us = mLatencies[((IoCount - 1) * 50) / 100];
+    Result->P99Us = mLatencies[((IoCount - 1) * 99) / 100];
+    Result->MaxUs = mLatencies[IoCount - 1];
+}
+
+STATIC
+VOID
+BenchPrintResult(
+    IN BENCH_OPTIONS    *Options,
+    IN BENCH_TEST       *Test,
+    IN BENCH_RESULT     *Result
+    )
+{
+    UINT64 Bytes;
+    UINT64 KBps;
+    UINT64 Iops;
+    UINTN Bucket;
+    UINTN First;
+    UINTN Last;
+
+    Bytes = MultU64x32(Result->Ios, (UINT32)Test->IoSize);
+    // 1MB/s is one byte per microsecond, keep two decimals
+    KBps = DivU64x64Remainder(MultU64x32(Bytes, 1000), Result->ElapsedUs, NULL);
+    Iops = DivU64x64Remainder(MultU64x32(Result->Ios, 1000000), Result->ElapsedUs, NULL);
+
+    if (Options->Csv) {
+        Print(
+            L"%s,%s,%d,%d,%d,%ld.%02ld,%ld,%ld,%ld,%ld,%ld,",
+            (Test->Transfer == BENCH_WRITE) ? L"write" : L"read",
+            Test->Random ? L"rand" : L"seq",
+            (UINT32)Test->IoSize,
+            (UINT32)Test->QueueDepth,
+            (UINT32)Result->Ios,
+            DivU64x32(KBps, 1000),
+            DivU64x32(ModU64x32(KBps, 1000), 10),
+            Iops,
+            Result->AvgUs,
+            Result->P50Us,
+            Result->P99Us,
+            Result->MaxUs);
+        if (Result->HasDriverStats) {
+            Print(L"%ld", Result->DriverAvgUs);
+        }
+        Print(L"\n");
+    } else {
+        Print(
+            L"%-5s  %-4s  %7d  %2d  %5d  %5ld.%02ld  %6ld  %8ld  %8ld  %8ld  %8ld",
+            (Test->Transfer == BENCH_WRITE) ? L"write" : L"read",
+            Test->Random ? L"rand" : L"seq",
+            (UINT32)Test->IoSize,
+            (UINT32)Test->QueueDepth,
+            (UINT32)Result->Ios,
+            DivU64x32(KBps, 1000),
+            DivU64x32(ModU64x32(KBps, 1000), 10),
+            Iops,
+            Result->AvgUs,
+            Result->P50Us,
+            Result->P99Us,
+            Result->MaxUs);
+        if (Result->HasDriverStats) {
+            Print(L"  %8ld", Result->DriverAvgUs);
+        }
+        Print(L"\n");
+    }
+
+    if (!Options->Histogram) {
+        return;
+    }
+
+    for (First = 0; (First < BENCH_LATENCY_BUCKETS) && (Result->Histogram[First] == 0); ++First);
+    for (Last = BENCH_LATENCY_BUCKETS; (Last > First) && (Result->Histogram[Last - 1] == 0); --Last);
+
+    for (Bucket = First; Bucket < Last; ++Bucket) {
+        if (Options->Csv) {
+            Print(
+                L"hist,%ld,%ld,%ld\n",
+                (Bucket == 0) ? 0 : LShiftU64(1, Bucket - 1),
+                LShiftU64(1, Bucket),
+                Result->Histogram[Bucket]);
+        } else {
+            Print(
+                L"    %8ld-%-8ld us  %6ld  %3d%%\n",
+                (Bucket == 0) ? 0 : LShiftU64(1, Bucket - 1),
+                LShiftU64(1, Bucket),
+                Result->Histogram[Bucket],
+                (UINT32)DivU64x32(MultU64x32(Result->Histogram[Bucket], 100), (UINT32)Result->Ios));
+        }
+    }
+}
+
+STATIC
+EFI_STATUS
+BenchRunTest(
+    IN BENCH_DEVICE     *Device,
+    IN BENCH_OPTIONS    *Options,
+    IN BENCH_TEST       *Test
+    )
+{
+    EFI_STATUS Status;
+    BENCH_RESULT Result;
+    MMC_STATS Before;
+    MMC_STATS After;
+    MMC_STATS_IO *IoBefore;
+    MMC_STATS_IO *IoAfter;
+    UINT64 ElapsedTicks;
+    UINT64 Requests;
+
+    // Start every test from the same state, with nothing left to write back
+    Device->BlockIo->FlushBlocks(Device->BlockIo);
+
+    if (Device->MmcStats != NULL) {
+        Device->MmcStats->GetStats(Device->MmcStats, &Before);
+    }
+
+    if (Test->QueueDepth == 1) {
+        Status = BenchRunBlockIo(Device, Test, Options->IoCount, &ElapsedTicks);
+    } else {
+        Status = BenchRunBlockIo2(Device, Test, Options->IoCount, &ElapsedTicks);
+    }
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    BenchComputeResult(Options->IoCount, ElapsedTicks, &Result);
+
+    // Time spent in MmcDxe per request, without the BlockIo2 queuing delays
+    if (Device->MmcStats != NULL) {
+        Device->MmcStats->GetStats(Device->MmcStats, &After);
+        IoBefore = (Test->Transfer == BENCH_WRITE) ? &Before.Write : &Before.Read;
+        IoAfter = (Test->Transfer == BENCH_WRITE) ? &After.Write : &After.Read;
+        Requests = IoAfter->Requests - IoBefore->Requests;
+        if (Requests != 0) {
+            Result.HasDriverStats = TRUE;
+            Result.DriverAvgUs = DivU64x64Remainder(IoAfter->TotalTimeUs - IoBefore->TotalTimeUs, Requests, NULL);
+        }
+    }
+
+    BenchPrintResult(Options, Test, &Result);
+    return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+BenchRun(
+    IN BENCH_DEVICE     *Device,
+    IN BENCH_OPTIONS    *Options
+    )
+{
+    EFI_STATUS Status;
+    BENCH_TEST Test;
+    UINTN Transfer;
+    UINTN Pattern;
+    UINTN QdIdx;
+
+    if (Options->Csv) {
+        Print(L"op,pattern,size,qd,ios,mbps,iops,avg_us,p50_us,p99_us,max_us,driver_avg_us\n");
+    } else {
+        Print(L"op     pat      size  qd    ios     MB/s    IOPS   avg(us)   p50(us)   p99(us)   max(us)");
+        Print((Device->MmcStats != NULL) ? L"   drv(us)\n" : L"\n");
+    }
+
+    for (Transfer = BENCH_READ; Transfer <= BENCH_WRITE; ++Transfer) {
+        if ((Transfer == BENCH_WRITE) && !Options->Write) {
+            break;
+        }
+
+        for (Pattern = 0; Pattern < 2; ++Pattern) {
+            if (((Pattern == 0) && !Options->Sequential) || ((Pattern == 1) && !Options->Random)) {
+                continue;
+            }
+
+            for (QdIdx = 0; QdIdx < Options->QueueDepthCount; ++QdIdx) {
+                if ((Options->QueueDepths[QdIdx] > 1) && (Device->BlockIo2 == NULL)) {
+                    continue;
+                }
+
+                for (Test.IoSize = Options->MinSize; Test.IoSize <= Options->MaxSize; Test.IoSize *= 2) {
+                    if ((Test.IoSize % Device->Media->BlockSize) != 0) {
+                        continue;
+                    }
+                    // The region must hold a full queue of distinct I/Os
+                    if (DivU64x32(MultU64x32(Device->RegionBlocks, Device->Media->BlockSize), (UINT32)Test.IoSize) <
+                        Options->QueueDepths[QdIdx]) {
+                        break;
+                    }
+
+                    Test.Transfer = Transfer;
+                    Test.Random = (Pattern == 1);
+                    Test.QueueDepth = Options->QueueDepths[QdIdx];
+
+                    // Every test replays the same random offsets
+                    mRandomState = Options->Seed;
+
+                    Status = BenchRunTest(Device, Options, &Test);
+                    if (EFI_ERROR(Status)) {
+                        return Status;
+                    }
+                }
+            }
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+BlockIoBenchmarkMain(
+    IN EFI_HANDLE           ImageHandle,
+    IN EFI_SYSTEM_TABLE     *SystemTable
+    )
+{
+    EFI_STATUS Status;
+    EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+    BENCH_OPTIONS Options;
+    BENCH_DEVICE Device;
+    EFI_HANDLE *Handles;
+    UINTN HandleCount;
+    BOOLEAN CacheWasEnabled;
+
+    Status = gBS->HandleProtocol(ImageHandle, &gEfiShellParametersProtocolGuid, (VOID**)&ShellParameters);
+    if (EFI_ERROR(Status)) {
+        Print(L"BlockIoBenchmark: Must be started from the UEFI Shell\n");
+        return Status;
+    }
+
+    Status = BenchParseOptions(ShellParameters->Argc, ShellParameters->Argv, &Options);
+    if (EFI_ERROR(Status)) {
+        BenchPrintUsage();
+        return (Status == EFI_ABORTED) ? EFI_SUCCESS : Status;
+    }
+
+    mTicksPerSecond = GetPerformanceCounterProperties(NULL, NULL);
+    ASSERT(mTicksPerSecond != 0);
+
+    Status = gBS->LocateHandleBuffer(ByProtocol, &gEfiBlockIoProtocolGuid, NULL, &HandleCount, &Handles);
+    if (EFI_ERROR(Status)) {
+        Print(L"BlockIoBenchmark: No block device\n");
+        return Status;
+    }
+
+    if (Options.List) {
+        BenchListDevices(Handles, HandleCount);
+        FreePool(Handles);
+        return EFI_SUCCESS;
+    }
+
+    CacheWasEnabled = FALSE;
+    Status = BenchOpenDevice(Handles, HandleCount, &Options, &Device);
+    FreePool(Handles);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    if (Options.Write && Device.Media->ReadOnly) {
+        Print(L"BlockIoBenchmark: Read-only media, skipping the write tests\n");
+        Options.Write = FALSE;
+    }
+
+    mLatencies = AllocatePool(Options.IoCount * sizeof(UINT64));
+    Status = (mLatencies != NULL) ? BenchAllocateSlots(&Device, &Options, BenchIoComplete) : EFI_OUT_OF_RESOURCES;
+    if (EFI_ERROR(Status)) {
+        Print(L"BlockIoBenchmark: Failed to allocate the buffers, %r\n", Status);
+        goto EXIT;
+    }
+
+    // Measure the card rather than the sector cache, the cache writes back its
+    // dirty lines on the way out so the saved region is up to date
+    if ((Device.MmcStats != NULL) && !Options.KeepCache) {
+        Device.MmcStats->SetCacheEnabled(Device.MmcStats, FALSE, &CacheWasEnabled);
+    }
+
+    if (Options.Write) {
+        Status = BenchBackupRegion(&Device);
+        if (EFI_ERROR(Status)) {
+            goto EXIT;
+        }
+    }
+
+    if (!Options.Csv) {
+        Print(
+            L"Region 0x%lx-0x%lx, %d I/Os per test, seed %d, %s\n",
+            Device.RegionStart,
+            Device.RegionStart + Device.RegionBlocks - 1,
+            (UINT32)Options.IoCount,
+            Options.Seed,
+            (Device.MmcStats == NULL) ? L"no driver statistics" :
+                (Options.KeepCache ? L"MmcDxe cache on" : L"MmcDxe cache off"));
+    }
+
+    Status = BenchRun(&Device, &Options);
+
+EXIT:
+    if (CacheWasEnabled) {
+        Device.MmcStats->SetCacheEnabled(Device.MmcStats, TRUE, NULL);
+    }
+    BenchFreeSlots();
+    if (Device.Backup != NULL) {
+        FreeAlignedPages(Device.Backup, Device.BackupPages);
+    }
+    if (mLatencies != NULL) {
+        FreePool(mLatencies);
+        mLatencies = NULL;
+    }
+
+    return Status;
+}
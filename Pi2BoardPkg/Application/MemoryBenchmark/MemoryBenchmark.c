@@ -0,0 +1,938 @@
+/** @file
+*
+*  Shell application checking the BaseMemoryLib instance it is linked with
+*  against byte-wise references, then measuring its throughput.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Protocol/EfiShellParameters.h>
+
+#define BENCH_DEFAULT_MIN_SIZE      64
+#define BENCH_DEFAULT_MAX_SIZE      SIZE_4MB
+#define BENCH_DEFAULT_DURATION_MS   50
+#define BENCH_MAX_SIZE              SIZE_64MB
+
+// Room around the buffers for the misaligned and overlapping tests
+#define BENCH_SLACK                 SIZE_4KB
+
+// The checks cover every length up to this one at every relative alignment
+#define CHECK_MAX_LENGTH            300
+#define CHECK_MAX_OFFSET            16
+#define CHECK_GUARD                 64
+#define CHECK_BUFFER_SIZE           (CHECK_GUARD + CHECK_MAX_OFFSET + CHECK_MAX_LENGTH + CHECK_GUARD)
+
+// Byte the buffers are filled with around the bytes an operation may touch
+#define CHECK_GUARD_BYTE            0xE7
+
+typedef struct {
+    BOOLEAN     CheckOnly;
+    BOOLEAN     SkipCheck;
+    BOOLEAN     Csv;
+    UINTN       MinSize;
+    UINTN       MaxSize;
+    UINTN       DurationMs;
+} BENCH_OPTIONS;
+
+typedef
+UINTN
+(*BENCH_ROUTINE)(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    );
+
+typedef struct {
+    CONST CHAR16    *Name;
+    BENCH_ROUTINE   Routine;
+} BENCH_TEST;
+
+STATIC UINT64 mTicksPerSecond;
+STATIC UINT32 mRandomState;
+STATIC UINTN mCheckFailures;
+
+// Keeps the results of the timed calls alive
+STATIC volatile UINTN mSink;
+
+STATIC
+VOID
+BenchPrintUsage(
+    VOID
+    )
+{
+    Print(L"Usage: MemoryBenchmark [options]\n");
+    Print(L"  -b <min>[:<max>]  Buffer sizes, doubled from min to max (default 64:4M)\n");
+    Print(L"  -t <ms>           Time spent on each operation and size (default %d)\n", BENCH_DEFAULT_DURATION_MS);
+    Print(L"  -c                Only run the correctness checks\n");
+    Print(L"  -nc               Skip the correctness checks\n");
+    Print(L"  -csv              Print the results as CSV\n");
+    Print(L"Sizes take a K or M suffix, numbers a 0x prefix for hexadecimal.\n");
+    Print(L"The results are those of the BaseMemoryLib instance the application is\n");
+    Print(L"built with, rebuild it against another one to compare them.\n");
+}
+
+//
+// xorshift32, the same seed always produces the same data
+//
+STATIC
+UINT32
+BenchRandom(
+    VOID
+    )
+{
+    mRandomState ^= mRandomState << 13;
+    mRandomState ^= mRandomState >> 17;
+    mRandomState ^= mRandomState << 5;
+    return mRandomState;
+}
+
+STATIC
+UINT64
+BenchTicksToUs(
+    IN UINT64   Ticks
+    )
+{
+    return DivU64x64Remainder(MultU64x32(Ticks, 1000000), mTicksPerSecond, NULL);
+}
+
+/**
+  Parses a decimal or 0x prefixed number with an optional K or M suffix
+**/
+STATIC
+EFI_STATUS
+BenchParseNumber(
+    IN  CONST CHAR16    *String,
+    OUT UINT64          *Value
+    )
+{
+    CONST CHAR16 *Suffix;
+
+    if ((String == NULL) || (*String == L'\0')) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if ((String[0] == L'0') && ((String[1] == L'x') || (String[1] == L'X'))) {
+        if (String[2] == L'\0') {
+            return EFI_INVALID_PARAMETER;
+        }
+        *Value = StrHexToUint64(String);
+        Suffix = String + 2;
+        while (((*Suffix >= L'0') && (*Suffix <= L'9')) ||
+               ((*Suffix >= L'a') && (*Suffix <= L'f')) ||
+               ((*Suffix >= L'A') && (*Suffix <= L'F'))) {
+            ++Suffix;
+        }
+    } else {
+        if ((*String < L'0') || (*String > L'9')) {
+            return EFI_INVALID_PARAMETER;
+        }
+        *Value = StrDecimalToUint64(String);
+        Suffix = String;
+        while ((*Suffix >= L'0') && (*Suffix <= L'9')) {
+            ++Suffix;
+        }
+    }
+
+    if (*Suffix == L'\0') {
+        return EFI_SUCCESS;
+    }
+    if (Suffix[1] != L'\0') {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if ((*Suffix == L'k') || (*Suffix == L'K')) {
+        *Value = LShiftU64(*Value, 10);
+    } else if ((*Suffix == L'm') || (*Suffix == L'M')) {
+        *Value = LShiftU64(*Value, 20);
+    } else {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Parses "<min>[:<max>]" into the buffer size range
+**/
+STATIC
+EFI_STATUS
+BenchParseSizes(
+    IN  CHAR16          *String,
+    OUT BENCH_OPTIONS   *Options
+    )
+{
+    EFI_STATUS Status;
+    UINT64 Min;
+    UINT64 Max;
+    CHAR16 *Separator;
+
+    Separator = StrStr(String, L":");
+    if (Separator != NULL) {
+        *Separator = L'\0';
+        Status = BenchParseNumber(Separator + 1, &Max);
+    } else {
+        Status = EFI_SUCCESS;
+    }
+
+    if (!EFI_ERROR(Status)) {
+        Status = BenchParseNumber(String, &Min);
+    }
+    if (Separator != NULL) {
+        *Separator = L':';
+    } else {
+        Max = Min;
+    }
+
+    if (EFI_ERROR(Status) || (Min == 0) || (Min > Max) || (Max > BENCH_MAX_SIZE)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Options->MinSize = (UINTN)Min;
+    Options->MaxSize = (UINTN)Max;
+    return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+BenchParseOptions(
+    IN  UINTN           Argc,
+    IN  CHAR16          **Argv,
+    OUT BENCH_OPTIONS   *Options
+    )
+{
+    EFI_STATUS Status;
+    UINT64 Value;
+    UINTN Idx;
+    CHAR16 *Option;
+    CHAR16 *Argument;
+
+    ZeroMem(Options, sizeof(BENCH_OPTIONS));
+    Options->MinSize = BENCH_DEFAULT_MIN_SIZE;
+    Options->MaxSize = BENCH_DEFAULT_MAX_SIZE;
+    Options->DurationMs = BENCH_DEFAULT_DURATION_MS;
+
+    for (Idx = 1; Idx < Argc; ++Idx) {
+        Option = Argv[Idx];
+
+        // Flags
+        if (StrCmp(Option, L"-c") == 0) {
+            Options->CheckOnly = TRUE;
+            continue;
+        } else if (StrCmp(Option, L"-nc") == 0) {
+            Options->SkipCheck = TRUE;
+            continue;
+        } else if (StrCmp(Option, L"-csv") == 0) {
+            Options->Csv = TRUE;
+            continue;
+        } else if ((StrCmp(Option, L"-h") == 0) || (StrCmp(Option, L"-?") == 0)) {
+            return EFI_ABORTED;
+        }
+
+        // Options with an argument
+        if (Idx + 1 >= Argc) {
+            Print(L"MemoryBenchmark: Missing or unknown option %s\n", Option);
+            return EFI_INVALID_PARAMETER;
+        }
+        Argument = Argv[++Idx];
+
+        if (StrCmp(Option, L"-b") == 0) {
+            Status = BenchParseSizes(Argument, Options);
+        } else if (StrCmp(Option, L"-t") == 0) {
+            Status = BenchParseNumber(Argument, &Value);
+            if (!EFI_ERROR(Status) && ((Value == 0) || (Value > 60000))) {
+                Status = EFI_INVALID_PARAMETER;
+            }
+            Options->DurationMs = (UINTN)Value;
+        } else {
+            Status = EFI_INVALID_PARAMETER;
+        }
+
+        if (EFI_ERROR(Status)) {
+            Print(L"MemoryBenchmark: Invalid option %s %s\n", Option, Argument);
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+
+    if (Options->CheckOnly && Options->SkipCheck) {
+        Print(L"MemoryBenchmark: -c and -nc are exclusive\n");
+        return EFI_INVALID_PARAMETER;
+    }
+
+    return EFI_SUCCESS;
+}
+
+//
+// Correctness checks. Every operation runs on buffers of random bytes and is
+// compared with a byte-wise reference, guard bytes included, so a routine
+// writing one byte too many or reading past its end on the wrong side of a
+// comparison is caught as well.
+//
+
+STATIC
+VOID
+CheckFill(
+    OUT UINT8   *Buffer,
+    IN  UINTN   Length
+    )
+{
+    UINTN Idx;
+
+    for (Idx = 0; Idx < Length; ++Idx) {
+        Buffer[Idx] = (UINT8)BenchRandom();
+    }
+}
+
+STATIC
+BOOLEAN
+CheckSame(
+    IN CONST UINT8  *Buffer,
+    IN CONST UINT8  *Expected,
+    IN UINTN        Length
+    )
+{
+    UINTN Idx;
+
+    for (Idx = 0; Idx < Length; ++Idx) {
+        if (Buffer[Idx] != Expected[Idx]) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+STATIC
+VOID
+CheckReport(
+    IN CONST CHAR16     *Name,
+    IN UINTN            Offset1,
+    IN UINTN            Offset2,
+    IN UINTN            Length
+    )
+{
+    // A broken routine usually fails thousands of cases, keep the first few
+    if (mCheckFailures < 8) {
+        Print(L"  %s failed, offsets %d/%d, length %d\n", Name, Offset1, Offset2, Length);
+    }
+    ++mCheckFailures;
+}
+
+STATIC
+VOID
+CheckCopy(
+    IN UINT8    *Buffer,
+    IN UINT8    *Expected,
+    IN UINT8    *Source
+    )
+{
+    UINTN SrcOffset;
+    UINTN DstOffset;
+    UINTN Length;
+    UINTN Idx;
+
+    for (SrcOffset = 0; SrcOffset < CHECK_MAX_OFFSET; ++SrcOffset) {
+        for (DstOffset = 0; DstOffset < CHECK_MAX_OFFSET; ++DstOffset) {
+            for (Length = 0; Length <= CHECK_MAX_LENGTH; ++Length) {
+                CheckFill(Source, CHECK_BUFFER_SIZE);
+                SetMem(Buffer, CHECK_BUFFER_SIZE, CHECK_GUARD_BYTE);
+                SetMem(Expected, CHECK_BUFFER_SIZE, CHECK_GUARD_BYTE);
+                for (Idx = 0; Idx < Length; ++Idx) {
+                    Expected[CHECK_GUARD + DstOffset + Idx] = Source[CHECK_GUARD + SrcOffset + Idx];
+                }
+
+                CopyMem(Buffer + CHECK_GUARD + DstOffset, Source + CHECK_GUARD + SrcOffset, Length);
+                if (!CheckSame(Buffer, Expected, CHECK_BUFFER_SIZE)) {
+                    CheckReport(L"CopyMem", DstOffset, SrcOffset, Length);
+                }
+            }
+        }
+    }
+}
+
+STATIC
+VOID
+CheckMove(
+    IN UINT8    *Buffer,
+    IN UINT8    *Expected,
+    IN UINT8    *Source
+    )
+{
+    UINTN SrcOffset;
+    UINTN DstOffset;
+    UINTN Length;
+    UINTN Idx;
+
+    // Both directions, with the two ranges overlapping by any amount
+    for (SrcOffset = 0; SrcOffset < CHECK_GUARD; ++SrcOffset) {
+        for (DstOffset = 0; DstOffset < CHECK_GUARD; ++DstOffset) {
+            for (Length = 0; Length <= CHECK_MAX_LENGTH; Length += (Length < 80) ? 1 : 13) {
+                CheckFill(Buffer, CHECK_BUFFER_SIZE);
+                CopyMem(Source, Buffer, CHECK_BUFFER_SIZE);
+                CopyMem(Expected, Buffer, CHECK_BUFFER_SIZE);
+                for (Idx = 0; Idx < Length; ++Idx) {
+                    Expected[DstOffset + Idx] = Source[SrcOffset + Idx];
+                }
+
+                CopyMem(Buffer + DstOffset, Buffer + SrcOffset, Length);
+                if (!CheckSame(Buffer, Expected, CHECK_BUFFER_SIZE)) {
+                    CheckReport(L"CopyMem (overlap)", DstOffset, SrcOffset, Length);
+                }
+            }
+        }
+    }
+}
+
+STATIC
+VOID
+CheckSet(
+    IN UINT8    *Buffer,
+    IN UINT8    *Expected
+    )
+{
+    UINTN Offset;
+    UINTN Length;
+    UINTN Width;
+    UINTN Idx;
+    UINT64 Value;
+    UINT8 *Start;
+
+    for (Width = 0; Width <= 8; Width = (Width == 0) ? 1 : (Width * 2)) {
+        for (Offset = 0; Offset < CHECK_MAX_OFFSET; Offset += (Width == 0) ? 1 : Width) {
+            for (Length = 0; Length <= CHECK_MAX_LENGTH; Length += (Width == 0) ? 1 : Width) {
+                Value = LShiftU64(BenchRandom(), 32) | BenchRandom();
+                Start = Buffer + CHECK_GUARD + Offset;
+
+                CheckFill(Buffer, CHECK_BUFFER_SIZE);
+                CopyMem(Expected, Buffer, CHECK_BUFFER_SIZE);
+                for (Idx = 0; Idx < Length; ++Idx) {
+                    switch (Width) {
+                    case 0:
+                        Expected[CHECK_GUARD + Offset + Idx] = 0;
+                        break;
+                    case 1:
+                        Expected[CHECK_GUARD + Offset + Idx] = (UINT8)Value;
+                        break;
+                    default:
+                        // Little endian, the pattern repeats every Width bytes
+                        Expected[CHECK_GUARD + Offset + Idx] = (UINT8)RShiftU64(Value, 8 * (Idx % Width));
+                        break;
+                    }
+                }
+
+                switch (Width) {
+                case 0:
+                    ZeroMem(Start, Length);
+                    break;
+                case 1:
+                    SetMem(Start, Length, (UINT8)Value);
+                    break;
+                case 2:
+                    SetMem16(Start, Length, (UINT16)Value);
+                    break;
+                case 4:
+                    SetMem32(Start, Length, (UINT32)Value);
+                    break;
+                default:
+                    SetMem64(Start, Length, Value);
+                    break;
+                }
+
+                if (!CheckSame(Buffer, Expected, CHECK_BUFFER_SIZE)) {
+                    CheckReport((Width == 0) ? L"ZeroMem" : L"SetMem", Width, Offset, Length);
+                }
+            }
+        }
+    }
+}
+
+STATIC
+VOID
+CheckCompare(
+    IN UINT8    *Buffer,
+    IN UINT8    *Source
+    )
+{
+    UINTN SrcOffset;
+    UINTN DstOffset;
+    UINTN Length;
+    UINTN Pass;
+    UINTN Position;
+    INTN Expected;
+    INTN Result;
+
+    for (SrcOffset = 0; SrcOffset < CHECK_MAX_OFFSET; ++SrcOffset) {
+        for (DstOffset = 0; DstOffset < CHECK_MAX_OFFSET; ++DstOffset) {
+            for (Length = 1; Length <= CHECK_MAX_LENGTH; ++Length) {
+                CheckFill(Source, CHECK_BUFFER_SIZE);
+                CopyMem(Buffer + CHECK_GUARD + DstOffset, Source + CHECK_GUARD + SrcOffset, Length);
+
+                // Equal, then a difference at the start, the middle and the
+                // end, then one just past the end that must not count
+                for (Pass = 0; Pass < 5; ++Pass) {
+                    Position = (Pass == 1) ? 0 :
+                               (Pass == 2) ? (Length / 2) :
+                               (Pass == 3) ? (Length - 1) : Length;
+                    Expected = 0;
+                    if ((Pass != 0) && (Pass != 4)) {
+                        Buffer[CHECK_GUARD + DstOffset + Position] ^= (UINT8)(BenchRandom() | 1);
+                        Expected = (INTN)Buffer[CHECK_GUARD + DstOffset + Position] -
+                                   (INTN)Source[CHECK_GUARD + SrcOffset + Position];
+                    } else if (Pass == 4) {
+                        Buffer[CHECK_GUARD + DstOffset + Position] = (UINT8)~Source[CHECK_GUARD + SrcOffset + Position];
+                    }
+
+                    Result = CompareMem(Buffer + CHECK_GUARD + DstOffset, Source + CHECK_GUARD + SrcOffset, Length);
+                    if (Result != Expected) {
+                        CheckReport(L"CompareMem", DstOffset, SrcOffset, Length);
+                    }
+
+                    if (Position < Length) {
+                        Buffer[CHECK_GUARD + DstOffset + Position] = Source[CHECK_GUARD + SrcOffset + Position];
+                    }
+                }
+            }
+        }
+    }
+}
+
+STATIC
+VOID
+CheckScan(
+    IN UINT8    *Buffer
+    )
+{
+    UINTN Offset;
+    UINTN Count;
+    UINTN Width;
+    UINTN Pass;
+    UINTN Position;
+    UINTN Idx;
+    UINT64 Value;
+    UINT8 *Start;
+    UINT8 *Found;
+    UINT8 *Expected;
+
+    for (Width = 1; Width <= 8; Width *= 2) {
+        for (Offset = 0; Offset < CHECK_MAX_OFFSET; Offset += Width) {
+            for (Count = 1; Count * Width <= CHECK_MAX_LENGTH; ++Count) {
+                Start = Buffer + CHECK_GUARD + Offset;
+                Value = LShiftU64(BenchRandom(), 32) | BenchRandom();
+
+                // Absent, then at the start, the middle and the end, then
+                // just past the end where it must not be found
+                for (Pass = 0; Pass < 5; ++Pass) {
+                    Position = (Pass == 1) ? 0 :
+                               (Pass == 2) ? (Count / 2) :
+                               (Pass == 3) ? (Count - 1) : Count;
+
+                    // Elements differing from the value in one byte only
+                    for (Idx = 0; Idx + Width <= CHECK_BUFFER_SIZE - CHECK_GUARD - Offset; Idx += Width) {
+                        CopyMem(Start + Idx, &Value, Width);
+                        Start[Idx + (BenchRandom() % Width)] ^= (UINT8)(BenchRandom() | 1);
+                    }
+                    Expected = NULL;
+                    if (Pass != 0) {
+                        CopyMem(Start + Position * Width, &Value, Width);
+                        if (Pass != 4) {
+                            Expected = Start + Position * Width;
+                        }
+                    }
+
+                    switch (Width) {
+                    case 1:
+                        Found = (UINT8*)ScanMem8(Start, Count, (UINT8)Value);
+                        break;
+                    case 2:
+                        Found = (UINT8*)ScanMem16(Start, Count * 2, (UINT16)Value);
+                        break;
+                    case 4:
+                        Found = (UINT8*)ScanMem32(Start, Count * 4, (UINT32)Value);
+                        break;
+                    default:
+                        Found = (UINT8*)ScanMem64(Start, Count * 8, Value);
+                        break;
+                    }
+
+                    if (Found != Expected) {
+                        CheckReport(L"ScanMem", Width, Offset, Count * Width);
+                    }
+                }
+            }
+        }
+    }
+}
+
+STATIC
+VOID
+CheckGuid(
+    IN UINT8    *Buffer,
+    IN UINT8    *Source
+    )
+{
+    UINTN SrcOffset;
+    UINTN DstOffset;
+    UINTN Position;
+
+    for (SrcOffset = 0; SrcOffset < 8; ++SrcOffset) {
+        for (DstOffset = 0; DstOffset < 8; ++DstOffset) {
+            CheckFill(Source, CHECK_BUFFER_SIZE);
+            CopyMem(Buffer, Source, CHECK_BUFFER_SIZE);
+            if (!CompareGuid((GUID*)(Buffer + DstOffset), (GUID*)(Buffer + DstOffset))) {
+                CheckReport(L"CompareGuid", DstOffset, DstOffset, sizeof(GUID));
+            }
+
+            CopyMem(Buffer + DstOffset, Source + SrcOffset, sizeof(GUID));
+            if (!CompareGuid((GUID*)(Buffer + DstOffset), (GUID*)(Source + SrcOffset))) {
+                CheckReport(L"CompareGuid", DstOffset, SrcOffset, sizeof(GUID));
+            }
+
+            for (Position = 0; Position < sizeof(GUID); ++Position) {
+                Buffer[DstOffset + Position] ^= 0x80;
+                if (CompareGuid((GUID*)(Buffer + DstOffset), (GUID*)(Source + SrcOffset))) {
+                    CheckReport(L"CompareGuid", DstOffset, SrcOffset, Position);
+                }
+                Buffer[DstOffset + Position] ^= 0x80;
+            }
+        }
+    }
+}
+
+STATIC
+EFI_STATUS
+BenchCheck(
+    VOID
+    )
+{
+    UINT8 *Buffer;
+    UINT8 *Expected;
+    UINT8 *Source;
+
+    // Pages, so that the offsets are relative to a well aligned address
+    Buffer = AllocatePages(EFI_SIZE_TO_PAGES(CHECK_BUFFER_SIZE) * 3);
+    if (Buffer == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    Expected = Buffer + EFI_PAGES_TO_SIZE(EFI_SIZE_TO_PAGES(CHECK_BUFFER_SIZE));
+    Source = Expected + EFI_PAGES_TO_SIZE(EFI_SIZE_TO_PAGES(CHECK_BUFFER_SIZE));
+
+    mRandomState = 1;
+    mCheckFailures = 0;
+
+    Print(L"Checking CopyMem\n");
+    CheckCopy(Buffer, Expected, Source);
+    CheckMove(Buffer, Expected, Source);
+    Print(L"Checking SetMem and ZeroMem\n");
+    CheckSet(Buffer, Expected);
+    Print(L"Checking CompareMem\n");
+    CheckCompare(Buffer, Source);
+    Print(L"Checking ScanMem\n");
+    CheckScan(Buffer);
+    Print(L"Checking CompareGuid\n");
+    CheckGuid(Buffer, Source);
+
+    FreePages(Buffer, EFI_SIZE_TO_PAGES(CHECK_BUFFER_SIZE) * 3);
+
+    if (mCheckFailures != 0) {
+        Print(L"MemoryBenchmark: %d checks failed\n", mCheckFailures);
+        return EFI_DEVICE_ERROR;
+    }
+
+    Print(L"All checks passed\n");
+    return EFI_SUCCESS;
+}
+
+//
+// Timed operations. The source and destination buffers start zeroed before
+// every operation, which CompareMem needs to run to the end and ScanMem to
+// miss.
+//
+
+STATIC
+UINTN
+BenchCopy(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    return (UINTN)CopyMem(Destination, Source, Length);
+}
+
+STATIC
+UINTN
+BenchCopyMisaligned(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    return (UINTN)CopyMem(Destination + 1, Source + 3, Length);
+}
+
+STATIC
+UINTN
+BenchMove(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    // Overlapping, destination above the source, so a backward copy
+    return (UINTN)CopyMem(Source + 64, Source, Length);
+}
+
+STATIC
+UINTN
+BenchSet(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    return (UINTN)SetMem(Destination, Length, 0x5A);
+}
+
+STATIC
+UINTN
+BenchSet32(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    return (UINTN)SetMem32(Destination, Length & ~(UINTN)3, 0x12345678);
+}
+
+STATIC
+UINTN
+BenchZero(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    return (UINTN)ZeroMem(Destination, Length);
+}
+
+STATIC
+UINTN
+BenchCompare(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    return (UINTN)CompareMem(Destination, Source, Length);
+}
+
+STATIC
+UINTN
+BenchScan8(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    return (UINTN)ScanMem8(Source, Length, 0xFF);
+}
+
+STATIC
+UINTN
+BenchScan32(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    return (UINTN)ScanMem32(Source, Length & ~(UINTN)3, 0xFFFFFFFF);
+}
+
+STATIC
+UINTN
+BenchGuid(
+    IN UINT8    *Destination,
+    IN UINT8    *Source,
+    IN UINTN    Length
+    )
+{
+    UINTN Idx;
+    UINTN Equal;
+
+    // FV and protocol lookups compare GUIDs one at a time, time it the same way
+    Equal = 0;
+    for (Idx = 0; Idx + sizeof(GUID) <= Length; Idx += sizeof(GUID)) {
+        Equal += CompareGuid((GUID*)(Destination + Idx), (GUID*)(Source + Idx));
+    }
+    return Equal;
+}
+
+STATIC CONST BENCH_TEST mTests[] = {
+    { L"copy",      BenchCopy },
+    { L"copy-u",    BenchCopyMisaligned },
+    { L"move",      BenchMove },
+    { L"set",       BenchSet },
+    { L"set32",     BenchSet32 },
+    { L"zero",      BenchZero },
+    { L"compare",   BenchCompare },
+    { L"scan8",     BenchScan8 },
+    { L"scan32",    BenchScan32 },
+    { L"guid",      BenchGuid },
+};
+
+STATIC
+VOID
+BenchRunTest(
+    IN BENCH_OPTIONS        *Options,
+    IN CONST BENCH_TEST     *Test,
+    IN UINT8                *Destination,
+    IN UINT8                *Source,
+    IN UINTN                Size
+    )
+{
+    UINT64 Start;
+    UINT64 Elapsed;
+    UINT64 Duration;
+    UINT64 Calls;
+    UINT64 ElapsedUs;
+    UINT64 KBps;
+
+    SetMem(Destination, Options->MaxSize + BENCH_SLACK, 0);
+    SetMem(Source, Options->MaxSize + BENCH_SLACK, 0);
+
+    // Warm the caches and the TLB up
+    mSink = Test->Routine(Destination, Source, Size);
+
+    Duration = DivU64x32(MultU64x32(mTicksPerSecond, (UINT32)Options->DurationMs), 1000);
+    Calls = 0;
+    Start = GetPerformanceCounter();
+    do {
+        mSink = Test->Routine(Destination, Source, Size);
+        ++Calls;
+        Elapsed = GetPerformanceCounter() - Start;
+    } while (Elapsed < Duration);
+
+    ElapsedUs = BenchTicksToUs(Elapsed);
+    if (ElapsedUs == 0) {
+        ElapsedUs = 1;
+    }
+
+    // 1MB/s is one byte per microsecond, keep two decimals
+    KBps = DivU64x64Remainder(MultU64x32(MultU64x32(Calls, (UINT32)Size), 1000), ElapsedUs, NULL);
+
+    if (Options->Csv) {
+        Print(
+            L"%s,%d,%ld,%ld.%02ld,%ld\n",
+            Test->Name,
+            (UINT32)Size,
+            Calls,
+            DivU64x32(KBps, 1000),
+            DivU64x32(ModU64x32(KBps, 1000), 10),
+            DivU64x64Remainder(MultU64x32(ElapsedUs, 1000), Calls, NULL));
+    } else {
+        Print(
+            L"%-8s  %8d  %9ld  %6ld.%02ld  %9ld\n",
+            Test->Name,
+            (UINT32)Size,
+            Calls,
+            DivU64x32(KBps, 1000),
+            DivU64x32(ModU64x32(KBps, 1000), 10),
+            DivU64x64Remainder(MultU64x32(ElapsedUs, 1000), Calls, NULL));
+    }
+}
+
+STATIC
+EFI_STATUS
+BenchRun(
+    IN BENCH_OPTIONS    *Options
+    )
+{
+    UINT8 *Destination;
+    UINT8 *Source;
+    UINTN Pages;
+    UINTN TestIdx;
+    UINTN Size;
+
+    Pages = EFI_SIZE_TO_PAGES(Options->MaxSize + BENCH_SLACK);
+    Destination = AllocatePages(Pages);
+    Source = AllocatePages(Pages);
+    if ((Destination == NULL) || (Source == NULL)) {
+        Print(L"MemoryBenchmark: Failed to allocate the buffers\n");
+        if (Destination != NULL) {
+            FreePages(Destination, Pages);
+        }
+        if (Source != NULL) {
+            FreePages(Source, Pages);
+        }
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    if (Options->Csv) {
+        Print(L"op,size,calls,mbps,ns_per_call\n");
+    } else {
+        Print(L"op            size      calls      MB/s   ns/call\n");
+    }
+
+    for (TestIdx = 0; TestIdx < sizeof(mTests) / sizeof(mTests[0]); ++TestIdx) {
+        for (Size = Options->MinSize; Size <= Options->MaxSize; Size *= 2) {
+            BenchRunTest(Options, &mTests[TestIdx], Destination, Source, Size);
+        }
+    }
+
+    FreePages(Destination, Pages);
+    FreePages(Source, Pages);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MemoryBenchmarkMain(
+    IN EFI_HANDLE           ImageHandle,
+    IN EFI_SYSTEM_TABLE     *SystemTable
+    )
+{
+    EFI_STATUS Status;
+    EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+    BENCH_OPTIONS Options;
+
+    Status = gBS->HandleProtocol(ImageHandle, &gEfiShellParametersProtocolGuid, (VOID**)&ShellParameters);
+    if (EFI_ERROR(Status)) {
+        Print(L"MemoryBenchmark: Must be started from the UEFI Shell\n");
+        return Status;
+    }
+
+    Status = BenchParseOptions(ShellParameters->Argc, ShellParameters->Argv, &Options);
+    if (EFI_ERROR(Status)) {
+        BenchPrintUsage();
+        return (Status == EFI_ABORTED) ? EFI_SUCCESS : Status;
+    }
+
+    mTicksPerSecond = GetPerformanceCounterProperties(NULL, NULL);
+    ASSERT(mTicksPerSecond != 0);
+
+    if (!Options.SkipCheck) {
+        Status = BenchCheck();
+        if (EFI_ERROR(Status) || Options.CheckOnly) {
+            return Status;
+        }
+    }
+
+    return BenchRun(&Options);
+}
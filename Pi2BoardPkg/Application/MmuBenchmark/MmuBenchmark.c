@@ -0,0 +1,313 @@
+/** @file
+*
+*  Shell application measuring SetMemoryAttributes() of the CPU driver over
+*  the ranges the drivers typically remap: single pages, DMA buffers, whole
+*  sections and the 8MB framebuffer, 1MB aligned or not. Every range is
+*  changed then restored to write-back, and the data written through the
+*  cache beforehand is checked through the new mapping.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Protocol/Cpu.h>
+#include <Protocol/EfiShellParameters.h>
+
+#define BENCH_DEFAULT_DURATION_MS   200
+
+// The ranges are within this much of a 1MB aligned buffer
+#define BENCH_BUFFER_SIZE           (SIZE_8MB + SIZE_1MB)
+
+typedef struct {
+    BOOLEAN     Csv;
+    UINTN       DurationMs;
+} BENCH_OPTIONS;
+
+typedef struct {
+    CONST CHAR16    *Name;
+    UINTN           Offset;         // From the start of the buffer
+    UINTN           Length;
+    UINT64          Attributes;     // Restored to EFI_MEMORY_WB afterwards
+} BENCH_CASE;
+
+STATIC CONST BENCH_CASE mCases[] = {
+    { L"page",      0,          SIZE_4KB,   EFI_MEMORY_UC },
+    { L"dma-64k",   SIZE_64KB,  SIZE_64KB,  EFI_MEMORY_UC },
+    { L"dma-1m-u",  SIZE_4KB,   SIZE_1MB,   EFI_MEMORY_UC },
+    { L"section",   0,          SIZE_1MB,   EFI_MEMORY_WC },
+    { L"fb-8m",     0,          SIZE_8MB,   EFI_MEMORY_WC },
+    { L"fb-8m-u",   SIZE_4KB,   SIZE_8MB,   EFI_MEMORY_WC },
+    { L"same-8m",   0,          SIZE_8MB,   EFI_MEMORY_WB },
+};
+
+STATIC EFI_CPU_ARCH_PROTOCOL *mCpu;
+STATIC UINT64 mTicksPerSecond;
+
+STATIC
+VOID
+BenchPrintUsage(
+    VOID
+    )
+{
+    Print(L"Usage: MmuBenchmark [options]\n");
+    Print(L"  -t <ms>   Time spent on each range (default %d)\n", BENCH_DEFAULT_DURATION_MS);
+    Print(L"  -csv      Print the results as CSV\n");
+    Print(L"Each range is set to the attributes shown then restored to WB, the\n");
+    Print(L"times are those of the two calls to SetMemoryAttributes().\n");
+}
+
+STATIC
+EFI_STATUS
+BenchParseOptions(
+    IN  UINTN           Argc,
+    IN  CHAR16          **Argv,
+    OUT BENCH_OPTIONS   *Options
+    )
+{
+    UINTN Idx;
+
+    ZeroMem(Options, sizeof(BENCH_OPTIONS));
+    Options->DurationMs = BENCH_DEFAULT_DURATION_MS;
+
+    for (Idx = 1; Idx < Argc; ++Idx) {
+        if (StrCmp(Argv[Idx], L"-csv") == 0) {
+            Options->Csv = TRUE;
+        } else if ((StrCmp(Argv[Idx], L"-t") == 0) && (Idx + 1 < Argc)) {
+            Options->DurationMs = StrDecimalToUintn(Argv[++Idx]);
+            if ((Options->DurationMs == 0) || (Options->DurationMs > 60000)) {
+                Print(L"MmuBenchmark: Invalid duration %s\n", Argv[Idx]);
+                return EFI_INVALID_PARAMETER;
+            }
+        } else if ((StrCmp(Argv[Idx], L"-h") == 0) || (StrCmp(Argv[Idx], L"-?") == 0)) {
+            return EFI_ABORTED;
+        } else {
+            Print(L"MmuBenchmark: Missing or unknown option %s\n", Argv[Idx]);
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC
+UINT64
+BenchTicksToNs(
+    IN UINT64   Ticks
+    )
+{
+    return DivU64x64Remainder(MultU64x32(Ticks, 1000000000), mTicksPerSecond, NULL);
+}
+
+STATIC
+EFI_STATUS
+BenchSetAttributes(
+    IN UINT8    *Buffer,
+    IN UINTN    Length,
+    IN UINT64   Attributes
+    )
+{
+    return mCpu->SetMemoryAttributes(mCpu, (EFI_PHYSICAL_ADDRESS)(UINTN)Buffer, Length, Attributes);
+}
+
+/**
+  Writes a pattern through the cache, changes the attributes and reads it back
+  through the new mapping. Catches the dirty lines the CPU driver failed to
+  write back before the range became uncached.
+**/
+STATIC
+EFI_STATUS
+BenchCheckCase(
+    IN UINT8                *Buffer,
+    IN CONST BENCH_CASE     *Case
+    )
+{
+    EFI_STATUS Status;
+    volatile UINT32 *Words;
+    UINTN Count;
+    UINTN Idx;
+    UINTN Failures;
+
+    Words = (volatile UINT32*)(Buffer + Case->Offset);
+    Count = Case->Length / sizeof(UINT32);
+
+    for (Idx = 0; Idx < Count; Idx += SIZE_1KB / sizeof(UINT32)) {
+        Words[Idx] = (UINT32)(UINTN)&Words[Idx] ^ 0x5AA55AA5;
+    }
+    Words[Count - 1] = 0xC3C3C3C3;
+
+    Status = BenchSetAttributes(Buffer + Case->Offset, Case->Length, Case->Attributes);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Failures = 0;
+    for (Idx = 0; Idx < Count; Idx += SIZE_1KB / sizeof(UINT32)) {
+        if (Words[Idx] != ((UINT32)(UINTN)&Words[Idx] ^ 0x5AA55AA5)) {
+            ++Failures;
+        }
+    }
+    if (Words[Count - 1] != 0xC3C3C3C3) {
+        ++Failures;
+    }
+
+    Status = BenchSetAttributes(Buffer + Case->Offset, Case->Length, EFI_MEMORY_WB);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    if (Failures != 0) {
+        Print(L"MmuBenchmark: %s lost %d words written before the attributes changed\n", Case->Name, Failures);
+        return EFI_DEVICE_ERROR;
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+BenchRunCase(
+    IN BENCH_OPTIONS        *Options,
+    IN UINT8                *Buffer,
+    IN CONST BENCH_CASE     *Case
+    )
+{
+    EFI_STATUS Status;
+    UINT64 Duration;
+    UINT64 Start;
+    UINT64 Changed;
+    UINT64 End;
+    UINT64 SetTicks;
+    UINT64 RestoreTicks;
+    UINT64 Calls;
+
+    Status = BenchCheckCase(Buffer, Case);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Duration = DivU64x32(MultU64x32(mTicksPerSecond, (UINT32)Options->DurationMs), 1000);
+    SetTicks = 0;
+    RestoreTicks = 0;
+    Calls = 0;
+
+    do {
+        Start = GetPerformanceCounter();
+        Status = BenchSetAttributes(Buffer + Case->Offset, Case->Length, Case->Attributes);
+        Changed = GetPerformanceCounter();
+        if (!EFI_ERROR(Status)) {
+            Status = BenchSetAttributes(Buffer + Case->Offset, Case->Length, EFI_MEMORY_WB);
+        }
+        End = GetPerformanceCounter();
+        if (EFI_ERROR(Status)) {
+            Print(L"MmuBenchmark: %s failed, %r\n", Case->Name, Status);
+            return Status;
+        }
+
+        SetTicks += Changed - Start;
+        RestoreTicks += End - Changed;
+        ++Calls;
+    } while (SetTicks + RestoreTicks < Duration);
+
+    if (Options->Csv) {
+        Print(
+            L"%s,0x%x,%d,%ld,%ld,%ld\n",
+            Case->Name,
+            (UINT32)Case->Offset,
+            (UINT32)Case->Length,
+            Calls,
+            DivU64x64Remainder(BenchTicksToNs(SetTicks), Calls, NULL),
+            DivU64x64Remainder(BenchTicksToNs(RestoreTicks), Calls, NULL));
+    } else {
+        Print(
+            L"%-9s  %7x  %8d  %7ld  %9ld  %9ld\n",
+            Case->Name,
+            (UINT32)Case->Offset,
+            (UINT32)Case->Length,
+            Calls,
+            DivU64x64Remainder(BenchTicksToNs(SetTicks), Calls, NULL),
+            DivU64x64Remainder(BenchTicksToNs(RestoreTicks), Calls, NULL));
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MmuBenchmarkMain(
+    IN EFI_HANDLE           ImageHandle,
+    IN EFI_SYSTEM_TABLE     *SystemTable
+    )
+{
+    EFI_STATUS Status;
+    EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+    BENCH_OPTIONS Options;
+    UINT8 *Allocation;
+    UINT8 *Buffer;
+    UINTN Pages;
+    UINTN Idx;
+
+    Status = gBS->HandleProtocol(ImageHandle, &gEfiShellParametersProtocolGuid, (VOID**)&ShellParameters);
+    if (EFI_ERROR(Status)) {
+        Print(L"MmuBenchmark: Must be started from the UEFI Shell\n");
+        return Status;
+    }
+
+    Status = BenchParseOptions(ShellParameters->Argc, ShellParameters->Argv, &Options);
+    if (EFI_ERROR(Status)) {
+        BenchPrintUsage();
+        return (Status == EFI_ABORTED) ? EFI_SUCCESS : Status;
+    }
+
+    Status = gBS->LocateProtocol(&gEfiCpuArchProtocolGuid, NULL, (VOID**)&mCpu);
+    if (EFI_ERROR(Status)) {
+        Print(L"MmuBenchmark: No CPU architectural protocol\n");
+        return Status;
+    }
+
+    mTicksPerSecond = GetPerformanceCounterProperties(NULL, NULL);
+    ASSERT(mTicksPerSecond != 0);
+
+    // 1MB aligned, so that the ranges cover whole sections or split them as
+    // their offsets intend
+    Pages = EFI_SIZE_TO_PAGES(BENCH_BUFFER_SIZE + SIZE_1MB);
+    Allocation = AllocatePages(Pages);
+    if (Allocation == NULL) {
+        Print(L"MmuBenchmark: Failed to allocate the buffer\n");
+        return EFI_OUT_OF_RESOURCES;
+    }
+    Buffer = (UINT8*)ALIGN_POINTER(Allocation, SIZE_1MB);
+
+    if (Options.Csv) {
+        Print(L"range,offset,length,calls,set_ns,restore_ns\n");
+    } else {
+        Print(L"range       offset    length    calls     set ns  restore ns\n");
+    }
+
+    for (Idx = 0; Idx < sizeof(mCases) / sizeof(mCases[0]); ++Idx) {
+        Status = BenchRunCase(&Options, Buffer, &mCases[Idx]);
+        if (EFI_ERROR(Status)) {
+            break;
+        }
+    }
+
+    FreePages(Allocation, Pages);
+    return Status;
+}
@@ -26,6 +26,27 @@ BOOLEAN MBRGPTWorkaroundEnabled;
 UINT32 MBRGPTWorkaroundOffsetLba;
 BOOLEAN MBRGPTWorkaroundReceivedCmdSendCSD;
 
+// ADMA2 mode. Block data commands are held back until MMCReadBlockData() or
+// MMCWriteBlockData() know the buffer the descriptor table has to point at
+BOOLEAN mAdmaEnabled = FALSE;
+ADMA2_DESCRIPTOR *mAdmaDescriptors = NULL;
+BOOLEAN mIsDataCmdPending = FALSE;
+UINT32 mPendingDataCmd;
+UINT32 mPendingDataCmdArgument;
+
+// When the controller interrupt is registered, status waits sleep until it fires
+EFI_HARDWARE_INTERRUPT_PROTOCOL *mInterrupt = NULL;
+BOOLEAN mIrqRegistered = FALSE;
+
+// Armed for the length of every sleep. A tickless timer driver only interrupts
+// for the timer events, so nothing else bounds the WFI.
+EFI_EVENT mSleepEvent = NULL;
+
+// Set at TPL_NOTIFY once ExitBootServices started. The timer is stopped and the GPU
+// interrupts are masked by then, so the TPL_CALLBACK handlers doing I/O must poll
+EFI_EVENT mExitBootServicesEvent = NULL;
+BOOLEAN mExitBootServicesStarted = FALSE;
+
 // Ensure 16 byte alignment
 volatile MAILBOX_GET_CLOCK_RATE MbGcr __attribute__((aligned(16)));
 
@@ -135,6 +156,9 @@ TranslateCommand(
     case MMC_CMD24:
         Translation = CMD24;
         break;
+    case MMC_CMD25:
+        Translation = CMD25;
+        break;
     case MMC_CMD55:
         Translation = CMD55;
         break;
@@ -155,8 +179,152 @@ TranslateCommand(
     return Translation;
 }
 
+UINT64
+MMCDeadline(
+    IN UINT32 TimeoutUs
+    )
+{
+    UINT64 Frequency = GetPerformanceCounterProperties(NULL, NULL);
+
+    return GetPerformanceCounter() + DivU64x32(MultU64x32(Frequency, TimeoutUs), 1000000);
+}
+
+BOOLEAN
+MMCIsExpired(
+    IN UINT64 Deadline
+    )
+{
+    return GetPerformanceCounter() > Deadline;
+}
+
+/**
+  The handler only masks the interrupt signals, the waiter reads MMCHS_INT_STAT itself
+**/
+VOID
+EFIAPI
+MMCInterruptHandler(
+    IN HARDWARE_INTERRUPT_SOURCE    Source,
+    IN EFI_SYSTEM_CONTEXT           SystemContext
+    )
+{
+    MmioWrite32(MMCHS_ISE, 0);
+    mInterrupt->EndOfInterrupt(mInterrupt, Source);
+}
+
+VOID
+EFIAPI
+MMCExitBootServices(
+    IN EFI_EVENT Event,
+    IN VOID      *Context
+    )
+{
+    mExitBootServicesStarted = TRUE;
+}
+
+/**
+  Returns TRUE when the controller interrupt can wake the CPU up from WFI. Interrupts
+  are off at TPL_HIGH_LEVEL, and once ExitBootServices started the GPU interrupts are
+  masked and the timer is stopped, so the waiters have to poll.
+**/
+BOOLEAN
+MMCCanSleep(
+    VOID
+    )
+{
+    BOOLEAN SourceEnabled;
+
+    if (!mIrqRegistered || mExitBootServicesStarted || !ArmGetInterruptState()) {
+        return FALSE;
+    }
+
+    if (EFI_ERROR(mInterrupt->GetInterruptSourceState(
+            mInterrupt,
+            INT_GPU_SOURCE(INT_GPU_IRQ_ARASAN),
+            &SourceEnabled))) {
+        return FALSE;
+    }
+
+    return SourceEnabled;
+}
+
+/**
+  Sleeps until the next interrupt unless one of the Mask bits is already set in
+  MMCHS_INT_STAT or Deadline has passed, or returns right away when the controller
+  interrupt cannot wake the CPU up. The signals of Mask are only enabled for the sleep,
+  with interrupts masked across the check and the WFI so that one raised in between
+  still wakes the CPU up.
+
+  The sleep lasts SLEEP_MAX_US at most, up to Deadline, whether the timer ticks
+  periodically or not.
+**/
+VOID
+MMCSleepOnStatus(
+    IN UINT32 Mask,
+    IN UINT64 Deadline
+    )
+{
+    UINT32 SignalMask;
+    UINT64 Frequency;
+    UINT64 Now;
+    UINT64 SleepUs;
+
+    if (!MMCCanSleep() || MMCIsExpired(Deadline)) {
+        return;
+    }
+
+    Frequency = GetPerformanceCounterProperties(NULL, NULL);
+    Now = GetPerformanceCounter();
+    SleepUs = (Deadline > Now) ? DivU64x64Remainder(MultU64x32(Deadline - Now, 1000000), Frequency, NULL) : 0;
+    SleepUs = MAX(MIN(SleepUs, SLEEP_MAX_US), 1);
+    if (EFI_ERROR(gBS->SetTimer(mSleepEvent, TimerRelative, MultU64x32(SleepUs, 10)))) {
+        return;
+    }
+
+    // ERRI is only a summary, the individual errors are what raise the interrupt
+    SignalMask = Mask & ~ERRI;
+    if (Mask & ERRI) {
+        SignalMask |= ALL_ERR_SIGEN;
+    }
+
+    ArmDisableInterrupts();
+    if ((MmioRead32(MMCHS_INT_STAT) & Mask) == 0) {
+        MmioWrite32(MMCHS_ISE, SignalMask);
+        ArmCallWFI();
+    }
+    ArmEnableInterrupts();
+
+    MmioWrite32(MMCHS_ISE, 0);
+    gBS->SetTimer(mSleepEvent, TimerCancel, 0);
+}
+
+/**
+  Waits until one of the Mask bits is set in MMCHS_INT_STAT, MmcStatus receives the last value read
+**/
+EFI_STATUS
+MMCWaitForStatus(
+    IN UINT32 Mask,
+    IN UINT32 TimeoutUs,
+    OUT UINTN *MmcStatus
+    )
+{
+    UINT64 Deadline = MMCDeadline(TimeoutUs);
+
+    for (;;) {
+        *MmcStatus = MmioRead32(MMCHS_INT_STAT);
+        if (*MmcStatus & Mask) {
+            return EFI_SUCCESS;
+        }
+
+        if (MMCIsExpired(Deadline)) {
+            return EFI_TIMEOUT;
+        }
+
+        MMCSleepOnStatus(Mask, Deadline);
+    }
+}
+
 /**
-  Repeatedly polls a register until its value becomes correct, or until MAX_RETRY_COUNT polls is reached
+  Polls a register until its value becomes correct, or until STATUS_TIMEOUT_US elapses
 **/
 EFI_STATUS
 PollRegisterWithMask(
@@ -165,19 +333,17 @@ PollRegisterWithMask(
     IN UINTN ExpectedValue
     )
 {
-    UINTN RetryCount = 0;
+    UINT64 Deadline = MMCDeadline(STATUS_TIMEOUT_US);
 
-    while (RetryCount < MAX_RETRY_COUNT) {
-        if ((MmioRead32(Register) & Mask) != ExpectedValue) {
-            RetryCount++;
-            gBS->Stall(STALL_AFTER_RETRY_US);
-        } else {
-            break;
+    while ((MmioRead32(Register) & Mask) != ExpectedValue) {
+        if (MMCIsExpired(Deadline)) {
+            return EFI_TIMEOUT;
         }
-    }
 
-    if (RetryCount == MAX_RETRY_COUNT) {
-        return EFI_TIMEOUT;
+        // The command and data lines are released along with CC and TC
+        if (Register == MMCHS_PRES_STATE) {
+            MMCSleepOnStatus(CC | TC, Deadline);
+        }
     }
 
     return EFI_SUCCESS;
@@ -411,25 +577,20 @@ MMCBuildDevicePath(
     return EFI_SUCCESS;
 }
 
+/**
+  Issues an already translated command, TransferFlags go along in the Transfer Mode half of MMCHS_CMD
+**/
 EFI_STATUS
-MMCSendCommand(
-    IN EFI_MMC_HOST_PROTOCOL    *This,
-    IN MMC_CMD                  MmcCmd,
-    IN UINT32                   Argument
+MMCIssueCommand(
+    IN UINT32                   MmcCmd,
+    IN UINT32                   Argument,
+    IN UINT32                   TransferFlags
     )
 {
+    EFI_STATUS Status;
     UINTN MmcStatus;
-    UINTN RetryCount = 0;
     UINTN CmdSendOKMask;
 
-    DEBUG((DEBUG_MMCHOST_SD, "ArasanMMCHost: MMCSendCommand(MmcCmd: %08x, Argument: %08x)\n", MmcCmd, Argument));
-
-    if (IgnoreCommand(MmcCmd)) {
-        return EFI_SUCCESS;
-    }
-
-    MmcCmd = TranslateCommand(MmcCmd);
-
     // Check if command and data lines are in use or not. Poll till both lines are available
     // However, for CMD12 (Stop Transmission), no need to wait for data line to be available
     if (MmcCmd == CMD_STOP_TRANSMISSION) {
@@ -453,7 +614,8 @@ MMCSendCommand(
 
     // Provide (Block Count << 16 | Block Size)
     // CMD23 (SET_BLOCK_COUNT) is sent before CMD18 (READ_MULTIPLE_BLOCK),
-    // and sets the number of blocks to read in CMD18
+    // and sets the number of blocks to read in CMD18. ACMD23 (SET_WR_BLK_ERASE_COUNT)
+    // shares the same index and is sent before CMD25 (WRITE_MULTIPLE_BLOCK)
     if (MmcCmd == CMD_SET_BLOCK_COUNT) {
         MmioWrite32(MMCHS_BLK, Argument << BLOCK_COUNT_SHIFT | BLEN_512BYTES);
     }
@@ -493,44 +655,61 @@ MMCSendCommand(
     }
 
     // Send the command
-    MmioWrite32(MMCHS_CMD, MmcCmd);
+    MmioWrite32(MMCHS_CMD, MmcCmd | TransferFlags);
 
-    // Check for the command status.
-    while (RetryCount < MAX_RETRY_COUNT) {
-        MmcStatus = MmioRead32(MMCHS_INT_STAT);
-
-        // Read status of command response
-        if ((MmcStatus & ERRI) != 0) {
-            // Perform soft-reset for mmci_cmd line.
-            MmioOr32(MMCHS_SYSCTL, SRC);
-            while ((MmioRead32(MMCHS_SYSCTL) & SRC));
+    // Wait for the command status.
+    Status = MMCWaitForStatus(CC | ERRI, STATUS_TIMEOUT_US, &MmcStatus);
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCSendCommand(): TIMEOUT: No response for Send Command\n"));
+        return EFI_TIMEOUT;
+    }
 
-            // CMD5 (CMD_IO_SEND_OP_COND) is only valid for SDIO cards and thus expected to fail
-            if (MmcCmd != CMD_IO_SEND_OP_COND) {
-                DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCSendCommand(): ERROR in Pres Status Reg: %08x\n", MmcStatus));
-            }
+    // Read status of command response
+    if ((MmcStatus & ERRI) != 0) {
+        // Perform soft-reset for mmci_cmd line.
+        MmioOr32(MMCHS_SYSCTL, SRC);
+        while ((MmioRead32(MMCHS_SYSCTL) & SRC));
 
-            return EFI_DEVICE_ERROR;
+        // CMD5 (CMD_IO_SEND_OP_COND) is only valid for SDIO cards and thus expected to fail
+        if (MmcCmd != CMD_IO_SEND_OP_COND) {
+            DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCSendCommand(): ERROR in Pres Status Reg: %08x\n", MmcStatus));
         }
 
-        // Check if command is completed.
-        if ((MmcStatus & CC) == CC) {
-            MmioWrite32(MMCHS_INT_STAT, CC);
-            break;
-        }
+        return EFI_DEVICE_ERROR;
+    }
+
+    MmioWrite32(MMCHS_INT_STAT, CC);
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+MMCSendCommand(
+    IN EFI_MMC_HOST_PROTOCOL    *This,
+    IN MMC_CMD                  MmcCmd,
+    IN UINT32                   Argument
+    )
+{
+    DEBUG((DEBUG_MMCHOST_SD, "ArasanMMCHost: MMCSendCommand(MmcCmd: %08x, Argument: %08x)\n", MmcCmd, Argument));
 
-        RetryCount++;
-        gBS->Stall(STALL_AFTER_RETRY_US);
+    if (IgnoreCommand(MmcCmd)) {
+        return EFI_SUCCESS;
     }
 
-    gBS->Stall(STALL_AFTER_SEND_CMD_US);
+    MmcCmd = TranslateCommand(MmcCmd);
 
-    if (RetryCount == MAX_RETRY_COUNT) {
-        DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCSendCommand(): TIMEOUT: No response for Send Command\n"));
-        return EFI_TIMEOUT;
+    mIsDataCmdPending = FALSE;
+
+    if (mAdmaEnabled &&
+        (MmcCmd == CMD_READ_SINGLE_BLOCK || MmcCmd == CMD_READ_MULTIPLE_BLOCK ||
+         MmcCmd == CMD_WRITE_SINGLE_BLOCK || MmcCmd == CMD_WRITE_MULTIPLE_BLOCK)) {
+        mIsDataCmdPending = TRUE;
+        mPendingDataCmd = MmcCmd;
+        mPendingDataCmdArgument = Argument;
+        return EFI_SUCCESS;
     }
 
-    return EFI_SUCCESS;
+    return MMCIssueCommand(MmcCmd, Argument, 0);
 }
 
 EFI_STATUS
@@ -565,6 +744,10 @@ MMCNotifyState(
 
         // Enable interrupts
         MmioWrite32(MMCHS_IE, ALL_EN);
+
+        if (mAdmaEnabled) {
+            MmioAndThenOr32(MMCHS_HCTL, ~DMAS_MASK, DMAS_ADMA2);
+        }
     }
     break;
     case MmcIdleState:
@@ -709,10 +892,164 @@ MMCReceiveResponse(
         MBRGPTWorkaroundReceivedCmdSendCSD = FALSE;
     }
 
-    gBS->Stall(STALL_AFTER_REC_RESP_US);
     return EFI_SUCCESS;
 }
 
+/**
+  Moves Length bytes through MMCHS_DATA one block per BRR/BWR
+**/
+EFI_STATUS
+MMCPioTransfer(
+    IN BOOLEAN                  IsRead,
+    IN UINTN                    Length,
+    IN UINT32*                  Buffer
+    )
+{
+    EFI_STATUS Status;
+    UINTN MmcStatus = 0;
+    UINTN Count;
+    UINTN BlockIdx;
+    UINTN ReadyMask = IsRead ? BRR : BWR;
+
+    for (BlockIdx = 0; BlockIdx < Length / BLEN_512BYTES; BlockIdx++) {
+        // Wait for Buffer Read/Write Ready (BRR/BWR)
+        Status = MMCWaitForStatus(ReadyMask | ERRI, STATUS_TIMEOUT_US, &MmcStatus);
+        if (EFI_ERROR(Status) || ((MmcStatus & ReadyMask) == 0)) {
+            DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCPioTransfer(): %a waiting for %a, MMCHS_INT_STAT: %08x\n",
+                   (EFI_ERROR(Status) ? "TIMEOUT" : "ERROR"), (IsRead ? "BRR" : "BWR"), MmcStatus));
+            return EFI_ERROR(Status) ? Status : EFI_DEVICE_ERROR;
+        }
+
+        // Clear BRR/BWR bit
+        MmioWrite32(MMCHS_INT_STAT, ReadyMask);
+
+        if (IsRead) {
+            for (Count = 0; Count < BLEN_512BYTES / 4; Count++) {
+                *Buffer++ = MmioRead32(MMCHS_DATA);
+            }
+        } else {
+            for (Count = 0; Count < BLEN_512BYTES / 4; Count++) {
+                MmioWrite32(MMCHS_DATA, *Buffer++);
+            }
+        }
+    }
+
+    // No need to let the card settle here, the next command waits for the
+    // data line to be released, which covers the write busy time
+    return EFI_SUCCESS;
+}
+
+/**
+  Issues the pending block data command and lets the ADMA2 engine move the whole
+  request, completion is reported by the TC status bit
+**/
+EFI_STATUS
+MMCAdmaTransfer(
+    IN BOOLEAN                  IsRead,
+    IN UINTN                    Length,
+    IN UINT32*                  Buffer
+    )
+{
+    EFI_STATUS Status;
+    EFI_PHYSICAL_ADDRESS DeviceAddress;
+    VOID *Mapping;
+    UINTN MappedLength = Length;
+    UINTN MmcStatus = 0;
+    UINTN Offset;
+    UINTN DescIdx;
+
+    Status = DmaMap(
+        (IsRead ? MapOperationBusMasterWrite : MapOperationBusMasterRead),
+        Buffer,
+        &MappedLength,
+        &DeviceAddress,
+        &Mapping);
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCAdmaTransfer(): DmaMap failed. %r\n", Status));
+        return Status;
+    }
+    ASSERT(MappedLength == Length);
+
+    for (Offset = 0, DescIdx = 0; Offset < Length; DescIdx++) {
+        UINTN DescLength = MIN(Length - Offset, ADMA2_MAX_DESC_LENGTH);
+
+        mAdmaDescriptors[DescIdx].Attributes = ADMA2_VALID | ADMA2_ACT_TRAN;
+        mAdmaDescriptors[DescIdx].Length = (UINT16)DescLength;
+        mAdmaDescriptors[DescIdx].Address = ((UINT32)DeviceAddress + Offset) | UNCACHED_ADDRESS_MASK;
+
+        Offset += DescLength;
+        if (Offset == Length) {
+            mAdmaDescriptors[DescIdx].Attributes |= ADMA2_END;
+        }
+    }
+
+    // Make sure the descriptors reached memory before the controller fetches them
+    ArmDataSyncronizationBarrier();
+
+    MmioWrite32(MMCHS_ADMA_SAR, (UINT32)(UINTN)mAdmaDescriptors | UNCACHED_ADDRESS_MASK);
+    MmioWrite32(MMCHS_BLK, (Length / BLEN_512BYTES) << BLOCK_COUNT_SHIFT | BLEN_512BYTES);
+
+    Status = MMCIssueCommand(mPendingDataCmd, mPendingDataCmdArgument, DE_ENABLE);
+    if (!EFI_ERROR(Status)) {
+        Status = MMCWaitForStatus(TC | ERRI | ADMAE, ADMA_TRANSFER_TIMEOUT_US, &MmcStatus);
+        if (EFI_ERROR(Status)) {
+            DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCAdmaTransfer(): TIMEOUT waiting for TC, MMCHS_INT_STAT: %08x\n",
+                   MmcStatus));
+        } else if (MmcStatus & (ERRI | ADMAE)) {
+            DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCAdmaTransfer(): ERROR MMCHS_INT_STAT: %08x, ADMA_ES: %08x\n",
+                   MmcStatus, MmioRead32(MMCHS_ADMA_ES)));
+            Status = EFI_DEVICE_ERROR;
+        } else {
+            MmioWrite32(MMCHS_INT_STAT, TC | DMAI);
+        }
+
+        if (EFI_ERROR(Status)) {
+            // Perform soft-reset for mmci_dat line.
+            MmioOr32(MMCHS_SYSCTL, SRD);
+            while ((MmioRead32(MMCHS_SYSCTL) & SRD));
+        }
+    }
+
+    DmaUnmap(Mapping);
+
+    return Status;
+}
+
+/**
+  Runs the data phase of a block data command, held back by MMCSendCommand() in ADMA2 mode
+**/
+EFI_STATUS
+MMCTransferBlockData(
+    IN BOOLEAN                  IsRead,
+    IN UINTN                    Length,
+    IN UINT32*                  Buffer
+    )
+{
+    EFI_STATUS Status;
+
+    if (!mIsDataCmdPending) {
+        return MMCPioTransfer(IsRead, Length, Buffer);
+    }
+
+    mIsDataCmdPending = FALSE;
+
+    // ADMA2 can only address 32-bit aligned buffers
+    if ((((UINTN)Buffer & 0x3) == 0) && (Length <= ADMA_MAX_TRANSFER_LENGTH)) {
+        return MMCAdmaTransfer(IsRead, Length, Buffer);
+    }
+
+    if (mPendingDataCmd == CMD_READ_MULTIPLE_BLOCK || mPendingDataCmd == CMD_WRITE_MULTIPLE_BLOCK) {
+        MmioWrite32(MMCHS_BLK, (Length / BLEN_512BYTES) << BLOCK_COUNT_SHIFT | BLEN_512BYTES);
+    }
+
+    Status = MMCIssueCommand(mPendingDataCmd, mPendingDataCmdArgument, 0);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    return MMCPioTransfer(IsRead, Length, Buffer);
+}
+
 EFI_STATUS
 MMCReadBlockData(
     IN EFI_MMC_HOST_PROTOCOL    *This,
@@ -721,9 +1058,7 @@ MMCReadBlockData(
     IN UINT32*                  Buffer
     )
 {
-    UINTN MmcStatus;
-    UINTN Count;
-    UINTN RetryCount = 0;
+    EFI_STATUS Status;
 
     // Make DebugPrints more manageable
     if (Lba % 2000 == 0) {
@@ -742,39 +1077,10 @@ MMCReadBlockData(
     }
 
     LedSetOk(TRUE);
-    {
-        while (RetryCount < MAX_RETRY_COUNT) {
-            // Read Status
-            MmcStatus = MmioRead32(MMCHS_INT_STAT);
-
-            // Check if Buffer Read Ready (BRR) bit is set
-            if (MmcStatus & BRR) {
-                // Clear BRR bit
-                MmioWrite32(MMCHS_INT_STAT, BRR);
-
-                for (Count = 0; Count < Length / 4; Count++) {
-                    UINT32 data = MmioRead32(MMCHS_DATA);
-                    Buffer[Count] = data;
-                }
-
-                break;
-            }
-
-            gBS->Stall(STALL_AFTER_RETRY_US);
-            RetryCount++;
-        }
-
-        gBS->Stall(STALL_AFTER_READ_US);
-    }
+    Status = MMCTransferBlockData(TRUE, Length, Buffer);
     LedSetOk(FALSE);
 
-    if (RetryCount == MAX_RETRY_COUNT) {
-        DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCReadBlockData(): TIMEOUT waiting for BRR, MMCHS_INT_STAT: %08x\n",
-               MmcStatus));
-        return EFI_TIMEOUT;
-    }
-
-    return EFI_SUCCESS;
+    return Status;
 }
 
 EFI_STATUS
@@ -785,9 +1091,7 @@ MMCWriteBlockData(
     IN UINT32*                  Buffer
     )
 {
-    UINTN MmcStatus;
-    UINTN Count;
-    UINTN RetryCount = 0;
+    EFI_STATUS Status;
 
     DEBUG((DEBUG_MMCHOST_SD, "ArasanMMCHost: MMCWriteBlockData(LBA: 0x%x, Length: 0x%x, Buffer: 0x%x)\n",
            Lba, Length, Buffer));
@@ -803,38 +1107,19 @@ MMCWriteBlockData(
     }
 
     LedSetOk(TRUE);
-    {
-        while (RetryCount < MAX_RETRY_COUNT) {
-            // Read Status
-            MmcStatus = MmioRead32(MMCHS_INT_STAT);
-
-            // Check if Buffer Write Ready (BWR) bit is set
-            if (MmcStatus & BWR) {
-                // Clear BWR bit
-                MmioWrite32(MMCHS_INT_STAT, BWR);
-
-                for (Count = 0; Count < Length / 4; Count++) {
-                    MmioWrite32(MMCHS_DATA, Buffer[Count]);
-                }
-
-                break;
-            }
-
-            gBS->Stall(STALL_AFTER_RETRY_US);
-            RetryCount++;
-        }
-
-        gBS->Stall(STALL_AFTER_WRITE_US);
-    }
+    Status = MMCTransferBlockData(FALSE, Length, Buffer);
     LedSetOk(FALSE);
 
-    if (RetryCount == MAX_RETRY_COUNT) {
-        DEBUG((DEBUG_ERROR, "ArasanMMCHost: MMCWriteBlockData(): TIMEOUT waiting for BWR, MMCHS_INT_STAT: %08x\n",
-               MmcStatus));
-        return EFI_TIMEOUT;
-    }
+    return Status;
+}
 
-    return EFI_SUCCESS;
+BOOLEAN
+MMCIsMultiBlock(
+    IN EFI_MMC_HOST_PROTOCOL *This
+    )
+{
+    // Only the ADMA2 path takes the data of a whole multiple block transfer at once
+    return mAdmaEnabled;
 }
 
 EFI_MMC_HOST_PROTOCOL gMMCHost =
@@ -847,7 +1132,8 @@ EFI_MMC_HOST_PROTOCOL gMMCHost =
     MMCSendCommand,
     MMCReceiveResponse,
     MMCReadBlockData,
-    MMCWriteBlockData
+    MMCWriteBlockData,
+    MMCIsMultiBlock
 };
 
 EFI_STATUS
@@ -877,6 +1163,42 @@ MMCInitialize(
         ASSERT(0);
     }
 
+    if (FixedPcdGetBool(PcdArasanAdmaEnabled)) {
+        if ((MmioRead32(MMCHS_CAPA) & ADMA2S) == 0) {
+            DEBUG((DEBUG_ERROR, "ArasanMMCHost: ADMA2 not supported by the controller, using PIO\n"));
+        } else if (EFI_ERROR(DmaAllocateBuffer(EfiBootServicesData, 1, (VOID**)&mAdmaDescriptors)) ||
+                   (mAdmaDescriptors == NULL)) {
+            DEBUG((DEBUG_ERROR, "ArasanMMCHost: Failed to allocate the ADMA2 descriptor table, using PIO\n"));
+        } else {
+            mAdmaEnabled = TRUE;
+        }
+    }
+
+    // Without the interrupt the status waits simply poll
+    MmioWrite32(MMCHS_ISE, 0);
+    if (!EFI_ERROR(gBS->LocateProtocol(&gHardwareInterruptProtocolGuid, NULL, (VOID**)&mInterrupt)) &&
+        !EFI_ERROR(mInterrupt->RegisterInterruptSource(
+            mInterrupt,
+            INT_GPU_SOURCE(INT_GPU_IRQ_ARASAN),
+            MMCInterruptHandler))) {
+        mIrqRegistered = TRUE;
+    } else {
+        DEBUG((DEBUG_ERROR, "ArasanMMCHost: Failed to register the controller interrupt, polling only\n"));
+    }
+
+    // TPL_NOTIFY, ahead of the TPL_CALLBACK handlers that may still flush to the card
+    if (mIrqRegistered &&
+        (EFI_ERROR(gBS->CreateEvent(
+            EVT_SIGNAL_EXIT_BOOT_SERVICES,
+            TPL_NOTIFY,
+            MMCExitBootServices,
+            NULL,
+            &mExitBootServicesEvent)) ||
+         EFI_ERROR(gBS->CreateEvent(EVT_TIMER, 0, NULL, NULL, &mSleepEvent)))) {
+        DEBUG((DEBUG_ERROR, "ArasanMMCHost: Failed to create the sleep events, polling only\n"));
+        mIrqRegistered = FALSE;
+    }
+
     // Init the LED to use as a disk access indicator
     LedInit();
 
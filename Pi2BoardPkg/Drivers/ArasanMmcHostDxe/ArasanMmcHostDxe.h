@@ -26,22 +26,24 @@
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DmaLib.h>
+#include <Library/ArmLib.h>
+#include <Library/TimerLib.h>
 
 #include <Protocol/EmbeddedExternalDevice.h>
 #include <Protocol/BlockIo.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/MmcHost.h>
+#include <Protocol/HardwareInterrupt.h>
 
 #include <LedLib.h>
 #include <Bcm2836.h>
 
-#define MAX_RETRY_COUNT (1000 * 20)
+#define STATUS_TIMEOUT_US (400 * 1000) // in microseconds
+#define SLEEP_MAX_US (10 * 1000) // in microseconds, sleeps also wake up on their own
 
-#define STALL_AFTER_SEND_CMD_US (200) // in microseconds
-#define STALL_AFTER_REC_RESP_US (50)
-#define STALL_AFTER_WRITE_US (200)
-#define STALL_AFTER_READ_US (20)
-#define STALL_AFTER_RETRY_US (20)
+#define ADMA_TRANSFER_TIMEOUT_US (5 * 1000 * 1000)
+#define ADMA_MAX_DESC_COUNT (EFI_PAGE_SIZE / sizeof(ADMA2_DESCRIPTOR))
+#define ADMA_MAX_TRANSFER_LENGTH (ADMA_MAX_DESC_COUNT * ADMA2_MAX_DESC_LENGTH)
 
 #define HC_MMC_CSD_GET_DEVICESIZE(Response)    ((Response[1] >> 16) | ((Response[2] & 0x3F) << 16));
 
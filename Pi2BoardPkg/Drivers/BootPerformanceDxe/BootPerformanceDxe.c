@@ -0,0 +1,200 @@
+/** @file
+*
+*  Publishes the PERF_START()/PERF_END() measurements of PrePi and the DXE
+*  phase in the ACPI FPDT.
+*
+*  At ReadyToBoot, once FirmwarePerformanceDxe installed the FPDT, every
+*  measurement logged so far is reported as a BOOT_PERFORMANCE_GAUGE_RECORD
+*  through the status code of FirmwarePerformanceDxe, which appends the records
+*  to the Firmware Basic Boot Performance Table. They have to fit in the
+*  PcdExtFpdtBootRecordPadSize bytes it reserves for that. The same
+*  measurements are shown by Dp from the shell.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <PiDxe.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/PcdLib.h>
+#include <Library/PerformanceLib.h>
+#include <Library/ReportStatusCodeLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Guid/EventGroup.h>
+#include <Guid/FirmwarePerformance.h>
+#include <Protocol/LoadedImage.h>
+
+#include <BootPerformanceRecord.h>
+
+// Records per status code, the DXE report status code library carries up to
+// 0x200 bytes of extended data
+#define BOOT_PERFORMANCE_RECORDS_PER_REPORT     4
+
+STATIC EFI_EVENT mReadyToBootEvent;
+
+/**
+  Returns the file GUID of the image a measurement belongs to, zeros if the
+  handle isn't that of an image loaded from a firmware volume
+**/
+STATIC
+VOID
+BootPerformanceGetFileGuid(
+    IN  CONST VOID  *Handle,
+    OUT EFI_GUID    *FileGuid
+    )
+{
+    EFI_STATUS Status;
+    EFI_LOADED_IMAGE_PROTOCOL *LoadedImage;
+    EFI_GUID *NameGuid;
+
+    ZeroMem(FileGuid, sizeof(*FileGuid));
+
+    if (Handle == NULL) {
+        return;
+    }
+
+    Status = gBS->HandleProtocol((EFI_HANDLE)Handle, &gEfiLoadedImageProtocolGuid, (VOID**)&LoadedImage);
+    if (EFI_ERROR(Status) || (LoadedImage->FilePath == NULL)) {
+        return;
+    }
+
+    NameGuid = EfiGetNameGuidFromFwVolDevicePathNode(
+        (CONST MEDIA_FW_VOL_FILEPATH_DEVICE_PATH*)LoadedImage->FilePath);
+    if (NameGuid != NULL) {
+        CopyGuid(FileGuid, NameGuid);
+    }
+}
+
+STATIC
+VOID
+BootPerformanceReport(
+    IN BOOT_PERFORMANCE_GAUGE_RECORD    *Records,
+    IN UINTN                            Count
+    )
+{
+    REPORT_STATUS_CODE_EX(
+        EFI_PROGRESS_CODE,
+        EFI_SOFTWARE_DXE_BS_DRIVER,
+        0,
+        NULL,
+        &gEfiFirmwarePerformanceGuid,
+        Records,
+        Count * sizeof(*Records));
+}
+
+VOID
+EFIAPI
+BootPerformanceReadyToBoot(
+    IN EFI_EVENT    Event,
+    IN VOID         *Context
+    )
+{
+    BOOT_PERFORMANCE_GAUGE_RECORD Records[BOOT_PERFORMANCE_RECORDS_PER_REPORT];
+    BOOT_PERFORMANCE_GAUGE_RECORD *Record;
+    UINTN Count;
+    UINTN Reported;
+    UINTN MaxRecords;
+    UINTN Dropped;
+    UINTN LogEntryKey;
+    CONST VOID *Handle;
+    CONST CHAR8 *Token;
+    CONST CHAR8 *Module;
+    UINT64 StartTimeStamp;
+    UINT64 EndTimeStamp;
+    UINT32 Identifier;
+
+    // Only the first boot attempt is recorded
+    gBS->CloseEvent(mReadyToBootEvent);
+
+    MaxRecords = PcdGet32(PcdExtFpdtBootRecordPadSize) / sizeof(BOOT_PERFORMANCE_GAUGE_RECORD);
+    Count = 0;
+    Reported = 0;
+    Dropped = 0;
+
+    LogEntryKey = 0;
+    while ((LogEntryKey = GetPerformanceMeasurementEx(
+                LogEntryKey,
+                &Handle,
+                &Token,
+                &Module,
+                &StartTimeStamp,
+                &EndTimeStamp,
+                &Identifier)) != 0) {
+
+        if (Reported + Count >= MaxRecords) {
+            ++Dropped;
+            continue;
+        }
+
+        Record = &Records[Count++];
+        ZeroMem(Record, sizeof(*Record));
+        Record->Header.Type = BOOT_PERFORMANCE_GAUGE_RECORD_TYPE;
+        Record->Header.Length = sizeof(*Record);
+        Record->Header.Revision = BOOT_PERFORMANCE_GAUGE_RECORD_REVISION;
+        Record->Identifier = Identifier;
+        Record->StartTime = GetTimeInNanoSecond(StartTimeStamp);
+        Record->EndTime = (EndTimeStamp != 0) ? GetTimeInNanoSecond(EndTimeStamp) : 0;
+        BootPerformanceGetFileGuid(Handle, &Record->FileGuid);
+        if (Token != NULL) {
+            AsciiStrnCpy(Record->Token, Token, sizeof(Record->Token) - 1);
+        }
+        if (Module != NULL) {
+            AsciiStrnCpy(Record->Module, Module, sizeof(Record->Module) - 1);
+        }
+
+        if (Count == BOOT_PERFORMANCE_RECORDS_PER_REPORT) {
+            BootPerformanceReport(Records, Count);
+            Reported += Count;
+            Count = 0;
+        }
+    }
+
+    if (Count != 0) {
+        BootPerformanceReport(Records, Count);
+        Reported += Count;
+    }
+
+    DEBUG((DEBUG_INFO, "BootPerformanceDxe: %d measurements added to the FPDT\n", Reported));
+    if (Dropped != 0) {
+        DEBUG((
+            DEBUG_WARN,
+            "BootPerformanceDxe: %d measurements dropped, increase PcdExtFpdtBootRecordPadSize\n",
+            Dropped));
+    }
+}
+
+EFI_STATUS
+EFIAPI
+BootPerformanceInitialize(
+    IN EFI_HANDLE           ImageHandle,
+    IN EFI_SYSTEM_TABLE     *SystemTable
+    )
+{
+    if (!PerformanceMeasurementEnabled()) {
+        return EFI_UNSUPPORTED;
+    }
+
+    // FirmwarePerformanceDxe installs the FPDT at TPL_NOTIFY, the records are
+    // appended afterwards
+    return gBS->CreateEventEx(
+        EVT_NOTIFY_SIGNAL,
+        TPL_CALLBACK,
+        BootPerformanceReadyToBoot,
+        NULL,
+        &gEfiEventReadyToBootGuid,
+        &mReadyToBootEvent);
+}
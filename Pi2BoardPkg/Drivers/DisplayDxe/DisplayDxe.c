@@ -25,9 +25,12 @@
 #include <Library/IoLib.h>
 #include <Library/TimerLib.h>
 #include <Library/CacheMaintenanceLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Protocol/GraphicsOutput.h>
 #include <Protocol/DevicePath.h>
+#include <Guid/EventGroup.h>
 
+#include "DisplayDxe.h"
 
 typedef struct {
     VENDOR_DEVICE_PATH DisplayDevicePath;
@@ -57,12 +60,6 @@ DISPLAY_DEVICE_PATH gDisplayDevicePath =
     }
 };
 
-#define PI2_BITS_PER_PIXEL              (32)
-#define PI2_BYTES_PER_PIXEL             (PI2_BITS_PER_PIXEL / 8)
-
-#define PI2_COLOUR_BITS_PER_PIXEL       (24)
-#define PI2_COLOUR_BYTES_PER_PIXEL      (PI2_COLOUR_BITS_PER_PIXEL / 8)
-
 //
 // Use the mailbox framebuffer channel mechanism to request a frame buffer
 // Return non-zero for success
@@ -162,6 +159,160 @@ EFI_GRAPHICS_OUTPUT_PROTOCOL gDisplay = {
   NULL
 };
 
+// Resolutions offered on top of the native one, when they fit in it
+STATIC CONST DISPLAY_MODE mStandardModes[] = {
+    { 1920, 1080 },
+    { 1280, 1024 },
+    { 1280, 720 },
+    { 1024, 768 },
+    { 800, 600 },
+    { 640, 480 }
+};
+
+DISPLAY_MODE mDisplayModes[DISPLAY_MAX_MODES];
+DISPLAY_SHADOW mShadow;
+BOOLEAN mShadowEnabled = FALSE;
+
+// Address of pixel (X, Y) in a buffer laid out like the framebuffer
+#define DISPLAY_PIXEL(Base, Mode, X, Y) \
+    ((UINT32*)((UINTN)(Base) + \
+               ((((Y) * (Mode)->Info->PixelsPerScanLine) + (X)) * PI2_BYTES_PER_PIXEL)))
+
+//
+// Copies the dirty rectangles of the shadow buffer to the framebuffer,
+// must be called at TPL_NOTIFY
+//
+VOID
+DisplayFlushShadow(
+    IN  EFI_GRAPHICS_OUTPUT_PROTOCOL    *This
+    )
+{
+    DISPLAY_RECT *Rect;
+    UINTN RectIdx;
+    UINTN i;
+
+    for (RectIdx = 0; RectIdx < mShadow.DirtyCount; RectIdx++) {
+        Rect = &mShadow.Dirty[RectIdx];
+        for (i = 0; i < Rect->Height; i++) {
+            DisplayCopyLine32(
+                DISPLAY_PIXEL(This->Mode->FrameBufferBase, This->Mode, Rect->X, Rect->Y + i),
+                DISPLAY_PIXEL(mShadow.Buffer, This->Mode, Rect->X, Rect->Y + i),
+                Rect->Width);
+        }
+    }
+
+    mShadow.DirtyCount = 0;
+}
+
+VOID
+DisplayUnionRect(
+    IN OUT  DISPLAY_RECT    *Rect,
+    IN      DISPLAY_RECT    *Other
+    )
+{
+    UINTN Right = MAX(Rect->X + Rect->Width, Other->X + Other->Width);
+    UINTN Bottom = MAX(Rect->Y + Rect->Height, Other->Y + Other->Height);
+
+    Rect->X = MIN(Rect->X, Other->X);
+    Rect->Y = MIN(Rect->Y, Other->Y);
+    Rect->Width = Right - Rect->X;
+    Rect->Height = Bottom - Rect->Y;
+}
+
+//
+// Records a rectangle of the shadow buffer that has to be flushed. Touching or
+// overlapping rectangles are merged, and once the list is full everything is
+// merged into a single bounding rectangle
+//
+VOID
+DisplayAddDirtyRect(
+    IN  UINTN   X,
+    IN  UINTN   Y,
+    IN  UINTN   Width,
+    IN  UINTN   Height
+    )
+{
+    DISPLAY_RECT NewRect = { X, Y, Width, Height };
+    DISPLAY_RECT *Rect;
+    UINTN RectIdx;
+
+    for (RectIdx = 0; RectIdx < mShadow.DirtyCount; RectIdx++) {
+        Rect = &mShadow.Dirty[RectIdx];
+        if ((NewRect.X <= Rect->X + Rect->Width) && (Rect->X <= NewRect.X + NewRect.Width) &&
+            (NewRect.Y <= Rect->Y + Rect->Height) && (Rect->Y <= NewRect.Y + NewRect.Height)) {
+            DisplayUnionRect(Rect, &NewRect);
+            return;
+        }
+    }
+
+    if (mShadow.DirtyCount < DISPLAY_MAX_DIRTY_RECTS) {
+        mShadow.Dirty[mShadow.DirtyCount++] = NewRect;
+        return;
+    }
+
+    for (RectIdx = 1; RectIdx < mShadow.DirtyCount; RectIdx++) {
+        DisplayUnionRect(&mShadow.Dirty[0], &mShadow.Dirty[RectIdx]);
+    }
+    DisplayUnionRect(&mShadow.Dirty[0], &NewRect);
+    mShadow.DirtyCount = 1;
+}
+
+VOID
+EFIAPI
+DisplayFlushTimerCallback(
+    IN  EFI_EVENT   Event,
+    IN  VOID        *Context
+    )
+{
+    DisplayFlushShadow((EFI_GRAPHICS_OUTPUT_PROTOCOL*)Context);
+}
+
+VOID
+EFIAPI
+DisplayExitBootServicesCallback(
+    IN  EFI_EVENT   Event,
+    IN  VOID        *Context
+    )
+{
+    // The OS takes the framebuffer over as it is, make sure it is up to date
+    if (mShadow.FlushEvent != NULL) {
+        gBS->SetTimer(mShadow.FlushEvent, TimerCancel, 0);
+    }
+    DisplayFlushShadow((EFI_GRAPHICS_OUTPUT_PROTOCOL*)Context);
+    mShadowEnabled = FALSE;
+}
+
+//
+// (Re)allocates the shadow buffer for the current mode, a failure only
+// disables the shadow buffer
+//
+VOID
+DisplayAllocateShadow(
+    IN  EFI_GRAPHICS_OUTPUT_PROTOCOL    *This
+    )
+{
+    UINTN Pages;
+
+    Pages = EFI_SIZE_TO_PAGES(This->Mode->FrameBufferSize);
+    if ((mShadow.Buffer != NULL) && (mShadow.Pages != Pages)) {
+        FreePages(mShadow.Buffer, mShadow.Pages);
+        mShadow.Buffer = NULL;
+    }
+
+    if (mShadow.Buffer == NULL) {
+        mShadow.Buffer = AllocatePages(Pages);
+        mShadow.Pages = Pages;
+    }
+
+    if (mShadow.Buffer == NULL) {
+        DEBUG((DEBUG_ERROR, "DisplayDxe: Failed to allocate the shadow framebuffer\n"));
+        mShadowEnabled = FALSE;
+        return;
+    }
+
+    mShadow.DirtyCount = 0;
+    SetMem32(mShadow.Buffer, This->Mode->FrameBufferSize, PI2_ALPHA_MASK);
+}
 
 EFI_STATUS
 EFIAPI
@@ -174,20 +325,32 @@ DisplayQueryMode(
 {
     EFI_STATUS Status;
 
+    if ((SizeOfInfo == NULL) || (Info == NULL) || (ModeNumber >= This->Mode->MaxMode)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
     Status = gBS->AllocatePool(
                     EfiBootServicesData,
                     sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION),
                     (VOID **)Info
                     );
-    ASSERT_EFI_ERROR(Status);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
 
     *SizeOfInfo = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
 
-    (*Info)->Version = This->Mode->Info->Version;
-    (*Info)->HorizontalResolution = This->Mode->Info->HorizontalResolution;
-    (*Info)->VerticalResolution = This->Mode->Info->VerticalResolution;
-    (*Info)->PixelFormat = This->Mode->Info->PixelFormat;
-    (*Info)->PixelsPerScanLine = This->Mode->Info->PixelsPerScanLine;
+    if (ModeNumber == This->Mode->Mode) {
+        CopyMem(*Info, This->Mode->Info, sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION));
+        return EFI_SUCCESS;
+    }
+
+    // The pitch of a mode is only known once the GPU has allocated its framebuffer
+    (*Info)->Version = 0;
+    (*Info)->HorizontalResolution = mDisplayModes[ModeNumber].Width;
+    (*Info)->VerticalResolution = mDisplayModes[ModeNumber].Height;
+    (*Info)->PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
+    (*Info)->PixelsPerScanLine = mDisplayModes[ModeNumber].Width;
 
     return EFI_SUCCESS;
 }
@@ -199,6 +362,61 @@ DisplaySetMode(
     IN  UINT32                       ModeNumber
     )
 {
+    MAILBOX_FRAMEBUFFER MbFb;
+    EFI_TPL OldTpl;
+
+    if (ModeNumber >= This->Mode->MaxMode) {
+        return EFI_UNSUPPORTED;
+    }
+
+    // Have the GPU (re)allocate a frame buffer of the requested size, it scales
+    // it to the display
+    ZeroMem((void*)&MbFb, sizeof(MAILBOX_FRAMEBUFFER));
+    MbFb.mbf_phys_width = MbFb.mbf_virt_width = mDisplayModes[ModeNumber].Width;
+    MbFb.mbf_phys_height = MbFb.mbf_virt_height = mDisplayModes[ModeNumber].Height;
+    MbFb.mbf_depth = PI2_BITS_PER_PIXEL;
+
+    OldTpl = gBS->RaiseTPL(TPL_NOTIFY);
+
+    MailboxTransactFrameBuffer(&MbFb);
+
+    if ((MbFb.mbf_framebuf_addr == 0) || (MbFb.mbf_framebuf_size == 0)) {
+        gBS->RestoreTPL(OldTpl);
+        DEBUG((DEBUG_ERROR, "DisplayDxe: Failed to set mode %d (%dx%d)\n",
+               ModeNumber, mDisplayModes[ModeNumber].Width, mDisplayModes[ModeNumber].Height));
+        return EFI_DEVICE_ERROR;
+    }
+
+    //Applying alpha value to the frame buffer
+    SetMem32((void*)MbFb.mbf_framebuf_addr, MbFb.mbf_framebuf_size, PI2_ALPHA_MASK);
+
+    // Fill out mode information
+    This->Mode->Mode = ModeNumber;
+    This->Mode->Info->Version = 0;
+    // There is no way to communicate pitch back to OS. OS and even UEFI
+    // expects a fully linear frame buffer. So the width should
+    // be based on the frame buffer's pitch value. In some casses VC
+    // firmware would allocate a frame buffer with some padding
+    // presumeably to be 8 byte align.
+    This->Mode->Info->HorizontalResolution = MbFb.mbf_pitch / PI2_BYTES_PER_PIXEL;
+    This->Mode->Info->VerticalResolution = MbFb.mbf_virt_height;
+
+    // NOTE: Windows REQUIRES BGR in 32 or 24 bit format.
+    // TODO: Figure out a way in GOP driver to set the display controller
+    //       to the appropriate pixel format instead of relying on
+    //       framebuffer_ignore_alpha and framebuffer_swap
+    This->Mode->Info->PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
+    This->Mode->Info->PixelsPerScanLine = MbFb.mbf_pitch / PI2_BYTES_PER_PIXEL;
+    This->Mode->SizeOfInfo = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
+    This->Mode->FrameBufferBase = MbFb.mbf_framebuf_addr;
+    This->Mode->FrameBufferSize = MbFb.mbf_framebuf_size;
+
+    if (mShadowEnabled) {
+        DisplayAllocateShadow(This);
+    }
+
+    gBS->RestoreTPL(OldTpl);
+
     return EFI_SUCCESS;
 }
 
@@ -217,77 +435,111 @@ DisplayBlt(
     IN  UINTN                                   Delta         OPTIONAL
     )
 {
-    UINT8 *VidBuf, *BltBuf, *VidBuf1;
-    UINTN i, j;
+    EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE *Mode;
+    UINT32 *VidBuf, *VidBuf1;
+    UINT8 *BltBuf;
+    UINTN VidBase;
+    UINT32 Colour;
+    EFI_TPL OldTpl;
+    UINTN i;
+
+    Mode = This->Mode;
+
+    if ((BltOperation < EfiBltVideoFill) || (BltOperation >= EfiGraphicsOutputBltOperationMax)) {
+        return EFI_INVALID_PARAMETER;
+    }
 
-    switch(BltOperation) {
-    case EfiBltVideoFill:
-        BltBuf = (UINT8 *)BltBuffer;
+    if ((Width == 0) || (Height == 0)) {
+        return EFI_INVALID_PARAMETER;
+    }
 
-        for (i=0;i<Height;i++) {
-            VidBuf = (UINT8 *)((UINT32)This->Mode->FrameBufferBase + \
-                     (DestinationY + i)*This->Mode->Info->PixelsPerScanLine*PI2_BYTES_PER_PIXEL + \
-                     DestinationX*PI2_BYTES_PER_PIXEL);
+    if ((BltBuffer == NULL) && (BltOperation != EfiBltVideoToVideo)) {
+        return EFI_INVALID_PARAMETER;
+    }
 
-            for(j=0;j<Width;j++) {
-                gBS->CopyMem((VOID *)VidBuf, (VOID *)BltBuf, PI2_COLOUR_BYTES_PER_PIXEL);
-                VidBuf += PI2_BYTES_PER_PIXEL;
-            }
+    // Every rectangle on the video side has to be within the mode
+    if ((BltOperation == EfiBltVideoToBltBuffer) || (BltOperation == EfiBltVideoToVideo)) {
+        if ((SourceX + Width > Mode->Info->HorizontalResolution) ||
+            (SourceY + Height > Mode->Info->VerticalResolution)) {
+            return EFI_INVALID_PARAMETER;
         }
-        break;
+    }
 
-    case EfiBltVideoToBltBuffer:
-        if (Delta == 0) {
-          Delta = Width * PI2_BYTES_PER_PIXEL;
+    if (BltOperation != EfiBltVideoToBltBuffer) {
+        if ((DestinationX + Width > Mode->Info->HorizontalResolution) ||
+            (DestinationY + Height > Mode->Info->VerticalResolution)) {
+            return EFI_INVALID_PARAMETER;
         }
+    }
 
-        for (i=0;i<Height;i++) {
-            VidBuf = (UINT8 *)((UINT32)This->Mode->FrameBufferBase + \
-                     (SourceY + i)*This->Mode->Info->PixelsPerScanLine*PI2_BYTES_PER_PIXEL + \
-                     SourceX*PI2_BYTES_PER_PIXEL);
-            BltBuf = (UINT8 *)((UINT32)BltBuffer + (DestinationY + i)*Delta + DestinationX*PI2_BYTES_PER_PIXEL);
+    if (Delta == 0) {
+        Delta = Width * PI2_BYTES_PER_PIXEL;
+    }
 
-            for (j=0;j<Width;j++) {
-                gBS->CopyMem((VOID *)BltBuf, (VOID *)VidBuf, PI2_COLOUR_BYTES_PER_PIXEL);
-                VidBuf += PI2_BYTES_PER_PIXEL;
-                BltBuf += PI2_BYTES_PER_PIXEL;
-            }
+    // Keep the flush timer from running in the middle of the operation
+    OldTpl = gBS->RaiseTPL(TPL_NOTIFY);
+
+    // With the shadow buffer all reads and writes stay in cached DRAM
+    if (mShadowEnabled) {
+        VidBase = (UINTN)mShadow.Buffer;
+    } else {
+        VidBase = (UINTN)Mode->FrameBufferBase;
+    }
+
+    // Whole scanlines are handed to the kernels, the reserved byte of the
+    // framebuffer pixels is kept opaque
+    switch(BltOperation) {
+    case EfiBltVideoFill:
+        Colour = (*(UINT32*)BltBuffer & PI2_COLOUR_MASK) | PI2_ALPHA_MASK;
+
+        for (i = 0; i < Height; i++) {
+            DisplayFillLine32(DISPLAY_PIXEL(VidBase, Mode, DestinationX, DestinationY + i), Colour, Width);
         }
         break;
 
-    case EfiBltBufferToVideo:
-        if (Delta == 0) {
-            Delta = Width * PI2_BYTES_PER_PIXEL;
+    case EfiBltVideoToBltBuffer:
+        for (i = 0; i < Height; i++) {
+            BltBuf = (UINT8*)BltBuffer + ((DestinationY + i) * Delta) + (DestinationX * PI2_BYTES_PER_PIXEL);
+            DisplayCopyLinePreserveReserved(
+                (UINT32*)BltBuf,
+                DISPLAY_PIXEL(VidBase, Mode, SourceX, SourceY + i),
+                Width);
         }
+        break;
 
-        for (i=0;i<Height;i++) {
-            VidBuf = (UINT8 *)((UINT32)This->Mode->FrameBufferBase + \
-                     (DestinationY + i)*This->Mode->Info->PixelsPerScanLine*PI2_BYTES_PER_PIXEL + \
-                     DestinationX*PI2_BYTES_PER_PIXEL);
-            BltBuf = (UINT8 *)((UINT32)BltBuffer + (SourceY + i)*Delta + SourceX*PI2_BYTES_PER_PIXEL);
-
-            for (j=0;j<Width;j++) {
-                gBS->CopyMem((VOID *)VidBuf, (VOID *)BltBuf, PI2_COLOUR_BYTES_PER_PIXEL);
-                VidBuf += PI2_BYTES_PER_PIXEL;
-                BltBuf += PI2_BYTES_PER_PIXEL;
-            }
+    case EfiBltBufferToVideo:
+        for (i = 0; i < Height; i++) {
+            BltBuf = (UINT8*)BltBuffer + ((SourceY + i) * Delta) + (SourceX * PI2_BYTES_PER_PIXEL);
+            DisplayCopyLineSetAlpha(
+                DISPLAY_PIXEL(VidBase, Mode, DestinationX, DestinationY + i),
+                (UINT32*)BltBuf,
+                Width);
         }
         break;
 
     case EfiBltVideoToVideo:
-        for (i=0;i<Height;i++) {
-            VidBuf = (UINT8 *)((UINT32)This->Mode->FrameBufferBase + \
-                     (SourceY + i)*This->Mode->Info->PixelsPerScanLine*PI2_BYTES_PER_PIXEL + \
-                     SourceX*PI2_BYTES_PER_PIXEL);
-
-            VidBuf1 = (UINT8 *)((UINT32)This->Mode->FrameBufferBase + \
-                      (DestinationY + i)*This->Mode->Info->PixelsPerScanLine*PI2_BYTES_PER_PIXEL + \
-                      DestinationX*PI2_BYTES_PER_PIXEL);
-
-            for (j=0;j<Width;j++) {
-                gBS->CopyMem((VOID *)VidBuf1, (VOID *)VidBuf, PI2_COLOUR_BYTES_PER_PIXEL);
-                VidBuf += PI2_BYTES_PER_PIXEL;
-                VidBuf1 += PI2_BYTES_PER_PIXEL;
+        if (DestinationY == SourceY) {
+            // Source and destination scanlines may overlap, CopyMem handles that
+            for (i = 0; i < Height; i++) {
+                CopyMem(
+                    DISPLAY_PIXEL(VidBase, Mode, DestinationX, DestinationY + i),
+                    DISPLAY_PIXEL(VidBase, Mode, SourceX, SourceY + i),
+                    Width * PI2_BYTES_PER_PIXEL);
+            }
+        } else if (DestinationY < SourceY) {
+            // Moving up (scrolling), copy top to bottom so no source line is
+            // overwritten before it has been copied
+            for (i = 0; i < Height; i++) {
+                VidBuf = DISPLAY_PIXEL(VidBase, Mode, SourceX, SourceY + i);
+                VidBuf1 = DISPLAY_PIXEL(VidBase, Mode, DestinationX, DestinationY + i);
+                DisplayCopyLine32(VidBuf1, VidBuf, Width);
+            }
+        } else {
+            // Moving down, copy bottom to top
+            for (i = Height; i > 0; i--) {
+                VidBuf = DISPLAY_PIXEL(VidBase, Mode, SourceX, SourceY + i - 1);
+                VidBuf1 = DISPLAY_PIXEL(VidBase, Mode, DestinationX, DestinationY + i - 1);
+                DisplayCopyLine32(VidBuf1, VidBuf, Width);
             }
         }
         break;
@@ -297,9 +549,99 @@ DisplayBlt(
         break;
     }
 
+    if (mShadowEnabled && (BltOperation != EfiBltVideoToBltBuffer)) {
+        DisplayAddDirtyRect(DestinationX, DestinationY, Width, Height);
+
+        // Without a flush period the framebuffer is updated right away
+        if (PcdGet32(PcdDisplayShadowFlushPeriod) == 0) {
+            DisplayFlushShadow(This);
+        }
+    }
+
+    gBS->RestoreTPL(OldTpl);
+
     return EFI_SUCCESS;
 }
 
+#if DISPLAY_BENCHMARK_BLT
+#define DISPLAY_BENCHMARK_FRAMES    30
+
+//
+// Runs each Blt operation over the whole screen DISPLAY_BENCHMARK_FRAMES times
+// and returns the frame rate in frames per second
+//
+UINT32
+DisplayBenchmarkOperation(
+    IN  EFI_GRAPHICS_OUTPUT_PROTOCOL        *This,
+    IN  EFI_GRAPHICS_OUTPUT_BLT_OPERATION   BltOperation,
+    IN  EFI_GRAPHICS_OUTPUT_BLT_PIXEL       *BltBuffer
+    )
+{
+    UINT64 StartTime, EndTime, TicksPerSecond;
+    UINTN Width, Height;
+    UINTN Frame;
+
+    Width = This->Mode->Info->HorizontalResolution;
+    Height = This->Mode->Info->VerticalResolution;
+    TicksPerSecond = GetPerformanceCounterProperties(NULL, NULL);
+
+    StartTime = GetPerformanceCounter();
+    for (Frame = 0; Frame < DISPLAY_BENCHMARK_FRAMES; ++Frame) {
+        if (BltOperation == EfiBltVideoToVideo) {
+            // Scroll the screen up by one console text line
+            DisplayBlt(This, NULL, EfiBltVideoToVideo, 0, EFI_GLYPH_HEIGHT, 0, 0, Width, Height - EFI_GLYPH_HEIGHT, 0);
+        } else {
+            DisplayBlt(This, BltBuffer, BltOperation, 0, 0, 0, 0, Width, Height, 0);
+        }
+    }
+    EndTime = GetPerformanceCounter();
+
+    if (EndTime == StartTime) {
+        return 0;
+    }
+
+    return (UINT32)DivU64x64Remainder(
+        MultU64x32(TicksPerSecond, DISPLAY_BENCHMARK_FRAMES),
+        EndTime - StartTime,
+        NULL);
+}
+
+VOID
+DisplayBenchmarkBlt(
+    IN  EFI_GRAPHICS_OUTPUT_PROTOCOL        *This
+    )
+{
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer;
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL Black;
+    UINTN BufferSize;
+
+    BufferSize = This->Mode->Info->HorizontalResolution *
+                 This->Mode->Info->VerticalResolution *
+                 sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+
+    BltBuffer = AllocateZeroPool(BufferSize);
+    if (BltBuffer == NULL) {
+        return;
+    }
+
+    ZeroMem(&Black, sizeof(Black));
+
+    DEBUG((EFI_D_INIT, "DisplayDxe: Benchmarking Blt %dx%d\n",
+           This->Mode->Info->HorizontalResolution,
+           This->Mode->Info->VerticalResolution));
+    DEBUG((EFI_D_INIT, "DisplayDxe: Fill          %d fps\n",
+           DisplayBenchmarkOperation(This, EfiBltVideoFill, &Black)));
+    DEBUG((EFI_D_INIT, "DisplayDxe: Scroll        %d fps\n",
+           DisplayBenchmarkOperation(This, EfiBltVideoToVideo, NULL)));
+    DEBUG((EFI_D_INIT, "DisplayDxe: BufferToVideo %d fps\n",
+           DisplayBenchmarkOperation(This, EfiBltBufferToVideo, BltBuffer)));
+    DEBUG((EFI_D_INIT, "DisplayDxe: VideoToBuffer %d fps\n",
+           DisplayBenchmarkOperation(This, EfiBltVideoToBltBuffer, BltBuffer)));
+
+    FreePool(BltBuffer);
+}
+#endif // DISPLAY_BENCHMARK_BLT
+
 
 /**
   Initialize the state information for the Display Dxe
@@ -322,6 +664,7 @@ DisplayDxeInitialize (
     EFI_STATUS Status = EFI_SUCCESS;
     EFI_GUID GraphicsOutputProtocolGuid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
     EFI_GUID DevicePathProtocolGuid = EFI_DEVICE_PATH_PROTOCOL_GUID;
+    UINTN Idx;
 
     if (gDisplay.Mode == NULL){
         Status = gBS->AllocatePool(
@@ -366,59 +709,76 @@ DisplayDxeInitialize (
     }
     DEBUG((EFI_D_INIT, "Mailbox Display Size  %d x %d\n", MbFbSize.Width, MbFbSize.Height));
 
-    MAILBOX_FRAMEBUFFER MbFb;
-    ZeroMem((void*)&MbFb, sizeof(MAILBOX_FRAMEBUFFER));
-    MbFb.mbf_phys_width = MbFb.mbf_virt_width = MbFbSize.Width;
-    MbFb.mbf_phys_height = MbFb.mbf_virt_height = MbFbSize.Height;
-    MbFb.mbf_depth = PI2_BITS_PER_PIXEL;
+    // Mode 0 is the native resolution, followed by the standard ones that fit in it
+    gDisplay.Mode->MaxMode = 0;
+    mDisplayModes[gDisplay.Mode->MaxMode].Width = MbFbSize.Width;
+    mDisplayModes[gDisplay.Mode->MaxMode].Height = MbFbSize.Height;
+    gDisplay.Mode->MaxMode++;
+
+    for (Idx = 0; Idx < sizeof(mStandardModes) / sizeof(mStandardModes[0]); Idx++) {
+        if ((gDisplay.Mode->MaxMode < DISPLAY_MAX_MODES) &&
+            (mStandardModes[Idx].Width <= MbFbSize.Width) &&
+            (mStandardModes[Idx].Height <= MbFbSize.Height) &&
+            ((mStandardModes[Idx].Width != MbFbSize.Width) ||
+             (mStandardModes[Idx].Height != MbFbSize.Height))) {
+            mDisplayModes[gDisplay.Mode->MaxMode++] = mStandardModes[Idx];
+        }
+    }
+
+    mShadowEnabled = PcdGetBool(PcdDisplayShadowEnabled);
 
     // Request a frame buffer allocation so we can retrive
     // frame buffer address
-    MailboxTransactFrameBuffer(&MbFb);
-
-    if ((MbFb.mbf_framebuf_addr != 0) && (MbFb.mbf_framebuf_size != 0))
-    {
-        //Applying alpha value to the frame buffer
-        SetMem32((void*)MbFb.mbf_framebuf_addr, MbFb.mbf_framebuf_size, 0xFF000000);
-
-        // Fill out mode information
-        gDisplay.Mode->MaxMode = 1;
-        gDisplay.Mode->Mode = 0;
-        gDisplay.Mode->Info->Version = 0;
-        // There is no way to communicate pitch back to OS. OS and even UEFI
-        // expects a fully linear frame buffer. So the width should
-        // be based on the frame buffer's pitch value. In some casses VC
-        // firmware would allocate a frame buffer with some padding
-        // presumeably to be 8 byte align.
-        gDisplay.Mode->Info->HorizontalResolution = MbFb.mbf_pitch / PI2_BYTES_PER_PIXEL;
-        gDisplay.Mode->Info->VerticalResolution = MbFb.mbf_virt_height;
-
-        // NOTE: Windows REQUIRES BGR in 32 or 24 bit format.
-        // TODO: Figure out a way in GOP driver to set the display controller
-        //       to the appropriate pixel format instead of relying on
-        //       framebuffer_ignore_alpha and framebuffer_swap
-        gDisplay.Mode->Info->PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
-        gDisplay.Mode->Info->PixelsPerScanLine = MbFb.mbf_pitch / PI2_BYTES_PER_PIXEL;;
-        gDisplay.Mode->SizeOfInfo = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
-        gDisplay.Mode->FrameBufferBase = MbFb.mbf_framebuf_addr;
-        gDisplay.Mode->FrameBufferSize = MbFb.mbf_framebuf_size;
+    Status = DisplaySetMode(&gDisplay, 0);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
 
-        {
-            EFI_HANDLE gUEFIDisplayHandle = NULL;
-            Status = gBS->InstallMultipleProtocolInterfaces (
-                              &gUEFIDisplayHandle,
-                              &DevicePathProtocolGuid,
-                              &gDisplayDevicePath,
-                              &GraphicsOutputProtocolGuid,
-                              &gDisplay,
-                              NULL);
+    if (mShadowEnabled) {
+        Status = gBS->CreateEventEx(
+                        EVT_NOTIFY_SIGNAL,
+                        TPL_NOTIFY,
+                        DisplayExitBootServicesCallback,
+                        &gDisplay,
+                        &gEfiEventExitBootServicesGuid,
+                        &mShadow.ExitBootServicesEvent
+                        );
+        ASSERT_EFI_ERROR(Status);
 
+        if (PcdGet32(PcdDisplayShadowFlushPeriod) != 0) {
+            Status = gBS->CreateEvent(
+                            EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                            TPL_NOTIFY,
+                            DisplayFlushTimerCallback,
+                            &gDisplay,
+                            &mShadow.FlushEvent
+                            );
+            ASSERT_EFI_ERROR(Status);
+
+            Status = gBS->SetTimer(
+                            mShadow.FlushEvent,
+                            TimerPeriodic,
+                            EFI_TIMER_PERIOD_MILLISECONDS(PcdGet32(PcdDisplayShadowFlushPeriod))
+                            );
+            ASSERT_EFI_ERROR(Status);
         }
     }
-    else
+
     {
-        Status = EFI_DEVICE_ERROR;
+        EFI_HANDLE gUEFIDisplayHandle = NULL;
+        Status = gBS->InstallMultipleProtocolInterfaces (
+                          &gUEFIDisplayHandle,
+                          &DevicePathProtocolGuid,
+                          &gDisplayDevicePath,
+                          &GraphicsOutputProtocolGuid,
+                          &gDisplay,
+                          NULL);
+
     }
 
+#if DISPLAY_BENCHMARK_BLT
+    DisplayBenchmarkBlt(&gDisplay);
+#endif // DISPLAY_BENCHMARK_BLT
+
     return Status;
 }
@@ -0,0 +1,102 @@
+/** @file
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __DISPLAYDXE_H__
+#define __DISPLAYDXE_H__
+
+#define PI2_BITS_PER_PIXEL              (32)
+#define PI2_BYTES_PER_PIXEL             (PI2_BITS_PER_PIXEL / 8)
+
+#define PI2_COLOUR_BITS_PER_PIXEL       (24)
+#define PI2_COLOUR_BYTES_PER_PIXEL      (PI2_COLOUR_BITS_PER_PIXEL / 8)
+
+// Only the 24 colour bits are ever written by Blt, the reserved byte of every
+// framebuffer pixel is set to opaque alpha once at initialization
+#define PI2_COLOUR_MASK                 0x00FFFFFF
+#define PI2_ALPHA_MASK                  0xFF000000
+
+// Define with non-zero to benchmark Blt once the GOP is installed and dump the
+// frame rates to the terminal
+#define DISPLAY_BENCHMARK_BLT           0
+
+//
+// Resolutions offered through QueryMode/SetMode. Mode 0 is always the native
+// resolution of the display, the other ones are only offered when they fit in it
+// and the GPU scales them up to the display
+//
+typedef struct {
+  UINT32  Width;
+  UINT32  Height;
+} DISPLAY_MODE;
+
+#define DISPLAY_MAX_MODES               8
+
+//
+// Shadow framebuffer. Blt works on a cached copy of the framebuffer in DRAM and
+// the rectangles it modified are copied to the real framebuffer by DisplayFlushShadow()
+//
+typedef struct {
+  UINTN   X;
+  UINTN   Y;
+  UINTN   Width;
+  UINTN   Height;
+} DISPLAY_RECT;
+
+#define DISPLAY_MAX_DIRTY_RECTS         8
+
+typedef struct {
+  UINT32        *Buffer;
+  UINTN         Pages;
+  EFI_EVENT     FlushEvent;
+  EFI_EVENT     ExitBootServicesEvent;
+  DISPLAY_RECT  Dirty[DISPLAY_MAX_DIRTY_RECTS];
+  UINTN         DirtyCount;
+} DISPLAY_SHADOW;
+
+//
+// Scanline kernels, see Arm/DisplayBltKernels.S
+//
+
+VOID
+DisplayFillLine32 (
+  OUT UINT32        *Destination,
+  IN  UINT32        Value,
+  IN  UINTN         Count
+  );
+
+// Destination and Source must not overlap
+VOID
+DisplayCopyLine32 (
+  OUT UINT32        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+// Copies the colour bytes and forces the reserved (alpha) byte to 0xFF
+VOID
+DisplayCopyLineSetAlpha (
+  OUT UINT32        *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+// Copies the colour bytes and leaves the reserved byte of Destination untouched
+VOID
+DisplayCopyLinePreserveReserved (
+  IN OUT UINT32     *Destination,
+  IN  CONST UINT32  *Source,
+  IN  UINTN         Count
+  );
+
+#endif // __DISPLAYDXE_H__
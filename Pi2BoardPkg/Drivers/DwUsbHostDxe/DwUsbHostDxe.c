@@ -0,0 +1,879 @@
+/** @file
+*
+*  EFI_USB2_HC_PROTOCOL of the DWC2 USB controller of the BCM2836/BCM2837,
+*  driven in host mode. UsbBusDxe enumerates the devices from its single root
+*  port, on the Pi 2 and Pi 3 that is the LAN9514/LAN9512 high speed hub.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Protocol/DevicePath.h>
+
+#include <Bcm2836.h>
+#include <Bcm2836Usb.h>
+
+#include "DwUsbHostDxe.h"
+
+// Core Timing Parameters
+#define CORE_RESET_TIMEOUT_US               100000 // 100ms
+#define CORE_RESET_STALL_US                 10000 // 10ms for the PHY clock to settle
+#define FORCE_HOST_MODE_STALL_US            25000 // 25ms, from the databook
+#define PORT_POWER_STALL_US                 20000 // 20ms
+#define PORT_RESUME_STALL_US                20000 // 20ms, USB 2.0 7.1.7.7
+
+// FIFO sizes in words, the Rx FIFO holds the largest packet with its status
+// words, the transmit FIFOs a few packets each
+#define RX_FIFO_DEPTH                       774
+#define NON_PERIODIC_TX_FIFO_DEPTH          256
+#define PERIODIC_TX_FIFO_DEPTH              512
+
+typedef struct {
+    VENDOR_DEVICE_PATH DwUsbDevicePath;
+    EFI_DEVICE_PATH EndDevicePath;
+} DW_USB_DEVICE_PATH;
+
+DW_USB_DEVICE_PATH gDwUsbDevicePath =
+{
+    {
+        {
+            HARDWARE_DEVICE_PATH,
+            HW_VENDOR_DP,
+            {
+                (UINT8)(sizeof(VENDOR_DEVICE_PATH)),
+                (UINT8)((sizeof(VENDOR_DEVICE_PATH)) >> 8),
+            }
+        },
+        EFI_CALLER_ID_GUID
+    },
+    {
+        END_DEVICE_PATH_TYPE,
+        END_ENTIRE_DEVICE_PATH_SUBTYPE,
+        {
+            sizeof(EFI_DEVICE_PATH_PROTOCOL),
+            0
+        }
+    }
+};
+
+STATIC EFI_USB_HC_STATE mState = EfiUsbHcStateHalt;
+STATIC UINT32 mChannelCount = 0;
+// The core has no reset change bit, the port reset is over once it is cleared
+STATIC BOOLEAN mPortResetChange = FALSE;
+STATIC LIST_ENTRY mAsyncTransfers = INITIALIZE_LIST_HEAD_VARIABLE(mAsyncTransfers);
+
+STATIC
+EFI_STATUS
+DwUsbWaitRegister(
+    IN UINTN    Register,
+    IN UINT32   Mask,
+    IN UINT32   Value,
+    IN UINTN    TimeoutUs
+    )
+{
+    UINT64 Deadline = DwUsbDeadline(TimeoutUs);
+
+    while ((MmioRead32(Register) & Mask) != Value) {
+        if (GetPerformanceCounter() > Deadline) {
+            return EFI_TIMEOUT;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Resets the core into host mode with the channels in DMA mode and powers
+  the root port. The core is polled, its interrupts stay disabled.
+**/
+STATIC
+EFI_STATUS
+DwUsbCoreInitialize(
+    VOID
+    )
+{
+    EFI_STATUS Status;
+    UINT32 Snpsid = MmioRead32(DWUSB_GSNPSID);
+    UINT32 Hprt;
+    UINT32 Channel;
+
+    if ((Snpsid & DWUSB_GSNPSID_ID_MASK) != DWUSB_GSNPSID_OTG2) {
+        DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbCoreInitialize(): No DWC2 core, GSNPSID: 0x%08x\n", Snpsid));
+        return EFI_UNSUPPORTED;
+    }
+
+    Status = DwUsbWaitRegister(DWUSB_GRSTCTL, DWUSB_GRSTCTL_AHBIDLE, DWUSB_GRSTCTL_AHBIDLE, CORE_RESET_TIMEOUT_US);
+    if (!EFI_ERROR(Status)) {
+        MmioOr32(DWUSB_GRSTCTL, DWUSB_GRSTCTL_CSFTRST);
+        Status = DwUsbWaitRegister(DWUSB_GRSTCTL, DWUSB_GRSTCTL_CSFTRST, 0, CORE_RESET_TIMEOUT_US);
+    }
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbCoreInitialize(): Core reset timed out\n"));
+        return EFI_DEVICE_ERROR;
+    }
+    gBS->Stall(CORE_RESET_STALL_US);
+
+    MmioAndThenOr32(DWUSB_GUSBCFG, ~DWUSB_GUSBCFG_FORCE_DEV_MODE, DWUSB_GUSBCFG_FORCE_HOST_MODE);
+    gBS->Stall(FORCE_HOST_MODE_STALL_US);
+    Status = DwUsbWaitRegister(DWUSB_GINTSTS, DWUSB_GINTSTS_CURMOD_HOST, DWUSB_GINTSTS_CURMOD_HOST, CORE_RESET_TIMEOUT_US);
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbCoreInitialize(): Core didn't switch to host mode\n"));
+        return EFI_DEVICE_ERROR;
+    }
+
+    MmioWrite32(DWUSB_PCGCCTL, 0);
+    MmioWrite32(DWUSB_GAHBCFG, DWUSB_GAHBCFG_DMA_EN | DWUSB_GAHBCFG_HBSTLEN_INCR4);
+    MmioAndThenOr32(
+        DWUSB_HCFG,
+        ~(DWUSB_HCFG_FSLSPCLKSEL_MASK | DWUSB_HCFG_FSLSSUPP),
+        DWUSB_HCFG_FSLSPCLKSEL_30_60MHZ);
+
+    MmioWrite32(DWUSB_GRXFSIZ, RX_FIFO_DEPTH);
+    MmioWrite32(DWUSB_GNPTXFSIZ, DWUSB_FIFO_DEPTH(RX_FIFO_DEPTH, NON_PERIODIC_TX_FIFO_DEPTH));
+    MmioWrite32(
+        DWUSB_HPTXFSIZ,
+        DWUSB_FIFO_DEPTH(RX_FIFO_DEPTH + NON_PERIODIC_TX_FIFO_DEPTH, PERIODIC_TX_FIFO_DEPTH));
+
+    MmioWrite32(DWUSB_GRSTCTL, DWUSB_GRSTCTL_TXFFLSH | DWUSB_GRSTCTL_TXFNUM_ALL);
+    Status = DwUsbWaitRegister(DWUSB_GRSTCTL, DWUSB_GRSTCTL_TXFFLSH, 0, CORE_RESET_TIMEOUT_US);
+    if (!EFI_ERROR(Status)) {
+        MmioWrite32(DWUSB_GRSTCTL, DWUSB_GRSTCTL_RXFFLSH);
+        Status = DwUsbWaitRegister(DWUSB_GRSTCTL, DWUSB_GRSTCTL_RXFFLSH, 0, CORE_RESET_TIMEOUT_US);
+    }
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbCoreInitialize(): FIFO flush timed out\n"));
+        return EFI_DEVICE_ERROR;
+    }
+
+    MmioWrite32(DWUSB_GINTMSK, 0);
+    MmioWrite32(DWUSB_GINTSTS, MAX_UINT32);
+    MmioWrite32(DWUSB_HAINTMSK, 0);
+
+    mChannelCount = DWUSB_GHWCFG2_NUM_HOST_CHAN(MmioRead32(DWUSB_GHWCFG2));
+    for (Channel = 0; Channel < mChannelCount; ++Channel) {
+        DwUsbChannelHalt(Channel);
+        MmioWrite32(DWUSB_HCINTMSK(Channel), DWUSB_HCINT_CHHLTD);
+        MmioWrite32(DWUSB_HCINT(Channel), DWUSB_HCINT_ALL);
+    }
+
+    Hprt = MmioRead32(DWUSB_HPRT) & ~DWUSB_HPRT_W1C_MASK;
+    if ((Hprt & DWUSB_HPRT_PWR) == 0) {
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_PWR);
+        gBS->Stall(PORT_POWER_STALL_US);
+    }
+
+    mPortResetChange = FALSE;
+
+    return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+DwUsbInitPipe(
+    OUT DW_USB_PIPE                         *Pipe,
+    IN  UINT8                               DeviceAddress,
+    IN  UINT8                               EndPointAddress,
+    IN  UINT8                               Type,
+    IN  UINT8                               DeviceSpeed,
+    IN  UINTN                               MaximumPacketLength,
+    IN  EFI_USB2_HC_TRANSACTION_TRANSLATOR  *Translator
+    )
+{
+    ZeroMem(Pipe, sizeof(*Pipe));
+    Pipe->DeviceAddress = DeviceAddress;
+    Pipe->EndPointNumber = EndPointAddress & 0xF;
+    Pipe->IsIn = ((EndPointAddress & USB_ENDPOINT_DIR_IN) != 0);
+    Pipe->Type = Type;
+    Pipe->DeviceSpeed = DeviceSpeed;
+    Pipe->MaxPacket = (UINT32)MaximumPacketLength;
+
+    if ((Translator != NULL) && (DeviceSpeed != EFI_USB_SPEED_HIGH)) {
+        Pipe->HubAddress = Translator->TranslatorHubAddress;
+        Pipe->PortNumber = Translator->TranslatorPortNumber;
+    }
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbGetCapability(
+    IN  EFI_USB2_HC_PROTOCOL    *This,
+    OUT UINT8                   *MaxSpeed,
+    OUT UINT8                   *PortNumber,
+    OUT UINT8                   *Is64BitCapable
+    )
+{
+    if ((MaxSpeed == NULL) || (PortNumber == NULL) || (Is64BitCapable == NULL)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    *MaxSpeed = EFI_USB_SPEED_HIGH;
+    *PortNumber = 1;
+    *Is64BitCapable = 0;
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbReset(
+    IN EFI_USB2_HC_PROTOCOL     *This,
+    IN UINT16                   Attributes
+    )
+{
+    EFI_STATUS Status;
+    EFI_TPL OldTpl;
+
+    switch (Attributes) {
+    case EFI_USB_HC_RESET_GLOBAL:
+    case EFI_USB_HC_RESET_HOST_CONTROLLER:
+        OldTpl = gBS->RaiseTPL(DW_USB_TPL);
+        Status = DwUsbCoreInitialize();
+        gBS->RestoreTPL(OldTpl);
+        return Status;
+
+    case EFI_USB_HC_RESET_GLOBAL_WITH_DEBUG:
+    case EFI_USB_HC_RESET_HOST_WITH_DEBUG:
+        return EFI_UNSUPPORTED;
+
+    default:
+        return EFI_INVALID_PARAMETER;
+    }
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbGetState(
+    IN  EFI_USB2_HC_PROTOCOL    *This,
+    OUT EFI_USB_HC_STATE        *State
+    )
+{
+    if (State == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    *State = mState;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbSetState(
+    IN EFI_USB2_HC_PROTOCOL     *This,
+    IN EFI_USB_HC_STATE         State
+    )
+{
+    if (State >= EfiUsbHcStateMaximum) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    // Transfers are only run on request, there is no schedule to stop
+    mState = State;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbControlTransferEntry(
+    IN     EFI_USB2_HC_PROTOCOL                 *This,
+    IN     UINT8                                DeviceAddress,
+    IN     UINT8                                DeviceSpeed,
+    IN     UINTN                                MaximumPacketLength,
+    IN     EFI_USB_DEVICE_REQUEST               *Request,
+    IN     EFI_USB_DATA_DIRECTION               TransferDirection,
+    IN OUT VOID                                 *Data,
+    IN OUT UINTN                                *DataLength,
+    IN     UINTN                                TimeOut,
+    IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR   *Translator,
+    OUT    UINT32                               *TransferResult
+    )
+{
+    EFI_STATUS Status;
+    EFI_TPL OldTpl;
+    DW_USB_PIPE Pipe;
+    UINTN NoDataLength = 0;
+
+    if ((Request == NULL) || (TransferResult == NULL) ||
+        (TransferDirection > EfiUsbNoData) ||
+        (DeviceSpeed > EFI_USB_SPEED_HIGH) ||
+        ((MaximumPacketLength != 8) && (MaximumPacketLength != 16) &&
+         (MaximumPacketLength != 32) && (MaximumPacketLength != 64)) ||
+        ((DeviceSpeed == EFI_USB_SPEED_LOW) && (MaximumPacketLength != 8)) ||
+        ((DeviceSpeed == EFI_USB_SPEED_HIGH) && (MaximumPacketLength != 64))) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (TransferDirection == EfiUsbNoData) {
+        if ((Data != NULL) || ((DataLength != NULL) && (*DataLength != 0))) {
+            return EFI_INVALID_PARAMETER;
+        }
+        DataLength = &NoDataLength;
+    } else if ((Data == NULL) || (DataLength == NULL)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    *TransferResult = EFI_USB_ERR_SYSTEM;
+
+    DwUsbInitPipe(&Pipe, DeviceAddress, 0, DWUSB_EPTYPE_CONTROL, DeviceSpeed, MaximumPacketLength, Translator);
+
+    OldTpl = gBS->RaiseTPL(DW_USB_TPL);
+    Status = DwUsbControlTransfer(
+        &Pipe,
+        Request,
+        TransferDirection,
+        Data,
+        DataLength,
+        DwUsbDeadline(TimeOut * 1000),
+        TransferResult);
+    gBS->RestoreTPL(OldTpl);
+
+    if (EFI_ERROR(Status)) {
+        DEBUG((
+            DEBUG_INFO,
+            "DwUsbHost: DwUsbControlTransfer(Device: %d, Request: 0x%02x/0x%02x) failed. %r, Result: 0x%x\n",
+            DeviceAddress,
+            Request->RequestType,
+            Request->Request,
+            Status,
+            *TransferResult));
+    }
+
+    return Status;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbBulkTransfer(
+    IN     EFI_USB2_HC_PROTOCOL                 *This,
+    IN     UINT8                                DeviceAddress,
+    IN     UINT8                                EndPointAddress,
+    IN     UINT8                                DeviceSpeed,
+    IN     UINTN                                MaximumPacketLength,
+    IN     UINT8                                DataBuffersNumber,
+    IN OUT VOID                                 *Data[EFI_USB_MAX_BULK_BUFFER_NUM],
+    IN OUT UINTN                                *DataLength,
+    IN OUT UINT8                                *DataToggle,
+    IN     UINTN                                TimeOut,
+    IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR   *Translator,
+    OUT    UINT32                               *TransferResult
+    )
+{
+    EFI_STATUS Status;
+    EFI_TPL OldTpl;
+    DW_USB_PIPE Pipe;
+    UINT8 Pid;
+
+    if ((Data == NULL) || (Data[0] == NULL) || (DataLength == NULL) || (*DataLength == 0) ||
+        (DataToggle == NULL) || (*DataToggle > 1) || (TransferResult == NULL) ||
+        (DataBuffersNumber == 0) || (DataBuffersNumber > EFI_USB_MAX_BULK_BUFFER_NUM) ||
+        (DeviceSpeed == EFI_USB_SPEED_LOW) || (DeviceSpeed > EFI_USB_SPEED_HIGH) ||
+        ((DeviceSpeed == EFI_USB_SPEED_FULL) && (MaximumPacketLength > 64)) ||
+        ((DeviceSpeed == EFI_USB_SPEED_HIGH) && (MaximumPacketLength > 512)) ||
+        (MaximumPacketLength == 0)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    DwUsbInitPipe(&Pipe, DeviceAddress, EndPointAddress, DWUSB_EPTYPE_BULK, DeviceSpeed, MaximumPacketLength, Translator);
+    Pid = (*DataToggle != 0) ? DWUSB_PID_DATA1 : DWUSB_PID_DATA0;
+
+    OldTpl = gBS->RaiseTPL(DW_USB_TPL);
+    Status = DwUsbTransfer(&Pipe, &Pid, Data[0], DataLength, DwUsbDeadline(TimeOut * 1000), FALSE, TransferResult);
+    gBS->RestoreTPL(OldTpl);
+
+    *DataToggle = (Pid == DWUSB_PID_DATA1) ? 1 : 0;
+
+    if (EFI_ERROR(Status)) {
+        DEBUG((
+            DEBUG_INFO,
+            "DwUsbHost: DwUsbBulkTransfer(Device: %d, EP: 0x%02x) failed after 0x%x bytes. %r, Result: 0x%x\n",
+            DeviceAddress,
+            EndPointAddress,
+            *DataLength,
+            Status,
+            *TransferResult));
+    }
+
+    return Status;
+}
+
+/**
+  Polls an asynchronous interrupt transfer, the callback is only called when
+  the endpoint had data or failed.
+**/
+VOID
+EFIAPI
+DwUsbAsyncPoll(
+    IN EFI_EVENT    Event,
+    IN VOID         *Context
+    )
+{
+    DW_USB_ASYNC_TRANSFER *Transfer = (DW_USB_ASYNC_TRANSFER*)Context;
+    EFI_ASYNC_USB_TRANSFER_CALLBACK CallBack = Transfer->CallBack;
+    VOID *CallBackContext = Transfer->Context;
+    EFI_STATUS Status;
+    UINTN Length = Transfer->DataLength;
+    UINT32 Result;
+    VOID *Data;
+
+    Status = DwUsbTransfer(
+        &Transfer->Pipe,
+        &Transfer->Pid,
+        Transfer->Data,
+        &Length,
+        DwUsbDeadline(DW_USB_ASYNC_POLL_TIMEOUT_US),
+        TRUE,
+        &Result);
+    if ((Status == EFI_NOT_READY) || (CallBack == NULL)) {
+        return;
+    }
+
+    if (EFI_ERROR(Status)) {
+        CallBack(NULL, 0, CallBackContext, Result);
+        return;
+    }
+
+    // The callback may remove the transfer, it gets a copy of the data
+    Data = AllocateCopyPool(Length, Transfer->Data);
+    if (Data == NULL) {
+        return;
+    }
+    CallBack(Data, Length, CallBackContext, EFI_USB_NOERROR);
+    FreePool(Data);
+}
+
+STATIC
+EFI_STATUS
+DwUsbAsyncTransferRemove(
+    IN  UINT8   DeviceAddress,
+    IN  UINT8   EndPointAddress,
+    OUT UINT8   *DataToggle
+    )
+{
+    LIST_ENTRY *Link;
+    DW_USB_ASYNC_TRANSFER *Transfer;
+
+    for (Link = GetFirstNode(&mAsyncTransfers); !IsNull(&mAsyncTransfers, Link); Link = GetNextNode(&mAsyncTransfers, Link)) {
+        Transfer = DW_USB_ASYNC_TRANSFER_FROM_LINK(Link);
+
+        if ((Transfer->Pipe.DeviceAddress == DeviceAddress) &&
+            (Transfer->Pipe.EndPointNumber == (EndPointAddress & 0xF)) &&
+            (Transfer->Pipe.IsIn == ((EndPointAddress & USB_ENDPOINT_DIR_IN) != 0))) {
+
+            gBS->CloseEvent(Transfer->PollEvent);
+            RemoveEntryList(&Transfer->Link);
+            if (DataToggle != NULL) {
+                *DataToggle = (Transfer->Pid == DWUSB_PID_DATA1) ? 1 : 0;
+            }
+            FreePool(Transfer);
+            return EFI_SUCCESS;
+        }
+    }
+
+    return EFI_NOT_FOUND;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbAsyncInterruptTransfer(
+    IN     EFI_USB2_HC_PROTOCOL                 *This,
+    IN     UINT8                                DeviceAddress,
+    IN     UINT8                                EndPointAddress,
+    IN     UINT8                                DeviceSpeed,
+    IN     UINTN                                MaximumPacketLength,
+    IN     BOOLEAN                              IsNewTransfer,
+    IN OUT UINT8                                *DataToggle,
+    IN     UINTN                                PollingInterval,
+    IN     UINTN                                DataLength,
+    IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR   *Translator,
+    IN     EFI_ASYNC_USB_TRANSFER_CALLBACK      CallBackFunction,
+    IN     VOID                                 *Context
+    )
+{
+    EFI_STATUS Status;
+    EFI_TPL OldTpl;
+    DW_USB_ASYNC_TRANSFER *Transfer;
+
+    if ((EndPointAddress & USB_ENDPOINT_DIR_IN) == 0) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (!IsNewTransfer) {
+        OldTpl = gBS->RaiseTPL(DW_USB_TPL);
+        Status = DwUsbAsyncTransferRemove(DeviceAddress, EndPointAddress, DataToggle);
+        gBS->RestoreTPL(OldTpl);
+        return Status;
+    }
+
+    if ((DataLength == 0) || (DataToggle == NULL) || (*DataToggle > 1) ||
+        (PollingInterval < 1) || (PollingInterval > 255) ||
+        (MaximumPacketLength == 0) || (DeviceSpeed > EFI_USB_SPEED_HIGH)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Transfer = AllocateZeroPool(sizeof(*Transfer) + DataLength);
+    if (Transfer == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Transfer->Signature = DW_USB_ASYNC_TRANSFER_SIGNATURE;
+    DwUsbInitPipe(
+        &Transfer->Pipe,
+        DeviceAddress,
+        EndPointAddress,
+        DWUSB_EPTYPE_INTERRUPT,
+        DeviceSpeed,
+        MaximumPacketLength,
+        Translator);
+    Transfer->Pid = (*DataToggle != 0) ? DWUSB_PID_DATA1 : DWUSB_PID_DATA0;
+    Transfer->DataLength = DataLength;
+    Transfer->Data = (UINT8*)(Transfer + 1);
+    Transfer->CallBack = CallBackFunction;
+    Transfer->Context = Context;
+
+    // Every transfer is polled from its own timer, the core has no periodic
+    // schedule the driver would have to walk
+    Status = gBS->CreateEvent(
+        EVT_TIMER | EVT_NOTIFY_SIGNAL,
+        DW_USB_TPL,
+        DwUsbAsyncPoll,
+        Transfer,
+        &Transfer->PollEvent);
+    if (!EFI_ERROR(Status)) {
+        Status = gBS->SetTimer(Transfer->PollEvent, TimerPeriodic, EFI_TIMER_PERIOD_MILLISECONDS(PollingInterval));
+    }
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbAsyncInterruptTransfer(): Failed to create the poll timer. %r\n", Status));
+        if (Transfer->PollEvent != NULL) {
+            gBS->CloseEvent(Transfer->PollEvent);
+        }
+        FreePool(Transfer);
+        return Status;
+    }
+
+    OldTpl = gBS->RaiseTPL(DW_USB_TPL);
+    InsertTailList(&mAsyncTransfers, &Transfer->Link);
+    gBS->RestoreTPL(OldTpl);
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbSyncInterruptTransfer(
+    IN     EFI_USB2_HC_PROTOCOL                 *This,
+    IN     UINT8                                DeviceAddress,
+    IN     UINT8                                EndPointAddress,
+    IN     UINT8                                DeviceSpeed,
+    IN     UINTN                                MaximumPacketLength,
+    IN OUT VOID                                 *Data,
+    IN OUT UINTN                                *DataLength,
+    IN OUT UINT8                                *DataToggle,
+    IN     UINTN                                TimeOut,
+    IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR   *Translator,
+    OUT    UINT32                               *TransferResult
+    )
+{
+    EFI_STATUS Status;
+    EFI_TPL OldTpl;
+    DW_USB_PIPE Pipe;
+    UINT8 Pid;
+
+    if ((Data == NULL) || (DataLength == NULL) || (*DataLength == 0) ||
+        (DataToggle == NULL) || (*DataToggle > 1) || (TransferResult == NULL) ||
+        ((EndPointAddress & USB_ENDPOINT_DIR_IN) == 0) ||
+        (MaximumPacketLength == 0) || (DeviceSpeed > EFI_USB_SPEED_HIGH)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    DwUsbInitPipe(&Pipe, DeviceAddress, EndPointAddress, DWUSB_EPTYPE_INTERRUPT, DeviceSpeed, MaximumPacketLength, Translator);
+    Pid = (*DataToggle != 0) ? DWUSB_PID_DATA1 : DWUSB_PID_DATA0;
+
+    OldTpl = gBS->RaiseTPL(DW_USB_TPL);
+    Status = DwUsbTransfer(&Pipe, &Pid, Data, DataLength, DwUsbDeadline(TimeOut * 1000), FALSE, TransferResult);
+    gBS->RestoreTPL(OldTpl);
+
+    *DataToggle = (Pid == DWUSB_PID_DATA1) ? 1 : 0;
+
+    return Status;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbIsochronousTransfer(
+    IN     EFI_USB2_HC_PROTOCOL                 *This,
+    IN     UINT8                                DeviceAddress,
+    IN     UINT8                                EndPointAddress,
+    IN     UINT8                                DeviceSpeed,
+    IN     UINTN                                MaximumPacketLength,
+    IN     UINT8                                DataBuffersNumber,
+    IN OUT VOID                                 *Data[EFI_USB_MAX_ISO_BUFFER_NUM],
+    IN     UINTN                                DataLength,
+    IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR   *Translator,
+    OUT    UINT32                               *TransferResult
+    )
+{
+    return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbAsyncIsochronousTransfer(
+    IN     EFI_USB2_HC_PROTOCOL                 *This,
+    IN     UINT8                                DeviceAddress,
+    IN     UINT8                                EndPointAddress,
+    IN     UINT8                                DeviceSpeed,
+    IN     UINTN                                MaximumPacketLength,
+    IN     UINT8                                DataBuffersNumber,
+    IN OUT VOID                                 *Data[EFI_USB_MAX_ISO_BUFFER_NUM],
+    IN     UINTN                                DataLength,
+    IN     EFI_USB2_HC_TRANSACTION_TRANSLATOR   *Translator,
+    IN     EFI_ASYNC_USB_TRANSFER_CALLBACK      IsochronousCallBack,
+    IN     VOID                                 *Context
+    )
+{
+    return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbGetRootHubPortStatus(
+    IN  EFI_USB2_HC_PROTOCOL    *This,
+    IN  UINT8                   PortNumber,
+    OUT EFI_USB_PORT_STATUS     *PortStatus
+    )
+{
+    UINT32 Hprt;
+
+    if ((PortNumber != 0) || (PortStatus == NULL)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Hprt = MmioRead32(DWUSB_HPRT);
+    PortStatus->PortStatus = 0;
+    PortStatus->PortChangeStatus = 0;
+
+    if ((Hprt & DWUSB_HPRT_CONN_STS) != 0) {
+        PortStatus->PortStatus |= USB_PORT_STAT_CONNECTION;
+
+        if (DWUSB_HPRT_SPD(Hprt) == DWUSB_HPRT_SPD_HIGH) {
+            PortStatus->PortStatus |= USB_PORT_STAT_HIGH_SPEED;
+        } else if (DWUSB_HPRT_SPD(Hprt) == DWUSB_HPRT_SPD_LOW) {
+            PortStatus->PortStatus |= USB_PORT_STAT_LOW_SPEED;
+        }
+    }
+    if ((Hprt & DWUSB_HPRT_ENA) != 0) {
+        PortStatus->PortStatus |= USB_PORT_STAT_ENABLE;
+    }
+    if ((Hprt & DWUSB_HPRT_SUSP) != 0) {
+        PortStatus->PortStatus |= USB_PORT_STAT_SUSPEND;
+    }
+    if ((Hprt & DWUSB_HPRT_OVRCURR_ACT) != 0) {
+        PortStatus->PortStatus |= USB_PORT_STAT_OVERCURRENT;
+    }
+    if ((Hprt & DWUSB_HPRT_RST) != 0) {
+        PortStatus->PortStatus |= USB_PORT_STAT_RESET;
+    }
+    if ((Hprt & DWUSB_HPRT_PWR) != 0) {
+        PortStatus->PortStatus |= USB_PORT_STAT_POWER;
+    }
+
+    if ((Hprt & DWUSB_HPRT_CONN_DET) != 0) {
+        PortStatus->PortChangeStatus |= USB_PORT_STAT_C_CONNECTION;
+    }
+    if ((Hprt & DWUSB_HPRT_ENA_CHNG) != 0) {
+        PortStatus->PortChangeStatus |= USB_PORT_STAT_C_ENABLE;
+    }
+    if ((Hprt & DWUSB_HPRT_OVRCURR_CHNG) != 0) {
+        PortStatus->PortChangeStatus |= USB_PORT_STAT_C_OVERCURRENT;
+    }
+    if (mPortResetChange) {
+        PortStatus->PortChangeStatus |= USB_PORT_STAT_C_RESET;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbSetRootHubPortFeature(
+    IN EFI_USB2_HC_PROTOCOL     *This,
+    IN UINT8                    PortNumber,
+    IN EFI_USB_PORT_FEATURE     PortFeature
+    )
+{
+    UINT32 Hprt;
+
+    if (PortNumber != 0) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Hprt = MmioRead32(DWUSB_HPRT) & ~DWUSB_HPRT_W1C_MASK;
+
+    switch (PortFeature) {
+    case EfiUsbPortEnable:
+        // The port is enabled by the end of its reset
+        break;
+
+    case EfiUsbPortSuspend:
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_SUSP);
+        break;
+
+    case EfiUsbPortReset:
+        mPortResetChange = FALSE;
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_RST);
+        break;
+
+    case EfiUsbPortPower:
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_PWR);
+        break;
+
+    case EfiUsbPortOwner:
+        // No companion controller
+        break;
+
+    default:
+        return EFI_INVALID_PARAMETER;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+DwUsbClearRootHubPortFeature(
+    IN EFI_USB2_HC_PROTOCOL     *This,
+    IN UINT8                    PortNumber,
+    IN EFI_USB_PORT_FEATURE     PortFeature
+    )
+{
+    UINT32 Hprt;
+
+    if (PortNumber != 0) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Hprt = MmioRead32(DWUSB_HPRT) & ~DWUSB_HPRT_W1C_MASK;
+
+    switch (PortFeature) {
+    case EfiUsbPortEnable:
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_ENA);
+        break;
+
+    case EfiUsbPortSuspend:
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_RES);
+        gBS->Stall(PORT_RESUME_STALL_US);
+        MmioWrite32(DWUSB_HPRT, Hprt & ~(DWUSB_HPRT_RES | DWUSB_HPRT_SUSP));
+        break;
+
+    case EfiUsbPortReset:
+        MmioWrite32(DWUSB_HPRT, Hprt & ~DWUSB_HPRT_RST);
+        mPortResetChange = TRUE;
+        break;
+
+    case EfiUsbPortPower:
+        MmioWrite32(DWUSB_HPRT, Hprt & ~DWUSB_HPRT_PWR);
+        break;
+
+    case EfiUsbPortOwner:
+    case EfiUsbPortSuspendChange:
+        break;
+
+    case EfiUsbPortConnectChange:
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_CONN_DET);
+        break;
+
+    case EfiUsbPortEnableChange:
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_ENA_CHNG);
+        break;
+
+    case EfiUsbPortOverCurrentChange:
+        MmioWrite32(DWUSB_HPRT, Hprt | DWUSB_HPRT_OVRCURR_CHNG);
+        break;
+
+    case EfiUsbPortResetChange:
+        mPortResetChange = FALSE;
+        break;
+
+    default:
+        return EFI_INVALID_PARAMETER;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_USB2_HC_PROTOCOL gDwUsb2Hc = {
+    DwUsbGetCapability,
+    DwUsbReset,
+    DwUsbGetState,
+    DwUsbSetState,
+    DwUsbControlTransferEntry,
+    DwUsbBulkTransfer,
+    DwUsbAsyncInterruptTransfer,
+    DwUsbSyncInterruptTransfer,
+    DwUsbIsochronousTransfer,
+    DwUsbAsyncIsochronousTransfer,
+    DwUsbGetRootHubPortStatus,
+    DwUsbSetRootHubPortFeature,
+    DwUsbClearRootHubPortFeature,
+    0x2, // MajorRevision
+    0x0, // MinorRevision
+};
+
+EFI_STATUS
+EFIAPI
+DwUsbHostInitialize(
+    IN EFI_HANDLE           ImageHandle,
+    IN EFI_SYSTEM_TABLE     *SystemTable
+    )
+{
+    EFI_STATUS Status;
+    EFI_HANDLE Handle = NULL;
+
+    Status = DwUsbCoreInitialize();
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Status = DwUsbTransferInitialize();
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    mState = EfiUsbHcStateOperational;
+
+    Status = gBS->InstallMultipleProtocolInterfaces(
+        &Handle,
+        &gEfiUsb2HcProtocolGuid, &gDwUsb2Hc,
+        &gEfiDevicePathProtocolGuid, &gDwUsbDevicePath,
+        NULL
+        );
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "DwUsbHost: Failed to install the USB2 host controller protocol. %r\n", Status));
+        return Status;
+    }
+
+    DEBUG((
+        DEBUG_INIT,
+        "DwUsbHost: DWC2 core 0x%08x, %d host channels\n",
+        MmioRead32(DWUSB_GSNPSID),
+        mChannelCount));
+
+    return EFI_SUCCESS;
+}
@@ -0,0 +1,112 @@
+/** @file
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __DWUSBHOSTDXE_H__
+#define __DWUSBHOSTDXE_H__
+
+#include <Uefi.h>
+
+#include <IndustryStandard/Usb.h>
+#include <Protocol/Usb2HostController.h>
+
+// All the transfers are serialized at this TPL on a single channel, the
+// asynchronous interrupt transfers are polled from timer events at it too
+#define DW_USB_TPL                          TPL_NOTIFY
+#define DW_USB_CHANNEL                      0
+
+// Transfers the DMA engine can't do straight from the caller buffer go
+// through this cached bounce buffer, one chunk at a time
+#define DW_USB_BOUNCE_SIZE                  SIZE_64KB
+
+// Transaction errors tolerated in a row before the transfer fails
+#define DW_USB_MAX_XACT_ERRORS              3
+// Complete splits answered NYET before an interrupt split is restarted
+#define DW_USB_MAX_SPLIT_NYETS              8
+// Longest wait for a channel to halt once it was disabled
+#define DW_USB_CHANNEL_HALT_TIMEOUT_US      10000 // 10ms
+// A poll of an asynchronous interrupt transfer takes a few (micro)frames
+#define DW_USB_ASYNC_POLL_TIMEOUT_US        20000 // 20ms
+
+typedef struct {
+    UINT8       DeviceAddress;
+    UINT8       EndPointNumber;
+    BOOLEAN     IsIn;
+    UINT8       Type;           // DWUSB_EPTYPE_*
+    UINT8       DeviceSpeed;    // EFI_USB_SPEED_*
+    UINT32      MaxPacket;
+    // Transaction translator of a low/full speed device behind a high speed
+    // hub, the hub address is 0 when the transactions aren't split
+    UINT8       HubAddress;
+    UINT8       PortNumber;
+} DW_USB_PIPE;
+
+#define DW_USB_ASYNC_TRANSFER_SIGNATURE     SIGNATURE_32('d', 'w', 'u', 'a')
+
+typedef struct {
+    UINT32                              Signature;
+    LIST_ENTRY                          Link;
+    DW_USB_PIPE                         Pipe;
+    UINT8                               Pid;
+    UINTN                               DataLength;
+    UINT8                               *Data;
+    EFI_EVENT                           PollEvent;
+    EFI_ASYNC_USB_TRANSFER_CALLBACK     CallBack;
+    VOID                                *Context;
+} DW_USB_ASYNC_TRANSFER;
+
+#define DW_USB_ASYNC_TRANSFER_FROM_LINK(a) \
+    CR(a, DW_USB_ASYNC_TRANSFER, Link, DW_USB_ASYNC_TRANSFER_SIGNATURE)
+
+//
+// DwUsbTransfer.c
+//
+
+EFI_STATUS
+DwUsbTransferInitialize(
+    VOID
+    );
+
+UINT64
+DwUsbDeadline(
+    IN UINTN    TimeoutUs
+    );
+
+EFI_STATUS
+DwUsbTransfer(
+    IN     DW_USB_PIPE  *Pipe,
+    IN OUT UINT8        *Pid,
+    IN OUT VOID         *Data,
+    IN OUT UINTN        *DataLength,
+    IN     UINT64       Deadline,
+    IN     BOOLEAN      IsPoll,
+    OUT    UINT32       *TransferResult
+    );
+
+EFI_STATUS
+DwUsbControlTransfer(
+    IN     DW_USB_PIPE              *Pipe,
+    IN     EFI_USB_DEVICE_REQUEST   *Request,
+    IN     EFI_USB_DATA_DIRECTION   TransferDirection,
+    IN OUT VOID                     *Data,
+    IN OUT UINTN                    *DataLength,
+    IN     UINT64                   Deadline,
+    OUT    UINT32                   *TransferResult
+    );
+
+VOID
+DwUsbChannelHalt(
+    IN UINT32   Channel
+    );
+
+#endif // __DWUSBHOSTDXE_H__
@@ -0,0 +1,517 @@
+/** @file
+*
+*  Transfers of the DWC2 host controller, run in buffer DMA mode on a single
+*  host channel.
+*
+*  Without split transactions a whole chunk of a transfer, up to the limits of
+*  the HCTSIZ transfer size and packet count fields, is handed to the channel
+*  at once and the core retries the NAKed packets on its own. Low and full
+*  speed devices behind the high speed hub are reached one packet at a time
+*  through start and complete splits sent to its transaction translator.
+*
+*  Large bulk transfers move straight from and to the caller buffer when the
+*  cache maintenance on it is safe, everything else goes through a bounce
+*  buffer.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+#include <Library/ArmLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/CacheMaintenanceLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+
+#include <Bcm2836.h>
+#include <Bcm2836Usb.h>
+
+#include "DwUsbHostDxe.h"
+
+// The core masters the bus through the VideoCore uncached alias of the memory
+#define DW_USB_BUS_ADDRESS(X)       ((UINT32)(UINTN)(X) | UNCACHED_ADDRESS_MASK)
+
+STATIC UINT8 *mBounce = NULL;
+STATIC EFI_USB_DEVICE_REQUEST *mSetup = NULL;
+STATIC UINT32 mMaxTransferSize = 0;
+STATIC UINT32 mMaxPacketCount = 0;
+STATIC UINTN mCacheLineMask = 0;
+
+UINT64
+DwUsbDeadline(
+    IN UINTN    TimeoutUs
+    )
+{
+    UINT64 Frequency;
+
+    // No timeout, the transfer runs until it completes or fails
+    if (TimeoutUs == 0) {
+        return MAX_UINT64;
+    }
+
+    Frequency = GetPerformanceCounterProperties(NULL, NULL);
+    return GetPerformanceCounter() + DivU64x32(MultU64x32(Frequency, (UINT32)TimeoutUs), 1000000);
+}
+
+STATIC
+BOOLEAN
+DwUsbIsExpired(
+    IN UINT64   Deadline
+    )
+{
+    return GetPerformanceCounter() > Deadline;
+}
+
+VOID
+DwUsbChannelHalt(
+    IN UINT32   Channel
+    )
+{
+    UINT32 Hcchar = MmioRead32(DWUSB_HCCHAR(Channel));
+    UINT64 Deadline;
+
+    if ((Hcchar & DWUSB_HCCHAR_CHENA) == 0) {
+        return;
+    }
+
+    MmioWrite32(DWUSB_HCCHAR(Channel), Hcchar | DWUSB_HCCHAR_CHDIS | DWUSB_HCCHAR_CHENA);
+
+    Deadline = DwUsbDeadline(DW_USB_CHANNEL_HALT_TIMEOUT_US);
+    while ((MmioRead32(DWUSB_HCCHAR(Channel)) & DWUSB_HCCHAR_CHENA) != 0) {
+        if (DwUsbIsExpired(Deadline)) {
+            DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbChannelHalt(): Channel %d doesn't halt\n", Channel));
+            break;
+        }
+    }
+}
+
+/**
+  Runs the channel once, until the core halts it or the deadline passes.
+
+  @retval EFI_SUCCESS       The channel halted, Hcint tells why.
+  @retval EFI_TIMEOUT       The deadline passed, the channel was disabled.
+**/
+STATIC
+EFI_STATUS
+DwUsbChannelRun(
+    IN  UINT32  Hcchar,
+    IN  UINT32  Hcsplt,
+    IN  UINT32  Hctsiz,
+    IN  UINT32  BusAddress,
+    IN  UINT64  Deadline,
+    OUT UINT32  *Hcint
+    )
+{
+    MmioWrite32(DWUSB_HCINT(DW_USB_CHANNEL), DWUSB_HCINT_ALL);
+    MmioWrite32(DWUSB_HCSPLT(DW_USB_CHANNEL), Hcsplt);
+    MmioWrite32(DWUSB_HCTSIZ(DW_USB_CHANNEL), Hctsiz);
+    MmioWrite32(DWUSB_HCDMA(DW_USB_CHANNEL), BusAddress);
+
+    // Periodic transactions go out in the (micro)frame parity selected by
+    // OddFrm, ask for the next one
+    if (((Hcchar & DWUSB_HCCHAR_EPTYPE(0x3)) == DWUSB_HCCHAR_EPTYPE(DWUSB_EPTYPE_INTERRUPT)) &&
+        ((DWUSB_HFNUM_FRNUM(MmioRead32(DWUSB_HFNUM)) & 1) == 0)) {
+        Hcchar |= DWUSB_HCCHAR_ODDFRM;
+    }
+
+    // The buffers must have reached memory before the core fetches them
+    ArmDataSyncronizationBarrier();
+    MmioWrite32(DWUSB_HCCHAR(DW_USB_CHANNEL), Hcchar | DWUSB_HCCHAR_CHENA);
+
+    for (;;) {
+        *Hcint = MmioRead32(DWUSB_HCINT(DW_USB_CHANNEL));
+        if ((*Hcint & DWUSB_HCINT_CHHLTD) != 0) {
+            return EFI_SUCCESS;
+        }
+
+        if (DwUsbIsExpired(Deadline)) {
+            DwUsbChannelHalt(DW_USB_CHANNEL);
+            *Hcint = MmioRead32(DWUSB_HCINT(DW_USB_CHANNEL));
+            return EFI_TIMEOUT;
+        }
+    }
+}
+
+/**
+  Moves Length bytes at BusAddress, which has room for the whole packets of
+  an IN transfer, from or to the endpoint.
+
+  @param  Pipe              The endpoint.
+  @param  Pid               Data PID of the first packet, on return the one of
+                            the packet following the last one transferred.
+  @param  BusAddress        Bus address of the data.
+  @param  Length            Number of bytes to transfer.
+  @param  Deadline          Performance counter value at which the transfer
+                            times out.
+  @param  IsPoll            A NAK ends the transfer instead of being retried.
+  @param  Transferred       Number of bytes transferred.
+  @param  TransferResult    EFI_USB_ERR_* bits of the failure.
+
+  @retval EFI_SUCCESS       The transfer completed, possibly short.
+  @retval EFI_NOT_READY     A poll was NAKed.
+  @retval EFI_TIMEOUT       The deadline passed.
+  @retval EFI_DEVICE_ERROR  The transfer failed.
+**/
+STATIC
+EFI_STATUS
+DwUsbChannelTransfer(
+    IN     DW_USB_PIPE  *Pipe,
+    IN OUT UINT8        *Pid,
+    IN     UINT32       BusAddress,
+    IN     UINT32       Length,
+    IN     UINT64       Deadline,
+    IN     BOOLEAN      IsPoll,
+    OUT    UINT32       *Transferred,
+    OUT    UINT32       *TransferResult
+    )
+{
+    EFI_STATUS Status;
+    BOOLEAN IsSplit = (Pipe->HubAddress != 0) && (Pipe->DeviceSpeed != EFI_USB_SPEED_HIGH);
+    UINT32 Hcchar;
+    UINT32 Hcsplt = 0;
+    UINT32 Hctsiz;
+    UINT32 Hcint;
+    UINT32 Remaining;
+    UINT32 Packets;
+    UINT32 Size;
+    UINT32 Done;
+    UINTN XactErrors = 0;
+    UINTN Nyets;
+
+    Hcchar =
+        DWUSB_HCCHAR_MPS(Pipe->MaxPacket) |
+        DWUSB_HCCHAR_EPNUM(Pipe->EndPointNumber) |
+        DWUSB_HCCHAR_EPTYPE(Pipe->Type) |
+        DWUSB_HCCHAR_MC(1) |
+        DWUSB_HCCHAR_DEVADDR(Pipe->DeviceAddress);
+    if (Pipe->IsIn) {
+        Hcchar |= DWUSB_HCCHAR_EPDIR_IN;
+    }
+    if (Pipe->DeviceSpeed == EFI_USB_SPEED_LOW) {
+        Hcchar |= DWUSB_HCCHAR_LSPDDEV;
+    }
+
+    if (IsSplit) {
+        Hcsplt =
+            DWUSB_HCSPLT_SPLTENA |
+            DWUSB_HCSPLT_HUBADDR(Pipe->HubAddress) |
+            DWUSB_HCSPLT_PRTADDR(Pipe->PortNumber) |
+            DWUSB_HCSPLT_XACTPOS_ALL;
+    }
+
+    *Transferred = 0;
+
+    for (;;) {
+        Remaining = Length - *Transferred;
+        if (IsSplit) {
+            Packets = 1;
+            Size = MIN(Remaining, Pipe->MaxPacket);
+        } else {
+            Packets = (Remaining == 0) ? 1 : ((Remaining + Pipe->MaxPacket - 1) / Pipe->MaxPacket);
+            Size = Remaining;
+        }
+        // IN transfers always cover whole packets
+        if (Pipe->IsIn) {
+            Size = Packets * Pipe->MaxPacket;
+        }
+        Hctsiz = DWUSB_HCTSIZ_XFERSIZE(Size) | DWUSB_HCTSIZ_PKTCNT(Packets) | DWUSB_HCTSIZ_PID(*Pid);
+
+        Status = DwUsbChannelRun(Hcchar, Hcsplt, Hctsiz, BusAddress + *Transferred, Deadline, &Hcint);
+
+        // The translator took the start split, collect the outcome of the
+        // transaction with complete splits. A periodic one that isn't there
+        // after a few microframes is started again
+        if (!EFI_ERROR(Status) && IsSplit && ((Hcint & DWUSB_HCINT_ACK) != 0)) {
+            Nyets = 0;
+            do {
+                Status = DwUsbChannelRun(
+                    Hcchar,
+                    Hcsplt | DWUSB_HCSPLT_COMPSPLT,
+                    Hctsiz,
+                    BusAddress + *Transferred,
+                    Deadline,
+                    &Hcint);
+            } while (!EFI_ERROR(Status) &&
+                     ((Hcint & DWUSB_HCINT_NYET) != 0) &&
+                     ((Pipe->Type != DWUSB_EPTYPE_INTERRUPT) || (++Nyets < DW_USB_MAX_SPLIT_NYETS)));
+        }
+
+        // A split packet is either transferred or not at all, the channel
+        // counters are only meaningful once it completed
+        Hctsiz = MmioRead32(DWUSB_HCTSIZ(DW_USB_CHANNEL));
+        Done = 0;
+        if (!IsSplit || ((Hcint & DWUSB_HCINT_XFERCOMPL) != 0)) {
+            if (Pipe->IsIn) {
+                Done = Size - DWUSB_HCTSIZ_GET_XFERSIZE(Hctsiz);
+            } else {
+                Done = MIN((Packets - DWUSB_HCTSIZ_GET_PKTCNT(Hctsiz)) * Pipe->MaxPacket, Size);
+            }
+            *Pid = (UINT8)DWUSB_HCTSIZ_GET_PID(Hctsiz);
+        }
+        *Transferred += MIN(Done, Remaining);
+        if (Done != 0) {
+            XactErrors = 0;
+        }
+
+        if (Status == EFI_TIMEOUT) {
+            *TransferResult |= EFI_USB_ERR_TIMEOUT;
+            return EFI_TIMEOUT;
+        }
+
+        if ((Hcint & DWUSB_HCINT_XFERCOMPL) != 0) {
+            // Split transfers move a packet at a time, a short one ends them
+            if (IsSplit && (*Transferred < Length) && (!Pipe->IsIn || (Done == Pipe->MaxPacket))) {
+                continue;
+            }
+            return EFI_SUCCESS;
+        }
+
+        if ((Hcint & DWUSB_HCINT_AHBERR) != 0) {
+            DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbChannelTransfer(): AHB error at 0x%08x\n", BusAddress + *Transferred));
+            *TransferResult |= EFI_USB_ERR_SYSTEM;
+            return EFI_DEVICE_ERROR;
+        }
+
+        if ((Hcint & DWUSB_HCINT_STALL) != 0) {
+            *TransferResult |= EFI_USB_ERR_STALL;
+            return EFI_DEVICE_ERROR;
+        }
+
+        if ((Hcint & DWUSB_HCINT_BBLERR) != 0) {
+            *TransferResult |= EFI_USB_ERR_BABBLE;
+            return EFI_DEVICE_ERROR;
+        }
+
+        if ((Hcint & (DWUSB_HCINT_NAK | DWUSB_HCINT_NYET)) != 0) {
+            if (IsPoll) {
+                if (*Transferred != 0) {
+                    return EFI_SUCCESS;
+                }
+                *TransferResult |= EFI_USB_ERR_NAK;
+                return EFI_NOT_READY;
+            }
+        } else if ((Hcint & (DWUSB_HCINT_XACTERR | DWUSB_HCINT_DATATGLERR | DWUSB_HCINT_FRMOVRUN)) != 0) {
+            if (++XactErrors > DW_USB_MAX_XACT_ERRORS) {
+                DEBUG((
+                    DEBUG_ERROR,
+                    "DwUsbHost: DwUsbChannelTransfer(): Device %d EP%d transaction errors, HCINT: 0x%08x\n",
+                    Pipe->DeviceAddress,
+                    Pipe->EndPointNumber,
+                    Hcint));
+                *TransferResult |= EFI_USB_ERR_TIMEOUT;
+                return EFI_DEVICE_ERROR;
+            }
+        } else {
+            DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbChannelTransfer(): Unexpected halt, HCINT: 0x%08x\n", Hcint));
+            *TransferResult |= EFI_USB_ERR_SYSTEM;
+            return EFI_DEVICE_ERROR;
+        }
+
+        // Retry what is left of the transfer
+        if (DwUsbIsExpired(Deadline)) {
+            *TransferResult |= EFI_USB_ERR_TIMEOUT;
+            return EFI_TIMEOUT;
+        }
+    }
+}
+
+/**
+  The core only moves whole words, and a buffer it writes to must not share
+  cache lines with anything else or invalidating them would lose data.
+  Transfers too short to pay off the cache maintenance of the caller buffer
+  aren't worth the check.
+**/
+STATIC
+BOOLEAN
+DwUsbIsDirectTransfer(
+    IN DW_USB_PIPE  *Pipe,
+    IN UINT8        *Buffer,
+    IN UINTN        Length
+    )
+{
+    if ((Pipe->Type != DWUSB_EPTYPE_BULK) || (Length == 0) || (((UINTN)Buffer & (sizeof(UINT32) - 1)) != 0)) {
+        return FALSE;
+    }
+
+    if (Pipe->IsIn) {
+        return ((((UINTN)Buffer | Length) & mCacheLineMask) == 0) && ((Length % Pipe->MaxPacket) == 0);
+    }
+
+    return TRUE;
+}
+
+EFI_STATUS
+DwUsbTransfer(
+    IN     DW_USB_PIPE  *Pipe,
+    IN OUT UINT8        *Pid,
+    IN OUT VOID         *Data,
+    IN OUT UINTN        *DataLength,
+    IN     UINT64       Deadline,
+    IN     BOOLEAN      IsPoll,
+    OUT    UINT32       *TransferResult
+    )
+{
+    EFI_STATUS Status;
+    UINT8 *Buffer = (UINT8*)Data;
+    UINTN Length = *DataLength;
+    UINTN Offset = 0;
+    UINTN MaxChunk;
+    UINTN BounceChunk;
+    UINTN Chunk;
+    UINTN DmaLength;
+    UINT8 *DmaBuffer;
+    BOOLEAN IsDirect;
+    UINT32 Done;
+
+    MaxChunk = MIN(mMaxTransferSize, mMaxPacketCount * Pipe->MaxPacket);
+    MaxChunk -= MaxChunk % Pipe->MaxPacket;
+    BounceChunk = DW_USB_BOUNCE_SIZE - (DW_USB_BOUNCE_SIZE % Pipe->MaxPacket);
+
+    *TransferResult = EFI_USB_NOERROR;
+
+    do {
+        IsDirect = DwUsbIsDirectTransfer(Pipe, Buffer + Offset, Length - Offset);
+        if (IsDirect) {
+            Chunk = MIN(Length - Offset, MaxChunk);
+            DmaBuffer = Buffer + Offset;
+        } else {
+            Chunk = MIN(Length - Offset, MIN(MaxChunk, BounceChunk));
+            DmaBuffer = mBounce;
+        }
+
+        if (Pipe->IsIn) {
+            DmaLength = MAX((Chunk + Pipe->MaxPacket - 1) / Pipe->MaxPacket, 1) * Pipe->MaxPacket;
+            // No dirty line may be written back over the data of the core
+            InvalidateDataCacheRange(DmaBuffer, DmaLength);
+        } else {
+            DmaLength = Chunk;
+            if (!IsDirect) {
+                CopyMem(mBounce, Buffer + Offset, Chunk);
+            }
+            WriteBackDataCacheRange(DmaBuffer, Chunk);
+        }
+
+        Status = DwUsbChannelTransfer(
+            Pipe,
+            Pid,
+            DW_USB_BUS_ADDRESS(DmaBuffer),
+            (UINT32)Chunk,
+            Deadline,
+            IsPoll,
+            &Done,
+            TransferResult);
+
+        if (Pipe->IsIn && (Done != 0)) {
+            // Drop the lines speculatively fetched while the core was writing
+            InvalidateDataCacheRange(DmaBuffer, DmaLength);
+            if (!IsDirect) {
+                CopyMem(Buffer + Offset, mBounce, Done);
+            }
+        }
+
+        Offset += Done;
+    } while (!EFI_ERROR(Status) && (Done == Chunk) && (Offset < Length));
+
+    *DataLength = Offset;
+    return Status;
+}
+
+EFI_STATUS
+DwUsbControlTransfer(
+    IN     DW_USB_PIPE              *Pipe,
+    IN     EFI_USB_DEVICE_REQUEST   *Request,
+    IN     EFI_USB_DATA_DIRECTION   TransferDirection,
+    IN OUT VOID                     *Data,
+    IN OUT UINTN                    *DataLength,
+    IN     UINT64                   Deadline,
+    OUT    UINT32                   *TransferResult
+    )
+{
+    EFI_STATUS Status;
+    UINT8 Pid;
+    UINT32 Done;
+
+    *TransferResult = EFI_USB_NOERROR;
+
+    // Setup stage
+    CopyMem(mSetup, Request, sizeof(*mSetup));
+    WriteBackDataCacheRange(mSetup, sizeof(*mSetup));
+    Pipe->IsIn = FALSE;
+    Pid = DWUSB_PID_SETUP;
+    Status = DwUsbChannelTransfer(
+        Pipe,
+        &Pid,
+        DW_USB_BUS_ADDRESS(mSetup),
+        sizeof(*mSetup),
+        Deadline,
+        FALSE,
+        &Done,
+        TransferResult);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    // Data stage
+    if ((TransferDirection != EfiUsbNoData) && (*DataLength != 0)) {
+        Pipe->IsIn = (TransferDirection == EfiUsbDataIn);
+        Pid = DWUSB_PID_DATA1;
+        Status = DwUsbTransfer(Pipe, &Pid, Data, DataLength, Deadline, FALSE, TransferResult);
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+    }
+
+    // Status stage, a zero length packet in the other direction. Whatever a
+    // broken device sends lands after the setup packet
+    Pipe->IsIn = (TransferDirection != EfiUsbDataIn);
+    Pid = DWUSB_PID_DATA1;
+    return DwUsbChannelTransfer(
+        Pipe,
+        &Pid,
+        DW_USB_BUS_ADDRESS(mSetup + 1),
+        0,
+        Deadline,
+        FALSE,
+        &Done,
+        TransferResult);
+}
+
+EFI_STATUS
+DwUsbTransferInitialize(
+    VOID
+    )
+{
+    UINT32 Hwcfg3 = MmioRead32(DWUSB_GHWCFG3);
+
+    mMaxTransferSize = MIN((1 << DWUSB_GHWCFG3_XFER_SIZE_WIDTH(Hwcfg3)) - 1, DWUSB_HCTSIZ_XFERSIZE(MAX_UINT32));
+    mMaxPacketCount = MIN((1 << DWUSB_GHWCFG3_PKT_COUNT_WIDTH(Hwcfg3)) - 1, DWUSB_HCTSIZ_GET_PKTCNT(MAX_UINT32));
+    mCacheLineMask = ArmDataCacheLineLength() - 1;
+
+    // Both are page aligned so their cache maintenance never touches anything else
+    mBounce = AllocatePages(EFI_SIZE_TO_PAGES(DW_USB_BOUNCE_SIZE));
+    mSetup = AllocatePages(1);
+    if ((mBounce == NULL) || (mSetup == NULL)) {
+        DEBUG((DEBUG_ERROR, "DwUsbHost: DwUsbTransferInitialize(): Failed to allocate the DMA buffers\n"));
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    DEBUG((
+        DEBUG_INIT,
+        "DwUsbHost: Up to 0x%x bytes and %d packets per channel transfer\n",
+        mMaxTransferSize,
+        mMaxPacketCount));
+
+    return EFI_SUCCESS;
+}
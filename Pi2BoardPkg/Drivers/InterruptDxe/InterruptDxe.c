@@ -36,7 +36,23 @@
 EFI_EVENT EfiExitBootServicesEvent = (EFI_EVENT)NULL;
 
 
-HARDWARE_INTERRUPT_HANDLER  gRegisteredInterruptHandlers[INT_CORE_MAX_NUM_VECTORS];
+HARDWARE_INTERRUPT_HANDLER  gRegisteredInterruptHandlers[INT_MAX_NUM_VECTORS];
+
+/**
+  Masks all the GPU peripheral interrupts at the BCM2835 interrupt controller
+**/
+VOID
+DisableGpuInterrupts (
+  VOID
+  )
+{
+    UINT32 Bank;
+
+    for (Bank = 0; Bank < INT_GPU_NUM_BANKS; Bank++)
+    {
+        MmioWrite32 (INT_GPU_DISABLE_IRQS(Bank), 0xFFFFFFFF);
+    }
+}
 
 /**
   Shutdown our hardware
@@ -69,6 +85,8 @@ ExitBootServicesEvent (
         MmioWrite32 (INT_CORE_TIMERS_CONTROL(CoreId), TCtrl);
     }
 
+    DisableGpuInterrupts();
+
     // Add code here to disable all FIQs as debugger may have turned one on
 }
 
@@ -91,7 +109,7 @@ RegisterInterruptSource (
   IN HARDWARE_INTERRUPT_HANDLER         Handler
   )
 {
-    if (Source > INT_CORE_MAX_VECTOR)
+    if (Source > INT_MAX_VECTOR)
     {
         ASSERT(FALSE);
         return EFI_UNSUPPORTED;
@@ -141,7 +159,7 @@ EnableInterruptSource (
 {
     UINTN CoreId = 0;
 
-    if (Source > INT_CORE_MAX_VECTOR)
+    if (Source > INT_MAX_VECTOR)
     {
         ASSERT(FALSE);
         return EFI_UNSUPPORTED;
@@ -149,9 +167,17 @@ EnableInterruptSource (
 
     // TODO: Assign the Core ID
 
-    // TODO: Only supports Timer sources for now.
+    // GPU interrupts reach the core through INT_CORE_GPU_SOURCE, which is always routed
+    if (INT_IS_GPU_SOURCE(Source))
+    {
+        UINT32 Irq = Source - INT_GPU_SOURCE(0);
+
+        DEBUG ((DEBUG_TIMER_INT, "EnableInterruptSource: Source=0x%x GPU IRQ=%d\n", Source, Irq));
+
+        MmioWrite32 (INT_GPU_ENABLE_IRQS(Irq / 32), 1UL << (Irq % 32));
+    }
     // Check to see if this is the Timer interrupt block (Sources 0-3)
-    if (Source < 4)
+    else if (Source < 4)
     {
         UINT32 Bit   = 1UL << Source;
         UINT32 TCtrl = MmioRead32(INT_CORE_TIMERS_CONTROL(CoreId));
@@ -192,16 +218,23 @@ DisableInterruptSource (
 {
     UINTN CoreId = 0;
 
-    if (Source > INT_CORE_MAX_VECTOR) {
+    if (Source > INT_MAX_VECTOR) {
     ASSERT(FALSE);
     return EFI_UNSUPPORTED;
     }
 
     // TODO: Assign the Core ID
 
-    // TODO: Only supports Timer sources for now.
+    if (INT_IS_GPU_SOURCE(Source))
+    {
+        UINT32 Irq = Source - INT_GPU_SOURCE(0);
+
+        DEBUG ((DEBUG_TIMER_INT, "DisableInterruptSource: Source=0x%x GPU IRQ=%d\n", Source, Irq));
+
+        MmioWrite32 (INT_GPU_DISABLE_IRQS(Irq / 32), 1UL << (Irq % 32));
+    }
     // Check to see if this is the Timer interrupt block (Sources 0-3)
-    if (Source < 4)
+    else if (Source < 4)
     {
         UINT32 Bit   = 1UL << Source;
         UINT32 TCtrl = MmioRead32(INT_CORE_TIMERS_CONTROL(CoreId));
@@ -249,15 +282,22 @@ GetInterruptSourceState (
         return EFI_INVALID_PARAMETER;
     }
 
-    if (Source > INT_CORE_MAX_VECTOR)
+    if (Source > INT_MAX_VECTOR)
     {
         ASSERT(FALSE);
         return EFI_UNSUPPORTED;
     }
 
-    // TODO: Only supports Timer sources for now.
+    // The enable registers of the GPU interrupt controller read back the enabled IRQs
+    if (INT_IS_GPU_SOURCE(Source))
+    {
+        UINT32 Irq = Source - INT_GPU_SOURCE(0);
+        UINT32 Enabled = MmioRead32(INT_GPU_ENABLE_IRQS(Irq / 32));
+
+        *InterruptState = ((Enabled & (1UL << (Irq % 32))) != 0);
+    }
     // Check to see if this is the Timer interrupt block (Sources 0-3)
-    if (Source < 4)
+    else if (Source < 4)
     {
         UINT32 Bit = 1UL << Source;
         UINT32 TCtrl = MmioRead32(INT_CORE_TIMERS_CONTROL(CoreId));
@@ -309,6 +349,52 @@ EndOfInterrupt (
 }
 
 
+VOID
+DispatchInterrupt (
+  IN HARDWARE_INTERRUPT_SOURCE  Source,
+  IN EFI_SYSTEM_CONTEXT         SystemContext
+  )
+{
+    HARDWARE_INTERRUPT_HANDLER Handler = gRegisteredInterruptHandlers[Source];
+
+    if (Handler != NULL)
+    {
+        DEBUG ((DEBUG_TIMER_INT, "IrqInterruptHandler: Source=0x%x Handler=0x%8.8p\n", Source, Handler));
+
+        // Call the registered interrupt handler.
+        Handler (Source, SystemContext);
+    }
+    else
+    {
+        DEBUG ((EFI_D_ERROR, "IrqInterruptHandler: Spurious interrupt, Source=0x%x\n", Source));
+    }
+}
+
+/**
+  Dispatches the pending GPU peripheral interrupts, the pending registers also show
+  the IRQs that are not routed to the ARM so they are filtered with the enabled ones.
+**/
+VOID
+DispatchGpuInterrupts (
+  IN EFI_SYSTEM_CONTEXT SystemContext
+  )
+{
+    UINT32 Bank;
+
+    for (Bank = 0; Bank < INT_GPU_NUM_BANKS; Bank++)
+    {
+        UINT32 Pending = MmioRead32(INT_GPU_IRQ_PENDING(Bank)) & MmioRead32(INT_GPU_ENABLE_IRQS(Bank));
+
+        while (Pending != 0)
+        {
+            UINT32 Irq = (UINT32)LowBitSet32(Pending);
+
+            Pending &= ~(1UL << Irq);
+            DispatchInterrupt (INT_GPU_SOURCE((Bank * 32) + Irq), SystemContext);
+        }
+    }
+}
+
 /**
   EFI_CPU_INTERRUPT_HANDLER that is called when a processor interrupt occurs.
 
@@ -328,7 +414,7 @@ IrqInterruptHandler (
   )
 {
     UINT32 CoreId = 0;
-    UINT32 Source = 0;
+    UINT32 Source;
 
     // There is no obvious conceptual priority or idea on what
     // interrupt source actually fired. Therefore, we just go through
@@ -338,26 +424,19 @@ IrqInterruptHandler (
 
     DEBUG ((DEBUG_TIMER_INT, "IrqInterruptHandler: IrqSrc=0x%x\n", IrqSrc));
 
-    // TODO: For now we only support Timer and Core 0
-    for ( ; Source < 4 ; Source++)
+    // TODO: For now we only support Core 0
+    while (IrqSrc != 0)
     {
-        UINT32 IrqSrcBit = 1UL << Source;
+        Source = (UINT32)LowBitSet32(IrqSrc);
+        IrqSrc &= ~(1UL << Source);
 
-        if ((IrqSrc & IrqSrcBit) == IrqSrcBit)
+        if (Source == INT_CORE_GPU_SOURCE)
         {
-            HARDWARE_INTERRUPT_HANDLER Handler = gRegisteredInterruptHandlers[Source];
-
-            if (Handler != NULL)
-            {
-                DEBUG ((DEBUG_TIMER_INT, "IrqInterruptHandler: Source=0x%x Handler=0x%8.8p\n", Source, Handler));
-
-                // Call the registered interrupt handler.
-                Handler (Source, SystemContext);
-            }
-            else
-            {
-                DEBUG ((EFI_D_ERROR, "IrqInterruptHandler: Spurious interrupt, Source=0x%x\n", Source));
-            }
+            DispatchGpuInterrupts (SystemContext);
+        }
+        else
+        {
+            DispatchInterrupt (Source, SystemContext);
         }
     }
 }
@@ -418,6 +497,9 @@ InterruptDxeInitialize (
 
             MmioWrite32 (INT_CORE_TIMERS_CONTROL(CoreId), TCtrl);
         }
+
+        // Drivers enable their GPU interrupts when they register a handler
+        DisableGpuInterrupts();
     }
 
     Status = gBS->InstallMultipleProtocolInterfaces(&gHardwareInterruptHandle,
@@ -111,17 +111,40 @@ MMC_HOST_INSTANCE* CreateMmcHostInstance (
   MmcHostInstance->BlockIo.WriteBlocks = MmcWriteBlocks;
   MmcHostInstance->BlockIo.FlushBlocks = MmcFlushBlocks;
 
+  MmcHostInstance->BlockIo2.Media = MmcHostInstance->BlockIo.Media;
+  MmcHostInstance->BlockIo2.Reset = MmcResetEx;
+  MmcHostInstance->BlockIo2.ReadBlocksEx = MmcReadBlocksEx;
+  MmcHostInstance->BlockIo2.WriteBlocksEx = MmcWriteBlocksEx;
+  MmcHostInstance->BlockIo2.FlushBlocksEx = MmcFlushBlocksEx;
+
+  // Non-blocking BlockIo2 requests are serviced from this timer event
+  InitializeListHead (&MmcHostInstance->Io2Queue);
+  Status = gBS->CreateEvent (
+                EVT_TIMER | EVT_NOTIFY_SIGNAL,
+                MMC_IO_TPL,
+                MmcIo2QueueCallback,
+                MmcHostInstance,
+                &MmcHostInstance->Io2QueueEvent
+                );
+  if (EFI_ERROR (Status)) {
+    goto FREE_MEDIA;
+  }
+
   MmcHostInstance->MmcHost = MmcHost;
 
+  // The driver still works without its cache, failing to set it up is not fatal
+  MmcCacheInitialize (MmcHostInstance);
+  MmcStatsInitialize (MmcHostInstance);
+
   // Create DevicePath for the new MMC Host
   Status = MmcHost->BuildDevicePath (MmcHost, &NewDevicePathNode);
   if (EFI_ERROR (Status)) {
-    goto FREE_MEDIA;
+    goto CLOSE_EVENT;
   }
 
   DevicePath = (EFI_DEVICE_PATH_PROTOCOL *) AllocatePool (END_DEVICE_PATH_LENGTH);
   if (DevicePath == NULL) {
-    goto FREE_MEDIA;
+    goto CLOSE_EVENT;
   }
 
   SetDevicePathEndNode (DevicePath);
@@ -131,7 +154,9 @@ MMC_HOST_INSTANCE* CreateMmcHostInstance (
   Status = gBS->InstallMultipleProtocolInterfaces (
                 &MmcHostInstance->MmcHandle,
                 &gEfiBlockIoProtocolGuid,&MmcHostInstance->BlockIo,
+                &gEfiBlockIo2ProtocolGuid,&MmcHostInstance->BlockIo2,
                 &gEfiDevicePathProtocolGuid,MmcHostInstance->DevicePath,
+                &gMmcStatsProtocolGuid,&MmcHostInstance->StatsProtocol,
                 NULL
                 );
   if (EFI_ERROR(Status)) {
@@ -143,6 +168,10 @@ MMC_HOST_INSTANCE* CreateMmcHostInstance (
 FREE_DEVICE_PATH:
   FreePool(DevicePath);
 
+CLOSE_EVENT:
+  MmcCacheFree (MmcHostInstance);
+  gBS->CloseEvent (MmcHostInstance->Io2QueueEvent);
+
 FREE_MEDIA:
   FreePool(MmcHostInstance->BlockIo.Media);
 
@@ -158,11 +187,21 @@ EFI_STATUS DestroyMmcHostInstance (
 {
   EFI_STATUS Status;
 
+  // Fail whatever is still queued before the interfaces go away
+  MmcIo2AbortQueue (MmcHostInstance);
+  gBS->CloseEvent (MmcHostInstance->Io2QueueEvent);
+
+  // Write back the cache while the card can still be reached
+  MmcHostInstance->BlockIo.FlushBlocks (&MmcHostInstance->BlockIo);
+  MmcCacheFree (MmcHostInstance);
+
   // Uninstall Protocol Interfaces
   Status = gBS->UninstallMultipleProtocolInterfaces (
         MmcHostInstance->MmcHandle,
         &gEfiBlockIoProtocolGuid,&(MmcHostInstance->BlockIo),
+        &gEfiBlockIo2ProtocolGuid,&(MmcHostInstance->BlockIo2),
         &gEfiDevicePathProtocolGuid,MmcHostInstance->DevicePath,
+        &gMmcStatsProtocolGuid,&(MmcHostInstance->StatsProtocol),
         NULL
         );
   ASSERT_EFI_ERROR (Status);
@@ -363,6 +402,9 @@ CheckCardsCallback (
     ASSERT(MmcHostInstance != NULL);
 
     if (MmcHostInstance->MmcHost->IsCardPresent (MmcHostInstance->MmcHost) == !MmcHostInstance->Initialized) {
+      // Requests queued against the previous media cannot complete
+      MmcIo2AbortQueue (MmcHostInstance);
+
       MmcHostInstance->State = MmcHwInitializationState;
       MmcHostInstance->BlockIo.Media->MediaPresent = !MmcHostInstance->Initialized;
       MmcHostInstance->Initialized = !MmcHostInstance->Initialized;
@@ -371,6 +413,9 @@ CheckCardsCallback (
         InitializeMmcDevice (MmcHostInstance);
       }
 
+      // Drop the lines of the previous media, and pick up the new block size
+      MmcCacheInvalidate (MmcHostInstance);
+
       Status = gBS->ReinstallProtocolInterface (
                     (MmcHostInstance->MmcHandle),
                     &gEfiBlockIoProtocolGuid,
@@ -381,6 +426,17 @@ CheckCardsCallback (
       if (EFI_ERROR(Status)) {
         Print(L"MMC Card: Error reinstalling BlockIo interface\n");
       }
+
+      Status = gBS->ReinstallProtocolInterface (
+                    (MmcHostInstance->MmcHandle),
+                    &gEfiBlockIo2ProtocolGuid,
+                    &(MmcHostInstance->BlockIo2),
+                    &(MmcHostInstance->BlockIo2)
+                    );
+
+      if (EFI_ERROR(Status)) {
+        Print(L"MMC Card: Error reinstalling BlockIo2 interface\n");
+      }
     }
 
     CurrentLink = CurrentLink->ForwardLink;
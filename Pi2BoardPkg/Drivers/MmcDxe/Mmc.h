@@ -20,25 +20,33 @@
 
 #include <Protocol/DiskIo.h>
 #include <Protocol/BlockIo.h>
+#include <Protocol/BlockIo2.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/MmcHost.h>
+#include <Protocol/MmcStats.h>
 
 #include <Library/UefiLib.h>
 #include <Library/DebugLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 
-// Define with non-zero to collect IO statistics and dump it to the terminal
+// Define with non-zero to time the card initialization and dump it to the terminal.
+// The I/O statistics are always collected and published through MMC_STATS_PROTOCOL
 #define MMC_COLLECT_STATISTICS  0
-// Define with non-zero to benchmark IO on the first MmcReadBlocks call and
-// dump to the terminal
-#define MMC_BENCHMARK_IO        0
 
 #define MMC_TRACE(txt)  DEBUG((EFI_D_BLKIO, "MMC: " txt "\n"))
 
 #define MMC_IOBLOCKS_READ           0
 #define MMC_IOBLOCKS_WRITE          1
+#define MMC_IOBLOCKS_FLUSH          2
 #define MMC_OCR_POWERUP             0x80000000
 
+// TPL the card is accessed at, so BlockIo and the BlockIo2 queue never interleave
+#define MMC_IO_TPL                  TPL_CALLBACK
+// Largest slice of a BlockIo2 request transferred per timer tick
+#define MMC_IO2_MAX_BLOCKS_PER_TICK 1024
+// How often the data of a running BlockIo2 slice is checked on, in 100ns units
+#define MMC_IO2_POLL_PERIOD         2000
+
 #define MMC_CSD_GET_CCC(Response)             (Response[2] >> 20)
 #define MMC_CSD_GET_TRANSPEED(Response)       (Response[3] & 0xFF)
 #define MMC_CSD_GET_READBLLEN(Response)       ((Response[2] >> 16) & 0xF)
@@ -187,11 +195,46 @@ typedef struct  {
   CID       CIDData;
   CSD       CSDData;
 } CARD_INFO;
-typedef struct _IoReadStatsEntry {
-    UINT16 NumBlocks;
-    UINT16 Count;
-    UINT32 TotalTransferTimeUs;
-} IoReadStatsEntry;
+
+//
+// Sector cache, see MmcCache.c
+//
+#define MMC_CACHE_HASH_BUCKETS      64
+
+typedef struct {
+  LIST_ENTRY                LruLink;      // In the LRU list when valid, in the free list otherwise
+  LIST_ENTRY                HashLink;
+  EFI_LBA                   Lba;          // First block of the line
+  BOOLEAN                   Dirty;
+  UINT64                    DirtySeq;     // Write that last dirtied the line
+  UINT8                     *Data;
+} MMC_CACHE_LINE;
+
+#define MMC_CACHE_LINE_FROM_LRU_LINK(a)             BASE_CR (a, MMC_CACHE_LINE, LruLink)
+#define MMC_CACHE_LINE_FROM_HASH_LINK(a)            BASE_CR (a, MMC_CACHE_LINE, HashLink)
+
+typedef struct {
+  BOOLEAN                   Enabled;
+  BOOLEAN                   WriteBack;
+  UINTN                     LineSize;     // In bytes
+  UINTN                     LineBlocks;   // 0 if the media block size does not fit the lines
+  UINTN                     LineCount;
+  UINTN                     ReadAheadLines;
+  UINTN                     MaxRequestSize;
+  MMC_CACHE_LINE            *Lines;
+  UINT8                     *Data;
+  LIST_ENTRY                LruList;
+  LIST_ENTRY                FreeList;
+  LIST_ENTRY                HashBuckets[MMC_CACHE_HASH_BUCKETS];
+  MMC_CACHE_LINE            **DirtyLines;
+  UINT8                     *StagingBuffer;
+  UINTN                     StagingLines;
+  EFI_LBA                   NextSequentialLba;
+  UINTN                     SequentialCount;
+  UINT64                    WriteSeq;     // Last write that went into the lines
+  EFI_EVENT                 ReadyToBootEvent;
+  MMC_CACHE_STATS           Stats;
+} MMC_CACHE;
 
 typedef struct _MMC_HOST_INSTANCE {
   UINTN                     Signature;
@@ -201,20 +244,46 @@ typedef struct _MMC_HOST_INSTANCE {
 
   MMC_STATE                 State;
   EFI_BLOCK_IO_PROTOCOL     BlockIo;
+  EFI_BLOCK_IO2_PROTOCOL    BlockIo2;
+  LIST_ENTRY                Io2Queue;
+  EFI_EVENT                 Io2QueueEvent;
+  MMC_CACHE                 Cache;
+  MMC_STATS_PROTOCOL        StatsProtocol;
+  MMC_STATS_IO              IoStats[3];   // Indexed by MMC_IOBLOCKS_READ/WRITE/FLUSH
   CARD_INFO                 CardInfo;
   EFI_MMC_HOST_PROTOCOL     *MmcHost;
 
   BOOLEAN                   Initialized;
-#ifdef MMC_COLLECT_STATISTICS
-  IoReadStatsEntry          IoReadStats[1024];
-  UINT32                    IoReadStatsNumEntries;
-#endif // COLLECT_IO_STATISTICS
+  BOOLEAN                   MultiBlockWriteEnabled;
 } MMC_HOST_INSTANCE;
 
 #define MMC_HOST_INSTANCE_SIGNATURE                 SIGNATURE_32('m', 'm', 'c', 'h')
 #define MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS(a)     CR (a, MMC_HOST_INSTANCE, BlockIo, MMC_HOST_INSTANCE_SIGNATURE)
+#define MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS(a)    CR (a, MMC_HOST_INSTANCE, BlockIo2, MMC_HOST_INSTANCE_SIGNATURE)
+#define MMC_HOST_INSTANCE_FROM_STATS_THIS(a)        CR (a, MMC_HOST_INSTANCE, StatsProtocol, MMC_HOST_INSTANCE_SIGNATURE)
 #define MMC_HOST_INSTANCE_FROM_LINK(a)              CR (a, MMC_HOST_INSTANCE, Link, MMC_HOST_INSTANCE_SIGNATURE)
 
+//
+// A queued non-blocking BlockIo2 request, Lba/Buffer/BufferSize track what is left to do.
+// SliceSize is non zero while the host moves the data of the slice at Lba.
+//
+typedef struct {
+  UINTN                     Signature;
+  LIST_ENTRY                Link;
+  UINTN                     Transfer;
+  UINT32                    MediaId;
+  EFI_LBA                   Lba;
+  UINTN                     BufferSize;
+  VOID                      *Buffer;
+  EFI_BLOCK_IO2_TOKEN       *Token;
+  UINTN                     SliceSize;
+  BOOLEAN                   IsStopRequired;
+  UINT64                    StartTime;
+} MMC_IO2_REQUEST;
+
+#define MMC_IO2_REQUEST_SIGNATURE                   SIGNATURE_32('m', 'm', 'c', 'r')
+#define MMC_IO2_REQUEST_FROM_LINK(a)                CR (a, MMC_IO2_REQUEST, Link, MMC_IO2_REQUEST_SIGNATURE)
+
 
 EFI_STATUS
 EFIAPI
@@ -348,6 +417,277 @@ MmcFlushBlocks (
   IN EFI_BLOCK_IO_PROTOCOL  *This
   );
 
+/**
+  Reset the block device hardware, aborting all queued non-blocking requests.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.Reset().
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  ExtendedVerification   Indicates that the driver may perform a more exhaustive
+                                 verification operation of the device during reset.
+
+  @retval EFI_SUCCESS            The block device was reset.
+  @retval EFI_DEVICE_ERROR       The block device is not functioning correctly and could not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcResetEx (
+  IN EFI_BLOCK_IO2_PROTOCOL   *This,
+  IN BOOLEAN                  ExtendedVerification
+  );
+
+/**
+  Reads the requested number of blocks from the device, without blocking if Token->Event is set.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.ReadBlocksEx().
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  MediaId                The media ID that the read request is for.
+  @param  Lba                    The starting logical block address to read from on the device.
+  @param  Token                  A pointer to the token associated with the transaction.
+  @param  BufferSize             The size of the Buffer in bytes.
+                                 This must be a multiple of the intrinsic block size of the device.
+  @param  Buffer                 A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS            The read request was queued if Token->Event is not NULL.
+                                 The data was read correctly from the device if Token->Event is NULL.
+  @retval EFI_DEVICE_ERROR       The device reported an error while attempting to perform the read operation.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_MEDIA_CHANGED      The MediaId is not for the current media.
+  @retval EFI_BAD_BUFFER_SIZE    The BufferSize parameter is not a multiple of the intrinsic block size of the device.
+  @retval EFI_INVALID_PARAMETER  The read request contains LBAs that are not valid,
+                                 or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be completed due to a lack of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcReadBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+     OUT VOID                   *Buffer
+  );
+
+/**
+  Writes a specified number of blocks to the device, without blocking if Token->Event is set.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.WriteBlocksEx().
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  MediaId                The media ID that the write request is for.
+  @param  Lba                    The starting logical block address to be written.
+  @param  Token                  A pointer to the token associated with the transaction.
+  @param  BufferSize             The size of the Buffer in bytes.
+                                 This must be a multiple of the intrinsic block size of the device.
+  @param  Buffer                 Pointer to the source buffer for the data.
+
+  @retval EFI_SUCCESS            The write request was queued if Token->Event is not NULL.
+                                 The data was written correctly to the device if Token->Event is NULL.
+  @retval EFI_WRITE_PROTECTED    The device cannot be written to.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_MEDIA_CHANGED      The MediaId is not for the current media.
+  @retval EFI_DEVICE_ERROR       The device reported an error while attempting to perform the write operation.
+  @retval EFI_BAD_BUFFER_SIZE    The BufferSize parameter is not a multiple of the intrinsic block size of the device.
+  @retval EFI_INVALID_PARAMETER  The write request contains LBAs that are not valid,
+                                 or the buffer is not on proper alignment.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be completed due to a lack of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcWriteBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN     UINT32                 MediaId,
+  IN     EFI_LBA                Lba,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+  IN     UINTN                  BufferSize,
+  IN     VOID                   *Buffer
+  );
+
+/**
+  Flushes all modified data to the device once all the requests queued before it are done.
+
+  This function implements EFI_BLOCK_IO2_PROTOCOL.FlushBlocksEx().
+
+  @param  This                   Indicates a pointer to the calling context.
+  @param  Token                  A pointer to the token associated with the transaction.
+
+  @retval EFI_SUCCESS            The flush request was queued if Token->Event is not NULL.
+                                 All outstanding data was written to the device if Token->Event is NULL.
+  @retval EFI_DEVICE_ERROR       The device reported an error while writing back the data.
+  @retval EFI_NO_MEDIA           There is no media in the device.
+  @retval EFI_OUT_OF_RESOURCES   The request could not be completed due to a lack of resources.
+
+**/
+EFI_STATUS
+EFIAPI
+MmcFlushBlocksEx (
+  IN     EFI_BLOCK_IO2_PROTOCOL *This,
+  IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+  );
+
+VOID
+EFIAPI
+MmcIo2QueueCallback (
+  IN  EFI_EVENT   Event,
+  IN  VOID        *Context
+  );
+
+VOID
+MmcIo2DrainQueue (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+VOID
+MmcIo2AbortQueue (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcCheckIoParameters (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN UINTN                  Transfer,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN VOID                   *Buffer
+  );
+
+EFI_STATUS
+MmcIoBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN UINTN                  Transfer,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  OUT VOID                  *Buffer
+  );
+
+EFI_STATUS
+MmcIoBlocksLocked (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Transfer,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN OUT VOID               *Buffer
+  );
+
+EFI_STATUS
+MmcFlushBlocksLocked (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcTransferBlocks (
+  IN EFI_BLOCK_IO_PROTOCOL  *This,
+  IN UINTN                  Transfer,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  OUT VOID                  *Buffer
+  );
+
+EFI_STATUS
+MmcStartTransfer (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Transfer,
+  IN EFI_LBA                Lba,
+  IN OUT UINTN              *BlockCount,
+  OUT BOOLEAN               *IsStopRequired
+  );
+
+EFI_STATUS
+MmcEndTransfer (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN BOOLEAN                IsStopRequired
+  );
+
+EFI_STATUS
+MmcStopTransmission (
+  EFI_MMC_HOST_PROTOCOL     *MmcHost
+  );
+
+EFI_STATUS
+MmcCacheInitialize (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+VOID
+MmcCacheFree (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+VOID
+MmcCacheInvalidate (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+EFI_STATUS
+MmcCacheFlush (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+BOOLEAN
+MmcCacheIsBypass (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Transfer,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize
+  );
+
+EFI_STATUS
+MmcCacheBypassStart (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Transfer
+  );
+
+VOID
+MmcCacheBypassDone (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Transfer,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN OUT VOID               *Buffer
+  );
+
+EFI_STATUS
+MmcCacheIoBlocks (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Transfer,
+  IN UINT32                 MediaId,
+  IN EFI_LBA                Lba,
+  IN UINTN                  BufferSize,
+  IN OUT VOID               *Buffer
+  );
+
+EFI_STATUS
+MmcCacheEnable (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN BOOLEAN                Enable
+  );
+
+//
+// I/O statistics, see MmcStats.c
+//
+VOID
+MmcStatsInitialize (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance
+  );
+
+VOID
+MmcStatsRecord (
+  IN MMC_HOST_INSTANCE      *MmcHostInstance,
+  IN UINTN                  Transfer,
+  IN UINTN                  BufferSize,
+  IN UINT64                 StartTime,
+  IN EFI_STATUS             Status
+  );
+
 EFI_STATUS
 MmcNotifyState (
   IN MMC_HOST_INSTANCE      *MmcHostInstance,
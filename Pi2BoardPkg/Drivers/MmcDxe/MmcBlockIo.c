@@ -28,40 +28,11 @@
 // The high-performance counter frequency
 UINT64 mHpcTicksPerSeconds = 0;
 
-VOID
-MmcBenchmarkBlockIo(
-    IN EFI_BLOCK_IO_PROTOCOL  *This,
-    IN UINTN                  Transfer,
-    IN UINT32                 MediaId,
-    IN UINT32                 BufferByteSize,
-    IN UINT32                 Iterations
-    );
-
 EFI_STATUS
 SdSwitchHighSpeedMode(
     IN  MMC_HOST_INSTANCE   *MmcHostInstance
     );
 
-VOID
-SortIoReadStatsByTotalTransferTime(
-    IoReadStatsEntry* Table,
-    UINT32 NumEntries
-    )
-{
-    // Using the simple insertion sort
-    UINT32 Idx;
-    for (Idx = 1; Idx < NumEntries; ++Idx) {
-        IoReadStatsEntry CurrEntry = Table[Idx];
-        UINT32 J = Idx;
-        while (J > 0 &&
-               Table[J - 1].TotalTransferTimeUs < CurrEntry.TotalTransferTimeUs) {
-            Table[J] = Table[J - 1];
-            --J;
-        }
-        Table[J] = CurrEntry;
-    }
-}
-
 EFI_STATUS
 MmcNotifyState(
     IN MMC_HOST_INSTANCE *MmcHostInstance,
@@ -410,6 +381,9 @@ EFI_STATUS InitializeMmcDevice(
         }
     }
 
+    // Assume multi-block writes work until the host or the card proves otherwise
+    MmcHostInstance->MultiBlockWriteEnabled = TRUE;
+
     mHpcTicksPerSeconds = GetPerformanceCounterProperties(NULL, NULL);
     ASSERT(mHpcTicksPerSeconds != 0);
 
@@ -441,6 +415,9 @@ MmcReset(
         return EFI_SUCCESS;
     }
 
+    // Let the pending BlockIo2 requests finish on the card they were queued for
+    MmcIo2DrainQueue(MmcHostInstance);
+
     // If a card is not present then clear all media settings
     if (!MmcHostInstance->MmcHost->IsCardPresent(MmcHostInstance->MmcHost)) {
         MmcHostInstance->BlockIo.Media->MediaPresent = FALSE;
@@ -451,6 +428,9 @@ MmcReset(
         // Indicate that the driver requires initialization
         MmcHostInstance->State = MmcHwInitializationState;
 
+        // Whatever was cached belonged to the card that is gone
+        MmcCacheInvalidate(MmcHostInstance);
+
         return EFI_SUCCESS;
     }
 
@@ -487,35 +467,68 @@ MmcStopTransmission(
     return Status;
 }
 
+/**
+  Announce the number of blocks of the upcoming CMD25 multi-block write.
+
+  SD cards receive an ACMD23 (SET_WR_BLK_ERASE_COUNT) which lets them pre-erase
+  the write blocks, the transfer still has to be closed with a CMD12.
+  MMC cards receive a CMD23 (SET_BLOCK_COUNT) which makes the write a
+  pre-defined one that the card terminates on its own without a CMD12.
+  Both are hints only, the write still goes ahead if the card rejects them.
+
+  @retval TRUE    A CMD12 is required to end the multi-block write.
+  @retval FALSE   The card will leave the receive state on its own.
+**/
+BOOLEAN
+MmcSetWriteBlockCount(
+    IN MMC_HOST_INSTANCE     *MmcHostInstance,
+    IN UINTN                 BlockCount
+    )
+{
+    EFI_STATUS              Status;
+    UINT32                  Response[4];
+    EFI_MMC_HOST_PROTOCOL   *MmcHost;
+
+    MmcHost = MmcHostInstance->MmcHost;
+
+    if ((MmcHostInstance->CardInfo.CardType == MMC_CARD) ||
+        (MmcHostInstance->CardInfo.CardType == MMC_CARD_HIGH) ||
+        (MmcHostInstance->CardInfo.CardType == EMMC_CARD)) {
+        Status = MmcHost->SendCommand(MmcHost, MMC_CMD23, BlockCount & 0xFFFF);
+        if (EFI_ERROR(Status)) {
+            DEBUG((EFI_D_WARN, "MmcDxe: MmcSetWriteBlockCount(MMC_CMD23): Error %r\n", Status));
+            return TRUE;
+        }
+        MmcHost->ReceiveResponse(MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+        return FALSE;
+    }
+
+    Status = MmcHost->SendCommand(MmcHost, MMC_CMD55, MmcHostInstance->CardInfo.RCA << 16);
+    if (!EFI_ERROR(Status)) {
+        Status = MmcHost->SendCommand(MmcHost, MMC_ACMD23, BlockCount & 0x7FFFFF);
+    }
+    if (EFI_ERROR(Status)) {
+        DEBUG((EFI_D_WARN, "MmcDxe: MmcSetWriteBlockCount(MMC_ACMD23): Error %r\n", Status));
+    } else {
+        MmcHost->ReceiveResponse(MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+    }
+
+    return TRUE;
+}
+
 EFI_STATUS
-MmcIoBlocks(
+MmcCheckIoParameters(
     IN EFI_BLOCK_IO_PROTOCOL    *This,
     IN UINTN                    Transfer,
     IN UINT32                   MediaId,
     IN EFI_LBA                  Lba,
     IN UINTN                    BufferSize,
-    OUT VOID                    *Buffer
+    IN VOID                     *Buffer
     )
 {
-    UINT32                  Response[4];
-    EFI_STATUS              Status;
-    UINTN                   CmdArg;
-    INTN                    Timeout;
-    UINTN                   Cmd;
     MMC_HOST_INSTANCE       *MmcHostInstance;
     EFI_MMC_HOST_PROTOCOL   *MmcHost;
-    UINTN                   BytesRemainingToBeTransfered;
-    UINTN                   BlockCount;
-    UINTN                   CurrentBlockNum;
 
-    DEBUG((
-        DEBUG_BLKIO,
-        "MmcDxe: MmcIoBlocks(%c, 0x%lx, 0x%xB)\n",
-        (Transfer == MMC_IOBLOCKS_WRITE) ? 'W' : 'R',
-        Lba,
-        (UINT32)BufferSize));
-
-    BlockCount = 1;
     MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS(This);
     ASSERT(MmcHostInstance != NULL);
     MmcHost = MmcHostInstance->MmcHost;
@@ -558,72 +571,229 @@ MmcIoBlocks(
         return EFI_INVALID_PARAMETER;
     }
 
-    BytesRemainingToBeTransfered = BufferSize;
-    while (BytesRemainingToBeTransfered > 0) {
+    return EFI_SUCCESS;
+}
 
-        // Check if the Card is in Ready status
-        CmdArg = MmcHostInstance->CardInfo.RCA << 16;
-        Response[0] = 0;
-        Timeout = 20;
-        while ((!(Response[0] & MMC_R0_READY_FOR_DATA))
-               && (MMC_R0_CURRENTSTATE(Response) != MMC_R0_STATE_TRAN)
-               && Timeout--) {
-            Status = MmcHost->SendCommand(MmcHost, MMC_CMD13, CmdArg);
-            if (!EFI_ERROR(Status)) {
-                MmcHost->ReceiveResponse(MmcHost, MMC_RESPONSE_TYPE_R1, Response);
-            }
-        }
+/**
+  Waits for the card to be ready, then sends the command starting the transfer of
+  *BlockCount blocks at Lba and moves the host to the matching data state.
 
-        if (0 == Timeout) {
-            DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): The Card is busy\n"));
-            return EFI_NOT_READY;
-        }
+  *BlockCount is lowered to 1 once the card turned multiple block writes down,
+  *IsStopRequired tells MmcEndTransfer() whether a CMD12 has to close the transfer.
+**/
+EFI_STATUS
+MmcStartTransfer(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance,
+    IN UINTN                    Transfer,
+    IN EFI_LBA                  Lba,
+    IN OUT UINTN                *BlockCount,
+    OUT BOOLEAN                 *IsStopRequired
+    )
+{
+    UINT32                  Response[4];
+    EFI_STATUS              Status;
+    UINTN                   CmdArg;
+    INTN                    Timeout;
+    UINTN                   Cmd;
+    EFI_MMC_HOST_PROTOCOL   *MmcHost;
 
-        //Set command argument based on the card access mode (Byte mode or Block mode)
-        if (MmcHostInstance->CardInfo.OCRData.AccessMode & BIT1) {
-            CmdArg = Lba;
-        } else {
-            CmdArg = Lba * This->Media->BlockSize;
+    MmcHost = MmcHostInstance->MmcHost;
+
+    // Check if the Card is in Ready status
+    CmdArg = MmcHostInstance->CardInfo.RCA << 16;
+    Response[0] = 0;
+    Timeout = 20;
+    while ((!(Response[0] & MMC_R0_READY_FOR_DATA))
+           && (MMC_R0_CURRENTSTATE(Response) != MMC_R0_STATE_TRAN)
+           && Timeout--) {
+        Status = MmcHost->SendCommand(MmcHost, MMC_CMD13, CmdArg);
+        if (!EFI_ERROR(Status)) {
+            MmcHost->ReceiveResponse(MmcHost, MMC_RESPONSE_TYPE_R1, Response);
         }
+    }
 
-        if (Transfer == MMC_IOBLOCKS_READ) {
-            BlockCount = BytesRemainingToBeTransfered / This->Media->BlockSize;
+    if (0 == Timeout) {
+        DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): The Card is busy\n"));
+        return EFI_NOT_READY;
+    }
 
-            // The card is unhappy if trying to read too many blocks at once
-            if (BlockCount > MULTI_BLK_XFER_MAX_BLK_CNT) {
-                BlockCount = MULTI_BLK_XFER_MAX_BLK_CNT;
-            }
-            if (BlockCount == 1) {
-                // Read a single block
-                Cmd = MMC_CMD17;
-            } else {
-                // Read multiple blocks
-                Cmd = MMC_CMD18;
-            }
+    //Set command argument based on the card access mode (Byte mode or Block mode)
+    if (MmcHostInstance->CardInfo.OCRData.AccessMode & BIT1) {
+        CmdArg = Lba;
+    } else {
+        CmdArg = Lba * MmcHostInstance->BlockIo.Media->BlockSize;
+    }
+
+    if ((Transfer == MMC_IOBLOCKS_WRITE) && !MmcHostInstance->MultiBlockWriteEnabled) {
+        *BlockCount = 1;
+    }
+
+    *IsStopRequired = (*BlockCount > 1);
+    if (Transfer == MMC_IOBLOCKS_READ) {
+        if (*BlockCount == 1) {
+            // Read a single block
+            Cmd = MMC_CMD17;
         } else {
+            // Read multiple blocks
+            Cmd = MMC_CMD18;
+        }
+    } else {
+        if (*BlockCount == 1) {
             // Write a single block
             Cmd = MMC_CMD24;
+        } else {
+            // Write multiple blocks, tell the card upfront how many blocks
+            // are coming so it can pre-erase them or stop on its own
+            *IsStopRequired = MmcSetWriteBlockCount(MmcHostInstance, *BlockCount);
+            Cmd = MMC_CMD25;
+        }
+    }
+
+    Status = MmcHost->SendCommand(MmcHost, Cmd, CmdArg);
+    if (EFI_ERROR(Status)) {
+        DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(MMC_CMD%d): Error %r\n", MMC_GET_INDX(Cmd), Status));
+        if (Cmd == MMC_CMD25) {
+            // The host or the card is not happy with multi-block writes, fall back
+            // to single block writes for the rest of this card session
+            DEBUG((EFI_D_WARN, "MmcDxe: MmcIoBlocks(): Falling back to single block writes\n"));
+            MmcHostInstance->MultiBlockWriteEnabled = FALSE;
+            return MmcStartTransfer(MmcHostInstance, Transfer, Lba, BlockCount, IsStopRequired);
+        }
+        return Status;
+    }
+
+    if (Transfer == MMC_IOBLOCKS_READ) {
+        Status = MmcNotifyState(MmcHostInstance, MmcSendingDataState);
+        if (EFI_ERROR(Status)) {
+            DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): Error MmcSendingDataState\n"));
         }
-        Status = MmcHost->SendCommand(MmcHost, Cmd, CmdArg);
+    } else {
+        Status = MmcNotifyState(MmcHostInstance, MmcReceiveDataState);
         if (EFI_ERROR(Status)) {
-            DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(MMC_CMD%d): Error %r\n", Cmd, Status));
-            return Status;
+            DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): Error MmcProgrammingState\n"));
         }
+    }
 
-        if (Transfer == MMC_IOBLOCKS_READ) {
-            Status = MmcNotifyState(MmcHostInstance, MmcSendingDataState);
-            if (EFI_ERROR(Status)) {
-                DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): Error MmcSendingDataState\n"));
-                return Status;
+    return Status;
+}
+
+/**
+  Closes the transfer once its data moved and waits for the card to finish
+  programming and return to the transfer state
+**/
+EFI_STATUS
+MmcEndTransfer(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance,
+    IN BOOLEAN                  IsStopRequired
+    )
+{
+    UINT32                  Response[4];
+    EFI_STATUS              Status;
+    UINTN                   CmdArg;
+    INTN                    Timeout;
+    EFI_MMC_HOST_PROTOCOL   *MmcHost;
+
+    MmcHost = MmcHostInstance->MmcHost;
+
+    if (IsStopRequired) {
+        MmcStopTransmission(MmcHost);
+    }
+
+    // Command 13 - Read status and wait for programming to complete (return to tran)
+    Timeout = MMCI0_TIMEOUT;
+    CmdArg = MmcHostInstance->CardInfo.RCA << 16;
+    Response[0] = 0;
+    while ((!(Response[0] & MMC_R0_READY_FOR_DATA))
+           && (MMC_R0_CURRENTSTATE(Response) != MMC_R0_STATE_TRAN)
+           && Timeout--) {
+        Status = MmcHost->SendCommand(MmcHost, MMC_CMD13, CmdArg);
+        if (!EFI_ERROR(Status)) {
+            MmcHost->ReceiveResponse(MmcHost, MMC_RESPONSE_TYPE_R1, Response);
+            if ((Response[0] & MMC_R0_READY_FOR_DATA)) {
+                break;  // Prevents delay once finished
             }
+        }
+        NanoSecondDelay(100);
+    }
 
+    Status = MmcNotifyState(MmcHostInstance, MmcTransferState);
+    if (EFI_ERROR(Status)) {
+        DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): Error MmcTransferState\n"));
+    }
+
+    return Status;
+}
+
+EFI_STATUS
+MmcTransferBlocks(
+    IN EFI_BLOCK_IO_PROTOCOL    *This,
+    IN UINTN                    Transfer,
+    IN UINT32                   MediaId,
+    IN EFI_LBA                  Lba,
+    IN UINTN                    BufferSize,
+    OUT VOID                    *Buffer
+    )
+{
+    EFI_STATUS              Status;
+    MMC_HOST_INSTANCE       *MmcHostInstance;
+    EFI_MMC_HOST_PROTOCOL   *MmcHost;
+    UINTN                   BytesRemainingToBeTransfered;
+    UINTN                   BlockCount;
+    UINTN                   CurrentBlockNum;
+    UINTN                   BlocksPerDataCall;
+    BOOLEAN                 IsStopRequired;
+
+    DEBUG((
+        DEBUG_BLKIO,
+        "MmcDxe: MmcIoBlocks(%c, 0x%lx, 0x%xB)\n",
+        (Transfer == MMC_IOBLOCKS_WRITE) ? 'W' : 'R',
+        Lba,
+        (UINT32)BufferSize));
+
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS(This);
+    MmcHost = MmcHostInstance->MmcHost;
+
+    Status = MmcCheckIoParameters(This, Transfer, MediaId, Lba, BufferSize, Buffer);
+    if (EFI_ERROR(Status) || (BufferSize == 0)) {
+        return Status;
+    }
+
+    BytesRemainingToBeTransfered = BufferSize;
+    while (BytesRemainingToBeTransfered > 0) {
+
+        // The card is unhappy if trying to transfer too many blocks at once
+        BlockCount = BytesRemainingToBeTransfered / This->Media->BlockSize;
+        if (BlockCount > MULTI_BLK_XFER_MAX_BLK_CNT) {
+            BlockCount = MULTI_BLK_XFER_MAX_BLK_CNT;
+        }
+
+        Status = MmcStartTransfer(MmcHostInstance, Transfer, Lba, &BlockCount, &IsStopRequired);
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+
+        // Hosts that can move the data of a whole multiple block transfer in one go
+        // (e.g. using DMA) get it in a single call rather than one block at a time
+        if ((BlockCount > 1) &&
+            MMC_HOST_HAS_ISMULTIBLOCK(MmcHost) &&
+            MmcHost->IsMultiBlock(MmcHost)) {
+            BlocksPerDataCall = BlockCount;
+        } else {
+            BlocksPerDataCall = 1;
+        }
+
+        if (Transfer == MMC_IOBLOCKS_READ) {
             if (BlockCount == 1) {
                 // Read one block of Data
                 Status = MmcHost->ReadBlockData(MmcHost, Lba, This->Media->BlockSize, Buffer);
             } else {
                 // Read multiple blocks of Data
-                for (CurrentBlockNum = 0; CurrentBlockNum < BlockCount; ++CurrentBlockNum) {
-                    Status = MmcHost->ReadBlockData(MmcHost, Lba, This->Media->BlockSize, Buffer);
+                for (CurrentBlockNum = 0; CurrentBlockNum < BlockCount; CurrentBlockNum += BlocksPerDataCall) {
+                    Status = MmcHost->ReadBlockData(
+                        MmcHost,
+                        Lba,
+                        BlocksPerDataCall * This->Media->BlockSize,
+                        Buffer);
                     if (EFI_ERROR(Status)) {
                         DEBUG((
                             EFI_D_ERROR,
@@ -632,11 +802,10 @@ MmcIoBlocks(
                         MmcStopTransmission(MmcHost);
                         return Status;
                     }
-                    BytesRemainingToBeTransfered -= This->Media->BlockSize;
-                    Lba += 1;
-                    Buffer = (UINT8 *)Buffer + This->Media->BlockSize;
+                    BytesRemainingToBeTransfered -= BlocksPerDataCall * This->Media->BlockSize;
+                    Lba += BlocksPerDataCall;
+                    Buffer = (UINT8 *)Buffer + (BlocksPerDataCall * This->Media->BlockSize);
                 }
-                MmcStopTransmission(MmcHost);
             }
 
             if (EFI_ERROR(Status)) {
@@ -646,41 +815,40 @@ MmcIoBlocks(
             }
 
         } else {
-            Status = MmcNotifyState(MmcHostInstance, MmcReceiveDataState);
-            if (EFI_ERROR(Status)) {
-                DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): Error MmcProgrammingState\n"));
-                return Status;
-            }
-
-            // Write one block of Data
-            Status = MmcHost->WriteBlockData(MmcHost, Lba, This->Media->BlockSize, Buffer);
-            if (EFI_ERROR(Status)) {
-                DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): Error Write Block Data and Status = %r\n", Status));
-                MmcStopTransmission(MmcHost);
-                return Status;
-            }
-        }
-
-        // Command 13 - Read status and wait for programming to complete (return to tran)
-        Timeout = MMCI0_TIMEOUT;
-        CmdArg = MmcHostInstance->CardInfo.RCA << 16;
-        Response[0] = 0;
-        while ((!(Response[0] & MMC_R0_READY_FOR_DATA))
-               && (MMC_R0_CURRENTSTATE(Response) != MMC_R0_STATE_TRAN)
-               && Timeout--) {
-            Status = MmcHost->SendCommand(MmcHost, MMC_CMD13, CmdArg);
-            if (!EFI_ERROR(Status)) {
-                MmcHost->ReceiveResponse(MmcHost, MMC_RESPONSE_TYPE_R1, Response);
-                if ((Response[0] & MMC_R0_READY_FOR_DATA)) {
-                    break;  // Prevents delay once finished
+            if (BlockCount == 1) {
+                // Write one block of Data
+                Status = MmcHost->WriteBlockData(MmcHost, Lba, This->Media->BlockSize, Buffer);
+                if (EFI_ERROR(Status)) {
+                    DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): Error Write Block Data and Status = %r\n", Status));
+                    MmcStopTransmission(MmcHost);
+                    return Status;
+                }
+            } else {
+                // Stream all the blocks of Data back to back and only wait for the card
+                // to finish programming once at the end of the whole transfer
+                for (CurrentBlockNum = 0; CurrentBlockNum < BlockCount; CurrentBlockNum += BlocksPerDataCall) {
+                    Status = MmcHost->WriteBlockData(
+                        MmcHost,
+                        Lba,
+                        BlocksPerDataCall * This->Media->BlockSize,
+                        Buffer);
+                    if (EFI_ERROR(Status)) {
+                        DEBUG((
+                            EFI_D_ERROR,
+                            "MmcDxe: MmcIoBlocks(): Error Write Multiple Block Data and Status = %r\n",
+                            Status));
+                        MmcStopTransmission(MmcHost);
+                        return Status;
+                    }
+                    BytesRemainingToBeTransfered -= BlocksPerDataCall * This->Media->BlockSize;
+                    Lba += BlocksPerDataCall;
+                    Buffer = (UINT8 *)Buffer + (BlocksPerDataCall * This->Media->BlockSize);
                 }
             }
-            NanoSecondDelay(100);
         }
 
-        Status = MmcNotifyState(MmcHostInstance, MmcTransferState);
+        Status = MmcEndTransfer(MmcHostInstance, IsStopRequired);
         if (EFI_ERROR(Status)) {
-            DEBUG((EFI_D_ERROR, "MmcDxe: MmcIoBlocks(): Error MmcTransferState\n"));
             return Status;
         }
 
@@ -694,138 +862,73 @@ MmcIoBlocks(
     return EFI_SUCCESS;
 }
 
+/**
+  Transfers through the cache, must be called at MMC_IO_TPL with nothing of the
+  BlockIo2 queue on the way, i.e. from the queue itself or once it is drained
+**/
 EFI_STATUS
-EFIAPI
-MmcReadBlocks(
-    IN EFI_BLOCK_IO_PROTOCOL    *This,
+MmcIoBlocksLocked(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance,
+    IN UINTN                    Transfer,
     IN UINT32                   MediaId,
     IN EFI_LBA                  Lba,
     IN UINTN                    BufferSize,
-    OUT VOID                    *Buffer
+    IN OUT VOID                 *Buffer
     )
 {
-#if MMC_BENCHMARK_IO
-    static BOOLEAN BenchmarkDone = FALSE;
-    if (!BenchmarkDone) {
-
-        DEBUG((EFI_D_INIT, "MmcDxe: Benchmarking BlockIo Read\n"));
+    EFI_STATUS          Status;
+    UINT64              StartTime;
 
-        UINT32 CurrByteSize = 512;
-        const UINT32 MaxByteSize = 8388608; // 8MB Max
-        for (; CurrByteSize <= MaxByteSize; CurrByteSize *= 2) {
-            MmcBenchmarkBlockIo(This, MMC_IOBLOCKS_READ, MediaId, CurrByteSize, 10);
-        }
-
-        BenchmarkDone = TRUE;
-    }
-#endif // MMC_BENCHMARK_IO
-
-#if MMC_COLLECT_STATISTICS
-    UINT32 NumBlocks = BufferSize / This->Media->BlockSize;
-    MMC_HOST_INSTANCE *MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS(This);
-    const UINT32 TableSize = ARRAYSIZE(MmcHostInstance->IoReadStats);
-    IoReadStatsEntry *CurrentReadEntry = NULL;
-
-    UINT32 BlockIdx;
-    for (BlockIdx = 0; BlockIdx < TableSize; ++BlockIdx) {
-        IoReadStatsEntry *Entry = MmcHostInstance->IoReadStats + BlockIdx;
-        // Reached end of table and didn't find a match, append an entry
-        if (Entry->NumBlocks == 0) {
-            ++MmcHostInstance->IoReadStatsNumEntries;
-            Entry->NumBlocks = NumBlocks;
-        }
-
-        if (Entry->NumBlocks == NumBlocks) {
-            CurrentReadEntry = Entry;
-            ++Entry->Count;
-            break;
-        }
-    }
-    ASSERT(BlockIdx < TableSize);
-
-    UINT64 StartTime = GetPerformanceCounter();
-
-    EFI_STATUS Status = MmcIoBlocks(
-        This,
-        MMC_IOBLOCKS_READ,
+    StartTime = GetPerformanceCounter();
+    Status = MmcCacheIoBlocks(
+        MmcHostInstance,
+        Transfer,
         MediaId,
         Lba,
         BufferSize,
-        Buffer
-        );
-    if (EFI_ERROR(Status)) {
-        goto Exit;
-    }
-
-    UINT64 EndTime = GetPerformanceCounter();
+        Buffer);
+    MmcStatsRecord(MmcHostInstance, Transfer, BufferSize, StartTime, Status);
 
-    ASSERT(CurrentReadEntry != NULL);
-    CurrentReadEntry->TotalTransferTimeUs +=
-        (UINT32)(((EndTime - StartTime) * 1000000UL) / mHpcTicksPerSeconds);
-
-    //
-    // Run statistics and dump updates
-    //
-    SortIoReadStatsByTotalTransferTime(
-        MmcHostInstance->IoReadStats,
-        MmcHostInstance->IoReadStatsNumEntries);
-
-    IoReadStatsEntry *MaxNumBlocksEntry = MmcHostInstance->IoReadStats;
-    IoReadStatsEntry *MaxCountEntry = MmcHostInstance->IoReadStats;
-    UINT32 TotalReadTimeUs = 0;
-    UINT32 TotalReadBlocksCount = 0;
-
-    DEBUG((EFI_D_INIT,
-           " #Blks\tCnt\tAvg(us)\tAll(us)\n"));
-
-    for (BlockIdx = 0; BlockIdx < MmcHostInstance->IoReadStatsNumEntries; ++BlockIdx) {
-        IoReadStatsEntry *CurrEntry = MmcHostInstance->IoReadStats + BlockIdx;
+    return Status;
+}
 
-        if (CurrEntry->NumBlocks > MaxNumBlocksEntry->NumBlocks) {
-            MaxNumBlocksEntry = CurrEntry;
-        }
+EFI_STATUS
+MmcIoBlocks(
+    IN EFI_BLOCK_IO_PROTOCOL    *This,
+    IN UINTN                    Transfer,
+    IN UINT32                   MediaId,
+    IN EFI_LBA                  Lba,
+    IN UINTN                    BufferSize,
+    OUT VOID                    *Buffer
+    )
+{
+    EFI_STATUS          Status;
+    EFI_TPL             OldTpl;
+    MMC_HOST_INSTANCE   *MmcHostInstance;
 
-        if (CurrEntry->Count > MaxCountEntry->Count) {
-            MaxCountEntry = CurrEntry;
-        }
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS(This);
 
-        TotalReadTimeUs += CurrEntry->TotalTransferTimeUs;
-        TotalReadBlocksCount += (CurrEntry->NumBlocks * CurrEntry->Count);
-
-        // Show only the top 5 time consuming transfers
-        if (BlockIdx < 5) {
-            DEBUG((EFI_D_INIT,
-                   " %d\t%d\t%d\t%d\n",
-                   (UINT32)CurrEntry->NumBlocks,
-                   (UINT32)CurrEntry->Count,
-                   (UINT32)(CurrEntry->TotalTransferTimeUs / CurrEntry->Count),
-                   (UINT32)CurrEntry->TotalTransferTimeUs));
-        }
-    }
+    // Ordered after the BlockIo2 requests queued so far, and the queue processing
+    // can't interleave with this transfer
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+    MmcIo2DrainQueue(MmcHostInstance);
+    Status = MmcIoBlocksLocked(MmcHostInstance, Transfer, MediaId, Lba, BufferSize, Buffer);
+    gBS->RestoreTPL(OldTpl);
 
-    DEBUG((EFI_D_INIT,
-           "MaxNumBlocksEntry: %d %d %dus\n",
-           (UINT32)MaxNumBlocksEntry->NumBlocks,
-           (UINT32)MaxNumBlocksEntry->Count,
-           (UINT32)MaxNumBlocksEntry->TotalTransferTimeUs));
-
-    DEBUG((EFI_D_INIT,
-           "MaxCountEntry: %d %d %dus\n",
-           (UINT32)MaxCountEntry->NumBlocks,
-           (UINT32)MaxCountEntry->Count,
-           (UINT32)MaxCountEntry->TotalTransferTimeUs));
-
-    DEBUG((EFI_D_INIT,
-           "UEFI spent %dus~%ds reading %dMB from SDCard\n\n",
-           TotalReadTimeUs,
-           INT_DIV_ROUND(TotalReadTimeUs, 1000000),
-           INT_DIV_ROUND(TotalReadBlocksCount * This->Media->BlockSize, (1024 * 1024))));
-Exit:
     return Status;
+}
 
-#else
+EFI_STATUS
+EFIAPI
+MmcReadBlocks(
+    IN EFI_BLOCK_IO_PROTOCOL    *This,
+    IN UINT32                   MediaId,
+    IN EFI_LBA                  Lba,
+    IN UINTN                    BufferSize,
+    OUT VOID                    *Buffer
+    )
+{
     return MmcIoBlocks(This, MMC_IOBLOCKS_READ, MediaId, Lba, BufferSize, Buffer);
-#endif // MMC_COLLECT_STATISTICS
 }
 
 EFI_STATUS
@@ -841,71 +944,43 @@ MmcWriteBlocks(
     return MmcIoBlocks(This, MMC_IOBLOCKS_WRITE, MediaId, Lba, BufferSize, Buffer);
 }
 
+/**
+  Writes the cache back, same calling rules as MmcIoBlocksLocked()
+**/
 EFI_STATUS
-EFIAPI
-MmcFlushBlocks(
-    IN EFI_BLOCK_IO_PROTOCOL  *This
+MmcFlushBlocksLocked(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance
     )
 {
-    return EFI_SUCCESS;
+    EFI_STATUS          Status;
+    UINT64              StartTime;
+
+    StartTime = GetPerformanceCounter();
+    Status = MmcCacheFlush(MmcHostInstance);
+    MmcStatsRecord(MmcHostInstance, MMC_IOBLOCKS_FLUSH, 0, StartTime, Status);
+
+    return Status;
 }
 
-VOID
-MmcBenchmarkBlockIo(
-    IN EFI_BLOCK_IO_PROTOCOL  *This,
-    IN UINTN                  Transfer,
-    IN UINT32                 MediaId,
-    IN UINT32                 BufferByteSize,
-    IN UINT32                 Iterations
+EFI_STATUS
+EFIAPI
+MmcFlushBlocks(
+    IN EFI_BLOCK_IO_PROTOCOL  *This
     )
 {
-    ASSERT(Iterations > 0);
-
-    EFI_STATUS Status;
-    UINT32 BufferSizeKB = INT_DIV_ROUND(BufferByteSize, 1024);
-    VOID* Buffer = AllocateZeroPool(BufferByteSize);
-    if (Buffer == NULL) {
-        DEBUG((EFI_D_ERROR, "MmcBenchmarkBlockIo() : No enough memory to allocate %dKB buffer\n", BufferSizeKB));
-        Status = EFI_OUT_OF_RESOURCES;
-        goto Exit;
-    }
-
-    UINT32 CurrIteration = Iterations;
-    UINT64 TotalTransfersTimeUs = 0;
-
-    while (CurrIteration--) {
-        UINT64 StartTime = GetPerformanceCounter();
-
-        Status = MmcIoBlocks(
-            This,
-            Transfer,
-            MediaId,
-            0, // Lba
-            BufferByteSize,
-            Buffer
-            );
-        if (EFI_ERROR(Status)) {
-            goto Exit;
-        }
+    EFI_STATUS          Status;
+    EFI_TPL             OldTpl;
+    MMC_HOST_INSTANCE   *MmcHostInstance;
 
-        UINT64 EndTime = GetPerformanceCounter();
-        TotalTransfersTimeUs += (((EndTime - StartTime) * 1000000UL) / mHpcTicksPerSeconds);
-    }
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO_THIS(This);
 
-    UINT32 KBps = (UINT32)(((UINT64)BufferSizeKB * (UINT64)Iterations * 1000000UL) / TotalTransfersTimeUs);
-    DEBUG((
-        EFI_D_INIT,
-        "- MmcBenchmarkBlockIo(%a, %dKB)\t: Xfr Avg:%dus\t%dKBps\t%dMBps\n",
-        (Transfer == MMC_IOBLOCKS_READ) ? "Read" : "Write",
-        BufferSizeKB,
-        (UINT32)(TotalTransfersTimeUs / Iterations),
-        KBps,
-        INT_DIV_ROUND(KBps, 1024)));
+    // The pending BlockIo2 writes are part of what gets flushed
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+    MmcIo2DrainQueue(MmcHostInstance);
+    Status = MmcFlushBlocksLocked(MmcHostInstance);
+    gBS->RestoreTPL(OldTpl);
 
-Exit:
-    if (Buffer != NULL) {
-        FreePool(Buffer);
-    }
+    return Status;
 }
 
 EFI_STATUS
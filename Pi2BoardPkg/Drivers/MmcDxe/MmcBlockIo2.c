@@ -0,0 +1,478 @@
+/** @file
+*
+*  Copyright (c) 2011-2014, ARM Limited. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+
+#include "Mmc.h"
+
+//
+// Non-blocking requests are queued in order on the instance and drained from a
+// timer callback at MMC_IO_TPL, one slice of at most MMC_IO2_MAX_BLOCKS_PER_TICK
+// blocks of the request at the head of the queue at a time.
+//
+// When the host can leave the data of a transfer moving (StartBlockData()) and the
+// slice bypasses the cache, the callback only sends the command and starts the data,
+// then returns to the caller while the host moves it. The following ticks poll the
+// host every MMC_IO2_POLL_PERIOD and close the transfer once the data landed. Other
+// slices are transferred synchronously from the callback.
+//
+// Everything else that reaches the card (BlockIo, flushes, resets, the cache
+// controls) drains the queue first, so it is ordered after the requests queued so
+// far and never finds a transfer running.
+//
+
+VOID
+MmcIo2CompleteRequest(
+    IN MMC_IO2_REQUEST          *Request,
+    IN EFI_STATUS               Status
+    )
+{
+    RemoveEntryList(&Request->Link);
+
+    Request->Token->TransactionStatus = Status;
+    gBS->SignalEvent(Request->Token->Event);
+
+    FreePool(Request);
+}
+
+/**
+  Returns TRUE if the data of the slice can keep moving once the callback returned
+**/
+BOOLEAN
+MmcIo2CanOverlap(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance,
+    IN MMC_IO2_REQUEST          *Request,
+    IN UINTN                    SliceSize
+    )
+{
+    EFI_MMC_HOST_PROTOCOL *MmcHost;
+
+    MmcHost = MmcHostInstance->MmcHost;
+
+    // Only hosts that take the data of a whole transfer at once (DMA) can leave it
+    // moving. The lines touched by a cached transfer have to be filled or written
+    // back in between, so only transfers going straight to the card are left running.
+    return MMC_HOST_HAS_ASYNCBLOCKDATA(MmcHost) &&
+           MMC_HOST_HAS_ISMULTIBLOCK(MmcHost) &&
+           MmcHost->IsMultiBlock(MmcHost) &&
+           MmcCacheIsBypass(MmcHostInstance, Request->Transfer, Request->Lba, SliceSize);
+}
+
+/**
+  Sends the command of the next slice of Request and starts moving its data
+**/
+EFI_STATUS
+MmcIo2StartSlice(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance,
+    IN MMC_IO2_REQUEST          *Request,
+    IN UINTN                    SliceSize
+    )
+{
+    EFI_STATUS Status;
+    EFI_MMC_HOST_PROTOCOL *MmcHost;
+    UINTN BlockCount;
+
+    MmcHost = MmcHostInstance->MmcHost;
+
+    // The media may have changed since the request was queued
+    Status = MmcCheckIoParameters(
+        &MmcHostInstance->BlockIo,
+        Request->Transfer,
+        Request->MediaId,
+        Request->Lba,
+        SliceSize,
+        Request->Buffer);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Request->StartTime = GetPerformanceCounter();
+
+    Status = MmcCacheBypassStart(MmcHostInstance, Request->Transfer);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    BlockCount = SliceSize / MmcHostInstance->BlockIo.Media->BlockSize;
+    Status = MmcStartTransfer(
+        MmcHostInstance,
+        Request->Transfer,
+        Request->Lba,
+        &BlockCount,
+        &Request->IsStopRequired);
+    if (EFI_ERROR(Status)) {
+        MmcStatsRecord(MmcHostInstance, Request->Transfer, SliceSize, Request->StartTime, Status);
+        return Status;
+    }
+
+    // Single block writes once the card turned multiple block writes down
+    SliceSize = BlockCount * MmcHostInstance->BlockIo.Media->BlockSize;
+
+    Status = MmcHost->StartBlockData(
+        MmcHost,
+        (Request->Transfer == MMC_IOBLOCKS_READ),
+        Request->Lba,
+        SliceSize,
+        Request->Buffer);
+    if (EFI_ERROR(Status)) {
+        MmcStopTransmission(MmcHost);
+        MmcStatsRecord(MmcHostInstance, Request->Transfer, SliceSize, Request->StartTime, Status);
+        return Status;
+    }
+
+    Request->SliceSize = SliceSize;
+    return EFI_SUCCESS;
+}
+
+/**
+  Closes the transfer of the running slice of Request once its data landed.
+  Returns EFI_NOT_READY as long as the host is still moving it.
+**/
+EFI_STATUS
+MmcIo2FinishSlice(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance,
+    IN MMC_IO2_REQUEST          *Request
+    )
+{
+    EFI_STATUS Status;
+    EFI_MMC_HOST_PROTOCOL *MmcHost;
+
+    MmcHost = MmcHostInstance->MmcHost;
+
+    Status = MmcHost->PollBlockData(MmcHost);
+    if (Status == EFI_NOT_READY) {
+        return Status;
+    }
+
+    if (EFI_ERROR(Status)) {
+        MmcStopTransmission(MmcHost);
+    } else {
+        Status = MmcEndTransfer(MmcHostInstance, Request->IsStopRequired);
+    }
+
+    if (!EFI_ERROR(Status)) {
+        MmcCacheBypassDone(
+            MmcHostInstance,
+            Request->Transfer,
+            Request->Lba,
+            Request->SliceSize,
+            Request->Buffer);
+    }
+
+    MmcStatsRecord(MmcHostInstance, Request->Transfer, Request->SliceSize, Request->StartTime, Status);
+    return Status;
+}
+
+/**
+  Moves the request at the head of the queue one step on, must be called at MMC_IO_TPL.
+
+  @retval TRUE    The host is moving the data of a slice, check again later.
+  @retval FALSE   The queue can move on right away.
+**/
+BOOLEAN
+MmcIo2ProcessQueue(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance
+    )
+{
+    EFI_STATUS Status;
+    MMC_IO2_REQUEST *Request;
+    UINTN SliceSize;
+
+    if (IsListEmpty(&MmcHostInstance->Io2Queue)) {
+        return FALSE;
+    }
+
+    Request = MMC_IO2_REQUEST_FROM_LINK(GetFirstNode(&MmcHostInstance->Io2Queue));
+
+    if (Request->Transfer == MMC_IOBLOCKS_FLUSH) {
+        // Everything queued before the flush is already on the card
+        Status = MmcFlushBlocksLocked(MmcHostInstance);
+        MmcIo2CompleteRequest(Request, Status);
+        return FALSE;
+    }
+
+    if (Request->SliceSize != 0) {
+        Status = MmcIo2FinishSlice(MmcHostInstance, Request);
+        if (Status == EFI_NOT_READY) {
+            return TRUE;
+        }
+        SliceSize = Request->SliceSize;
+        Request->SliceSize = 0;
+    } else {
+        SliceSize = MIN(
+            Request->BufferSize,
+            MMC_IO2_MAX_BLOCKS_PER_TICK * MmcHostInstance->BlockIo.Media->BlockSize);
+
+        if (MmcIo2CanOverlap(MmcHostInstance, Request, SliceSize)) {
+            Status = MmcIo2StartSlice(MmcHostInstance, Request, SliceSize);
+            if (!EFI_ERROR(Status)) {
+                return TRUE;
+            }
+        } else {
+            Status = MmcIoBlocksLocked(
+                MmcHostInstance,
+                Request->Transfer,
+                Request->MediaId,
+                Request->Lba,
+                SliceSize,
+                Request->Buffer);
+        }
+    }
+
+    if (EFI_ERROR(Status)) {
+        DEBUG((
+            EFI_D_ERROR,
+            "MmcDxe: MmcIo2ProcessQueue(%c, 0x%lx, 0x%xB): Error %r\n",
+            (Request->Transfer == MMC_IOBLOCKS_WRITE) ? 'W' : 'R',
+            Request->Lba,
+            (UINT32)SliceSize,
+            Status));
+        MmcIo2CompleteRequest(Request, Status);
+        return FALSE;
+    }
+
+    Request->Lba += SliceSize / MmcHostInstance->BlockIo.Media->BlockSize;
+    Request->Buffer = (UINT8*)Request->Buffer + SliceSize;
+    Request->BufferSize -= SliceSize;
+
+    if (Request->BufferSize == 0) {
+        MmcIo2CompleteRequest(Request, EFI_SUCCESS);
+    }
+
+    return FALSE;
+}
+
+VOID
+EFIAPI
+MmcIo2QueueCallback(
+    IN  EFI_EVENT   Event,
+    IN  VOID        *Context
+    )
+{
+    MMC_HOST_INSTANCE *MmcHostInstance = (MMC_HOST_INSTANCE*)Context;
+
+    if (MmcIo2ProcessQueue(MmcHostInstance)) {
+        // The caller runs while the host moves the data
+        gBS->SetTimer(MmcHostInstance->Io2QueueEvent, TimerRelative, MMC_IO2_POLL_PERIOD);
+    } else if (!IsListEmpty(&MmcHostInstance->Io2Queue)) {
+        // Come back on the next tick for whatever is left
+        gBS->SetTimer(MmcHostInstance->Io2QueueEvent, TimerRelative, 0);
+    }
+}
+
+/**
+  Blocks until all the queued requests are done, so whatever reaches the card next
+  is ordered after them
+**/
+VOID
+MmcIo2DrainQueue(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance
+    )
+{
+    EFI_TPL OldTpl;
+
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+    while (!IsListEmpty(&MmcHostInstance->Io2Queue)) {
+        MmcIo2ProcessQueue(MmcHostInstance);
+    }
+    gBS->SetTimer(MmcHostInstance->Io2QueueEvent, TimerCancel, 0);
+    gBS->RestoreTPL(OldTpl);
+}
+
+VOID
+MmcIo2AbortQueue(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance
+    )
+{
+    EFI_TPL OldTpl;
+    MMC_IO2_REQUEST *Request;
+
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+
+    // Data the host is already moving can't be called back, let it land first
+    while (!IsListEmpty(&MmcHostInstance->Io2Queue)) {
+        Request = MMC_IO2_REQUEST_FROM_LINK(GetFirstNode(&MmcHostInstance->Io2Queue));
+        if (Request->SliceSize == 0) {
+            break;
+        }
+        MmcIo2ProcessQueue(MmcHostInstance);
+    }
+
+    while (!IsListEmpty(&MmcHostInstance->Io2Queue)) {
+        MmcIo2CompleteRequest(
+            MMC_IO2_REQUEST_FROM_LINK(GetFirstNode(&MmcHostInstance->Io2Queue)),
+            EFI_ABORTED);
+    }
+    gBS->SetTimer(MmcHostInstance->Io2QueueEvent, TimerCancel, 0);
+    gBS->RestoreTPL(OldTpl);
+}
+
+EFI_STATUS
+MmcIo2QueueRequest(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance,
+    IN UINTN                    Transfer,
+    IN UINT32                   MediaId,
+    IN EFI_LBA                  Lba,
+    IN EFI_BLOCK_IO2_TOKEN      *Token,
+    IN UINTN                    BufferSize,
+    IN VOID                     *Buffer
+    )
+{
+    EFI_STATUS Status;
+    EFI_TPL OldTpl;
+    MMC_IO2_REQUEST *Request;
+
+    Request = AllocatePool(sizeof(MMC_IO2_REQUEST));
+    if (Request == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Request->Signature = MMC_IO2_REQUEST_SIGNATURE;
+    Request->Transfer = Transfer;
+    Request->MediaId = MediaId;
+    Request->Lba = Lba;
+    Request->BufferSize = BufferSize;
+    Request->Buffer = Buffer;
+    Request->Token = Token;
+    Request->SliceSize = 0;
+
+    Token->TransactionStatus = EFI_NOT_READY;
+
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+    {
+        InsertTailList(&MmcHostInstance->Io2Queue, &Request->Link);
+
+        Status = gBS->SetTimer(MmcHostInstance->Io2QueueEvent, TimerRelative, 0);
+        if (EFI_ERROR(Status)) {
+            RemoveEntryList(&Request->Link);
+            FreePool(Request);
+        }
+    }
+    gBS->RestoreTPL(OldTpl);
+
+    return Status;
+}
+
+EFI_STATUS
+MmcIoBlocksEx(
+    IN EFI_BLOCK_IO2_PROTOCOL   *This,
+    IN UINTN                    Transfer,
+    IN UINT32                   MediaId,
+    IN EFI_LBA                  Lba,
+    IN EFI_BLOCK_IO2_TOKEN      *Token,
+    IN UINTN                    BufferSize,
+    IN VOID                     *Buffer
+    )
+{
+    EFI_STATUS Status;
+    MMC_HOST_INSTANCE *MmcHostInstance;
+
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS(This);
+
+    if ((Token == NULL) || (Token->Event == NULL)) {
+        // Drains the queue first
+        return MmcIoBlocks(&MmcHostInstance->BlockIo, Transfer, MediaId, Lba, BufferSize, Buffer);
+    }
+
+    // Parameter errors are reported right away rather than through the token
+    Status = MmcCheckIoParameters(&MmcHostInstance->BlockIo, Transfer, MediaId, Lba, BufferSize, Buffer);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    if (BufferSize == 0) {
+        Token->TransactionStatus = EFI_SUCCESS;
+        gBS->SignalEvent(Token->Event);
+        return EFI_SUCCESS;
+    }
+
+    return MmcIo2QueueRequest(MmcHostInstance, Transfer, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcResetEx(
+    IN EFI_BLOCK_IO2_PROTOCOL   *This,
+    IN BOOLEAN                  ExtendedVerification
+    )
+{
+    MMC_HOST_INSTANCE *MmcHostInstance;
+
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS(This);
+
+    MmcIo2AbortQueue(MmcHostInstance);
+
+    return MmcReset(&MmcHostInstance->BlockIo, ExtendedVerification);
+}
+
+EFI_STATUS
+EFIAPI
+MmcReadBlocksEx(
+    IN     EFI_BLOCK_IO2_PROTOCOL *This,
+    IN     UINT32                 MediaId,
+    IN     EFI_LBA                Lba,
+    IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+    IN     UINTN                  BufferSize,
+       OUT VOID                   *Buffer
+    )
+{
+    return MmcIoBlocksEx(This, MMC_IOBLOCKS_READ, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcWriteBlocksEx(
+    IN     EFI_BLOCK_IO2_PROTOCOL *This,
+    IN     UINT32                 MediaId,
+    IN     EFI_LBA                Lba,
+    IN OUT EFI_BLOCK_IO2_TOKEN    *Token,
+    IN     UINTN                  BufferSize,
+    IN     VOID                   *Buffer
+    )
+{
+    return MmcIoBlocksEx(This, MMC_IOBLOCKS_WRITE, MediaId, Lba, Token, BufferSize, Buffer);
+}
+
+EFI_STATUS
+EFIAPI
+MmcFlushBlocksEx(
+    IN     EFI_BLOCK_IO2_PROTOCOL *This,
+    IN OUT EFI_BLOCK_IO2_TOKEN    *Token
+    )
+{
+    MMC_HOST_INSTANCE *MmcHostInstance;
+
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_BLOCK_IO2_THIS(This);
+
+    if (!This->Media->MediaPresent) {
+        return EFI_NO_MEDIA;
+    }
+
+    if ((Token == NULL) || (Token->Event == NULL)) {
+        // Drains the queue first
+        return MmcFlushBlocks(&MmcHostInstance->BlockIo);
+    }
+
+    // Queued behind the pending writes, so it completes only once they are on the card
+    return MmcIo2QueueRequest(
+        MmcHostInstance,
+        MMC_IOBLOCKS_FLUSH,
+        This->Media->MediaId,
+        0,
+        Token,
+        0,
+        NULL);
+}
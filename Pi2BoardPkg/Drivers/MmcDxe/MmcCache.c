@@ -0,0 +1,912 @@
+/** @file
+*
+*  Copyright (c) 2011-2014, ARM Limited. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Guid/EventGroup.h>
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#include "Mmc.h"
+
+//
+// The cache holds whole lines of PcdMmcCacheLineSize bytes, looked up through a
+// small hash table and recycled in LRU order. Small requests (FAT metadata, directory
+// entries) are served from it, requests larger than PcdMmcCacheMaxRequestSize go
+// straight to the card and are only made coherent with the lines already cached.
+//
+// The cache is only ever touched at MMC_IO_TPL, from MmcIoBlocks() and MmcFlushBlocks()
+// and from the BlockIo2 queue, which bypasses it the same way for the transfers it
+// leaves running.
+//
+
+#define MMC_CACHE_LINE_INDEX(Cache, Lba)        ((Lba) / (Cache)->LineBlocks)
+#define MMC_CACHE_LINE_LBA(Cache, Lba)          ((Lba) - ((Lba) % (Cache)->LineBlocks))
+#define MMC_CACHE_HASH(Cache, LineLba)          ((UINTN)MMC_CACHE_LINE_INDEX(Cache, LineLba) % MMC_CACHE_HASH_BUCKETS)
+
+// Number of back to back requests after which a stream is treated as sequential
+#define MMC_CACHE_SEQUENTIAL_THRESHOLD          2
+
+//
+// The dirty lines are written back in the order they were written, never in LBA order
+// alone, so the card never holds a write without the ones issued before it. A line
+// dirtied before the last write is written back before it takes new data, and a write
+// going straight to the card is preceded by a flush.
+//
+
+// ResetSystem() of the runtime services table while the caches hook it
+STATIC EFI_RESET_SYSTEM mMmcCacheResetSystem = NULL;
+
+STATIC
+MMC_CACHE_LINE*
+MmcCacheLookup(
+    IN MMC_CACHE    *Cache,
+    IN EFI_LBA      LineLba
+    )
+{
+    LIST_ENTRY *Bucket;
+    LIST_ENTRY *Link;
+    MMC_CACHE_LINE *Line;
+
+    Bucket = &Cache->HashBuckets[MMC_CACHE_HASH(Cache, LineLba)];
+    for (Link = GetFirstNode(Bucket); !IsNull(Bucket, Link); Link = GetNextNode(Bucket, Link)) {
+        Line = MMC_CACHE_LINE_FROM_HASH_LINK(Link);
+        if (Line->Lba == LineLba) {
+            // Most recently used lines live at the head of the LRU list
+            RemoveEntryList(&Line->LruLink);
+            InsertHeadList(&Cache->LruList, &Line->LruLink);
+            return Line;
+        }
+    }
+
+    return NULL;
+}
+
+STATIC
+VOID
+MmcCacheDiscardLine(
+    IN MMC_CACHE        *Cache,
+    IN MMC_CACHE_LINE   *Line
+    )
+{
+    RemoveEntryList(&Line->HashLink);
+    RemoveEntryList(&Line->LruLink);
+    Line->Dirty = FALSE;
+    InsertTailList(&Cache->FreeList, &Line->LruLink);
+}
+
+/**
+  Sorts the lines in write order, lines of the same write in LBA order
+**/
+STATIC
+VOID
+MmcCacheSortLines(
+    IN MMC_CACHE_LINE   **Table,
+    IN UINTN            NumEntries
+    )
+{
+    // Using the simple insertion sort, the number of dirty lines is small
+    UINTN Idx;
+    for (Idx = 1; Idx < NumEntries; ++Idx) {
+        MMC_CACHE_LINE *CurrEntry = Table[Idx];
+        UINTN J = Idx;
+        while (J > 0 &&
+               ((Table[J - 1]->DirtySeq > CurrEntry->DirtySeq) ||
+                ((Table[J - 1]->DirtySeq == CurrEntry->DirtySeq) && (Table[J - 1]->Lba > CurrEntry->Lba)))) {
+            Table[J] = Table[J - 1];
+            --J;
+        }
+        Table[J] = CurrEntry;
+    }
+}
+
+/**
+  Writes all the dirty lines back to the card in write order. Lines that are next to
+  each other both in that order and on the card are gathered in the staging buffer,
+  so each run goes out as a single multiple block write
+**/
+EFI_STATUS
+MmcCacheFlush(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance
+    )
+{
+    EFI_STATUS Status;
+    MMC_CACHE *Cache;
+    LIST_ENTRY *Link;
+    MMC_CACHE_LINE *Line;
+    UINTN DirtyCount;
+    UINTN RunStart;
+    UINTN RunLength;
+    UINTN Idx;
+    VOID *Buffer;
+
+    Cache = &MmcHostInstance->Cache;
+    if (!Cache->Enabled || (Cache->LineBlocks == 0)) {
+        return EFI_SUCCESS;
+    }
+
+    DirtyCount = 0;
+    for (Link = GetFirstNode(&Cache->LruList); !IsNull(&Cache->LruList, Link); Link = GetNextNode(&Cache->LruList, Link)) {
+        Line = MMC_CACHE_LINE_FROM_LRU_LINK(Link);
+        if (Line->Dirty) {
+            Cache->DirtyLines[DirtyCount++] = Line;
+        }
+    }
+
+    if (DirtyCount == 0) {
+        return EFI_SUCCESS;
+    }
+
+    MmcCacheSortLines(Cache->DirtyLines, DirtyCount);
+
+    for (RunStart = 0; RunStart < DirtyCount; RunStart += RunLength) {
+        RunLength = 1;
+        while ((RunStart + RunLength < DirtyCount) &&
+               (RunLength < Cache->StagingLines) &&
+               (Cache->DirtyLines[RunStart + RunLength]->Lba ==
+                Cache->DirtyLines[RunStart]->Lba + (RunLength * Cache->LineBlocks))) {
+            ++RunLength;
+        }
+
+        if (RunLength == 1) {
+            Buffer = Cache->DirtyLines[RunStart]->Data;
+        } else {
+            for (Idx = 0; Idx < RunLength; ++Idx) {
+                CopyMem(
+                    Cache->StagingBuffer + (Idx * Cache->LineSize),
+                    Cache->DirtyLines[RunStart + Idx]->Data,
+                    Cache->LineSize);
+            }
+            Buffer = Cache->StagingBuffer;
+        }
+
+        Status = MmcTransferBlocks(
+            &MmcHostInstance->BlockIo,
+            MMC_IOBLOCKS_WRITE,
+            MmcHostInstance->BlockIo.Media->MediaId,
+            Cache->DirtyLines[RunStart]->Lba,
+            RunLength * Cache->LineSize,
+            Buffer);
+        if (EFI_ERROR(Status)) {
+            DEBUG((
+                EFI_D_ERROR,
+                "MmcDxe: MmcCacheFlush(0x%lx, %d lines): Error %r\n",
+                Cache->DirtyLines[RunStart]->Lba,
+                (UINT32)RunLength,
+                Status));
+            return Status;
+        }
+
+        for (Idx = 0; Idx < RunLength; ++Idx) {
+            Cache->DirtyLines[RunStart + Idx]->Dirty = FALSE;
+        }
+
+        Cache->Stats.FlushedLines += RunLength;
+        ++Cache->Stats.FlushWrites;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Takes a line for LineLba from the free list, or recycles the least recently used one.
+  The content of the returned line is undefined
+**/
+STATIC
+EFI_STATUS
+MmcCacheAllocateLine(
+    IN  MMC_HOST_INSTANCE   *MmcHostInstance,
+    IN  EFI_LBA             LineLba,
+    OUT MMC_CACHE_LINE      **Line
+    )
+{
+    EFI_STATUS Status;
+    MMC_CACHE *Cache;
+    MMC_CACHE_LINE *Victim;
+
+    Cache = &MmcHostInstance->Cache;
+
+    if (IsListEmpty(&Cache->FreeList)) {
+        Victim = MMC_CACHE_LINE_FROM_LRU_LINK(GetPreviousNode(&Cache->LruList, &Cache->LruList));
+        if (Victim->Dirty) {
+            // Write back everything rather than the victim alone, so the card gets
+            // a few large writes instead of a trickle of single lines
+            Status = MmcCacheFlush(MmcHostInstance);
+            if (EFI_ERROR(Status)) {
+                return Status;
+            }
+        }
+        MmcCacheDiscardLine(Cache, Victim);
+        ++Cache->Stats.Evictions;
+    }
+
+    *Line = MMC_CACHE_LINE_FROM_LRU_LINK(GetFirstNode(&Cache->FreeList));
+    RemoveEntryList(&(*Line)->LruLink);
+
+    (*Line)->Lba = LineLba;
+    (*Line)->Dirty = FALSE;
+    InsertHeadList(&Cache->LruList, &(*Line)->LruLink);
+    InsertTailList(&Cache->HashBuckets[MMC_CACHE_HASH(Cache, LineLba)], &(*Line)->HashLink);
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Reads LineCount consecutive lines that are not cached yet with a single transfer
+**/
+STATIC
+EFI_STATUS
+MmcCacheFill(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance,
+    IN EFI_LBA              LineLba,
+    IN UINTN                LineCount
+    )
+{
+    EFI_STATUS Status;
+    MMC_CACHE *Cache;
+    MMC_CACHE_LINE *Line;
+    UINTN Idx;
+
+    Cache = &MmcHostInstance->Cache;
+    ASSERT(LineCount <= Cache->StagingLines);
+
+    // Allocate first, evicting a dirty line flushes through the staging buffer
+    for (Idx = 0; Idx < LineCount; ++Idx) {
+        Status = MmcCacheAllocateLine(MmcHostInstance, LineLba + (Idx * Cache->LineBlocks), &Line);
+        if (EFI_ERROR(Status)) {
+            LineCount = Idx;
+            goto DISCARD_LINES;
+        }
+    }
+
+    Status = MmcTransferBlocks(
+        &MmcHostInstance->BlockIo,
+        MMC_IOBLOCKS_READ,
+        MmcHostInstance->BlockIo.Media->MediaId,
+        LineLba,
+        LineCount * Cache->LineSize,
+        Cache->StagingBuffer);
+    if (EFI_ERROR(Status)) {
+        goto DISCARD_LINES;
+    }
+
+    for (Idx = 0; Idx < LineCount; ++Idx) {
+        Line = MmcCacheLookup(Cache, LineLba + (Idx * Cache->LineBlocks));
+        ASSERT(Line != NULL);
+        CopyMem(Line->Data, Cache->StagingBuffer + (Idx * Cache->LineSize), Cache->LineSize);
+    }
+
+    return EFI_SUCCESS;
+
+DISCARD_LINES:
+    for (Idx = 0; Idx < LineCount; ++Idx) {
+        Line = MmcCacheLookup(Cache, LineLba + (Idx * Cache->LineBlocks));
+        if (Line != NULL) {
+            MmcCacheDiscardLine(Cache, Line);
+        }
+    }
+
+    return Status;
+}
+
+/**
+  Copies the part of Line that overlaps [Lba, Lba + BufferSize) from or into Buffer.
+  Returns TRUE if there was an overlap
+**/
+STATIC
+BOOLEAN
+MmcCacheCopyOverlap(
+    IN MMC_CACHE        *Cache,
+    IN MMC_CACHE_LINE   *Line,
+    IN UINT32           BlockSize,
+    IN EFI_LBA          Lba,
+    IN UINTN            BufferSize,
+    IN VOID             *Buffer,
+    IN BOOLEAN          ToLine
+    )
+{
+    EFI_LBA Start;
+    EFI_LBA End;
+    UINT8 *LineData;
+    UINT8 *BufferData;
+    UINTN Size;
+
+    Start = MAX(Lba, Line->Lba);
+    End = MIN(Lba + (BufferSize / BlockSize), Line->Lba + Cache->LineBlocks);
+    if (Start >= End) {
+        return FALSE;
+    }
+
+    LineData = Line->Data + (UINTN)(Start - Line->Lba) * BlockSize;
+    BufferData = (UINT8*)Buffer + (UINTN)(Start - Lba) * BlockSize;
+    Size = (UINTN)(End - Start) * BlockSize;
+
+    if (ToLine) {
+        CopyMem(LineData, BufferData, Size);
+    } else {
+        CopyMem(BufferData, LineData, Size);
+    }
+
+    return TRUE;
+}
+
+/**
+  Returns TRUE if the request goes straight to the card rather than through the lines
+**/
+BOOLEAN
+MmcCacheIsBypass(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance,
+    IN UINTN                Transfer,
+    IN EFI_LBA              Lba,
+    IN UINTN                BufferSize
+    )
+{
+    MMC_CACHE *Cache;
+    EFI_BLOCK_IO_MEDIA *Media;
+    EFI_LBA LastLineLba;
+
+    Cache = &MmcHostInstance->Cache;
+    Media = MmcHostInstance->BlockIo.Media;
+
+    if (!Cache->Enabled || (Cache->LineBlocks == 0)) {
+        return TRUE;
+    }
+
+    // Large requests, write-through writes and the partial line at the end of the
+    // media do not go through the lines
+    LastLineLba = MMC_CACHE_LINE_LBA(Cache, Lba + (BufferSize / Media->BlockSize) - 1);
+    return (BufferSize > Cache->MaxRequestSize) ||
+           ((Transfer == MMC_IOBLOCKS_WRITE) && !Cache->WriteBack) ||
+           (LastLineLba + Cache->LineBlocks > Media->LastBlock + 1);
+}
+
+/**
+  Writes the dirty lines back ahead of a write going straight to the card, so that it
+  doesn't overtake them
+**/
+EFI_STATUS
+MmcCacheBypassStart(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance,
+    IN UINTN                Transfer
+    )
+{
+    if (Transfer != MMC_IOBLOCKS_WRITE) {
+        return EFI_SUCCESS;
+    }
+
+    return MmcCacheFlush(MmcHostInstance);
+}
+
+/**
+  Keeps the cached lines coherent with a transfer that went straight between the
+  card and Buffer: written data updates the lines it overlaps, read data is patched
+  with dirty lines
+**/
+VOID
+MmcCacheBypassDone(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance,
+    IN UINTN                Transfer,
+    IN EFI_LBA              Lba,
+    IN UINTN                BufferSize,
+    IN OUT VOID             *Buffer
+    )
+{
+    MMC_CACHE *Cache;
+    LIST_ENTRY *Link;
+    MMC_CACHE_LINE *Line;
+
+    Cache = &MmcHostInstance->Cache;
+
+    if (!Cache->Enabled || (Cache->LineBlocks == 0)) {
+        return;
+    }
+
+    ++Cache->Stats.Bypasses;
+
+    for (Link = GetFirstNode(&Cache->LruList); !IsNull(&Cache->LruList, Link); Link = GetNextNode(&Cache->LruList, Link)) {
+        Line = MMC_CACHE_LINE_FROM_LRU_LINK(Link);
+        if (Transfer == MMC_IOBLOCKS_WRITE) {
+            MmcCacheCopyOverlap(Cache, Line, MmcHostInstance->BlockIo.Media->BlockSize, Lba, BufferSize, Buffer, TRUE);
+        } else if (Line->Dirty) {
+            MmcCacheCopyOverlap(Cache, Line, MmcHostInstance->BlockIo.Media->BlockSize, Lba, BufferSize, Buffer, FALSE);
+        }
+    }
+}
+
+STATIC
+EFI_STATUS
+MmcCacheRead(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance,
+    IN EFI_LBA              Lba,
+    IN UINTN                BufferSize,
+    OUT VOID                *Buffer
+    )
+{
+    EFI_STATUS Status;
+    MMC_CACHE *Cache;
+    MMC_CACHE_LINE *Line;
+    EFI_BLOCK_IO_MEDIA *Media;
+    EFI_LBA EndLba;
+    EFI_LBA LineLba;
+    EFI_LBA RunEndLba;
+    EFI_LBA FilledEndLba;
+    UINTN RunLines;
+    UINTN RequestLines;
+
+    Cache = &MmcHostInstance->Cache;
+    Media = MmcHostInstance->BlockIo.Media;
+    EndLba = Lba + (BufferSize / Media->BlockSize);
+    FilledEndLba = 0;
+
+    // Detect sequential streams, they get the following lines prefetched on a miss
+    if (Lba == Cache->NextSequentialLba) {
+        ++Cache->SequentialCount;
+    } else {
+        Cache->SequentialCount = 0;
+    }
+    Cache->NextSequentialLba = EndLba;
+
+    for (LineLba = MMC_CACHE_LINE_LBA(Cache, Lba); LineLba < EndLba; LineLba += Cache->LineBlocks) {
+        Line = MmcCacheLookup(Cache, LineLba);
+        if (Line == NULL) {
+            // Gather the run of missing lines covering the rest of the request
+            RequestLines = 0;
+            for (RunEndLba = LineLba;
+                 (RunEndLba < EndLba) && (RequestLines < Cache->StagingLines);
+                 RunEndLba += Cache->LineBlocks) {
+                if ((RunEndLba != LineLba) && (MmcCacheLookup(Cache, RunEndLba) != NULL)) {
+                    break;
+                }
+                ++RequestLines;
+            }
+
+            // Read ahead past the end of the request while the following lines are
+            // missing, are on the card and fit in the staging buffer
+            RunLines = RequestLines;
+            if ((RunEndLba >= EndLba) && (Cache->SequentialCount >= MMC_CACHE_SEQUENTIAL_THRESHOLD)) {
+                while ((RunLines < RequestLines + Cache->ReadAheadLines) &&
+                       (RunLines < Cache->StagingLines) &&
+                       (RunEndLba + Cache->LineBlocks <= Media->LastBlock + 1) &&
+                       (MmcCacheLookup(Cache, RunEndLba) == NULL)) {
+                    RunEndLba += Cache->LineBlocks;
+                    ++RunLines;
+                }
+            }
+
+            Status = MmcCacheFill(MmcHostInstance, LineLba, RunLines);
+            if (EFI_ERROR(Status)) {
+                return Status;
+            }
+
+            Cache->Stats.ReadMisses += RequestLines;
+            Cache->Stats.ReadAheadLines += RunLines - RequestLines;
+            FilledEndLba = LineLba + (RequestLines * Cache->LineBlocks);
+
+            Line = MmcCacheLookup(Cache, LineLba);
+            ASSERT(Line != NULL);
+        } else if (LineLba >= FilledEndLba) {
+            ++Cache->Stats.ReadHits;
+        }
+
+        MmcCacheCopyOverlap(Cache, Line, Media->BlockSize, Lba, BufferSize, Buffer, FALSE);
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+MmcCacheWrite(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance,
+    IN EFI_LBA              Lba,
+    IN UINTN                BufferSize,
+    IN VOID                 *Buffer
+    )
+{
+    EFI_STATUS Status;
+    MMC_CACHE *Cache;
+    MMC_CACHE_LINE *Line;
+    EFI_BLOCK_IO_MEDIA *Media;
+    EFI_LBA EndLba;
+    EFI_LBA LineLba;
+
+    Cache = &MmcHostInstance->Cache;
+    Media = MmcHostInstance->BlockIo.Media;
+    EndLba = Lba + (BufferSize / Media->BlockSize);
+
+    // A line dirtied before the last write would take this one ahead of that write
+    for (LineLba = MMC_CACHE_LINE_LBA(Cache, Lba); LineLba < EndLba; LineLba += Cache->LineBlocks) {
+        Line = MmcCacheLookup(Cache, LineLba);
+        if ((Line != NULL) && Line->Dirty && (Line->DirtySeq != Cache->WriteSeq)) {
+            Status = MmcCacheFlush(MmcHostInstance);
+            if (EFI_ERROR(Status)) {
+                return Status;
+            }
+            break;
+        }
+    }
+
+    ++Cache->WriteSeq;
+
+    for (LineLba = MMC_CACHE_LINE_LBA(Cache, Lba); LineLba < EndLba; LineLba += Cache->LineBlocks) {
+        Line = MmcCacheLookup(Cache, LineLba);
+        if (Line != NULL) {
+            ++Cache->Stats.WriteHits;
+        } else {
+            ++Cache->Stats.WriteMisses;
+            if ((LineLba >= Lba) && (LineLba + Cache->LineBlocks <= EndLba)) {
+                // The whole line is overwritten, no need to read it first
+                Status = MmcCacheAllocateLine(MmcHostInstance, LineLba, &Line);
+            } else {
+                Status = MmcCacheFill(MmcHostInstance, LineLba, 1);
+                Line = MmcCacheLookup(Cache, LineLba);
+            }
+            if (EFI_ERROR(Status)) {
+                return Status;
+            }
+        }
+
+        MmcCacheCopyOverlap(Cache, Line, Media->BlockSize, Lba, BufferSize, Buffer, TRUE);
+        Line->Dirty = TRUE;
+        Line->DirtySeq = Cache->WriteSeq;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+MmcCacheIoBlocks(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance,
+    IN UINTN                Transfer,
+    IN UINT32               MediaId,
+    IN EFI_LBA              Lba,
+    IN UINTN                BufferSize,
+    IN OUT VOID             *Buffer
+    )
+{
+    EFI_STATUS Status;
+    MMC_CACHE *Cache;
+
+    Cache = &MmcHostInstance->Cache;
+
+    if (!Cache->Enabled || (Cache->LineBlocks == 0)) {
+        return MmcTransferBlocks(&MmcHostInstance->BlockIo, Transfer, MediaId, Lba, BufferSize, Buffer);
+    }
+
+    Status = MmcCheckIoParameters(&MmcHostInstance->BlockIo, Transfer, MediaId, Lba, BufferSize, Buffer);
+    if (EFI_ERROR(Status) || (BufferSize == 0)) {
+        return Status;
+    }
+
+    if (MmcCacheIsBypass(MmcHostInstance, Transfer, Lba, BufferSize)) {
+        Status = MmcCacheBypassStart(MmcHostInstance, Transfer);
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+        Status = MmcTransferBlocks(&MmcHostInstance->BlockIo, Transfer, MediaId, Lba, BufferSize, Buffer);
+        if (!EFI_ERROR(Status)) {
+            MmcCacheBypassDone(MmcHostInstance, Transfer, Lba, BufferSize, Buffer);
+        }
+        return Status;
+    }
+
+    if (Transfer == MMC_IOBLOCKS_READ) {
+        return MmcCacheRead(MmcHostInstance, Lba, BufferSize, Buffer);
+    } else {
+        return MmcCacheWrite(MmcHostInstance, Lba, BufferSize, Buffer);
+    }
+}
+
+/**
+  Drops every line, dirty or not, and adapts the line geometry to the current media
+**/
+VOID
+MmcCacheInvalidate(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance
+    )
+{
+    MMC_CACHE *Cache;
+    UINT32 BlockSize;
+    UINTN Idx;
+
+    Cache = &MmcHostInstance->Cache;
+    if (Cache->Lines == NULL) {
+        return;
+    }
+
+    InitializeListHead(&Cache->LruList);
+    InitializeListHead(&Cache->FreeList);
+    for (Idx = 0; Idx < MMC_CACHE_HASH_BUCKETS; ++Idx) {
+        InitializeListHead(&Cache->HashBuckets[Idx]);
+    }
+
+    for (Idx = 0; Idx < Cache->LineCount; ++Idx) {
+        Cache->Lines[Idx].Dirty = FALSE;
+        InsertTailList(&Cache->FreeList, &Cache->Lines[Idx].LruLink);
+    }
+
+    BlockSize = MmcHostInstance->BlockIo.Media->BlockSize;
+    if ((BlockSize != 0) && ((Cache->LineSize % BlockSize) == 0)) {
+        Cache->LineBlocks = Cache->LineSize / BlockSize;
+    } else {
+        Cache->LineBlocks = 0;
+    }
+
+    Cache->NextSequentialLba = 0;
+    Cache->SequentialCount = 0;
+}
+
+/**
+  Turns the cache on or off at run time, must be called at MMC_IO_TPL
+**/
+EFI_STATUS
+MmcCacheEnable(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance,
+    IN BOOLEAN              Enable
+    )
+{
+    EFI_STATUS Status;
+    MMC_CACHE *Cache;
+
+    Cache = &MmcHostInstance->Cache;
+    if (Cache->Lines == NULL) {
+        return EFI_UNSUPPORTED;
+    }
+
+    if (Enable == Cache->Enabled) {
+        return EFI_SUCCESS;
+    }
+
+    if (Enable) {
+        // Writes went straight to the card while the cache was off
+        MmcCacheInvalidate(MmcHostInstance);
+        Cache->Enabled = TRUE;
+        MmcHostInstance->BlockIo.Media->WriteCaching = Cache->WriteBack;
+    } else {
+        Status = MmcCacheFlush(MmcHostInstance);
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+        Cache->Enabled = FALSE;
+        MmcHostInstance->BlockIo.Media->WriteCaching = FALSE;
+    }
+
+    return EFI_SUCCESS;
+}
+
+VOID
+MmcCacheDumpStatistics(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance
+    )
+{
+    MMC_CACHE_STATS *Stats = &MmcHostInstance->Cache.Stats;
+
+    DEBUG((
+        EFI_D_INFO,
+        "MmcDxe: Cache read %ld hits %ld misses %ld read-ahead, write %ld hits %ld misses\n",
+        Stats->ReadHits,
+        Stats->ReadMisses,
+        Stats->ReadAheadLines,
+        Stats->WriteHits,
+        Stats->WriteMisses));
+    DEBUG((
+        EFI_D_INFO,
+        "MmcDxe: Cache %ld lines flushed in %ld writes, %ld evictions, %ld bypasses\n",
+        Stats->FlushedLines,
+        Stats->FlushWrites,
+        Stats->Evictions,
+        Stats->Bypasses));
+}
+
+/**
+  Writes every cache back before the system resets, the dirty lines would be lost
+  otherwise. The card can't be accessed above MMC_IO_TPL, callers up there lose them.
+**/
+STATIC
+VOID
+EFIAPI
+MmcCacheResetSystemHook(
+    IN EFI_RESET_TYPE   ResetType,
+    IN EFI_STATUS       ResetStatus,
+    IN UINTN            DataSize,
+    IN VOID             *ResetData OPTIONAL
+    )
+{
+    LIST_ENTRY *Link;
+    MMC_HOST_INSTANCE *MmcHostInstance;
+    EFI_TPL OldTpl;
+
+    OldTpl = gBS->RaiseTPL(TPL_HIGH_LEVEL);
+    gBS->RestoreTPL(OldTpl);
+
+    if (OldTpl > MMC_IO_TPL) {
+        DEBUG((EFI_D_WARN, "MmcDxe: MmcCacheResetSystemHook(): Reset at TPL %d, cache not written back\n", OldTpl));
+    } else {
+        for (Link = GetFirstNode(&mMmcHostPool); !IsNull(&mMmcHostPool, Link); Link = GetNextNode(&mMmcHostPool, Link)) {
+            MmcHostInstance = MMC_HOST_INSTANCE_FROM_LINK(Link);
+            OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+            MmcIo2DrainQueue(MmcHostInstance);
+            MmcCacheFlush(MmcHostInstance);
+            gBS->RestoreTPL(OldTpl);
+        }
+    }
+
+    mMmcCacheResetSystem(ResetType, ResetStatus, DataSize, ResetData);
+}
+
+/**
+  Hooks ResetSystem() until ReadyToBoot, the reset driver has been dispatched by the
+  time the first card gets its cache
+**/
+STATIC
+VOID
+MmcCacheHookResetSystem(
+    IN BOOLEAN  Hook
+    )
+{
+    if (Hook && (mMmcCacheResetSystem == NULL)) {
+        mMmcCacheResetSystem = gRT->ResetSystem;
+        gRT->ResetSystem = MmcCacheResetSystemHook;
+    } else if (!Hook && (gRT->ResetSystem == MmcCacheResetSystemHook)) {
+        gRT->ResetSystem = mMmcCacheResetSystem;
+    } else {
+        return;
+    }
+
+    gRT->Hdr.CRC32 = 0;
+    gBS->CalculateCrc32(&gRT->Hdr, gRT->Hdr.HeaderSize, &gRT->Hdr.CRC32);
+}
+
+/**
+  The card can't be written from ExitBootServices, so the dirty lines are written
+  back at ReadyToBoot and the writes of the boot loader go straight to the card
+**/
+VOID
+EFIAPI
+MmcCacheReadyToBoot(
+    IN  EFI_EVENT   Event,
+    IN  VOID        *Context
+    )
+{
+    MMC_HOST_INSTANCE *MmcHostInstance = (MMC_HOST_INSTANCE*)Context;
+    EFI_TPL OldTpl;
+
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+    MmcIo2DrainQueue(MmcHostInstance);
+    MmcCacheFlush(MmcHostInstance);
+    MmcHostInstance->Cache.WriteBack = FALSE;
+    if (MmcHostInstance->Cache.Enabled) {
+        MmcHostInstance->BlockIo.Media->WriteCaching = FALSE;
+    }
+    gBS->RestoreTPL(OldTpl);
+
+    // Nothing is left to write back and the hook must not outlive the boot services
+    MmcCacheHookResetSystem(FALSE);
+
+    MmcCacheDumpStatistics(MmcHostInstance);
+}
+
+EFI_STATUS
+MmcCacheInitialize(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance
+    )
+{
+    EFI_STATUS Status;
+    MMC_CACHE *Cache;
+    UINTN Idx;
+
+    Cache = &MmcHostInstance->Cache;
+    ZeroMem(Cache, sizeof(MMC_CACHE));
+
+    Cache->LineSize = PcdGet32(PcdMmcCacheLineSize);
+    if ((PcdGet32(PcdMmcCacheSize) == 0) || (Cache->LineSize == 0)) {
+        return EFI_SUCCESS;
+    }
+
+    Cache->LineCount = PcdGet32(PcdMmcCacheSize) / Cache->LineSize;
+    Cache->ReadAheadLines = PcdGet32(PcdMmcCacheReadAheadSize) / Cache->LineSize;
+    Cache->WriteBack = PcdGetBool(PcdMmcCacheWriteBack);
+
+    // A single fill must never evict lines it has just brought in
+    Cache->MaxRequestSize = MIN(PcdGet32(PcdMmcCacheMaxRequestSize), (Cache->LineCount / 2) * Cache->LineSize);
+    Cache->StagingLines = MIN(
+        (Cache->MaxRequestSize / Cache->LineSize) + 1 + Cache->ReadAheadLines,
+        Cache->LineCount / 2);
+    if (Cache->StagingLines == 0) {
+        DEBUG((EFI_D_WARN, "MmcDxe: MmcCacheInitialize(): Cache too small, disabled\n"));
+        return EFI_SUCCESS;
+    }
+
+    Cache->Lines = AllocateZeroPool(Cache->LineCount * sizeof(MMC_CACHE_LINE));
+    Cache->DirtyLines = AllocatePool(Cache->LineCount * sizeof(MMC_CACHE_LINE*));
+    // Page allocations keep the line and staging buffers aligned for host DMA
+    Cache->Data = AllocatePages(EFI_SIZE_TO_PAGES(Cache->LineCount * Cache->LineSize));
+    Cache->StagingBuffer = AllocatePages(EFI_SIZE_TO_PAGES(Cache->StagingLines * Cache->LineSize));
+    if ((Cache->Lines == NULL) || (Cache->DirtyLines == NULL) ||
+        (Cache->Data == NULL) || (Cache->StagingBuffer == NULL)) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto FREE_CACHE;
+    }
+
+    for (Idx = 0; Idx < Cache->LineCount; ++Idx) {
+        Cache->Lines[Idx].Data = Cache->Data + (Idx * Cache->LineSize);
+    }
+
+    Status = gBS->CreateEventEx(
+        EVT_NOTIFY_SIGNAL,
+        TPL_CALLBACK,
+        MmcCacheReadyToBoot,
+        MmcHostInstance,
+        &gEfiEventReadyToBootGuid,
+        &Cache->ReadyToBootEvent);
+    if (EFI_ERROR(Status)) {
+        goto FREE_CACHE;
+    }
+
+    MmcCacheInvalidate(MmcHostInstance);
+    Cache->Enabled = TRUE;
+
+    MmcHostInstance->BlockIo.Media->WriteCaching = Cache->WriteBack;
+    if (Cache->WriteBack) {
+        MmcCacheHookResetSystem(TRUE);
+    }
+
+    DEBUG((
+        EFI_D_INIT,
+        "MmcDxe: Cache %d lines of %dB, read-ahead %d lines, %a\n",
+        (UINT32)Cache->LineCount,
+        (UINT32)Cache->LineSize,
+        (UINT32)Cache->ReadAheadLines,
+        Cache->WriteBack ? "write-back" : "write-through"));
+
+    return EFI_SUCCESS;
+
+FREE_CACHE:
+    DEBUG((EFI_D_ERROR, "MmcDxe: MmcCacheInitialize(): Error %r, cache disabled\n", Status));
+    MmcCacheFree(MmcHostInstance);
+    return Status;
+}
+
+VOID
+MmcCacheFree(
+    IN MMC_HOST_INSTANCE    *MmcHostInstance
+    )
+{
+    MMC_CACHE *Cache;
+
+    Cache = &MmcHostInstance->Cache;
+    Cache->Enabled = FALSE;
+
+    if (Cache->ReadyToBootEvent != NULL) {
+        gBS->CloseEvent(Cache->ReadyToBootEvent);
+        Cache->ReadyToBootEvent = NULL;
+    }
+    if (Cache->StagingBuffer != NULL) {
+        FreePages(Cache->StagingBuffer, EFI_SIZE_TO_PAGES(Cache->StagingLines * Cache->LineSize));
+        Cache->StagingBuffer = NULL;
+    }
+    if (Cache->Data != NULL) {
+        FreePages(Cache->Data, EFI_SIZE_TO_PAGES(Cache->LineCount * Cache->LineSize));
+        Cache->Data = NULL;
+    }
+    if (Cache->DirtyLines != NULL) {
+        FreePool(Cache->DirtyLines);
+        Cache->DirtyLines = NULL;
+    }
+    if (Cache->Lines != NULL) {
+        FreePool(Cache->Lines);
+        Cache->Lines = NULL;
+    }
+}
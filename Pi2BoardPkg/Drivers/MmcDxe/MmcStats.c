@@ -0,0 +1,162 @@
+/** @file
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/TimerLib.h>
+
+#include "Mmc.h"
+
+//
+// Every request handed to the cache is timed with the generic timer and counted
+// in a log2 latency histogram. The counters are only touched at MMC_IO_TPL, so
+// GetStats/ResetStats raise to it to get a consistent snapshot.
+//
+
+STATIC UINT64 mStatsTicksPerSecond = 0;
+
+UINTN
+MmcStatsLatencyBucket(
+    IN UINT64                   TimeUs
+    )
+{
+    UINTN Bucket;
+
+    if (TimeUs == 0) {
+        return 0;
+    }
+
+    Bucket = (UINTN)HighBitSet64(TimeUs) + 1;
+    return MIN(Bucket, MMC_STATS_LATENCY_BUCKETS - 1);
+}
+
+VOID
+MmcStatsRecord(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance,
+    IN UINTN                    Transfer,
+    IN UINTN                    BufferSize,
+    IN UINT64                   StartTime,
+    IN EFI_STATUS               Status
+    )
+{
+    MMC_STATS_IO *IoStats;
+    UINT64 TimeUs;
+
+    ASSERT(Transfer <= MMC_IOBLOCKS_FLUSH);
+
+    TimeUs = DivU64x64Remainder(
+        MultU64x32(GetPerformanceCounter() - StartTime, 1000000),
+        mStatsTicksPerSecond,
+        NULL);
+
+    IoStats = &MmcHostInstance->IoStats[Transfer];
+    ++IoStats->Requests;
+    if (EFI_ERROR(Status)) {
+        ++IoStats->Errors;
+    }
+    if (MmcHostInstance->BlockIo.Media->BlockSize != 0) {
+        IoStats->Blocks += BufferSize / MmcHostInstance->BlockIo.Media->BlockSize;
+    }
+    IoStats->TotalTimeUs += TimeUs;
+    IoStats->MaxTimeUs = MAX(IoStats->MaxTimeUs, TimeUs);
+    ++IoStats->Latency[MmcStatsLatencyBucket(TimeUs)];
+}
+
+EFI_STATUS
+EFIAPI
+MmcGetStats(
+    IN  MMC_STATS_PROTOCOL      *This,
+    OUT MMC_STATS               *Stats
+    )
+{
+    MMC_HOST_INSTANCE *MmcHostInstance;
+    EFI_TPL OldTpl;
+
+    if (Stats == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_STATS_THIS(This);
+
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+    Stats->BlockSize = MmcHostInstance->BlockIo.Media->BlockSize;
+    Stats->CacheEnabled = MmcHostInstance->Cache.Enabled;
+    CopyMem(&Stats->Read, &MmcHostInstance->IoStats[MMC_IOBLOCKS_READ], sizeof(MMC_STATS_IO));
+    CopyMem(&Stats->Write, &MmcHostInstance->IoStats[MMC_IOBLOCKS_WRITE], sizeof(MMC_STATS_IO));
+    CopyMem(&Stats->Flush, &MmcHostInstance->IoStats[MMC_IOBLOCKS_FLUSH], sizeof(MMC_STATS_IO));
+    CopyMem(&Stats->Cache, &MmcHostInstance->Cache.Stats, sizeof(MMC_CACHE_STATS));
+    gBS->RestoreTPL(OldTpl);
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MmcResetStats(
+    IN  MMC_STATS_PROTOCOL      *This
+    )
+{
+    MMC_HOST_INSTANCE *MmcHostInstance;
+    EFI_TPL OldTpl;
+
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_STATS_THIS(This);
+
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+    ZeroMem(MmcHostInstance->IoStats, sizeof(MmcHostInstance->IoStats));
+    ZeroMem(&MmcHostInstance->Cache.Stats, sizeof(MMC_CACHE_STATS));
+    gBS->RestoreTPL(OldTpl);
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MmcSetCacheEnabled(
+    IN  MMC_STATS_PROTOCOL      *This,
+    IN  BOOLEAN                 Enable,
+    OUT BOOLEAN                 *WasEnabled OPTIONAL
+    )
+{
+    MMC_HOST_INSTANCE *MmcHostInstance;
+    EFI_STATUS Status;
+    EFI_TPL OldTpl;
+
+    MmcHostInstance = MMC_HOST_INSTANCE_FROM_STATS_THIS(This);
+
+    OldTpl = gBS->RaiseTPL(MMC_IO_TPL);
+    MmcIo2DrainQueue(MmcHostInstance);
+    if (WasEnabled != NULL) {
+        *WasEnabled = MmcHostInstance->Cache.Enabled;
+    }
+    Status = MmcCacheEnable(MmcHostInstance, Enable);
+    gBS->RestoreTPL(OldTpl);
+
+    return Status;
+}
+
+VOID
+MmcStatsInitialize(
+    IN MMC_HOST_INSTANCE        *MmcHostInstance
+    )
+{
+    mStatsTicksPerSecond = GetPerformanceCounterProperties(NULL, NULL);
+    ASSERT(mStatsTicksPerSecond != 0);
+
+    ZeroMem(MmcHostInstance->IoStats, sizeof(MmcHostInstance->IoStats));
+
+    MmcHostInstance->StatsProtocol.Revision = MMC_STATS_PROTOCOL_REVISION;
+    MmcHostInstance->StatsProtocol.GetStats = MmcGetStats;
+    MmcHostInstance->StatsProtocol.ResetStats = MmcResetStats;
+    MmcHostInstance->StatsProtocol.SetCacheEnabled = MmcSetCacheEnabled;
+}
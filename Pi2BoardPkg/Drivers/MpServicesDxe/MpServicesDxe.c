@@ -0,0 +1,956 @@
+/** @file
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <PiDxe.h>
+#include <Library/ArmLib.h>
+#include <Library/ArmMpppLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include <Protocol/MpService.h>
+
+#include <Guid/ArmMpCoreInfo.h>
+#include <Guid/EventGroup.h>
+
+//
+// The secondary cores sit in the PrePi MPPP parking loop until the OS takes
+// them through their parking protocol mailbox. This driver borrows them for
+// boot-time work: the first time an AP is needed ArmMpppStartCore() sends it
+// through its mailbox, like the OS would do it, to MpApMain on a stack
+// allocated here, with the BSP translation table and caches. The AP waits
+// there for procedures posted by the BSP. At ExitBootServices every AP is
+// asked to leave MpApMain and ArmMpppLib puts it back in the parking loop with
+// the mailbox in the state the OS expects.
+//
+// The procedures run with the interrupts off and must not call the boot
+// services. An AP cannot be interrupted, a procedure that times out keeps its
+// AP busy until it returns.
+
+#define MP_AP_STACK_SIZE                SIZE_32KB
+
+// How long to wait for an AP to reach MpApMain or to get back to PrePi
+#define MP_AP_SWITCH_TIMEOUT_US         100000
+#define MP_AP_PARK_TIMEOUT_US           1000000
+
+// Period of the timer that completes the non-blocking requests, in 100ns units
+#define MP_CHECK_PERIOD                 (10 * 1000 * 10)
+
+typedef enum {
+    MpApStateParked = 0,        // In the PrePi parking loop
+    MpApStateIdle,              // In MpApMain, waiting for a procedure
+    MpApStateReady,             // The BSP posted a procedure
+    MpApStateBusy,              // The AP runs the procedure
+    MpApStateFinished,          // The procedure returned
+    MpApStateParkRequest,       // The AP must return to PrePi
+    MpApStateFailed             // The AP never reached MpApMain
+} MP_AP_STATE;
+
+typedef struct {
+    ARM_MPPP_STARTUP        Startup;
+    ARM_CORE_INFO           *CoreInfo;
+    VOID                    *Stack;
+    BOOLEAN                 Enabled;
+    BOOLEAN                 Healthy;
+
+    // Shared with the AP
+    volatile UINT32         State;
+    EFI_AP_PROCEDURE        Procedure;
+    VOID                    *Argument;
+
+    // StartupThisAP() request owning the AP, if any
+    BOOLEAN                 ThisApPending;
+    EFI_EVENT               WaitEvent;
+    BOOLEAN                 *Finished;
+    UINT64                  StartTime;
+    UINTN                   TimeoutUs;
+
+    // TRUE while the AP belongs to the StartupAllAPs() request
+    BOOLEAN                 AllApsPending;
+} MP_CPU;
+
+typedef struct {
+    BOOLEAN                 Active;
+    EFI_AP_PROCEDURE        Procedure;
+    VOID                    *Argument;
+    BOOLEAN                 SingleThread;
+    EFI_EVENT               WaitEvent;
+    UINT64                  StartTime;
+    UINTN                   TimeoutUs;
+    UINTN                   **FailedCpuList;
+    UINTN                   NextCpu;    // Next AP to start in single thread mode
+} MP_ALL_APS_REQUEST;
+
+STATIC MP_CPU *mCpus = NULL;
+STATIC UINTN mCpuCount = 0;
+STATIC UINTN mBspNumber = 0;
+
+STATIC MP_ALL_APS_REQUEST mAllAps;
+STATIC EFI_EVENT mCheckEvent = NULL;
+STATIC UINTN mPendingRequests = 0;
+
+STATIC UINT64 mTicksPerSecond = 0;
+
+STATIC
+UINT64
+MpElapsedUs(
+    IN UINT64                   StartTime
+    )
+{
+    return DivU64x64Remainder(
+        MultU64x32(GetPerformanceCounter() - StartTime, 1000000),
+        mTicksPerSecond,
+        NULL);
+}
+
+STATIC
+BOOLEAN
+MpTimedOut(
+    IN UINT64                   StartTime,
+    IN UINTN                    TimeoutUs
+    )
+{
+    return (TimeoutUs != 0) && (MpElapsedUs(StartTime) >= TimeoutUs);
+}
+
+STATIC
+UINTN
+MpGetCurrentNumber(
+    VOID
+    )
+{
+    UINTN MpId;
+    UINTN Index;
+
+    MpId = ArmReadMpidr();
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        if ((mCpus[Index].CoreInfo->ClusterId == GET_CLUSTER_ID(MpId)) &&
+            (mCpus[Index].CoreInfo->CoreId == GET_CORE_ID(MpId))) {
+            return Index;
+        }
+    }
+
+    return mCpuCount;
+}
+
+STATIC
+BOOLEAN
+MpIsBsp(
+    VOID
+    )
+{
+    return MpGetCurrentNumber() == mBspNumber;
+}
+
+/**
+  Main loop of the APs, entered from ArmMpppLib with the MMU and the caches on.
+  Returns when the BSP asks the AP to go back to the parked state.
+**/
+STATIC
+VOID
+EFIAPI
+MpApMain(
+    IN VOID                     *Context
+    )
+{
+    MP_CPU *Cpu;
+    UINT32 State;
+
+    Cpu = Context;
+
+    Cpu->State = MpApStateIdle;
+    ArmDataSyncronizationBarrier();
+    ArmCallSEV();
+
+    for (;;) {
+        State = Cpu->State;
+
+        if (State == MpApStateReady) {
+            ArmDataMemoryBarrier();
+            Cpu->State = MpApStateBusy;
+            Cpu->Procedure(Cpu->Argument);
+
+            ArmDataMemoryBarrier();
+            Cpu->State = MpApStateFinished;
+            ArmDataSyncronizationBarrier();
+            ArmCallSEV();
+        } else if (State == MpApStateParkRequest) {
+            break;
+        } else {
+            ArmCallWFE();
+        }
+    }
+
+    Cpu->State = MpApStateParked;
+    ArmDataSyncronizationBarrier();
+}
+
+/**
+  Sends a parked AP to MpApMain through its parking protocol mailbox.
+**/
+STATIC
+EFI_STATUS
+MpWakeAp(
+    IN MP_CPU                   *Cpu
+    )
+{
+    EFI_STATUS Status;
+    UINT64 StartTime;
+
+    if (Cpu->State != MpApStateParked) {
+        return (Cpu->State == MpApStateFailed) ? EFI_DEVICE_ERROR : EFI_SUCCESS;
+    }
+
+    Status = ArmMpppStartCore(
+        Cpu->CoreInfo,
+        &Cpu->Startup,
+        MpApMain,
+        Cpu,
+        (UINT8 *)Cpu->Stack + MP_AP_STACK_SIZE);
+    if (!EFI_ERROR(Status)) {
+        StartTime = GetPerformanceCounter();
+        while (Cpu->State == MpApStateParked) {
+            if (MpTimedOut(StartTime, MP_AP_SWITCH_TIMEOUT_US)) {
+                Status = EFI_TIMEOUT;
+                break;
+            }
+        }
+    }
+
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "MpWakeAp: Core %d failed to start: %r\n", Cpu->CoreInfo->CoreId, Status));
+        Cpu->State = MpApStateFailed;
+        Cpu->Healthy = FALSE;
+        return EFI_DEVICE_ERROR;
+    }
+
+    DEBUG((DEBUG_INFO, "MpWakeAp: Core %d started\n", Cpu->CoreInfo->CoreId));
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Returns an AP to the PrePi parking loop and waits until the mailbox is back
+  in the state the OS expects.
+**/
+STATIC
+VOID
+MpParkAp(
+    IN MP_CPU                   *Cpu
+    )
+{
+    UINT64 StartTime;
+
+    if ((Cpu->State == MpApStateParked) || (Cpu->State == MpApStateFailed)) {
+        return;
+    }
+
+    StartTime = GetPerformanceCounter();
+    while ((Cpu->State == MpApStateReady) || (Cpu->State == MpApStateBusy)) {
+        if (MpTimedOut(StartTime, MP_AP_PARK_TIMEOUT_US)) {
+            DEBUG((DEBUG_ERROR, "MpParkAp: Core %d is still running a procedure\n", Cpu->CoreInfo->CoreId));
+            return;
+        }
+    }
+
+    Cpu->State = MpApStateParkRequest;
+    ArmDataSyncronizationBarrier();
+    ArmCallSEV();
+
+    StartTime = GetPerformanceCounter();
+    while ((Cpu->State != MpApStateParked) || !ArmMpppIsCoreParked(Cpu->CoreInfo)) {
+        if (MpTimedOut(StartTime, MP_AP_PARK_TIMEOUT_US)) {
+            DEBUG((DEBUG_ERROR, "MpParkAp: Core %d did not get back to its parking loop\n", Cpu->CoreInfo->CoreId));
+            return;
+        }
+    }
+}
+
+/**
+  Posts a procedure to an AP, waking it up first if it is still parked.
+**/
+STATIC
+EFI_STATUS
+MpStartProcedure(
+    IN MP_CPU                   *Cpu,
+    IN EFI_AP_PROCEDURE         Procedure,
+    IN VOID                     *Argument
+    )
+{
+    EFI_STATUS Status;
+
+    Status = MpWakeAp(Cpu);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Cpu->Procedure = Procedure;
+    Cpu->Argument = Argument;
+    ArmDataMemoryBarrier();
+    Cpu->State = MpApStateReady;
+    ArmDataSyncronizationBarrier();
+    ArmCallSEV();
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Returns TRUE if the AP can take a new procedure. An AP left running by a
+  request that timed out becomes available again when its procedure returns.
+**/
+STATIC
+BOOLEAN
+MpIsApAvailable(
+    IN MP_CPU                   *Cpu
+    )
+{
+    if (Cpu->ThisApPending || Cpu->AllApsPending) {
+        return FALSE;
+    }
+
+    if (Cpu->State == MpApStateFinished) {
+        Cpu->State = MpApStateIdle;
+    }
+
+    return (Cpu->State == MpApStateParked) || (Cpu->State == MpApStateIdle);
+}
+
+STATIC
+VOID
+MpRequestDone(
+    VOID
+    )
+{
+    ASSERT(mPendingRequests != 0);
+    if (--mPendingRequests == 0) {
+        gBS->SetTimer(mCheckEvent, TimerCancel, 0);
+    }
+}
+
+STATIC
+VOID
+MpRequestQueued(
+    VOID
+    )
+{
+    if (mPendingRequests++ == 0) {
+        gBS->SetTimer(mCheckEvent, TimerPeriodic, MP_CHECK_PERIOD);
+    }
+}
+
+/**
+  Advances the StartupAllAPs() request.
+
+  @retval EFI_NOT_READY     Some APs are still running or waiting to be started
+  @retval EFI_SUCCESS       Every AP ran the procedure
+  @retval EFI_TIMEOUT       The timeout expired, the unfinished APs are in the
+                            failed CPU list
+**/
+STATIC
+EFI_STATUS
+MpCheckAllAps(
+    VOID
+    )
+{
+    MP_CPU *Cpu;
+    UINTN Index;
+    UINTN Failed;
+    BOOLEAN Running;
+    EFI_STATUS Status;
+
+    ASSERT(mAllAps.Active);
+
+    Running = FALSE;
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        Cpu = &mCpus[Index];
+        if (!Cpu->AllApsPending) {
+            continue;
+        }
+
+        if (Cpu->State == MpApStateFinished) {
+            Cpu->State = MpApStateIdle;
+            Cpu->AllApsPending = FALSE;
+        } else if ((Cpu->State == MpApStateReady) || (Cpu->State == MpApStateBusy)) {
+            Running = TRUE;
+        }
+    }
+
+    //
+    // In single thread mode the next AP only starts when the previous one is
+    // done
+    //
+    while (!Running && (mAllAps.NextCpu < mCpuCount)) {
+        Cpu = &mCpus[mAllAps.NextCpu++];
+        if (!Cpu->AllApsPending) {
+            continue;
+        }
+
+        Status = MpStartProcedure(Cpu, mAllAps.Procedure, mAllAps.Argument);
+        if (!EFI_ERROR(Status)) {
+            Running = TRUE;
+        }
+    }
+
+    if (Running && !MpTimedOut(mAllAps.StartTime, mAllAps.TimeoutUs)) {
+        return EFI_NOT_READY;
+    }
+
+    //
+    // Whatever still belongs to the request either failed to start or timed
+    // out
+    //
+    Failed = 0;
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        if (mCpus[Index].AllApsPending) {
+            ++Failed;
+        }
+    }
+
+    if ((Failed != 0) && (mAllAps.FailedCpuList != NULL)) {
+        *mAllAps.FailedCpuList = AllocatePool((Failed + 1) * sizeof(UINTN));
+        if (*mAllAps.FailedCpuList != NULL) {
+            Failed = 0;
+            for (Index = 0; Index < mCpuCount; ++Index) {
+                if (mCpus[Index].AllApsPending) {
+                    (*mAllAps.FailedCpuList)[Failed++] = Index;
+                }
+            }
+            (*mAllAps.FailedCpuList)[Failed] = END_OF_CPU_LIST;
+        }
+    } else if (mAllAps.FailedCpuList != NULL) {
+        *mAllAps.FailedCpuList = NULL;
+    }
+
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        mCpus[Index].AllApsPending = FALSE;
+    }
+    mAllAps.Active = FALSE;
+
+    return (Failed != 0) ? EFI_TIMEOUT : EFI_SUCCESS;
+}
+
+/**
+  Checks the StartupThisAP() request owning an AP.
+
+  @retval EFI_NOT_READY     The procedure is still running
+  @retval EFI_SUCCESS       The procedure returned
+  @retval EFI_TIMEOUT       The timeout expired before the procedure returned
+**/
+STATIC
+EFI_STATUS
+MpCheckThisAp(
+    IN MP_CPU                   *Cpu
+    )
+{
+    ASSERT(Cpu->ThisApPending);
+
+    if (Cpu->State == MpApStateFinished) {
+        Cpu->State = MpApStateIdle;
+    } else if (!MpTimedOut(Cpu->StartTime, Cpu->TimeoutUs)) {
+        return EFI_NOT_READY;
+    }
+
+    Cpu->ThisApPending = FALSE;
+    if (Cpu->Finished != NULL) {
+        *Cpu->Finished = (Cpu->State == MpApStateIdle);
+    }
+
+    return (Cpu->State == MpApStateIdle) ? EFI_SUCCESS : EFI_TIMEOUT;
+}
+
+/**
+  Completes the non-blocking requests and signals their events.
+**/
+STATIC
+VOID
+EFIAPI
+MpCheckRequests(
+    IN EFI_EVENT                Event,
+    IN VOID                     *Context
+    )
+{
+    MP_CPU *Cpu;
+    UINTN Index;
+
+    if (mAllAps.Active && (mAllAps.WaitEvent != NULL)) {
+        if (MpCheckAllAps() != EFI_NOT_READY) {
+            gBS->SignalEvent(mAllAps.WaitEvent);
+            MpRequestDone();
+        }
+    }
+
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        Cpu = &mCpus[Index];
+        if (Cpu->ThisApPending && (Cpu->WaitEvent != NULL)) {
+            if (MpCheckThisAp(Cpu) != EFI_NOT_READY) {
+                gBS->SignalEvent(Cpu->WaitEvent);
+                MpRequestDone();
+            }
+        }
+    }
+}
+
+EFI_STATUS
+EFIAPI
+MpGetNumberOfProcessors(
+    IN  EFI_MP_SERVICES_PROTOCOL    *This,
+    OUT UINTN                       *NumberOfProcessors,
+    OUT UINTN                       *NumberOfEnabledProcessors
+    )
+{
+    UINTN Index;
+
+    if ((NumberOfProcessors == NULL) || (NumberOfEnabledProcessors == NULL)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (!MpIsBsp()) {
+        return EFI_DEVICE_ERROR;
+    }
+
+    *NumberOfProcessors = mCpuCount;
+    *NumberOfEnabledProcessors = 0;
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        if (mCpus[Index].Enabled) {
+            ++*NumberOfEnabledProcessors;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MpGetProcessorInfo(
+    IN  EFI_MP_SERVICES_PROTOCOL    *This,
+    IN  UINTN                       ProcessorNumber,
+    OUT EFI_PROCESSOR_INFORMATION   *ProcessorInfoBuffer
+    )
+{
+    MP_CPU *Cpu;
+
+    if (ProcessorInfoBuffer == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (!MpIsBsp()) {
+        return EFI_DEVICE_ERROR;
+    }
+
+    if (ProcessorNumber >= mCpuCount) {
+        return EFI_NOT_FOUND;
+    }
+
+    Cpu = &mCpus[ProcessorNumber];
+
+    ProcessorInfoBuffer->ProcessorId = (Cpu->CoreInfo->ClusterId << 8) | Cpu->CoreInfo->CoreId;
+    ProcessorInfoBuffer->StatusFlag = 0;
+    if (ProcessorNumber == mBspNumber) {
+        ProcessorInfoBuffer->StatusFlag |= PROCESSOR_AS_BSP_BIT;
+    }
+    if (Cpu->Enabled) {
+        ProcessorInfoBuffer->StatusFlag |= PROCESSOR_ENABLED_BIT;
+    }
+    if (Cpu->Healthy) {
+        ProcessorInfoBuffer->StatusFlag |= PROCESSOR_HEALTH_STATUS_BIT;
+    }
+    ProcessorInfoBuffer->Location.Package = Cpu->CoreInfo->ClusterId;
+    ProcessorInfoBuffer->Location.Core = Cpu->CoreInfo->CoreId;
+    ProcessorInfoBuffer->Location.Thread = 0;
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MpStartupAllAPs(
+    IN  EFI_MP_SERVICES_PROTOCOL    *This,
+    IN  EFI_AP_PROCEDURE            Procedure,
+    IN  BOOLEAN                     SingleThread,
+    IN  EFI_EVENT                   WaitEvent OPTIONAL,
+    IN  UINTN                       TimeoutInMicroSeconds,
+    IN  VOID                        *ProcedureArgument OPTIONAL,
+    OUT UINTN                       **FailedCpuList OPTIONAL
+    )
+{
+    MP_CPU *Cpu;
+    UINTN Index;
+    UINTN Count;
+    EFI_TPL OldTpl;
+    EFI_STATUS Status;
+
+    if (Procedure == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (!MpIsBsp()) {
+        return EFI_DEVICE_ERROR;
+    }
+
+    // Keep MpCheckRequests away until the request is set up
+    OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+
+    if (mAllAps.Active) {
+        gBS->RestoreTPL(OldTpl);
+        return EFI_NOT_READY;
+    }
+
+    Count = 0;
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        Cpu = &mCpus[Index];
+        if ((Index == mBspNumber) || !Cpu->Enabled) {
+            continue;
+        }
+        if (!MpIsApAvailable(Cpu)) {
+            gBS->RestoreTPL(OldTpl);
+            return EFI_NOT_READY;
+        }
+        ++Count;
+    }
+
+    if (Count == 0) {
+        gBS->RestoreTPL(OldTpl);
+        return EFI_NOT_STARTED;
+    }
+
+    mAllAps.Procedure = Procedure;
+    mAllAps.Argument = ProcedureArgument;
+    mAllAps.SingleThread = SingleThread;
+    mAllAps.WaitEvent = WaitEvent;
+    mAllAps.StartTime = GetPerformanceCounter();
+    mAllAps.TimeoutUs = TimeoutInMicroSeconds;
+    mAllAps.FailedCpuList = FailedCpuList;
+    mAllAps.NextCpu = mCpuCount;
+    mAllAps.Active = TRUE;
+
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        Cpu = &mCpus[Index];
+        if ((Index == mBspNumber) || !Cpu->Enabled) {
+            continue;
+        }
+
+        Cpu->AllApsPending = TRUE;
+        if (SingleThread) {
+            mAllAps.NextCpu = MIN(mAllAps.NextCpu, Index);
+            continue;
+        }
+
+        Status = MpStartProcedure(Cpu, Procedure, ProcedureArgument);
+        if (EFI_ERROR(Status)) {
+            DEBUG((DEBUG_ERROR, "MpStartupAllAPs: Processor %d failed to start: %r\n", Index, Status));
+        }
+    }
+
+    if (WaitEvent != NULL) {
+        Status = MpCheckAllAps();
+        if (Status == EFI_NOT_READY) {
+            MpRequestQueued();
+        } else {
+            gBS->SignalEvent(WaitEvent);
+        }
+        gBS->RestoreTPL(OldTpl);
+        return EFI_SUCCESS;
+    }
+
+    gBS->RestoreTPL(OldTpl);
+
+    do {
+        Status = MpCheckAllAps();
+    } while (Status == EFI_NOT_READY);
+
+    return Status;
+}
+
+EFI_STATUS
+EFIAPI
+MpStartupThisAP(
+    IN  EFI_MP_SERVICES_PROTOCOL    *This,
+    IN  EFI_AP_PROCEDURE            Procedure,
+    IN  UINTN                       ProcessorNumber,
+    IN  EFI_EVENT                   WaitEvent OPTIONAL,
+    IN  UINTN                       TimeoutInMicroseconds,
+    IN  VOID                        *ProcedureArgument OPTIONAL,
+    OUT BOOLEAN                     *Finished OPTIONAL
+    )
+{
+    MP_CPU *Cpu;
+    EFI_TPL OldTpl;
+    EFI_STATUS Status;
+
+    if (Procedure == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (!MpIsBsp()) {
+        return EFI_DEVICE_ERROR;
+    }
+
+    if (ProcessorNumber >= mCpuCount) {
+        return EFI_NOT_FOUND;
+    }
+
+    if (ProcessorNumber == mBspNumber) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Cpu = &mCpus[ProcessorNumber];
+    if (!Cpu->Enabled) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    OldTpl = gBS->RaiseTPL(TPL_CALLBACK);
+
+    if (!MpIsApAvailable(Cpu)) {
+        gBS->RestoreTPL(OldTpl);
+        return EFI_NOT_READY;
+    }
+
+    Status = MpStartProcedure(Cpu, Procedure, ProcedureArgument);
+    if (EFI_ERROR(Status)) {
+        gBS->RestoreTPL(OldTpl);
+        return Status;
+    }
+
+    Cpu->WaitEvent = WaitEvent;
+    Cpu->Finished = Finished;
+    Cpu->StartTime = GetPerformanceCounter();
+    Cpu->TimeoutUs = TimeoutInMicroseconds;
+    Cpu->ThisApPending = TRUE;
+
+    if (WaitEvent != NULL) {
+        MpRequestQueued();
+    }
+
+    gBS->RestoreTPL(OldTpl);
+
+    if (WaitEvent != NULL) {
+        return EFI_SUCCESS;
+    }
+
+    do {
+        Status = MpCheckThisAp(Cpu);
+    } while (Status == EFI_NOT_READY);
+
+    return Status;
+}
+
+EFI_STATUS
+EFIAPI
+MpSwitchBSP(
+    IN  EFI_MP_SERVICES_PROTOCOL    *This,
+    IN  UINTN                       ProcessorNumber,
+    IN  BOOLEAN                     EnableOldBSP
+    )
+{
+    // The BSP is the core that runs the DXE core, nothing else can take over
+    return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS
+EFIAPI
+MpEnableDisableAP(
+    IN  EFI_MP_SERVICES_PROTOCOL    *This,
+    IN  UINTN                       ProcessorNumber,
+    IN  BOOLEAN                     EnableAP,
+    IN  UINT32                      *HealthFlag OPTIONAL
+    )
+{
+    MP_CPU *Cpu;
+
+    if (!MpIsBsp()) {
+        return EFI_DEVICE_ERROR;
+    }
+
+    if (ProcessorNumber >= mCpuCount) {
+        return EFI_NOT_FOUND;
+    }
+
+    if (ProcessorNumber == mBspNumber) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Cpu = &mCpus[ProcessorNumber];
+    Cpu->Enabled = EnableAP;
+    if (HealthFlag != NULL) {
+        Cpu->Healthy = (*HealthFlag & PROCESSOR_HEALTH_STATUS_BIT) != 0;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+MpWhoAmI(
+    IN  EFI_MP_SERVICES_PROTOCOL    *This,
+    OUT UINTN                       *ProcessorNumber
+    )
+{
+    if (ProcessorNumber == NULL) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    *ProcessorNumber = MpGetCurrentNumber();
+    ASSERT(*ProcessorNumber < mCpuCount);
+
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_MP_SERVICES_PROTOCOL mMpServices = {
+    MpGetNumberOfProcessors,
+    MpGetProcessorInfo,
+    MpStartupAllAPs,
+    MpStartupThisAP,
+    MpSwitchBSP,
+    MpEnableDisableAP,
+    MpWhoAmI
+};
+
+STATIC
+VOID
+EFIAPI
+MpExitBootServices(
+    IN EFI_EVENT                Event,
+    IN VOID                     *Context
+    )
+{
+    UINTN Index;
+
+    gBS->SetTimer(mCheckEvent, TimerCancel, 0);
+
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        if (Index != mBspNumber) {
+            MpParkAp(&mCpus[Index]);
+        }
+    }
+}
+
+EFI_STATUS
+EFIAPI
+MpServicesInitialize(
+    IN EFI_HANDLE               ImageHandle,
+    IN EFI_SYSTEM_TABLE         *SystemTable
+    )
+{
+    EFI_HOB_GUID_TYPE *Hob;
+    ARM_CORE_INFO *CoreInfo;
+    MP_CPU *Cpu;
+    EFI_EVENT ExitBootServicesEvent;
+    EFI_HANDLE Handle;
+    UINTN Index;
+    EFI_STATUS Status;
+
+    Hob = GetFirstGuidHob(&gArmMpCoreInfoGuid);
+    if (Hob == NULL) {
+        DEBUG((DEBUG_ERROR, "MpServicesInitialize: No MP core info HOB\n"));
+        return EFI_UNSUPPORTED;
+    }
+
+    CoreInfo = GET_GUID_HOB_DATA(Hob);
+    mCpuCount = GET_GUID_HOB_DATA_SIZE(Hob) / sizeof(ARM_CORE_INFO);
+
+    mCpus = AllocateZeroPool(mCpuCount * sizeof(MP_CPU));
+    if (mCpus == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        Cpu = &mCpus[Index];
+        Cpu->CoreInfo = &CoreInfo[Index];
+        Cpu->State = MpApStateParked;
+        Cpu->Enabled = TRUE;
+        Cpu->Healthy = TRUE;
+    }
+
+    mBspNumber = MpGetCurrentNumber();
+    if (mBspNumber == mCpuCount) {
+        DEBUG((DEBUG_ERROR, "MpServicesInitialize: The BSP is not in the MP core info HOB\n"));
+        Status = EFI_UNSUPPORTED;
+        goto Exit;
+    }
+
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        Cpu = &mCpus[Index];
+        if (Index == mBspNumber) {
+            continue;
+        }
+
+        if (Cpu->CoreInfo->MailboxSetAddress == 0) {
+            DEBUG((DEBUG_WARN, "MpServicesInitialize: Core %d has no mailbox, disabled\n", Cpu->CoreInfo->CoreId));
+            Cpu->Enabled = FALSE;
+            Cpu->State = MpApStateFailed;
+            continue;
+        }
+
+        // The stack goes through the cache like any other DXE memory
+        Cpu->Stack = AllocatePages(EFI_SIZE_TO_PAGES(MP_AP_STACK_SIZE));
+        if (Cpu->Stack == NULL) {
+            Status = EFI_OUT_OF_RESOURCES;
+            goto Exit;
+        }
+    }
+
+    mTicksPerSecond = GetPerformanceCounterProperties(NULL, NULL);
+    ASSERT(mTicksPerSecond != 0);
+
+    Status = gBS->CreateEvent(
+        EVT_TIMER | EVT_NOTIFY_SIGNAL,
+        TPL_CALLBACK,
+        MpCheckRequests,
+        NULL,
+        &mCheckEvent);
+    if (EFI_ERROR(Status)) {
+        goto Exit;
+    }
+
+    Handle = NULL;
+    Status = gBS->InstallMultipleProtocolInterfaces(
+        &Handle,
+        &gEfiMpServiceProtocolGuid, &mMpServices,
+        NULL);
+    if (EFI_ERROR(Status)) {
+        goto Exit;
+    }
+
+    Status = gBS->CreateEventEx(
+        EVT_NOTIFY_SIGNAL,
+        TPL_CALLBACK,
+        MpExitBootServices,
+        NULL,
+        &gEfiEventExitBootServicesGuid,
+        &ExitBootServicesEvent);
+    ASSERT_EFI_ERROR(Status);
+
+    DEBUG((DEBUG_INIT, "MpServicesInitialize: %d processors, BSP is %d\n", mCpuCount, mBspNumber));
+
+    return EFI_SUCCESS;
+
+Exit:
+    DEBUG((DEBUG_ERROR, "MpServicesInitialize: Failed: %r\n", Status));
+
+    if (mCheckEvent != NULL) {
+        gBS->CloseEvent(mCheckEvent);
+    }
+    for (Index = 0; Index < mCpuCount; ++Index) {
+        if (mCpus[Index].Stack != NULL) {
+            FreePages(mCpus[Index].Stack, EFI_SIZE_TO_PAGES(MP_AP_STACK_SIZE));
+        }
+    }
+    FreePool(mCpus);
+
+    return Status;
+}
@@ -0,0 +1,862 @@
+/** @file
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <PiDxe.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/DxeServicesTableLib.h>
+#include <Library/PcdLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiRuntimeLib.h>
+
+#include <Protocol/BlockIo.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/FirmwareVolumeBlock.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include <Guid/EventGroup.h>
+#include <Guid/SystemNvDataGuid.h>
+#include <Guid/VariableFormat.h>
+
+//
+// The UEFI variable store lives in a region of the boot image (kernel.img) that
+// the VideoCore firmware loads in RAM with the rest of UEFI, so the variables
+// are available as soon as the image runs and VariableRuntimeDxe indexes them
+// straight from memory. The region is exposed as a memory mapped FVB to
+// FaultTolerantWriteDxe and VariableRuntimeDxe, which already append variable
+// updates to the store and only reclaim it when it is full.
+//
+// Writes and erases only update the RAM copy and queue the 4KB blocks they
+// touched. The queued blocks are written back in place to the boot image on
+// the boot partition PcdNvStoreCommitDelay milliseconds after the first of
+// them was modified, so a burst of SetVariable() calls is committed at once.
+//
+// FaultTolerantWriteDxe relies on the order of its writes to recover from a
+// power loss: the spare and working areas have to reach the media before the
+// target blocks they describe. The queue is therefore kept in the order the
+// blocks were last modified and a commit writes them in that order, from a
+// copy taken between two FVB calls. Every block is written with its final
+// content after all the blocks it was modified after, so an interrupted commit
+// leaves the store in a state FaultTolerantWriteDxe can recover from. The file
+// system and the block device below it are flushed after each block, neither
+// the FAT driver nor the SD cache get to hold or reorder the writes.
+//
+// The file system can't be used from ExitBootServices, so the queue is
+// committed at ReadyToBoot and from then on every modification is written
+// back as soon as the TPL drops below TPL_CALLBACK, which is before
+// SetVariable() returns to a boot loader. From ExitBootServices on the store
+// is write protected: SetVariable() of a non-volatile variable, including by
+// the OS through the runtime services, fails instead of being silently lost.
+//
+
+#define NV_STORAGE_BLOCK_SIZE           0x1000
+#define NV_STORAGE_MAX_BLOCKS           64
+
+
+#pragma pack(1)
+typedef struct {
+    EFI_FIRMWARE_VOLUME_HEADER  FvHeader;
+    EFI_FV_BLOCK_MAP_ENTRY      EndBlockMap;
+    VARIABLE_STORE_HEADER       VariableStoreHeader;
+} NV_STORAGE_HEADERS;
+
+typedef struct {
+    MEMMAP_DEVICE_PATH          MemMapDevicePath;
+    EFI_DEVICE_PATH_PROTOCOL    EndDevicePath;
+} NV_STORAGE_DEVICE_PATH;
+#pragma pack()
+
+STATIC EFI_PHYSICAL_ADDRESS mNvStorageAddress = 0;
+STATIC UINT8 *mNvStorageBase = NULL;
+STATIC UINTN mNvStorageSize = 0;
+STATIC UINTN mNvStorageBlocks = 0;
+
+STATIC UINTN mPendingBlocks[NV_STORAGE_MAX_BLOCKS];
+STATIC UINTN mPendingCount = 0;
+STATIC BOOLEAN mCommitPending = FALSE;
+STATIC BOOLEAN mReadyToBoot = FALSE;
+STATIC UINT8 *mCommitBuffer = NULL;
+
+STATIC EFI_FILE_PROTOCOL *mNvStorageFile = NULL;
+STATIC EFI_BLOCK_IO_PROTOCOL *mNvStorageBlockIo = NULL;
+STATIC UINT64 mNvStorageFileOffset = 0;
+
+STATIC EFI_EVENT mCommitEvent = NULL;
+STATIC VOID *mFileSystemRegistration = NULL;
+STATIC EFI_EVENT mReadyToBootEvent = NULL;
+STATIC EFI_EVENT mExitBootServicesEvent = NULL;
+STATIC EFI_EVENT mVirtualAddrChangeEvent = NULL;
+
+STATIC NV_STORAGE_DEVICE_PATH mNvStorageDevicePath =
+{
+    {
+        {
+            HARDWARE_DEVICE_PATH,
+            HW_MEMMAP_DP,
+            { (UINT8)sizeof(MEMMAP_DEVICE_PATH), (UINT8)(sizeof(MEMMAP_DEVICE_PATH) >> 8) }
+        },
+        EfiMemoryMappedIO,
+        0,
+        0
+    },
+    {
+        END_DEVICE_PATH_TYPE,
+        END_ENTIRE_DEVICE_PATH_SUBTYPE,
+        { (UINT8)sizeof(EFI_DEVICE_PATH_PROTOCOL), 0 }
+    }
+};
+
+// Must be called at TPL_NOTIFY
+STATIC
+VOID
+NvStorageQueueBlock(
+    IN UINTN                    Lba
+    )
+{
+    UINTN Idx;
+
+    // A block modified again moves to the end of the queue, it must not reach
+    // the media before the blocks modified in between
+    for (Idx = 0; Idx < mPendingCount; ++Idx) {
+        if (mPendingBlocks[Idx] == Lba) {
+            CopyMem(
+                &mPendingBlocks[Idx],
+                &mPendingBlocks[Idx + 1],
+                (mPendingCount - Idx - 1) * sizeof(mPendingBlocks[0]));
+            --mPendingCount;
+            break;
+        }
+    }
+
+    mPendingBlocks[mPendingCount++] = Lba;
+}
+
+STATIC
+VOID
+NvStorageMarkDirty(
+    IN UINTN                    Lba,
+    IN UINTN                    Count
+    )
+{
+    EFI_TPL OldTpl;
+    BOOLEAN StartCommit;
+
+    OldTpl = gBS->RaiseTPL(TPL_NOTIFY);
+    while (Count-- > 0) {
+        NvStorageQueueBlock(Lba);
+        ++Lba;
+    }
+    StartCommit = !mCommitPending;
+    mCommitPending = TRUE;
+    gBS->RestoreTPL(OldTpl);
+
+    if (!StartCommit) {
+        return;
+    }
+
+    if (mReadyToBoot) {
+        // The boot loader may exit the boot services at any time, the commit
+        // runs as soon as the caller drops below TPL_CALLBACK
+        gBS->SignalEvent(mCommitEvent);
+    } else {
+        // The delay runs from the first modification so that a steady stream
+        // of writes can't hold the commit back forever
+        gBS->SetTimer(
+            mCommitEvent,
+            TimerRelative,
+            EFI_TIMER_PERIOD_MILLISECONDS(PcdGet32(PcdNvStoreCommitDelay)));
+    }
+}
+
+STATIC
+EFI_STATUS
+NvStorageCommit(
+    VOID
+    )
+{
+    UINTN Blocks[NV_STORAGE_MAX_BLOCKS];
+    UINTN Requeued[NV_STORAGE_MAX_BLOCKS];
+    EFI_STATUS Status;
+    EFI_TPL OldTpl;
+    UINTN BlockCount;
+    UINTN RequeuedCount;
+    UINTN Idx;
+    UINTN Lba;
+    UINTN Size;
+
+    if (mNvStorageFile == NULL) {
+        // The queued blocks are committed once the boot image is found
+        return EFI_NOT_READY;
+    }
+
+    // Take the queue and the content of its blocks at once so that the commit
+    // matches the state of the store between two FVB calls. Blocks modified
+    // while the commit is in progress are queued again and go out with the
+    // next one.
+    OldTpl = gBS->RaiseTPL(TPL_NOTIFY);
+    BlockCount = mPendingCount;
+    CopyMem(Blocks, mPendingBlocks, BlockCount * sizeof(Blocks[0]));
+    for (Idx = 0; Idx < BlockCount; ++Idx) {
+        CopyMem(
+            mCommitBuffer + (Blocks[Idx] * NV_STORAGE_BLOCK_SIZE),
+            mNvStorageBase + (Blocks[Idx] * NV_STORAGE_BLOCK_SIZE),
+            NV_STORAGE_BLOCK_SIZE);
+    }
+    mPendingCount = 0;
+    mCommitPending = FALSE;
+    gBS->RestoreTPL(OldTpl);
+
+    Status = EFI_SUCCESS;
+    for (Idx = 0; Idx < BlockCount; ++Idx) {
+        // Each block is on the media before the next one is written
+        Lba = Blocks[Idx];
+        Status = mNvStorageFile->SetPosition(
+            mNvStorageFile,
+            mNvStorageFileOffset + (Lba * NV_STORAGE_BLOCK_SIZE));
+        if (!EFI_ERROR(Status)) {
+            Size = NV_STORAGE_BLOCK_SIZE;
+            Status = mNvStorageFile->Write(
+                mNvStorageFile,
+                &Size,
+                mCommitBuffer + (Lba * NV_STORAGE_BLOCK_SIZE));
+        }
+        if (!EFI_ERROR(Status)) {
+            Status = mNvStorageFile->Flush(mNvStorageFile);
+        }
+        if (!EFI_ERROR(Status) && (mNvStorageBlockIo != NULL)) {
+            Status = mNvStorageBlockIo->FlushBlocks(mNvStorageBlockIo);
+        }
+        if (EFI_ERROR(Status)) {
+            DEBUG((EFI_D_ERROR, "NvStorageFvbDxe: Failed to write block %d to the boot image. Status=%r\n",
+                Lba, Status));
+            break;
+        }
+    }
+
+    if (!EFI_ERROR(Status)) {
+        return EFI_SUCCESS;
+    }
+
+    // Queue what could not be written ahead of what was modified since, the
+    // next modification tries again
+    OldTpl = gBS->RaiseTPL(TPL_NOTIFY);
+    RequeuedCount = mPendingCount;
+    CopyMem(Requeued, mPendingBlocks, RequeuedCount * sizeof(Requeued[0]));
+    mPendingCount = 0;
+    for (; Idx < BlockCount; ++Idx) {
+        NvStorageQueueBlock(Blocks[Idx]);
+    }
+    for (Idx = 0; Idx < RequeuedCount; ++Idx) {
+        NvStorageQueueBlock(Requeued[Idx]);
+    }
+    gBS->RestoreTPL(OldTpl);
+
+    return Status;
+}
+
+STATIC
+VOID
+EFIAPI
+NvStorageCommitTimer(
+    IN EFI_EVENT                Event,
+    IN VOID                     *Context
+    )
+{
+    NvStorageCommit();
+}
+
+STATIC
+EFI_STATUS
+NvStorageOpenFile(
+    IN EFI_HANDLE               Handle
+    )
+{
+    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *FileSystem;
+    EFI_FIRMWARE_VOLUME_HEADER FvHeader;
+    EFI_FILE_PROTOCOL *Root;
+    EFI_FILE_PROTOCOL *File;
+    EFI_PHYSICAL_ADDRESS ImageBase;
+    EFI_STATUS Status;
+    UINT64 FileSize;
+    UINTN Size;
+
+    Status = gBS->HandleProtocol(Handle, &gEfiSimpleFileSystemProtocolGuid, (VOID**)&FileSystem);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Status = FileSystem->OpenVolume(FileSystem, &Root);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Status = Root->Open(
+        Root,
+        &File,
+        (CHAR16*)PcdGetPtr(PcdNvStoreFileName),
+        EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE,
+        0);
+    Root->Close(Root);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    // Only trust the file if it holds the image we are running from and covers
+    // the whole variable store
+    Status = File->SetPosition(File, 0xFFFFFFFFFFFFFFFFULL);
+    if (!EFI_ERROR(Status)) {
+        Status = File->GetPosition(File, &FileSize);
+    }
+    if (EFI_ERROR(Status)) {
+        goto CLOSE_FILE;
+    }
+
+    if (FileSize < (mNvStorageFileOffset + mNvStorageSize)) {
+        DEBUG((EFI_D_WARN, "NvStorageFvbDxe: %s is too small to hold the variable store\n",
+            (CHAR16*)PcdGetPtr(PcdNvStoreFileName)));
+        Status = EFI_VOLUME_CORRUPTED;
+        goto CLOSE_FILE;
+    }
+
+    // The firmware volume the file is checked against is at the start of the FD
+    // unless the platform points somewhere else
+    ImageBase = FixedPcdGet64(PcdNvStoreImageBase);
+    if (ImageBase == 0) {
+        ImageBase = FixedPcdGet32(PcdFdBaseAddress);
+    }
+
+    Status = File->SetPosition(File, ImageBase - FixedPcdGet64(PcdNvStoreFileBase));
+    if (EFI_ERROR(Status)) {
+        goto CLOSE_FILE;
+    }
+
+    Size = sizeof(FvHeader);
+    Status = File->Read(File, &Size, &FvHeader);
+    if (EFI_ERROR(Status)) {
+        goto CLOSE_FILE;
+    }
+
+    if ((Size != sizeof(FvHeader)) ||
+        (CompareMem(&FvHeader, (VOID*)(UINTN)ImageBase, sizeof(FvHeader)) != 0)) {
+        DEBUG((EFI_D_WARN, "NvStorageFvbDxe: %s doesn't match the running image\n",
+            (CHAR16*)PcdGetPtr(PcdNvStoreFileName)));
+        Status = EFI_NOT_FOUND;
+        goto CLOSE_FILE;
+    }
+
+    // The file system doesn't flush the block device, the commits do it
+    // themselves when the partition has a BlockIo
+    if (EFI_ERROR(gBS->HandleProtocol(Handle, &gEfiBlockIoProtocolGuid, (VOID**)&mNvStorageBlockIo))) {
+        mNvStorageBlockIo = NULL;
+    }
+
+    mNvStorageFile = File;
+    return EFI_SUCCESS;
+
+CLOSE_FILE:
+    File->Close(File);
+    return Status;
+}
+
+STATIC
+VOID
+EFIAPI
+NvStorageFileSystemNotify(
+    IN EFI_EVENT                Event,
+    IN VOID                     *Context
+    )
+{
+    EFI_HANDLE Handle;
+    EFI_STATUS Status;
+    UINTN Size;
+
+    for (;;) {
+        Size = sizeof(Handle);
+        Status = gBS->LocateHandle(
+            ByRegisterNotify,
+            NULL,
+            mFileSystemRegistration,
+            &Size,
+            &Handle);
+        if (EFI_ERROR(Status)) {
+            break;
+        }
+
+        if (!EFI_ERROR(NvStorageOpenFile(Handle))) {
+            DEBUG((EFI_D_INFO, "NvStorageFvbDxe: Variables are persisted to %s\n",
+                (CHAR16*)PcdGetPtr(PcdNvStoreFileName)));
+
+            gBS->CloseEvent(Event);
+
+            // Write back what was modified before the file system showed up
+            NvStorageCommit();
+            break;
+        }
+    }
+}
+
+STATIC
+VOID
+EFIAPI
+NvStorageReadyToBoot(
+    IN EFI_EVENT                Event,
+    IN VOID                     *Context
+    )
+{
+    // Don't wait for the commit delay anymore
+    mReadyToBoot = TRUE;
+    gBS->SetTimer(mCommitEvent, TimerCancel, 0);
+    NvStorageCommit();
+}
+
+STATIC
+VOID
+EFIAPI
+NvStorageExitBootServices(
+    IN EFI_EVENT                Event,
+    IN VOID                     *Context
+    )
+{
+    // The file system can't be used anymore, not even to close the file
+    gBS->SetTimer(mCommitEvent, TimerCancel, 0);
+    mNvStorageFile = NULL;
+    mNvStorageBlockIo = NULL;
+}
+
+STATIC
+VOID
+EFIAPI
+NvStorageVirtualAddressChange(
+    IN EFI_EVENT                Event,
+    IN VOID                     *Context
+    )
+{
+    EfiConvertPointer(0x0, (VOID**)&mNvStorageBase);
+}
+
+EFI_STATUS
+EFIAPI
+NvStorageFvbGetAttributes(
+    IN CONST  EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL   *This,
+    OUT       EFI_FVB_ATTRIBUTES_2                  *Attributes
+    )
+{
+    *Attributes = (EFI_FVB_ATTRIBUTES_2)(
+        EFI_FVB2_READ_ENABLED_CAP |
+        EFI_FVB2_READ_STATUS |
+        EFI_FVB2_WRITE_ENABLED_CAP |
+        EFI_FVB2_WRITE_STATUS |
+        EFI_FVB2_STICKY_WRITE |
+        EFI_FVB2_MEMORY_MAPPED |
+        EFI_FVB2_ERASE_POLARITY);
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+NvStorageFvbSetAttributes(
+    IN CONST  EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL   *This,
+    IN OUT    EFI_FVB_ATTRIBUTES_2                  *Attributes
+    )
+{
+    return EFI_UNSUPPORTED;
+}
+
+EFI_STATUS
+EFIAPI
+NvStorageFvbGetPhysicalAddress(
+    IN CONST  EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL   *This,
+    OUT       EFI_PHYSICAL_ADDRESS                  *Address
+    )
+{
+    *Address = mNvStorageAddress;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+NvStorageFvbGetBlockSize(
+    IN CONST  EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL   *This,
+    IN        EFI_LBA                               Lba,
+    OUT       UINTN                                 *BlockSize,
+    OUT       UINTN                                 *NumberOfBlocks
+    )
+{
+    if (Lba >= mNvStorageBlocks) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    *BlockSize = NV_STORAGE_BLOCK_SIZE;
+    *NumberOfBlocks = mNvStorageBlocks - (UINTN)Lba;
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+NvStorageFvbRead(
+    IN CONST  EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL   *This,
+    IN        EFI_LBA                               Lba,
+    IN        UINTN                                 Offset,
+    IN OUT    UINTN                                 *NumBytes,
+    IN OUT    UINT8                                 *Buffer
+    )
+{
+    EFI_STATUS Status;
+
+    if ((Lba >= mNvStorageBlocks) || (Offset > NV_STORAGE_BLOCK_SIZE) ||
+        (NumBytes == NULL) || (Buffer == NULL)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    Status = EFI_SUCCESS;
+    if (*NumBytes > (NV_STORAGE_BLOCK_SIZE - Offset)) {
+        *NumBytes = NV_STORAGE_BLOCK_SIZE - Offset;
+        Status = EFI_BAD_BUFFER_SIZE;
+    }
+
+    CopyMem(Buffer, mNvStorageBase + ((UINTN)Lba * NV_STORAGE_BLOCK_SIZE) + Offset, *NumBytes);
+
+    return Status;
+}
+
+EFI_STATUS
+EFIAPI
+NvStorageFvbWrite(
+    IN CONST  EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL   *This,
+    IN        EFI_LBA                               Lba,
+    IN        UINTN                                 Offset,
+    IN OUT    UINTN                                 *NumBytes,
+    IN        UINT8                                 *Buffer
+    )
+{
+    EFI_STATUS Status;
+
+    if ((Lba >= mNvStorageBlocks) || (Offset > NV_STORAGE_BLOCK_SIZE) ||
+        (NumBytes == NULL) || (Buffer == NULL)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    // Nothing can be written back to the SD card anymore
+    if (EfiAtRuntime()) {
+        *NumBytes = 0;
+        return EFI_ACCESS_DENIED;
+    }
+
+    Status = EFI_SUCCESS;
+    if (*NumBytes > (NV_STORAGE_BLOCK_SIZE - Offset)) {
+        *NumBytes = NV_STORAGE_BLOCK_SIZE - Offset;
+        Status = EFI_BAD_BUFFER_SIZE;
+    }
+
+    if (*NumBytes > 0) {
+        // The block is marked dirty after it is updated so that a commit in
+        // progress can't miss the new content
+        CopyMem(mNvStorageBase + ((UINTN)Lba * NV_STORAGE_BLOCK_SIZE) + Offset, Buffer, *NumBytes);
+        NvStorageMarkDirty((UINTN)Lba, 1);
+    }
+
+    return Status;
+}
+
+EFI_STATUS
+EFIAPI
+NvStorageFvbEraseBlocks(
+    IN CONST  EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL   *This,
+    ...
+    )
+{
+    VA_LIST Args;
+    EFI_LBA StartingLba;
+    UINTN NumOfLba;
+
+    if (EfiAtRuntime()) {
+        return EFI_ACCESS_DENIED;
+    }
+
+    // Check the whole list before erasing anything
+    VA_START(Args, This);
+    for (;;) {
+        StartingLba = VA_ARG(Args, EFI_LBA);
+        if (StartingLba == EFI_LBA_LIST_TERMINATOR) {
+            break;
+        }
+        NumOfLba = VA_ARG(Args, UINTN);
+        if ((NumOfLba == 0) || (StartingLba >= mNvStorageBlocks) ||
+            (NumOfLba > (mNvStorageBlocks - (UINTN)StartingLba))) {
+            VA_END(Args);
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+    VA_END(Args);
+
+    VA_START(Args, This);
+    for (;;) {
+        StartingLba = VA_ARG(Args, EFI_LBA);
+        if (StartingLba == EFI_LBA_LIST_TERMINATOR) {
+            break;
+        }
+        NumOfLba = VA_ARG(Args, UINTN);
+        SetMem(
+            mNvStorageBase + ((UINTN)StartingLba * NV_STORAGE_BLOCK_SIZE),
+            NumOfLba * NV_STORAGE_BLOCK_SIZE,
+            0xFF);
+        NvStorageMarkDirty((UINTN)StartingLba, NumOfLba);
+    }
+    VA_END(Args);
+
+    return EFI_SUCCESS;
+}
+
+STATIC EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL mNvStorageFvb =
+{
+    NvStorageFvbGetAttributes,
+    NvStorageFvbSetAttributes,
+    NvStorageFvbGetPhysicalAddress,
+    NvStorageFvbGetBlockSize,
+    NvStorageFvbRead,
+    NvStorageFvbWrite,
+    NvStorageFvbEraseBlocks,
+    NULL
+};
+
+STATIC
+EFI_STATUS
+NvStorageValidateHeaders(
+    VOID
+    )
+{
+    EFI_FIRMWARE_VOLUME_HEADER *FvHeader;
+    VARIABLE_STORE_HEADER *VariableStoreHeader;
+
+    FvHeader = (EFI_FIRMWARE_VOLUME_HEADER*)mNvStorageBase;
+    if ((FvHeader->Revision != EFI_FVH_REVISION) ||
+        (FvHeader->Signature != EFI_FVH_SIGNATURE) ||
+        (FvHeader->FvLength != mNvStorageSize) ||
+        (FvHeader->HeaderLength != OFFSET_OF(NV_STORAGE_HEADERS, VariableStoreHeader)) ||
+        !CompareGuid(&FvHeader->FileSystemGuid, &gEfiSystemNvDataFvGuid) ||
+        (CalculateSum16((UINT16*)FvHeader, FvHeader->HeaderLength) != 0)) {
+        DEBUG((EFI_D_WARN, "NvStorageFvbDxe: No valid firmware volume header\n"));
+        return EFI_NOT_FOUND;
+    }
+
+    VariableStoreHeader = (VARIABLE_STORE_HEADER*)(mNvStorageBase + FvHeader->HeaderLength);
+    if (!CompareGuid(&VariableStoreHeader->Signature, &gEfiVariableGuid) ||
+        (VariableStoreHeader->Size != (PcdGet32(PcdFlashNvStorageVariableSize) - FvHeader->HeaderLength))) {
+        DEBUG((EFI_D_WARN, "NvStorageFvbDxe: No valid variable store header\n"));
+        return EFI_NOT_FOUND;
+    }
+
+    return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+NvStorageInitializeHeaders(
+    VOID
+    )
+{
+    NV_STORAGE_HEADERS *Headers;
+
+    // The working and spare areas are formatted by FaultTolerantWriteDxe
+    SetMem(mNvStorageBase, mNvStorageSize, 0xFF);
+
+    Headers = (NV_STORAGE_HEADERS*)mNvStorageBase;
+    ZeroMem(Headers, sizeof(NV_STORAGE_HEADERS));
+
+    CopyGuid(&Headers->FvHeader.FileSystemGuid, &gEfiSystemNvDataFvGuid);
+    Headers->FvHeader.FvLength = mNvStorageSize;
+    Headers->FvHeader.Signature = EFI_FVH_SIGNATURE;
+    NvStorageFvbGetAttributes(&mNvStorageFvb, &Headers->FvHeader.Attributes);
+    Headers->FvHeader.HeaderLength = OFFSET_OF(NV_STORAGE_HEADERS, VariableStoreHeader);
+    Headers->FvHeader.Revision = EFI_FVH_REVISION;
+    Headers->FvHeader.BlockMap[0].NumBlocks = (UINT32)mNvStorageBlocks;
+    Headers->FvHeader.BlockMap[0].Length = NV_STORAGE_BLOCK_SIZE;
+    Headers->FvHeader.Checksum = CalculateCheckSum16((UINT16*)&Headers->FvHeader, Headers->FvHeader.HeaderLength);
+
+    CopyGuid(&Headers->VariableStoreHeader.Signature, &gEfiVariableGuid);
+    Headers->VariableStoreHeader.Size = PcdGet32(PcdFlashNvStorageVariableSize) - Headers->FvHeader.HeaderLength;
+    Headers->VariableStoreHeader.Format = VARIABLE_STORE_FORMATTED;
+    Headers->VariableStoreHeader.State = VARIABLE_STORE_HEALTHY;
+
+    NvStorageMarkDirty(0, mNvStorageBlocks);
+}
+
+EFI_STATUS
+EFIAPI
+NvStorageFvbInitialize(
+    IN EFI_HANDLE               ImageHandle,
+    IN EFI_SYSTEM_TABLE         *SystemTable
+    )
+{
+    EFI_GCD_MEMORY_SPACE_DESCRIPTOR Descriptor;
+    EFI_PHYSICAL_ADDRESS BaseAddress;
+    EFI_PHYSICAL_ADDRESS WorkingBase;
+    EFI_PHYSICAL_ADDRESS SpareBase;
+    EFI_EVENT FileSystemEvent;
+    EFI_HANDLE Handle;
+    EFI_STATUS Status;
+
+    // The 64-bit addresses take precedence, like in VariableRuntimeDxe
+    BaseAddress = PcdGet64(PcdFlashNvStorageVariableBase64);
+    if (BaseAddress == 0) {
+        BaseAddress = PcdGet32(PcdFlashNvStorageVariableBase);
+    }
+    WorkingBase = PcdGet64(PcdFlashNvStorageFtwWorkingBase64);
+    if (WorkingBase == 0) {
+        WorkingBase = PcdGet32(PcdFlashNvStorageFtwWorkingBase);
+    }
+    SpareBase = PcdGet64(PcdFlashNvStorageFtwSpareBase64);
+    if (SpareBase == 0) {
+        SpareBase = PcdGet32(PcdFlashNvStorageFtwSpareBase);
+    }
+
+    // FaultTolerantWriteDxe and VariableRuntimeDxe expect the variable, working
+    // and spare areas to follow each other in a single firmware volume
+    ASSERT(BaseAddress + PcdGet32(PcdFlashNvStorageVariableSize) == WorkingBase);
+    ASSERT(WorkingBase + PcdGet32(PcdFlashNvStorageFtwWorkingSize) == SpareBase);
+    ASSERT((BaseAddress % NV_STORAGE_BLOCK_SIZE) == 0);
+    ASSERT((WorkingBase % NV_STORAGE_BLOCK_SIZE) == 0);
+    ASSERT((SpareBase % NV_STORAGE_BLOCK_SIZE) == 0);
+
+    mNvStorageAddress = BaseAddress;
+    mNvStorageBase = (UINT8*)(UINTN)BaseAddress;
+    mNvStorageSize = PcdGet32(PcdFlashNvStorageVariableSize) +
+                     PcdGet32(PcdFlashNvStorageFtwWorkingSize) +
+                     PcdGet32(PcdFlashNvStorageFtwSpareSize);
+    mNvStorageBlocks = mNvStorageSize / NV_STORAGE_BLOCK_SIZE;
+    if ((mNvStorageBlocks == 0) || (mNvStorageBlocks > NV_STORAGE_MAX_BLOCKS) ||
+        ((mNvStorageSize % NV_STORAGE_BLOCK_SIZE) != 0)) {
+        DEBUG((EFI_D_ERROR, "NvStorageFvbDxe: Unsupported variable store size 0x%x\n", mNvStorageSize));
+        return EFI_UNSUPPORTED;
+    }
+
+    // The boot image is loaded at PcdNvStoreFileBase, the store sits at the
+    // same offset in the file as in memory
+    mNvStorageFileOffset = BaseAddress - FixedPcdGet64(PcdNvStoreFileBase);
+
+    // The boot region is outside of the system memory, declare the store so it
+    // gets mapped for the runtime services. A platform that already describes
+    // it, like the Emulator with its flash device, maps it itself.
+    Status = gDS->GetMemorySpaceDescriptor(BaseAddress, &Descriptor);
+    if (EFI_ERROR(Status) || (Descriptor.GcdMemoryType == EfiGcdMemoryTypeNonExistent)) {
+        Status = gDS->AddMemorySpace(
+            EfiGcdMemoryTypeReserved,
+            BaseAddress,
+            mNvStorageSize,
+            EFI_MEMORY_WB | EFI_MEMORY_RUNTIME);
+        if (EFI_ERROR(Status)) {
+            DEBUG((EFI_D_ERROR, "NvStorageFvbDxe: Failed to add the variable store to the memory space. Status=%r\n", Status));
+            return Status;
+        }
+
+        Status = gDS->SetMemorySpaceAttributes(
+            BaseAddress,
+            mNvStorageSize,
+            EFI_MEMORY_WB | EFI_MEMORY_RUNTIME);
+        if (EFI_ERROR(Status)) {
+            DEBUG((EFI_D_ERROR, "NvStorageFvbDxe: Failed to set the variable store attributes. Status=%r\n", Status));
+            return Status;
+        }
+    }
+
+    // The commits are taken from a copy of the store that can't change while
+    // they are written
+    Status = gBS->AllocatePool(EfiBootServicesData, mNvStorageSize, (VOID**)&mCommitBuffer);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Status = gBS->CreateEvent(
+        EVT_TIMER | EVT_NOTIFY_SIGNAL,
+        TPL_CALLBACK,
+        NvStorageCommitTimer,
+        NULL,
+        &mCommitEvent);
+    if (EFI_ERROR(Status)) {
+        goto FREE_BUFFER;
+    }
+
+    // A store that was never written (a freshly deployed image) or got
+    // corrupted starts over empty
+    if (EFI_ERROR(NvStorageValidateHeaders())) {
+        DEBUG((EFI_D_INFO, "NvStorageFvbDxe: Formatting the variable store\n"));
+        NvStorageInitializeHeaders();
+    }
+
+    mNvStorageDevicePath.MemMapDevicePath.StartingAddress = BaseAddress;
+    mNvStorageDevicePath.MemMapDevicePath.EndingAddress = BaseAddress + mNvStorageSize - 1;
+
+    Handle = NULL;
+    Status = gBS->InstallMultipleProtocolInterfaces(
+        &Handle,
+        &gEfiFirmwareVolumeBlockProtocolGuid, &mNvStorageFvb,
+        &gEfiDevicePathProtocolGuid, &mNvStorageDevicePath,
+        NULL);
+    if (EFI_ERROR(Status)) {
+        goto CLOSE_EVENTS;
+    }
+
+    // The boot partition shows up once BDS connects the SD card
+    FileSystemEvent = EfiCreateProtocolNotifyEvent(
+        &gEfiSimpleFileSystemProtocolGuid,
+        TPL_CALLBACK,
+        NvStorageFileSystemNotify,
+        NULL,
+        &mFileSystemRegistration);
+    if (FileSystemEvent == NULL) {
+        DEBUG((EFI_D_ERROR, "NvStorageFvbDxe: Variables won't be persisted\n"));
+    }
+
+    Status = gBS->CreateEventEx(
+        EVT_NOTIFY_SIGNAL,
+        TPL_CALLBACK,
+        NvStorageReadyToBoot,
+        NULL,
+        &gEfiEventReadyToBootGuid,
+        &mReadyToBootEvent);
+    ASSERT_EFI_ERROR(Status);
+
+    Status = gBS->CreateEventEx(
+        EVT_NOTIFY_SIGNAL,
+        TPL_CALLBACK,
+        NvStorageExitBootServices,
+        NULL,
+        &gEfiEventExitBootServicesGuid,
+        &mExitBootServicesEvent);
+    ASSERT_EFI_ERROR(Status);
+
+    Status = gBS->CreateEventEx(
+        EVT_NOTIFY_SIGNAL,
+        TPL_NOTIFY,
+        NvStorageVirtualAddressChange,
+        NULL,
+        &gEfiEventVirtualAddressChangeGuid,
+        &mVirtualAddrChangeEvent);
+    ASSERT_EFI_ERROR(Status);
+
+    return EFI_SUCCESS;
+
+CLOSE_EVENTS:
+    gBS->CloseEvent(mCommitEvent);
+    mCommitEvent = NULL;
+
+FREE_BUFFER:
+    gBS->FreePool(mCommitBuffer);
+    mCommitBuffer = NULL;
+    return Status;
+}
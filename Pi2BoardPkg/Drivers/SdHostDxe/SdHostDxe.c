@@ -23,30 +23,45 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/DmaLib.h>
 #include <Library/TimerLib.h>
+#include <Library/ArmLib.h>
 
 #include <Protocol/EmbeddedExternalDevice.h>
 #include <Protocol/BlockIo.h>
 #include <Protocol/DevicePath.h>
 #include <Protocol/MmcHost.h>
+#include <Protocol/HardwareInterrupt.h>
 
 #include <LedLib.h>
 #include <Bcm2836.h>
 #include <Bcm2836SdHost.h>
+#include <Bcm2836Dma.h>
 #include <BcmMailbox.h>
 
 #define SDHOST_BLOCK_BYTE_LENGTH            512
 
 // Driver Timing Parameters
-#define CMD_STALL_AFTER_POLL_US             1
-#define CMD_MIN_POLL_TOTAL_TIME_US          100000 // 100ms
-#define CMD_MAX_POLL_COUNT                  (CMD_MIN_POLL_TOTAL_TIME_US / CMD_STALL_AFTER_POLL_US)
+#define CMD_POLL_TIMEOUT_US                 100000 // 100ms
+#define CMD_BUSY_TIMEOUT_US                 500000 // 500ms, the longest SDXC write busy
 #define CMD_MAX_RETRY_COUNT                 3
 #define CMD_STALL_AFTER_RETRY_US            20 // 20us
 #define FIFO_MAX_POLL_COUNT                 1000000
 #define STALL_TO_STABILIZE_US               10000 // 10ms
+#define SLEEP_MAX_US                        10000 // 10ms, sleeps also wake up on their own
 
 #define IDENT_MODE_SD_CLOCK_FREQ_HZ         400000 // 400KHz
 
+// DMA Parameters
+#define DMA_TRANSFER_TIMEOUT_US             1000000 // 1s
+#define DMA_PIO_THRESHOLD_BLOCKS            1 // Single block transfers are cheaper with PIO
+#define DMA_CB_MAX_TRANSFER_LENGTH          0x8000 // 32KB, also fits lite channels
+#define DMA_CB_COUNT                        (EFI_PAGE_SIZE / sizeof(DMA_CONTROL_BLOCK))
+#define DMA_MAX_TRANSFER_LENGTH             (DMA_CB_COUNT * DMA_CB_MAX_TRANSFER_LENGTH)
+#define FIFO_READ_THRESHOLD                 4
+#define FIFO_WRITE_THRESHOLD                4
+// The Fifo won't raise a DREQ for the last words of a read sitting below the read
+// threshold, those have to be drained by the CPU
+#define DMA_READ_DRAIN_WORDS                (FIFO_READ_THRESHOLD - 1)
+
 // Macros adopted from MmcDxe internal header
 #define SDHOST_CSD_GET_TRANSPEED(Response)  ((Response[2] >> 24)& 0xFF)
 #define SDHOST_R0_READY_FOR_DATA            BIT8
@@ -61,17 +76,52 @@ UINT32 mRca = 0;
 UINT32 mLastExecutedMmcCmd = MMC_GET_INDX(MMC_CMD0);
 BOOLEAN mIsSdBusSwitched4BitMode = FALSE;
 UINT64 mScr = 0;
+BOOLEAN mDmaEnabled = FALSE;
+UINT32 mDmaChannel = 0;
+DMA_CONTROL_BLOCK *mDmaControlBlocks = NULL;
+
+// Interrupt sources of the SD host and of its DMA channel, long waits sleep
+// until one of them fires instead of polling when they are registered
+EFI_HARDWARE_INTERRUPT_PROTOCOL *mInterrupt = NULL;
+BOOLEAN mSdHostIrqRegistered = FALSE;
+BOOLEAN mDmaIrqRegistered = FALSE;
+
+// The DMA transfer SdStartBlockData() left running, SdPollBlockData() finishes it
+BOOLEAN mDmaAsyncActive = FALSE;
+BOOLEAN mDmaAsyncIsRead = FALSE;
+UINT32 *mDmaAsyncBuffer = NULL;
+UINTN mDmaAsyncLength = 0;
+UINTN mDmaAsyncDmaLength = 0;
+VOID *mDmaAsyncMapping = NULL;
+UINT64 mDmaAsyncDeadline = 0;
+EFI_STATUS mDmaAsyncStatus = EFI_SUCCESS;
+
+// Armed for the length of every sleep. A tickless timer driver only interrupts
+// for the timer events, so nothing else bounds the WFI.
+EFI_EVENT mSleepEvent = NULL;
+
+// Set at TPL_NOTIFY once ExitBootServices started. The timer is stopped and the GPU
+// interrupts are masked by then, so the TPL_CALLBACK handlers doing I/O must poll
+EFI_EVENT mExitBootServicesEvent = NULL;
+BOOLEAN mExitBootServicesStarted = FALSE;
 
 // Ensure 16 byte alignment
 volatile MAILBOX_GET_CLOCK_RATE MbGcr __attribute__((aligned(16)));
 
 EFI_STATUS SdHostGetSdStatus(UINT32* StatusR0);
+EFI_STATUS SdPollBlockData(EFI_MMC_HOST_PROTOCOL *This);
 
 BOOLEAN IsAppCmd() { return mLastExecutedMmcCmd == MMC_CMD55; }
 
 BOOLEAN IsBusyCmd(UINT32 MmcCmd) { return ((MmcCmd == MMC_CMD7 || MmcCmd == MMC_CMD12) && !IsAppCmd()); }
 
-BOOLEAN IsWriteCmd(UINT32 MmcCmd) { return (MmcCmd == MMC_CMD24 && !IsAppCmd()); }
+BOOLEAN IsWriteCmd(UINT32 MmcCmd)
+{
+    BOOLEAN CmdIsAppCmd = IsAppCmd();
+    return
+        (MmcCmd == MMC_CMD24 && !CmdIsAppCmd) ||
+        (MmcCmd == MMC_CMD25 && !CmdIsAppCmd);
+}
 
 BOOLEAN IsReadCmd(UINT32 MmcCmd)
 {
@@ -163,6 +213,169 @@ SdHostDumpStatus(
     SdHostDumpSdCardStatus();
 }
 
+UINT64
+SdHostDeadline(
+    IN UINT32 TimeoutUs
+    )
+{
+    UINT64 Frequency = GetPerformanceCounterProperties(NULL, NULL);
+
+    return GetPerformanceCounter() + DivU64x32(MultU64x32(Frequency, TimeoutUs), 1000000);
+}
+
+BOOLEAN
+SdHostIsExpired(
+    IN UINT64 Deadline
+    )
+{
+    return GetPerformanceCounter() > Deadline;
+}
+
+/**
+  Returns TRUE when Source can wake the CPU up from WFI. Interrupts are off at
+  TPL_HIGH_LEVEL, and once ExitBootServices started the GPU interrupts are masked and
+  the timer is stopped, so the waiters have to poll.
+**/
+BOOLEAN
+SdHostCanSleepOn(
+    IN HARDWARE_INTERRUPT_SOURCE Source
+    )
+{
+    BOOLEAN SourceEnabled;
+
+    if (mExitBootServicesStarted || !ArmGetInterruptState()) {
+        return FALSE;
+    }
+
+    if (EFI_ERROR(mInterrupt->GetInterruptSourceState(mInterrupt, Source, &SourceEnabled))) {
+        return FALSE;
+    }
+
+    return SourceEnabled;
+}
+
+/**
+  Sleeps until the next interrupt as long as (Register & Mask) == PendingValue and
+  Deadline has not passed, or returns right away when Source cannot wake the CPU up.
+  Interrupts are masked across the check and the WFI so that one raised in between
+  still wakes the CPU up, it is then taken once they are unmasked.
+
+  The sleep lasts SLEEP_MAX_US at most, up to Deadline, whether the timer ticks
+  periodically or not, so that the waiters also see the conditions that raise no
+  interrupt.
+**/
+VOID
+SdHostSleepWhile(
+    IN HARDWARE_INTERRUPT_SOURCE Source,
+    IN UINTN  Register,
+    IN UINT32 Mask,
+    IN UINT32 PendingValue,
+    IN UINT64 Deadline
+    )
+{
+    UINT64 Frequency;
+    UINT64 Now;
+    UINT64 SleepUs;
+
+    if (!SdHostCanSleepOn(Source) || SdHostIsExpired(Deadline)) {
+        return;
+    }
+
+    Frequency = GetPerformanceCounterProperties(NULL, NULL);
+    Now = GetPerformanceCounter();
+    SleepUs = (Deadline > Now) ? DivU64x64Remainder(MultU64x32(Deadline - Now, 1000000), Frequency, NULL) : 0;
+    SleepUs = MAX(MIN(SleepUs, SLEEP_MAX_US), 1);
+    if (EFI_ERROR(gBS->SetTimer(mSleepEvent, TimerRelative, MultU64x32(SleepUs, 10)))) {
+        return;
+    }
+
+    ArmDisableInterrupts();
+    if ((MmioRead32(Register) & Mask) == PendingValue) {
+        ArmCallWFI();
+    }
+    ArmEnableInterrupts();
+
+    gBS->SetTimer(mSleepEvent, TimerCancel, 0);
+}
+
+VOID
+EFIAPI
+SdHostExitBootServices(
+    IN EFI_EVENT Event,
+    IN VOID      *Context
+    )
+{
+    mExitBootServicesStarted = TRUE;
+
+    // No DMA may keep writing to memory once the OS owns it
+    while (SdPollBlockData(NULL) == EFI_NOT_READY);
+}
+
+/**
+  The handlers only mask their source, the waiter reads the status itself
+**/
+VOID
+EFIAPI
+SdHostInterruptHandler(
+    IN HARDWARE_INTERRUPT_SOURCE    Source,
+    IN EFI_SYSTEM_CONTEXT           SystemContext
+    )
+{
+    MmioAnd32(SDHOST_HCFG, ~SDHOST_HCFG_IRPT_EN_MASK);
+    mInterrupt->EndOfInterrupt(mInterrupt, Source);
+}
+
+VOID
+EFIAPI
+SdHostDmaInterruptHandler(
+    IN HARDWARE_INTERRUPT_SOURCE    Source,
+    IN EFI_SYSTEM_CONTEXT           SystemContext
+    )
+{
+    // Only raised by the last control block, the channel is already idle
+    MmioWrite32(DMA_CS(mDmaChannel), DMA_CS_INT);
+    mInterrupt->EndOfInterrupt(mInterrupt, Source);
+}
+
+/**
+  Waits for the card to release DAT0 at the end of a busy (R1b) command
+**/
+EFI_STATUS
+SdHostWaitForBusy(
+    VOID
+    )
+{
+    UINT64 Deadline = SdHostDeadline(CMD_BUSY_TIMEOUT_US);
+
+    for (;;) {
+        UINT32 Hsts = MmioRead32(SDHOST_HSTS);
+
+        if (Hsts & SDHOST_HSTS_ERROR) {
+            return EFI_DEVICE_ERROR;
+        }
+
+        if (Hsts & SDHOST_HSTS_BUSY_IRPT) {
+            MmioWrite32(SDHOST_HSTS, SDHOST_HSTS_BUSY_IRPT);
+            return EFI_SUCCESS;
+        }
+
+        if (SdHostIsExpired(Deadline)) {
+            DEBUG((DEBUG_ERROR, "SdHost: SdHostWaitForBusy(): Card still busy after %dms\n", CMD_BUSY_TIMEOUT_US / 1000));
+            return EFI_TIMEOUT;
+        }
+
+        if (mSdHostIrqRegistered) {
+            MmioOr32(SDHOST_HCFG, SDHOST_HCFG_BUSY_IRPT_EN);
+            SdHostSleepWhile(
+                INT_GPU_SOURCE(INT_GPU_IRQ_SDHOST),
+                SDHOST_HSTS,
+                SDHOST_HSTS_BUSY_IRPT | SDHOST_HSTS_ERROR,
+                0,
+                Deadline);
+        }
+    }
+}
+
 EFI_STATUS
 SdHostSetClockFrequency(
     IN UINTN TargetSdFreqHz
@@ -263,6 +476,9 @@ SdSendCommand(
         return EFI_UNSUPPORTED;
     }
 
+    // The data of the previous transfer must have landed, see SdPollBlockData()
+    ASSERT(!mDmaAsyncActive);
+
     if (MmioRead32(SDHOST_CMD) & SDHOST_CMD_NEW_FLAG) {
         DEBUG((
             DEBUG_ERROR,
@@ -308,7 +524,6 @@ SdSendCommand(
         ((SdCmd & SDHOST_CMD_WRITE_CMD) ? 1 : 0),
         ((SdCmd & SDHOST_CMD_READ_CMD) ? 1 : 0)));
 
-    UINT32 PollCount = 0;
     UINT32 RetryCount = 0;
     BOOLEAN IsCmdExecuted = FALSE;
     EFI_STATUS Status = EFI_SUCCESS;
@@ -327,8 +542,11 @@ SdSendCommand(
         // Write command and set it to start execution
         MmioWrite32(SDHOST_CMD, SDHOST_CMD_NEW_FLAG | SdCmd);
 
-        // Poll for the command status untill it finishes execution
-        while (PollCount < CMD_MAX_POLL_COUNT) {
+        // Poll for the command status untill it finishes execution. The SD host has no
+        // command completion interrupt and a command takes a few SD clocks, so spin on
+        // the register rather than stalling in between reads
+        UINT64 Deadline = SdHostDeadline(CMD_POLL_TIMEOUT_US);
+        while (!SdHostIsExpired(Deadline)) {
             UINT32 CmdReg = MmioRead32(SDHOST_CMD);
 
             // Read status of command response
@@ -342,9 +560,6 @@ SdSendCommand(
                 IsCmdExecuted = TRUE;
                 break;
             }
-
-            ++PollCount;
-            gBS->Stall(CMD_STALL_AFTER_POLL_US);
         }
 
         if (!IsCmdExecuted) {
@@ -357,6 +572,12 @@ SdSendCommand(
         Status = EFI_TIMEOUT;
     }
 
+    // Busy commands are only done once the card releases DAT0
+    if (IsCmdExecuted &&
+        (SdCmd & SDHOST_CMD_BUSY_CMD) &&
+        !(MmioRead32(SDHOST_HSTS) & SDHOST_HSTS_ERROR)) {
+        Status = SdHostWaitForBusy();
+    }
 
 
     if (EFI_ERROR(Status) ||
@@ -623,6 +844,360 @@ SdHostSwitch4BitBusWidth(
     return Status;
 }
 
+EFI_STATUS
+SdHostPioRead(
+    IN UINT32*                  Buffer,
+    IN UINTN                    NumWords
+    )
+{
+    UINT32 WordIdx;
+
+    for (WordIdx = 0; WordIdx < NumWords; ++WordIdx) {
+        UINT32 PollCount = 0;
+        while (PollCount < FIFO_MAX_POLL_COUNT) {
+            if (MmioRead32(SDHOST_HSTS) & SDHOST_HSTS_DATA_FLAG) {
+                Buffer[WordIdx] = MmioRead32(SDHOST_DATA);
+                break;
+            }
+
+            ++PollCount;
+        }
+
+        if (PollCount == FIFO_MAX_POLL_COUNT) {
+            DEBUG(
+                (DEBUG_ERROR,
+                    "SdHost: SdReadBlockData(): Block Word%d read poll timed-out\n",
+                    WordIdx));
+            SdHostDumpStatus();
+            MmioWrite32(SDHOST_HSTS, SDHOST_HSTS_CLEAR);
+            return EFI_TIMEOUT;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+SdHostPioWrite(
+    IN UINT32*                  Buffer,
+    IN UINTN                    NumWords
+    )
+{
+    UINT32 WordIdx;
+
+    for (WordIdx = 0; WordIdx < NumWords; ++WordIdx) {
+        UINT32 PollCount = 0;
+        while (PollCount < FIFO_MAX_POLL_COUNT) {
+            if (MmioRead32(SDHOST_HSTS) & SDHOST_HSTS_DATA_FLAG) {
+                MmioWrite32(SDHOST_DATA, Buffer[WordIdx]);
+                break;
+            }
+
+            ++PollCount;
+        }
+
+        if (PollCount == FIFO_MAX_POLL_COUNT) {
+            DEBUG((
+                DEBUG_ERROR,
+                "SdHost: SdWriteBlockData(): Block Word%d write poll timed-out\n",
+                WordIdx));
+            SdHostDumpStatus();
+            MmioWrite32(SDHOST_HSTS, SDHOST_HSTS_CLEAR);
+            return EFI_TIMEOUT;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+BOOLEAN
+SdHostIsDmaTransfer(
+    IN UINTN                    Length,
+    IN UINT32*                  Buffer
+    )
+{
+    // The DMA engine moves whole words to/from the data Fifo, anything else
+    // and short transfers that don't pay off the mapping cost go through PIO
+    return mDmaEnabled &&
+        (((UINTN)Buffer & (sizeof(UINT32) - 1)) == 0) &&
+        (Length > (DMA_PIO_THRESHOLD_BLOCKS * SDHOST_BLOCK_BYTE_LENGTH));
+}
+
+VOID
+SdHostDmaStart(
+    IN BOOLEAN                  IsRead,
+    IN UINT32                   MemoryBusAddress,
+    IN UINTN                    Length
+    )
+{
+    UINT32 DataBusAddress = DMA_PERIPHERAL_BUS_ADDRESS(SDHOST_DATA);
+    UINT32 TransferInfo;
+    UINTN Offset;
+    UINTN CbIdx;
+
+    ASSERT(Length <= DMA_MAX_TRANSFER_LENGTH);
+
+    if (IsRead) {
+        TransferInfo = DMA_TI_SRC_DREQ | DMA_TI_DEST_INC;
+    } else {
+        TransferInfo = DMA_TI_DEST_DREQ | DMA_TI_SRC_INC;
+    }
+    TransferInfo |= DMA_TI_PERMAP(DMA_DREQ_SDHOST) | DMA_TI_WAIT_RESP;
+
+    // Chain the control blocks over the buffer
+    for (Offset = 0, CbIdx = 0; Offset < Length; ++CbIdx) {
+        DMA_CONTROL_BLOCK *Cb = &mDmaControlBlocks[CbIdx];
+        UINTN CbLength = MIN(Length - Offset, DMA_CB_MAX_TRANSFER_LENGTH);
+
+        Cb->TransferInfo = TransferInfo;
+        Cb->SourceAddress = IsRead ? DataBusAddress : (MemoryBusAddress + Offset);
+        Cb->DestinationAddress = IsRead ? (MemoryBusAddress + Offset) : DataBusAddress;
+        Cb->TransferLength = CbLength;
+        Cb->Stride = 0;
+
+        Offset += CbLength;
+        if (Offset < Length) {
+            Cb->NextControlBlock = (UINT32)(UINTN)&mDmaControlBlocks[CbIdx + 1] | UNCACHED_ADDRESS_MASK;
+        } else {
+            Cb->NextControlBlock = 0;
+            // Wake the waiter up once the last block is done
+            if (mDmaIrqRegistered) {
+                Cb->TransferInfo |= DMA_TI_INTEN;
+            }
+        }
+    }
+
+    // Make sure the control blocks reached memory before the channel fetches them
+    ArmDataSyncronizationBarrier();
+
+    MmioWrite32(DMA_DEBUG(mDmaChannel), DMA_DEBUG_CLEAR);
+    MmioWrite32(DMA_CONBLK_AD(mDmaChannel), (UINT32)(UINTN)mDmaControlBlocks | UNCACHED_ADDRESS_MASK);
+    MmioWrite32(
+        DMA_CS(mDmaChannel),
+        DMA_CS_ACTIVE | DMA_CS_END | DMA_CS_WAIT_FOR_OUTSTANDING_WRITES);
+}
+
+/**
+  Returns EFI_NOT_READY while the transfer started by SdHostDmaStart() is running,
+  its outcome otherwise. The channel is left ready for the next transfer either way.
+**/
+EFI_STATUS
+SdHostDmaCheck(
+    IN BOOLEAN                  IsRead,
+    IN UINTN                    Length,
+    IN UINT64                   Deadline
+    )
+{
+    UINT32 Cs = MmioRead32(DMA_CS(mDmaChannel));
+    BOOLEAN IsTimedOut = FALSE;
+
+    if (Cs & DMA_CS_ERROR) {
+        DEBUG((
+            DEBUG_ERROR,
+            "SdHost: SdHostDmaCheck(): DMA error, CS: 0x%8.8X, DEBUG: 0x%8.8X\n",
+            Cs,
+            MmioRead32(DMA_DEBUG(mDmaChannel))));
+    } else if (!(Cs & DMA_CS_ACTIVE)) {
+        MmioWrite32(DMA_CS(mDmaChannel), DMA_CS_END);
+        return EFI_SUCCESS;
+    } else if (MmioRead32(SDHOST_HSTS) & SDHOST_HSTS_ERROR) {
+        // The card side failed, the Fifo will never be serviced again
+    } else if (SdHostIsExpired(Deadline)) {
+        IsTimedOut = TRUE;
+    } else {
+        return EFI_NOT_READY;
+    }
+
+    DEBUG((
+        DEBUG_ERROR,
+        "SdHost: SdHostDmaCheck(): %a DMA of 0x%x bytes %a, %d bytes left\n",
+        (IsRead ? "Read" : "Write"),
+        Length,
+        (IsTimedOut ? "timed out" : "failed"),
+        MmioRead32(DMA_TXFR_LEN(mDmaChannel))));
+    SdHostDumpStatus();
+
+    // Leave the channel ready for the next transfer
+    MmioWrite32(DMA_CS(mDmaChannel), DMA_CS_ABORT);
+    MmioWrite32(DMA_CS(mDmaChannel), DMA_CS_RESET);
+    MmioWrite32(SDHOST_HSTS, SDHOST_HSTS_CLEAR);
+
+    return IsTimedOut ? EFI_TIMEOUT : EFI_DEVICE_ERROR;
+}
+
+EFI_STATUS
+SdHostDmaRun(
+    IN BOOLEAN                  IsRead,
+    IN UINT32                   MemoryBusAddress,
+    IN UINTN                    Length
+    )
+{
+    EFI_STATUS Status;
+
+    SdHostDmaStart(IsRead, MemoryBusAddress, Length);
+
+    UINT64 Deadline = SdHostDeadline(DMA_TRANSFER_TIMEOUT_US);
+    for (;;) {
+        Status = SdHostDmaCheck(IsRead, Length, Deadline);
+        if (Status != EFI_NOT_READY) {
+            return Status;
+        }
+
+        // Card side errors raise no DMA interrupt, they are caught when the sleep ends
+        if (mDmaIrqRegistered) {
+            SdHostSleepWhile(
+                INT_GPU_SOURCE(INT_GPU_IRQ_DMA(mDmaChannel)),
+                DMA_CS(mDmaChannel),
+                DMA_CS_ACTIVE | DMA_CS_ERROR,
+                DMA_CS_ACTIVE,
+                Deadline);
+        }
+    }
+}
+
+EFI_STATUS
+SdHostDmaTransfer(
+    IN BOOLEAN                  IsRead,
+    IN UINTN                    Length,
+    IN UINT32*                  Buffer
+    )
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    UINT8 *Chunk = (UINT8*)Buffer;
+    UINTN BytesLeft = Length;
+
+    while (BytesLeft > 0) {
+        EFI_PHYSICAL_ADDRESS DeviceAddress;
+        VOID *Mapping;
+        UINTN ChunkLength = MIN(BytesLeft, DMA_MAX_TRANSFER_LENGTH);
+        UINTN MappedLength = ChunkLength;
+        UINTN DmaLength = ChunkLength;
+        BOOLEAN IsLastChunk = (ChunkLength == BytesLeft);
+
+        // The whole chunk is mapped to keep the cache maintenance on full cache lines
+        // even though the DMA engine stops short of the read drain words
+        if (IsRead && IsLastChunk) {
+            DmaLength -= DMA_READ_DRAIN_WORDS * sizeof(UINT32);
+        }
+
+        Status = DmaMap(
+            (IsRead ? MapOperationBusMasterWrite : MapOperationBusMasterRead),
+            Chunk,
+            &MappedLength,
+            &DeviceAddress,
+            &Mapping);
+        if (EFI_ERROR(Status)) {
+            DEBUG((DEBUG_ERROR, "SdHost: SdHostDmaTransfer(): DmaMap failed. %r\n", Status));
+            return Status;
+        }
+        ASSERT(MappedLength == ChunkLength);
+
+        Status = SdHostDmaRun(IsRead, (UINT32)DeviceAddress | UNCACHED_ADDRESS_MASK, DmaLength);
+
+        DmaUnmap(Mapping);
+
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+
+        if (DmaLength != ChunkLength) {
+            Status = SdHostPioRead(
+                (UINT32*)(Chunk + DmaLength),
+                (ChunkLength - DmaLength) / sizeof(UINT32));
+            if (EFI_ERROR(Status)) {
+                return Status;
+            }
+        }
+
+        Chunk += ChunkLength;
+        BytesLeft -= ChunkLength;
+    }
+
+    return Status;
+}
+
+EFI_STATUS
+SdHostDmaInitialize(
+    VOID
+    )
+{
+    EFI_STATUS Status;
+
+    mDmaChannel = PcdGet32(PcdSdHostDmaChannel);
+    if (mDmaChannel >= DMA_CHANNEL_COUNT) {
+        DEBUG((DEBUG_ERROR, "SdHost: SdHostDmaInitialize(): Invalid DMA channel %d\n", mDmaChannel));
+        return EFI_INVALID_PARAMETER;
+    }
+
+    // One page of uncached control blocks, so the chain needs no cache maintenance
+    Status = DmaAllocateBuffer(EfiBootServicesData, 1, (VOID**)&mDmaControlBlocks);
+    if (EFI_ERROR(Status) || (mDmaControlBlocks == NULL)) {
+        DEBUG((DEBUG_ERROR, "SdHost: SdHostDmaInitialize(): Failed to allocate control blocks\n"));
+        return EFI_OUT_OF_RESOURCES;
+    }
+    ASSERT(((UINTN)mDmaControlBlocks & (DMA_CONTROL_BLOCK_ALIGNMENT - 1)) == 0);
+
+    MmioOr32(DMA_ENABLE, 1 << mDmaChannel);
+    MmioWrite32(DMA_CS(mDmaChannel), DMA_CS_RESET);
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+SdHostInterruptInitialize(
+    VOID
+    )
+{
+    EFI_STATUS Status;
+
+    Status = gBS->LocateProtocol(&gHardwareInterruptProtocolGuid, NULL, (VOID**)&mInterrupt);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    // TPL_NOTIFY, ahead of the TPL_CALLBACK handlers that may still flush to the card
+    Status = gBS->CreateEvent(
+        EVT_SIGNAL_EXIT_BOOT_SERVICES,
+        TPL_NOTIFY,
+        SdHostExitBootServices,
+        NULL,
+        &mExitBootServicesEvent);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    Status = gBS->CreateEvent(EVT_TIMER, 0, NULL, NULL, &mSleepEvent);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    // Enable bits in HCFG are only set while waiting
+    MmioAnd32(SDHOST_HCFG, ~SDHOST_HCFG_IRPT_EN_MASK);
+
+    Status = mInterrupt->RegisterInterruptSource(
+        mInterrupt,
+        INT_GPU_SOURCE(INT_GPU_IRQ_SDHOST),
+        SdHostInterruptHandler);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+    mSdHostIrqRegistered = TRUE;
+
+    // Higher channels share their interrupt with other channels
+    if (mDmaEnabled && (mDmaChannel <= INT_GPU_IRQ_DMA_MAX_CHANNEL)) {
+        Status = mInterrupt->RegisterInterruptSource(
+            mInterrupt,
+            INT_GPU_SOURCE(INT_GPU_IRQ_DMA(mDmaChannel)),
+            SdHostDmaInterruptHandler);
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+        mDmaIrqRegistered = TRUE;
+    }
+
+    return EFI_SUCCESS;
+}
+
 EFI_STATUS
 SdReadBlockData(
     IN EFI_MMC_HOST_PROTOCOL    *This,
@@ -639,35 +1214,13 @@ SdReadBlockData(
     ASSERT(Buffer != NULL);
     ASSERT(Length % SDHOST_BLOCK_BYTE_LENGTH == 0);
 
-    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_STATUS Status;
 
     LedSetOk(TRUE);
-    {
-        UINT32 NumWords = Length / 4;
-        UINT32 WordIdx;
-
-        for (WordIdx = 0; WordIdx < NumWords; ++WordIdx) {
-            UINT32 PollCount = 0;
-            while (PollCount < FIFO_MAX_POLL_COUNT) {
-                if (MmioRead32(SDHOST_HSTS) & SDHOST_HSTS_DATA_FLAG) {
-                    Buffer[WordIdx] = MmioRead32(SDHOST_DATA);
-                    break;
-                }
-
-                ++PollCount;
-            }
-            
-            if (PollCount == FIFO_MAX_POLL_COUNT) {
-                DEBUG(
-                    (DEBUG_ERROR,
-                        "SdHost: SdReadBlockData(): Block Word%d read poll timed-out\n",
-                        WordIdx));
-                SdHostDumpStatus();
-                MmioWrite32(SDHOST_HSTS, SDHOST_HSTS_CLEAR);
-                Status = EFI_TIMEOUT;
-                break;
-            }
-        }
+    if (SdHostIsDmaTransfer(Length, Buffer)) {
+        Status = SdHostDmaTransfer(TRUE, Length, Buffer);
+    } else {
+        Status = SdHostPioRead(Buffer, Length / sizeof(UINT32));
     }
     LedSetOk(FALSE);
 
@@ -690,38 +1243,123 @@ SdWriteBlockData(
     ASSERT(Buffer != NULL);
     ASSERT(Length % SDHOST_BLOCK_BYTE_LENGTH == 0);
 
-    EFI_STATUS Status = EFI_SUCCESS;
+    EFI_STATUS Status;
 
     LedSetOk(TRUE);
-    {
-        UINT32 NumWords = Length / 4;
-        UINT32 WordIdx;
-
-        for (WordIdx = 0; WordIdx < NumWords; ++WordIdx) {
-            UINT32 PollCount = 0;
-            while (PollCount < FIFO_MAX_POLL_COUNT) {
-                if (MmioRead32(SDHOST_HSTS) & SDHOST_HSTS_DATA_FLAG) {
-                    MmioWrite32(SDHOST_DATA, Buffer[WordIdx]);
-                    break;
-                }
-
-                ++PollCount;
-            }
+    if (SdHostIsDmaTransfer(Length, Buffer)) {
+        Status = SdHostDmaTransfer(FALSE, Length, Buffer);
+    } else {
+        Status = SdHostPioWrite(Buffer, Length / sizeof(UINT32));
+    }
+    LedSetOk(FALSE);
 
-            if (PollCount == FIFO_MAX_POLL_COUNT) {
-                DEBUG((
-                    DEBUG_ERROR,
-                    "SdHost: SdWriteBlockData(): Block Word%d write poll timed-out\n",
-                    WordIdx));
-                SdHostDumpStatus();
-                MmioWrite32(SDHOST_HSTS, SDHOST_HSTS_CLEAR);
-                Status = EFI_TIMEOUT;
-                break;
-            }
+    return Status;
+}
+
+BOOLEAN
+SdIsMultiBlock(
+    IN EFI_MMC_HOST_PROTOCOL *This
+    )
+{
+    // Only worth it when the data goes through DMA, the mapping cost is then paid
+    // once per transfer. Without DMA MmcDxe keeps handing the data over one block
+    // at a time, as it always did.
+    return mDmaEnabled;
+}
+
+/**
+  Leaves a transfer that fits a single DMA run moving in the background. Anything
+  else is moved right away and only its outcome is left for SdPollBlockData().
+**/
+EFI_STATUS
+SdStartBlockData(
+    IN EFI_MMC_HOST_PROTOCOL    *This,
+    IN BOOLEAN                  IsRead,
+    IN EFI_LBA                  Lba,
+    IN UINTN                    Length,
+    IN UINT32*                  Buffer
+    )
+{
+    DEBUG((
+        DEBUG_MMCHOST_SD,
+        "SdHost: SdStartBlockData(%a, LBA: 0x%x, Length: 0x%x, Buffer: 0x%x)\n",
+        (IsRead ? "Read" : "Write"),
+        (UINT32)Lba, Length, Buffer));
+
+    ASSERT(Buffer != NULL);
+    ASSERT(Length % SDHOST_BLOCK_BYTE_LENGTH == 0);
+    ASSERT(!mDmaAsyncActive);
+
+    EFI_STATUS Status;
+    EFI_PHYSICAL_ADDRESS DeviceAddress;
+    UINTN MappedLength = Length;
+
+    // The read drain words and the chunking of longer transfers need the CPU
+    if (!SdHostIsDmaTransfer(Length, Buffer) || (Length > DMA_MAX_TRANSFER_LENGTH)) {
+        if (IsRead) {
+            Status = SdReadBlockData(This, Lba, Length, Buffer);
+        } else {
+            Status = SdWriteBlockData(This, Lba, Length, Buffer);
         }
+        mDmaAsyncStatus = Status;
+        return Status;
+    }
+
+    Status = DmaMap(
+        (IsRead ? MapOperationBusMasterWrite : MapOperationBusMasterRead),
+        Buffer,
+        &MappedLength,
+        &DeviceAddress,
+        &mDmaAsyncMapping);
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "SdHost: SdStartBlockData(): DmaMap failed. %r\n", Status));
+        return Status;
+    }
+    ASSERT(MappedLength == Length);
+
+    mDmaAsyncIsRead = IsRead;
+    mDmaAsyncBuffer = Buffer;
+    mDmaAsyncLength = Length;
+    mDmaAsyncDmaLength = Length;
+    if (IsRead) {
+        mDmaAsyncDmaLength -= DMA_READ_DRAIN_WORDS * sizeof(UINT32);
+    }
+
+    LedSetOk(TRUE);
+    SdHostDmaStart(IsRead, (UINT32)DeviceAddress | UNCACHED_ADDRESS_MASK, mDmaAsyncDmaLength);
+    mDmaAsyncDeadline = SdHostDeadline(DMA_TRANSFER_TIMEOUT_US);
+    mDmaAsyncActive = TRUE;
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS
+SdPollBlockData(
+    IN EFI_MMC_HOST_PROTOCOL    *This
+    )
+{
+    EFI_STATUS Status;
+
+    if (!mDmaAsyncActive) {
+        return mDmaAsyncStatus;
+    }
+
+    Status = SdHostDmaCheck(mDmaAsyncIsRead, mDmaAsyncDmaLength, mDmaAsyncDeadline);
+    if (Status == EFI_NOT_READY) {
+        return Status;
+    }
+
+    DmaUnmap(mDmaAsyncMapping);
+    mDmaAsyncActive = FALSE;
+
+    if (!EFI_ERROR(Status) && (mDmaAsyncDmaLength != mDmaAsyncLength)) {
+        Status = SdHostPioRead(
+            (UINT32*)((UINT8*)mDmaAsyncBuffer + mDmaAsyncDmaLength),
+            (mDmaAsyncLength - mDmaAsyncDmaLength) / sizeof(UINT32));
     }
     LedSetOk(FALSE);
 
+    mDmaAsyncStatus = Status;
     return Status;
 }
 
@@ -766,6 +1404,16 @@ SdNotifyState(
         Hcfg |= SDHOST_HCFG_SLOW_CARD; // Use all bits of CDIV in DataMode
         MmioWrite32(SDHOST_HCFG, Hcfg);
 
+        if (mDmaEnabled) {
+            // Fifo fill levels at which the SD Host raises its DREQ to the DMA engine
+            UINT32 Edm = MmioRead32(SDHOST_EDM);
+            Edm &= ~(SDHOST_EDM_READ_THRESHOLD(SDHOST_EDM_THRESHOLD_MASK) |
+                     SDHOST_EDM_WRITE_THRESHOLD(SDHOST_EDM_THRESHOLD_MASK));
+            Edm |= SDHOST_EDM_READ_THRESHOLD(FIFO_READ_THRESHOLD) |
+                   SDHOST_EDM_WRITE_THRESHOLD(FIFO_WRITE_THRESHOLD);
+            MmioWrite32(SDHOST_EDM, Edm);
+        }
+
         // Set default clock frequency
         EFI_STATUS Status = SdHostSetClockFrequency(IDENT_MODE_SD_CLOCK_FREQ_HZ);
         if (EFI_ERROR(Status)) {
@@ -868,7 +1516,10 @@ EFI_MMC_HOST_PROTOCOL gMmcHost =
     SdSendCommand,
     SdReceiveResponse,
     SdReadBlockData,
-    SdWriteBlockData
+    SdWriteBlockData,
+    SdIsMultiBlock,
+    SdStartBlockData,
+    SdPollBlockData
 };
 
 EFI_STATUS
@@ -883,11 +1534,25 @@ SdHostInitialize(
     DEBUG((DEBUG_MMCHOST_SD, "SdHost: Initialize\n"));
     DEBUG((DEBUG_MMCHOST_SD, "Config:\n"));
     DEBUG((DEBUG_MMCHOST_SD, " - FIFO_MAX_POLL_COUNT=%d\n", FIFO_MAX_POLL_COUNT));
-    DEBUG((DEBUG_MMCHOST_SD, " - CMD_STALL_AFTER_POLL_US=%dus\n", CMD_STALL_AFTER_POLL_US));
-    DEBUG((DEBUG_MMCHOST_SD, " - CMD_MIN_POLL_TOTAL_TIME_US=%dms\n", CMD_MIN_POLL_TOTAL_TIME_US / 1000));
-    DEBUG((DEBUG_MMCHOST_SD, " - CMD_MAX_POLL_COUNT=%d\n", CMD_MAX_POLL_COUNT));
+    DEBUG((DEBUG_MMCHOST_SD, " - CMD_POLL_TIMEOUT_US=%dms\n", CMD_POLL_TIMEOUT_US / 1000));
+    DEBUG((DEBUG_MMCHOST_SD, " - CMD_BUSY_TIMEOUT_US=%dms\n", CMD_BUSY_TIMEOUT_US / 1000));
     DEBUG((DEBUG_MMCHOST_SD, " - CMD_MAX_RETRY_COUNT=%d\n", CMD_MAX_RETRY_COUNT));
     DEBUG((DEBUG_MMCHOST_SD, " - CMD_STALL_AFTER_RETRY_US=%dus\n", CMD_STALL_AFTER_RETRY_US));
+    DEBUG((DEBUG_MMCHOST_SD, " - DMA=%d, Channel=%d\n", PcdGetBool(PcdSdHostDmaEnabled), PcdGet32(PcdSdHostDmaChannel)));
+
+    if (PcdGetBool(PcdSdHostDmaEnabled)) {
+        Status = SdHostDmaInitialize();
+        if (EFI_ERROR(Status)) {
+            DEBUG((DEBUG_ERROR, "SdHost: Failed to initialize DMA, using PIO only. %r\n", Status));
+        } else {
+            mDmaEnabled = TRUE;
+        }
+    }
+
+    Status = SdHostInterruptInitialize();
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_ERROR, "SdHost: Failed to register interrupts, polling only. %r\n", Status));
+    }
 
     Status = gBS->InstallMultipleProtocolInterfaces(
         &Handle,
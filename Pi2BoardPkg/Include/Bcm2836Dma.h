@@ -0,0 +1,102 @@
+/** @file
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __BCM2836DMA_H__
+#define __BCM2836DMA_H__
+
+// The DMA engine sees peripherals through the VideoCore bus address space
+#define DMA_PERIPHERAL_BUS_BASE_ADDRESS     0x7E000000
+#define DMA_PERIPHERAL_BUS_ADDRESS(X)       ((X) - SOC_PERIPHERAL_BASE_ADDRESS + DMA_PERIPHERAL_BUS_BASE_ADDRESS)
+
+#define DMA_BASE_ADDRESS                    (SOC_PERIPHERAL_BASE_ADDRESS + 0x00007000)
+#define DMA_CHANNEL_REG(Ch, X)              (DMA_BASE_ADDRESS + ((Ch) * 0x100) + (X))
+#define DMA_CS(Ch)                          DMA_CHANNEL_REG(Ch, 0x0)
+#define DMA_CONBLK_AD(Ch)                   DMA_CHANNEL_REG(Ch, 0x4)
+#define DMA_TI(Ch)                          DMA_CHANNEL_REG(Ch, 0x8)
+#define DMA_SOURCE_AD(Ch)                   DMA_CHANNEL_REG(Ch, 0xC)
+#define DMA_DEST_AD(Ch)                     DMA_CHANNEL_REG(Ch, 0x10)
+#define DMA_TXFR_LEN(Ch)                    DMA_CHANNEL_REG(Ch, 0x14)
+#define DMA_STRIDE(Ch)                      DMA_CHANNEL_REG(Ch, 0x18)
+#define DMA_NEXTCONBK(Ch)                   DMA_CHANNEL_REG(Ch, 0x1C)
+#define DMA_DEBUG(Ch)                       DMA_CHANNEL_REG(Ch, 0x20)
+#define DMA_INT_STATUS                      (DMA_BASE_ADDRESS + 0xFE0)
+#define DMA_ENABLE                          (DMA_BASE_ADDRESS + 0xFF0)
+
+// Channels 0-6 are full channels, 7-14 are lite channels limited to 64KB per control block
+#define DMA_CHANNEL_COUNT                   15
+#define DMA_LITE_CHANNEL_FIRST              7
+#define DMA_LITE_MAX_TXFR_LEN               0xFFFF
+
+//
+// CS
+//
+#define DMA_CS_ACTIVE                       BIT0
+#define DMA_CS_END                          BIT1
+#define DMA_CS_INT                          BIT2
+#define DMA_CS_DREQ                         BIT3
+#define DMA_CS_PAUSED                       BIT4
+#define DMA_CS_ERROR                        BIT8
+#define DMA_CS_PRIORITY(X)                  (((X) & 0xF) << 16)
+#define DMA_CS_PANIC_PRIORITY(X)            (((X) & 0xF) << 20)
+#define DMA_CS_WAIT_FOR_OUTSTANDING_WRITES  BIT28
+#define DMA_CS_DISDEBUG                     BIT29
+#define DMA_CS_ABORT                        BIT30
+#define DMA_CS_RESET                        BIT31
+
+//
+// TI
+//
+#define DMA_TI_INTEN                        BIT0
+#define DMA_TI_TDMODE                       BIT1
+#define DMA_TI_WAIT_RESP                    BIT3
+#define DMA_TI_DEST_INC                     BIT4
+#define DMA_TI_DEST_WIDTH_128               BIT5
+#define DMA_TI_DEST_DREQ                    BIT6
+#define DMA_TI_DEST_IGNORE                  BIT7
+#define DMA_TI_SRC_INC                      BIT8
+#define DMA_TI_SRC_WIDTH_128                BIT9
+#define DMA_TI_SRC_DREQ                     BIT10
+#define DMA_TI_SRC_IGNORE                   BIT11
+#define DMA_TI_BURST_LENGTH(X)              (((X) & 0xF) << 12)
+#define DMA_TI_PERMAP(X)                    (((X) & 0x1F) << 16)
+#define DMA_TI_WAITS(X)                     (((X) & 0x1F) << 21)
+#define DMA_TI_NO_WIDE_BURSTS               BIT26
+
+//
+// DEBUG
+//
+#define DMA_DEBUG_READ_LAST_NOT_SET_ERROR   BIT0
+#define DMA_DEBUG_FIFO_ERROR                BIT1
+#define DMA_DEBUG_READ_ERROR                BIT2
+#define DMA_DEBUG_CLEAR                     (DMA_DEBUG_READ_LAST_NOT_SET_ERROR | DMA_DEBUG_FIFO_ERROR | DMA_DEBUG_READ_ERROR)
+
+//
+// Peripheral DREQ lines
+//
+#define DMA_DREQ_SDHOST                     13
+
+// Control blocks have to be 256-bit aligned in memory
+#define DMA_CONTROL_BLOCK_ALIGNMENT         32
+
+typedef struct {
+    UINT32 TransferInfo;
+    UINT32 SourceAddress;
+    UINT32 DestinationAddress;
+    UINT32 TransferLength;
+    UINT32 Stride;
+    UINT32 NextControlBlock;
+    UINT32 Reserved[2];
+} DMA_CONTROL_BLOCK;
+
+#endif // __BCM2836DMA_H__
@@ -38,5 +38,36 @@
 #define INT_CORE_MAX_NUM_VECTORS  (32)
 #define INT_CORE_MAX_VECTOR       (INT_CORE_MAX_NUM_VECTORS - 1)
 
+/* Local source of the line coming from the BCM2835 (GPU) interrupt controller */
+#define INT_CORE_GPU_SOURCE       (8)
+
+/*
+   The BCM2835 interrupt controller multiplexes the 64 GPU peripheral interrupts
+   onto INT_CORE_GPU_SOURCE. They are exposed as HARDWARE_INTERRUPT_SOURCEs numbered
+   after the local ones, use INT_GPU_SOURCE() to get the source of a GPU IRQ.
+*/
+#define INT_GPU_BASE_ADDRESS      (SOC_PERIPHERAL_BASE_ADDRESS + 0xB200)
+
+/* n is the bank: 0 for GPU IRQs 0-31, 1 for GPU IRQs 32-63 */
+#define INT_GPU_IRQ_PENDING(n)    (INT_GPU_BASE_ADDRESS + 0x04 + ((n) * 4))
+#define INT_GPU_ENABLE_IRQS(n)    (INT_GPU_BASE_ADDRESS + 0x10 + ((n) * 4))
+#define INT_GPU_DISABLE_IRQS(n)   (INT_GPU_BASE_ADDRESS + 0x1C + ((n) * 4))
+
+#define INT_GPU_NUM_IRQS          (64)
+#define INT_GPU_NUM_BANKS         (INT_GPU_NUM_IRQS / 32)
+
+/* GPU IRQs of the peripherals with a UEFI driver. Channels above 10 share an IRQ */
+#define INT_GPU_IRQ_DMA(c)        (16 + (c))
+#define INT_GPU_IRQ_DMA_MAX_CHANNEL (10)
+#define INT_GPU_IRQ_AUX           (29)
+#define INT_GPU_IRQ_SDHOST        (56)
+#define INT_GPU_IRQ_ARASAN        (62)
+
+#define INT_GPU_SOURCE(Irq)       (INT_CORE_MAX_NUM_VECTORS + (Irq))
+#define INT_IS_GPU_SOURCE(Source) (((Source) >= INT_GPU_SOURCE(0)) && ((Source) <= INT_MAX_VECTOR))
+
+#define INT_MAX_NUM_VECTORS       (INT_CORE_MAX_NUM_VECTORS + INT_GPU_NUM_IRQS)
+#define INT_MAX_VECTOR            (INT_MAX_NUM_VECTORS - 1)
+
 #endif // __BCM2836INTERRUPT_H__
 
@@ -63,6 +63,9 @@
 #define SDBP_ON           BIT8
 #define SDVS_1_8_V        (0x5UL << 9)
 #define SDVS_3_0_V        (0x6UL << 9)
+#define DMAS_MASK         (0x3UL << 3)
+#define DMAS_SDMA         (0x0UL << 3)
+#define DMAS_ADMA2        (0x2UL << 3)
 #define IWE               BIT24
 
 #define MMCHS_SYSCTL      (MMCHS1BASE + 0x2C)
@@ -85,6 +88,7 @@
 #define CC                BIT0
 #define TC                BIT1
 #define BWR               BIT4
+#define DMAI              BIT3
 #define BRR               BIT5
 #define CARD_INS          BIT6
 #define ERRI              BIT15
@@ -92,6 +96,7 @@
 #define DTO               BIT20
 #define DCRC              BIT21
 #define DEB               BIT22
+#define ADMAE             BIT25
 
 #define MMCHS_IE          (MMCHS1BASE + 0x34)
 #define CC_EN             BIT0
@@ -123,14 +128,33 @@
 #define DEB_SIGEN         BIT22
 #define CERR_SIGEN        BIT28
 #define BADA_SIGEN        BIT29
+#define ALL_ERR_SIGEN     0xFFFF0000
 
 #define MMCHS_AC12        (MMCHS1BASE + 0x3C)
 
 #define MMCHS_CAPA        (MMCHS1BASE + 0x40)
+#define ADMA2S            BIT19
 #define VS30              BIT25
 #define VS18              BIT26
 
 #define MMCHS_CUR_CAPA    (MMCHS1BASE + 0x48)
+
+#define MMCHS_ADMA_ES     (MMCHS1BASE + 0x54)
+#define MMCHS_ADMA_SAR    (MMCHS1BASE + 0x58)
+
+// ADMA2 32-bit descriptor, the table has to be 4 byte aligned
+#define ADMA2_VALID               BIT0
+#define ADMA2_END                 BIT1
+#define ADMA2_INT                 BIT2
+#define ADMA2_ACT_TRAN            (0x2UL << 4)
+#define ADMA2_ACT_LINK            (0x3UL << 4)
+#define ADMA2_MAX_DESC_LENGTH     0x8000 // Keep it block aligned, 0 would mean 64KB
+
+typedef struct {
+    UINT16 Attributes;
+    UINT16 Length;
+    UINT32 Address;
+} ADMA2_DESCRIPTOR;
 #define MMCHS_REV         (MMCHS1BASE + 0xFC)
 
 #define BLOCK_COUNT_SHIFT 16
@@ -186,8 +210,8 @@
 #define CMD24             (INDX(24) | DP_ENABLE | CICE_ENABLE | CCCE_ENABLE | RSP_TYPE_48BITS | DDIR_WRITE)
 #define CMD24_INT_EN      (CERR_EN | CIE_EN | CCRC_EN | CC_EN | TC_EN | BWR_EN | CTO_EN | DTO_EN | DCRC_EN | DEB_EN | CEB_EN)
 
-#define CMD25             (INDX(25) | DP_ENABLE | CICE_ENABLE | CCCE_ENABLE | RSP_TYPE_48BITS | MSBS_MULTBLK | DDIR_WRITE | BCE_ENABLE | DE_ENABLE)
-#define CMD25_INT_EN      (CERR_EN | CIE_EN | CCRC_EN | CC_EN | TC_EN | BRR_EN | CTO_EN | DTO_EN | DCRC_EN | DEB_EN | CEB_EN)
+#define CMD25             (INDX(25) | DP_ENABLE | CICE_ENABLE | CCCE_ENABLE | RSP_TYPE_48BITS | MSBS_MULTBLK | DDIR_WRITE | BCE_ENABLE)
+#define CMD25_INT_EN      (CERR_EN | CIE_EN | CCRC_EN | CC_EN | TC_EN | BWR_EN | CTO_EN | DTO_EN | DCRC_EN | DEB_EN | CEB_EN)
 
 #define CMD55             (INDX(55) | CICE_ENABLE | CCCE_ENABLE | RSP_TYPE_48BITS)
 #define CMD55_INT_EN      (CERR_EN | CIE_EN | CCRC_EN | CC_EN | CEB_EN | CTO_EN)
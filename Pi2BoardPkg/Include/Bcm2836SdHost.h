@@ -53,7 +53,9 @@
 // HSTS
 //
 #define SDHOST_HSTS_CLEAR           0x7F8
+#define SDHOST_HSTS_BUSY_IRPT       BIT10
 #define SDHOST_HSTS_BLOCK_IRPT      BIT9
+#define SDHOST_HSTS_SDIO_IRPT       BIT8
 #define SDHOST_HSTS_REW_TIME_OUT    BIT7
 #define SDHOST_HSTS_CMD_TIME_OUT    BIT6
 #define SDHOST_HSTS_CRC16_ERROR     BIT5
@@ -74,6 +76,7 @@
 #define SDHOST_HCFG_DATA_IRPT_EN    BIT4
 #define SDHOST_HCFG_BLOCK_IRPT_EN   BIT8
 #define SDHOST_HCFG_BUSY_IRPT_EN    BIT10
+#define SDHOST_HCFG_IRPT_EN_MASK    (SDHOST_HCFG_DATA_IRPT_EN | SDHOST_HCFG_BLOCK_IRPT_EN | SDHOST_HCFG_BUSY_IRPT_EN)
 
 //
 // EDM
@@ -17,9 +17,12 @@
 
 #define AUX_BASE_ADDRESS  (0x3F215000)
 
+#define AUX_IRQ           (AUX_BASE_ADDRESS + 0x00)
 #define AUX_AUXENB        (AUX_BASE_ADDRESS + 0x04)
 
 #define AUX_MU_IO_REG     (AUX_BASE_ADDRESS + 0x40)
+#define AUX_MU_IER_REG    (AUX_BASE_ADDRESS + 0x44)
+#define AUX_MU_IIR_REG    (AUX_BASE_ADDRESS + 0x48)
 #define AUX_MU_LCR_REG    (AUX_BASE_ADDRESS + 0x4C)
 
 #define AUX_MU_STAT_REG   (AUX_BASE_ADDRESS + 0x64)
@@ -29,4 +32,16 @@
 #define AUX_AUXENB_SPI1_BIT 0x2
 #define AUX_AUXENB_SPI2_BIT 0x4
 
+// The interrupt shared by the mini UART and the two SPI masters
+#define AUX_IRQ_MINIUART_BIT 0x1
+
+// The datasheet has the receive and transmit enable bits swapped, and bits 3:2
+// must be set for the mini UART to raise any interrupt (BCM2835 datasheet errata)
+#define AUX_MU_IER_RX_INT     0x1
+#define AUX_MU_IER_TX_INT     0x2
+#define AUX_MU_IER_ENABLE     0xC
+
+#define AUX_MU_STAT_RX_READY  0x1
+#define AUX_MU_STAT_TX_SPACE  0x2
+
 #endif // __BCM2836UART_H__
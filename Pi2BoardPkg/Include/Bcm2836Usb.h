@@ -0,0 +1,208 @@
+/** @file
+*
+*  Synopsys DesignWare USB 2.0 Hi-Speed On-The-Go (DWC2) controller of the
+*  BCM2836/BCM2837, host mode registers only.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __BCM2836USB_H__
+#define __BCM2836USB_H__
+
+#define DWUSB_BASE_ADDRESS          (SOC_PERIPHERAL_BASE_ADDRESS + 0x00980000)
+#define DWUSB_REG(X)                (DWUSB_BASE_ADDRESS + (X))
+
+//
+// Core global registers
+//
+#define DWUSB_GOTGCTL               DWUSB_REG(0x000)
+#define DWUSB_GAHBCFG               DWUSB_REG(0x008)
+#define DWUSB_GUSBCFG               DWUSB_REG(0x00C)
+#define DWUSB_GRSTCTL               DWUSB_REG(0x010)
+#define DWUSB_GINTSTS               DWUSB_REG(0x014)
+#define DWUSB_GINTMSK               DWUSB_REG(0x018)
+#define DWUSB_GRXFSIZ               DWUSB_REG(0x024)
+#define DWUSB_GNPTXFSIZ             DWUSB_REG(0x028)
+#define DWUSB_GSNPSID               DWUSB_REG(0x040)
+#define DWUSB_GHWCFG2               DWUSB_REG(0x048)
+#define DWUSB_GHWCFG3               DWUSB_REG(0x04C)
+#define DWUSB_HPTXFSIZ              DWUSB_REG(0x100)
+
+//
+// Host mode registers
+//
+#define DWUSB_HCFG                  DWUSB_REG(0x400)
+#define DWUSB_HFIR                  DWUSB_REG(0x404)
+#define DWUSB_HFNUM                 DWUSB_REG(0x408)
+#define DWUSB_HAINT                 DWUSB_REG(0x414)
+#define DWUSB_HAINTMSK              DWUSB_REG(0x418)
+#define DWUSB_HPRT                  DWUSB_REG(0x440)
+
+//
+// Host channel registers
+//
+#define DWUSB_HC_REG(Ch, X)         DWUSB_REG(0x500 + ((Ch) * 0x20) + (X))
+#define DWUSB_HCCHAR(Ch)            DWUSB_HC_REG(Ch, 0x00)
+#define DWUSB_HCSPLT(Ch)            DWUSB_HC_REG(Ch, 0x04)
+#define DWUSB_HCINT(Ch)             DWUSB_HC_REG(Ch, 0x08)
+#define DWUSB_HCINTMSK(Ch)          DWUSB_HC_REG(Ch, 0x0C)
+#define DWUSB_HCTSIZ(Ch)            DWUSB_HC_REG(Ch, 0x10)
+#define DWUSB_HCDMA(Ch)             DWUSB_HC_REG(Ch, 0x14)
+
+#define DWUSB_PCGCCTL               DWUSB_REG(0xE00)
+
+//
+// GAHBCFG
+//
+#define DWUSB_GAHBCFG_GLBL_INTR_EN          BIT0
+#define DWUSB_GAHBCFG_HBSTLEN_INCR4         (3 << 1)
+#define DWUSB_GAHBCFG_HBSTLEN_INCR8         (5 << 1)
+#define DWUSB_GAHBCFG_HBSTLEN_INCR16        (7 << 1)
+#define DWUSB_GAHBCFG_DMA_EN                BIT5
+
+//
+// GUSBCFG
+//
+#define DWUSB_GUSBCFG_FORCE_HOST_MODE       BIT29
+#define DWUSB_GUSBCFG_FORCE_DEV_MODE        BIT30
+
+//
+// GRSTCTL
+//
+#define DWUSB_GRSTCTL_CSFTRST               BIT0
+#define DWUSB_GRSTCTL_RXFFLSH               BIT4
+#define DWUSB_GRSTCTL_TXFFLSH               BIT5
+#define DWUSB_GRSTCTL_TXFNUM_ALL            (0x10 << 6)
+#define DWUSB_GRSTCTL_AHBIDLE               BIT31
+
+//
+// GINTSTS
+//
+#define DWUSB_GINTSTS_CURMOD_HOST           BIT0
+
+//
+// GSNPSID, the core version is in the low 12 bits
+//
+#define DWUSB_GSNPSID_ID_MASK               0xFFFFF000
+#define DWUSB_GSNPSID_OTG2                  0x4F542000
+
+//
+// GHWCFG2
+//
+#define DWUSB_GHWCFG2_NUM_HOST_CHAN(X)      ((((X) >> 14) & 0xF) + 1)
+
+//
+// GHWCFG3, widths of the transfer size and packet count fields of HCTSIZ
+//
+#define DWUSB_GHWCFG3_XFER_SIZE_WIDTH(X)    (((X) & 0xF) + 11)
+#define DWUSB_GHWCFG3_PKT_COUNT_WIDTH(X)    ((((X) >> 4) & 0x7) + 4)
+
+//
+// FIFO sizes, in 32bits words
+//
+#define DWUSB_FIFO_DEPTH(Start, Depth)      (((Depth) << 16) | (Start))
+
+//
+// HCFG
+//
+#define DWUSB_HCFG_FSLSPCLKSEL_30_60MHZ     0
+#define DWUSB_HCFG_FSLSPCLKSEL_MASK         (BIT1 | BIT0)
+#define DWUSB_HCFG_FSLSSUPP                 BIT2
+
+//
+// HFNUM
+//
+#define DWUSB_HFNUM_FRNUM(X)                ((X) & 0xFFFF)
+
+//
+// HPRT
+//
+#define DWUSB_HPRT_CONN_STS                 BIT0
+#define DWUSB_HPRT_CONN_DET                 BIT1
+#define DWUSB_HPRT_ENA                      BIT2
+#define DWUSB_HPRT_ENA_CHNG                 BIT3
+#define DWUSB_HPRT_OVRCURR_ACT              BIT4
+#define DWUSB_HPRT_OVRCURR_CHNG             BIT5
+#define DWUSB_HPRT_RES                      BIT6
+#define DWUSB_HPRT_SUSP                     BIT7
+#define DWUSB_HPRT_RST                      BIT8
+#define DWUSB_HPRT_PWR                      BIT12
+#define DWUSB_HPRT_SPD(X)                   (((X) >> 17) & 0x3)
+#define DWUSB_HPRT_SPD_HIGH                 0
+#define DWUSB_HPRT_SPD_FULL                 1
+#define DWUSB_HPRT_SPD_LOW                  2
+// Write 1 to clear bits, masked out of read-modify-writes. Writing 1 to ENA
+// disables the port
+#define DWUSB_HPRT_W1C_MASK                 (DWUSB_HPRT_CONN_DET | DWUSB_HPRT_ENA | \
+                                             DWUSB_HPRT_ENA_CHNG | DWUSB_HPRT_OVRCURR_CHNG)
+
+//
+// HCCHAR
+//
+#define DWUSB_HCCHAR_MPS(X)                 ((X) & 0x7FF)
+#define DWUSB_HCCHAR_EPNUM(X)               (((X) & 0xF) << 11)
+#define DWUSB_HCCHAR_EPDIR_IN               BIT15
+#define DWUSB_HCCHAR_LSPDDEV                BIT17
+#define DWUSB_HCCHAR_EPTYPE(X)              (((X) & 0x3) << 18)
+#define DWUSB_HCCHAR_MC(X)                  (((X) & 0x3) << 20)
+#define DWUSB_HCCHAR_DEVADDR(X)             (((X) & 0x7F) << 22)
+#define DWUSB_HCCHAR_ODDFRM                 BIT29
+#define DWUSB_HCCHAR_CHDIS                  BIT30
+#define DWUSB_HCCHAR_CHENA                  BIT31
+
+#define DWUSB_EPTYPE_CONTROL                0
+#define DWUSB_EPTYPE_ISOCHRONOUS            1
+#define DWUSB_EPTYPE_BULK                   2
+#define DWUSB_EPTYPE_INTERRUPT              3
+
+//
+// HCSPLT
+//
+#define DWUSB_HCSPLT_PRTADDR(X)             ((X) & 0x7F)
+#define DWUSB_HCSPLT_HUBADDR(X)             (((X) & 0x7F) << 7)
+#define DWUSB_HCSPLT_XACTPOS_ALL            (3 << 14)
+#define DWUSB_HCSPLT_COMPSPLT               BIT16
+#define DWUSB_HCSPLT_SPLTENA                BIT31
+
+//
+// HCINT
+//
+#define DWUSB_HCINT_XFERCOMPL               BIT0
+#define DWUSB_HCINT_CHHLTD                  BIT1
+#define DWUSB_HCINT_AHBERR                  BIT2
+#define DWUSB_HCINT_STALL                   BIT3
+#define DWUSB_HCINT_NAK                     BIT4
+#define DWUSB_HCINT_ACK                     BIT5
+#define DWUSB_HCINT_NYET                    BIT6
+#define DWUSB_HCINT_XACTERR                 BIT7
+#define DWUSB_HCINT_BBLERR                  BIT8
+#define DWUSB_HCINT_FRMOVRUN                BIT9
+#define DWUSB_HCINT_DATATGLERR              BIT10
+#define DWUSB_HCINT_ALL                     0x7FF
+
+//
+// HCTSIZ
+//
+#define DWUSB_HCTSIZ_XFERSIZE(X)            ((X) & 0x7FFFF)
+#define DWUSB_HCTSIZ_PKTCNT(X)              (((X) & 0x3FF) << 19)
+#define DWUSB_HCTSIZ_PID(X)                 (((X) & 0x3) << 29)
+#define DWUSB_HCTSIZ_DOPNG                  BIT31
+#define DWUSB_HCTSIZ_GET_XFERSIZE(X)        ((X) & 0x7FFFF)
+#define DWUSB_HCTSIZ_GET_PKTCNT(X)          (((X) >> 19) & 0x3FF)
+#define DWUSB_HCTSIZ_GET_PID(X)             (((X) >> 29) & 0x3)
+
+#define DWUSB_PID_DATA0                     0
+#define DWUSB_PID_DATA2                     1
+#define DWUSB_PID_DATA1                     2
+#define DWUSB_PID_SETUP                     3
+
+#endif // __BCM2836USB_H__
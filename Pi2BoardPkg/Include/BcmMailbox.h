@@ -34,5 +34,71 @@ EFI_STATUS MailboxProperty(
     MAILBOX_HEADER *pMbProperty
     );
 
+//
+// Property batches pack several tags into a single mailbox transaction:
+//
+//   MailboxBatchBegin(&Batch);
+//   MailboxBatchAddTag(&Batch, TAG_GET_ARM_MEMORY, NULL, 0, 8, &ArmTag);
+//   MailboxBatchAddTag(&Batch, TAG_GET_VC_MEMORY, NULL, 0, 8, &VcTag);
+//   Status = MailboxBatchSubmit(&Batch, MAILBOX_CHANNEL_PROPERTY_ARM_VC);
+//   MailboxBatchGetTag(&Batch, ArmTag, &ArmMemory, sizeof(ArmMemory), NULL);
+//   MailboxBatchGetTag(&Batch, VcTag, &VcMemory, sizeof(VcMemory), NULL);
+//   MailboxBatchEnd(&Batch);
+//
+// Every batch owns one buffer of the library buffer pool from Begin to End,
+// so batches can be built concurrently from different TPLs.
+//
+
+#define MAILBOX_BUFFER_COUNT            4
+#define MAILBOX_BUFFER_SIZE             1024
+
+// Request/response code of the buffer and of the tags
+#define MAILBOX_PROCESS_REQUEST         0x00000000
+#define MAILBOX_REQUEST_SUCCESS         0x80000000
+#define MAILBOX_REQUEST_ERROR           0x80000001
+#define MAILBOX_TAG_RESPONSE            0x80000000
+#define MAILBOX_TAG_LENGTH_MASK         0x7FFFFFFF
+#define MAILBOX_END_TAG                 0x00000000
+
+typedef UINT32 MAILBOX_TAG_HANDLE;
+
+typedef struct _MAILBOX_BATCH {
+    UINT32      *Buffer;
+    UINT32      PoolIndex;
+    UINT32      Size;           // Bytes used in Buffer, end tag excluded
+    BOOLEAN     Submitted;
+    EFI_STATUS  Status;         // First error of MailboxBatchAddTag, reported by Submit
+} MAILBOX_BATCH, *PMAILBOX_BATCH;
+
+EFI_STATUS MailboxBatchBegin(
+    OUT MAILBOX_BATCH *Batch
+    );
+
+EFI_STATUS MailboxBatchAddTag(
+    IN OUT MAILBOX_BATCH *Batch,
+    IN UINT32 TagId,
+    IN CONST VOID *Request OPTIONAL,
+    IN UINT32 RequestSize,
+    IN UINT32 ValueBufferSize,
+    OUT MAILBOX_TAG_HANDLE *TagHandle OPTIONAL
+    );
+
+EFI_STATUS MailboxBatchSubmit(
+    IN OUT MAILBOX_BATCH *Batch,
+    IN UINT32 Channel
+    );
+
+EFI_STATUS MailboxBatchGetTag(
+    IN MAILBOX_BATCH *Batch,
+    IN MAILBOX_TAG_HANDLE TagHandle,
+    OUT VOID *Response,
+    IN UINT32 ResponseSize,
+    OUT UINT32 *ResponseLength OPTIONAL
+    );
+
+VOID MailboxBatchEnd(
+    IN OUT MAILBOX_BATCH *Batch
+    );
+
 #endif // __BCMMAILBOXLIB_H__
 
@@ -0,0 +1,43 @@
+/** @file
+*
+*  Performance record BootPerformanceDxe appends to the Firmware Basic Boot
+*  Performance Table of the ACPI FPDT, one per measurement of the PERF_START()
+*  and PERF_END() macros of PrePi and the DXE phase. The record type is in the
+*  range ACPI reserves for the platform firmware vendor.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __BOOT_PERFORMANCE_RECORD_H__
+#define __BOOT_PERFORMANCE_RECORD_H__
+
+#include <IndustryStandard/Acpi.h>
+#include <Guid/Performance.h>
+
+#define BOOT_PERFORMANCE_GAUGE_RECORD_TYPE        0x1100
+#define BOOT_PERFORMANCE_GAUGE_RECORD_REVISION    1
+
+#pragma pack(1)
+
+typedef struct {
+    EFI_ACPI_5_0_FPDT_PERFORMANCE_RECORD_HEADER Header;
+    UINT32      Identifier;     // Identifier of the measurement, 0 for most of them
+    UINT64      StartTime;      // Nanoseconds since the reset
+    UINT64      EndTime;        // Nanoseconds since the reset, 0 if the measurement didn't end
+    EFI_GUID    FileGuid;       // File of the image the measurement belongs to, zeros if none
+    CHAR8       Token[DXE_PERFORMANCE_STRING_SIZE];
+    CHAR8       Module[DXE_PERFORMANCE_STRING_SIZE];
+} BOOT_PERFORMANCE_GAUGE_RECORD;
+
+#pragma pack()
+
+#endif // __BOOT_PERFORMANCE_RECORD_H__
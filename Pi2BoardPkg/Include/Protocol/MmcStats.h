@@ -0,0 +1,129 @@
+/** @file
+*
+*  I/O statistics published by MmcDxe on every MMC/SD block device handle,
+*  next to its BlockIo and BlockIo2 protocols.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __MMC_STATS_H__
+#define __MMC_STATS_H__
+
+#define MMC_STATS_PROTOCOL_GUID \
+  { 0x5d0a8c1e, 0x3b7f, 0x4e52, { 0x9a, 0x61, 0x27, 0xc4, 0x0e, 0x83, 0xd5, 0x19 } }
+
+#define MMC_STATS_PROTOCOL_REVISION     0x00010000
+
+typedef struct _MMC_STATS_PROTOCOL MMC_STATS_PROTOCOL;
+
+//
+// Latency histogram buckets. Bucket 0 counts the requests that took less than
+// 1us and bucket n > 0 the ones that took [2^(n-1), 2^n) us, the last bucket
+// also holds everything slower
+//
+#define MMC_STATS_LATENCY_BUCKETS       24
+
+typedef struct {
+  UINT64  Requests;
+  UINT64  Errors;
+  UINT64  Blocks;
+  UINT64  TotalTimeUs;
+  UINT64  MaxTimeUs;
+  UINT64  Latency[MMC_STATS_LATENCY_BUCKETS];
+} MMC_STATS_IO;
+
+typedef struct {
+  UINT64  ReadHits;     // In lines
+  UINT64  ReadMisses;
+  UINT64  ReadAheadLines;
+  UINT64  WriteHits;
+  UINT64  WriteMisses;
+  UINT64  FlushedLines;
+  UINT64  FlushWrites;  // Multiple block writes used to flush the lines
+  UINT64  Evictions;
+  UINT64  Bypasses;     // Requests that went straight to the card
+} MMC_CACHE_STATS;
+
+//
+// Read and Write count the requests as MmcDxe hands them to its cache, a
+// non-blocking BlockIo2 request is counted once per slice it is split into
+//
+typedef struct {
+  UINT32            BlockSize;
+  BOOLEAN           CacheEnabled;
+  MMC_STATS_IO      Read;
+  MMC_STATS_IO      Write;
+  MMC_STATS_IO      Flush;
+  MMC_CACHE_STATS   Cache;
+} MMC_STATS;
+
+/**
+  Returns a snapshot of the statistics collected since the device was started
+  or since the last ResetStats() call.
+
+  @param  This              Protocol instance
+  @param  Stats             Receives the statistics
+
+  @retval EFI_SUCCESS       Stats was filled
+  @retval EFI_INVALID_PARAMETER Stats is NULL
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_STATS_GET)(
+  IN  MMC_STATS_PROTOCOL  *This,
+  OUT MMC_STATS           *Stats
+  );
+
+/**
+  Clears every counter, including the cache ones.
+
+  @param  This              Protocol instance
+
+  @retval EFI_SUCCESS       The counters are cleared
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_STATS_RESET)(
+  IN  MMC_STATS_PROTOCOL  *This
+  );
+
+/**
+  Turns the sector cache on or off, so the card itself can be measured. The
+  dirty lines are written back before the cache is turned off and the cache
+  starts empty when it is turned back on.
+
+  @param  This              Protocol instance
+  @param  Enable            TRUE to turn the cache on
+  @param  WasEnabled        Optionally receives the previous state
+
+  @retval EFI_SUCCESS       The cache is in the requested state
+  @retval EFI_UNSUPPORTED   The driver was built or started without a cache
+  @retval Others            Writing back the dirty lines failed, the cache is left on
+**/
+typedef
+EFI_STATUS
+(EFIAPI *MMC_STATS_SET_CACHE)(
+  IN  MMC_STATS_PROTOCOL  *This,
+  IN  BOOLEAN             Enable,
+  OUT BOOLEAN             *WasEnabled OPTIONAL
+  );
+
+struct _MMC_STATS_PROTOCOL {
+  UINT64                Revision;
+  MMC_STATS_GET         GetStats;
+  MMC_STATS_RESET       ResetStats;
+  MMC_STATS_SET_CACHE   SetCacheEnabled;
+};
+
+extern EFI_GUID gMmcStatsProtocolGuid;
+
+#endif // __MMC_STATS_H__
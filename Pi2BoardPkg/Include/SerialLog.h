@@ -0,0 +1,55 @@
+/** @file
+*
+*  The serial log is a ring of debug output kept at PcdSerialLogBase, outside
+*  of the memory given to UEFI. ArmPlatformInitialize() starts a new one on
+*  every boot; the serial port library of the DXE modules then appends to it
+*  and the drain driver sends it to the UART from the UART interrupt. In
+*  memory-only mode the output stays in the ring until it is dumped.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __SERIAL_LOG_H__
+#define __SERIAL_LOG_H__
+
+#include <Library/SynchronizationLib.h>
+
+#define SERIAL_LOG_SIGNATURE    SIGNATURE_32('S', 'L', 'O', 'G')
+
+// The output goes to the UART, through the ring while it is drained
+#define SERIAL_LOG_MODE_BUFFERED    0
+// The output stays in the ring, the oldest bytes are overwritten
+#define SERIAL_LOG_MODE_MEMORY      1
+
+//
+// Head and Tail are offsets in the data that follows the header, the ring is
+// empty when they are equal. All the fields but Signature, Mode and Size are
+// only changed while holding Lock with the interrupts disabled.
+//
+typedef struct {
+    UINT32              Signature;
+    UINT32              Mode;
+    UINT32              Size;       // Bytes of data after the header
+    volatile UINT32     Draining;   // TRUE while the drain driver owns the UART
+    volatile UINT32     Head;       // Next byte written
+    volatile UINT32     Tail;       // Next byte sent, or oldest byte kept
+    volatile UINT32     Lost;       // Bytes overwritten in memory-only mode
+    SPIN_LOCK           Lock;
+} SERIAL_LOG;
+
+#define SERIAL_LOG_DATA(Log)    ((UINT8*)((SERIAL_LOG*)(Log) + 1))
+
+#define SERIAL_LOG_USED(Log) \
+    (((Log)->Head >= (Log)->Tail) ? \
+        ((Log)->Head - (Log)->Tail) : ((Log)->Size - (Log)->Tail + (Log)->Head))
+
+#endif // __SERIAL_LOG_H__
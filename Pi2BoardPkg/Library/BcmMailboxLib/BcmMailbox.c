@@ -13,10 +13,11 @@
 **/
 
 #include <Base.h>
+#include <Library/BaseLib.h>
 #include <Library/DebugLib.h>
 #include <Library/IoLib.h>
 #include <Bcm2836.h>
-#include <Bcm2836Mailbox.h>
+#include <BcmMailbox.h>
 #include <Library/CacheMaintenanceLib.h>
 #include <Library/BaseMemoryLib.h>
 
@@ -83,28 +84,104 @@ BOOLEAN BcmMailboxWrite(
     return TRUE;
 }
 
+//
+// Cannot allocate memory from the heap because memory allocation
+// services may not be available yet, for example when this is
+// called by SerialPortInitialize() early in SEC phase.
+// This memory must be cache-size aligned, which on Pi is 64 bytes.
+// It is static because stack size is limited. Each transaction owns
+// one buffer of the pool, so a caller interrupted in the middle of a
+// batch does not stop another one from talking to the firmware.
+//
+static UINT8 mMailboxBuffers[MAILBOX_BUFFER_COUNT][MAILBOX_BUFFER_SIZE] __attribute__((aligned(64)));
+static volatile BOOLEAN mMailboxBufferBusy[MAILBOX_BUFFER_COUNT];
+
+/**
+  Claims a free buffer of the pool, returns MAILBOX_BUFFER_COUNT if they are all in use.
+  Only the boot CPU runs UEFI, so masking interrupts is enough to make the claim atomic.
+**/
+static
+UINT32
+MailboxAcquireBuffer(
+    VOID
+    )
+{
+    BOOLEAN InterruptState;
+    UINT32 Index;
+
+    InterruptState = SaveAndDisableInterrupts();
+    for (Index = 0; Index < MAILBOX_BUFFER_COUNT; ++Index)
+    {
+        if (!mMailboxBufferBusy[Index])
+        {
+            mMailboxBufferBusy[Index] = TRUE;
+            break;
+        }
+    }
+    SetInterruptState(InterruptState);
+
+    return Index;
+}
+
+static
+VOID
+MailboxReleaseBuffer(
+    IN UINT32 Index
+    )
+{
+    ASSERT(Index < MAILBOX_BUFFER_COUNT);
+    mMailboxBufferBusy[Index] = FALSE;
+}
+
+/**
+  Hands Buffer to the firmware and waits for its response. Interrupts are masked
+  for the round trip because responses are only matched by channel.
+**/
+static
 EFI_STATUS
-MailboxProperty(
+MailboxTransact(
     IN UINT32 Channel,
-    MAILBOX_HEADER *pMbProperty
+    IN OUT VOID *Buffer,
+    IN UINT32 BufferSize
     )
 {
+    EFI_STATUS Status = EFI_SUCCESS;
+    BOOLEAN InterruptState;
     UINT32 MBStatus = 0;
     UINT32 MBData;
-    UINT32 BufferSize;
 
-    //
-    // Cannot allocate memory from the heap because memory allocation
-    // services may not be available yet, for example when this is
-    // called by SerialPortInitialize() early in SEC phase.
-    // This memory must be cache-size aligned, which on Pi is 64 bytes.
-    // This is static because stack size is limited and the mailbox
-    // is non-reentrant.
-    //
-    static UINT8 SharedMem[2048] __attribute__((aligned(64)));
+    WriteBackInvalidateDataCacheRange(Buffer, BufferSize);
+    MBData = ((UINT32)Buffer) | UNCACHED_ADDRESS_MASK;
+
+    InterruptState = SaveAndDisableInterrupts();
+    if (!BcmMailboxWrite(Channel, MBData))
+    {
+        Status = EFI_DEVICE_ERROR;
+    }
+    // Wait for the completion on the ARM to GPU channel
+    else if (!BcmMailboxRead(Channel, &MBStatus))
+    {
+        Status = EFI_DEVICE_ERROR;
+    }
+    SetInterruptState(InterruptState);
+
+    InvalidateDataCacheRange(Buffer, BufferSize);
+
+    return Status;
+}
+
+EFI_STATUS
+MailboxProperty(
+    IN UINT32 Channel,
+    MAILBOX_HEADER *pMbProperty
+    )
+{
+    EFI_STATUS Status;
+    UINT32 BufferSize;
+    UINT32 PoolIndex;
 
     BufferSize = pMbProperty->BufferSize;
-    if (BufferSize > sizeof(SharedMem))
+    if (BufferSize > MAILBOX_BUFFER_SIZE)
     {
         //
         // Cannot debug print here as serial port may not be initialized yet
@@ -112,23 +189,217 @@ MailboxProperty(
         return EFI_OUT_OF_RESOURCES;
     }
 
-    CopyMem(SharedMem, pMbProperty, BufferSize);
-    WriteBackInvalidateDataCacheRange(SharedMem, BufferSize);
-    MBData = ((UINT32)SharedMem) | UNCACHED_ADDRESS_MASK;
+    PoolIndex = MailboxAcquireBuffer();
+    if (PoolIndex == MAILBOX_BUFFER_COUNT)
+    {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    CopyMem(mMailboxBuffers[PoolIndex], pMbProperty, BufferSize);
+
+    Status = MailboxTransact(Channel, mMailboxBuffers[PoolIndex], BufferSize);
+    if (!EFI_ERROR(Status))
+    {
+        CopyMem(pMbProperty, mMailboxBuffers[PoolIndex], BufferSize);
+    }
+
+    MailboxReleaseBuffer(PoolIndex);
+
+    return Status;
+}
+
+EFI_STATUS
+MailboxBatchBegin(
+    OUT MAILBOX_BATCH *Batch
+    )
+{
+    if (Batch == NULL)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
 
-    if(!BcmMailboxWrite(Channel, MBData))
+    Batch->PoolIndex = MailboxAcquireBuffer();
+    if (Batch->PoolIndex == MAILBOX_BUFFER_COUNT)
     {
+        Batch->Buffer = NULL;
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Batch->Buffer = (UINT32*)mMailboxBuffers[Batch->PoolIndex];
+    Batch->Buffer[0] = 0;
+    Batch->Buffer[1] = MAILBOX_PROCESS_REQUEST;
+    Batch->Size = 2 * sizeof(UINT32);
+    Batch->Submitted = FALSE;
+    Batch->Status = EFI_SUCCESS;
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Appends a tag to the batch. ValueBufferSize is the size of the tag value buffer,
+  which must be large enough for both the request and the response. The returned
+  handle is passed to MailboxBatchGetTag() once the batch is submitted.
+**/
+EFI_STATUS
+MailboxBatchAddTag(
+    IN OUT MAILBOX_BATCH *Batch,
+    IN UINT32 TagId,
+    IN CONST VOID *Request OPTIONAL,
+    IN UINT32 RequestSize,
+    IN UINT32 ValueBufferSize,
+    OUT MAILBOX_TAG_HANDLE *TagHandle OPTIONAL
+    )
+{
+    UINT32 *Tag;
+    UINT32 TagSize;
+
+    if ((Batch == NULL) || (Batch->Buffer == NULL) || Batch->Submitted)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (EFI_ERROR(Batch->Status))
+    {
+        return Batch->Status;
+    }
+
+    if ((RequestSize > ValueBufferSize) || ((Request == NULL) && (RequestSize != 0)))
+    {
+        Batch->Status = EFI_INVALID_PARAMETER;
+        return Batch->Status;
+    }
+
+    // Tag identifier, value buffer size and request/response code, then the
+    // value buffer padded to 32 bits. The end tag must still fit afterwards
+    ValueBufferSize = ALIGN_VALUE(ValueBufferSize, sizeof(UINT32));
+    TagSize = 3 * sizeof(UINT32) + ValueBufferSize;
+    if (Batch->Size + TagSize + sizeof(UINT32) > MAILBOX_BUFFER_SIZE)
+    {
+        Batch->Status = EFI_BUFFER_TOO_SMALL;
+        return Batch->Status;
+    }
+
+    Tag = Batch->Buffer + (Batch->Size / sizeof(UINT32));
+    Tag[0] = TagId;
+    Tag[1] = ValueBufferSize;
+    Tag[2] = MAILBOX_PROCESS_REQUEST;
+    ZeroMem(&Tag[3], ValueBufferSize);
+    if (RequestSize != 0)
+    {
+        CopyMem(&Tag[3], Request, RequestSize);
+    }
+
+    if (TagHandle != NULL)
+    {
+        *TagHandle = Batch->Size;
+    }
+    Batch->Size += TagSize;
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Terminates the batch and sends all its tags to the firmware in one transaction.
+  Fails if any tag could not be added or if the firmware rejects the buffer.
+**/
+EFI_STATUS
+MailboxBatchSubmit(
+    IN OUT MAILBOX_BATCH *Batch,
+    IN UINT32 Channel
+    )
+{
+    EFI_STATUS Status;
+    UINT32 BufferSize;
+
+    if ((Batch == NULL) || (Batch->Buffer == NULL) || Batch->Submitted)
+    {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (EFI_ERROR(Batch->Status))
+    {
+        return Batch->Status;
+    }
+
+    Batch->Buffer[Batch->Size / sizeof(UINT32)] = MAILBOX_END_TAG;
+    BufferSize = Batch->Size + sizeof(UINT32);
+    Batch->Buffer[0] = BufferSize;
+    Batch->Buffer[1] = MAILBOX_PROCESS_REQUEST;
+
+    Status = MailboxTransact(Channel, Batch->Buffer, BufferSize);
+    if (EFI_ERROR(Status))
+    {
+        return Status;
+    }
+
+    Batch->Submitted = TRUE;
+
+    if (Batch->Buffer[1] != MAILBOX_REQUEST_SUCCESS)
+    {
+        DEBUG((DEBUG_ERROR, "MailboxBatchSubmit: Firmware returned 0x%08X\n", Batch->Buffer[1]));
         return EFI_DEVICE_ERROR;
     }
 
-    // Wait for the completion on the ARM to GPU channel
-    if(!BcmMailboxRead(Channel, &MBStatus))
+    return EFI_SUCCESS;
+}
+
+/**
+  Copies the response of a submitted tag, at most ResponseSize bytes of it.
+  ResponseLength receives the length reported by the firmware, which can be
+  larger than the value buffer when the tag had more to return.
+**/
+EFI_STATUS
+MailboxBatchGetTag(
+    IN MAILBOX_BATCH *Batch,
+    IN MAILBOX_TAG_HANDLE TagHandle,
+    OUT VOID *Response,
+    IN UINT32 ResponseSize,
+    OUT UINT32 *ResponseLength OPTIONAL
+    )
+{
+    UINT32 *Tag;
+    UINT32 Length;
+
+    if ((Batch == NULL) || (Batch->Buffer == NULL) ||
+        (TagHandle < 2 * sizeof(UINT32)) || (TagHandle >= Batch->Size) ||
+        ((Response == NULL) && (ResponseSize != 0)))
     {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (!Batch->Submitted)
+    {
+        return EFI_NOT_READY;
+    }
+
+    Tag = Batch->Buffer + (TagHandle / sizeof(UINT32));
+    if ((Tag[2] & MAILBOX_TAG_RESPONSE) == 0)
+    {
+        // The firmware did not process this tag
         return EFI_DEVICE_ERROR;
     }
 
-    InvalidateDataCacheRange(SharedMem, BufferSize);
-    CopyMem(pMbProperty, SharedMem, BufferSize);
+    Length = Tag[2] & MAILBOX_TAG_LENGTH_MASK;
+    if (ResponseLength != NULL)
+    {
+        *ResponseLength = Length;
+    }
+
+    CopyMem(Response, &Tag[3], MIN(ResponseSize, MIN(Length, Tag[1])));
 
     return EFI_SUCCESS;
 }
+
+VOID
+MailboxBatchEnd(
+    IN OUT MAILBOX_BATCH *Batch
+    )
+{
+    if ((Batch == NULL) || (Batch->Buffer == NULL))
+    {
+        return;
+    }
+
+    MailboxReleaseBuffer(Batch->PoolIndex);
+    Batch->Buffer = NULL;
+}
@@ -24,6 +24,7 @@
 #include <Bcm2836.h>
 #include <Pi2Board.h>
 #include <BcmMailbox.h>
+#include <SerialLog.h>
 
 //
 // We'll use Mailbox 3 for this since the Pi2 boot firmware already uses it
@@ -239,6 +240,18 @@ ArmPlatformInitialize(
                 }
             }
         }
+
+        // Start the serial log of this boot, the DXE modules write to it
+        if (FixedPcdGet32(PcdSerialLogSize) > sizeof(SERIAL_LOG)) {
+            SERIAL_LOG *Log = (SERIAL_LOG*)(UINTN)FixedPcdGet32(PcdSerialLogBase);
+
+            ZeroMem(Log, sizeof(*Log));
+            Log->Mode = FixedPcdGetBool(PcdSerialLogMemoryOnly) ?
+                SERIAL_LOG_MODE_MEMORY : SERIAL_LOG_MODE_BUFFERED;
+            Log->Size = FixedPcdGet32(PcdSerialLogSize) - sizeof(SERIAL_LOG);
+            InitializeSpinLock(&Log->Lock);
+            Log->Signature = SERIAL_LOG_SIGNATURE;
+        }
     }
 
     return RETURN_SUCCESS;
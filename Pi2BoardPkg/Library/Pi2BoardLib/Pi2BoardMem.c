@@ -25,8 +25,6 @@
 
 #define MAX_VIRTUAL_MEMORY_MAP_DESCRIPTORS  6
 
-volatile MAILBOX_GET_MEMORY MbGetMemory __attribute__((aligned(16)));
-
 /**
   Return the Virtual Memory Map of your platform
 
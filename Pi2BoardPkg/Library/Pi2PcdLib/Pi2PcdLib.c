@@ -34,8 +34,6 @@ PCD_DYNAMIC_VALUE DynamicPCDValue[] =
     { PcdToken(PcdGpuMemorySize), 0, 0 },
 };
 
-extern MAILBOX_GET_MEMORY MbGetMemory;
-
 PCD_DYNAMIC_VALUE* GetDynamicPCD (
     IN UINTN             TokenNumber
     )
@@ -51,6 +49,50 @@ PCD_DYNAMIC_VALUE* GetDynamicPCD (
     return NULL;
 }
 
+/**
+  Queries the ARM and VC memory sizes from the VC firmware in a single
+  mailbox transaction and sets both dynamic PCDs.
+**/
+VOID
+QueryMemorySizes (
+    VOID
+    )
+{
+    EFI_STATUS Status;
+    MAILBOX_BATCH Batch;
+    MAILBOX_TAG_HANDLE ArmMemoryTag;
+    MAILBOX_TAG_HANDLE VcMemoryTag;
+    UINT32 ArmMemory[2];
+    UINT32 VcMemory[2];
+
+    Status = MailboxBatchBegin(&Batch);
+    if (Status == EFI_SUCCESS) {
+        MailboxBatchAddTag(&Batch, TAG_GET_ARM_MEMORY, NULL, 0, sizeof(ArmMemory), &ArmMemoryTag);
+        MailboxBatchAddTag(&Batch, TAG_GET_VC_MEMORY, NULL, 0, sizeof(VcMemory), &VcMemoryTag);
+
+        Status = MailboxBatchSubmit(&Batch, MAILBOX_CHANNEL_PROPERTY_ARM_VC);
+        if (Status == EFI_SUCCESS) {
+            Status = MailboxBatchGetTag(&Batch, ArmMemoryTag, ArmMemory, sizeof(ArmMemory), NULL);
+        }
+        if (Status == EFI_SUCCESS) {
+            Status = MailboxBatchGetTag(&Batch, VcMemoryTag, VcMemory, sizeof(VcMemory), NULL);
+        }
+
+        MailboxBatchEnd(&Batch);
+    }
+
+    if (Status == EFI_SUCCESS) {
+        // Base address is followed by the size in both responses
+        PcdSet64(PcdSystemMemorySize, (ArmMemory[1] - FixedPcdGet64(PcdSystemMemoryBase)));
+        PcdSet64(PcdGpuMemorySize, VcMemory[1]);
+    } else {
+        // Assert immediately because this means VC firmware has failed
+        ASSERT(FALSE);
+    }
+    DEBUG((DEBUG_VERBOSE, "QueryMemorySizes: PcdSystemMemorySize=0x%8.8X\n", PcdGet64(PcdSystemMemorySize)));
+    DEBUG((DEBUG_VERBOSE, "QueryMemorySizes: PcdGpuMemorySize=0x%8.8X\n", PcdGet64(PcdGpuMemorySize)));
+}
+
 /**
   This function retrieves a value for a dynamic token.
 
@@ -73,43 +115,10 @@ LibPcdGet64 (
     // Use lazy initialization to assign dynamic PCD values
     if (Pcd->Value == Pcd->DefaultValue) {
         switch (Pcd->TokenNumber) {
-        // Query ARM System Memory Size
+        // Both sizes come from the same mailbox transaction
         case PcdToken(PcdSystemMemorySize):
-            {
-                EFI_STATUS Status;
-                ZeroMem((void*)&MbGetMemory, sizeof(MbGetMemory));
-                MbGetMemory.Header.BufferSize = sizeof(MbGetMemory);
-                MbGetMemory.Header.TagID = TAG_GET_ARM_MEMORY;
-                MbGetMemory.Header.TagLength = 8;
-
-                Status = MailboxProperty(MAILBOX_CHANNEL_PROPERTY_ARM_VC, (MAILBOX_HEADER*)&MbGetMemory);
-                if (Status == EFI_SUCCESS) {
-                    PcdSet64(PcdSystemMemorySize, (MbGetMemory.Size - FixedPcdGet64(PcdSystemMemoryBase)));
-                } else {
-                    // Assert immediately because this means VC firmware has failed
-                    ASSERT(FALSE);
-                }
-                DEBUG((DEBUG_VERBOSE, "LibPcdGet64: PcdSystemMemorySize=0x%8.8X\n", PcdGet64(PcdSystemMemorySize)));
-            }
-            break;
-        // Query VC GPU Memory Size
         case PcdToken(PcdGpuMemorySize):
-            {
-                EFI_STATUS Status;
-                ZeroMem((void*)&MbGetMemory, sizeof(MbGetMemory));
-                MbGetMemory.Header.BufferSize = sizeof(MbGetMemory);
-                MbGetMemory.Header.TagID = TAG_GET_VC_MEMORY;
-                MbGetMemory.Header.TagLength = 8;
-
-                Status = MailboxProperty(MAILBOX_CHANNEL_PROPERTY_ARM_VC, (MAILBOX_HEADER*)&MbGetMemory);
-                if (Status == EFI_SUCCESS) {
-                    PcdSet64(PcdGpuMemorySize, MbGetMemory.Size);
-                } else {
-                    // Assert immediately because this means VC firmware has failed
-                    ASSERT(FALSE);
-                }
-                DEBUG((DEBUG_VERBOSE, "LibPcdGet64: PcdGpuMemorySize=0x%8.8X\n", PcdGet64(PcdGpuMemorySize)));
-            }
+            QueryMemorySizes();
             break;
         default:
             DEBUG((DEBUG_ERROR, "LibPcdGet64: PcdToken=0x%8.8X for DynamicPcd is not supported\n", Pcd->TokenNumber));
@@ -0,0 +1,196 @@
+/** @file
+*
+*  Shell application printing the serial log, see Pi2BoardPkg/Include/SerialLog.h.
+*  In memory-only mode that is the debug output of the boot so far.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#include <Protocol/EfiShellParameters.h>
+
+#include <SerialLog.h>
+
+// Characters printed per call to Print()
+#define DUMP_LINE_LENGTH    128
+
+typedef struct {
+    BOOLEAN     Clear;
+    BOOLEAN     Info;
+} DUMP_OPTIONS;
+
+STATIC
+VOID
+DumpPrintUsage(
+    VOID
+    )
+{
+    Print(L"Usage: SerialLogDump [options]\n");
+    Print(L"  -c    Empty the log once it is printed\n");
+    Print(L"  -i    Only print the state of the log\n");
+}
+
+STATIC
+EFI_STATUS
+DumpParseOptions(
+    IN  UINTN           Argc,
+    IN  CHAR16          **Argv,
+    OUT DUMP_OPTIONS    *Options
+    )
+{
+    UINTN Idx;
+
+    ZeroMem(Options, sizeof(*Options));
+
+    for (Idx = 1; Idx < Argc; ++Idx) {
+        if (StrCmp(Argv[Idx], L"-c") == 0) {
+            Options->Clear = TRUE;
+        } else if (StrCmp(Argv[Idx], L"-i") == 0) {
+            Options->Info = TRUE;
+        } else if ((StrCmp(Argv[Idx], L"-?") == 0) || (StrCmp(Argv[Idx], L"-h") == 0)) {
+            return EFI_ABORTED;
+        } else {
+            Print(L"SerialLogDump: Unknown option %s\n", Argv[Idx]);
+            return EFI_INVALID_PARAMETER;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+  Copies the content of the log, oldest byte first, and empties it if asked.
+  Printing goes through the serial port library which locks the log, so it
+  has to work on a copy.
+**/
+STATIC
+UINTN
+DumpSnapshot(
+    IN  SERIAL_LOG      *Log,
+    IN  BOOLEAN         Clear,
+    OUT UINT8           *Buffer,
+    OUT UINT32          *Lost
+    )
+{
+    UINT8 *Data = SERIAL_LOG_DATA(Log);
+    BOOLEAN InterruptState;
+    UINTN Used;
+    UINTN Chunk;
+
+    InterruptState = SaveAndDisableInterrupts();
+    AcquireSpinLock(&Log->Lock);
+
+    Used = SERIAL_LOG_USED(Log);
+    Chunk = MIN(Used, Log->Size - Log->Tail);
+    CopyMem(Buffer, Data + Log->Tail, Chunk);
+    CopyMem(Buffer + Chunk, Data, Used - Chunk);
+    *Lost = Log->Lost;
+
+    if (Clear) {
+        Log->Tail = Log->Head;
+        Log->Lost = 0;
+    }
+
+    ReleaseSpinLock(&Log->Lock);
+    SetInterruptState(InterruptState);
+
+    return Used;
+}
+
+EFI_STATUS
+EFIAPI
+SerialLogDumpMain(
+    IN EFI_HANDLE           ImageHandle,
+    IN EFI_SYSTEM_TABLE     *SystemTable
+    )
+{
+    EFI_STATUS Status;
+    EFI_SHELL_PARAMETERS_PROTOCOL *ShellParameters;
+    DUMP_OPTIONS Options;
+    SERIAL_LOG *Log;
+    UINT8 *Buffer;
+    UINTN Length;
+    UINTN Idx;
+    UINT32 Lost;
+    CHAR16 Line[DUMP_LINE_LENGTH + 1];
+    UINTN LineLength;
+
+    Status = gBS->HandleProtocol(ImageHandle, &gEfiShellParametersProtocolGuid, (VOID**)&ShellParameters);
+    if (EFI_ERROR(Status)) {
+        Print(L"SerialLogDump: Must be started from the UEFI Shell\n");
+        return Status;
+    }
+
+    Status = DumpParseOptions(ShellParameters->Argc, ShellParameters->Argv, &Options);
+    if (EFI_ERROR(Status)) {
+        DumpPrintUsage();
+        return (Status == EFI_ABORTED) ? EFI_SUCCESS : Status;
+    }
+
+    Log = (SERIAL_LOG*)(UINTN)FixedPcdGet32(PcdSerialLogBase);
+    if ((FixedPcdGet32(PcdSerialLogSize) <= sizeof(SERIAL_LOG)) ||
+        (Log->Signature != SERIAL_LOG_SIGNATURE)) {
+        Print(L"SerialLogDump: No serial log\n");
+        return EFI_NOT_FOUND;
+    }
+
+    Buffer = AllocatePool(Log->Size);
+    if (Buffer == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Length = DumpSnapshot(Log, Options.Clear, Buffer, &Lost);
+
+    if (!Options.Info) {
+        LineLength = 0;
+        for (Idx = 0; Idx < Length; ++Idx) {
+            // The debug output has "\n" or "\n\r" line endings
+            if (Buffer[Idx] == '\r') {
+                continue;
+            }
+            if (Buffer[Idx] == '\n') {
+                Line[LineLength++] = L'\r';
+            }
+            Line[LineLength++] = ((Buffer[Idx] < 0x80) && (Buffer[Idx] != 0)) ? Buffer[Idx] : L'.';
+
+            if ((Buffer[Idx] == '\n') || (LineLength >= DUMP_LINE_LENGTH - 1)) {
+                Line[LineLength] = L'\0';
+                Print(L"%s", Line);
+                LineLength = 0;
+            }
+        }
+        if (LineLength != 0) {
+            Line[LineLength] = L'\0';
+            Print(L"%s\n", Line);
+        }
+    }
+
+    Print(
+        L"SerialLogDump: %a log at 0x%08x, %d of %d bytes used, %d bytes lost\n",
+        (Log->Mode == SERIAL_LOG_MODE_MEMORY) ? "Memory-only" : "Buffered",
+        (UINTN)Log,
+        Length,
+        Log->Size,
+        Lost);
+
+    FreePool(Buffer);
+    return EFI_SUCCESS;
+}
@@ -0,0 +1,223 @@
+/** @file
+*
+*  Sends the serial log to the mini UART in the background, see
+*  Pi2BoardPkg/Include/SerialLog.h.
+*
+*  Once the driver owns the UART, the serial port library appends the debug
+*  output to the log and enables the transmit interrupt; the handler refills
+*  the transmit FIFO and disables the interrupt when the log is empty. If the
+*  interrupt can't be registered a timer event drains the log instead. At
+*  ExitBootServices the log is flushed and the library writes synchronously
+*  again.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoLib.h>
+#include <Library/PcdLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include <Protocol/HardwareInterrupt.h>
+
+#include <Bcm2836.h>
+#include <SerialLog.h>
+
+// Period of the timer draining the log when the interrupt is not available,
+// long enough to fill the 8 bytes FIFO at 921600 bauds (100ns units)
+#define SERIAL_LOG_DRAIN_PERIOD     (1 * 1000 * 10)
+
+STATIC SERIAL_LOG *mLog;
+STATIC EFI_HARDWARE_INTERRUPT_PROTOCOL *mInterrupt;
+STATIC EFI_EVENT mDrainEvent;
+STATIC EFI_EVENT mExitBootServicesEvent;
+
+/**
+  Refills the transmit FIFO from the log, and disables the transmit interrupt
+  once the log is empty. Called with the log locked.
+**/
+STATIC
+VOID
+SerialLogDrain(
+    VOID
+    )
+{
+    UINT8 *Data = SERIAL_LOG_DATA(mLog);
+    UINT32 Tail = mLog->Tail;
+
+    while ((Tail != mLog->Head) &&
+           ((MmioRead32(AUX_MU_STAT_REG) & AUX_MU_STAT_TX_SPACE) != 0)) {
+        MmioWrite32(AUX_MU_IO_REG, Data[Tail]);
+        if (++Tail == mLog->Size) {
+            Tail = 0;
+        }
+    }
+    mLog->Tail = Tail;
+
+    if (Tail == mLog->Head) {
+        MmioWrite32(AUX_MU_IER_REG, AUX_MU_IER_ENABLE);
+    }
+}
+
+/**
+  The interrupt is shared with the SPI masters, which have no UEFI driver
+**/
+VOID
+EFIAPI
+SerialLogInterruptHandler(
+    IN HARDWARE_INTERRUPT_SOURCE    Source,
+    IN EFI_SYSTEM_CONTEXT           SystemContext
+    )
+{
+    AcquireSpinLock(&mLog->Lock);
+    SerialLogDrain();
+    ReleaseSpinLock(&mLog->Lock);
+
+    mInterrupt->EndOfInterrupt(mInterrupt, Source);
+}
+
+VOID
+EFIAPI
+SerialLogDrainTimer(
+    IN EFI_EVENT    Event,
+    IN VOID         *Context
+    )
+{
+    BOOLEAN InterruptState;
+
+    InterruptState = SaveAndDisableInterrupts();
+    AcquireSpinLock(&mLog->Lock);
+    SerialLogDrain();
+    ReleaseSpinLock(&mLog->Lock);
+    SetInterruptState(InterruptState);
+}
+
+/**
+  Hands the UART back to the serial port library. Everything still in the
+  log is written before the OS takes over.
+**/
+VOID
+EFIAPI
+SerialLogExitBootServices(
+    IN EFI_EVENT    Event,
+    IN VOID         *Context
+    )
+{
+    BOOLEAN InterruptState;
+
+    InterruptState = SaveAndDisableInterrupts();
+    AcquireSpinLock(&mLog->Lock);
+
+    mLog->Draining = FALSE;
+    MmioWrite32(AUX_MU_IER_REG, 0);
+    while (mLog->Tail != mLog->Head) {
+        SerialLogDrain();
+    }
+
+    ReleaseSpinLock(&mLog->Lock);
+    SetInterruptState(InterruptState);
+
+    if (mDrainEvent != NULL) {
+        gBS->CloseEvent(mDrainEvent);
+    }
+}
+
+EFI_STATUS
+EFIAPI
+SerialLogDxeInitialize(
+    IN EFI_HANDLE           ImageHandle,
+    IN EFI_SYSTEM_TABLE     *SystemTable
+    )
+{
+    EFI_STATUS Status;
+    BOOLEAN InterruptState;
+
+    mLog = (SERIAL_LOG*)(UINTN)FixedPcdGet32(PcdSerialLogBase);
+
+    if ((FixedPcdGet32(PcdSerialLogSize) <= sizeof(SERIAL_LOG)) ||
+        (mLog->Signature != SERIAL_LOG_SIGNATURE)) {
+        DEBUG((DEBUG_WARN, "SerialLogDxe: No serial log\n"));
+        return EFI_UNSUPPORTED;
+    }
+
+    // Nothing to send, the log is dumped on demand
+    if (mLog->Mode == SERIAL_LOG_MODE_MEMORY) {
+        DEBUG((
+            DEBUG_INFO,
+            "SerialLogDxe: Memory-only serial log at 0x%08x, %d bytes\n",
+            (UINTN)mLog,
+            mLog->Size));
+        return EFI_UNSUPPORTED;
+    }
+
+    Status = gBS->CreateEvent(
+        EVT_SIGNAL_EXIT_BOOT_SERVICES,
+        TPL_NOTIFY,
+        SerialLogExitBootServices,
+        NULL,
+        &mExitBootServicesEvent);
+    if (EFI_ERROR(Status)) {
+        return Status;
+    }
+
+    // The transmit interrupt is only enabled while the log isn't empty
+    MmioWrite32(AUX_MU_IER_REG, AUX_MU_IER_ENABLE);
+
+    Status = gBS->LocateProtocol(&gHardwareInterruptProtocolGuid, NULL, (VOID**)&mInterrupt);
+    if (!EFI_ERROR(Status)) {
+        Status = mInterrupt->RegisterInterruptSource(
+            mInterrupt,
+            INT_GPU_SOURCE(INT_GPU_IRQ_AUX),
+            SerialLogInterruptHandler);
+    }
+
+    if (EFI_ERROR(Status)) {
+        DEBUG((DEBUG_WARN, "SerialLogDxe: No UART interrupt (%r), draining the log from a timer\n", Status));
+
+        Status = gBS->CreateEvent(
+            EVT_TIMER | EVT_NOTIFY_SIGNAL,
+            TPL_NOTIFY,
+            SerialLogDrainTimer,
+            NULL,
+            &mDrainEvent);
+        if (!EFI_ERROR(Status)) {
+            Status = gBS->SetTimer(mDrainEvent, TimerPeriodic, SERIAL_LOG_DRAIN_PERIOD);
+        }
+        if (EFI_ERROR(Status)) {
+            DEBUG((DEBUG_ERROR, "SerialLogDxe: Failed to create the drain timer (%r)\n", Status));
+            if (mDrainEvent != NULL) {
+                gBS->CloseEvent(mDrainEvent);
+            }
+            gBS->CloseEvent(mExitBootServicesEvent);
+            return Status;
+        }
+    }
+
+    InterruptState = SaveAndDisableInterrupts();
+    AcquireSpinLock(&mLog->Lock);
+    mLog->Draining = TRUE;
+    ReleaseSpinLock(&mLog->Lock);
+    SetInterruptState(InterruptState);
+
+    DEBUG((
+        DEBUG_INIT,
+        "SerialLogDxe: Serial log at 0x%08x, %d bytes, drained by %a\n",
+        (UINTN)mLog,
+        mLog->Size,
+        (mDrainEvent != NULL) ? "timer" : "interrupt"));
+
+    return EFI_SUCCESS;
+}
@@ -25,6 +25,8 @@
 #include <Bcm2836.h>
 #include <BcmMailbox.h>
 
+#include "SerialPortLibInternal.h"
+
 
 /* Baud rate for 115,200 */
 /*
@@ -176,18 +178,16 @@ SerialPortInitialize (
 
 
 /**
-  Write data to serial device.
+  Write data to the mini UART, waiting for room in its FIFO.
 
   @param  Buffer           Point of data buffer which need to be written.
   @param  NumberOfBytes    Number of output bytes which are cached in Buffer.
 
-  @retval 0                Write data failed.
-  @retval !0               Actual number of bytes written to serial device.
+  @retval NumberOfBytes    All the bytes were written.
 
 **/
 UINTN
-EFIAPI
-SerialPortWrite (
+MiniUartWrite (
   IN UINT8     *Buffer,
   IN UINTN     NumberOfBytes
 )
@@ -198,7 +198,7 @@ SerialPortWrite (
     {
 
         /* Wait for space in the FIFO */
-        while ((MmioRead32(AUX_MU_STAT_REG) & 0x02) == 0)
+        while ((MmioRead32(AUX_MU_STAT_REG) & AUX_MU_STAT_TX_SPACE) == 0)
         {
         }
 
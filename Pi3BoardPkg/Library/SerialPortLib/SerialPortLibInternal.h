@@ -0,0 +1,35 @@
+/** @file
+*
+*  Serial I/O Port library internal definitions
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#ifndef __SERIAL_PORT_LIB_INTERNAL_H__
+#define __SERIAL_PORT_LIB_INTERNAL_H__
+
+/**
+  Write data to the mini UART, waiting for room in its FIFO.
+
+  @param  Buffer           Point of data buffer which need to be written.
+  @param  NumberOfBytes    Number of output bytes which are cached in Buffer.
+
+  @retval NumberOfBytes    All the bytes were written.
+
+**/
+UINTN
+MiniUartWrite (
+  IN UINT8     *Buffer,
+  IN UINTN     NumberOfBytes
+);
+
+#endif // __SERIAL_PORT_LIB_INTERNAL_H__
@@ -0,0 +1,185 @@
+/** @file
+*
+*  Serial port write of the library instance going through the serial log.
+*
+*  While the drain driver owns the UART, the data is appended to the log and
+*  the mini UART transmit interrupt is enabled; the driver sends it from the
+*  interrupt handler. Until then, with the interrupts disabled, for ASSERT()
+*  messages and when the log is full, the pending data and the new data are
+*  written synchronously instead. In memory-only mode the data is only
+*  appended to the log.
+*
+*  Copyright (c), Microsoft Corporation. All rights reserved.
+*
+*  This program and the accompanying materials
+*  are licensed and made available under the terms and conditions of the BSD License
+*  which accompanies this distribution.  The full text of the license may be found at
+*  http://opensource.org/licenses/bsd-license.php
+*
+*  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*
+**/
+
+#include <Base.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/IoLib.h>
+#include <Library/PcdLib.h>
+#include <Library/SerialPortLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Bcm2836.h>
+#include <SerialLog.h>
+
+#include "SerialPortLibInternal.h"
+
+// BaseDebugLibSerialPort writes a whole ASSERT() message with a single call
+#define ASSERT_PREFIX           "ASSERT "
+#define ASSERT_PREFIX_LENGTH    (sizeof(ASSERT_PREFIX) - 1)
+
+
+/**
+  Append data to the log, dropping its oldest bytes when it is full.
+
+  @param  Log              The serial log, locked.
+  @param  Buffer           Point of data buffer which need to be appended.
+  @param  NumberOfBytes    Number of bytes in Buffer.
+
+**/
+STATIC
+VOID
+SerialLogAppend (
+  IN SERIAL_LOG    *Log,
+  IN UINT8         *Buffer,
+  IN UINTN         NumberOfBytes
+)
+{
+    UINT8   *Data = SERIAL_LOG_DATA(Log);
+    UINTN   Capacity = Log->Size - 1;
+    UINTN   Used = SERIAL_LOG_USED(Log);
+    UINTN   Dropped;
+    UINTN   Chunk;
+    UINT32  Head;
+
+    if (NumberOfBytes > Capacity)
+    {
+        /* Only the end of the data fits */
+        Log->Lost += (UINT32)(Used + NumberOfBytes - Capacity);
+        Buffer += NumberOfBytes - Capacity;
+        NumberOfBytes = Capacity;
+        Log->Tail = Log->Head;
+    }
+    else if (NumberOfBytes > Capacity - Used)
+    {
+        Dropped = NumberOfBytes - (Capacity - Used);
+        Log->Lost += (UINT32)Dropped;
+        Log->Tail = (UINT32)((Log->Tail + Dropped) % Log->Size);
+    }
+
+    Head = Log->Head;
+    while (NumberOfBytes > 0)
+    {
+        Chunk = MIN(NumberOfBytes, Log->Size - Head);
+        CopyMem(Data + Head, Buffer, Chunk);
+
+        Buffer += Chunk;
+        NumberOfBytes -= Chunk;
+        Head += (UINT32)Chunk;
+        if (Head == Log->Size)
+        {
+            Head = 0;
+        }
+    }
+    Log->Head = Head;
+}
+
+
+/**
+  Write the data pending in the log to the mini UART.
+
+  @param  Log              The serial log, locked.
+
+**/
+STATIC
+VOID
+SerialLogFlush (
+  IN SERIAL_LOG    *Log
+)
+{
+    UINT8   *Data = SERIAL_LOG_DATA(Log);
+    UINT32  End;
+
+    while (Log->Tail != Log->Head)
+    {
+        End = (Log->Head > Log->Tail) ? Log->Head : Log->Size;
+        MiniUartWrite(Data + Log->Tail, End - Log->Tail);
+        Log->Tail = (End == Log->Size) ? 0 : End;
+    }
+}
+
+
+/**
+  Write data to serial device.
+
+  @param  Buffer           Point of data buffer which need to be written.
+  @param  NumberOfBytes    Number of output bytes which are cached in Buffer.
+
+  @retval 0                Write data failed.
+  @retval !0               Actual number of bytes written to serial device.
+
+**/
+UINTN
+EFIAPI
+SerialPortWrite (
+  IN UINT8     *Buffer,
+  IN UINTN     NumberOfBytes
+)
+{
+    SERIAL_LOG  *Log = (SERIAL_LOG*)(UINTN)FixedPcdGet32(PcdSerialLogBase);
+    BOOLEAN     InterruptState;
+    BOOLEAN     IsAssert;
+
+    if ((FixedPcdGet32(PcdSerialLogSize) <= sizeof(SERIAL_LOG)) ||
+        (Log->Signature != SERIAL_LOG_SIGNATURE) ||
+        (Log->Size != FixedPcdGet32(PcdSerialLogSize) - sizeof(SERIAL_LOG)))
+    {
+        return MiniUartWrite(Buffer, NumberOfBytes);
+    }
+
+    IsAssert = (NumberOfBytes > ASSERT_PREFIX_LENGTH) &&
+        (CompareMem(Buffer, ASSERT_PREFIX, ASSERT_PREFIX_LENGTH) == 0);
+
+    InterruptState = SaveAndDisableInterrupts();
+    AcquireSpinLock(&Log->Lock);
+
+    if (Log->Mode == SERIAL_LOG_MODE_MEMORY)
+    {
+        if (FixedPcdGetBool(PcdSerialLogMemoryOnly))
+        {
+            SerialLogAppend(Log, Buffer, NumberOfBytes);
+        }
+
+        if (!FixedPcdGetBool(PcdSerialLogMemoryOnly) || IsAssert)
+        {
+            MiniUartWrite(Buffer, NumberOfBytes);
+        }
+    }
+    else if (Log->Draining && InterruptState && !IsAssert &&
+             (NumberOfBytes <= Log->Size - 1 - SERIAL_LOG_USED(Log)))
+    {
+        SerialLogAppend(Log, Buffer, NumberOfBytes);
+
+        /* The drain driver disables it again once the log is empty */
+        MmioWrite32(AUX_MU_IER_REG, AUX_MU_IER_ENABLE | AUX_MU_IER_TX_INT);
+    }
+    else
+    {
+        SerialLogFlush(Log);
+        MiniUartWrite(Buffer, NumberOfBytes);
+    }
+
+    ReleaseSpinLock(&Log->Lock);
+    SetInterruptState(InterruptState);
+
+    return NumberOfBytes;
+}
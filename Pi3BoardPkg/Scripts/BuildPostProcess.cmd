@@ -124,7 +124,7 @@ if /I "%PI_FLAVOR%"=="Pi2Pi3" (
     )
 
     REM Generate a pad of zeros required by the boot image physical layout
-    fsutil file createnew "%TEMP_DIR%\pad.bin" 0x28000
+    fsutil file createnew "%TEMP_DIR%\pad.bin" 0x2000
     if %ERRORLEVEL% neq 0 (
         set EXITCODE=%ERRORLEVEL%
         goto :failed